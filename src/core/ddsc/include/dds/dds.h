@@ -1069,6 +1069,84 @@ dds_get_topic_filter(dds_entity_t topic);
 DDS_DEPRECATED_EXPORT dds_topic_filter_fn
 dds_topic_get_filter(dds_entity_t topic);
 
+/**
+ * @brief Content filter class
+ *
+ * A content filter class turns a filter expression and its parameters into
+ * an object that can decide whether a sample is of interest.  Readers
+ * created with dds_create_filtered_reader advertise their filter in
+ * discovery, and writers evaluate it on behalf of each matched reader,
+ * sending a sample only to the readers that accept it.  For this to work
+ * across processes, the class must be registered under the same name in
+ * every process.
+ *
+ * The compile function returns NULL if the expression is invalid.  It may
+ * be called for a topic whose type is not known in the process (desc =
+ * NULL), in which case returning NULL means the writer simply sends all
+ * data to that reader.
+ */
+typedef struct dds_content_filter_class {
+  const char *name;
+  void *(*compile) (const dds_topic_descriptor_t *desc, const char *expression, uint32_t nparams, const char * const *params);
+  bool (*accept) (const void *compiled, const void *sample);
+  void (*free) (void *compiled);
+} dds_content_filter_class_t;
+
+/**
+ * @brief Registers a content filter class
+ *
+ * Classes can't be unregistered; the class definition must remain valid
+ * for as long as the process uses DDS.
+ *
+ * @param[in]  cls  The content filter class.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The class is registered.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The class is incomplete.
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET
+ *             A class with the same name is already registered.
+ */
+DDS_EXPORT dds_return_t
+dds_register_content_filter_class(const dds_content_filter_class_t *cls);
+
+/**
+ * @brief Creates a content-filtered reader
+ *
+ * Equivalent to dds_create_reader, except that only samples accepted by the
+ * filter are stored in the reader.  The filter is also evaluated by the
+ * matching writers where possible, so that samples the reader is not
+ * interested in are not sent to it.
+ *
+ * @param[in]  participant_or_subscriber The participant or subscriber on which the reader is being created.
+ * @param[in]  topic         The topic to read.
+ * @param[in]  filter_class  The name of a registered content filter class.
+ * @param[in]  expression    The filter expression.
+ * @param[in]  nparams       The number of expression parameters.
+ * @param[in]  params        The expression parameters.
+ * @param[in]  qos           The QoS to set on the new reader (can be NULL).
+ * @param[in]  listener      Any listener functions associated with the new reader (can be NULL).
+ *
+ * @returns A valid reader handle or an error code.
+ *
+ * @retval >0
+ *             A valid reader handle.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The filter class is unknown or the expression can't be compiled.
+ */
+DDS_EXPORT dds_entity_t
+dds_create_filtered_reader(
+  dds_entity_t participant_or_subscriber,
+  dds_entity_t topic,
+  const char *filter_class,
+  const char *expression,
+  uint32_t nparams,
+  const char * const *params,
+  const dds_qos_t *qos,
+  const dds_listener_t *listener);
+
 /**
  * @brief Creates a new instance of a DDS subscriber
  *
@@ -1772,6 +1850,57 @@ dds_create_querycondition(
   uint32_t mask,
   dds_querycondition_filter_fn filter);
 
+/**
+ * @brief Filter evaluating a batch of samples in a single call.
+ *
+ * Sets matches[i] to whether samples[i] passes the filter, for 0 <= i < count.
+ * The arg parameter is the one passed to dds_create_querycondition_batch.
+ */
+typedef void (*dds_querycondition_batch_filter_fn) (const void * const *samples, bool *matches, uint32_t count, void *arg);
+
+/** @brief Flag for dds_create_querycondition_batch: the filter only looks at the key fields. */
+#define DDS_QUERYCOND_KEY_ONLY 1u
+
+/**
+ * @brief Creates a querycondition that uses a batch filter.
+ *
+ * Equivalent to dds_create_querycondition, except that the filter is given
+ * many samples at a time where possible (when the condition is created and
+ * the existing history has to be evaluated), with an application-defined
+ * argument.
+ *
+ * If flags includes DDS_QUERYCOND_KEY_ONLY, the filter promises to look only
+ * at the key fields of the samples, and the result is evaluated once per
+ * instance rather than once per sample. The non-key fields of the samples
+ * passed to the filter are then undefined.
+ *
+ * @param[in]  reader  Reader to associate the condition to.
+ * @param[in]  mask    Interest (dds_sample_state_t|dds_view_state_t|dds_instance_state_t).
+ * @param[in]  filter  Callback evaluating the filter for a batch of samples.
+ * @param[in]  arg     Argument passed to the filter.
+ * @param[in]  flags   0 or DDS_QUERYCOND_KEY_ONLY.
+ *
+ * @returns A valid condition handle or an error code
+ *
+ * @retval >=0
+ *             A valid condition handle.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The filter is a null pointer or the flags are invalid.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ */
+DDS_EXPORT dds_entity_t
+dds_create_querycondition_batch(
+  dds_entity_t reader,
+  uint32_t mask,
+  dds_querycondition_batch_filter_fn filter,
+  void *arg,
+  uint32_t flags);
+
 /**
  * @brief Creates a guardcondition.
  *
@@ -0,0 +1,43 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef _DDS_ARENA_H_
+#define _DDS_ARENA_H_
+
+#include <stddef.h>
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct dds_arena_chunk;
+
+/* Bump-pointer allocator for the out-of-line data (strings, sequence
+   buffers) of loaned samples: allocations are never freed individually,
+   instead the whole arena is reset once the loan is returned.  It grows by
+   adding chunks, and a reset consolidates those into a single chunk large
+   enough for the same amount of data, so that a reader that keeps reading
+   similar batches of data stops allocating memory altogether. */
+struct dds_arena {
+  struct dds_arena_chunk *chunks; /* current chunk first */
+};
+
+void dds_arena_init (struct dds_arena *arena);
+void dds_arena_fini (struct dds_arena *arena);
+void *dds_arena_alloc (struct dds_arena *arena, size_t size);
+void *dds_arena_alloc_zero (struct dds_arena *arena, size_t size);
+void dds_arena_reset (struct dds_arena *arena);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef _DDS_CONTENT_FILTER_H_
+#define _DDS_CONTENT_FILTER_H_
+
+#include "dds/dds.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_sertopic;
+struct ddsi_serdata;
+struct nn_content_filter_property;
+
+/* A compiled filter: used both by filtered readers and, through the
+   DDSI plugin hooks, by writers evaluating the filters of matched
+   proxy readers */
+struct dds_content_filter {
+  const dds_content_filter_class_t *cls;
+  void *compiled;
+  const struct ddsi_sertopic *topic;
+};
+
+struct dds_content_filter *dds_content_filter_new (const struct ddsi_sertopic *topic, const char *class_name, const char *expression, uint32_t nparams, const char * const *params);
+void dds_content_filter_free (struct dds_content_filter *cf);
+bool dds_content_filter_accepts_sample (const struct dds_content_filter *cf, const void *sample);
+
+void *dds__content_filter_compile (const struct ddsi_sertopic *topic, const struct nn_content_filter_property *filter);
+void *dds__content_filter_sample_new (const struct ddsi_serdata *serdata);
+bool dds__content_filter_accepts (const void *filter, const void *sample);
+void dds__content_filter_sample_free (const struct ddsi_serdata *serdata, void *sample);
+void dds__content_filter_free (void *filter);
+
+#if defined (__cplusplus)
+}
+#endif
+#endif
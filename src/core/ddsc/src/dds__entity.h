@@ -79,6 +79,15 @@ DDS_EXPORT void dds_entity_status_signal (dds_entity *e);
 
 DDS_EXPORT void dds_entity_invoke_listener (const dds_entity *entity, enum dds_status_id which, const void *vst);
 
+/* True if listeners are invoked on the listener thread pool (Internal/ListenerThreads) */
+DDS_EXPORT inline bool dds_entity_listeners_async (void) {
+  return dds_global.m_listener_pool != NULL;
+}
+
+/* Queues an invocation of the listener for WHICH on the listener thread
+   pool; called with m_observers_lock held */
+DDS_EXPORT void dds_entity_post_listener (dds_entity *e, enum dds_status_id which);
+
 DDS_EXPORT dds_retcode_t
 dds_entity_claim (
   dds_entity_t hdl,
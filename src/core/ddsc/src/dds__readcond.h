@@ -23,7 +23,10 @@ dds_create_readcond(
   dds_reader *rd,
   dds_entity_kind_t kind,
   uint32_t mask,
-  dds_querycondition_filter_fn filter);
+  dds_querycondition_filter_fn filter,
+  dds_querycondition_batch_filter_fn batch_filter,
+  void *batch_arg,
+  bool keyonly);
 
 #if defined (__cplusplus)
 }
@@ -23,13 +23,26 @@ struct nn_xqos;
 struct ddsi_serdata;
 struct ddsi_tkmap_instance;
 struct proxy_writer_info;
+struct dds_content_filter;
+struct dds_arena;
+
+struct dds_rhc_pool_stats {
+  uint64_t nallocs;   /* number of allocations served from the pool */
+  uint32_t nslabs;    /* number of slabs allocated */
+  uint32_t capacity;  /* number of elements in all slabs combined */
+  uint32_t inuse;     /* number of elements currently allocated */
+  uint32_t peak;      /* maximum of inuse */
+};
 
 DDS_EXPORT struct rhc *dds_rhc_new (dds_reader *reader, const struct ddsi_sertopic *topic);
 DDS_EXPORT void dds_rhc_free (struct rhc *rhc);
+DDS_EXPORT void dds_rhc_set_content_filter (struct rhc *rhc, struct dds_content_filter *filter);
 
 DDS_EXPORT uint32_t dds_rhc_lock_samples (struct rhc *rhc);
+DDS_EXPORT void dds_rhc_get_pool_stats (struct rhc *rhc, struct dds_rhc_pool_stats *samples, struct dds_rhc_pool_stats *instances);
 
 DDS_EXPORT bool dds_rhc_store  (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk);
+DDS_EXPORT uint32_t dds_rhc_store_set (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info, uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks);
 DDS_EXPORT void dds_rhc_unregister_wr (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info);
 DDS_EXPORT void dds_rhc_relinquish_ownership (struct rhc * __restrict rhc, const uint64_t wr_iid);
 
@@ -42,7 +55,8 @@ dds_rhc_read(
         uint32_t max_samples,
         uint32_t mask,
         dds_instance_handle_t handle,
-        dds_readcond *cond);
+        dds_readcond *cond,
+        struct dds_arena *arena);
 DDS_EXPORT int
 dds_rhc_take(
         struct rhc *rhc,
@@ -52,7 +66,8 @@ dds_rhc_take(
         uint32_t max_samples,
         uint32_t mask,
         dds_instance_handle_t handle,
-        dds_readcond *cond);
+        dds_readcond *cond,
+        struct dds_arena *arena);
 
 DDS_EXPORT void dds_rhc_set_qos (struct rhc * rhc, const struct nn_xqos * qos);
 
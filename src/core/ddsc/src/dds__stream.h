@@ -19,22 +19,33 @@
 extern "C" {
 #endif
 
-void dds_stream_write_sample
+struct dds_arena;
+
+DDS_EXPORT void dds_stream_write_sample
 (
   dds_stream_t * os,
   const void * data,
   const struct ddsi_sertopic_default * topic
 );
-void dds_stream_read_sample
+DDS_EXPORT void dds_stream_read_sample
 (
   dds_stream_t * is,
   void * data,
   const struct ddsi_sertopic_default * topic
 );
 
+void dds_stream_read_sample_w_arena
+(
+  dds_stream_t * is,
+  void * data,
+  const struct ddsi_sertopic_default * topic,
+  struct dds_arena * arena
+);
+
 size_t dds_stream_check_optimize (const dds_topic_descriptor_t * desc);
 void dds_stream_from_serdata_default (dds_stream_t * s, const struct ddsi_serdata_default *d);
 void dds_stream_add_to_serdata_default (dds_stream_t * s, struct ddsi_serdata_default **d);
+void dds_stream_serdata_to_sample_w_arena (const struct ddsi_serdata_default *d, const struct ddsi_sertopic_default *topic, void *sample, struct dds_arena *arena);
 
 void dds_stream_write_key (dds_stream_t * os, const char * sample, const struct ddsi_sertopic_default * topic);
 uint32_t dds_stream_extract_key (dds_stream_t *is, dds_stream_t *os, const uint32_t *ops, const bool just_key);
@@ -44,6 +55,13 @@ void dds_stream_read_key
   char * sample,
   const dds_topic_descriptor_t * desc
 );
+void dds_stream_read_key_w_arena
+(
+  dds_stream_t * is,
+  char * sample,
+  const dds_topic_descriptor_t * desc,
+  struct dds_arena * arena
+);
 void dds_stream_read_keyhash
 (
   dds_stream_t * is,
@@ -51,6 +69,14 @@ void dds_stream_read_keyhash
   const dds_topic_descriptor_t * desc,
   const bool just_key
 );
+DDS_EXPORT bool dds_stream_normalize
+(
+  void * data,
+  uint32_t size,
+  bool bswap,
+  const struct ddsi_sertopic_default * topic,
+  bool just_key
+);
 char * dds_stream_reuse_string
 (
   dds_stream_t * is,
@@ -59,6 +85,17 @@ char * dds_stream_reuse_string
 );
 DDS_EXPORT void dds_stream_swap (void * buff, uint32_t size, uint32_t num);
 
+/* Byte swapping using a specific instruction set, rather than the best one
+   available, so the vectorised implementations can be tested against the
+   scalar one. Returns false if it is not supported by the platform or the
+   CPU. */
+enum dds_stream_swap_isa {
+  DDS_STREAM_SWAP_SCALAR,
+  DDS_STREAM_SWAP_SSSE3,
+  DDS_STREAM_SWAP_AVX2
+};
+DDS_EXPORT bool dds_stream_swap_isa (void * buff, uint32_t size, uint32_t num, enum dds_stream_swap_isa isa);
+
 extern const uint32_t dds_op_size[5];
 
 /* For marshalling op code handling */
@@ -19,6 +19,7 @@
 #include "dds/ddsi/q_rtps.h"
 #include "dds/ddsrt/avl.h"
 #include "dds__handles.h"
+#include "dds__arena.h"
 
 #if defined (__cplusplus)
 extern "C" {
@@ -38,6 +39,7 @@ struct dds_statuscond;
 
 struct ddsi_sertopic;
 struct rhc;
+struct coherent_set;
 
 /* Internal entity status flags */
 
@@ -110,6 +112,8 @@ typedef struct dds_entity_deriver {
     dds_return_t (*set_qos)(struct dds_entity *e, const dds_qos_t *qos, bool enabled);
     dds_return_t (*validate_status)(uint32_t mask);
     dds_return_t (*get_instance_hdl)(struct dds_entity *e, dds_instance_handle_t *i);
+    /* Invokes the listener for a status queued by dds_entity_post_listener; called with m_observers_lock held. */
+    void (*deferred_listener)(struct dds_entity *e, enum dds_status_id which);
 }
 dds_entity_deriver;
 
@@ -148,6 +152,13 @@ typedef struct dds_entity
   uint32_t m_status_enable;
   uint32_t m_cb_count;
   dds_entity_observer *m_observers;
+
+  /* Listener invocations queued for the listener thread pool, in the
+     order in which the statuses were first raised */
+  bool m_async_scheduled;
+  uint32_t m_async_pending;
+  uint32_t m_async_npending;
+  uint8_t m_async_order[DDS_SUBSCRIPTION_MATCHED_STATUS_ID + 1];
 }
 dds_entity;
 
@@ -162,6 +173,7 @@ dds_subscriber;
 typedef struct dds_publisher
 {
   struct dds_entity m_entity;
+  uint32_t m_coherent_depth; /* nesting level of begin_coherent/end_coherent */
 }
 dds_publisher;
 
@@ -174,15 +186,27 @@ typedef struct dds_participant
 }
 dds_participant;
 
+/* Sample buffer loaned out by read/take when the application doesn't
+   provide one; returned loans are kept by the reader for reuse */
+typedef struct dds_loan
+{
+  struct dds_loan * m_next;
+  void * m_samples;
+  void ** m_ptrs;            /* [m_size] pointers to the samples in m_samples */
+  uint32_t m_size;
+  bool m_out;
+  struct dds_arena m_arena;  /* out-of-line data of the samples, if the topic allows it */
+}
+dds_loan;
+
 typedef struct dds_reader
 {
   struct dds_entity m_entity;
   const struct dds_topic * m_topic;
   struct reader * m_rd;
   bool m_data_on_readers;
-  bool m_loan_out;
-  void * m_loan;
-  uint32_t m_loan_size;
+  bool m_loan_arena;
+  dds_loan * m_loans;
 
   /* Status metrics */
 
@@ -202,6 +226,8 @@ typedef struct dds_writer
   struct nn_xpack * m_xp;
   struct writer * m_wr;
   struct whc *m_whc; /* FIXME: ownership still with underlying DDSI writer (cos of DDSI built-in writers )*/
+  struct coherent_set *m_coherent; /* samples pending for local coherent readers, NULL if no set open */
+  struct ddsi_tkmap_instance *m_last_tk; /* instance last written to, referenced to avoid re-creating it for every write */
 
   /* Status metrics */
 
@@ -245,7 +271,10 @@ typedef struct dds_readcond
   struct dds_readcond * m_next;
   struct
   {
-      dds_querycondition_filter_fn m_filter;
+      dds_querycondition_filter_fn m_filter; /* per-sample filter, or 0 if created with a batch filter */
+      dds_querycondition_batch_filter_fn m_batch_filter; /* non-0 for all query conditions */
+      void *m_batch_arg;
+      bool m_keyonly; /* filter only looks at key fields */
       dds_querycond_mask_t m_qcmask; /* condition mask in RHC*/
   } m_query;
 }
@@ -285,6 +314,7 @@ typedef struct dds_globals
   void (*m_dur_fini) (void);
   ddsrt_avl_tree_t m_domains;
   ddsrt_mutex_t m_mutex;
+  struct ddsrt_thread_pool_s *m_listener_pool;
 }
 dds_globals;
 
@@ -19,6 +19,7 @@ extern "C" {
 #endif
 
 struct whc *whc_new (int is_transient_local, unsigned hdepth, unsigned tldepth);
+DDS_EXPORT struct whc *whc_ring_new (unsigned hdepth);
 
 #if defined (__cplusplus)
 }
@@ -21,6 +21,7 @@ extern "C" {
 #define DDS_WR_UNREGISTER_BIT 0x04
 
 struct ddsi_serdata;
+struct coherent_set;
 
 typedef enum {
   DDS_WR_ACTION_WRITE = 0,
@@ -31,7 +32,10 @@ typedef enum {
 
 dds_return_t dds_write_impl (dds_writer *wr, const void *data, dds_time_t tstamp, dds_write_action action);
 dds_return_t dds_writecdr_impl (dds_writer *wr, struct ddsi_serdata *d, dds_time_t tstamp, dds_write_action action);
-dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d);
+dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct coherent_set *cs, struct ddsi_serdata *d);
+
+dds_return_t dds_write_begin_coherent (dds_writer *wr);
+dds_return_t dds_write_end_coherent (dds_writer *wr);
 
 #if defined (__cplusplus)
 }
@@ -0,0 +1,103 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds__arena.h"
+
+#define ARENA_ALIGN 8u
+#define ARENA_MIN_CHUNK_SIZE 4096u
+
+struct dds_arena_chunk {
+  struct dds_arena_chunk *next;
+  size_t size;
+  size_t pos;
+  union {
+    /* raw data array, size bytes long in reality */
+    unsigned char raw[1];
+
+    /* to ensure reasonable alignment of raw[] */
+    int64_t l;
+    double d;
+    void *p;
+  } u;
+};
+
+static struct dds_arena_chunk *dds_arena_chunk_new (size_t size, struct dds_arena_chunk *next)
+{
+  struct dds_arena_chunk *c = ddsrt_malloc (offsetof (struct dds_arena_chunk, u.raw) + size);
+  c->next = next;
+  c->size = size;
+  c->pos = 0;
+  return c;
+}
+
+void dds_arena_init (struct dds_arena *arena)
+{
+  arena->chunks = NULL;
+}
+
+void dds_arena_fini (struct dds_arena *arena)
+{
+  struct dds_arena_chunk *c;
+  while ((c = arena->chunks) != NULL)
+  {
+    arena->chunks = c->next;
+    ddsrt_free (c);
+  }
+}
+
+void *dds_arena_alloc (struct dds_arena *arena, size_t size)
+{
+  struct dds_arena_chunk *c = arena->chunks;
+  void *ptr;
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  if (c == NULL || c->size - c->pos < size)
+  {
+    /* doubling the chunk size bounds the number of chunks to log(total) */
+    size_t csize = (c == NULL) ? ARENA_MIN_CHUNK_SIZE : 2 * c->size;
+    if (csize < size)
+      csize = size;
+    c = arena->chunks = dds_arena_chunk_new (csize, c);
+  }
+  ptr = c->u.raw + c->pos;
+  c->pos += size;
+  return ptr;
+}
+
+void *dds_arena_alloc_zero (struct dds_arena *arena, size_t size)
+{
+  void *ptr = dds_arena_alloc (arena, size);
+  memset (ptr, 0, size);
+  return ptr;
+}
+
+void dds_arena_reset (struct dds_arena *arena)
+{
+  struct dds_arena_chunk *c = arena->chunks;
+  if (c == NULL)
+    return;
+  else if (c->next == NULL)
+    c->pos = 0;
+  else
+  {
+    size_t total = 0;
+    while ((c = arena->chunks) != NULL)
+    {
+      total += c->size;
+      arena->chunks = c->next;
+      ddsrt_free (c);
+    }
+    arena->chunks = dds_arena_chunk_new (total, NULL);
+  }
+}
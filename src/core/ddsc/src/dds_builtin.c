@@ -231,6 +231,6 @@ void dds__builtin_write (const struct entity_common *e, nn_wctime_t timestamp, b
         bwr = builtintopic_writer_subscriptions;
         break;
     }
-    dds_writecdr_impl_lowlevel (&bwr->wr, NULL, serdata);
+    dds_writecdr_impl_lowlevel (&bwr->wr, NULL, NULL, serdata);
   }
 }
@@ -17,11 +17,28 @@
 #include "dds__publisher.h"
 #include "dds__err.h"
 
+static bool
+is_publisher_side(
+  dds_entity_t entity)
+{
+  dds_entity *e;
+  bool ret = false;
+  if (dds_entity_claim (entity, &e) == DDS_RETCODE_OK)
+  {
+    ret = (dds_entity_kind (e) == DDS_KIND_PUBLISHER || dds_entity_kind (e) == DDS_KIND_WRITER);
+    dds_entity_release (e);
+  }
+  return ret;
+}
+
 dds_return_t
 dds_begin_coherent(
   dds_entity_t entity)
 {
-  static const dds_entity_kind_t kinds[] = { DDS_KIND_READER, DDS_KIND_WRITER, DDS_KIND_PUBLISHER, DDS_KIND_SUBSCRIBER };
+  /* Group/ordered access on the subscriber side is not supported */
+  static const dds_entity_kind_t kinds[] = { DDS_KIND_READER, DDS_KIND_SUBSCRIBER };
+  if (is_publisher_side (entity))
+    return dds_publisher_begin_coherent (entity);
   return dds_generic_unimplemented_operation_manykinds (entity, sizeof (kinds) / sizeof (kinds[0]), kinds);
 }
 
@@ -29,6 +46,8 @@ dds_return_t
 dds_end_coherent(
   dds_entity_t entity)
 {
-  static const dds_entity_kind_t kinds[] = { DDS_KIND_READER, DDS_KIND_WRITER, DDS_KIND_PUBLISHER, DDS_KIND_SUBSCRIBER };
+  static const dds_entity_kind_t kinds[] = { DDS_KIND_READER, DDS_KIND_SUBSCRIBER };
+  if (is_publisher_side (entity))
+    return dds_publisher_end_coherent (entity);
   return dds_generic_unimplemented_operation_manykinds (entity, sizeof (kinds) / sizeof (kinds[0]), kinds);
 }
@@ -0,0 +1,124 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds__content_filter.h"
+#include "dds__err.h"
+#include "dds/ddsi/q_plist.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_sertopic.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+
+/* Registered classes form a push-only list: classes can't be
+   unregistered, which means lookups need no locking at all */
+struct content_filter_class_node {
+  struct content_filter_class_node *next;
+  const dds_content_filter_class_t *cls;
+};
+
+static ddsrt_atomic_voidp_t content_filter_classes = DDSRT_ATOMIC_VOIDP_INIT (0);
+
+static const dds_content_filter_class_t *lookup_class (struct content_filter_class_node *n, const char *name)
+{
+  for (; n; n = n->next)
+    if (strcmp (n->cls->name, name) == 0)
+      return n->cls;
+  return NULL;
+}
+
+dds_return_t dds_register_content_filter_class (const dds_content_filter_class_t *cls)
+{
+  struct content_filter_class_node *n, *head;
+  if (cls == NULL || cls->name == NULL || cls->compile == 0 || cls->accept == 0 || cls->free == 0)
+    return DDS_ERRNO (DDS_RETCODE_BAD_PARAMETER);
+  n = ddsrt_malloc (sizeof (*n));
+  n->cls = cls;
+  do {
+    head = ddsrt_atomic_ldvoidp (&content_filter_classes);
+    if (lookup_class (head, cls->name) != NULL)
+    {
+      ddsrt_free (n);
+      return DDS_ERRNO (DDS_RETCODE_PRECONDITION_NOT_MET);
+    }
+    n->next = head;
+  } while (!ddsrt_atomic_casvoidp (&content_filter_classes, head, n));
+  return DDS_RETCODE_OK;
+}
+
+struct dds_content_filter *dds_content_filter_new (const struct ddsi_sertopic *topic, const char *class_name, const char *expression, uint32_t nparams, const char * const *params)
+{
+  const dds_content_filter_class_t *cls;
+  const dds_topic_descriptor_t *desc;
+  struct dds_content_filter *cf;
+  void *compiled;
+  if ((cls = lookup_class (ddsrt_atomic_ldvoidp (&content_filter_classes), class_name)) == NULL)
+    return NULL;
+  /* The type descriptor is only available for topics of the default
+     sample representation */
+  if (topic->ops == &ddsi_sertopic_ops_default)
+    desc = ((const struct ddsi_sertopic_default *) topic)->type;
+  else
+    desc = NULL;
+  if ((compiled = cls->compile (desc, expression, nparams, params)) == NULL)
+    return NULL;
+  cf = ddsrt_malloc (sizeof (*cf));
+  cf->cls = cls;
+  cf->compiled = compiled;
+  cf->topic = topic;
+  return cf;
+}
+
+void dds_content_filter_free (struct dds_content_filter *cf)
+{
+  cf->cls->free (cf->compiled);
+  ddsrt_free (cf);
+}
+
+bool dds_content_filter_accepts_sample (const struct dds_content_filter *cf, const void *sample)
+{
+  return cf->cls->accept (cf->compiled, sample);
+}
+
+void *dds__content_filter_compile (const struct ddsi_sertopic *topic, const struct nn_content_filter_property *filter)
+{
+  return dds_content_filter_new (topic, filter->filter_class_name, filter->filter_expression, filter->expression_parameters.n, (const char * const *) filter->expression_parameters.strs);
+}
+
+void *dds__content_filter_sample_new (const struct ddsi_serdata *serdata)
+{
+  void *sample = ddsi_sertopic_alloc_sample (serdata->topic);
+  if (!ddsi_serdata_to_sample (serdata, sample, NULL, NULL))
+  {
+    ddsi_sertopic_free_sample (serdata->topic, sample, DDS_FREE_ALL);
+    return NULL;
+  }
+  return sample;
+}
+
+bool dds__content_filter_accepts (const void *filter, const void *sample)
+{
+  const struct dds_content_filter *cf = filter;
+  return cf->cls->accept (cf->compiled, sample);
+}
+
+void dds__content_filter_sample_free (const struct ddsi_serdata *serdata, void *sample)
+{
+  ddsi_sertopic_free_sample (serdata->topic, sample, DDS_FREE_ALL);
+}
+
+void dds__content_filter_free (void *filter)
+{
+  dds_content_filter_free (filter);
+}
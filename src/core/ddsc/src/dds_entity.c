@@ -14,6 +14,7 @@
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
+#include "dds/ddsrt/thread_pool.h"
 #include "dds__entity.h"
 #include "dds__write.h"
 #include "dds__writer.h"
@@ -27,6 +28,7 @@ extern inline bool dds_entity_is_enabled (const dds_entity *e);
 extern inline void dds_entity_status_reset (dds_entity *e, uint32_t t);
 extern inline bool dds_entity_status_match (const dds_entity *e, uint32_t t);
 extern inline dds_entity_kind_t dds_entity_kind (const dds_entity *e);
+extern inline bool dds_entity_listeners_async (void);
 
 static void dds_entity_observers_signal (dds_entity *observed, uint32_t status);
 static void dds_entity_observers_delete (dds_entity *observed);
@@ -77,6 +79,9 @@ dds_entity_t dds_entity_init (dds_entity *e, dds_entity *parent, dds_entity_kind
   e->m_cb_count = 0;
   e->m_observers = NULL;
   e->m_trigger = 0;
+  e->m_async_scheduled = false;
+  e->m_async_pending = 0;
+  e->m_async_npending = 0;
 
   /* TODO: CHAM-96: Implement dynamic enabling of entity. */
   e->m_flags |= DDS_ENTITY_ENABLED;
@@ -484,6 +489,66 @@ void dds_entity_invoke_listener (const dds_entity *entity, enum dds_status_id wh
   }
 }
 
+static void dds_entity_deferred_listener_job (void *varg)
+{
+  /* The job refers to the entity by handle: once deletion has started the
+     claim fails and the job is a no-op, so that deleting an entity never
+     has to wait for a job that is still queued behind other listeners */
+  const dds_entity_t hdl = (dds_entity_t) (intptr_t) varg;
+  dds_entity *e;
+  if (dds_entity_claim (hdl, &e) != DDS_RETCODE_OK)
+    return;
+  ddsrt_mutex_lock (&e->m_observers_lock);
+  if (!e->m_async_scheduled)
+  {
+    /* handle got reused for an entity without pending listeners */
+    ddsrt_mutex_unlock (&e->m_observers_lock);
+    dds_entity_release (e);
+    return;
+  }
+  e->m_cb_count++;
+  while (e->m_async_npending > 0)
+  {
+    const enum dds_status_id which = (enum dds_status_id) e->m_async_order[0];
+    memmove (&e->m_async_order[0], &e->m_async_order[1], (e->m_async_npending - 1) * sizeof (e->m_async_order[0]));
+    e->m_async_npending--;
+    e->m_async_pending &= ~(1u << which);
+    e->m_deriver.deferred_listener (e, which);
+  }
+  e->m_async_scheduled = false;
+  e->m_cb_count--;
+  ddsrt_cond_broadcast (&e->m_observers_cond);
+  ddsrt_mutex_unlock (&e->m_observers_lock);
+  dds_entity_release (e);
+}
+
+void dds_entity_post_listener (dds_entity *e, enum dds_status_id which)
+{
+  /* A status that is already pending gets merged with the pending one:
+     its counters keep accumulating until the listener gets invoked.  A
+     single job per entity guarantees the invocations occur in order and
+     never concurrently; while running it holds a claim on m_cb_count so
+     that deleting the entity or changing its listeners waits for it. */
+  const uint32_t bit = 1u << which;
+  assert (dds_entity_listeners_async ());
+  assert (e->m_deriver.deferred_listener);
+  if (!(e->m_async_pending & bit))
+  {
+    assert (e->m_async_npending < sizeof (e->m_async_order) / sizeof (e->m_async_order[0]));
+    e->m_async_pending |= bit;
+    e->m_async_order[e->m_async_npending++] = (uint8_t) which;
+  }
+  if (!e->m_async_scheduled)
+  {
+    dds_retcode_t rc;
+    e->m_async_scheduled = true;
+    rc = ddsrt_thread_pool_submit (dds_global.m_listener_pool, dds_entity_deferred_listener_job, (void *) (intptr_t) e->m_hdllink.hdl);
+    /* the queue is unbounded, but each entity is in it at most once */
+    assert (rc == DDS_RETCODE_OK);
+    (void) rc;
+  }
+}
+
 static void clear_status_with_listener (struct dds_entity *e)
 {
   const struct dds_listener *lst = &e->m_listener;
@@ -17,11 +17,13 @@
 #include "dds/ddsrt/environ.h"
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/thread_pool.h"
 #include "dds__init.h"
 #include "dds__rhc.h"
 #include "dds__domain.h"
 #include "dds__err.h"
 #include "dds__builtin.h"
+#include "dds__content_filter.h"
 #include "dds__whc_builtintopic.h"
 #include "dds/ddsi/ddsi_iid.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -147,6 +149,17 @@ dds_init(dds_domainid_t domain)
     goto fail_rtps_init;
   }
 
+  if (config.listener_threads > 0)
+  {
+    dds_global.m_listener_pool = ddsrt_thread_pool_new (1, (uint32_t) config.listener_threads, 0, NULL);
+    if (dds_global.m_listener_pool == NULL)
+    {
+      DDS_ERROR("Failed to create listener thread pool\n");
+      ret = DDS_ERRNO(DDS_RETCODE_ERROR);
+      goto fail_listener_pool;
+    }
+  }
+
   if (dds_handle_server_init (free_via_gc) != DDS_RETCODE_OK)
   {
     DDS_ERROR("Failed to initialize internal handle server\n");
@@ -200,6 +213,12 @@ fail_handleserver:
   rtps_stop ();
 fail_rtps_start:
   dds__builtin_fini ();
+  if (dds_global.m_listener_pool)
+  {
+    ddsrt_thread_pool_free (dds_global.m_listener_pool);
+    dds_global.m_listener_pool = NULL;
+  }
+fail_listener_pool:
   rtps_fini ();
 fail_rtps_init:
   if (gv.threadmon)
@@ -237,6 +256,11 @@ extern void dds_fini (void)
     dds_handle_server_fini();
     rtps_stop ();
     dds__builtin_fini ();
+    if (dds_global.m_listener_pool)
+    {
+      ddsrt_thread_pool_free (dds_global.m_listener_pool);
+      dds_global.m_listener_pool = NULL;
+    }
     rtps_fini ();
     if (gv.threadmon)
       ddsi_threadmon_free (gv.threadmon);
@@ -275,9 +299,16 @@ void ddsi_plugin_init (void)
 
   ddsi_plugin.rhc_plugin.rhc_free_fn = dds_rhc_free;
   ddsi_plugin.rhc_plugin.rhc_store_fn = dds_rhc_store;
+  ddsi_plugin.rhc_plugin.rhc_store_set_fn = dds_rhc_store_set;
   ddsi_plugin.rhc_plugin.rhc_unregister_wr_fn = dds_rhc_unregister_wr;
   ddsi_plugin.rhc_plugin.rhc_relinquish_ownership_fn = dds_rhc_relinquish_ownership;
   ddsi_plugin.rhc_plugin.rhc_set_qos_fn = dds_rhc_set_qos;
+
+  ddsi_plugin.content_filter_compile = dds__content_filter_compile;
+  ddsi_plugin.content_filter_sample_new = dds__content_filter_sample_new;
+  ddsi_plugin.content_filter_accepts = dds__content_filter_accepts;
+  ddsi_plugin.content_filter_sample_free = dds__content_filter_sample_free;
+  ddsi_plugin.content_filter_free = dds__content_filter_free;
 }
 
 //provides explicit default domain id.
@@ -82,7 +82,7 @@ static void dds_key_gen_stream (const dds_topic_descriptor_t * const desc, dds_s
         uint32_t size = dds_op_size[DDS_OP_SUBTYPE (*op)];
         char *dst;
         len = size * op[2];
-        dst = dds_stream_alignto (os, op[2]);
+        dst = dds_stream_alignto (os, size);
         dds_stream_write_buffer (os, len, (const uint8_t *) src);
         if (dds_stream_endian () && (size != 1u))
           dds_stream_swap (dst, size, op[2]);
@@ -93,6 +93,48 @@ static void dds_key_gen_stream (const dds_topic_descriptor_t * const desc, dds_s
   }
 }
 
+/* Upper bound on the size of the key as serialised by dds_key_gen_stream,
+   including the worst-case alignment padding preceding each key field */
+static uint32_t dds_key_gen_maxsize (const dds_topic_descriptor_t * const desc, const char *sample)
+{
+  const char * src;
+  const uint32_t * op;
+  uint32_t i;
+  uint32_t size = 0;
+
+  for (i = 0; i < desc->m_nkeys; i++)
+  {
+    op = desc->m_ops + desc->m_keys[i].m_index;
+    src = sample + op[1];
+    switch (DDS_OP_TYPE (*op))
+    {
+      case DDS_OP_VAL_STR:
+      {
+        src = *((char**) src);
+      }
+        /* FALLS THROUGH */
+      case DDS_OP_VAL_BST:
+      {
+        size += 3 + 4 + (uint32_t) strlen (src) + 1;
+        break;
+      }
+      case DDS_OP_VAL_ARR:
+      {
+        const uint32_t elemsize = dds_op_size[DDS_OP_SUBTYPE (*op)];
+        size += (elemsize - 1) + elemsize * op[2];
+        break;
+      }
+      default:
+      {
+        const uint32_t elemsize = dds_op_size[DDS_OP_TYPE (*op)];
+        size += (elemsize - 1) + elemsize;
+        break;
+      }
+    }
+  }
+  return size;
+}
+
 void dds_key_gen (const dds_topic_descriptor_t * const desc, dds_key_hash_t * kh, const char * sample)
 {
   assert(keyhash_is_reset(kh));
@@ -112,15 +154,33 @@ void dds_key_gen (const dds_topic_descriptor_t * const desc, dds_key_hash_t * kh
   }
   else
   {
+    /* Keys are nearly always small, serialising them on the stack avoids a
+       heap allocation for every sample written.  The stack buffer is only
+       used if the key is guaranteed to fit, as growing the stream would
+       realloc it, and padding is hashed as well, hence clearing it */
+    uint64_t buf[32];
     dds_stream_t os;
     ddsrt_md5_state_t md5st;
+    const uint32_t maxsize = dds_key_gen_maxsize (desc, sample);
     kh->m_iskey = 0;
-    dds_stream_init(&os, 64);
+    if (maxsize <= sizeof (buf))
+    {
+      dds_stream_init (&os, 0);
+      memset (buf, 0, sizeof (buf));
+      os.m_buffer.pv = buf;
+      os.m_size = (uint32_t) sizeof (buf);
+    }
+    else
+    {
+      dds_stream_init (&os, maxsize);
+    }
     os.m_endian = 0;
     dds_key_gen_stream (desc, &os, sample);
+    assert (os.m_index <= maxsize);
     ddsrt_md5_init (&md5st);
     ddsrt_md5_append (&md5st, os.m_buffer.p8, os.m_index);
     ddsrt_md5_finish (&md5st, (unsigned char *) kh->m_hash);
-    dds_stream_fini (&os);
+    if (os.m_buffer.pv != buf)
+      dds_stream_fini (&os);
   }
 }
@@ -11,9 +11,12 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/misc.h"
 #include "dds__listener.h"
 #include "dds__publisher.h"
+#include "dds__writer.h"
+#include "dds__write.h"
 #include "dds__qos.h"
 #include "dds__err.h"
 #include "dds/ddsi/q_entity.h"
@@ -169,23 +172,87 @@ dds_wait_for_acks(
   return dds_generic_unimplemented_operation_manykinds (publisher_or_writer, sizeof (kinds) / sizeof (kinds[0]), kinds);
 }
 
+static dds_return_t
+dds_publisher_coherent(
+    dds_entity_t e,
+    bool begin)
+{
+    /* Coherent sets are maintained per writer (i.e., TOPIC access scope),
+       the publisher only keeps track of the nesting and opens/closes the
+       sets of all its writers when the outermost one starts/ends. */
+    dds_entity *x;
+    dds_publisher *pub;
+    dds_entity_t pubh;
+    dds_entity_t *wrs = NULL;
+    dds_retcode_t rc;
+    dds_return_t ret = DDS_RETCODE_OK;
+    size_t nwrs = 0, i;
+
+    if ((rc = dds_entity_lock(e, DDS_KIND_DONTCARE, &x)) != DDS_RETCODE_OK) {
+        return DDS_ERRNO(rc);
+    }
+    switch (dds_entity_kind(x)) {
+        case DDS_KIND_PUBLISHER:
+            pubh = e;
+            break;
+        case DDS_KIND_WRITER:
+            pubh = x->m_parent->m_hdllink.hdl;
+            break;
+        default:
+            dds_entity_unlock(x);
+            return DDS_ERRNO(DDS_RETCODE_ILLEGAL_OPERATION);
+    }
+    dds_entity_unlock(x);
+
+    if ((rc = dds_publisher_lock(pubh, &pub)) != DDS_RETCODE_OK) {
+        return DDS_ERRNO(rc);
+    }
+    if (!begin && pub->m_coherent_depth == 0) {
+        dds_publisher_unlock(pub);
+        DDS_ERROR("No coherent set in progress\n");
+        return DDS_ERRNO(DDS_RETCODE_PRECONDITION_NOT_MET);
+    }
+    if (begin ? (pub->m_coherent_depth++ == 0) : (--pub->m_coherent_depth == 0)) {
+        dds_entity *iter;
+        for (iter = pub->m_entity.m_children; iter; iter = iter->m_next) {
+            nwrs++;
+        }
+        wrs = ddsrt_malloc((nwrs > 0 ? nwrs : 1) * sizeof(*wrs));
+        nwrs = 0;
+        for (iter = pub->m_entity.m_children; iter; iter = iter->m_next) {
+            wrs[nwrs++] = iter->m_hdllink.hdl;
+        }
+    }
+    dds_publisher_unlock(pub);
+
+    for (i = 0; i < nwrs; i++) {
+        dds_writer *wr;
+        dds_return_t ret1;
+        /* writers may have been deleted in the meantime */
+        if (dds_writer_lock(wrs[i], &wr) != DDS_RETCODE_OK) {
+            continue;
+        }
+        ret1 = begin ? dds_write_begin_coherent(wr) : dds_write_end_coherent(wr);
+        dds_writer_unlock(wr);
+        if (ret == DDS_RETCODE_OK) {
+            ret = ret1;
+        }
+    }
+    ddsrt_free(wrs);
+    return ret;
+}
+
 dds_return_t
 dds_publisher_begin_coherent(
     dds_entity_t e)
 {
-    /* TODO: CHAM-124 Currently unsupported. */
-    (void)e;
-    DDS_ERROR("Using coherency to get a coherent data set is not being supported yet\n");
-    return DDS_ERRNO(DDS_RETCODE_UNSUPPORTED);
+    return dds_publisher_coherent(e, true);
 }
 
 dds_return_t
 dds_publisher_end_coherent(
     dds_entity_t e)
 {
-    /* TODO: CHAM-124 Currently unsupported. */
-    (void)e;
-    DDS_ERROR("Using coherency to get a coherent data set is not being supported yet\n");
-    return DDS_ERRNO(DDS_RETCODE_UNSUPPORTED);
+    return dds_publisher_coherent(e, false);
 }
 
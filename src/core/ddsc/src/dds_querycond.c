@@ -22,11 +22,14 @@
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertopic.h"
 
-DDS_EXPORT dds_entity_t
-dds_create_querycondition(
+static dds_entity_t
+dds_create_querycondition_impl(
     dds_entity_t reader,
     uint32_t mask,
-    dds_querycondition_filter_fn filter)
+    dds_querycondition_filter_fn filter,
+    dds_querycondition_batch_filter_fn batch_filter,
+    void *batch_arg,
+    bool keyonly)
 {
     dds_entity_t hdl;
     dds_retcode_t rc;
@@ -34,7 +37,7 @@ dds_create_querycondition(
 
     rc = dds_reader_lock(reader, &r);
     if (rc == DDS_RETCODE_OK) {
-        dds_readcond *cond = dds_create_readcond(r, DDS_KIND_COND_QUERY, mask, filter);
+        dds_readcond *cond = dds_create_readcond(r, DDS_KIND_COND_QUERY, mask, filter, batch_filter, batch_arg, keyonly);
         assert(cond);
         const bool success = (cond->m_entity.m_deriver.delete != 0);
         dds_reader_unlock(r);
@@ -51,3 +54,27 @@ dds_create_querycondition(
 
     return hdl;
 }
+
+DDS_EXPORT dds_entity_t
+dds_create_querycondition(
+    dds_entity_t reader,
+    uint32_t mask,
+    dds_querycondition_filter_fn filter)
+{
+    return dds_create_querycondition_impl(reader, mask, filter, 0, NULL, false);
+}
+
+DDS_EXPORT dds_entity_t
+dds_create_querycondition_batch(
+    dds_entity_t reader,
+    uint32_t mask,
+    dds_querycondition_batch_filter_fn filter,
+    void *arg,
+    uint32_t flags)
+{
+    if (filter == 0 || (flags & ~DDS_QUERYCOND_KEY_ONLY) != 0) {
+        DDS_ERROR("Invalid filter or flags\n");
+        return DDS_ERRNO(DDS_RETCODE_BAD_PARAMETER);
+    }
+    return dds_create_querycondition_impl(reader, mask, 0, filter, arg, (flags & DDS_QUERYCOND_KEY_ONLY) != 0);
+}
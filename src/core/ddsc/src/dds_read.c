@@ -21,6 +21,7 @@
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_globals.h"
 #include "dds/ddsi/ddsi_sertopic.h"
+#include "dds__arena.h"
 
 static dds_retcode_t dds_read_lock (dds_entity_t hdl, dds_reader **reader, dds_readcond **condition, bool only_reader)
 {
@@ -69,6 +70,49 @@ static void dds_read_unlock (dds_reader *reader, dds_readcond *condition)
       dds_entity_unlock (&condition->m_entity);
 }
 
+static dds_loan *dds_loan_find (dds_reader *rd, const void *samples)
+{
+    dds_loan *loan;
+    for (loan = rd->m_loans; loan; loan = loan->m_next) {
+        if (loan->m_samples == samples) {
+            break;
+        }
+    }
+    return loan;
+}
+
+/* Hands out a loan of at least maxs samples, preferring a returned one that
+   is large enough, growing a returned one that isn't and only allocating a
+   new one if all of them are out */
+static dds_loan *dds_loan_acquire (dds_reader *rd, void **buf, uint32_t maxs)
+{
+    const struct ddsi_sertopic *st = rd->m_topic->m_stopic;
+    dds_loan *loan, *free_loan = NULL;
+    for (loan = rd->m_loans; loan; loan = loan->m_next) {
+        if (!loan->m_out) {
+            free_loan = loan;
+            if (loan->m_size >= maxs) {
+                break;
+            }
+        }
+    }
+    if (loan == NULL && (loan = free_loan) == NULL) {
+        loan = dds_alloc (sizeof (*loan));
+        dds_arena_init (&loan->m_arena);
+        loan->m_next = rd->m_loans;
+        rd->m_loans = loan;
+    }
+    if (loan->m_size < maxs) {
+        loan->m_ptrs = dds_realloc (loan->m_ptrs, maxs * sizeof (*loan->m_ptrs));
+        ddsi_sertopic_realloc_samples (loan->m_ptrs, st, loan->m_samples, loan->m_size, maxs);
+        loan->m_samples = loan->m_ptrs[0];
+        loan->m_size = maxs;
+    }
+    memcpy (buf, loan->m_ptrs, maxs * sizeof (*buf));
+    loan->m_out = true;
+    return loan;
+}
+
 /*
   dds_read_impl: Core read/take function. Usually maxs is size of buf and si
   into which samples/status are written, when set to zero is special case
@@ -94,6 +138,8 @@ dds_read_impl(
     dds_retcode_t rc;
     struct dds_reader * rd;
     struct dds_readcond * cond;
+    struct dds_loan * loan;
+    struct dds_arena * arena = NULL;
 
     if (buf == NULL) {
         DDS_ERROR("The provided buffer is NULL\n");
@@ -137,25 +183,18 @@ dds_read_impl(
     }
     /* Allocate samples if not provided (assuming all or none provided) */
     if (buf[0] == NULL) {
-        /* Allocate, use or reallocate loan cached on reader */
-        if (rd->m_loan_out) {
-            ddsi_sertopic_realloc_samples (buf, rd->m_topic->m_stopic, NULL, 0, maxs);
-        } else {
-            if (rd->m_loan) {
-                if (rd->m_loan_size < maxs) {
-                    ddsi_sertopic_realloc_samples (buf, rd->m_topic->m_stopic, rd->m_loan, rd->m_loan_size, maxs);
-                    rd->m_loan = buf[0];
-                    rd->m_loan_size = maxs;
-                } else {
-                  buf[0] = rd->m_loan;
-                }
-             } else {
-                 ddsi_sertopic_realloc_samples (buf, rd->m_topic->m_stopic, NULL, 0, maxs);
-                 rd->m_loan = buf[0];
-                 rd->m_loan_size = maxs;
-             }
-            rd->m_loan_out = true;
+        loan = dds_loan_acquire (rd, buf, maxs);
+        if (rd->m_loan_arena) {
+            arena = &loan->m_arena;
         }
+    } else if ((loan = dds_loan_find (rd, buf[0])) != NULL) {
+        /* Reading into a loan that is still out overwrites its contents */
+        if (rd->m_loan_arena) {
+            dds_arena_reset (&loan->m_arena);
+            ddsi_sertopic_zero_samples (rd->m_topic->m_stopic, loan->m_samples, loan->m_size);
+            arena = &loan->m_arena;
+        }
+        loan->m_out = true;
     }
 
     /* read/take resets data available status -- must reset before reading because
@@ -169,9 +208,9 @@ dds_read_impl(
     ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
 
     if (take) {
-        ret = (dds_return_t)dds_rhc_take(rd->m_rd->rhc, lock, buf, si, maxs, mask, hand, cond);
+        ret = (dds_return_t)dds_rhc_take(rd->m_rd->rhc, lock, buf, si, maxs, mask, hand, cond, arena);
     } else {
-        ret = (dds_return_t)dds_rhc_read(rd->m_rd->rhc, lock, buf, si, maxs, mask, hand, cond);
+        ret = (dds_return_t)dds_rhc_read(rd->m_rd->rhc, lock, buf, si, maxs, mask, hand, cond, arena);
     }
     dds_read_unlock(rd, cond);
 
@@ -685,6 +724,7 @@ dds_return_loan(
     const struct ddsi_sertopic *st;
     dds_reader *rd;
     dds_readcond *cond;
+    dds_loan *loan;
     dds_return_t ret = DDS_RETCODE_OK;
 
     if (!buf) {
@@ -704,14 +744,21 @@ dds_return_loan(
     }
     st = rd->m_topic->m_stopic;
 
-    for (int32_t i = 0; i < bufsz; i++) {
-        ddsi_sertopic_free_sample (st, buf[i], DDS_FREE_CONTENTS);
+    /* The contents of loaned samples are carved from the loan's arena, so
+       they can all be released in one go instead of one by one */
+    loan = dds_loan_find (rd, buf[0]);
+    if (loan != NULL && rd->m_loan_arena) {
+        dds_arena_reset (&loan->m_arena);
+    } else {
+        for (int32_t i = 0; i < bufsz; i++) {
+            ddsi_sertopic_free_sample (st, buf[i], DDS_FREE_CONTENTS);
+        }
     }
 
     /* If possible return loan buffer to reader */
-    if (rd->m_loan != 0 && (buf[0] == rd->m_loan)) {
-        rd->m_loan_out = false;
-        ddsi_sertopic_zero_samples (st, rd->m_loan, rd->m_loan_size);
+    if (loan != NULL) {
+        loan->m_out = false;
+        ddsi_sertopic_zero_samples (st, loan->m_samples, loan->m_size);
         buf[0] = NULL;
     }
 
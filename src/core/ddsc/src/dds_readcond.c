@@ -27,15 +27,33 @@ dds_readcond_delete(
     return DDS_RETCODE_OK;
 }
 
+static void
+eval_single_filter(
+    const void * const *samples,
+    bool *matches,
+    uint32_t count,
+    void *arg)
+{
+    /* Adapter so that all query conditions can be evaluated through the batch interface */
+    const dds_readcond *cond = arg;
+    for (uint32_t i = 0; i < count; i++) {
+        matches[i] = cond->m_query.m_filter(samples[i]);
+    }
+}
+
 dds_readcond*
 dds_create_readcond(
     dds_reader *rd,
     dds_entity_kind_t kind,
     uint32_t mask,
-    dds_querycondition_filter_fn filter)
+    dds_querycondition_filter_fn filter,
+    dds_querycondition_batch_filter_fn batch_filter,
+    void *batch_arg,
+    bool keyonly)
 {
     dds_readcond * cond = dds_alloc(sizeof(*cond));
-    assert((kind == DDS_KIND_COND_READ && filter == 0) || (kind == DDS_KIND_COND_QUERY && filter != 0));
+    assert((kind == DDS_KIND_COND_READ && filter == 0 && batch_filter == 0) ||
+           (kind == DDS_KIND_COND_QUERY && (filter != 0) != (batch_filter != 0)));
     (void) dds_entity_init(&cond->m_entity, (dds_entity*)rd, kind, NULL, NULL, 0);
     cond->m_entity.m_deriver.delete = dds_readcond_delete;
     cond->m_rhc = rd->m_rd->rhc;
@@ -45,6 +63,14 @@ dds_create_readcond(
     cond->m_rd_guid = rd->m_entity.m_guid;
     if (kind == DDS_KIND_COND_QUERY) {
         cond->m_query.m_filter = filter;
+        if (filter) {
+            cond->m_query.m_batch_filter = eval_single_filter;
+            cond->m_query.m_batch_arg = cond;
+        } else {
+            cond->m_query.m_batch_filter = batch_filter;
+            cond->m_query.m_batch_arg = batch_arg;
+        }
+        cond->m_query.m_keyonly = keyonly;
         cond->m_query.m_qcmask = 0;
     }
     if (!dds_rhc_add_readcondition (cond)) {
@@ -67,7 +93,7 @@ dds_create_readcondition(
 
     rc = dds_reader_lock(reader, &rd);
     if (rc == DDS_RETCODE_OK) {
-        dds_readcond *cond = dds_create_readcond(rd, DDS_KIND_COND_READ, mask, 0);
+        dds_readcond *cond = dds_create_readcond(rd, DDS_KIND_COND_READ, mask, 0, 0, NULL, false);
         assert(cond);
         assert(cond->m_entity.m_deriver.delete);
         hdl = cond->m_entity.m_hdllink.hdl;
@@ -10,6 +10,7 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include "dds/dds.h"
 #include "dds/version.h"
@@ -19,6 +20,7 @@
 #include "dds__qos.h"
 #include "dds__init.h"
 #include "dds__rhc.h"
+#include "dds__content_filter.h"
 #include "dds__err.h"
 #include "dds__topic.h"
 #include "dds/ddsi/q_entity.h"
@@ -26,6 +28,7 @@
 #include "dds/ddsi/q_globals.h"
 #include "dds__builtin.h"
 #include "dds/ddsi/ddsi_sertopic.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
 
 DECL_ENTITY_LOCK_UNLOCK(extern inline, dds_reader)
 
@@ -82,7 +85,14 @@ dds_reader_delete(
             ret = DDS_RETCODE_OK;
         }
     }
-    dds_free(rd->m_loan);
+    while (rd->m_loans) {
+        dds_loan *loan = rd->m_loans;
+        rd->m_loans = loan->m_next;
+        dds_arena_fini(&loan->m_arena);
+        dds_free(loan->m_samples);
+        dds_free(loan->m_ptrs);
+        dds_free(loan);
+    }
     return ret;
 }
 
@@ -154,25 +164,10 @@ dds_reader_status_validate(
                      DDS_RETCODE_OK;
 }
 
-void dds_reader_data_available_cb (struct dds_reader *rd)
+static void dds_reader_data_available_invoke (struct dds_reader *rd)
 {
-  /* DATA_AVAILABLE is special in two ways: firstly, it should first try
-     DATA_ON_READERS on the line of ancestors, and if not consumed set the
-     status on the subscriber; secondly it is the only one for which
-     overhead really matters.  Otherwise, it is pretty much like
-     dds_reader_status_cb. */
-
-  ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
-  if (!(rd->m_entity.m_status_enable & DDS_DATA_AVAILABLE_STATUS))
-  {
-    ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
-    return;
-  }
-
-  while (rd->m_entity.m_cb_count > 0)
-    ddsrt_cond_wait (&rd->m_entity.m_observers_cond, &rd->m_entity.m_observers_lock);
-  rd->m_entity.m_cb_count++;
-
+  /* Called with m_observers_lock held and, if there is a listener to
+     invoke, with a claim on m_cb_count */
   struct dds_listener const * const lst = &rd->m_entity.m_listener;
   dds_entity * const sub = rd->m_entity.m_parent;
   if (lst->on_data_on_readers)
@@ -207,6 +202,41 @@ void dds_reader_data_available_cb (struct dds_reader *rd)
     dds_entity_status_set (sub, DDS_DATA_ON_READERS_STATUS);
     ddsrt_mutex_unlock (&sub->m_observers_lock);
   }
+}
+
+void dds_reader_data_available_cb (struct dds_reader *rd)
+{
+  /* DATA_AVAILABLE is special in two ways: firstly, it should first try
+     DATA_ON_READERS on the line of ancestors, and if not consumed set the
+     status on the subscriber; secondly it is the only one for which
+     overhead really matters.  Otherwise, it is pretty much like
+     dds_reader_status_cb. */
+
+  ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
+  if (!(rd->m_entity.m_status_enable & DDS_DATA_AVAILABLE_STATUS))
+  {
+    ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
+    return;
+  }
+
+  if (dds_entity_listeners_async ())
+  {
+    /* Never run application code on the delivery thread, and merge
+       DATA_AVAILABLE events until the listener gets to run */
+    struct dds_listener const * const lst = &rd->m_entity.m_listener;
+    if (lst->on_data_on_readers || lst->on_data_available)
+      dds_entity_post_listener (&rd->m_entity, DDS_DATA_AVAILABLE_STATUS_ID);
+    else
+      dds_reader_data_available_invoke (rd);
+    ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
+    return;
+  }
+
+  while (rd->m_entity.m_cb_count > 0)
+    ddsrt_cond_wait (&rd->m_entity.m_observers_cond, &rd->m_entity.m_observers_lock);
+  rd->m_entity.m_cb_count++;
+
+  dds_reader_data_available_invoke (rd);
 
   rd->m_entity.m_cb_count--;
   ddsrt_cond_broadcast (&rd->m_entity.m_observers_cond);
@@ -242,11 +272,16 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
      can safely be incremented and/or reset while releasing
      m_observers_lock for the duration of the listener call itself,
      and that similarly the listener function and argument pointers
-     are stable */
+     are stable.  With asynchronous listeners, the serialization is
+     done by the job on the listener thread pool instead */
+  const bool async = dds_entity_listeners_async ();
   ddsrt_mutex_lock (&entity->m_observers_lock);
-  while (entity->m_cb_count > 0)
-    ddsrt_cond_wait (&entity->m_observers_cond, &entity->m_observers_lock);
-  entity->m_cb_count++;
+  if (!async)
+  {
+    while (entity->m_cb_count > 0)
+      ddsrt_cond_wait (&entity->m_observers_cond, &entity->m_observers_lock);
+    entity->m_cb_count++;
+  }
 
   /* Update status metrics. */
   dds_reader * const rd = (dds_reader *) entity;
@@ -333,7 +368,11 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
       assert (0);
   }
 
-  if (invoke)
+  if (invoke && async)
+  {
+    dds_entity_post_listener (entity, status_id);
+  }
+  else if (invoke)
   {
     ddsrt_mutex_unlock (&entity->m_observers_lock);
     dds_entity_invoke_listener(entity, status_id, vst);
@@ -347,18 +386,99 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
     dds_entity_status_set (entity, 1u << status_id);
   }
 
-  entity->m_cb_count--;
-  ddsrt_cond_broadcast (&entity->m_observers_cond);
+  if (!async)
+  {
+    entity->m_cb_count--;
+    ddsrt_cond_broadcast (&entity->m_observers_cond);
+  }
   ddsrt_mutex_unlock (&entity->m_observers_lock);
 }
 
-dds_entity_t
-dds_create_reader(
+static void dds_reader_deferred_listener (struct dds_entity *entity, enum dds_status_id status_id)
+{
+  /* Invoked on the listener thread pool with m_observers_lock held: the
+     listener gets a copy of the status, as the delivery threads continue
+     updating it while the listener runs */
+  dds_reader * const rd = (dds_reader *) entity;
+  struct dds_listener const * const lst = &entity->m_listener;
+  union {
+    dds_requested_deadline_missed_status_t requested_deadline_missed;
+    dds_requested_incompatible_qos_status_t requested_incompatible_qos;
+    dds_sample_lost_status_t sample_lost;
+    dds_sample_rejected_status_t sample_rejected;
+    dds_liveliness_changed_status_t liveliness_changed;
+    dds_subscription_matched_status_t subscription_matched;
+  } st;
+  bool invoke = false;
+
+  switch (status_id)
+  {
+    case DDS_DATA_AVAILABLE_STATUS_ID:
+      dds_reader_data_available_invoke (rd);
+      return;
+    case DDS_REQUESTED_DEADLINE_MISSED_STATUS_ID:
+      st.requested_deadline_missed = rd->m_requested_deadline_missed_status;
+      rd->m_requested_deadline_missed_status.total_count_change = 0;
+      invoke = (lst->on_requested_deadline_missed != 0);
+      break;
+    case DDS_REQUESTED_INCOMPATIBLE_QOS_STATUS_ID:
+      st.requested_incompatible_qos = rd->m_requested_incompatible_qos_status;
+      rd->m_requested_incompatible_qos_status.total_count_change = 0;
+      invoke = (lst->on_requested_incompatible_qos != 0);
+      break;
+    case DDS_SAMPLE_LOST_STATUS_ID:
+      st.sample_lost = rd->m_sample_lost_status;
+      rd->m_sample_lost_status.total_count_change = 0;
+      invoke = (lst->on_sample_lost != 0);
+      break;
+    case DDS_SAMPLE_REJECTED_STATUS_ID:
+      st.sample_rejected = rd->m_sample_rejected_status;
+      rd->m_sample_rejected_status.total_count_change = 0;
+      invoke = (lst->on_sample_rejected != 0);
+      break;
+    case DDS_LIVELINESS_CHANGED_STATUS_ID:
+      st.liveliness_changed = rd->m_liveliness_changed_status;
+      rd->m_liveliness_changed_status.alive_count_change = 0;
+      rd->m_liveliness_changed_status.not_alive_count_change = 0;
+      invoke = (lst->on_liveliness_changed != 0);
+      break;
+    case DDS_SUBSCRIPTION_MATCHED_STATUS_ID:
+      st.subscription_matched = rd->m_subscription_matched_status;
+      rd->m_subscription_matched_status.total_count_change = 0;
+      rd->m_subscription_matched_status.current_count_change = 0;
+      invoke = (lst->on_subscription_matched != 0);
+      break;
+    case DDS_DATA_ON_READERS_STATUS_ID:
+    case DDS_INCONSISTENT_TOPIC_STATUS_ID:
+    case DDS_LIVELINESS_LOST_STATUS_ID:
+    case DDS_PUBLICATION_MATCHED_STATUS_ID:
+    case DDS_OFFERED_DEADLINE_MISSED_STATUS_ID:
+    case DDS_OFFERED_INCOMPATIBLE_QOS_STATUS_ID:
+      assert (0);
+  }
+
+  /* The listener may have been reset by dds_delete in the meantime */
+  if (invoke)
+  {
+    ddsrt_mutex_unlock (&entity->m_observers_lock);
+    dds_entity_invoke_listener (entity, status_id, &st);
+    ddsrt_mutex_lock (&entity->m_observers_lock);
+  }
+  else
+  {
+    dds_entity_status_set (entity, 1u << status_id);
+  }
+}
+
+static dds_entity_t
+dds_create_reader_int(
     dds_entity_t participant_or_subscriber,
     dds_entity_t topic,
+    const nn_content_filter_property_t *filter,
     const dds_qos_t *qos,
     const dds_listener_t *listener)
 {
+    struct dds_content_filter *cf = NULL;
     dds_qos_t * rqos;
     dds_retcode_t rc;
     dds_subscriber * sub = NULL;
@@ -452,17 +572,34 @@ dds_create_reader(
         goto err_bad_qos;
     }
 
+    if (filter) {
+        cf = dds_content_filter_new (tp->m_stopic, filter->filter_class_name, filter->filter_expression,
+                                     filter->expression_parameters.n, (const char * const *) filter->expression_parameters.strs);
+        if (cf == NULL) {
+            dds_delete_qos(rqos);
+            DDS_ERROR("Unknown content filter class or invalid filter expression\n");
+            reader = DDS_ERRNO(DDS_RETCODE_BAD_PARAMETER);
+            goto err_bad_qos;
+        }
+    }
+
     /* Create reader and associated read cache */
     rd = dds_alloc (sizeof (*rd));
     reader = dds_entity_init (&rd->m_entity, &sub->m_entity, DDS_KIND_READER, rqos, listener, DDS_READER_STATUS_MASK);
     rd->m_sample_rejected_status.last_reason = DDS_NOT_REJECTED;
     rd->m_topic = tp;
+    /* only the default sample representation can deserialize into an arena */
+    rd->m_loan_arena = (tp->m_stopic->ops == &ddsi_sertopic_ops_default);
     rhc = dds_rhc_new (rd, tp->m_stopic);
+    if (cf) {
+        dds_rhc_set_content_filter (rhc, cf);
+    }
     dds_entity_add_ref_nolock (&tp->m_entity);
     rd->m_entity.m_deriver.close = dds_reader_close;
     rd->m_entity.m_deriver.delete = dds_reader_delete;
     rd->m_entity.m_deriver.set_qos = dds_reader_qos_set;
     rd->m_entity.m_deriver.validate_status = dds_reader_status_validate;
+    rd->m_entity.m_deriver.deferred_listener = dds_reader_deferred_listener;
     rd->m_entity.m_deriver.get_instance_hdl = dds_reader_instance_hdl;
 
     /* Extra claim of this reader to make sure that the delete waits until DDSI
@@ -474,7 +611,7 @@ dds_create_reader(
 
     thread_state_awake (lookup_thread_state ());
     ret = new_reader(&rd->m_rd, &rd->m_entity.m_guid, NULL, &sub->m_entity.m_participant->m_guid, tp->m_stopic,
-                     rqos, rhc, dds_reader_status_cb, rd);
+                     rqos, filter, rhc, dds_reader_status_cb, rd);
     ddsrt_mutex_lock(&sub->m_entity.m_mutex);
     ddsrt_mutex_lock(&tp->m_entity.m_mutex);
     assert (ret == DDS_RETCODE_OK);
@@ -511,6 +648,54 @@ err_sub_lock:
     return reader;
 }
 
+dds_entity_t
+dds_create_reader(
+    dds_entity_t participant_or_subscriber,
+    dds_entity_t topic,
+    const dds_qos_t *qos,
+    const dds_listener_t *listener)
+{
+    return dds_create_reader_int (participant_or_subscriber, topic, NULL, qos, listener);
+}
+
+dds_entity_t
+dds_create_filtered_reader(
+    dds_entity_t participant_or_subscriber,
+    dds_entity_t topic,
+    const char *filter_class,
+    const char *expression,
+    uint32_t nparams,
+    const char * const *params,
+    const dds_qos_t *qos,
+    const dds_listener_t *listener)
+{
+    nn_content_filter_property_t filter;
+    char topic_name[256], cft_name[256 + 16];
+    dds_return_t ret;
+
+    if (filter_class == NULL || expression == NULL || (nparams > 0 && params == NULL)) {
+        DDS_ERROR("Invalid content filter\n");
+        return DDS_ERRNO(DDS_RETCODE_BAD_PARAMETER);
+    }
+    if (topic >= DDS_BUILTIN_TOPIC_DCPSPARTICIPANT) {
+        DDS_ERROR("Content filters on built-in topics are not supported\n");
+        return DDS_ERRNO(DDS_RETCODE_BAD_PARAMETER);
+    }
+    if ((ret = dds_get_name (topic, topic_name, sizeof (topic_name))) < 0) {
+        return ret;
+    }
+    (void) snprintf (cft_name, sizeof (cft_name), "%s_filtered", topic_name);
+
+    /* Only aliases the arguments: new_reader makes a copy */
+    filter.content_filtered_topic_name = cft_name;
+    filter.related_topic_name = topic_name;
+    filter.filter_class_name = (char *) filter_class;
+    filter.filter_expression = (char *) expression;
+    filter.expression_parameters.n = nparams;
+    filter.expression_parameters.strs = (char **) params;
+    return dds_create_reader_int (participant_or_subscriber, topic, &filter, qos, listener);
+}
+
 void dds_reader_ddsi2direct (dds_entity_t entity, ddsi2direct_directread_cb_t cb, void *cbarg)
 {
   dds_entity *dds_entity;
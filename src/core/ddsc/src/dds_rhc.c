@@ -26,6 +26,8 @@
 #include "dds__entity.h"
 #include "dds__reader.h"
 #include "dds__rhc.h"
+#include "dds__content_filter.h"
+#include "dds__stream.h"
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsrt/hopscotch.h"
 #include "dds/ddsrt/avl.h"
@@ -225,6 +227,125 @@ void lwregs_dump (struct lwregs *rt)
     printf("iid=%"PRIu64" wr_iid=%"PRIu64"\n", r->iid, r->wr_iid);
 }
 
+/*************************
+ ******    POOLS    ******
+ *************************/
+
+/* Per-RHC slab allocators for samples and instances.  Every allocation and every free
+   (including those done by a take on an application thread) happens with the RHC lock
+   held, so a plain free list suffices.  Slabs are retained until the RHC is freed, the
+   memory use is therefore bounded by the peak number of samples/instances. */
+
+#define RHC_POOL_MIN_SLAB 16u
+#define RHC_POOL_MAX_SLAB 1024u
+#define RHC_POOL_MAX_LIMITED_SLAB 65536u
+
+union rhc_pool_slab {
+  struct {
+    union rhc_pool_slab *next;
+    uint32_t nelems;
+  } h;
+  /* elements follow the header, this ensures their alignment */
+  uint64_t align_u64;
+  void *align_ptr;
+};
+
+struct rhc_pool_elem {
+  struct rhc_pool_elem *next;
+};
+
+struct rhc_pool {
+  union rhc_pool_slab *slabs;
+  struct rhc_pool_elem *freelist;
+  char *bump;                        /* next never-used element in most recent slab */
+  uint32_t bump_left;                /* number of never-used elements left in it */
+  uint32_t elemsize;
+  uint32_t next_nelems;              /* size of the next slab */
+  bool limited;                      /* next_nelems derived from resource limits */
+  struct dds_rhc_pool_stats stats;
+};
+
+static void rhc_pool_init (struct rhc_pool *pool, size_t elemsize)
+{
+  memset (pool, 0, sizeof (*pool));
+  assert (elemsize >= sizeof (struct rhc_pool_elem));
+  pool->elemsize = (uint32_t) ((elemsize + sizeof (union rhc_pool_slab) - 1) & ~(sizeof (union rhc_pool_slab) - 1));
+  pool->next_nelems = RHC_POOL_MIN_SLAB;
+}
+
+static void rhc_pool_set_limit (struct rhc_pool *pool, int32_t limit)
+{
+  /* With a resource limit, a single slab that can hold everything is the obvious choice
+     (memory is only touched once it is used); without one, grow geometrically.  Only
+     possible as long as nothing has been allocated yet. */
+  if (pool->slabs != NULL)
+    return;
+  if (limit == DDS_LENGTH_UNLIMITED || limit <= 0)
+  {
+    pool->next_nelems = RHC_POOL_MIN_SLAB;
+    pool->limited = false;
+  }
+  else
+  {
+    pool->next_nelems = ((uint32_t) limit < RHC_POOL_MAX_LIMITED_SLAB) ? (uint32_t) limit : RHC_POOL_MAX_LIMITED_SLAB;
+    pool->limited = true;
+  }
+}
+
+static void rhc_pool_fini (struct rhc_pool *pool)
+{
+  union rhc_pool_slab *slab;
+  while ((slab = pool->slabs) != NULL)
+  {
+    pool->slabs = slab->h.next;
+    ddsrt_free (slab);
+  }
+}
+
+static void *rhc_pool_alloc (struct rhc_pool *pool)
+{
+  void *p;
+  if (pool->freelist)
+  {
+    struct rhc_pool_elem *e = pool->freelist;
+    pool->freelist = e->next;
+    p = e;
+  }
+  else
+  {
+    if (pool->bump_left == 0)
+    {
+      const uint32_t n = pool->next_nelems;
+      union rhc_pool_slab *slab = ddsrt_malloc (sizeof (*slab) + (size_t) n * pool->elemsize);
+      slab->h.next = pool->slabs;
+      slab->h.nelems = n;
+      pool->slabs = slab;
+      pool->bump = (char *) (slab + 1);
+      pool->bump_left = n;
+      pool->stats.nslabs++;
+      pool->stats.capacity += n;
+      if (!pool->limited && n < RHC_POOL_MAX_SLAB)
+        pool->next_nelems = 2 * n;
+    }
+    p = pool->bump;
+    pool->bump += pool->elemsize;
+    pool->bump_left--;
+  }
+  pool->stats.nallocs++;
+  if (++pool->stats.inuse > pool->stats.peak)
+    pool->stats.peak = pool->stats.inuse;
+  return p;
+}
+
+static void rhc_pool_free (struct rhc_pool *pool, void *p)
+{
+  struct rhc_pool_elem *e = p;
+  assert (pool->stats.inuse > 0);
+  e->next = pool->freelist;
+  pool->freelist = e;
+  pool->stats.inuse--;
+}
+
 /*************************
  ******     RHC     ******
  *************************/
@@ -304,7 +425,12 @@ struct rhc {
   uint32_t nconds;                   /* Number of associated read conditions */
   uint32_t nqconds;                  /* Number of associated query conditions */
   dds_querycond_mask_t qconds_samplest;  /* Mask of associated query conditions that check the sample state */
+  dds_querycond_mask_t qconds_keyonly;   /* Mask of associated query conditions that only look at the key */
   void *qcond_eval_samplebuf;        /* Temporary storage for evaluating query conditions, NULL if no qconds */
+  struct dds_content_filter *filter; /* Reader content filter, NULL if none */
+
+  struct rhc_pool sample_pool;       /* rhc_samples beyond the one embedded in each instance */
+  struct rhc_pool instance_pool;     /* rhc_instances */
 };
 
 struct trigger_info_cmn {
@@ -379,6 +505,28 @@ static void topicless_to_clean_invsample (const struct ddsi_sertopic *topic, con
   ddsi_serdata_topicless_to_sample (topic, d, sample, bufptr, buflim);
 }
 
+/* Loaned samples of topics using the default sample representation get
+   their strings and sequences from the loan's arena (see dds_read.c),
+   such samples are zero on entry and their contents must never be freed */
+static void to_sample_w_arena (const struct ddsi_serdata *d, void *sample, struct dds_arena *arena)
+{
+  if (arena == NULL)
+    ddsi_serdata_to_sample (d, sample, NULL, NULL);
+  else
+    dds_stream_serdata_to_sample_w_arena ((const struct ddsi_serdata_default *) d, (const struct ddsi_sertopic_default *) d->topic, sample, arena);
+}
+
+static void topicless_to_clean_invsample_w_arena (const struct ddsi_sertopic *topic, const struct ddsi_serdata *d, void *sample, struct dds_arena *arena)
+{
+  if (arena == NULL)
+    topicless_to_clean_invsample (topic, d, sample, NULL, NULL);
+  else
+  {
+    ddsi_sertopic_zero_sample (topic, sample);
+    dds_stream_serdata_to_sample_w_arena ((const struct ddsi_serdata_default *) d, (const struct ddsi_sertopic_default *) topic, sample, arena);
+  }
+}
+
 static unsigned qmask_of_inst (const struct rhc_instance *inst);
 static bool update_conditions_locked (struct rhc *rhc, bool called_from_insert, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc, const struct rhc_instance *inst);
 #ifndef NDEBUG
@@ -461,10 +609,19 @@ struct rhc * dds_rhc_new (dds_reader * reader, const struct ddsi_sertopic * topi
   rhc->instances = ddsrt_hh_new (1, instance_iid_hash, instance_iid_eq);
   rhc->topic = topic;
   rhc->reader = reader;
+  rhc_pool_init (&rhc->sample_pool, sizeof (struct rhc_sample));
+  rhc_pool_init (&rhc->instance_pool, sizeof (struct rhc_instance));
 
   return rhc;
 }
 
+void dds_rhc_set_content_filter (struct rhc *rhc, struct dds_content_filter *filter)
+{
+  /* Only before the reader is made known to DDSI, so no locking needed */
+  assert (rhc->filter == NULL);
+  rhc->filter = filter;
+}
+
 void dds_rhc_set_qos (struct rhc * rhc, const nn_xqos_t * qos)
 {
   /* Set read related QoS */
@@ -477,23 +634,113 @@ void dds_rhc_set_qos (struct rhc * rhc, const nn_xqos_t * qos)
   rhc->reliable = (qos->reliability.kind == NN_RELIABLE_RELIABILITY_QOS);
   assert(qos->history.kind != NN_KEEP_LAST_HISTORY_QOS || qos->history.depth > 0);
   rhc->history_depth = (qos->history.kind == NN_KEEP_LAST_HISTORY_QOS) ? (uint32_t)qos->history.depth : ~0u;
+  rhc_pool_set_limit (&rhc->sample_pool, rhc->max_samples);
+  rhc_pool_set_limit (&rhc->instance_pool, rhc->max_instances);
 }
 
-static bool eval_predicate_sample (const struct rhc *rhc, const struct ddsi_serdata *sample, bool (*pred) (const void *sample))
+static bool eval_qcond (const dds_readcond *cond, const void *sample)
 {
-  ddsi_serdata_to_sample (sample, rhc->qcond_eval_samplebuf, NULL, NULL);
-  bool ret = pred (rhc->qcond_eval_samplebuf);
-  return ret;
+  if (cond->m_query.m_filter)
+    return cond->m_query.m_filter (sample);
+  else
+  {
+    bool m;
+    cond->m_query.m_batch_filter (&sample, &m, 1, cond->m_query.m_batch_arg);
+    return m;
+  }
 }
 
-static bool eval_predicate_invsample (const struct rhc *rhc, const struct rhc_instance *inst, bool (*pred) (const void *sample))
+static dds_querycond_mask_t eval_qconds_sample (const struct rhc *rhc, const struct rhc_instance *inst, const struct ddsi_serdata *sample)
 {
+  /* Key-only conditions necessarily give the same result for the sample as for the
+     instance; the others share a single deserialisation of the sample */
+  dds_querycond_mask_t conds = inst->conds & rhc->qconds_keyonly;
+  bool deserialised = false;
+  for (const dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
+  {
+    if (rc->m_query.m_batch_filter == 0 || rc->m_query.m_keyonly)
+      continue;
+    if (!deserialised)
+    {
+      ddsi_serdata_to_sample (sample, rhc->qcond_eval_samplebuf, NULL, NULL);
+      deserialised = true;
+    }
+    if (eval_qcond (rc, rhc->qcond_eval_samplebuf))
+      conds |= rc->m_query.m_qcmask;
+  }
+  return conds;
+}
+
+static dds_querycond_mask_t eval_qconds_invsample (const struct rhc *rhc, const struct rhc_instance *inst)
+{
+  dds_querycond_mask_t conds = 0;
   topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, rhc->qcond_eval_samplebuf, NULL, NULL);
-  bool ret = pred (rhc->qcond_eval_samplebuf);
-  return ret;
+  for (const dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
+    if (rc->m_query.m_batch_filter != 0 && eval_qcond (rc, rhc->qcond_eval_samplebuf))
+      conds |= rc->m_query.m_qcmask;
+  return conds;
+}
+
+/* Evaluating a single query condition for many samples/instances at a time, used when
+   attaching a query condition to a reader with a non-empty history */
+
+#define QCOND_BATCH_SIZE 32
+
+struct qcond_batch {
+  const struct rhc *rhc;
+  const dds_readcond *cond;
+  uint32_t n, nbufs;
+  void *bufs[QCOND_BATCH_SIZE];
+  dds_querycond_mask_t *targets[QCOND_BATCH_SIZE];
+};
+
+static void qcond_batch_init (struct qcond_batch *b, const struct rhc *rhc, const dds_readcond *cond)
+{
+  b->rhc = rhc;
+  b->cond = cond;
+  b->n = b->nbufs = 0;
+}
+
+static void qcond_batch_flush (struct qcond_batch *b)
+{
+  const dds_querycond_mask_t qcmask = b->cond->m_query.m_qcmask;
+  bool matches[QCOND_BATCH_SIZE];
+  if (b->n == 0)
+    return;
+  b->cond->m_query.m_batch_filter ((const void * const *) b->bufs, matches, b->n, b->cond->m_query.m_batch_arg);
+  for (uint32_t i = 0; i < b->n; i++)
+    *b->targets[i] = (*b->targets[i] & ~qcmask) | (matches[i] ? qcmask : 0);
+  b->n = 0;
+}
+
+static void *qcond_batch_slot (struct qcond_batch *b, dds_querycond_mask_t *target)
+{
+  if (b->n == QCOND_BATCH_SIZE)
+    qcond_batch_flush (b);
+  if (b->n == b->nbufs)
+    b->bufs[b->nbufs++] = ddsi_sertopic_alloc_sample (b->rhc->topic);
+  b->targets[b->n] = target;
+  return b->bufs[b->n++];
+}
+
+static void qcond_batch_add_sample (struct qcond_batch *b, struct rhc_sample *sample)
+{
+  ddsi_serdata_to_sample (sample->sample, qcond_batch_slot (b, &sample->conds), NULL, NULL);
+}
+
+static void qcond_batch_add_invsample (struct qcond_batch *b, struct rhc_instance *inst)
+{
+  topicless_to_clean_invsample (b->rhc->topic, inst->tk->m_sample, qcond_batch_slot (b, &inst->conds), NULL, NULL);
+}
+
+static void qcond_batch_fini (struct qcond_batch *b)
+{
+  qcond_batch_flush (b);
+  for (uint32_t i = 0; i < b->nbufs; i++)
+    ddsi_sertopic_free_sample (b->rhc->topic, b->bufs[i], DDS_FREE_ALL);
 }
 
-static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
+static struct rhc_sample *alloc_sample (struct rhc *rhc, struct rhc_instance *inst)
 {
   if (inst->a_sample_free)
   {
@@ -505,14 +752,11 @@ static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
   }
   else
   {
-    /* This instead of sizeof(rhc_sample) gets us type checking */
-    struct rhc_sample *s;
-    s = ddsrt_malloc (sizeof (*s));
-    return s;
+    return rhc_pool_alloc (&rhc->sample_pool);
   }
 }
 
-static void free_sample (struct rhc_instance *inst, struct rhc_sample *s)
+static void free_sample (struct rhc *rhc, struct rhc_instance *inst, struct rhc_sample *s)
 {
   ddsi_serdata_unref (s->sample);
   if (s == &inst->a_sample)
@@ -525,7 +769,7 @@ static void free_sample (struct rhc_instance *inst, struct rhc_sample *s)
   }
   else
   {
-    ddsrt_free (s);
+    rhc_pool_free (&rhc->sample_pool, s);
   }
 }
 
@@ -564,11 +808,11 @@ static void inst_set_invsample (struct rhc *rhc, struct rhc_instance *inst, stru
   }
 }
 
-static void free_empty_instance (struct rhc_instance *inst)
+static void free_empty_instance (struct rhc *rhc, struct rhc_instance *inst)
 {
   assert (inst_is_empty (inst));
   ddsi_tkmap_instance_unref (inst->tk);
-  ddsrt_free (inst);
+  rhc_pool_free (&rhc->instance_pool, inst);
 }
 
 static void free_instance_rhc_free (struct rhc_instance *inst, struct rhc *rhc)
@@ -580,7 +824,7 @@ static void free_instance_rhc_free (struct rhc_instance *inst, struct rhc *rhc)
   {
     do {
       struct rhc_sample * const s1 = s->next;
-      free_sample (inst, s);
+      free_sample (rhc, inst, s);
       s = s1;
     } while (s != inst->latest);
     rhc->n_vsamples -= inst->nvsamples;
@@ -597,7 +841,7 @@ static void free_instance_rhc_free (struct rhc_instance *inst, struct rhc *rhc)
     remove_inst_from_nonempty_list (rhc, inst);
   }
   ddsi_tkmap_instance_unref (inst->tk);
-  ddsrt_free (inst);
+  rhc_pool_free (&rhc->instance_pool, inst);
 }
 
 uint32_t dds_rhc_lock_samples (struct rhc *rhc)
@@ -626,10 +870,27 @@ void dds_rhc_free (struct rhc *rhc)
   lwregs_fini (&rhc->registrations);
   if (rhc->qcond_eval_samplebuf != NULL)
     ddsi_sertopic_free_sample (rhc->topic, rhc->qcond_eval_samplebuf, DDS_FREE_ALL);
+  if (rhc->filter != NULL)
+    dds_content_filter_free (rhc->filter);
+  TRACE ("rhc_free(%p) sample pool: allocs %"PRIu64" slabs %"PRIu32" capacity %"PRIu32" peak %"PRIu32"; instance pool: allocs %"PRIu64" slabs %"PRIu32" capacity %"PRIu32" peak %"PRIu32"\n",
+         (void *) rhc, rhc->sample_pool.stats.nallocs, rhc->sample_pool.stats.nslabs, rhc->sample_pool.stats.capacity, rhc->sample_pool.stats.peak,
+         rhc->instance_pool.stats.nallocs, rhc->instance_pool.stats.nslabs, rhc->instance_pool.stats.capacity, rhc->instance_pool.stats.peak);
+  rhc_pool_fini (&rhc->sample_pool);
+  rhc_pool_fini (&rhc->instance_pool);
   ddsrt_mutex_destroy (&rhc->lock);
   ddsrt_free (rhc);
 }
 
+void dds_rhc_get_pool_stats (struct rhc *rhc, struct dds_rhc_pool_stats *samples, struct dds_rhc_pool_stats *instances)
+{
+  ddsrt_mutex_lock (&rhc->lock);
+  if (samples)
+    *samples = rhc->sample_pool.stats;
+  if (instances)
+    *instances = rhc->instance_pool.stats;
+  ddsrt_mutex_unlock (&rhc->lock);
+}
+
 static void init_trigger_info_cmn_nonmatch (struct trigger_info_cmn *info)
 {
   info->qminst = ~0u;
@@ -734,7 +995,7 @@ static bool add_sample (struct rhc *rhc, struct rhc_instance *inst, const struct
 
     /* add new latest sample */
 
-    s = alloc_sample (inst);
+    s = alloc_sample (rhc, inst);
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
     if (inst->latest == NULL)
     {
@@ -755,28 +1016,26 @@ static bool add_sample (struct rhc *rhc, struct rhc_instance *inst, const struct
   s->disposed_gen = inst->disposed_gen;
   s->no_writers_gen = inst->no_writers_gen;
 
-  s->conds = 0;
-  if (rhc->nqconds != 0)
-  {
-    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
-      if (rc->m_query.m_filter != 0 && eval_predicate_sample (rhc, s->sample, rc->m_query.m_filter))
-        s->conds |= rc->m_query.m_qcmask;
-  }
+  s->conds = (rhc->nqconds == 0) ? 0 : eval_qconds_sample (rhc, inst, s->sample);
 
   trig_qc->inc_conds_sample = s->conds;
   inst->latest = s;
   return true;
 }
 
-static bool content_filter_accepts (const struct ddsi_sertopic *sertopic, const struct ddsi_serdata *sample)
+static bool content_filter_accepts (const struct rhc *rhc, const struct ddsi_serdata *sample)
 {
   bool ret = true;
+  const struct ddsi_sertopic *sertopic = rhc->topic;
   const struct dds_topic *tp = sertopic->status_cb_entity;
-  if (tp->filter_fn)
+  if (tp->filter_fn || rhc->filter)
   {
     char *tmp = ddsi_sertopic_alloc_sample (sertopic);
     ddsi_serdata_to_sample (sample, tmp, NULL, NULL);
-    ret = (tp->filter_fn) (tmp, tp->filter_ctx);
+    if (tp->filter_fn)
+      ret = (tp->filter_fn) (tmp, tp->filter_ctx);
+    if (ret && rhc->filter)
+      ret = dds_content_filter_accepts_sample (rhc->filter, tmp);
     ddsi_sertopic_free_sample (sertopic, tmp, DDS_FREE_ALL);
   }
   return ret;
@@ -821,7 +1080,7 @@ static int inst_accepts_sample (const struct rhc *rhc, const struct rhc_instance
       return 0;
     }
   }
-  if (has_data && !content_filter_accepts (rhc->topic, sample))
+  if (has_data && !content_filter_accepts (rhc, sample))
   {
     return 0;
   }
@@ -852,7 +1111,7 @@ static void drop_instance_noupdate_no_writers (struct rhc *rhc, struct rhc_insta
   assert (ret);
   (void) ret;
 
-  free_empty_instance (inst);
+  free_empty_instance (rhc, inst);
 }
 
 static void dds_rhc_register (struct rhc *rhc, struct rhc_instance *inst, uint64_t wr_iid, bool iid_update)
@@ -1111,12 +1370,12 @@ static bool dds_rhc_unregister (struct rhc *rhc, struct rhc_instance *inst, cons
   return notify_data_available;
 }
 
-static struct rhc_instance *alloc_new_instance (const struct rhc *rhc, const struct proxy_writer_info *pwr_info, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+static struct rhc_instance *alloc_new_instance (struct rhc *rhc, const struct proxy_writer_info *pwr_info, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
   struct rhc_instance *inst;
 
   ddsi_tkmap_instance_ref (tk);
-  inst = ddsrt_malloc (sizeof (*inst));
+  inst = rhc_pool_alloc (&rhc->instance_pool);
   memset (inst, 0, sizeof (*inst));
   inst->iid = tk->m_iid;
   inst->tk = tk;
@@ -1132,15 +1391,7 @@ static struct rhc_instance *alloc_new_instance (const struct rhc *rhc, const str
   inst->strength = pwr_info->ownership_strength;
 
   if (rhc->nqconds != 0)
-  {
-    for (dds_readcond *c = rhc->conds; c != NULL; c = c->m_next)
-    {
-      assert ((dds_entity_kind (&c->m_entity) == DDS_KIND_COND_READ && c->m_query.m_filter == 0) ||
-              (dds_entity_kind (&c->m_entity) == DDS_KIND_COND_QUERY && c->m_query.m_filter != 0));
-      if (c->m_query.m_filter && eval_predicate_invsample (rhc, inst, c->m_query.m_filter))
-        inst->conds |= c->m_query.m_qcmask;
-    }
-  }
+    inst->conds = eval_qconds_invsample (rhc, inst);
 
   return inst;
 }
@@ -1165,7 +1416,7 @@ static rhc_store_result_t rhc_store_new_instance (struct rhc_instance **out_inst
      attribute (rather than a key), an empty instance should be
      instantiated. */
 
-  if (has_data && !content_filter_accepts (rhc->topic, sample))
+  if (has_data && !content_filter_accepts (rhc, sample))
   {
     return RHC_FILTERED;
   }
@@ -1185,7 +1436,7 @@ static rhc_store_result_t rhc_store_new_instance (struct rhc_instance **out_inst
   {
     if (!add_sample (rhc, inst, pwr_info, sample, cb_data, trig_qc))
     {
-      free_empty_instance (inst);
+      free_empty_instance (rhc, inst);
       return RHC_REJECTED;
     }
   }
@@ -1209,11 +1460,13 @@ static rhc_store_result_t rhc_store_new_instance (struct rhc_instance **out_inst
 }
 
 /*
-  dds_rhc_store: DDSI up call into read cache to store new sample. Returns whether sample
-  delivered (true unless a reliable sample rejected).
+  rhc_store_locked: stores a sample with rhc->lock held.  Returns whether sample delivered
+  (true unless a reliable sample rejected); data available notifications and waitset
+  triggers are accumulated in *notify_data_available and *trigger_waitsets, a status
+  callback to be made after unlocking is returned in *cb_data.
 */
 
-bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+static bool rhc_store_locked (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk, bool *notify_data_available_out, bool *trigger_waitsets_out, status_cb_data_t *cb_data)
 {
   const uint64_t wr_iid = pwr_info->iid;
   const unsigned statusinfo = sample->statusinfo;
@@ -1224,9 +1477,7 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
   struct trigger_info_pre pre;
   struct trigger_info_post post;
   struct trigger_info_qcond trig_qc;
-  bool trigger_waitsets;
   rhc_store_result_t stored;
-  status_cb_data_t cb_data;   /* Callback data for reader status callback */
   bool delivered = true;
   bool notify_data_available = false;
 
@@ -1242,12 +1493,9 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
 
   dummy_instance.iid = tk->m_iid;
   stored = RHC_FILTERED;
-  cb_data.raw_status_id = -1;
 
   init_trigger_info_qcond (&trig_qc);
 
-  ddsrt_mutex_lock (&rhc->lock);
-
   inst = ddsrt_hh_lookup (rhc->instances, &dummy_instance);
   if (inst == NULL)
   {
@@ -1263,7 +1511,7 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
     else
     {
       TRACE (" new instance");
-      stored = rhc_store_new_instance (&inst, rhc, pwr_info, sample, tk, has_data, &cb_data, &post, &trig_qc);
+      stored = rhc_store_new_instance (&inst, rhc, pwr_info, sample, tk, has_data, cb_data, &post, &trig_qc);
       if (stored != RHC_STORED)
       {
         goto error_or_nochange;
@@ -1297,10 +1545,10 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
     }
     /* notify sample lost */
 
-    cb_data.raw_status_id = (int) DDS_SAMPLE_LOST_STATUS_ID;
-    cb_data.extra = 0;
-    cb_data.handle = 0;
-    cb_data.add = true;
+    cb_data->raw_status_id = (int) DDS_SAMPLE_LOST_STATUS_ID;
+    cb_data->extra = 0;
+    cb_data->handle = 0;
+    cb_data->add = true;
     goto error_or_nochange;
 
     /* FIXME: deadline (and other) QoS? */
@@ -1366,7 +1614,7 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
       if (has_data)
       {
         TRACE (" add_sample");
-        if (!add_sample (rhc, inst, pwr_info, sample, &cb_data, &trig_qc))
+        if (!add_sample (rhc, inst, pwr_info, sample, cb_data, &trig_qc))
         {
           TRACE ("(reject)");
           stored = RHC_REJECTED;
@@ -1439,12 +1687,27 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
 
   TRACE (")\n");
 
-  trigger_waitsets = trigger_info_differs (rhc, &pre, &post, &trig_qc) && update_conditions_locked (rhc, true, &pre, &post, &trig_qc, inst);
+  if (trigger_info_differs (rhc, &pre, &post, &trig_qc) && update_conditions_locked (rhc, true, &pre, &post, &trig_qc, inst))
+    *trigger_waitsets_out = true;
+  if (notify_data_available)
+    *notify_data_available_out = true;
 
   assert (rhc_check_counts_locked (rhc, true, true));
+  return delivered;
 
-  ddsrt_mutex_unlock (&rhc->lock);
+error_or_nochange:
+
+  if (rhc->reliable && (stored == RHC_REJECTED))
+  {
+    delivered = false;
+  }
 
+  TRACE (")\n");
+  return delivered;
+}
+
+static void rhc_store_notify (struct rhc * __restrict rhc, bool notify_data_available, bool trigger_waitsets)
+{
   if (rhc->reader)
   {
     if (notify_data_available)
@@ -1452,26 +1715,69 @@ bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info
     if (trigger_waitsets)
       dds_entity_status_signal (&rhc->reader->m_entity);
   }
+}
 
-  return delivered;
-
-error_or_nochange:
+/*
+  dds_rhc_store: DDSI up call into read cache to store new sample. Returns whether sample
+  delivered (true unless a reliable sample rejected).
+*/
 
-  if (rhc->reliable && (stored == RHC_REJECTED))
-  {
-    delivered = false;
-  }
+bool dds_rhc_store (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+{
+  status_cb_data_t cb_data;   /* Callback data for reader status callback */
+  bool notify_data_available = false;
+  bool trigger_waitsets = false;
+  bool delivered;
 
+  cb_data.raw_status_id = -1;
+  ddsrt_mutex_lock (&rhc->lock);
+  delivered = rhc_store_locked (rhc, pwr_info, sample, tk, &notify_data_available, &trigger_waitsets, &cb_data);
   ddsrt_mutex_unlock (&rhc->lock);
-  TRACE (")\n");
 
   /* Make any reader status callback */
-
   if (cb_data.raw_status_id >= 0 && rhc->reader)
     dds_reader_status_cb (&rhc->reader->m_entity, &cb_data);
+  rhc_store_notify (rhc, notify_data_available, trigger_waitsets);
   return delivered;
 }
 
+/*
+  dds_rhc_store_set: DDSI up call into read cache to store a coherent set of samples
+  from a single writer.  All samples are stored while holding the lock, so a reader
+  never observes a partial set, and the reader gets notified only once.  Stops at the
+  first rejected sample and returns the number of samples delivered, the caller may
+  retry delivering the remainder.
+*/
+
+uint32_t dds_rhc_store_set (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info, uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks)
+{
+  status_cb_data_t cb_data;
+  bool notify_data_available = false;
+  bool trigger_waitsets = false;
+  uint32_t i;
+
+  TRACE ("rhc_store_set(%"PRIx64" n %"PRIu32")\n", pwr_info->iid, n);
+  ddsrt_mutex_lock (&rhc->lock);
+  for (i = 0; i < n; i++)
+  {
+    cb_data.raw_status_id = -1;
+    const bool delivered = rhc_store_locked (rhc, pwr_info, samples[i], tks[i], &notify_data_available, &trigger_waitsets, &cb_data);
+    if (cb_data.raw_status_id >= 0 && rhc->reader)
+    {
+      /* Status callbacks are rare (only for lost or rejected samples) and
+         may not be invoked while holding the lock */
+      ddsrt_mutex_unlock (&rhc->lock);
+      dds_reader_status_cb (&rhc->reader->m_entity, &cb_data);
+      ddsrt_mutex_lock (&rhc->lock);
+    }
+    if (!delivered)
+      break;
+  }
+  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_store_notify (rhc, notify_data_available, trigger_waitsets);
+  return i;
+}
+
 void dds_rhc_unregister_wr (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info)
 {
   /* Only to be called when writer with ID WR_IID has died.
@@ -1747,7 +2053,7 @@ static bool take_sample_update_conditions (struct rhc *rhc, struct trigger_info_
   return trigger_waitsets;
 }
 
-static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, unsigned qminv, dds_instance_handle_t handle, dds_readcond *cond)
+static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, unsigned qminv, dds_instance_handle_t handle, dds_readcond *cond, struct dds_arena *arena)
 {
   bool trigger_waitsets = false;
   uint32_t n = 0;
@@ -1765,7 +2071,7 @@ static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
 
   if (rhc->nonempty_instances)
   {
-    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
+    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_batch_filter) ? cond->m_query.m_qcmask : 0;
     struct rhc_instance * inst = rhc->nonempty_instances->next;
     struct rhc_instance * const end = inst;
     do
@@ -1792,7 +2098,7 @@ static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
               {
                 /* sample state matches too */
                 set_sample_info (info_seq + n, inst, sample);
-                ddsi_serdata_to_sample (sample->sample, values[n], 0, 0);
+                to_sample_w_arena (sample->sample, values[n], arena);
                 if (!sample->isread)
                 {
                   TRACE ("s");
@@ -1815,7 +2121,7 @@ static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
           if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask)))
           {
             set_sample_info_invsample (info_seq + n, inst);
-            topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, values[n], 0, 0);
+            topicless_to_clean_invsample_w_arena (rhc->topic, inst->tk->m_sample, values[n], arena);
             if (!inst->inv_isread)
             {
               TRACE ("i");
@@ -1869,7 +2175,7 @@ static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
   return (int)n;
 }
 
-static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, unsigned qminv, dds_instance_handle_t handle, dds_readcond *cond)
+static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, unsigned qminv, dds_instance_handle_t handle, dds_readcond *cond, struct dds_arena *arena)
 {
   bool trigger_waitsets = false;
   uint64_t iid;
@@ -1888,7 +2194,7 @@ static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
 
   if (rhc->nonempty_instances)
   {
-    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
+    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_batch_filter) ? cond->m_query.m_qcmask : 0;
     struct rhc_instance *inst = rhc->nonempty_instances->next;
     unsigned n_insts = rhc->n_nonempty_instances;
     while (n_insts-- > 0 && n < max_samples)
@@ -1926,7 +2232,7 @@ static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
                   trigger_waitsets = true;
 
                 set_sample_info (info_seq + n, inst, sample);
-                ddsi_serdata_to_sample (sample->sample, values[n], 0, 0);
+                to_sample_w_arena (sample->sample, values[n], arena);
                 rhc->n_vsamples--;
                 if (sample->isread)
                 {
@@ -1945,7 +2251,7 @@ static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
                   inst->latest = NULL;
                 }
 
-                free_sample (inst, sample);
+                free_sample (rhc, inst, sample);
 
                 if (++n == max_samples)
                 {
@@ -1965,7 +2271,7 @@ static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
             if (take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, inst->conds, inst->inv_isread))
               trigger_waitsets = true;
             set_sample_info_invsample (info_seq + n, inst);
-            topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, values[n], 0, 0);
+            topicless_to_clean_invsample_w_arena (rhc->topic, inst->tk->m_sample, values[n], arena);
             inst_clear_invsample (rhc, inst, &dummy_trig_qc);
             ++n;
           }
@@ -2051,7 +2357,7 @@ static int dds_rhc_takecdr_w_qminv (struct rhc *rhc, bool lock, struct ddsi_serd
 
   if (rhc->nonempty_instances)
   {
-    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
+    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_batch_filter) ? cond->m_query.m_qcmask : 0;
     struct rhc_instance *inst = rhc->nonempty_instances->next;
     unsigned n_insts = rhc->n_nonempty_instances;
     while (n_insts-- > 0 && n < max_samples)
@@ -2101,7 +2407,7 @@ static int dds_rhc_takecdr_w_qminv (struct rhc *rhc, bool lock, struct ddsi_serd
                 else
                   inst->latest = NULL;
 
-                free_sample (inst, sample);
+                free_sample (rhc, inst, sample);
 
                 if (++n == max_samples)
                 {
@@ -2236,8 +2542,8 @@ bool dds_rhc_add_readcondition (dds_readcond *cond)
   struct rhc *rhc = cond->m_rhc;
   struct ddsrt_hh_iter it;
 
-  assert ((dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_READ && cond->m_query.m_filter == 0) ||
-          (dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_QUERY && cond->m_query.m_filter != 0));
+  assert ((dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_READ && cond->m_query.m_batch_filter == 0) ||
+          (dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_QUERY && cond->m_query.m_batch_filter != 0));
   assert (cond->m_entity.m_trigger == 0);
   assert (cond->m_query.m_qcmask == 0);
 
@@ -2246,12 +2552,12 @@ bool dds_rhc_add_readcondition (dds_readcond *cond)
   ddsrt_mutex_lock (&rhc->lock);
 
   /* Allocate a slot in the condition bitmasks; return an error no more slots are available */
-  if (cond->m_query.m_filter != 0)
+  if (cond->m_query.m_batch_filter != 0)
   {
     dds_querycond_mask_t avail_qcmask = ~(dds_querycond_mask_t)0;
     for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
     {
-      assert ((rc->m_query.m_filter == 0 && rc->m_query.m_qcmask == 0) || (rc->m_query.m_filter != 0 && rc->m_query.m_qcmask != 0));
+      assert ((rc->m_query.m_batch_filter == 0 && rc->m_query.m_qcmask == 0) || (rc->m_query.m_batch_filter != 0 && rc->m_query.m_qcmask != 0));
       avail_qcmask &= ~rc->m_query.m_qcmask;
     }
     if (avail_qcmask == 0)
@@ -2269,7 +2575,7 @@ bool dds_rhc_add_readcondition (dds_readcond *cond)
   cond->m_next = rhc->conds;
   rhc->conds = cond;
 
-  if (cond->m_query.m_filter == 0)
+  if (cond->m_query.m_batch_filter == 0)
   {
     /* Read condition is not cached inside the instances and samples, so it only needs
        to be evaluated on the non-empty instances */
@@ -2293,28 +2599,48 @@ bool dds_rhc_add_readcondition (dds_readcond *cond)
     }
 
     /* Attaching a query condition means clearing the allocated bit in all instances and
-       samples, except for those that match the predicate. */
+       samples, except for those that match the predicate.  For a key-only condition, the
+       samples simply inherit the result of their instance. */
     const dds_querycond_mask_t qcmask = cond->m_query.m_qcmask;
+    struct qcond_batch batch;
     uint32_t trigger = 0;
+    if (cond->m_query.m_keyonly)
+      rhc->qconds_keyonly |= qcmask;
+    qcond_batch_init (&batch, rhc, cond);
+    for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
+      qcond_batch_add_invsample (&batch, inst);
+    qcond_batch_flush (&batch);
     for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
     {
-      const bool instmatch = eval_predicate_invsample (rhc, inst, cond->m_query.m_filter);;
-      uint32_t matches = 0;
-
-      inst->conds = (inst->conds & ~qcmask) | (instmatch ? qcmask : 0);
       if (inst->latest)
       {
         struct rhc_sample *sample = inst->latest->next, * const end = sample;
         do {
-          const bool m = eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter);
-          sample->conds = (sample->conds & ~qcmask) | (m ? qcmask : 0);
-          matches += m;
+          if (cond->m_query.m_keyonly)
+            sample->conds = (sample->conds & ~qcmask) | (inst->conds & qcmask);
+          else
+            qcond_batch_add_sample (&batch, sample);
           sample = sample->next;
         } while (sample != end);
       }
+    }
+    qcond_batch_fini (&batch);
 
+    for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
+    {
       if (!inst_is_empty (inst) && rhc_get_cond_trigger (inst, cond))
-        trigger += (inst->inv_exists ? instmatch : 0) + matches;
+      {
+        if (inst->inv_exists && (inst->conds & qcmask))
+          trigger++;
+        if (inst->latest)
+        {
+          struct rhc_sample *sample = inst->latest->next, * const end = sample;
+          do {
+            trigger += (sample->conds & qcmask) != 0;
+            sample = sample->next;
+          } while (sample != end);
+        }
+      }
     }
     cond->m_entity.m_trigger = trigger;
   }
@@ -2340,10 +2666,11 @@ void dds_rhc_remove_readcondition (dds_readcond *cond)
     ptr = &(*ptr)->m_next;
   *ptr = (*ptr)->m_next;
   rhc->nconds--;
-  if (cond->m_query.m_filter)
+  if (cond->m_query.m_batch_filter)
   {
     rhc->nqconds--;
     rhc->qconds_samplest &= ~cond->m_query.m_qcmask;
+    rhc->qconds_keyonly &= ~cond->m_query.m_qcmask;
     cond->m_query.m_qcmask = 0;
     if (rhc->nqconds == 0)
     {
@@ -2408,7 +2735,7 @@ static bool update_conditions_locked (struct rhc *rhc, bool called_from_insert,
     }
 
     TRACE ("  cond %p %08"PRIx32": ", (void *) iter, iter->m_query.m_qcmask);
-    if (iter->m_query.m_filter == 0)
+    if (iter->m_query.m_batch_filter == 0)
     {
       assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_READ);
       if (m_pre == m_post)
@@ -2563,10 +2890,11 @@ dds_rhc_read(
         uint32_t max_samples,
         uint32_t mask,
         dds_instance_handle_t handle,
-        dds_readcond *cond)
+        dds_readcond *cond,
+        struct dds_arena *arena)
 {
     unsigned qminv = qmask_from_mask_n_cond(mask, cond);
-    return dds_rhc_read_w_qminv(rhc, lock, values, info_seq, max_samples, qminv, handle, cond);
+    return dds_rhc_read_w_qminv(rhc, lock, values, info_seq, max_samples, qminv, handle, cond, arena);
 }
 
 int
@@ -2578,10 +2906,11 @@ dds_rhc_take(
         uint32_t max_samples,
         uint32_t mask,
         dds_instance_handle_t handle,
-        dds_readcond *cond)
+        dds_readcond *cond,
+        struct dds_arena *arena)
 {
     unsigned qminv = qmask_from_mask_n_cond(mask, cond);
-    return dds_rhc_take_w_qminv(rhc, lock, values, info_seq, max_samples, qminv, handle, cond);
+    return dds_rhc_take_w_qminv(rhc, lock, values, info_seq, max_samples, qminv, handle, cond, arena);
 }
 
 int dds_rhc_takecdr
@@ -2621,9 +2950,9 @@ static int rhc_check_counts_locked (struct rhc *rhc, bool check_conds, bool chec
 
   for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
   {
-    assert ((dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_READ && rciter->m_query.m_filter == 0) ||
-            (dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_QUERY && rciter->m_query.m_filter != 0));
-    assert ((rciter->m_query.m_filter != 0) == (rciter->m_query.m_qcmask != 0));
+    assert ((dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_READ && rciter->m_query.m_batch_filter == 0) ||
+            (dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_QUERY && rciter->m_query.m_batch_filter != 0));
+    assert ((rciter->m_query.m_batch_filter != 0) == (rciter->m_query.m_qcmask != 0));
     assert (!(enabled_qcmask & rciter->m_query.m_qcmask));
     enabled_qcmask |= rciter->m_query.m_qcmask;
   }
@@ -2680,11 +3009,7 @@ static int rhc_check_counts_locked (struct rhc *rhc, bool check_conds, bool chec
       if (check_qcmask && rhc->nqconds > 0)
       {
         dds_querycond_mask_t qcmask;
-        topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, rhc->qcond_eval_samplebuf, 0, 0);
-        qcmask = 0;
-        for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-          if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
-            qcmask |= rciter->m_query.m_qcmask;
+        qcmask = eval_qconds_invsample (rhc, inst);
         assert ((inst->conds & enabled_qcmask) == qcmask);
         if (inst->latest)
         {
@@ -2693,7 +3018,7 @@ static int rhc_check_counts_locked (struct rhc *rhc, bool check_conds, bool chec
             ddsi_serdata_to_sample (sample->sample, rhc->qcond_eval_samplebuf, NULL, NULL);
             qcmask = 0;
             for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-              if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
+              if (rciter->m_query.m_batch_filter != 0 && eval_qcond (rciter, rhc->qcond_eval_samplebuf))
                 qcmask |= rciter->m_query.m_qcmask;
             assert ((sample->conds & enabled_qcmask) == qcmask);
             sample = sample->next;
@@ -2705,7 +3030,7 @@ static int rhc_check_counts_locked (struct rhc *rhc, bool check_conds, bool chec
       {
         if (!rhc_get_cond_trigger (inst, rciter))
           ;
-        else if (rciter->m_query.m_filter == 0)
+        else if (rciter->m_query.m_batch_filter == 0)
           cond_match_count[i]++;
         else
         {
@@ -19,6 +19,7 @@
 #include "dds__stream.h"
 #include "dds__key.h"
 #include "dds__alloc.h"
+#include "dds__arena.h"
 
 //#define OP_DEBUG_READ 1
 //#define OP_DEBUG_WRITE 1
@@ -41,7 +42,7 @@ static const char * stream_op_type[11] =
 const uint32_t dds_op_size[5] = { 0, 1u, 2u, 4u, 8u };
 
 static void dds_stream_write (dds_stream_t * os, const char * data, const uint32_t * ops);
-static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * ops);
+static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * ops, struct dds_arena * arena);
 
 #define DDS_SWAP16(v) \
   ((uint16_t)(((v) >> 8) | ((v) << 8)))
@@ -321,10 +322,65 @@ char * dds_stream_read_string (dds_stream_t * is)
   return dds_stream_reuse_string (is, NULL, 0);
 }
 
-void dds_stream_swap (void * buff, uint32_t size, uint32_t num)
+/* Byte swapping of arrays of primitives: big-endian peers sending large
+   sequences of floats/doubles to little-endian readers (and vice versa) end
+   up here for every sample, so on x86 with GCC/Clang a shuffle-based
+   implementation using SSSE3 or AVX2 is used when the CPU supports it. The
+   choice is made once per array (i.e., once per sample for the typical
+   case), the scalar code handles the tail and all other platforms. */
+#if (defined __GNUC__ || defined __clang__) && (defined __x86_64__ || defined __i386__)
+#define DDS_STREAM_SWAP_X86 1
+#include <immintrin.h>
+
+static const int8_t dds_stream_swap_shuffle[3][16] = {
+  { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+  { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+  { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 }
+};
+
+static uint32_t dds_stream_swap_shuffle_idx (uint32_t size)
 {
-  assert (size == 2 || size == 4 || size == 8);
+  return (size == 2) ? 0 : (size == 4) ? 1 : 2;
+}
+
+__attribute__ ((target ("ssse3")))
+static size_t dds_stream_swap_ssse3 (uint8_t * ptr, size_t nbytes, uint32_t size)
+{
+  const __m128i mask = _mm_loadu_si128 ((const __m128i *) dds_stream_swap_shuffle[dds_stream_swap_shuffle_idx (size)]);
+  size_t i;
+  for (i = 0; i + 16 <= nbytes; i += 16)
+  {
+    __m128i x = _mm_loadu_si128 ((const __m128i *) (ptr + i));
+    _mm_storeu_si128 ((__m128i *) (ptr + i), _mm_shuffle_epi8 (x, mask));
+  }
+  return i;
+}
 
+__attribute__ ((target ("avx2")))
+static size_t dds_stream_swap_avx2 (uint8_t * ptr, size_t nbytes, uint32_t size)
+{
+  /* _mm256_shuffle_epi8 shuffles within each 128-bit lane, so the same
+     16-byte pattern is used for both lanes */
+  const __m128i mask128 = _mm_loadu_si128 ((const __m128i *) dds_stream_swap_shuffle[dds_stream_swap_shuffle_idx (size)]);
+  const __m256i mask = _mm256_broadcastsi128_si256 (mask128);
+  size_t i;
+  for (i = 0; i + 32 <= nbytes; i += 32)
+  {
+    __m256i x = _mm256_loadu_si256 ((const __m256i *) (ptr + i));
+    _mm256_storeu_si256 ((__m256i *) (ptr + i), _mm256_shuffle_epi8 (x, mask));
+  }
+  if (i + 16 <= nbytes)
+  {
+    __m128i x = _mm_loadu_si128 ((const __m128i *) (ptr + i));
+    _mm_storeu_si128 ((__m128i *) (ptr + i), _mm_shuffle_epi8 (x, mask128));
+    i += 16;
+  }
+  return i;
+}
+#endif
+
+static void dds_stream_swap_scalar (void * buff, uint32_t size, uint32_t num)
+{
   switch (size)
   {
     case 2:
@@ -360,6 +416,58 @@ void dds_stream_swap (void * buff, uint32_t size, uint32_t num)
   }
 }
 
+bool dds_stream_swap_isa (void * buff, uint32_t size, uint32_t num, enum dds_stream_swap_isa isa)
+{
+  size_t done = 0;
+  assert (size == 2 || size == 4 || size == 8);
+  switch (isa)
+  {
+    case DDS_STREAM_SWAP_SCALAR:
+      break;
+#ifdef DDS_STREAM_SWAP_X86
+    case DDS_STREAM_SWAP_SSSE3:
+      if (!__builtin_cpu_supports ("ssse3"))
+        return false;
+      done = dds_stream_swap_ssse3 (buff, (size_t) num * size, size);
+      break;
+    case DDS_STREAM_SWAP_AVX2:
+      if (!__builtin_cpu_supports ("avx2"))
+        return false;
+      done = dds_stream_swap_avx2 (buff, (size_t) num * size, size);
+      break;
+#else
+    case DDS_STREAM_SWAP_SSSE3:
+    case DDS_STREAM_SWAP_AVX2:
+      return false;
+#endif
+  }
+  dds_stream_swap_scalar ((uint8_t *) buff + done, size, num - (uint32_t) (done / size));
+  return true;
+}
+
+void dds_stream_swap (void * buff, uint32_t size, uint32_t num)
+{
+  assert (size == 2 || size == 4 || size == 8);
+
+#ifdef DDS_STREAM_SWAP_X86
+  /* Not worth the bother for a handful of elements */
+  if ((size_t) num * size >= 32)
+  {
+    const size_t nbytes = (size_t) num * size;
+    size_t done;
+    if (__builtin_cpu_supports ("avx2"))
+      done = dds_stream_swap_avx2 (buff, nbytes, size);
+    else if (__builtin_cpu_supports ("ssse3"))
+      done = dds_stream_swap_ssse3 (buff, nbytes, size);
+    else
+      done = 0;
+    buff = (uint8_t *) buff + done;
+    num -= (uint32_t) (done / size);
+  }
+#endif
+  dds_stream_swap_scalar (buff, size, num);
+}
+
 static void dds_stream_read_fixed_buffer
   (dds_stream_t * is, void * buff, uint32_t len, const uint32_t size, const bool swap)
 {
@@ -383,6 +491,11 @@ void dds_stream_read_buffer (dds_stream_t * is, uint8_t * buffer, uint32_t len)
 }
 
 void dds_stream_read_sample (dds_stream_t * is, void * data, const struct ddsi_sertopic_default * topic)
+{
+  dds_stream_read_sample_w_arena (is, data, topic, NULL);
+}
+
+void dds_stream_read_sample_w_arena (dds_stream_t * is, void * data, const struct ddsi_sertopic_default * topic, struct dds_arena * arena)
 {
   const struct dds_topic_descriptor * desc = topic->type;
   /* Check if can copy directly from stream buffer */
@@ -392,7 +505,7 @@ void dds_stream_read_sample (dds_stream_t * is, void * data, const struct ddsi_s
   }
   else
   {
-    dds_stream_read (is, data, desc->m_ops);
+    dds_stream_read (is, data, desc->m_ops, arena);
   }
 }
 
@@ -790,8 +903,52 @@ static void dds_stream_write
 #endif
 }
 
-static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * ops)
+/* With an arena, the sample is known to be zero-initialised (loaned samples
+   are zeroed when they are returned), so there is nothing to reuse and all
+   out-of-line data is allocated from the arena instead of the heap */
+static char * dds_stream_read_string_w_arena (dds_stream_t * is, char * str, struct dds_arena * arena)
 {
+  uint32_t length;
+  char * src;
+
+  if (arena == NULL)
+  {
+    return dds_stream_reuse_string (is, str, 0);
+  }
+  DDS_CDR_ALIGN4 (is);
+  if (DDS_IS_OK (is, 4))
+  {
+    DDS_IS_GET4 (is, length, uint32_t);
+    if (DDS_IS_OK (is, length))
+    {
+      src = DDS_CDR_ADDRESS (is, char);
+      str = dds_arena_alloc (arena, length + 1);
+      memcpy (str, src, length);
+      str[length] = 0;
+      is->m_index += length;
+    }
+  }
+  return str;
+}
+
+static void dds_stream_alloc_seq_w_arena (dds_sequence_t * seq, uint32_t num, uint32_t elem_size, bool zero, struct dds_arena * arena)
+{
+  const size_t size = (size_t) num * elem_size;
+  if (num == 0)
+  {
+    seq->_buffer = NULL;
+  }
+  else
+  {
+    seq->_buffer = zero ? dds_arena_alloc_zero (arena, size) : dds_arena_alloc (arena, size);
+  }
+  seq->_release = false;
+  seq->_maximum = num;
+}
+
+static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * ops, struct dds_arena * arena)
+{
+  const bool swap = (is->m_endian != DDS_ENDIAN);
   uint32_t align;
   uint32_t op;
   uint32_t type;
@@ -838,7 +995,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 #ifdef OP_DEBUG_READ
             DDS_TRACE("R-STR: @ %p\n", addr);
 #endif
-            *(char**) addr = dds_stream_reuse_string (is, *((char**) addr), 0);
+            *(char**) addr = dds_stream_read_string_w_arena (is, *((char**) addr), arena);
             break;
           }
           case DDS_OP_VAL_SEQ:
@@ -868,7 +1025,11 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 
                 /* Reuse sequence buffer if big enough */
 
-                if (num > seq->_length)
+                if (arena)
+                {
+                  dds_stream_alloc_seq_w_arena (seq, num, align, false, arena);
+                }
+                else if (num > seq->_length)
                 {
                   if (seq->_release && seq->_length)
                   {
@@ -882,7 +1043,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
                   seq->_maximum = num;
                 }
                 seq->_length = num;
-                dds_stream_read_fixed_buffer (is, seq->_buffer, seq->_length, align, is->m_endian != DDS_ENDIAN);
+                dds_stream_read_fixed_buffer (is, seq->_buffer, seq->_length, align, swap);
                 break;
               }
               case DDS_OP_VAL_STR:
@@ -891,7 +1052,11 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 
                 /* Reuse sequence buffer if big enough */
 
-                if (num > seq->_maximum)
+                if (arena)
+                {
+                  dds_stream_alloc_seq_w_arena (seq, num, (uint32_t) sizeof (char*), true, arena);
+                }
+                else if (num > seq->_maximum)
                 {
                   if (seq->_release && seq->_maximum)
                   {
@@ -909,7 +1074,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
                 ptr = (char**) seq->_buffer;
                 while (num--)
                 {
-                  *ptr = dds_stream_reuse_string (is, *ptr, 0);
+                  *ptr = dds_stream_read_string_w_arena (is, *ptr, arena);
                   ptr++;
                 }
                 break;
@@ -921,7 +1086,11 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 
                 /* Reuse sequence buffer if big enough */
 
-                if (num > seq->_maximum)
+                if (arena)
+                {
+                  dds_stream_alloc_seq_w_arena (seq, num, align, true, arena);
+                }
+                else if (num > seq->_maximum)
                 {
                   if (seq->_release && seq->_maximum)
                   {
@@ -954,7 +1123,11 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 
                 /* Reuse sequence buffer if big enough */
 
-                if (num > seq->_maximum)
+                if (arena)
+                {
+                  dds_stream_alloc_seq_w_arena (seq, num, elem_size, true, arena);
+                }
+                else if (num > seq->_maximum)
                 {
                   if (seq->_release && seq->_maximum)
                   {
@@ -982,7 +1155,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
                 ptr = (char*) seq->_buffer;
                 while (num--)
                 {
-                  dds_stream_read (is, ptr, jsr_ops);
+                  dds_stream_read (is, ptr, jsr_ops, arena);
                   ptr += elem_size;
                 }
                 ops += jmp ? (jmp - 3) : 1;
@@ -1009,7 +1182,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
                 align = dds_op_size[subtype];
                 if (DDS_IS_OK (is, num * align))
                 {
-                  dds_stream_read_fixed_buffer (is, addr, num, align, is->m_endian != DDS_ENDIAN);
+                  dds_stream_read_fixed_buffer (is, addr, num, align, swap);
                 }
                 break;
               }
@@ -1018,7 +1191,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
                 char ** ptr = (char**) addr;
                 while (num--)
                 {
-                  *ptr = dds_stream_reuse_string (is, *ptr, 0);
+                  *ptr = dds_stream_read_string_w_arena (is, *ptr, arena);
                   ptr++;
                 }
                 break;
@@ -1043,7 +1216,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 
                 while (num--)
                 {
-                  dds_stream_read (is, addr, jsr_ops);
+                  dds_stream_read (is, addr, jsr_ops, arena);
                   addr += elem_size;
                 }
                 ops += jmp ? (jmp - 3) : 2;
@@ -1130,12 +1303,12 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
                   }
                   case DDS_OP_VAL_STR:
                   {
-                    *(char**) addr = dds_stream_reuse_string (is, *((char**) addr), 0);
+                    *(char**) addr = dds_stream_read_string_w_arena (is, *((char**) addr), arena);
                     break;
                   }
                   default:
                   {
-                    dds_stream_read (is, addr, jeq_op + DDS_OP_ADR_JSR (jeq_op[0]));
+                    dds_stream_read (is, addr, jeq_op + DDS_OP_ADR_JSR (jeq_op[0]), arena);
                     break;
                   }
                 }
@@ -1167,7 +1340,7 @@ static void dds_stream_read (dds_stream_t * is, char * data, const uint32_t * op
 #ifdef OP_DEBUG_READ
         DDS_TRACE("R-JSR: %d\n", DDS_OP_JUMP (op));
 #endif
-        dds_stream_read (is, data, ops + DDS_OP_JUMP (op));
+        dds_stream_read (is, data, ops + DDS_OP_JUMP (op), arena);
         ops++;
         break;
       }
@@ -1203,6 +1376,17 @@ void dds_stream_from_serdata_default (dds_stream_t * s, const struct ddsi_serdat
   s->m_endian = (d->hdr.identifier == CDR_LE);
 }
 
+void dds_stream_serdata_to_sample_w_arena (const struct ddsi_serdata_default *d, const struct ddsi_sertopic_default *topic, void *sample, struct dds_arena *arena)
+{
+  /* topic is passed in explicitly because d may be a topicless (key-only) serdata */
+  dds_stream_t is;
+  dds_stream_from_serdata_default (&is, d);
+  if (d->c.kind == SDK_KEY)
+    dds_stream_read_key_w_arena (&is, sample, topic->type, arena);
+  else
+    dds_stream_read_sample_w_arena (&is, sample, topic, arena);
+}
+
 void dds_stream_add_to_serdata_default (dds_stream_t * s, struct ddsi_serdata_default **d)
 {
   /* DDSI requires 4 byte alignment */
@@ -1262,6 +1446,338 @@ void dds_stream_write_key (dds_stream_t * os, const char * sample, const struct
   }
 }
 
+/*
+  dds_stream_normalize: Validate received CDR data against the type and
+  convert it in place to native endianness. Checks that every primitive,
+  string (length and terminating nul, bound for bounded strings), array
+  and sequence fits in the "size" bytes of "data", so that all subsequent
+  processing of the serdata (key extraction, deserialisation, filters)
+  can skip byte swapping and rely on the input being well-formed. Data
+  may contain a full sample or just the key fields, in the order written
+  by dds_stream_write_key. Returns false if the data is malformed.
+*/
+
+static bool dds_stream_normalize_align (uint32_t * off, uint32_t size, uint32_t align)
+{
+  const uint32_t off1 = (*off + align - 1) & ~(align - 1);
+  if (off1 < *off || off1 > size)
+    return false;
+  *off = off1;
+  return true;
+}
+
+static bool dds_stream_normalize_prim (char * data, uint32_t * off, uint32_t size, bool bswap, uint32_t elem_size, uint32_t num)
+{
+  if (!dds_stream_normalize_align (off, size, elem_size) || num > (size - *off) / elem_size)
+    return false;
+  if (bswap && elem_size > 1 && num > 0)
+    dds_stream_swap (data + *off, elem_size, num);
+  *off += num * elem_size;
+  return true;
+}
+
+static bool dds_stream_normalize_uint32 (char * data, uint32_t * off, uint32_t size, bool bswap, uint32_t * val)
+{
+  if (!dds_stream_normalize_prim (data, off, size, bswap, 4, 1))
+    return false;
+  memcpy (val, data + *off - 4, 4);
+  return true;
+}
+
+static bool dds_stream_normalize_string (char * data, uint32_t * off, uint32_t size, bool bswap, uint32_t bound)
+{
+  uint32_t len;
+  if (!dds_stream_normalize_uint32 (data, off, size, bswap, &len))
+    return false;
+  /* length includes the terminating nul, bound does too */
+  if (len == 0 || len > size - *off || data[*off + len - 1] != 0 || (bound && len > bound))
+    return false;
+  *off += len;
+  return true;
+}
+
+static bool dds_stream_normalize_disc (char * data, uint32_t * off, uint32_t size, bool bswap, uint32_t subtype, uint32_t * disc)
+{
+  switch (subtype)
+  {
+    case DDS_OP_VAL_1BY:
+    {
+      if (!dds_stream_normalize_prim (data, off, size, bswap, 1, 1))
+        return false;
+      *disc = *((uint8_t *) (data + *off - 1));
+      return true;
+    }
+    case DDS_OP_VAL_2BY:
+    {
+      uint16_t d16;
+      if (!dds_stream_normalize_prim (data, off, size, bswap, 2, 1))
+        return false;
+      memcpy (&d16, data + *off - 2, 2);
+      *disc = d16;
+      return true;
+    }
+    case DDS_OP_VAL_4BY:
+    {
+      return dds_stream_normalize_uint32 (data, off, size, bswap, disc);
+    }
+    default:
+    {
+      return false;
+    }
+  }
+}
+
+static bool dds_stream_normalize_ops (char * data, uint32_t * off, uint32_t size, bool bswap, const uint32_t * ops)
+{
+  uint32_t op;
+  uint32_t type;
+  uint32_t subtype;
+  uint32_t num;
+
+  while ((op = *ops) != DDS_OP_RTS)
+  {
+    switch (DDS_OP_MASK & op)
+    {
+      case DDS_OP_ADR:
+      {
+        type = DDS_OP_TYPE (op);
+        ops += 2;
+        switch (type)
+        {
+          case DDS_OP_VAL_1BY:
+          case DDS_OP_VAL_2BY:
+          case DDS_OP_VAL_4BY:
+          case DDS_OP_VAL_8BY:
+          {
+            if (!dds_stream_normalize_prim (data, off, size, bswap, dds_op_size[type], 1))
+              return false;
+            break;
+          }
+          case DDS_OP_VAL_STR:
+          {
+            if (!dds_stream_normalize_string (data, off, size, bswap, 0))
+              return false;
+            break;
+          }
+          case DDS_OP_VAL_BST:
+          {
+            if (!dds_stream_normalize_string (data, off, size, bswap, *ops))
+              return false;
+            ops++;
+            break;
+          }
+          case DDS_OP_VAL_SEQ:
+          {
+            subtype = DDS_OP_SUBTYPE (op);
+            if (!dds_stream_normalize_uint32 (data, off, size, bswap, &num))
+              return false;
+            switch (subtype)
+            {
+              case DDS_OP_VAL_1BY:
+              case DDS_OP_VAL_2BY:
+              case DDS_OP_VAL_4BY:
+              case DDS_OP_VAL_8BY:
+              {
+                if (!dds_stream_normalize_prim (data, off, size, bswap, dds_op_size[subtype], num))
+                  return false;
+                break;
+              }
+              case DDS_OP_VAL_STR:
+              case DDS_OP_VAL_BST:
+              {
+                const uint32_t bound = (subtype == DDS_OP_VAL_BST) ? *ops++ : 0;
+                /* each string takes at least 5 bytes: checking it up front
+                   bounds the work a bogus length can cause */
+                if (num > (size - *off) / 5)
+                  return false;
+                while (num--)
+                {
+                  if (!dds_stream_normalize_string (data, off, size, bswap, bound))
+                    return false;
+                }
+                break;
+              }
+              default:
+              {
+                const uint32_t * jsr_ops = ops + DDS_OP_ADR_JSR (ops[1]) - 2;
+                const uint32_t jmp = DDS_OP_ADR_JMP (ops[1]);
+                if (num > size - *off)
+                  return false;
+                while (num--)
+                {
+                  if (!dds_stream_normalize_ops (data, off, size, bswap, jsr_ops))
+                    return false;
+                }
+                ops += jmp ? (jmp - 2) : 2;
+                break;
+              }
+            }
+            break;
+          }
+          case DDS_OP_VAL_ARR:
+          {
+            subtype = DDS_OP_SUBTYPE (op);
+            num = *ops++;
+            switch (subtype)
+            {
+              case DDS_OP_VAL_1BY:
+              case DDS_OP_VAL_2BY:
+              case DDS_OP_VAL_4BY:
+              case DDS_OP_VAL_8BY:
+              {
+                if (!dds_stream_normalize_prim (data, off, size, bswap, dds_op_size[subtype], num))
+                  return false;
+                break;
+              }
+              case DDS_OP_VAL_STR:
+              case DDS_OP_VAL_BST:
+              {
+                const uint32_t bound = (subtype == DDS_OP_VAL_BST) ? ops[1] : 0;
+                while (num--)
+                {
+                  if (!dds_stream_normalize_string (data, off, size, bswap, bound))
+                    return false;
+                }
+                if (subtype == DDS_OP_VAL_BST)
+                  ops += 2;
+                break;
+              }
+              default:
+              {
+                const uint32_t * jsr_ops = ops + DDS_OP_ADR_JSR (*ops) - 3;
+                const uint32_t jmp = DDS_OP_ADR_JMP (*ops);
+                while (num--)
+                {
+                  if (!dds_stream_normalize_ops (data, off, size, bswap, jsr_ops))
+                    return false;
+                }
+                ops += jmp ? (jmp - 3) : 2;
+                break;
+              }
+            }
+            break;
+          }
+          case DDS_OP_VAL_UNI:
+          {
+            const bool has_default = op & DDS_OP_FLAG_DEF;
+            const uint32_t * jeq_op = ops + DDS_OP_ADR_JSR (ops[1]) - 2;
+            uint32_t disc;
+            subtype = DDS_OP_SUBTYPE (op);
+            num = ops[0];
+            if (!dds_stream_normalize_disc (data, off, size, bswap, subtype, &disc))
+              return false;
+            while (num--)
+            {
+              assert ((DDS_OP_MASK & jeq_op[0]) == DDS_OP_JEQ);
+              if ((jeq_op[1] == disc) || (has_default && (num == 0)))
+              {
+                subtype = DDS_JEQ_TYPE (jeq_op[0]);
+                switch (subtype)
+                {
+                  case DDS_OP_VAL_1BY:
+                  case DDS_OP_VAL_2BY:
+                  case DDS_OP_VAL_4BY:
+                  case DDS_OP_VAL_8BY:
+                  {
+                    if (!dds_stream_normalize_prim (data, off, size, bswap, dds_op_size[subtype], 1))
+                      return false;
+                    break;
+                  }
+                  case DDS_OP_VAL_STR:
+                  case DDS_OP_VAL_BST:
+                  {
+                    if (!dds_stream_normalize_string (data, off, size, bswap, 0))
+                      return false;
+                    break;
+                  }
+                  default:
+                  {
+                    if (!dds_stream_normalize_ops (data, off, size, bswap, jeq_op + DDS_OP_ADR_JSR (jeq_op[0])))
+                      return false;
+                    break;
+                  }
+                }
+                break;
+              }
+              jeq_op += 3;
+            }
+            ops += DDS_OP_ADR_JMP (ops[1]) - 2;
+            break;
+          }
+          default:
+          {
+            return false;
+          }
+        }
+        break;
+      }
+      case DDS_OP_JSR: /* Implies nested type */
+      {
+        if (!dds_stream_normalize_ops (data, off, size, bswap, ops + DDS_OP_JUMP (op)))
+          return false;
+        ops++;
+        break;
+      }
+      default:
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool dds_stream_normalize_key (char * data, uint32_t * off, uint32_t size, bool bswap, const dds_topic_descriptor_t * desc)
+{
+  uint32_t i;
+  const uint32_t * op;
+
+  for (i = 0; i < desc->m_nkeys; i++)
+  {
+    op = desc->m_ops + desc->m_keys[i].m_index;
+    assert ((*op & DDS_OP_FLAG_KEY) && ((DDS_OP_MASK & *op) == DDS_OP_ADR));
+    switch (DDS_OP_TYPE (*op))
+    {
+      case DDS_OP_VAL_1BY:
+      case DDS_OP_VAL_2BY:
+      case DDS_OP_VAL_4BY:
+      case DDS_OP_VAL_8BY:
+        if (!dds_stream_normalize_prim (data, off, size, bswap, dds_op_size[DDS_OP_TYPE (*op)], 1))
+          return false;
+        break;
+      case DDS_OP_VAL_STR:
+        if (!dds_stream_normalize_string (data, off, size, bswap, 0))
+          return false;
+        break;
+      case DDS_OP_VAL_BST:
+        if (!dds_stream_normalize_string (data, off, size, bswap, op[2]))
+          return false;
+        break;
+      case DDS_OP_VAL_ARR:
+      {
+        uint32_t subtype = DDS_OP_SUBTYPE (*op);
+        assert (subtype <= DDS_OP_VAL_8BY);
+        if (!dds_stream_normalize_prim (data, off, size, bswap, dds_op_size[subtype], op[2]))
+          return false;
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+bool dds_stream_normalize (void * data, uint32_t size, bool bswap, const struct ddsi_sertopic_default * topic, bool just_key)
+{
+  const dds_topic_descriptor_t * desc = topic->type;
+  uint32_t off = 0;
+  if (just_key)
+    return dds_stream_normalize_key (data, &off, size, bswap, desc);
+  else
+    return dds_stream_normalize_ops (data, &off, size, bswap, desc->m_ops);
+}
+
 /*
   dds_stream_get_keyhash: Extract key values from a stream and generate
   keyhash used for instance identification. Non key fields are skipped.
@@ -1630,6 +2146,17 @@ void dds_stream_read_key
   char * sample,
   const dds_topic_descriptor_t * desc
 )
+{
+  dds_stream_read_key_w_arena (is, sample, desc, NULL);
+}
+
+void dds_stream_read_key_w_arena
+(
+  dds_stream_t * is,
+  char * sample,
+  const dds_topic_descriptor_t * desc,
+  struct dds_arena * arena
+)
 {
   uint32_t i;
   char * dst;
@@ -1655,7 +2182,7 @@ void dds_stream_read_key
         *((uint64_t*) dst) = dds_stream_read_uint64 (is);
         break;
       case DDS_OP_VAL_STR:
-        *((char**) dst) = dds_stream_reuse_string (is, *((char**) dst), 0);
+        *((char**) dst) = dds_stream_read_string_w_arena (is, *((char**) dst), arena);
         break;
       case DDS_OP_VAL_BST:
         dds_stream_reuse_string (is, dst, op[2]);
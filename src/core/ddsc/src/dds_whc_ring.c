@@ -0,0 +1,578 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_plist.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/q_time.h"
+#include "dds__whc.h"
+
+/* WHC for volatile, KEEP_LAST writers of topics without a key field.
+
+   A writer assigns consecutive sequence numbers and there is only a
+   single instance, so the history is simply the most recent HDEPTH
+   samples (invalid samples and unregisters aside) and samples leave
+   the WHC almost exclusively at the low end, either because they got
+   acknowledged or because they were pushed out of the history.  That
+   means the contents of the WHC fit in a ring buffer indexed by
+   sequence number, with constant-time insert, lookup and removal and
+   without per-sample allocations, hash tables and interval trees.
+
+   The window [min_seq,maxp1_seq) covers all samples in the WHC: entry
+   SEQ lives at ring[SEQ % ringsize] and the window is never larger
+   than the ring, which grows if needed.  Samples can be missing from
+   the window (e.g., a sample pushed out of the history following an
+   unacknowledged unregister), but the window is always trimmed so
+   that the first and last entries are present.
+
+   Samples in the history of the instance are flagged as "indexed";
+   all indexed samples are at or above idx_first and idx_head is the
+   most recent one. */
+
+struct whc_ring_entry {
+  struct ddsi_serdata *serdata; /* NULL iff entry is not in use */
+  struct nn_plist *plist; /* 0 if nothing special */
+  size_t size;
+  nn_mtime_t last_rexmit_ts;
+  unsigned rexmit_count;
+  unsigned unacked: 1; /* counted in whc::unacked_bytes iff 1 */
+  unsigned borrowed: 1; /* at most one can borrow it at any time */
+  unsigned indexed: 1; /* part of the history of the instance */
+};
+
+struct whc_ring {
+  struct whc common;
+  ddsrt_mutex_t lock;
+  struct whc_ring_entry *ring;
+  uint32_t ringsize; /* power of 2 */
+  seqno_t min_seq; /* = maxp1_seq iff empty */
+  seqno_t maxp1_seq;
+  uint32_t seq_size;
+  size_t unacked_bytes;
+  size_t sample_overhead;
+  unsigned hdepth;
+  seqno_t max_drop_seq; /* samples in whc with seq <= max_drop_seq are acknowledged */
+  unsigned idx_count;
+  seqno_t idx_first;
+  seqno_t idx_head; /* valid iff idx_count > 0 */
+  struct whc_ring_deferred_free_list *dfl_cache; /* retained for the next ack, or NULL */
+};
+
+/* Samples removed from the WHC get passed to the caller in a single
+   block, to be freed once the writer lock has been released.  The block
+   is returned to the WHC afterward, so that processing ACKs doesn't
+   require an allocation each time; only if it is still in use by a
+   concurrent ACK (or too small because the ring grew) is a new one
+   allocated. */
+struct whc_ring_deferred_free_list {
+  uint32_t n;
+  uint32_t cap;
+  struct {
+    struct ddsi_serdata *serdata;
+    struct nn_plist *plist;
+  } xs[];
+};
+
+struct whc_ring_sample_iter {
+  struct whc_sample_iter_base c;
+  bool first;
+};
+
+/* check that our definition of whc_sample_iter fits in the type that callers allocate */
+struct whc_ring_sample_iter_sizecheck {
+  char fits_in_generic_type[sizeof(struct whc_ring_sample_iter) <= sizeof(struct whc_sample_iter) ? 1 : -1];
+};
+
+#define WHC_RING_INITIAL_SIZE_MAX 64u
+
+static struct whc_ring_entry *whc_ring_entry (const struct whc_ring *whc, seqno_t seq)
+{
+  return &whc->ring[(uint32_t) seq & (whc->ringsize - 1)];
+}
+
+static struct whc_ring_entry *whc_ring_lookup (const struct whc_ring *whc, seqno_t seq)
+{
+  struct whc_ring_entry *e;
+  if (seq < whc->min_seq || seq >= whc->maxp1_seq)
+    return NULL;
+  e = whc_ring_entry (whc, seq);
+  return e->serdata ? e : NULL;
+}
+
+static void check_whc (const struct whc_ring *whc)
+{
+  assert (whc->min_seq <= whc->maxp1_seq);
+  assert (whc->maxp1_seq - whc->min_seq <= (seqno_t) whc->ringsize);
+  assert ((whc->seq_size == 0) == (whc->min_seq == whc->maxp1_seq));
+  assert (whc->seq_size == 0 || whc_ring_lookup (whc, whc->min_seq) != NULL);
+  assert (whc->seq_size == 0 || whc_ring_lookup (whc, whc->maxp1_seq - 1) != NULL);
+  assert (whc->idx_count <= whc->hdepth);
+  assert (whc->idx_count == 0 || (whc->idx_head >= whc->idx_first && whc_ring_lookup (whc, whc->idx_head)->indexed));
+  (void) whc;
+}
+
+static void free_whc_entry_contents (struct ddsi_serdata *serdata, struct nn_plist *plist)
+{
+  ddsi_serdata_unref (serdata);
+  if (plist) {
+    nn_plist_fini (plist);
+    ddsrt_free (plist);
+  }
+}
+
+static void whc_ring_trim (struct whc_ring *whc)
+{
+  while (whc->min_seq < whc->maxp1_seq && whc_ring_entry (whc, whc->min_seq)->serdata == NULL)
+    whc->min_seq++;
+  while (whc->maxp1_seq > whc->min_seq && whc_ring_entry (whc, whc->maxp1_seq - 1)->serdata == NULL)
+    whc->maxp1_seq--;
+}
+
+static void whc_ring_clear_entry (struct whc_ring *whc, seqno_t seq, struct whc_ring_entry *e)
+{
+  if (e->unacked)
+  {
+    assert (whc->unacked_bytes >= e->size);
+    whc->unacked_bytes -= e->size;
+  }
+  if (e->indexed && seq >= whc->idx_first)
+  {
+    /* only ever removed from the history in order */
+    assert (whc->idx_count > 0);
+    whc->idx_count--;
+    whc->idx_first = seq + 1;
+  }
+  memset (e, 0, sizeof (*e));
+  whc->seq_size--;
+}
+
+static void whc_ring_delete_one (struct whc_ring *whc, seqno_t seq)
+{
+  /* Removes the sample and frees it, unless it is borrowed, in which
+     case ownership passes to the borrower */
+  struct whc_ring_entry *e = whc_ring_lookup (whc, seq);
+  struct ddsi_serdata *serdata;
+  struct nn_plist *plist;
+  bool borrowed;
+  assert (e != NULL);
+  serdata = e->serdata;
+  plist = e->plist;
+  borrowed = e->borrowed;
+  whc_ring_clear_entry (whc, seq, e);
+  whc_ring_trim (whc);
+  if (!borrowed)
+    free_whc_entry_contents (serdata, plist);
+}
+
+static void whc_ring_grow (struct whc_ring *whc, seqno_t maxp1_seq)
+{
+  struct whc_ring_entry *ring;
+  uint32_t ringsize = whc->ringsize;
+  seqno_t seq;
+  while (maxp1_seq - whc->min_seq > (seqno_t) ringsize)
+    ringsize *= 2;
+  DDS_LOG(DDS_LC_WHC, "  grow ring %p from %"PRIu32" to %"PRIu32"\n", (void *) whc, whc->ringsize, ringsize);
+  ring = ddsrt_malloc (ringsize * sizeof (*ring));
+  memset (ring, 0, ringsize * sizeof (*ring));
+  for (seq = whc->min_seq; seq < whc->maxp1_seq; seq++)
+    ring[(uint32_t) seq & (ringsize - 1)] = *whc_ring_entry (whc, seq);
+  ddsrt_free (whc->ring);
+  whc->ring = ring;
+  whc->ringsize = ringsize;
+}
+
+static void get_state_locked (const struct whc_ring *whc, struct whc_state *st)
+{
+  if (whc->seq_size == 0)
+  {
+    st->min_seq = st->max_seq = -1;
+    st->unacked_bytes = 0;
+  }
+  else
+  {
+    st->min_seq = whc->min_seq;
+    st->max_seq = whc->maxp1_seq - 1;
+    st->unacked_bytes = whc->unacked_bytes;
+  }
+}
+
+static void whc_ring_get_state (const struct whc *whc_generic, struct whc_state *st)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  check_whc (whc);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+}
+
+static seqno_t next_seq_locked (const struct whc_ring *whc, seqno_t seq)
+{
+  seqno_t nseq = (seq < whc->min_seq) ? whc->min_seq : seq + 1;
+  while (nseq < whc->maxp1_seq && whc_ring_entry (whc, nseq)->serdata == NULL)
+    nseq++;
+  return (nseq < whc->maxp1_seq) ? nseq : MAX_SEQ_NUMBER;
+}
+
+static seqno_t whc_ring_next_seq (const struct whc *whc_generic, seqno_t seq)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  seqno_t nseq;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  check_whc (whc);
+  nseq = next_seq_locked (whc, seq);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return nseq;
+}
+
+static size_t whc_entry_size (const struct whc_ring *whc, const struct ddsi_serdata *serdata)
+{
+  size_t sz = ddsi_serdata_size (serdata);
+  return sz + ((sz + config.fragment_size - 1) / config.fragment_size) * whc->sample_overhead;
+}
+
+static int whc_ring_insert (struct whc *whc_generic, seqno_t max_drop_seq, seqno_t seq, struct nn_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  struct whc_ring_entry *e;
+  (void) tk;
+
+  ddsrt_mutex_lock (&whc->lock);
+  check_whc (whc);
+  DDS_LOG(DDS_LC_WHC, "whc_ring_insert(%p max_drop_seq %"PRId64" seq %"PRId64" plist %p serdata %p:%"PRIx32")\n", (void *) whc, max_drop_seq, seq, (void *) plist, (void *) serdata, serdata->hash);
+  DDS_LOG(DDS_LC_WHC, "  whc: [%"PRId64",%"PRId64") max_drop_seq %"PRId64" h %u idx %u\n", whc->min_seq, whc->maxp1_seq, whc->max_drop_seq, whc->hdepth, whc->idx_count);
+
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  assert (whc->seq_size == 0 || seq >= whc->maxp1_seq);
+
+  if (serdata->kind != SDK_EMPTY && !(serdata->statusinfo & NN_STATUSINFO_UNREGISTER) && whc->idx_count == whc->hdepth)
+  {
+    /* history full: push out the oldest sample in it, first, so the
+       window shrinks before growing it */
+    seqno_t oldseq = (whc->idx_first > whc->min_seq) ? whc->idx_first : whc->min_seq;
+    while (!(whc_ring_lookup (whc, oldseq) && whc_ring_entry (whc, oldseq)->indexed))
+      oldseq++;
+    DDS_LOG(DDS_LC_WHC, "  prune %"PRId64"\n", oldseq);
+    whc_ring_delete_one (whc, oldseq);
+  }
+
+  if (whc->seq_size == 0)
+    whc->min_seq = whc->maxp1_seq = seq;
+  else if (seq + 1 - whc->min_seq > (seqno_t) whc->ringsize)
+    whc_ring_grow (whc, seq + 1);
+  e = whc_ring_entry (whc, seq);
+  assert (e->serdata == NULL);
+  e->serdata = ddsi_serdata_ref (serdata);
+  e->plist = plist;
+  e->size = whc_entry_size (whc, serdata);
+  e->last_rexmit_ts.v = 0;
+  e->rexmit_count = 0;
+  e->unacked = (seq > max_drop_seq);
+  e->borrowed = 0;
+  e->indexed = 0;
+  if (e->unacked)
+    whc->unacked_bytes += e->size;
+  whc->maxp1_seq = seq + 1;
+  whc->seq_size++;
+
+  if (serdata->kind == SDK_EMPTY)
+    ; /* not part of the history */
+  else if (!(serdata->statusinfo & NN_STATUSINFO_UNREGISTER))
+  {
+    e->indexed = 1;
+    if (whc->idx_count++ == 0)
+      whc->idx_first = seq;
+    whc->idx_head = seq;
+  }
+  else
+  {
+    /* Unregistering drops the history of the instance: whatever has
+       been acknowledged goes, the remainder stays until it is */
+    seqno_t s;
+    DDS_LOG(DDS_LC_WHC, "  unreg\n");
+    for (s = (whc->idx_first > whc->min_seq) ? whc->idx_first : whc->min_seq; s <= max_drop_seq && s < seq; s++)
+    {
+      struct whc_ring_entry *olde = whc_ring_lookup (whc, s);
+      if (olde && olde->indexed)
+        whc_ring_delete_one (whc, s);
+    }
+    whc->idx_count = 0;
+    whc->idx_first = seq + 1;
+    if (seq <= max_drop_seq)
+      whc_ring_delete_one (whc, seq);
+  }
+  check_whc (whc);
+  ddsrt_mutex_unlock (&whc->lock);
+  return 0;
+}
+
+static unsigned whc_ring_remove_acked_messages (struct whc *whc_generic, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  struct whc_ring_deferred_free_list *dfl = NULL;
+  unsigned cnt = 0;
+
+  ddsrt_mutex_lock (&whc->lock);
+  check_whc (whc);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  DDS_LOG(DDS_LC_WHC, "whc_ring_remove_acked_messages(%p max_drop_seq %"PRId64")\n", (void *) whc, max_drop_seq);
+  DDS_LOG(DDS_LC_WHC, "  whc: [%"PRId64",%"PRId64") max_drop_seq %"PRId64" h %u idx %u\n", whc->min_seq, whc->maxp1_seq, whc->max_drop_seq, whc->hdepth, whc->idx_count);
+
+  if (whc->seq_size > 0 && max_drop_seq >= whc->min_seq)
+  {
+    const seqno_t endp1 = (max_drop_seq < whc->maxp1_seq) ? max_drop_seq + 1 : whc->maxp1_seq;
+    seqno_t seq;
+    dfl = whc->dfl_cache;
+    whc->dfl_cache = NULL;
+    if (dfl == NULL || dfl->cap < (uint32_t) (endp1 - whc->min_seq))
+    {
+      /* the window never exceeds the ring, so sizing it for the ring
+         means it need not grow again until the ring does */
+      ddsrt_free (dfl);
+      dfl = ddsrt_malloc (sizeof (*dfl) + whc->ringsize * sizeof (dfl->xs[0]));
+      dfl->cap = whc->ringsize;
+    }
+    dfl->n = 0;
+    for (seq = whc->min_seq; seq < endp1; seq++)
+    {
+      struct whc_ring_entry * const e = whc_ring_entry (whc, seq);
+      if (e->serdata == NULL)
+        continue;
+      if (!e->borrowed)
+      {
+        dfl->xs[dfl->n].serdata = e->serdata;
+        dfl->xs[dfl->n].plist = e->plist;
+        dfl->n++;
+      }
+      whc_ring_clear_entry (whc, seq, e);
+      cnt++;
+    }
+    whc->min_seq = endp1;
+    whc_ring_trim (whc);
+    if (dfl->n == 0)
+    {
+      whc->dfl_cache = dfl;
+      dfl = NULL;
+    }
+  }
+  whc->max_drop_seq = max_drop_seq;
+  *deferred_free_list = (struct whc_node *) dfl;
+  check_whc (whc);
+  get_state_locked (whc, whcst);
+  ddsrt_mutex_unlock (&whc->lock);
+  return cnt;
+}
+
+static void whc_ring_free_deferred_free_list (struct whc *whc_generic, struct whc_node *deferred_free_list)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  struct whc_ring_deferred_free_list *dfl = (struct whc_ring_deferred_free_list *) deferred_free_list;
+  if (dfl)
+  {
+    uint32_t i;
+    for (i = 0; i < dfl->n; i++)
+      free_whc_entry_contents (dfl->xs[i].serdata, dfl->xs[i].plist);
+    ddsrt_mutex_lock (&whc->lock);
+    if (whc->dfl_cache == NULL)
+    {
+      whc->dfl_cache = dfl;
+      dfl = NULL;
+    }
+    ddsrt_mutex_unlock (&whc->lock);
+    ddsrt_free (dfl);
+  }
+}
+
+static unsigned whc_ring_downgrade_to_volatile (struct whc *whc_generic, struct whc_state *st)
+{
+  /* only ever used for volatile writers */
+  whc_ring_get_state (whc_generic, st);
+  return 0;
+}
+
+static void make_borrowed_sample (struct whc_borrowed_sample *sample, seqno_t seq, struct whc_ring_entry *e)
+{
+  assert (!e->borrowed);
+  e->borrowed = 1;
+  sample->seq = seq;
+  sample->plist = e->plist;
+  sample->serdata = e->serdata;
+  sample->unacked = e->unacked;
+  sample->rexmit_count = e->rexmit_count;
+  sample->last_rexmit_ts = e->last_rexmit_ts;
+}
+
+static bool whc_ring_borrow_sample (const struct whc *whc_generic, seqno_t seq, struct whc_borrowed_sample *sample)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  struct whc_ring_entry *e;
+  bool found;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  if ((e = whc_ring_lookup (whc, seq)) == NULL)
+    found = false;
+  else
+  {
+    make_borrowed_sample (sample, seq, e);
+    found = true;
+  }
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static bool whc_ring_borrow_sample_key (const struct whc *whc_generic, const struct ddsi_serdata *serdata_key, struct whc_borrowed_sample *sample)
+{
+  /* there is but one instance, and its latest sample is the head of the history */
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  bool found;
+  (void) serdata_key;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  if (whc->idx_count == 0)
+    found = false;
+  else
+  {
+    make_borrowed_sample (sample, whc->idx_head, whc_ring_lookup (whc, whc->idx_head));
+    found = true;
+  }
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static void return_sample_locked (struct whc_ring *whc, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_ring_entry *e;
+  if ((e = whc_ring_lookup (whc, sample->seq)) == NULL)
+  {
+    /* data no longer present in WHC - that means ownership for serdata, plist shifted to the borrowed copy and "returning" it really becomes "destroying" it */
+    free_whc_entry_contents (sample->serdata, sample->plist);
+  }
+  else
+  {
+    assert (e->borrowed);
+    e->borrowed = 0;
+    if (update_retransmit_info)
+    {
+      e->rexmit_count = sample->rexmit_count;
+      e->last_rexmit_ts = sample->last_rexmit_ts;
+    }
+  }
+}
+
+static void whc_ring_return_sample (struct whc *whc_generic, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock (&whc->lock);
+  return_sample_locked (whc, sample, update_retransmit_info);
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void whc_ring_sample_iter_init (const struct whc *whc_generic, struct whc_sample_iter *opaque_it)
+{
+  struct whc_ring_sample_iter *it = (struct whc_ring_sample_iter *) opaque_it;
+  it->c.whc = (struct whc *) whc_generic;
+  it->first = true;
+}
+
+static bool whc_ring_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample)
+{
+  struct whc_ring_sample_iter * const it = (struct whc_ring_sample_iter *) opaque_it;
+  struct whc_ring * const whc = (struct whc_ring *) it->c.whc;
+  seqno_t seq;
+  bool valid;
+  ddsrt_mutex_lock (&whc->lock);
+  check_whc (whc);
+  if (!it->first)
+  {
+    seq = sample->seq;
+    return_sample_locked (whc, sample, false);
+  }
+  else
+  {
+    it->first = false;
+    seq = 0;
+  }
+  if ((seq = next_seq_locked (whc, seq)) == MAX_SEQ_NUMBER)
+    valid = false;
+  else
+  {
+    make_borrowed_sample (sample, seq, whc_ring_entry (whc, seq));
+    valid = true;
+  }
+  ddsrt_mutex_unlock (&whc->lock);
+  return valid;
+}
+
+static void whc_ring_free (struct whc *whc_generic)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  seqno_t seq;
+  check_whc (whc);
+  for (seq = whc->min_seq; seq < whc->maxp1_seq; seq++)
+  {
+    struct whc_ring_entry * const e = whc_ring_entry (whc, seq);
+    if (e->serdata)
+      free_whc_entry_contents (e->serdata, e->plist);
+  }
+  ddsrt_free (whc->dfl_cache);
+  ddsrt_free (whc->ring);
+  ddsrt_mutex_destroy (&whc->lock);
+  ddsrt_free (whc);
+}
+
+static const struct whc_ops whc_ring_ops = {
+  .insert = whc_ring_insert,
+  .remove_acked_messages = whc_ring_remove_acked_messages,
+  .free_deferred_free_list = whc_ring_free_deferred_free_list,
+  .get_state = whc_ring_get_state,
+  .next_seq = whc_ring_next_seq,
+  .borrow_sample = whc_ring_borrow_sample,
+  .borrow_sample_key = whc_ring_borrow_sample_key,
+  .return_sample = whc_ring_return_sample,
+  .sample_iter_init = whc_ring_sample_iter_init,
+  .sample_iter_borrow_next = whc_ring_sample_iter_borrow_next,
+  .downgrade_to_volatile = whc_ring_downgrade_to_volatile,
+  .free = whc_ring_free
+};
+
+struct whc *whc_ring_new (unsigned hdepth)
+{
+  struct whc_ring *whc;
+  uint32_t ringsize = 1;
+  assert (hdepth > 0);
+  while (ringsize < hdepth && ringsize < WHC_RING_INITIAL_SIZE_MAX)
+    ringsize *= 2;
+  whc = ddsrt_malloc (sizeof (*whc));
+  whc->common.ops = &whc_ring_ops;
+  ddsrt_mutex_init (&whc->lock);
+  whc->ring = ddsrt_malloc (ringsize * sizeof (*whc->ring));
+  memset (whc->ring, 0, ringsize * sizeof (*whc->ring));
+  whc->ringsize = ringsize;
+  whc->min_seq = whc->maxp1_seq = 1;
+  whc->seq_size = 0;
+  whc->unacked_bytes = 0;
+  whc->sample_overhead = 80; /* INFO_TS, DATA (estimate), inline QoS */
+  whc->hdepth = hdepth;
+  whc->max_drop_seq = 0;
+  whc->idx_count = 0;
+  whc->idx_first = 1;
+  whc->idx_head = 0;
+  whc->dfl_cache = NULL;
+  check_whc (whc);
+  return (struct whc *) whc;
+}
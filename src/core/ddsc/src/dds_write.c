@@ -25,6 +25,7 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_radmin.h"
+#include "dds/ddsrt/heap.h"
 
 dds_return_t dds_write (dds_entity_t writer, const void *data)
 {
@@ -92,9 +93,12 @@ static dds_return_t try_store (struct rhc *rhc, const struct proxy_writer_info *
   return DDS_RETCODE_OK;
 }
 
-static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *payload, struct ddsi_tkmap_instance *tk)
+static dds_return_t deliver_locally (struct writer *wr, struct coherent_set *cs, struct ddsi_serdata *payload, struct ddsi_tkmap_instance *tk)
 {
+  /* Readers with coherent access get a sample that is part of a coherent
+     set (i.e., CS != NULL) only once the set is complete */
   dds_return_t ret = DDS_RETCODE_OK;
+  bool in_coherent_set = false;
   ddsrt_mutex_lock (&wr->rdary.rdary_lock);
   if (wr->rdary.fastpath_ok)
   {
@@ -106,6 +110,10 @@ static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *pay
       unsigned i;
       make_proxy_writer_info (&pwr_info, &wr->e, wr->xqos);
       for (i = 0; rdary[i]; i++) {
+        if (cs && reader_wants_coherent_sets (rdary[i])) {
+          in_coherent_set = true;
+          continue;
+        }
         DDS_TRACE ("reader "PGUIDFMT"\n", PGUID (rdary[i]->e.guid));
         if ((ret = try_store (rdary[i]->rhc, &pwr_info, payload, tk, &max_block_ms)) != DDS_RETCODE_OK)
           break;
@@ -135,6 +143,10 @@ static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *pay
       struct reader *rd;
       if ((rd = ephash_lookup_reader_guid (&m->rd_guid)) != NULL)
       {
+        if (cs && reader_wants_coherent_sets (rd)) {
+          in_coherent_set = true;
+          continue;
+        }
         DDS_TRACE("reader-via-guid "PGUIDFMT"\n", PGUID (rd->e.guid));
         /* Copied the return value ignore from DDSI deliver_user_data() function. */
         if ((ret = try_store (rd->rhc, &pwr_info, payload, tk, &max_block_ms)) != DDS_RETCODE_OK)
@@ -143,9 +155,88 @@ static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *pay
     }
     ddsrt_mutex_unlock (&wr->e.lock);
   }
+  if (in_coherent_set && ret == DDS_RETCODE_OK)
+  {
+    /* local delivery is lossless, so the set is always complete */
+    coherent_set_append (cs, cs->next_seq, payload, tk);
+  }
   return ret;
 }
 
+static dds_return_t deliver_locally_coherent_set (struct writer *wr, const struct coherent_set *cs)
+{
+  /* Delivering a set may block on resource limits, which means the
+     readers have to be looked up again after sleeping */
+  dds_duration_t max_block_ms = nn_from_ddsi_duration (wr->xqos->reliability.max_blocking_time);
+  struct proxy_writer_info pwr_info;
+  nn_guid_t *rdguids;
+  uint32_t nrd = 0, i;
+  ddsrt_avl_iter_t it;
+  struct wr_rd_match *m;
+
+  make_proxy_writer_info (&pwr_info, &wr->e, wr->xqos);
+  ddsrt_mutex_lock (&wr->e.lock);
+  for (m = ddsrt_avl_iter_first (&wr_local_readers_treedef, &wr->local_readers, &it); m != NULL; m = ddsrt_avl_iter_next (&it))
+    nrd++;
+  rdguids = ddsrt_malloc ((nrd + 1) * sizeof (*rdguids));
+  nrd = 0;
+  for (m = ddsrt_avl_iter_first (&wr_local_readers_treedef, &wr->local_readers, &it); m != NULL; m = ddsrt_avl_iter_next (&it))
+  {
+    struct reader *rd;
+    if ((rd = ephash_lookup_reader_guid (&m->rd_guid)) != NULL && reader_wants_coherent_sets (rd))
+      rdguids[nrd++] = m->rd_guid;
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+
+  for (i = 0; i < nrd; i++)
+  {
+    struct reader *rd;
+    uint32_t ndeliv = 0;
+    DDS_TRACE ("coherent set (%"PRIu32" samples) => "PGUIDFMT"\n", cs->n, PGUID (rdguids[i]));
+    while ((rd = ephash_lookup_reader_guid (&rdguids[i])) != NULL &&
+           (ndeliv += (ddsi_plugin.rhc_plugin.rhc_store_set_fn) (rd->rhc, &pwr_info, cs->n - ndeliv, cs->samples + ndeliv, cs->tks + ndeliv)) < cs->n)
+    {
+      if (max_block_ms <= 0)
+      {
+        DDS_ERROR ("The writer could not deliver data on time, probably due to a local reader resources being full\n");
+        ddsrt_free (rdguids);
+        return DDS_ERRNO (DDS_RETCODE_TIMEOUT);
+      }
+      dds_sleepfor (DDS_HEADBANG_TIMEOUT);
+      max_block_ms -= DDS_HEADBANG_TIMEOUT;
+    }
+  }
+  ddsrt_free (rdguids);
+  return DDS_RETCODE_OK;
+}
+
+static void retain_last_instance (dds_writer *wr, struct ddsi_tkmap_instance *tk, bool unregister)
+{
+  /* Without a reference, an instance that is only known to the writer is
+     removed from the instance map after every write, and added again on the
+     next: keeping a reference to the most recently written one makes writing
+     to a single instance free of allocations */
+  if (unregister)
+  {
+    if (wr->m_last_tk == tk)
+    {
+      ddsi_tkmap_instance_unref (wr->m_last_tk);
+      wr->m_last_tk = NULL;
+    }
+    ddsi_tkmap_instance_unref (tk);
+  }
+  else if (wr->m_last_tk == tk)
+  {
+    ddsi_tkmap_instance_unref (tk);
+  }
+  else
+  {
+    if (wr->m_last_tk)
+      ddsi_tkmap_instance_unref (wr->m_last_tk);
+    wr->m_last_tk = tk;
+  }
+}
+
 dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstamp, dds_write_action action)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -194,14 +285,14 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     ret = DDS_ERRNO (DDS_RETCODE_ERROR);
   }
   if (ret == DDS_RETCODE_OK)
-    ret = deliver_locally (ddsi_wr, d, tk);
+    ret = deliver_locally (ddsi_wr, wr->m_coherent, d, tk);
   ddsi_serdata_unref (d);
-  ddsi_tkmap_instance_unref (tk);
+  retain_last_instance (wr, tk, (action & DDS_WR_UNREGISTER_BIT) != 0);
   thread_state_asleep (ts1);
   return ret;
 }
 
-dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d)
+dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct coherent_set *cs, struct ddsi_serdata *d)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   struct ddsi_tkmap_instance * tk;
@@ -229,7 +320,7 @@ dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack
   }
 
   if (ret == DDS_RETCODE_OK)
-    ret = deliver_locally (ddsi_wr, d, tk);
+    ret = deliver_locally (ddsi_wr, cs, d, tk);
   ddsi_serdata_unref (d);
   ddsi_tkmap_instance_unref (tk);
   thread_state_asleep (ts1);
@@ -243,7 +334,62 @@ dds_return_t dds_writecdr_impl (dds_writer *wr, struct ddsi_serdata *d, dds_time
   /* Set if disposing or unregistering */
   d->statusinfo = ((action & DDS_WR_DISPOSE_BIT) ? NN_STATUSINFO_DISPOSE : 0) | ((action & DDS_WR_UNREGISTER_BIT) ? NN_STATUSINFO_UNREGISTER : 0);
   d->timestamp.v = tstamp;
-  return dds_writecdr_impl_lowlevel (wr->m_wr, wr->m_xp, d);
+  return dds_writecdr_impl_lowlevel (wr->m_wr, wr->m_xp, wr->m_coherent, d);
+}
+
+dds_return_t dds_write_begin_coherent (dds_writer *wr)
+{
+  /* Only a writer offering coherent access can have matching readers
+     that request it, for any other writer it is a no-op */
+  if (!wr->m_wr->xqos->presentation.coherent_access || wr->m_coherent != NULL)
+    return DDS_RETCODE_OK;
+  writer_begin_coherent (wr->m_wr);
+  wr->m_coherent = ddsrt_malloc (sizeof (*wr->m_coherent));
+  coherent_set_init (wr->m_coherent);
+  coherent_set_start (wr->m_coherent, 1);
+  return DDS_RETCODE_OK;
+}
+
+dds_return_t dds_write_end_coherent (dds_writer *wr)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct coherent_set * const cs = wr->m_coherent;
+  dds_return_t ret = DDS_RETCODE_OK;
+  int w_rc;
+
+  if (cs == NULL)
+    return DDS_RETCODE_OK;
+  wr->m_coherent = NULL;
+
+  thread_state_awake (ts1);
+  if ((w_rc = writer_end_coherent (ts1, wr->m_xp, wr->m_wr)) >= 0)
+  {
+    nn_xpack_send (wr->m_xp, false);
+  }
+  else if (w_rc == Q_ERR_TIMEOUT)
+  {
+    DDS_ERROR ("The writer could not deliver data on time, probably due to a reader resources being full\n");
+    ret = DDS_ERRNO (DDS_RETCODE_TIMEOUT);
+  }
+  else
+  {
+    DDS_ERROR ("Internal error\n");
+    ret = DDS_ERRNO (DDS_RETCODE_ERROR);
+  }
+  if (cs->incomplete)
+  {
+    DDS_TRACE ("coherent set exceeded %u samples, dropped\n", config.coherent_set_maxsamples);
+  }
+  else if (cs->n > 0)
+  {
+    dds_return_t ret1 = deliver_locally_coherent_set (wr->m_wr, cs);
+    if (ret == DDS_RETCODE_OK)
+      ret = ret1;
+  }
+  coherent_set_fini (cs);
+  thread_state_asleep (ts1);
+  ddsrt_free (cs);
+  return ret;
 }
 
 void dds_write_set_batch (bool enable)
@@ -26,7 +26,10 @@
 #include "dds__publisher.h"
 #include "dds__topic.h"
 #include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds__whc.h"
+#include "dds__write.h"
+#include "dds/ddsrt/heap.h"
 
 DECL_ENTITY_LOCK_UNLOCK(extern inline, dds_writer)
 
@@ -87,10 +90,14 @@ static void dds_writer_status_cb (void *ventity, const status_cb_data_t *data)
   void *vst = NULL;
   int32_t *reset[2] = { NULL, NULL };
 
+  const bool async = dds_entity_listeners_async ();
   ddsrt_mutex_lock (&entity->m_observers_lock);
-  while (entity->m_cb_count > 0)
-    ddsrt_cond_wait (&entity->m_observers_cond, &entity->m_observers_lock);
-  entity->m_cb_count++;
+  if (!async)
+  {
+    while (entity->m_cb_count > 0)
+      ddsrt_cond_wait (&entity->m_observers_cond, &entity->m_observers_lock);
+    entity->m_cb_count++;
+  }
 
   /* Reset the status for possible Listener call.
    * When a listener is not called, the status will be set (again). */
@@ -155,7 +162,11 @@ static void dds_writer_status_cb (void *ventity, const status_cb_data_t *data)
       assert (0);
   }
 
-  if (invoke)
+  if (invoke && async)
+  {
+    dds_entity_post_listener (entity, status_id);
+  }
+  else if (invoke)
   {
     ddsrt_mutex_unlock (&entity->m_observers_lock);
     dds_entity_invoke_listener(entity, status_id, vst);
@@ -169,11 +180,75 @@ static void dds_writer_status_cb (void *ventity, const status_cb_data_t *data)
     dds_entity_status_set (entity, 1u << status_id);
   }
 
-  entity->m_cb_count--;
-  ddsrt_cond_broadcast (&entity->m_observers_cond);
+  if (!async)
+  {
+    entity->m_cb_count--;
+    ddsrt_cond_broadcast (&entity->m_observers_cond);
+  }
   ddsrt_mutex_unlock (&entity->m_observers_lock);
 }
 
+static void dds_writer_deferred_listener (struct dds_entity *entity, enum dds_status_id status_id)
+{
+  /* Invoked on the listener thread pool with m_observers_lock held, see
+     dds_reader_deferred_listener */
+  dds_writer * const wr = (dds_writer *) entity;
+  struct dds_listener const * const lst = &entity->m_listener;
+  union {
+    dds_offered_deadline_missed_status_t offered_deadline_missed;
+    dds_liveliness_lost_status_t liveliness_lost;
+    dds_offered_incompatible_qos_status_t offered_incompatible_qos;
+    dds_publication_matched_status_t publication_matched;
+  } st;
+  bool invoke = false;
+
+  switch (status_id)
+  {
+    case DDS_OFFERED_DEADLINE_MISSED_STATUS_ID:
+      st.offered_deadline_missed = wr->m_offered_deadline_missed_status;
+      wr->m_offered_deadline_missed_status.total_count_change = 0;
+      invoke = (lst->on_offered_deadline_missed != 0);
+      break;
+    case DDS_LIVELINESS_LOST_STATUS_ID:
+      st.liveliness_lost = wr->m_liveliness_lost_status;
+      wr->m_liveliness_lost_status.total_count_change = 0;
+      invoke = (lst->on_liveliness_lost != 0);
+      break;
+    case DDS_OFFERED_INCOMPATIBLE_QOS_STATUS_ID:
+      st.offered_incompatible_qos = wr->m_offered_incompatible_qos_status;
+      wr->m_offered_incompatible_qos_status.total_count_change = 0;
+      invoke = (lst->on_offered_incompatible_qos != 0);
+      break;
+    case DDS_PUBLICATION_MATCHED_STATUS_ID:
+      st.publication_matched = wr->m_publication_matched_status;
+      wr->m_publication_matched_status.total_count_change = 0;
+      wr->m_publication_matched_status.current_count_change = 0;
+      invoke = (lst->on_publication_matched != 0);
+      break;
+    case DDS_DATA_AVAILABLE_STATUS_ID:
+    case DDS_INCONSISTENT_TOPIC_STATUS_ID:
+    case DDS_SAMPLE_LOST_STATUS_ID:
+    case DDS_DATA_ON_READERS_STATUS_ID:
+    case DDS_SAMPLE_REJECTED_STATUS_ID:
+    case DDS_LIVELINESS_CHANGED_STATUS_ID:
+    case DDS_SUBSCRIPTION_MATCHED_STATUS_ID:
+    case DDS_REQUESTED_DEADLINE_MISSED_STATUS_ID:
+    case DDS_REQUESTED_INCOMPATIBLE_QOS_STATUS_ID:
+      assert (0);
+  }
+
+  if (invoke)
+  {
+    ddsrt_mutex_unlock (&entity->m_observers_lock);
+    dds_entity_invoke_listener (entity, status_id, &st);
+    ddsrt_mutex_lock (&entity->m_observers_lock);
+  }
+  else
+  {
+    dds_entity_status_set (entity, 1u << status_id);
+  }
+}
+
 static uint32_t
 get_bandwidth_limit(
         nn_transport_priority_qospolicy_t transport_priority)
@@ -215,6 +290,13 @@ dds_writer_delete(
     /* FIXME: not freeing WHC here because it is owned by the DDSI entity */
     thread_state_awake (lookup_thread_state ());
     nn_xpack_free(wr->m_xp);
+    if (wr->m_last_tk)
+        ddsi_tkmap_instance_unref(wr->m_last_tk);
+    if (wr->m_coherent) {
+        /* an unfinished coherent set is never delivered */
+        coherent_set_fini(wr->m_coherent);
+        ddsrt_free(wr->m_coherent);
+    }
     thread_state_asleep (lookup_thread_state ());
     ret = dds_delete(wr->m_topic->m_entity.m_hdllink.hdl);
     if(ret == DDS_RETCODE_OK){
@@ -311,7 +393,12 @@ dds_writer_qos_set(
     return ret;
 }
 
-static struct whc *make_whc(const dds_qos_t *qos)
+static bool is_keyless_topic(const struct ddsi_sertopic *st)
+{
+  return st->ops == &ddsi_sertopic_ops_default && ((const struct ddsi_sertopic_default *)st)->nkeys == 0;
+}
+
+static struct whc *make_whc(const dds_qos_t *qos, const struct ddsi_sertopic *st)
 {
   bool handle_as_transient_local;
   unsigned hdepth, tldepth;
@@ -331,6 +418,10 @@ static struct whc *make_whc(const dds_qos_t *qos)
   } else {
     tldepth = 0;
   }
+  /* A volatile KEEP_LAST writer of a keyless topic holds a contiguous
+     range of sequence numbers, which a ring buffer handles cheaply */
+  if (!handle_as_transient_local && hdepth > 0 && is_keyless_topic(st))
+    return whc_ring_new (hdepth);
   return whc_new (handle_as_transient_local, hdepth, tldepth);
 }
 
@@ -419,8 +510,9 @@ dds_create_writer(
     wr->m_entity.m_deriver.delete = dds_writer_delete;
     wr->m_entity.m_deriver.set_qos = dds_writer_qos_set;
     wr->m_entity.m_deriver.validate_status = dds_writer_status_validate;
+    wr->m_entity.m_deriver.deferred_listener = dds_writer_deferred_listener;
     wr->m_entity.m_deriver.get_instance_hdl = dds_writer_instance_hdl;
-    wr->m_whc = make_whc (wqos);
+    wr->m_whc = make_whc (wqos, tp->m_stopic);
 
     /* Extra claim of this writer to make sure that the delete waits until DDSI
      * has deleted its writer as well. This can be known through the callback. */
@@ -434,6 +526,12 @@ dds_create_writer(
     ddsrt_mutex_lock (&pub->m_entity.m_mutex);
     ddsrt_mutex_lock (&tp->m_entity.m_mutex);
     assert(ret == DDS_RETCODE_OK);
+    if (pub->m_coherent_depth > 0) {
+        /* joining a publisher that is in the middle of a coherent set */
+        ddsrt_mutex_lock (&wr->m_entity.m_mutex);
+        (void) dds_write_begin_coherent (wr);
+        ddsrt_mutex_unlock (&wr->m_entity.m_mutex);
+    }
     thread_state_asleep (lookup_thread_state ());
     dds_topic_unlock(tp);
     dds_publisher_unlock(pub);
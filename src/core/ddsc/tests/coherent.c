@@ -0,0 +1,213 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include "dds/dds.h"
+#include "dds/version.h"
+#include "dds/ddsrt/environ.h"
+#include "Space.h"
+#include "CUnit/Test.h"
+
+#define MAX_SAMPLES  (10)
+
+#define URI_VARIABLE DDS_PROJECT_NAME_NOSPACE_CAPS"_URI"
+#define MAX_SET_SAMPLES  (4)
+
+static dds_entity_t g_participant = 0;
+static dds_entity_t g_topic = 0;
+static dds_entity_t g_publisher = 0;
+static dds_entity_t g_writer = 0;
+static dds_entity_t g_coh_reader = 0;
+static dds_entity_t g_plain_reader = 0;
+
+static void*             g_samples[MAX_SAMPLES];
+static Space_Type1       g_data[MAX_SAMPLES];
+static dds_sample_info_t g_info[MAX_SAMPLES];
+
+static void
+coherent_init(void)
+{
+    dds_entity_t sub;
+    dds_qos_t *qos;
+
+    memset (g_data, 0, sizeof (g_data));
+    for (int i = 0; i < MAX_SAMPLES; i++) {
+        g_samples[i] = &g_data[i];
+    }
+
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+
+    qos = dds_create_qos();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qos);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    g_topic = dds_create_topic(g_participant, &Space_Type1_desc, "ddsc_coherent", qos, NULL);
+    CU_ASSERT_FATAL(g_topic > 0);
+
+    /* Publisher and one subscriber request coherent access, the other doesn't. */
+    g_plain_reader = dds_create_reader(g_participant, g_topic, NULL, NULL);
+    CU_ASSERT_FATAL(g_plain_reader > 0);
+    dds_qset_presentation(qos, DDS_PRESENTATION_TOPIC, true, false);
+    g_publisher = dds_create_publisher(g_participant, qos, NULL);
+    CU_ASSERT_FATAL(g_publisher > 0);
+    sub = dds_create_subscriber(g_participant, qos, NULL);
+    CU_ASSERT_FATAL(sub > 0);
+    g_coh_reader = dds_create_reader(sub, g_topic, NULL, NULL);
+    CU_ASSERT_FATAL(g_coh_reader > 0);
+    g_writer = dds_create_writer(g_publisher, g_topic, NULL, NULL);
+    CU_ASSERT_FATAL(g_writer > 0);
+    dds_delete_qos(qos);
+}
+
+static void
+coherent_fini(void)
+{
+    dds_delete(g_participant);
+}
+
+static void
+coherent_limited_init(void)
+{
+    char uri[200];
+    (void) snprintf(uri, sizeof(uri), "<CycloneDDS><Internal><CoherentSetMaxSamples>%d</CoherentSetMaxSamples></Internal></CycloneDDS>", MAX_SET_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ddsrt_setenv(URI_VARIABLE, uri), DDS_RETCODE_OK);
+    coherent_init();
+}
+
+static void
+coherent_limited_fini(void)
+{
+    coherent_fini();
+    (void) ddsrt_unsetenv(URI_VARIABLE);
+}
+
+static void
+write_samples(int32_t first, int32_t n)
+{
+    for (int32_t i = first; i < first + n; i++) {
+        Space_Type1 sample = { i, i, i };
+        dds_return_t ret = dds_write(g_writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+}
+
+static int
+count_samples(dds_entity_t reader)
+{
+    dds_return_t ret = dds_read(reader, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_FATAL(ret >= 0);
+    return (int) ret;
+}
+
+CU_Test(ddsc_coherent, publisher, .init=coherent_init, .fini=coherent_fini)
+{
+    dds_return_t ret;
+
+    ret = dds_begin_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    write_samples(0, 3);
+    CU_ASSERT_EQUAL(count_samples(g_plain_reader), 3);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 0);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 3);
+
+    /* Outside a coherent set, data is delivered immediately. */
+    write_samples(3, 1);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 4);
+}
+
+CU_Test(ddsc_coherent, writer, .init=coherent_init, .fini=coherent_fini)
+{
+    dds_return_t ret;
+
+    /* A writer behaves as its publisher. */
+    ret = dds_begin_coherent(g_writer);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    write_samples(0, 2);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 0);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 2);
+}
+
+CU_Test(ddsc_coherent, nested, .init=coherent_init, .fini=coherent_fini)
+{
+    dds_return_t ret;
+
+    ret = dds_begin_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    write_samples(0, 1);
+    ret = dds_begin_coherent(g_writer);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    write_samples(1, 1);
+    ret = dds_end_coherent(g_writer);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 0);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 2);
+}
+
+CU_Test(ddsc_coherent, end_without_begin, .init=coherent_init, .fini=coherent_fini)
+{
+    dds_return_t ret;
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL(dds_err_nr(ret), DDS_RETCODE_PRECONDITION_NOT_MET);
+    ret = dds_begin_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ret = dds_end_coherent(g_writer);
+    CU_ASSERT_EQUAL(dds_err_nr(ret), DDS_RETCODE_PRECONDITION_NOT_MET);
+}
+
+CU_Test(ddsc_coherent, late_writer, .init=coherent_init, .fini=coherent_fini)
+{
+    dds_entity_t wr;
+    dds_return_t ret;
+    Space_Type1 sample = { 10, 10, 10 };
+
+    /* A writer created while a set is open joins it. */
+    ret = dds_begin_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    wr = dds_create_writer(g_publisher, g_topic, NULL, NULL);
+    CU_ASSERT_FATAL(wr > 0);
+    ret = dds_write(wr, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 0);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 1);
+}
+
+CU_Test(ddsc_coherent, max_samples, .init=coherent_limited_init, .fini=coherent_limited_fini)
+{
+    dds_return_t ret;
+
+    /* A set exceeding the limit is dropped for coherent readers only. */
+    ret = dds_begin_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    write_samples(0, MAX_SET_SAMPLES + 1);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), 0);
+    CU_ASSERT_EQUAL(count_samples(g_plain_reader), MAX_SET_SAMPLES + 1);
+
+    /* The next set is not affected by the previous one. */
+    ret = dds_begin_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    write_samples(MAX_SET_SAMPLES + 1, MAX_SET_SAMPLES);
+    ret = dds_end_coherent(g_publisher);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(count_samples(g_coh_reader), MAX_SET_SAMPLES);
+}
@@ -9,16 +9,21 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "dds/dds.h"
 #include "CUnit/Test.h"
 #include "config_env.h"
+#include "RoundTrip.h"
 
 #include "dds/version.h"
 #include "dds/ddsrt/cdtors.h"
 #include "dds/ddsrt/environ.h"
 #include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/q_config.h"
 
 #define FORCE_ENV
 
@@ -75,3 +80,127 @@ CU_Test(ddsc_config, simple_udp, .init = ddsrt_init, .fini = ddsrt_fini) {
 
     dds_delete(participant);
 }
+
+CU_Test(ddsc_config, static_discovery, .init = ddsrt_init, .fini = ddsrt_fini) {
+
+    /* A statically configured remote reader is matched as soon as the
+       writer is created, without any discovery data being exchanged */
+    const char *uri =
+        "<CycloneDDS><Discovery><Static>"
+        "<Exclusive>true</Exclusive>"
+        "<Participant GuidPrefix=\"1:2:3\" Address=\"127.0.0.1:7399\">"
+        "<Reader EntityId=\"0x107\" Topic=\"ddsc_config_static_discovery\" Type=\"RoundTripModule::DataType\"/>"
+        "</Participant>"
+        "</Static></Discovery></CycloneDDS>";
+    dds_entity_t participant, topic, writer;
+    dds_publication_matched_status_t status;
+    dds_return_t ret;
+
+    ret = ddsrt_setenv(URI_VARIABLE, uri);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+
+    participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(participant > 0);
+    topic = dds_create_topic(participant, &RoundTripModule_DataType_desc, "ddsc_config_static_discovery", NULL, NULL);
+    CU_ASSERT_FATAL(topic > 0);
+    writer = dds_create_writer(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(writer > 0);
+
+    ret = dds_get_publication_matched_status(writer, &status);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(status.current_count, 1);
+    CU_ASSERT_EQUAL(status.total_count, 1);
+
+    dds_delete(participant);
+}
+
+/* Creates a participant with CPUSET configured as the CPU set of the
+   debug monitor thread, which isn't started by default, so that the set
+   is parsed but no thread gets pinned; returns 0 if the configuration is
+   rejected */
+static dds_entity_t config__cpuset_participant(
+    const char *cpuset)
+{
+    char uri[512];
+    dds_entity_t participant;
+    dds_return_t ret;
+
+    (void) snprintf(uri, sizeof(uri),
+        "<CycloneDDS><Threads><Thread Name=\"debmon\">"
+        "<CpuSet>%s</CpuSet>"
+        "</Thread></Threads></CycloneDDS>", cpuset);
+    ret = ddsrt_setenv(URI_VARIABLE, uri);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    return (participant > 0) ? participant : 0;
+}
+
+static const struct config_cpuset *config__cpuset(void)
+{
+    const struct config_thread_properties_listelem *tp;
+    for (tp = config.thread_properties; tp; tp = tp->next) {
+        if (strcmp(tp->name, "debmon") == 0) {
+            return &tp->cpuset;
+        }
+    }
+    return NULL;
+}
+
+CU_Test(ddsc_config, cpuset, .init = ddsrt_init, .fini = ddsrt_fini) {
+
+    /* Lists and ranges, in any order and overlapping, give a sorted set
+       without duplicates */
+    static const struct {
+        const char *value;
+        uint32_t n;
+        uint32_t cpus[8];
+    } valid[] = {
+        { "any", 0, { 0 } },
+        { "ANY", 0, { 0 } },
+        { "3", 1, { 3 } },
+        { "0,2-3", 3, { 0, 2, 3 } },
+        { "5-7,1", 4, { 1, 5, 6, 7 } },
+        { "2-4,3,4-5,2", 4, { 2, 3, 4, 5 } },
+        { "4095", 1, { 4095 } }
+    };
+    static const char *invalid[] = {
+        ",", "1,", ",1", "1,,2", "a", "1a", "1-", "-1", "+1", "3-1", "1-2-3", "1;2", "4096", "0-4096", "4294967296"
+    };
+
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        dds_entity_t participant = config__cpuset_participant(valid[i].value);
+        const struct config_cpuset *cs;
+        CU_ASSERT_FATAL(participant > 0);
+        cs = config__cpuset();
+        CU_ASSERT_PTR_NOT_NULL_FATAL(cs);
+        CU_ASSERT_EQUAL(cs->n, valid[i].n);
+        if (cs->n == valid[i].n) {
+            for (uint32_t j = 0; j < cs->n; j++) {
+                CU_ASSERT_EQUAL(cs->cpus[j], valid[i].cpus[j]);
+            }
+        }
+        dds_delete(participant);
+    }
+
+    /* A large range */
+    {
+        dds_entity_t participant = config__cpuset_participant("0-1023");
+        const struct config_cpuset *cs;
+        CU_ASSERT_FATAL(participant > 0);
+        cs = config__cpuset();
+        CU_ASSERT_PTR_NOT_NULL_FATAL(cs);
+        CU_ASSERT_EQUAL_FATAL(cs->n, 1024);
+        for (uint32_t j = 0; j < cs->n; j++) {
+            CU_ASSERT_EQUAL(cs->cpus[j], j);
+        }
+        dds_delete(participant);
+    }
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        dds_entity_t participant = config__cpuset_participant(invalid[i]);
+        CU_ASSERT_EQUAL(participant, 0);
+        if (participant > 0) {
+            dds_delete(participant);
+        }
+    }
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+
+#include "dds/version.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsi/q_config.h"
+
+#define URI_VARIABLE DDS_PROJECT_NAME_NOSPACE_CAPS"_URI"
+
+#define KEY128 "000102030405060708090a0b0c0d0e0f"
+#define KEY256 KEY128 "101112131415161718191a1b1c1d1e1f"
+
+/* One network partition per cipher, "p1" .. "p5" */
+static const struct {
+    const char *cipher;
+    bool aead;
+} ciphers[] = {
+    { "aes128-gcm", true },
+    { "aes256-gcm", true },
+    { "chacha20-poly1305", true },
+    { "aes128", false },
+    { "aes256", false }
+};
+#define NCIPHERS (sizeof(ciphers) / sizeof(ciphers[0]))
+
+static const char config_uri[] =
+    "<CycloneDDS><Security>"
+    "<SecurityProfile Name=\"gcm128\" Cipher=\"aes128-gcm\" CipherKey=\"" KEY128 "\"/>"
+    "<SecurityProfile Name=\"gcm256\" Cipher=\"aes256-gcm\" CipherKey=\"" KEY256 "\"/>"
+    "<SecurityProfile Name=\"chacha\" Cipher=\"chacha20-poly1305\" CipherKey=\"" KEY256 "\"/>"
+    "<SecurityProfile Name=\"aes128\" Cipher=\"aes128\" CipherKey=\"" KEY128 "\"/>"
+    "<SecurityProfile Name=\"aes256\" Cipher=\"aes256\" CipherKey=\"" KEY256 "\"/>"
+    "</Security><Partitioning><NetworkPartitions>"
+    "<NetworkPartition Name=\"p1\" Address=\"239.255.0.1\" SecurityProfile=\"gcm128\"/>"
+    "<NetworkPartition Name=\"p2\" Address=\"239.255.0.2\" SecurityProfile=\"gcm256\"/>"
+    "<NetworkPartition Name=\"p3\" Address=\"239.255.0.3\" SecurityProfile=\"chacha\"/>"
+    "<NetworkPartition Name=\"p4\" Address=\"239.255.0.4\" SecurityProfile=\"aes128\"/>"
+    "<NetworkPartition Name=\"p5\" Address=\"239.255.0.5\" SecurityProfile=\"aes256\"/>"
+    "</NetworkPartitions></Partitioning></CycloneDDS>";
+
+#define MAX_PLAIN 1000
+#define MAX_HEADER 64
+
+struct msg {
+    unsigned char buf[MAX_PLAIN + MAX_HEADER];
+    uint32_t len;
+};
+
+static dds_entity_t g_participant;
+static q_securityEncoderSet g_enc;
+static q_securityDecoderSet g_dec;
+
+static void
+encryption_init(void)
+{
+    CU_ASSERT_EQUAL_FATAL(ddsrt_setenv(URI_VARIABLE, config_uri), DDS_RETCODE_OK);
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+    CU_ASSERT_EQUAL_FATAL(config.nof_networkPartitions, NCIPHERS);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(q_security_plugin.new_encoder);
+    g_enc = q_security_plugin.new_encoder();
+    g_dec = q_security_plugin.new_decoder();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_enc);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_dec);
+}
+
+static void
+encryption_fini(void)
+{
+    q_security_plugin.free_decoder(g_dec);
+    q_security_plugin.free_encoder(g_enc);
+    dds_delete(g_participant);
+}
+
+/* Returns the partition id of the network partition for ciphers[i] */
+static uint32_t
+partition_id(size_t i)
+{
+    char name[16];
+    (void) snprintf(name, sizeof(name), "p%u", (unsigned) i + 1);
+    for (struct config_networkpartition_listelem *p = config.networkPartitions; p; p = p->next) {
+        if (strcmp(p->name, name) == 0) {
+            return p->partitionId;
+        }
+    }
+    CU_FAIL_FATAL("network partition missing");
+    return 0;
+}
+
+static void
+plain(unsigned char *buf, uint32_t len, uint32_t seed)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = (unsigned char) (seed + 7 * i);
+    }
+}
+
+static void
+encode(q_securityEncoderSet enc, uint32_t partitionId, struct msg *m, uint32_t len, uint32_t seed)
+{
+    plain(m->buf, len, seed);
+    m->len = len;
+    CU_ASSERT_FATAL(q_security_plugin.encode(enc, partitionId, m->buf, sizeof(m->buf), &m->len));
+    CU_ASSERT_FATAL(m->len > len && m->len <= len + MAX_HEADER);
+}
+
+/* Decodes a copy, leaving the message itself intact for replaying it */
+static bool
+decode(const struct msg *m, uint32_t len, uint32_t seed)
+{
+    unsigned char buf[sizeof(m->buf)], ref[MAX_PLAIN];
+    size_t n = m->len;
+    memcpy(buf, m->buf, m->len);
+    if (!q_security_plugin.decode(g_dec, buf, sizeof(buf), &n)) {
+        return false;
+    }
+    plain(ref, len, seed);
+    CU_ASSERT_EQUAL(n, len);
+    CU_ASSERT(memcmp(buf, ref, len) == 0);
+    return true;
+}
+
+CU_Test(ddsc_encryption, roundtrip, .init=encryption_init, .fini=encryption_fini)
+{
+    static const uint32_t sizes[] = { 4, 16, 100, MAX_PLAIN };
+    for (size_t c = 0; c < NCIPHERS; c++) {
+        const uint32_t p = partition_id(c);
+        q_cipherType type;
+        CU_ASSERT_FATAL(q_security_plugin.cipher_type_from_string(ciphers[c].cipher, &type));
+        CU_ASSERT_EQUAL(q_security_plugin.encoder_type(g_enc, p), type);
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            struct msg m;
+            unsigned char ref[MAX_PLAIN];
+            encode(g_enc, p, &m, sizes[i], p);
+            plain(ref, sizes[i], p);
+            CU_ASSERT(memcmp(m.buf, ref, sizes[i]) != 0);
+            CU_ASSERT(decode(&m, sizes[i], p));
+        }
+    }
+}
+
+CU_Test(ddsc_encryption, tamper, .init=encryption_init, .fini=encryption_fini)
+{
+    /* Changing a single bit anywhere, in the payload or in the trailing
+       security header, must cause the message to be rejected */
+    for (size_t c = 0; c < NCIPHERS; c++) {
+        const uint32_t p = partition_id(c);
+        struct msg m;
+        encode(g_enc, p, &m, 32, p);
+        for (uint32_t i = 0; i < m.len; i++) {
+            struct msg t = m;
+            t.buf[i] ^= (unsigned char) (1u << (i % 8));
+            CU_ASSERT(!decode(&t, 32, p));
+        }
+        /* Truncated messages must be rejected as well */
+        for (uint32_t n = 4; n < m.len; n += 4) {
+            struct msg t = m;
+            memmove(t.buf, m.buf + m.len - n, n);
+            t.len = n;
+            CU_ASSERT(!decode(&t, 32, p));
+        }
+        CU_ASSERT(decode(&m, 32, p));
+    }
+}
+
+CU_Test(ddsc_encryption, replay, .init=encryption_init, .fini=encryption_fini)
+{
+    /* The authenticated ciphers reject messages they have accepted before */
+    for (size_t c = 0; c < NCIPHERS; c++) {
+        const uint32_t p = partition_id(c);
+        struct msg m[70];
+        if (!ciphers[c].aead) {
+            continue;
+        }
+        for (uint32_t i = 0; i < 70; i++) {
+            encode(g_enc, p, &m[i], 16, i);
+        }
+
+        /* Out-of-order is fine, but only once */
+        CU_ASSERT(decode(&m[1], 16, 1));
+        CU_ASSERT(!decode(&m[1], 16, 1));
+        CU_ASSERT(decode(&m[0], 16, 0));
+        CU_ASSERT(!decode(&m[0], 16, 0));
+        CU_ASSERT(!decode(&m[1], 16, 1));
+
+        /* Once the sender has moved on far enough, old messages that haven't
+           been received are rejected, too */
+        CU_ASSERT(decode(&m[69], 16, 69));
+        CU_ASSERT(!decode(&m[2], 16, 2));
+        CU_ASSERT(decode(&m[10], 16, 10));
+        CU_ASSERT(!decode(&m[10], 16, 10));
+        CU_ASSERT(!decode(&m[69], 16, 69));
+
+        /* Another sender is independent */
+        {
+            q_securityEncoderSet enc = q_security_plugin.new_encoder();
+            struct msg m1;
+            encode(enc, p, &m1, 16, 100);
+            CU_ASSERT(decode(&m1, 16, 100));
+            CU_ASSERT(!decode(&m1, 16, 100));
+            q_security_plugin.free_encoder(enc);
+        }
+    }
+}
+
+CU_Test(ddsc_encryption, replay_senders, .init=encryption_init, .fini=encryption_fini)
+{
+    /* A sender is never forgotten: once the decoder tracks as many senders as
+       it can, messages of new senders are rejected rather than making room
+       for them by forgetting which messages an old sender has sent */
+    const uint32_t p = partition_id(0);
+    q_securityEncoderSet encs[1000];
+    struct msg first, m;
+    uint32_t n = 0;
+    encode(g_enc, p, &first, 16, 0);
+    CU_ASSERT_FATAL(decode(&first, 16, 0));
+    do {
+        encs[n] = q_security_plugin.new_encoder();
+        CU_ASSERT_PTR_NOT_NULL_FATAL(encs[n]);
+        encode(encs[n], p, &m, 16, n);
+    } while (decode(&m, 16, n) && ++n < sizeof(encs) / sizeof(encs[0]) - 1);
+    CU_ASSERT_FATAL(n > 0 && n < sizeof(encs) / sizeof(encs[0]) - 1);
+    /* the new sender is still rejected, the old ones are still tracked */
+    encode(encs[n], p, &m, 16, n);
+    CU_ASSERT(!decode(&m, 16, n));
+    CU_ASSERT(!decode(&first, 16, 0));
+    encode(g_enc, p, &m, 16, 1);
+    CU_ASSERT(decode(&m, 16, 1));
+    for (uint32_t i = 0; i <= n; i++) {
+        q_security_plugin.free_encoder(encs[i]);
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+
+#include "dds/ddsi/q_radmin.h"
+
+#define GROUP_SIZE 4
+#define PKT_SIZE   100
+
+static struct nn_fec_decoder *g_dec;
+static nn_guid_prefix_t g_src;
+static unsigned char g_pkts[GROUP_SIZE][PKT_SIZE];
+static uint32_t g_lens[GROUP_SIZE];
+static unsigned char g_parity[PKT_SIZE];
+static uint32_t g_lenxor;
+
+static void
+fec_init(void)
+{
+    g_dec = nn_fec_decoder_new();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_dec);
+    memset(&g_src, 0x5a, sizeof(g_src));
+
+    /* A group of packets of different lengths, and the parity packet a
+       writer would send for it */
+    memset(g_parity, 0, sizeof(g_parity));
+    g_lenxor = 0;
+    for (int i = 0; i < GROUP_SIZE; i++) {
+        g_lens[i] = PKT_SIZE - 10 * (uint32_t) i;
+        for (uint32_t j = 0; j < g_lens[i]; j++) {
+            g_pkts[i][j] = (unsigned char) (31 * i + (int) j);
+        }
+        nn_fec_xor(g_parity, g_pkts[i], g_lens[i]);
+        g_lenxor ^= g_lens[i];
+    }
+}
+
+static void
+fec_fini(void)
+{
+    nn_fec_decoder_free(g_dec);
+}
+
+static const unsigned char *
+parity(uint32_t streamid, uint32_t firstseq, uint32_t *seq, uint32_t *len)
+{
+    return nn_fec_decoder_parity(g_dec, &g_src, streamid, firstseq, GROUP_SIZE, g_lenxor, g_parity, PKT_SIZE, seq, len);
+}
+
+CU_Test(ddsc_fec, recover_single_loss, .init=fec_init, .fini=fec_fini)
+{
+    for (int lost = 0; lost < GROUP_SIZE; lost++) {
+        const uint32_t firstseq = 1 + GROUP_SIZE * (uint32_t) lost;
+        const unsigned char *rec;
+        uint32_t seq, len;
+        for (int i = 0; i < GROUP_SIZE; i++) {
+            if (i != lost) {
+                CU_ASSERT(nn_fec_decoder_note_packet(g_dec, &g_src, 1, firstseq + (uint32_t) i, g_pkts[i], g_lens[i]));
+            }
+        }
+        rec = parity(1, firstseq, &seq, &len);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(rec);
+        CU_ASSERT_EQUAL(seq, firstseq + (uint32_t) lost);
+        CU_ASSERT_EQUAL_FATAL(len, g_lens[lost]);
+        CU_ASSERT(memcmp(rec, g_pkts[lost], len) == 0);
+
+        /* The reconstructed packet is a duplicate if the original turns up
+           late after all */
+        CU_ASSERT(!nn_fec_decoder_note_packet(g_dec, &g_src, 1, firstseq + (uint32_t) lost, g_pkts[lost], g_lens[lost]));
+    }
+}
+
+CU_Test(ddsc_fec, no_loss_or_double_loss, .init=fec_init, .fini=fec_fini)
+{
+    uint32_t seq, len;
+
+    /* Nothing to repair */
+    for (int i = 0; i < GROUP_SIZE; i++) {
+        CU_ASSERT(nn_fec_decoder_note_packet(g_dec, &g_src, 1, 1 + (uint32_t) i, g_pkts[i], g_lens[i]));
+    }
+    CU_ASSERT_PTR_NULL(parity(1, 1, &seq, &len));
+
+    /* A single parity packet can't repair two losses */
+    for (int i = 2; i < GROUP_SIZE; i++) {
+        CU_ASSERT(nn_fec_decoder_note_packet(g_dec, &g_src, 1, 1 + GROUP_SIZE + (uint32_t) i, g_pkts[i], g_lens[i]));
+    }
+    CU_ASSERT_PTR_NULL(parity(1, 1 + GROUP_SIZE, &seq, &len));
+
+    /* Nor can a parity packet for an unknown stream */
+    CU_ASSERT_PTR_NULL(parity(2, 1, &seq, &len));
+}
+
+CU_Test(ddsc_fec, duplicates, .init=fec_init, .fini=fec_fini)
+{
+    CU_ASSERT(nn_fec_decoder_note_packet(g_dec, &g_src, 1, 1, g_pkts[0], g_lens[0]));
+    CU_ASSERT(!nn_fec_decoder_note_packet(g_dec, &g_src, 1, 1, g_pkts[0], g_lens[0]));
+    /* The same sequence number in another stream is not a duplicate */
+    CU_ASSERT(nn_fec_decoder_note_packet(g_dec, &g_src, 2, 1, g_pkts[0], g_lens[0]));
+}
+
+CU_Test(ddsc_fec, memory_bound, .init=fec_init, .fini=fec_fini)
+{
+    /* Large packets in many streams must not make the decoder retain more
+       than a bounded amount of memory, while the stream in use continues
+       to work */
+    const uint32_t bigsize = 65000;
+    unsigned char *big = dds_alloc(bigsize);
+    size_t limit = 0;
+    uint32_t seq, len;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(big);
+    for (uint32_t streamid = 1; streamid <= 64; streamid++) {
+        for (uint32_t s = 1; s <= 128; s++) {
+            (void) nn_fec_decoder_note_packet(g_dec, &g_src, streamid, s, big, bigsize);
+        }
+        if (streamid == 1) {
+            limit = nn_fec_decoder_memsize(g_dec);
+        }
+        CU_ASSERT(nn_fec_decoder_memsize(g_dec) <= limit);
+    }
+    dds_free(big);
+    /* retaining every packet of the window of 16 streams would take 64MB */
+    CU_ASSERT(limit > 0 && limit <= 8 * 1024 * 1024);
+
+    for (int i = 1; i < GROUP_SIZE; i++) {
+        CU_ASSERT(nn_fec_decoder_note_packet(g_dec, &g_src, 1000, 1 + (uint32_t) i, g_pkts[i], g_lens[i]));
+    }
+    CU_ASSERT_PTR_NOT_NULL(parity(1000, 1, &seq, &len));
+    CU_ASSERT_EQUAL(seq, 1);
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dds/dds.h"
+#include "Space.h"
+#include "CUnit/Test.h"
+
+#define MAX_SAMPLES  (10)
+
+static dds_entity_t g_participant = 0;
+static dds_entity_t g_topic = 0;
+static dds_entity_t g_writer = 0;
+
+static void*             g_samples[MAX_SAMPLES];
+static Space_Type1       g_data[MAX_SAMPLES];
+static dds_sample_info_t g_info[MAX_SAMPLES];
+
+/* A trivial filter class: expression "long_1 >= %0" with an integer
+ * parameter is the only one understood. */
+static void *
+ge_compile(const dds_topic_descriptor_t *desc, const char *expression, uint32_t nparams, const char * const *params)
+{
+    int32_t *bound;
+    if (desc != &Space_Type1_desc || strcmp(expression, "long_1 >= %0") != 0 || nparams != 1) {
+        return NULL;
+    }
+    bound = malloc(sizeof(*bound));
+    *bound = (int32_t) atoi(params[0]);
+    return bound;
+}
+
+static bool
+ge_accept(const void *compiled, const void *sample)
+{
+    return ((const Space_Type1 *) sample)->long_1 >= *(const int32_t *) compiled;
+}
+
+static void
+ge_free(void *compiled)
+{
+    free(compiled);
+}
+
+static const dds_content_filter_class_t ge_class = {
+    "ddsc_filter_ge", ge_compile, ge_accept, ge_free
+};
+
+static void
+filter_init(void)
+{
+    dds_qos_t *qos;
+    dds_return_t ret;
+
+    memset (g_data, 0, sizeof (g_data));
+    for (int i = 0; i < MAX_SAMPLES; i++) {
+        g_samples[i] = &g_data[i];
+    }
+
+    /* Classes can't be unregistered, so the second time around it'll already be there. */
+    ret = dds_register_content_filter_class(&ge_class);
+    CU_ASSERT_FATAL(ret == DDS_RETCODE_OK || dds_err_nr(ret) == DDS_RETCODE_PRECONDITION_NOT_MET);
+
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+    qos = dds_create_qos();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qos);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    g_topic = dds_create_topic(g_participant, &Space_Type1_desc, "ddsc_filter", qos, NULL);
+    CU_ASSERT_FATAL(g_topic > 0);
+    g_writer = dds_create_writer(g_participant, g_topic, NULL, NULL);
+    CU_ASSERT_FATAL(g_writer > 0);
+    dds_delete_qos(qos);
+}
+
+static void
+filter_fini(void)
+{
+    dds_delete(g_participant);
+}
+
+CU_Test(ddsc_filter, register_twice, .init=filter_init, .fini=filter_fini)
+{
+    dds_return_t ret;
+    const dds_content_filter_class_t incomplete = { "ddsc_filter_incomplete", ge_compile, 0, ge_free };
+    ret = dds_register_content_filter_class(&ge_class);
+    CU_ASSERT_EQUAL(dds_err_nr(ret), DDS_RETCODE_PRECONDITION_NOT_MET);
+    ret = dds_register_content_filter_class(&incomplete);
+    CU_ASSERT_EQUAL(dds_err_nr(ret), DDS_RETCODE_BAD_PARAMETER);
+}
+
+CU_Test(ddsc_filter, invalid, .init=filter_init, .fini=filter_fini)
+{
+    const char *params[] = { "3" };
+    dds_entity_t rd;
+    rd = dds_create_filtered_reader(g_participant, g_topic, "ddsc_filter_unknown", "long_1 >= %0", 1, params, NULL, NULL);
+    CU_ASSERT_EQUAL(dds_err_nr(rd), DDS_RETCODE_BAD_PARAMETER);
+    rd = dds_create_filtered_reader(g_participant, g_topic, "ddsc_filter_ge", "long_2 >= %0", 1, params, NULL, NULL);
+    CU_ASSERT_EQUAL(dds_err_nr(rd), DDS_RETCODE_BAD_PARAMETER);
+    rd = dds_create_filtered_reader(g_participant, g_topic, "ddsc_filter_ge", NULL, 0, NULL, NULL, NULL);
+    CU_ASSERT_EQUAL(dds_err_nr(rd), DDS_RETCODE_BAD_PARAMETER);
+}
+
+CU_Test(ddsc_filter, local, .init=filter_init, .fini=filter_fini)
+{
+    const char *params[] = { "3" };
+    dds_entity_t frd, rd;
+    dds_return_t ret;
+
+    frd = dds_create_filtered_reader(g_participant, g_topic, "ddsc_filter_ge", "long_1 >= %0", 1, params, NULL, NULL);
+    CU_ASSERT_FATAL(frd > 0);
+    rd = dds_create_reader(g_participant, g_topic, NULL, NULL);
+    CU_ASSERT_FATAL(rd > 0);
+    for (int32_t i = 0; i < 6; i++) {
+        Space_Type1 sample = { i, i, i };
+        ret = dds_write(g_writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+
+    ret = dds_take(frd, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, 3);
+    for (int32_t i = 0; i < ret; i++) {
+        CU_ASSERT(g_data[i].long_1 >= 3);
+    }
+    ret = dds_take(rd, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL(ret, 6);
+}
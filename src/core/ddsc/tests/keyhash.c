@@ -0,0 +1,175 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+
+#include "dds/ddsrt/md5.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+
+/* A type with keys of all kinds mixed, so that each key is preceded by
+   padding that depends on the length of the string keys */
+#define BS_BOUND 6
+
+typedef struct Keys {
+    uint8_t c;
+    char *s;
+    uint16_t a[3];
+    char bs[BS_BOUND];
+    uint32_t e[5];
+    uint64_t d;
+} Keys;
+
+static const uint32_t Keys_ops[] = {
+    DDS_OP_ADR | DDS_OP_TYPE_1BY | DDS_OP_FLAG_KEY, offsetof(Keys, c),
+    DDS_OP_ADR | DDS_OP_TYPE_STR | DDS_OP_FLAG_KEY, offsetof(Keys, s),
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_2BY | DDS_OP_FLAG_KEY, offsetof(Keys, a), 3,
+    DDS_OP_ADR | DDS_OP_TYPE_BST | DDS_OP_FLAG_KEY, offsetof(Keys, bs), BS_BOUND,
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_4BY | DDS_OP_FLAG_KEY, offsetof(Keys, e), 5,
+    DDS_OP_ADR | DDS_OP_TYPE_8BY | DDS_OP_FLAG_KEY, offsetof(Keys, d),
+    DDS_OP_RTS
+};
+static const dds_key_descriptor_t Keys_keys[] = {
+    { "c", 0 }, { "s", 2 }, { "a", 4 }, { "bs", 7 }, { "e", 10 }, { "d", 13 }
+};
+static const dds_topic_descriptor_t Keys_desc = {
+    sizeof(Keys), sizeof(char *), DDS_TOPIC_NO_OPTIMIZE, 6u, "Keys", Keys_keys, 7, Keys_ops, ""
+};
+
+/* Reference big-endian CDR serialisation of the key, per the DDSI spec */
+struct ref {
+    unsigned char buf[1024];
+    uint32_t pos;
+};
+
+static void
+put(struct ref *r, uint32_t align, uint64_t v, uint32_t size)
+{
+    while (r->pos % align) {
+        r->buf[r->pos++] = 0;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        r->buf[r->pos++] = (unsigned char) (v >> (8 * (size - 1 - i)));
+    }
+}
+
+static void
+put_string(struct ref *r, const char *s)
+{
+    const uint32_t len = (uint32_t) strlen(s) + 1;
+    put(r, 4, len, 4);
+    memcpy(r->buf + r->pos, s, len);
+    r->pos += len;
+}
+
+static void
+ref_keyhash(const Keys *x, unsigned char hash[16])
+{
+    struct ref r;
+    ddsrt_md5_state_t md5st;
+    r.pos = 0;
+    put(&r, 1, x->c, 1);
+    put_string(&r, x->s);
+    for (int i = 0; i < 3; i++) {
+        put(&r, 2, x->a[i], 2);
+    }
+    put_string(&r, x->bs);
+    for (int i = 0; i < 5; i++) {
+        put(&r, 4, x->e[i], 4);
+    }
+    put(&r, 8, x->d, 8);
+    CU_ASSERT_FATAL(r.pos <= sizeof(r.buf));
+    ddsrt_md5_init(&md5st);
+    ddsrt_md5_append(&md5st, r.buf, r.pos);
+    ddsrt_md5_finish(&md5st, hash);
+}
+
+static dds_entity_t g_participant;
+static struct ddsi_sertopic_default g_topic;
+
+static void
+keyhash_init(void)
+{
+    /* serdata come from the pool of the domain */
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+    memset(&g_topic, 0, sizeof(g_topic));
+    g_topic.c.ops = &ddsi_sertopic_ops_default;
+    g_topic.c.serdata_ops = &ddsi_serdata_ops_cdr;
+    g_topic.type = (struct dds_topic_descriptor *) &Keys_desc;
+    g_topic.nkeys = Keys_desc.m_nkeys;
+    g_topic.keys = Keys_desc.m_keys;
+}
+
+static void
+keyhash_fini(void)
+{
+    dds_delete(g_participant);
+}
+
+/* Leaves garbage on the stack where the key is going to be serialised */
+static void
+dirty_stack(unsigned char v)
+{
+    volatile unsigned char junk[4096];
+    for (size_t i = 0; i < sizeof(junk); i++) {
+        junk[i] = v;
+    }
+}
+
+static void
+keyhash(const Keys *x, unsigned char v, unsigned char hash[16])
+{
+    struct ddsi_serdata *sd;
+    const struct ddsi_serdata_default *d;
+    dirty_stack(v);
+    sd = ddsi_serdata_from_sample(&g_topic.c, SDK_KEY, x);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sd);
+    d = (const struct ddsi_serdata_default *) sd;
+    CU_ASSERT(d->keyhash.m_set && !d->keyhash.m_iskey);
+    memcpy(hash, d->keyhash.m_hash, 16);
+    ddsi_serdata_unref(sd);
+}
+
+CU_Test(ddsc_keyhash, mixed_keys, .init=keyhash_init, .fini=keyhash_fini)
+{
+    /* String lengths up to well beyond what fits in dds_key_gen's stack
+       buffer, with every possible amount of padding after the strings */
+    char s[400];
+    for (uint32_t n = 0; n < sizeof(s); n++) {
+        for (uint32_t m = 0; m < BS_BOUND; m++) {
+            Keys x;
+            unsigned char ref[16], h1[16], h2[16];
+            memset(s, 'a' + (int) (n % 26), n);
+            s[n] = 0;
+            memset(&x, 0, sizeof(x));
+            x.c = (uint8_t) n;
+            x.s = s;
+            x.a[0] = 0x0102; x.a[1] = (uint16_t) n; x.a[2] = 0xfffe;
+            memset(x.bs, 'b', m);
+            for (uint32_t i = 0; i < 5; i++) {
+                x.e[i] = 0x01020304u * (i + 1) + n;
+            }
+            x.d = 0x0102030405060708ull + m;
+
+            ref_keyhash(&x, ref);
+            keyhash(&x, 0x00, h1);
+            keyhash(&x, 0xff, h2);
+            CU_ASSERT(memcmp(h1, ref, 16) == 0);
+            CU_ASSERT(memcmp(h2, ref, 16) == 0);
+        }
+    }
+}
@@ -0,0 +1,433 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+#include "Space.h"
+
+#include "dds/version.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/threads.h"
+
+/****************************************************************************
+ * Listeners invoked on a thread pool (Internal/ListenerThreads > 0): the
+ * invocations for an entity are ordered and never concurrent, repeated
+ * events are coalesced while the listener is pending or running, and
+ * deleting an entity works regardless of the state of its listener.
+ ****************************************************************************/
+
+#define URI_VARIABLE DDS_PROJECT_NAME_NOSPACE_CAPS"_URI"
+#define URI_FMT "<CycloneDDS><Internal><ListenerThreads>%d</ListenerThreads></Internal></CycloneDDS>"
+
+#define MAX_EVENTS 64
+
+static dds_entity_t g_participant = 0;
+static dds_entity_t g_topic = 0;
+static dds_entity_t g_topic2 = 0;
+
+static ddsrt_mutex_t g_mutex;
+static ddsrt_cond_t g_cond;
+
+/* event log of the listeners of the first reader, protected by g_mutex */
+static uint32_t g_events[MAX_EVENTS];
+static uint32_t g_nevents = 0;
+static uint32_t g_ndata_available = 0;
+static uint32_t g_ndata_available_other = 0;
+static int g_concurrent = 0;
+static int g_overlap = 0;
+static ddsrt_tid_t g_listener_tid;
+
+/* gate for blocking a listener invocation */
+static bool g_gate_entered = false;
+static bool g_gate_open = true;
+static bool g_listener_done = false;
+static dds_entity_t g_delete_from_listener = 0;
+static dds_return_t g_delete_result = 0;
+
+static void
+listener_threads_init(int nthreads)
+{
+    char uri[200];
+    dds_return_t ret;
+
+    ddsrt_init();
+    ddsrt_mutex_init(&g_mutex);
+    ddsrt_cond_init(&g_cond);
+    g_nevents = 0;
+    g_ndata_available = 0;
+    g_ndata_available_other = 0;
+    g_concurrent = 0;
+    g_overlap = 0;
+    g_gate_entered = false;
+    g_gate_open = true;
+    g_listener_done = false;
+    g_delete_from_listener = 0;
+    g_delete_result = 0;
+
+    (void) snprintf(uri, sizeof(uri), URI_FMT, nthreads);
+    ret = ddsrt_setenv(URI_VARIABLE, uri);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+    g_topic = dds_create_topic(g_participant, &Space_Type1_desc, "ddsc_listener_threads", NULL, NULL);
+    CU_ASSERT_FATAL(g_topic > 0);
+    g_topic2 = dds_create_topic(g_participant, &Space_Type1_desc, "ddsc_listener_threads2", NULL, NULL);
+    CU_ASSERT_FATAL(g_topic2 > 0);
+}
+
+static void
+listener_threads_init_1(void)
+{
+    listener_threads_init(1);
+}
+
+static void
+listener_threads_init_2(void)
+{
+    listener_threads_init(2);
+}
+
+static void
+listener_threads_fini(void)
+{
+    dds_delete(g_participant);
+    (void) ddsrt_unsetenv(URI_VARIABLE);
+    ddsrt_cond_destroy(&g_cond);
+    ddsrt_mutex_destroy(&g_mutex);
+    ddsrt_fini();
+}
+
+/* Waits until *flag is set or a few seconds have passed, with g_mutex held */
+static bool
+wait_for_locked(const bool *flag)
+{
+    const dds_time_t tend = dds_time() + DDS_SECS(5);
+    while (!*flag) {
+        if (!ddsrt_cond_waituntil(&g_cond, &g_mutex, tend))
+            return *flag;
+    }
+    return true;
+}
+
+static bool
+wait_for_count(const uint32_t *count, uint32_t expected)
+{
+    const dds_time_t tend = dds_time() + DDS_SECS(5);
+    bool res = true;
+    ddsrt_mutex_lock(&g_mutex);
+    while (*count < expected && res)
+        res = ddsrt_cond_waituntil(&g_cond, &g_mutex, tend);
+    res = (*count >= expected);
+    ddsrt_mutex_unlock(&g_mutex);
+    return res;
+}
+
+static void
+log_event(uint32_t status)
+{
+    /* called with g_mutex held */
+    if (g_nevents < MAX_EVENTS)
+        g_events[g_nevents++] = status;
+    if (status == DDS_DATA_AVAILABLE_STATUS)
+        g_ndata_available++;
+    ddsrt_cond_broadcast(&g_cond);
+}
+
+static void
+enter_listener(void)
+{
+    ddsrt_mutex_lock(&g_mutex);
+    if (g_concurrent++ > 0)
+        g_overlap = 1;
+    g_listener_tid = ddsrt_gettid();
+    ddsrt_mutex_unlock(&g_mutex);
+}
+
+static void
+leave_listener(uint32_t status)
+{
+    ddsrt_mutex_lock(&g_mutex);
+    g_concurrent--;
+    log_event(status);
+    ddsrt_mutex_unlock(&g_mutex);
+}
+
+static void
+subscription_matched_cb(dds_entity_t reader, const dds_subscription_matched_status_t status, void *arg)
+{
+    (void)reader;
+    (void)status;
+    (void)arg;
+    enter_listener();
+    dds_sleepfor(DDS_MSECS(10));
+    leave_listener(DDS_SUBSCRIPTION_MATCHED_STATUS);
+}
+
+static void
+data_available_cb(dds_entity_t reader, void *arg)
+{
+    (void)reader;
+    (void)arg;
+    enter_listener();
+    dds_sleepfor(DDS_MSECS(10));
+    leave_listener(DDS_DATA_AVAILABLE_STATUS);
+}
+
+static void
+gated_data_available_cb(dds_entity_t reader, void *arg)
+{
+    (void)reader;
+    (void)arg;
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_entered = true;
+    ddsrt_cond_broadcast(&g_cond);
+    (void) wait_for_locked(&g_gate_open);
+    if (g_delete_from_listener)
+        g_delete_result = dds_delete(g_delete_from_listener);
+    g_listener_done = true;
+    log_event(DDS_DATA_AVAILABLE_STATUS);
+    ddsrt_mutex_unlock(&g_mutex);
+}
+
+static void
+other_data_available_cb(dds_entity_t reader, void *arg)
+{
+    (void)reader;
+    (void)arg;
+    ddsrt_mutex_lock(&g_mutex);
+    g_ndata_available_other++;
+    ddsrt_cond_broadcast(&g_cond);
+    ddsrt_mutex_unlock(&g_mutex);
+}
+
+static uint32_t
+gate_opener(void *arg)
+{
+    (void)arg;
+    dds_sleepfor(DDS_MSECS(100));
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_open = true;
+    ddsrt_cond_broadcast(&g_cond);
+    ddsrt_mutex_unlock(&g_mutex);
+    return 0;
+}
+
+static dds_entity_t
+create_reader(dds_entity_t topic, dds_on_data_available_fn da, dds_on_subscription_matched_fn sm)
+{
+    dds_listener_t *listener = dds_create_listener(NULL);
+    dds_qos_t *qos = dds_create_qos();
+    dds_entity_t rd;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(listener);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    if (da)
+        dds_lset_data_available(listener, da);
+    if (sm)
+        dds_lset_subscription_matched(listener, sm);
+    rd = dds_create_reader(g_participant, topic, qos, listener);
+    CU_ASSERT_FATAL(rd > 0);
+    dds_delete_listener(listener);
+    dds_delete_qos(qos);
+    return rd;
+}
+
+static dds_entity_t
+create_writer(dds_entity_t topic)
+{
+    dds_qos_t *qos = dds_create_qos();
+    dds_entity_t wr;
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    wr = dds_create_writer(g_participant, topic, qos, NULL);
+    CU_ASSERT_FATAL(wr > 0);
+    dds_delete_qos(qos);
+    return wr;
+}
+
+static void
+write_sample(dds_entity_t wr, int32_t key)
+{
+    Space_Type1 sample = { key, 0, 0 };
+    dds_return_t ret = dds_write(wr, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+}
+
+CU_Test(ddsc_listener_threads, ordering, .init=listener_threads_init_2, .fini=listener_threads_fini)
+{
+    dds_entity_t rd, wr;
+
+    /* Matching precedes the data, so the listener must see them in that order,
+       on a thread from the pool and never concurrently even though there are
+       two threads in the pool */
+    rd = create_reader(g_topic, data_available_cb, subscription_matched_cb);
+    wr = create_writer(g_topic);
+    for (int32_t i = 0; i < 10; i++)
+        write_sample(wr, i);
+
+    CU_ASSERT_FATAL(wait_for_count(&g_ndata_available, 1));
+    dds_delete(rd);
+
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_FATAL(g_nevents >= 2);
+    CU_ASSERT_EQUAL(g_events[0], DDS_SUBSCRIPTION_MATCHED_STATUS);
+    for (uint32_t i = 1; i < g_nevents; i++)
+        CU_ASSERT_EQUAL(g_events[i], DDS_DATA_AVAILABLE_STATUS);
+    CU_ASSERT_EQUAL(g_overlap, 0);
+    CU_ASSERT_NOT_EQUAL(g_listener_tid, ddsrt_gettid());
+    ddsrt_mutex_unlock(&g_mutex);
+}
+
+CU_Test(ddsc_listener_threads, coalescing, .init=listener_threads_init_2, .fini=listener_threads_fini)
+{
+    dds_entity_t rd, wr;
+    void *samples[10];
+    dds_sample_info_t infos[10];
+    Space_Type1 data[10];
+    dds_return_t ret;
+
+    wr = create_writer(g_topic);
+    rd = create_reader(g_topic, gated_data_available_cb, 0);
+
+    /* First sample: the listener gets invoked and blocks */
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_open = false;
+    ddsrt_mutex_unlock(&g_mutex);
+    write_sample(wr, 0);
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_FATAL(wait_for_locked(&g_gate_entered));
+    ddsrt_mutex_unlock(&g_mutex);
+
+    /* The events for the next samples must be merged into one invocation */
+    for (int32_t i = 1; i < 10; i++)
+        write_sample(wr, i);
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_open = true;
+    ddsrt_cond_broadcast(&g_cond);
+    ddsrt_mutex_unlock(&g_mutex);
+
+    CU_ASSERT_FATAL(wait_for_count(&g_ndata_available, 2));
+    dds_sleepfor(DDS_MSECS(100));
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_EQUAL(g_ndata_available, 2);
+    ddsrt_mutex_unlock(&g_mutex);
+
+    /* None of the data got lost */
+    for (int i = 0; i < 10; i++)
+        samples[i] = &data[i];
+    ret = dds_take(rd, samples, infos, 10, 10);
+    CU_ASSERT_EQUAL(ret, 10);
+}
+
+CU_Test(ddsc_listener_threads, delete_while_running, .init=listener_threads_init_2, .fini=listener_threads_fini)
+{
+    dds_entity_t rd, wr;
+    dds_return_t ret;
+
+    wr = create_writer(g_topic);
+    rd = create_reader(g_topic, gated_data_available_cb, 0);
+
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_open = false;
+    ddsrt_mutex_unlock(&g_mutex);
+    write_sample(wr, 0);
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_FATAL(wait_for_locked(&g_gate_entered));
+    ddsrt_mutex_unlock(&g_mutex);
+
+    /* Deleting the reader must wait for the running listener: open the gate
+       from another thread so the deletion can complete */
+    {
+        ddsrt_thread_t tid;
+        ddsrt_threadattr_t attr;
+        ddsrt_threadattr_init(&attr);
+        ret = ddsrt_thread_create(&tid, "opener", &attr, gate_opener, NULL);
+        CU_ASSERT_FATAL(ret == DDS_RETCODE_OK);
+        ret = dds_delete(rd);
+        CU_ASSERT_EQUAL(ret, DDS_RETCODE_OK);
+        ddsrt_mutex_lock(&g_mutex);
+        CU_ASSERT(g_listener_done);
+        ddsrt_mutex_unlock(&g_mutex);
+        ddsrt_thread_join(tid, NULL);
+    }
+}
+
+CU_Test(ddsc_listener_threads, delete_while_queued, .init=listener_threads_init_1, .fini=listener_threads_fini)
+{
+    dds_entity_t rd, rd_other, wr, wr_other;
+    dds_return_t ret;
+
+    /* With a single listener thread, a listener on one reader deletes another
+       reader whose listener invocation is queued behind it: the deletion must
+       not wait for it, and the queued listener must not be invoked */
+    wr = create_writer(g_topic);
+    wr_other = create_writer(g_topic2);
+    rd = create_reader(g_topic, gated_data_available_cb, 0);
+    rd_other = create_reader(g_topic2, other_data_available_cb, 0);
+
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_open = false;
+    g_delete_from_listener = rd_other;
+    ddsrt_mutex_unlock(&g_mutex);
+    write_sample(wr, 0);
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_FATAL(wait_for_locked(&g_gate_entered));
+    ddsrt_mutex_unlock(&g_mutex);
+
+    write_sample(wr_other, 0);
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_open = true;
+    ddsrt_cond_broadcast(&g_cond);
+    CU_ASSERT_FATAL(wait_for_locked(&g_listener_done));
+    CU_ASSERT_EQUAL(g_delete_result, DDS_RETCODE_OK);
+    ddsrt_mutex_unlock(&g_mutex);
+
+    /* Give the queued job a chance to run */
+    dds_sleepfor(DDS_MSECS(100));
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_EQUAL(g_ndata_available_other, 0);
+    ddsrt_mutex_unlock(&g_mutex);
+
+    /* Deleting an entity from the application while its invocation is queued
+       behind a blocked one doesn't wait either */
+    rd_other = create_reader(g_topic2, other_data_available_cb, 0);
+    ddsrt_mutex_lock(&g_mutex);
+    g_gate_entered = false;
+    g_gate_open = false;
+    g_listener_done = false;
+    g_delete_from_listener = 0;
+    ddsrt_mutex_unlock(&g_mutex);
+    write_sample(wr, 1);
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_FATAL(wait_for_locked(&g_gate_entered));
+    ddsrt_mutex_unlock(&g_mutex);
+    write_sample(wr_other, 1);
+    ret = dds_delete(rd_other);
+    CU_ASSERT_EQUAL(ret, DDS_RETCODE_OK);
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT(!g_listener_done);
+    g_gate_open = true;
+    ddsrt_cond_broadcast(&g_cond);
+    CU_ASSERT_FATAL(wait_for_locked(&g_listener_done));
+    ddsrt_mutex_unlock(&g_mutex);
+    dds_sleepfor(DDS_MSECS(100));
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_EQUAL(g_ndata_available_other, 0);
+    ddsrt_mutex_unlock(&g_mutex);
+
+    ret = dds_delete(rd);
+    CU_ASSERT_EQUAL(ret, DDS_RETCODE_OK);
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+
+#include "dds/ddsrt/endian.h"
+#include "dds/ddsi/q_error.h"
+#include "dds/ddsi/q_plist.h"
+#include "dds/ddsi/q_protocol.h"
+
+/* nn_plist_findparam_checking scans received discovery data for a single
+   parameter before (and instead of) parsing it, so it must cope with any
+   garbage without reading outside the buffer */
+
+#define GUID_OFFSET 16 /* USER_DATA header + 8 bytes, ENDPOINT_GUID header */
+
+struct pl {
+    unsigned char buf[64];
+    size_t size;
+    int encoding;
+};
+
+static void
+put_u16(struct pl *pl, uint16_t x, bool bswap)
+{
+    if (bswap) {
+        x = (uint16_t) ((x >> 8) | (x << 8));
+    }
+    memcpy(pl->buf + pl->size, &x, sizeof(x));
+    pl->size += sizeof(x);
+}
+
+static void
+put_param(struct pl *pl, uint16_t pid, uint16_t len, bool bswap)
+{
+    put_u16(pl, pid, bswap);
+    put_u16(pl, len, bswap);
+    for (uint16_t i = 0; i < len; i++) {
+        pl->buf[pl->size++] = (unsigned char) (pid + i);
+    }
+}
+
+/* USER_DATA (8 bytes), ENDPOINT_GUID (16 bytes), SENTINEL in native or in
+   swapped byte order */
+static void
+make_pl(struct pl *pl, bool bswap)
+{
+    const bool le = ((DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) != bswap);
+    pl->size = 0;
+    pl->encoding = le ? PL_CDR_LE : PL_CDR_BE;
+    put_param(pl, PID_USER_DATA, 8, bswap);
+    put_param(pl, PID_ENDPOINT_GUID, 16, bswap);
+    put_param(pl, PID_SENTINEL, 0, bswap);
+}
+
+static int
+findparam(const struct pl *pl, size_t size, nn_parameterid_t pid, const unsigned char **value, uint16_t *length)
+{
+    nn_plist_src_t src;
+    memset(&src, 0, sizeof(src));
+    src.encoding = pl->encoding;
+    src.buf = pl->buf;
+    src.bufsz = size;
+    return nn_plist_findparam_checking(&src, pid, value, length);
+}
+
+CU_Test(ddsc_plist, findparam)
+{
+    for (int bswap = 0; bswap <= 1; bswap++) {
+        const unsigned char *value;
+        uint16_t length;
+        struct pl pl;
+        make_pl(&pl, bswap);
+        CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_ENDPOINT_GUID, &value, &length), 0);
+        CU_ASSERT_EQUAL(value, pl.buf + GUID_OFFSET);
+        CU_ASSERT_EQUAL(length, 16);
+        CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_USER_DATA, &value, &length), 0);
+        CU_ASSERT_EQUAL(value, pl.buf + 4);
+        CU_ASSERT_EQUAL(length, 8);
+        /* absent: success, but no value */
+        CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_PARTICIPANT_GUID, &value, &length), 0);
+        CU_ASSERT_PTR_NULL(value);
+        CU_ASSERT_EQUAL(length, 0);
+    }
+}
+
+CU_Test(ddsc_plist, findparam_encoding)
+{
+    const unsigned char *value;
+    uint16_t length;
+    struct pl pl;
+    /* only parameter lists, and the lengths are interpreted according to the
+       encoding: in the wrong byte order, USER_DATA is 2048 bytes long */
+    make_pl(&pl, false);
+    pl.encoding = (pl.encoding == PL_CDR_LE) ? PL_CDR_BE : PL_CDR_LE;
+    CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_ENDPOINT_GUID, &value, &length), Q_ERR_INVALID);
+    pl.encoding = 0; /* CDR_BE */
+    CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_ENDPOINT_GUID, &value, &length), Q_ERR_INVALID);
+    pl.encoding = PL_CDR_LE & ~PL_CDR_BE; /* CDR_LE */
+    CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_ENDPOINT_GUID, &value, &length), Q_ERR_INVALID);
+}
+
+CU_Test(ddsc_plist, findparam_truncated)
+{
+    for (int bswap = 0; bswap <= 1; bswap++) {
+        const unsigned char *value;
+        uint16_t length;
+        struct pl pl;
+        make_pl(&pl, bswap);
+        for (size_t size = 0; size < pl.size; size++) {
+            /* without the sentinel, the absence of a parameter can't be
+               established */
+            CU_ASSERT_EQUAL(findparam(&pl, size, PID_PARTICIPANT_GUID, &value, &length), Q_ERR_INVALID);
+            /* the parameter itself must be complete, what follows it is of
+               no interest */
+            if (size < GUID_OFFSET + 16) {
+                CU_ASSERT_EQUAL(findparam(&pl, size, PID_ENDPOINT_GUID, &value, &length), Q_ERR_INVALID);
+            } else {
+                CU_ASSERT_EQUAL(findparam(&pl, size, PID_ENDPOINT_GUID, &value, &length), 0);
+                CU_ASSERT_EQUAL(value, pl.buf + GUID_OFFSET);
+            }
+        }
+    }
+}
+
+CU_Test(ddsc_plist, findparam_malformed)
+{
+    for (int bswap = 0; bswap <= 1; bswap++) {
+        const unsigned char *value;
+        uint16_t length;
+        struct pl pl;
+
+        /* lengths must be a multiple of 4 (DDSI 9.4.2.11) */
+        for (uint16_t len = 1; len < 4; len++) {
+            pl.size = 0;
+            pl.encoding = ((DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) != bswap) ? PL_CDR_LE : PL_CDR_BE;
+            put_param(&pl, PID_USER_DATA, (uint16_t) (4 + len), bswap);
+            put_param(&pl, PID_ENDPOINT_GUID, 16, bswap);
+            put_param(&pl, PID_SENTINEL, 0, bswap);
+            CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_ENDPOINT_GUID, &value, &length), Q_ERR_INVALID);
+            CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_PARTICIPANT_GUID, &value, &length), Q_ERR_INVALID);
+        }
+
+        /* a length pointing beyond the end, far or only by one byte */
+        make_pl(&pl, bswap);
+        pl.buf[2] = pl.buf[3] = 0xf0;
+        CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_USER_DATA, &value, &length), Q_ERR_INVALID);
+        CU_ASSERT_EQUAL(findparam(&pl, pl.size, PID_ENDPOINT_GUID, &value, &length), Q_ERR_INVALID);
+        make_pl(&pl, bswap);
+        CU_ASSERT_EQUAL(findparam(&pl, 12, PID_USER_DATA, &value, &length), 0);
+        CU_ASSERT_EQUAL(findparam(&pl, 11, PID_USER_DATA, &value, &length), Q_ERR_INVALID);
+
+        /* nothing at all, or less than a parameter header */
+        make_pl(&pl, bswap);
+        CU_ASSERT_EQUAL(findparam(&pl, 0, PID_SENTINEL, &value, &length), Q_ERR_INVALID);
+        CU_ASSERT_EQUAL(findparam(&pl, 3, PID_SENTINEL, &value, &length), Q_ERR_INVALID);
+    }
+}
@@ -1562,3 +1562,88 @@ CU_Test(ddsc_querycondition_take, some_from_instance, .init=querycondition_init_
     CU_ASSERT_EQUAL_FATAL (ret, DDS_RETCODE_OK);
 }
 /*************************************************************************************************/
+
+/**************************************************************************************************
+ *
+ * These will check queryconditions with a batch filter.
+ *
+ *************************************************************************************************/
+static void
+batch_filter_mod2(const void * const *samples, bool *matches, uint32_t count, void *arg)
+{
+    uint32_t *ncalls = arg;
+    (*ncalls)++;
+    for (uint32_t i = 0; i < count; i++) {
+        matches[i] = filter_mod2(samples[i]);
+    }
+}
+
+static void
+check_read_batch(dds_entity_t condition, int exp_count)
+{
+    dds_return_t ret;
+    ret = dds_read(condition, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(ret, exp_count);
+    for(int i = 0; i < ret; i++) {
+        Space_Type1 *sample = (Space_Type1*)g_samples[i];
+        CU_ASSERT_EQUAL_FATAL(sample->long_1 % 2, 0);
+        CU_ASSERT_EQUAL_FATAL(g_info[i].valid_data, true);
+    }
+}
+
+CU_Test(ddsc_querycondition_batch, invalid_params, .init=querycondition_init, .fini=querycondition_fini)
+{
+    dds_entity_t cond;
+    uint32_t ncalls = 0;
+    cond = dds_create_querycondition_batch(g_reader, DDS_ANY_STATE, 0, &ncalls, 0);
+    CU_ASSERT_EQUAL_FATAL(dds_err_nr(cond), DDS_RETCODE_BAD_PARAMETER);
+    cond = dds_create_querycondition_batch(g_reader, DDS_ANY_STATE, batch_filter_mod2, &ncalls, ~DDS_QUERYCOND_KEY_ONLY);
+    CU_ASSERT_EQUAL_FATAL(dds_err_nr(cond), DDS_RETCODE_BAD_PARAMETER);
+}
+
+CU_Test(ddsc_querycondition_batch, any, .init=querycondition_init, .fini=querycondition_fini)
+{
+    dds_entity_t condition;
+    uint32_t ncalls = 0;
+
+    /* The history has to be evaluated when creating the condition, which should be
+       done in far fewer calls than there are instances and samples. */
+    condition = dds_create_querycondition_batch(g_reader, DDS_ANY_STATE, batch_filter_mod2, &ncalls, 0);
+    CU_ASSERT_FATAL(condition > 0);
+    CU_ASSERT(ncalls > 0 && ncalls < MAX_SAMPLES);
+    check_read_batch(condition, 4);
+    dds_delete(condition);
+}
+
+CU_Test(ddsc_querycondition_batch, key_only, .init=querycondition_init, .fini=querycondition_fini)
+{
+    dds_entity_t condition;
+    dds_return_t ret;
+    uint32_t ncalls = 0;
+
+    /* long_1 is the key, so filter_mod2 is key-only */
+    condition = dds_create_querycondition_batch(g_reader, DDS_ANY_STATE, batch_filter_mod2, &ncalls, DDS_QUERYCOND_KEY_ONLY);
+    CU_ASSERT_FATAL(condition > 0);
+    check_read_batch(condition, 4);
+
+    /* Writing new samples for existing instances mustn't involve the filter anymore */
+    ncalls = 0;
+    for (int i = 0; i < MAX_SAMPLES; i++) {
+        const Space_Type1 sample = { i, i, i };
+        ret = dds_write(g_writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+    CU_ASSERT_EQUAL(ncalls, 0);
+    check_read_batch(condition, 4);
+
+    /* A new instance does require evaluating it */
+    {
+        const Space_Type1 sample = { 8, 0, 0 };
+        ret = dds_write(g_writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+    CU_ASSERT_EQUAL(ncalls, 1);
+    check_read_batch(condition, 5);
+    dds_delete(condition);
+}
+/*************************************************************************************************/
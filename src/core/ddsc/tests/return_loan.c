@@ -138,3 +138,58 @@ CU_Test(ddsc_reader, return_loan_success, .init = create_entities, .fini = delet
     CU_ASSERT_EQUAL(dds_err_nr(result), DDS_RETCODE_OK);
     delete_loan_buf(buf, 10, true);
 }
+
+/* Verify that a reader can have multiple loans outstanding, and that
+   returned loans are reused */
+CU_Test(ddsc_reader, return_loan_multiple_outstanding, .init = create_entities, .fini = delete_entities)
+{
+    dds_entity_t rd, wr;
+    dds_qos_t *qos;
+    dds_sample_info_t si[3];
+    void *buf1[3] = { NULL }, *buf2[3] = { NULL }, *buf3[3] = { NULL };
+    dds_return_t result;
+    int32_t n, i;
+
+    qos = dds_create_qos();
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    rd = dds_create_reader(participant, topic, qos, NULL);
+    CU_ASSERT_FATAL(rd > 0);
+    dds_delete_qos(qos);
+    wr = dds_create_writer(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(wr > 0);
+
+    for (i = 0; i < 3; i++) {
+        uint8_t payload[3] = { 0, 0, 0 };
+        RoundTripModule_DataType s;
+        memset(payload, 'a' + i, sizeof(payload));
+        s.payload._maximum = s.payload._length = (uint32_t)(i + 1);
+        s.payload._buffer = payload;
+        s.payload._release = false;
+        result = dds_write(wr, &s);
+        CU_ASSERT_EQUAL_FATAL(result, DDS_RETCODE_OK);
+    }
+
+    n = dds_read(rd, buf1, si, 3, 3);
+    CU_ASSERT_EQUAL_FATAL(n, 3);
+    n = dds_read(rd, buf2, si, 3, 3);
+    CU_ASSERT_EQUAL_FATAL(n, 3);
+    CU_ASSERT(buf1[0] != buf2[0]);
+    for (i = 0; i < 3; i++) {
+        const RoundTripModule_DataType *s1 = buf1[i], *s2 = buf2[i];
+        CU_ASSERT_EQUAL_FATAL(s1->payload._length, (uint32_t)(i + 1));
+        CU_ASSERT_EQUAL_FATAL(s2->payload._length, (uint32_t)(i + 1));
+        CU_ASSERT(s1->payload._buffer != s2->payload._buffer);
+        CU_ASSERT(memcmp(s1->payload._buffer, s2->payload._buffer, (size_t)(i + 1)) == 0);
+        CU_ASSERT(s1->payload._buffer[i] == 'a' + i);
+    }
+
+    result = dds_return_loan(rd, buf1, 3);
+    CU_ASSERT_EQUAL(dds_err_nr(result), DDS_RETCODE_OK);
+    n = dds_take(rd, buf3, si, 3, 3);
+    CU_ASSERT_EQUAL(n, 3);
+    CU_ASSERT(buf3[0] != buf2[0]);
+    result = dds_return_loan(rd, buf3, 3);
+    CU_ASSERT_EQUAL(dds_err_nr(result), DDS_RETCODE_OK);
+    result = dds_return_loan(rd, buf2, 3);
+    CU_ASSERT_EQUAL(dds_err_nr(result), DDS_RETCODE_OK);
+}
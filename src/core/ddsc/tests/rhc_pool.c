@@ -0,0 +1,198 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+#include "Space.h"
+
+#include "dds__entity.h"
+#include "dds__types.h"
+#include "dds__rhc.h"
+#include "dds/ddsi/q_entity.h"
+
+/* Every instance embeds a sample, so a history of N samples in an
+   instance takes N-1 elements from the sample pool */
+#define N_INSTANCES       3
+#define N_PER_INSTANCE    4
+#define N_POOLED_SAMPLES  (N_INSTANCES * (N_PER_INSTANCE - 1))
+#define MAX_SAMPLES       (N_INSTANCES * N_PER_INSTANCE)
+
+static dds_entity_t g_participant = 0;
+static dds_entity_t g_topic = 0;
+static dds_entity_t g_writer = 0;
+static dds_entity_t g_reader = 0;
+
+static void*             g_samples[MAX_SAMPLES];
+static Space_Type1       g_data[MAX_SAMPLES];
+static dds_sample_info_t g_info[MAX_SAMPLES];
+
+static void
+rhc_pool_init(void)
+{
+    dds_qos_t *qos;
+
+    memset (g_data, 0, sizeof (g_data));
+    for (int i = 0; i < MAX_SAMPLES; i++) {
+        g_samples[i] = &g_data[i];
+    }
+
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+
+    qos = dds_create_qos();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qos);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    dds_qset_writer_data_lifecycle(qos, false);
+    g_topic = dds_create_topic(g_participant, &Space_Type1_desc, "ddsc_rhc_pool", qos, NULL);
+    CU_ASSERT_FATAL(g_topic > 0);
+    g_writer = dds_create_writer(g_participant, g_topic, qos, NULL);
+    CU_ASSERT_FATAL(g_writer > 0);
+    g_reader = dds_create_reader(g_participant, g_topic, qos, NULL);
+    CU_ASSERT_FATAL(g_reader > 0);
+    dds_delete_qos(qos);
+}
+
+static void
+rhc_pool_fini(void)
+{
+    dds_delete(g_participant);
+}
+
+static void
+get_pool_stats(dds_entity_t rd, struct dds_rhc_pool_stats *samples, struct dds_rhc_pool_stats *instances)
+{
+    dds_entity *e;
+    CU_ASSERT_FATAL(dds_entity_lock(rd, DDS_KIND_READER, &e) == DDS_RETCODE_OK);
+    dds_rhc_get_pool_stats(((dds_reader *) e)->m_rd->rhc, samples, instances);
+    dds_entity_unlock(e);
+}
+
+static void
+write_samples(void)
+{
+    for (int32_t j = 0; j < N_PER_INSTANCE; j++) {
+        for (int32_t i = 0; i < N_INSTANCES; i++) {
+            Space_Type1 s = { i, j, 0 };
+            CU_ASSERT_FATAL(dds_write(g_writer, &s) == DDS_RETCODE_OK);
+        }
+    }
+}
+
+CU_Test(ddsc_rhc_pool, write_take_delete, .init=rhc_pool_init, .fini=rhc_pool_fini)
+{
+    struct dds_rhc_pool_stats samples, instances;
+    dds_return_t ret;
+
+    get_pool_stats(g_reader, &samples, &instances);
+    CU_ASSERT_EQUAL(samples.inuse, 0);
+    CU_ASSERT_EQUAL(samples.nallocs, 0);
+    CU_ASSERT_EQUAL(instances.inuse, 0);
+
+    /* Local delivery is synchronous, so all samples are in the reader now */
+    write_samples();
+    get_pool_stats(g_reader, &samples, &instances);
+    CU_ASSERT_EQUAL(samples.inuse, N_POOLED_SAMPLES);
+    CU_ASSERT_EQUAL(samples.peak, N_POOLED_SAMPLES);
+    CU_ASSERT(samples.capacity >= samples.inuse);
+    CU_ASSERT(samples.nslabs >= 1);
+    CU_ASSERT_EQUAL(instances.inuse, N_INSTANCES);
+    CU_ASSERT_EQUAL(instances.peak, N_INSTANCES);
+
+    /* Taking returns the samples to the pool, the memory is retained so all
+       of the capacity is now free */
+    {
+        const uint32_t capacity = samples.capacity;
+        ret = dds_take(g_reader, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+        CU_ASSERT_EQUAL_FATAL(ret, MAX_SAMPLES);
+        get_pool_stats(g_reader, &samples, &instances);
+        CU_ASSERT_EQUAL(samples.inuse, 0);
+        CU_ASSERT_EQUAL(samples.peak, N_POOLED_SAMPLES);
+        CU_ASSERT_EQUAL(samples.capacity, capacity);
+        CU_ASSERT_EQUAL(instances.inuse, N_INSTANCES);
+    }
+
+    /* Writing again reuses the free elements rather than growing the pool */
+    {
+        const uint32_t nslabs = samples.nslabs, capacity = samples.capacity;
+        const uint64_t nallocs = samples.nallocs;
+        write_samples();
+        get_pool_stats(g_reader, &samples, &instances);
+        CU_ASSERT_EQUAL(samples.inuse, N_POOLED_SAMPLES);
+        CU_ASSERT_EQUAL(samples.peak, N_POOLED_SAMPLES);
+        CU_ASSERT_EQUAL(samples.nslabs, nslabs);
+        CU_ASSERT_EQUAL(samples.capacity, capacity);
+        CU_ASSERT_EQUAL(samples.nallocs, nallocs + N_POOLED_SAMPLES);
+        CU_ASSERT_EQUAL(instances.inuse, N_INSTANCES);
+    }
+
+    /* Deleting the writer unregisters the instances, taking the last of their
+       samples then returns the instances to the pool */
+    {
+        const uint32_t capacity = instances.capacity;
+        ret = dds_delete(g_writer);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        do {
+            ret = dds_take(g_reader, g_samples, g_info, MAX_SAMPLES, MAX_SAMPLES);
+            CU_ASSERT_FATAL(ret >= 0);
+        } while (ret > 0);
+        get_pool_stats(g_reader, &samples, &instances);
+        CU_ASSERT_EQUAL(samples.inuse, 0);
+        CU_ASSERT_EQUAL(instances.inuse, 0);
+        CU_ASSERT_EQUAL(instances.peak, N_INSTANCES);
+        CU_ASSERT_EQUAL(instances.capacity, capacity);
+    }
+
+    /* Deleting a reader with samples still in its pools frees them */
+    {
+        dds_entity_t rd = dds_create_reader(g_participant, g_topic, NULL, NULL);
+        dds_entity_t wr = dds_create_writer(g_participant, g_topic, NULL, NULL);
+        CU_ASSERT_FATAL(rd > 0);
+        CU_ASSERT_FATAL(wr > 0);
+        g_writer = wr;
+        write_samples();
+        get_pool_stats(rd, &samples, &instances);
+        CU_ASSERT_EQUAL(samples.inuse, N_POOLED_SAMPLES);
+        CU_ASSERT_EQUAL(instances.inuse, N_INSTANCES);
+        ret = dds_delete(rd);
+        CU_ASSERT_EQUAL(ret, DDS_RETCODE_OK);
+        ret = dds_delete(g_reader);
+        CU_ASSERT_EQUAL(ret, DDS_RETCODE_OK);
+    }
+}
+
+CU_Test(ddsc_rhc_pool, resource_limits, .init=rhc_pool_init, .fini=rhc_pool_fini)
+{
+    struct dds_rhc_pool_stats samples, instances;
+    dds_qos_t *qos;
+    dds_entity_t rd;
+
+    /* With resource limits, the pools are sized once to hold everything */
+    qos = dds_create_qos();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qos);
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    dds_qset_resource_limits(qos, MAX_SAMPLES, N_INSTANCES, N_PER_INSTANCE);
+    rd = dds_create_reader(g_participant, g_topic, qos, NULL);
+    CU_ASSERT_FATAL(rd > 0);
+    dds_delete_qos(qos);
+
+    write_samples();
+    get_pool_stats(rd, &samples, &instances);
+    CU_ASSERT_EQUAL(samples.inuse, N_POOLED_SAMPLES);
+    CU_ASSERT_EQUAL(samples.nslabs, 1);
+    CU_ASSERT_EQUAL(samples.capacity, MAX_SAMPLES);
+    CU_ASSERT_EQUAL(instances.inuse, N_INSTANCES);
+    CU_ASSERT_EQUAL(instances.nslabs, 1);
+    CU_ASSERT_EQUAL(instances.capacity, N_INSTANCES);
+}
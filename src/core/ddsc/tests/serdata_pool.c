@@ -0,0 +1,86 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/q_globals.h"
+
+/* The limit on the memory held by each size class of the pool */
+#define MAX_POOL_BYTES (8192 * 128)
+
+typedef struct Blob {
+    char *s;
+} Blob;
+
+static const uint32_t Blob_ops[] = {
+    DDS_OP_ADR | DDS_OP_TYPE_STR, offsetof(Blob, s),
+    DDS_OP_RTS
+};
+static const dds_topic_descriptor_t Blob_desc = {
+    sizeof(Blob), sizeof(char *), DDS_TOPIC_NO_OPTIMIZE, 0u, "Blob", NULL, 2, Blob_ops, ""
+};
+
+static dds_entity_t g_participant;
+static struct ddsi_sertopic_default g_topic;
+
+static void
+serdata_pool_init(void)
+{
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+    memset(&g_topic, 0, sizeof(g_topic));
+    g_topic.c.ops = &ddsi_sertopic_ops_default;
+    g_topic.c.serdata_ops = &ddsi_serdata_ops_cdr_nokey;
+    g_topic.type = (struct dds_topic_descriptor *) &Blob_desc;
+}
+
+static void
+serdata_pool_fini(void)
+{
+    dds_delete(g_participant);
+}
+
+CU_Test(ddsc_serdata_pool, memory_bound, .init=serdata_pool_init, .fini=serdata_pool_fini)
+{
+    /* Sizes in and between all size classes, and beyond the largest one,
+       many more of each than the pool may hold on to */
+    static const uint32_t sizes[] = { 10, 100, 300, 1000, 3000, 10000, 30000, 50000, 100000 };
+    enum { N = 400 };
+    struct ddsi_serdata **sds = ddsrt_malloc(N * sizeof(*sds));
+    char *s = ddsrt_malloc(100001);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        Blob x = { s };
+        memset(s, 'x', sizes[i]);
+        s[sizes[i]] = 0;
+        for (int j = 0; j < N; j++) {
+            sds[j] = ddsi_serdata_from_sample(&g_topic.c, SDK_DATA, &x);
+            CU_ASSERT_PTR_NOT_NULL_FATAL(sds[j]);
+        }
+        for (int j = 0; j < N; j++) {
+            ddsi_serdata_unref(sds[j]);
+        }
+        for (int cls = 0; cls < SERDATAPOOL_NCLASSES; cls++) {
+            CU_ASSERT(ddsrt_atomic_ld32(&gv.serpool->bytes[cls]) <= MAX_POOL_BYTES);
+        }
+    }
+    /* The pool does get used */
+    CU_ASSERT(ddsrt_atomic_ld32(&gv.serpool->bytes[0]) > 0);
+    CU_ASSERT(ddsrt_atomic_ld32(&gv.serpool->bytes[SERDATAPOOL_NCLASSES - 1]) > 0);
+    ddsrt_free(s);
+    ddsrt_free(sds);
+}
@@ -0,0 +1,393 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+
+#include "dds__stream.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+
+/* Bytes before and after the array, which must remain untouched */
+#define GUARD 32
+#define MAX_BYTES 100
+
+static void
+swap_reference(unsigned char *buf, uint32_t size, uint32_t num)
+{
+    for (uint32_t i = 0; i < num; i++) {
+        unsigned char *e = buf + i * size;
+        for (uint32_t j = 0; j < size / 2; j++) {
+            unsigned char t = e[j];
+            e[j] = e[size - 1 - j];
+            e[size - 1 - j] = t;
+        }
+    }
+}
+
+/* Swaps arrays of all lengths up to MAX_BYTES, so that those just below,
+   at and just above the 16- and 32-byte vector widths are covered, and at
+   all offsets within a vector, so that starts are unaligned. Returns false
+   if the instruction set is not supported. */
+static bool
+check_swap(enum dds_stream_swap_isa isa, uint32_t size)
+{
+    static unsigned char buf[GUARD + 8 + MAX_BYTES + GUARD];
+    static unsigned char ref[GUARD + 8 + MAX_BYTES + GUARD];
+    for (uint32_t offset = 0; offset < 8; offset++) {
+        /* the scalar code relies on the alignment that CDR guarantees */
+        if (isa == DDS_STREAM_SWAP_SCALAR && offset % size != 0) {
+            continue;
+        }
+        for (uint32_t num = 0; num * size <= MAX_BYTES; num++) {
+            for (size_t i = 0; i < sizeof(buf); i++) {
+                buf[i] = (unsigned char) (i * 7 + num);
+            }
+            memcpy(ref, buf, sizeof(ref));
+            swap_reference(ref + GUARD + offset, size, num);
+            if (!dds_stream_swap_isa(buf + GUARD + offset, size, num, isa)) {
+                return false;
+            }
+            if (memcmp(buf, ref, sizeof(buf)) != 0) {
+                printf("isa %d size %u num %u offset %u: mismatch\n", (int) isa, (unsigned) size, (unsigned) num, (unsigned) offset);
+                CU_FAIL("swapped array differs from reference");
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+CU_Test(ddsc_stream, swap_scalar)
+{
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_SCALAR, 2));
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_SCALAR, 4));
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_SCALAR, 8));
+}
+
+CU_Test(ddsc_stream, swap_ssse3)
+{
+    if (!check_swap(DDS_STREAM_SWAP_SSSE3, 2)) {
+        printf("SSSE3 not supported, skipped\n");
+        return;
+    }
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_SSSE3, 4));
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_SSSE3, 8));
+}
+
+CU_Test(ddsc_stream, swap_avx2)
+{
+    if (!check_swap(DDS_STREAM_SWAP_AVX2, 2)) {
+        printf("AVX2 not supported, skipped\n");
+        return;
+    }
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_AVX2, 4));
+    CU_ASSERT(check_swap(DDS_STREAM_SWAP_AVX2, 8));
+}
+
+CU_Test(ddsc_stream, swap)
+{
+    /* Whatever dds_stream_swap picks must give the same result */
+    static unsigned char buf[GUARD + 8 + MAX_BYTES + GUARD];
+    static unsigned char ref[GUARD + 8 + MAX_BYTES + GUARD];
+    const uint32_t sizes[] = { 2, 4, 8 };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        const uint32_t size = sizes[k];
+        for (uint32_t num = 0; num * size <= MAX_BYTES; num++) {
+            for (size_t i = 0; i < sizeof(buf); i++) {
+                buf[i] = (unsigned char) (i * 13 + num);
+            }
+            memcpy(ref, buf, sizeof(ref));
+            swap_reference(ref + GUARD, size, num);
+            dds_stream_swap(buf + GUARD, size, num);
+            CU_ASSERT(memcmp(buf, ref, sizeof(buf)) == 0);
+        }
+    }
+}
+
+/* dds_stream_normalize checks received data against the type and converts
+   it to native endianness. The CDR is constructed by hand here, in either
+   endianness, so that it can be corrupted in well-defined places. */
+
+#define BS_BOUND 9 /* string<8>, the bound includes the terminating nul */
+
+typedef struct Norm {
+    int32_t k;
+    char *s;
+    char bs[BS_BOUND];
+    int64_t d;
+    dds_sequence_t seq; /* sequence<short> */
+    dds_sequence_t seqs; /* sequence<string> */
+    int32_t arr[3];
+} Norm;
+
+static const uint32_t Norm_ops[] = {
+    DDS_OP_ADR | DDS_OP_TYPE_4BY | DDS_OP_FLAG_KEY, offsetof(Norm, k),
+    DDS_OP_ADR | DDS_OP_TYPE_STR, offsetof(Norm, s),
+    DDS_OP_ADR | DDS_OP_TYPE_BST, offsetof(Norm, bs), BS_BOUND,
+    DDS_OP_ADR | DDS_OP_TYPE_8BY, offsetof(Norm, d),
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_2BY, offsetof(Norm, seq),
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_STR, offsetof(Norm, seqs),
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_4BY, offsetof(Norm, arr), 3,
+    DDS_OP_RTS
+};
+static const dds_key_descriptor_t Norm_keys[] = { { "k", 0 } };
+static const dds_topic_descriptor_t Norm_desc = {
+    sizeof(Norm), sizeof(char *), DDS_TOPIC_NO_OPTIMIZE, 1u, "Norm", Norm_keys, 8, Norm_ops, ""
+};
+
+static struct ddsi_sertopic_default g_norm_topic;
+
+static void
+normalize_init(void)
+{
+    memset(&g_norm_topic, 0, sizeof(g_norm_topic));
+    g_norm_topic.type = (struct dds_topic_descriptor *) &Norm_desc;
+}
+
+/* Offsets of the interesting parts of the CDR constructed by build */
+struct layout {
+    uint32_t s_len, s_nul, bs_len, seq_len, seqs_len, seqs_0_len, size;
+};
+
+struct cdr {
+    unsigned char buf[256];
+    uint32_t off;
+    bool bswap;
+};
+
+static void
+put(struct cdr *c, const void *v, uint32_t size)
+{
+    c->off = (c->off + size - 1) & ~(size - 1);
+    CU_ASSERT_FATAL(c->off + size <= sizeof(c->buf));
+    memcpy(c->buf + c->off, v, size);
+    if (c->bswap) {
+        swap_reference(c->buf + c->off, size, 1);
+    }
+    c->off += size;
+}
+
+static void
+put32(struct cdr *c, uint32_t v)
+{
+    put(c, &v, 4);
+}
+
+static void
+put_string(struct cdr *c, const char *s)
+{
+    const uint32_t len = (uint32_t) strlen(s) + 1;
+    put32(c, len);
+    CU_ASSERT_FATAL(c->off + len <= sizeof(c->buf));
+    memcpy(c->buf + c->off, s, len);
+    c->off += len;
+}
+
+/* Overwrites a uint32 written at "off" earlier */
+static void
+patch32(struct cdr *c, uint32_t off, uint32_t v)
+{
+    uint32_t saved = c->off;
+    c->off = off;
+    put32(c, v);
+    c->off = saved;
+}
+
+static void
+build(struct cdr *c, bool bswap, const char *bs, struct layout *l)
+{
+    const uint16_t seq[] = { 0x0102, 0x0304, 0x0506 };
+    const int64_t d = 0x0102030405060708;
+    memset(c, 0, sizeof(*c));
+    c->bswap = bswap;
+    put32(c, 0x01020304);
+    l->s_len = c->off;
+    put_string(c, "hello");
+    l->s_nul = c->off - 1;
+    l->bs_len = c->off;
+    put_string(c, bs);
+    put(c, &d, 8);
+    l->seq_len = c->off;
+    put32(c, 3);
+    for (int i = 0; i < 3; i++) {
+        put(c, &seq[i], 2);
+    }
+    l->seqs_len = c->off;
+    put32(c, 2);
+    l->seqs_0_len = c->off;
+    put_string(c, "a");
+    put_string(c, "bc");
+    for (uint32_t i = 1; i <= 3; i++) {
+        put32(c, i);
+    }
+    l->size = c->off;
+}
+
+/* Normalizes a copy in a buffer of exactly the given size, so that reading
+   beyond it is caught by the address sanitizer */
+static bool
+normalize(const struct cdr *c, uint32_t size, bool just_key, unsigned char *out)
+{
+    unsigned char *buf = malloc(size ? size : 1);
+    bool ok;
+    CU_ASSERT_FATAL(buf != NULL);
+    memcpy(buf, c->buf, size);
+    ok = dds_stream_normalize(buf, size, c->bswap, &g_norm_topic, just_key);
+    if (out) {
+        memcpy(out, buf, size);
+    }
+    free(buf);
+    return ok;
+}
+
+static const bool endiannesses[] = { false, true };
+#define FOR_EACH_ENDIANNESS(bswap) \
+    for (size_t bswap##_i = 0; bswap##_i < 2 && ((bswap = endiannesses[bswap##_i]), 1); bswap##_i++)
+
+CU_Test(ddsc_stream, normalize_roundtrip, .init=normalize_init)
+{
+    struct cdr c, native;
+    struct layout l, ln;
+    unsigned char out[sizeof(c.buf)];
+    bool bswap;
+
+    build(&native, false, "12345678", &ln);
+
+    /* The hand-made CDR matches what the serializer produces */
+    {
+        const uint16_t seq[] = { 0x0102, 0x0304, 0x0506 };
+        char *seqs[] = { "a", "bc" };
+        Norm x = { 0x01020304, "hello", "12345678", 0x0102030405060708,
+                   { 3, 3, (uint8_t *) seq, false }, { 2, 2, (uint8_t *) seqs, false }, { 1, 2, 3 } };
+        dds_stream_t os;
+        dds_stream_init(&os, 0);
+        dds_stream_write_sample(&os, &x, &g_norm_topic);
+        CU_ASSERT_EQUAL_FATAL(os.m_index, ln.size);
+        CU_ASSERT(memcmp(os.m_buffer.p8, native.buf, ln.size) == 0);
+        dds_stream_fini(&os);
+    }
+
+    FOR_EACH_ENDIANNESS(bswap) {
+        Norm y;
+        dds_stream_t is;
+        build(&c, bswap, "12345678", &l);
+        CU_ASSERT_EQUAL_FATAL(l.size, ln.size);
+        CU_ASSERT_FATAL(normalize(&c, l.size, false, out));
+        CU_ASSERT(memcmp(out, native.buf, l.size) == 0);
+
+        /* The result deserializes without any byte swapping */
+        memset(&y, 0, sizeof(y));
+        memset(&is, 0, sizeof(is));
+        is.m_buffer.p8 = out;
+        is.m_size = l.size;
+        is.m_endian = dds_stream_endian();
+        dds_stream_read_sample(&is, &y, &g_norm_topic);
+        CU_ASSERT(!is.m_failed);
+        CU_ASSERT_EQUAL(y.k, 0x01020304);
+        CU_ASSERT_STRING_EQUAL(y.s, "hello");
+        CU_ASSERT_STRING_EQUAL(y.bs, "12345678");
+        CU_ASSERT_EQUAL(y.d, 0x0102030405060708);
+        CU_ASSERT_EQUAL_FATAL(y.seq._length, 3);
+        CU_ASSERT_EQUAL(((uint16_t *) y.seq._buffer)[2], 0x0506);
+        CU_ASSERT_EQUAL_FATAL(y.seqs._length, 2);
+        CU_ASSERT_STRING_EQUAL(((char **) y.seqs._buffer)[1], "bc");
+        CU_ASSERT_EQUAL(y.arr[2], 3);
+        dds_sample_free(&y, &Norm_desc, DDS_FREE_CONTENTS);
+
+        /* Just the key */
+        CU_ASSERT(normalize(&c, 4, true, out));
+        CU_ASSERT(memcmp(out, native.buf, 4) == 0);
+    }
+}
+
+CU_Test(ddsc_stream, normalize_truncated, .init=normalize_init)
+{
+    struct cdr c;
+    struct layout l;
+    bool bswap;
+    FOR_EACH_ENDIANNESS(bswap) {
+        build(&c, bswap, "12345678", &l);
+        CU_ASSERT(normalize(&c, l.size, false, NULL));
+        for (uint32_t size = 0; size < l.size; size++) {
+            CU_ASSERT(!normalize(&c, size, false, NULL));
+        }
+        for (uint32_t size = 0; size < 4; size++) {
+            CU_ASSERT(!normalize(&c, size, true, NULL));
+        }
+    }
+}
+
+CU_Test(ddsc_stream, normalize_strings, .init=normalize_init)
+{
+    struct cdr c;
+    struct layout l;
+    bool bswap;
+    FOR_EACH_ENDIANNESS(bswap) {
+        /* Length beyond the end of the data */
+        build(&c, bswap, "12345678", &l);
+        patch32(&c, l.s_len, l.size);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+        patch32(&c, l.s_len, 0xffffffff);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+
+        /* Zero length: not even a terminating nul */
+        build(&c, bswap, "12345678", &l);
+        patch32(&c, l.s_len, 0);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+
+        /* Unterminated */
+        build(&c, bswap, "12345678", &l);
+        c.buf[l.s_nul] = 'x';
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+
+        /* Shorter length than the actual string, so it is unterminated */
+        build(&c, bswap, "12345678", &l);
+        patch32(&c, l.s_len, 3);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+
+        /* Bounded string at and beyond the bound */
+        build(&c, bswap, "12345678", &l);
+        CU_ASSERT(normalize(&c, l.size, false, NULL));
+        build(&c, bswap, "123456789", &l);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+        build(&c, bswap, "12345678", &l);
+        patch32(&c, l.bs_len, BS_BOUND + 1);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+
+        /* Broken string in a sequence */
+        build(&c, bswap, "12345678", &l);
+        patch32(&c, l.seqs_0_len, 100);
+        CU_ASSERT(!normalize(&c, l.size, false, NULL));
+    }
+}
+
+CU_Test(ddsc_stream, normalize_sequences, .init=normalize_init)
+{
+    /* Sequences carry no bound in the type, the length must fit the data */
+    const uint32_t lengths[] = { 100, 0x10000000, 0x7fffffff, 0x80000000, 0xffffffff };
+    struct cdr c;
+    struct layout l;
+    bool bswap;
+    FOR_EACH_ENDIANNESS(bswap) {
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+            build(&c, bswap, "12345678", &l);
+            patch32(&c, l.seq_len, lengths[i]);
+            CU_ASSERT(!normalize(&c, l.size, false, NULL));
+            build(&c, bswap, "12345678", &l);
+            patch32(&c, l.seqs_len, lengths[i]);
+            CU_ASSERT(!normalize(&c, l.size, false, NULL));
+        }
+    }
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "CUnit/Test.h"
+#include "Space.h"
+
+#include "dds__entity.h"
+#include "dds__types.h"
+#include "dds/ddsi/q_time.h"
+#include "dds__whc.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/q_protocol.h"
+
+/* The ring WHC is only used for volatile KEEP_LAST writers of keyless
+   topics, but it never looks at the key, so any topic will do for
+   generating the samples */
+
+static dds_entity_t g_participant = 0;
+static dds_entity_t g_topic = 0;
+static struct ddsi_sertopic *g_stopic = NULL;
+static struct whc *g_whc = NULL;
+
+static void
+whc_ring_init(void)
+{
+    dds_entity *e;
+    g_participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(g_participant > 0);
+    g_topic = dds_create_topic(g_participant, &Space_Type1_desc, "ddsc_whc_ring", NULL, NULL);
+    CU_ASSERT_FATAL(g_topic > 0);
+    CU_ASSERT_FATAL(dds_entity_lock(g_topic, DDS_KIND_TOPIC, &e) == DDS_RETCODE_OK);
+    g_stopic = ((dds_topic *) e)->m_stopic;
+    dds_entity_unlock(e);
+    g_whc = NULL;
+}
+
+static void
+whc_ring_fini(void)
+{
+    if (g_whc) {
+        whc_free(g_whc);
+    }
+    dds_delete(g_participant);
+}
+
+static void
+insert(seqno_t max_drop_seq, seqno_t seq)
+{
+    Space_Type1 s = { 0, (int32_t) seq, 0 };
+    struct ddsi_serdata *sd = ddsi_serdata_from_sample(g_stopic, SDK_DATA, &s);
+    CU_ASSERT_FATAL(sd != NULL);
+    CU_ASSERT_EQUAL(whc_insert(g_whc, max_drop_seq, seq, NULL, sd, NULL), 0);
+    ddsi_serdata_unref(sd);
+}
+
+static void
+insert_unregister(seqno_t max_drop_seq, seqno_t seq)
+{
+    Space_Type1 s = { 0, 0, 0 };
+    struct ddsi_serdata *sd = ddsi_serdata_from_sample(g_stopic, SDK_KEY, &s);
+    CU_ASSERT_FATAL(sd != NULL);
+    sd->statusinfo = NN_STATUSINFO_UNREGISTER;
+    CU_ASSERT_EQUAL(whc_insert(g_whc, max_drop_seq, seq, NULL, sd, NULL), 0);
+    ddsi_serdata_unref(sd);
+}
+
+static unsigned
+ack(seqno_t max_drop_seq, struct whc_state *st)
+{
+    struct whc_node *dfl;
+    unsigned n = whc_remove_acked_messages(g_whc, max_drop_seq, st, &dfl);
+    whc_free_deferred_free_list(g_whc, dfl);
+    return n;
+}
+
+static void
+check_state(seqno_t min_seq, seqno_t max_seq, bool unacked)
+{
+    struct whc_state st;
+    whc_get_state(g_whc, &st);
+    CU_ASSERT_EQUAL(st.min_seq, min_seq);
+    CU_ASSERT_EQUAL(st.max_seq, max_seq);
+    CU_ASSERT_EQUAL(st.unacked_bytes > 0, unacked);
+}
+
+static bool
+present(seqno_t seq)
+{
+    struct whc_borrowed_sample sample;
+    if (!whc_borrow_sample(g_whc, seq, &sample)) {
+        return false;
+    }
+    CU_ASSERT_EQUAL(sample.seq, seq);
+    whc_return_sample(g_whc, &sample, false);
+    return true;
+}
+
+CU_Test(ddsc_whc_ring, insert, .init=whc_ring_init, .fini=whc_ring_fini)
+{
+    g_whc = whc_ring_new(10);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_whc);
+    check_state(-1, -1, false);
+    CU_ASSERT_EQUAL(whc_next_seq(g_whc, 0), MAX_SEQ_NUMBER);
+
+    for (seqno_t seq = 1; seq <= 3; seq++) {
+        insert(0, seq);
+    }
+    check_state(1, 3, true);
+    CU_ASSERT_EQUAL(whc_next_seq(g_whc, 0), 1);
+    CU_ASSERT_EQUAL(whc_next_seq(g_whc, 1), 2);
+    CU_ASSERT_EQUAL(whc_next_seq(g_whc, 3), MAX_SEQ_NUMBER);
+    for (seqno_t seq = 1; seq <= 3; seq++) {
+        CU_ASSERT(present(seq));
+    }
+    CU_ASSERT(!present(4));
+
+    /* Sequence numbers may skip, e.g., when a writer has filtered readers */
+    insert(0, 6);
+    check_state(1, 6, true);
+    CU_ASSERT_EQUAL(whc_next_seq(g_whc, 3), 6);
+    CU_ASSERT(!present(4));
+}
+
+CU_Test(ddsc_whc_ring, grow, .init=whc_ring_init, .fini=whc_ring_fini)
+{
+    /* A history deeper than the initial ring size forces it to grow */
+    g_whc = whc_ring_new(1000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_whc);
+    for (seqno_t seq = 1; seq <= 1000; seq++) {
+        insert(0, seq);
+    }
+    check_state(1, 1000, true);
+    for (seqno_t seq = 1; seq <= 1000; seq++) {
+        CU_ASSERT(present(seq));
+    }
+}
+
+CU_Test(ddsc_whc_ring, prune, .init=whc_ring_init, .fini=whc_ring_fini)
+{
+    struct whc_borrowed_sample sample;
+
+    /* KEEP_LAST pushes the oldest sample out of the history, acknowledged
+       or not */
+    g_whc = whc_ring_new(2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_whc);
+    for (seqno_t seq = 1; seq <= 5; seq++) {
+        insert(0, seq);
+    }
+    check_state(4, 5, true);
+    CU_ASSERT(!present(3));
+    CU_ASSERT(present(4));
+    CU_ASSERT(present(5));
+
+    /* The latest sample is the one for the (only) key */
+    CU_ASSERT_FATAL(whc_borrow_sample_key(g_whc, NULL, &sample));
+    CU_ASSERT_EQUAL(sample.seq, 5);
+    whc_return_sample(g_whc, &sample, false);
+}
+
+CU_Test(ddsc_whc_ring, ack, .init=whc_ring_init, .fini=whc_ring_fini)
+{
+    struct whc_state st;
+    struct whc_node *dfl1, *dfl2;
+
+    g_whc = whc_ring_new(10);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_whc);
+    for (seqno_t seq = 1; seq <= 5; seq++) {
+        insert(0, seq);
+    }
+
+    /* Acknowledged samples are removed from the WHC, they are no longer
+       needed for a volatile writer */
+    CU_ASSERT_EQUAL(ack(2, &st), 2);
+    CU_ASSERT_EQUAL(st.min_seq, 3);
+    CU_ASSERT_EQUAL(st.max_seq, 5);
+    CU_ASSERT(!present(2));
+    CU_ASSERT(present(3));
+
+    /* Nothing new acknowledged */
+    CU_ASSERT_EQUAL(ack(2, &st), 0);
+
+    /* Samples written with all readers having acknowledged them already
+       are not counted as unacknowledged */
+    CU_ASSERT_EQUAL(ack(5, &st), 3);
+    check_state(-1, -1, false);
+    insert(6, 6);
+    check_state(6, 6, false);
+    CU_ASSERT_EQUAL(ack(6, &st), 1);
+    check_state(-1, -1, false);
+
+    /* The block in which removed samples are passed to the caller is
+       retained by the WHC for the next time */
+    insert(6, 7);
+    CU_ASSERT_EQUAL(whc_remove_acked_messages(g_whc, 7, &st, &dfl1), 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dfl1);
+    whc_free_deferred_free_list(g_whc, dfl1);
+    insert(7, 8);
+    CU_ASSERT_EQUAL(whc_remove_acked_messages(g_whc, 8, &st, &dfl2), 1);
+    CU_ASSERT_PTR_EQUAL(dfl2, dfl1);
+
+    /* ... unless it is still in use */
+    insert(8, 9);
+    CU_ASSERT_EQUAL(whc_remove_acked_messages(g_whc, 9, &st, &dfl1), 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dfl1);
+    CU_ASSERT_PTR_NOT_EQUAL(dfl1, dfl2);
+    whc_free_deferred_free_list(g_whc, dfl2);
+    whc_free_deferred_free_list(g_whc, dfl1);
+}
+
+CU_Test(ddsc_whc_ring, unregister, .init=whc_ring_init, .fini=whc_ring_fini)
+{
+    struct whc_borrowed_sample sample;
+    struct whc_state st;
+
+    g_whc = whc_ring_new(10);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_whc);
+    for (seqno_t seq = 1; seq <= 3; seq++) {
+        insert(0, seq);
+    }
+
+    /* Unregistering drops the acknowledged part of the history, the rest
+       and the unregister itself stay until acknowledged */
+    insert_unregister(2, 4);
+    check_state(3, 4, true);
+    CU_ASSERT(!present(1));
+    CU_ASSERT(!present(2));
+    CU_ASSERT(present(3));
+    CU_ASSERT(present(4));
+    CU_ASSERT(!whc_borrow_sample_key(g_whc, NULL, &sample));
+
+    /* Writing after unregistering starts a new history */
+    insert(2, 5);
+    CU_ASSERT_FATAL(whc_borrow_sample_key(g_whc, NULL, &sample));
+    CU_ASSERT_EQUAL(sample.seq, 5);
+    whc_return_sample(g_whc, &sample, false);
+
+    /* An unregister that needn't be retained is dropped immediately */
+    insert_unregister(6, 6);
+    check_state(3, 4, true);
+    CU_ASSERT(!present(5));
+    CU_ASSERT(!whc_borrow_sample_key(g_whc, NULL, &sample));
+
+    CU_ASSERT_EQUAL(ack(6, &st), 2);
+    check_state(-1, -1, false);
+}
+
+CU_Test(ddsc_whc_ring, borrow_return, .init=whc_ring_init, .fini=whc_ring_fini)
+{
+    struct whc_borrowed_sample sample, sample2;
+    struct whc_sample_iter it;
+    struct whc_state st;
+    seqno_t seq;
+
+    g_whc = whc_ring_new(10);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_whc);
+    for (seq = 1; seq <= 3; seq++) {
+        insert(0, seq);
+    }
+
+    /* Retransmit information is only updated if requested */
+    CU_ASSERT_FATAL(whc_borrow_sample(g_whc, 2, &sample));
+    CU_ASSERT_EQUAL(sample.rexmit_count, 0);
+    CU_ASSERT(sample.unacked);
+    sample.rexmit_count = 3;
+    whc_return_sample(g_whc, &sample, false);
+    CU_ASSERT_FATAL(whc_borrow_sample(g_whc, 2, &sample));
+    CU_ASSERT_EQUAL(sample.rexmit_count, 0);
+    sample.rexmit_count = 3;
+    whc_return_sample(g_whc, &sample, true);
+    CU_ASSERT_FATAL(whc_borrow_sample(g_whc, 2, &sample));
+    CU_ASSERT_EQUAL(sample.rexmit_count, 3);
+    whc_return_sample(g_whc, &sample, false);
+
+    /* A sample removed from the WHC while borrowed is freed on return */
+    CU_ASSERT_FATAL(whc_borrow_sample(g_whc, 1, &sample));
+    CU_ASSERT_FATAL(whc_borrow_sample(g_whc, 3, &sample2));
+    CU_ASSERT_EQUAL(ack(1, &st), 1);
+    CU_ASSERT(!present(1));
+    whc_return_sample(g_whc, &sample, false);
+    insert(1, 4);
+    insert(1, 5);
+    insert_unregister(3, 6);
+    CU_ASSERT(!present(3));
+    whc_return_sample(g_whc, &sample2, true);
+
+    /* Iterating visits all samples in order */
+    seq = 0;
+    whc_sample_iter_init(g_whc, &it);
+    while (whc_sample_iter_borrow_next(&it, &sample)) {
+        CU_ASSERT(sample.seq > seq);
+        seq = sample.seq;
+    }
+    CU_ASSERT_EQUAL(seq, 6);
+}
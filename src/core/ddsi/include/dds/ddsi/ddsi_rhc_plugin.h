@@ -37,6 +37,9 @@ struct ddsi_rhc_plugin
   bool (*rhc_store_fn)
   (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info,
    struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk);
+  uint32_t (*rhc_store_set_fn)
+  (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info,
+   uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks);
   void (*rhc_unregister_wr_fn)
   (struct rhc * __restrict rhc, const struct proxy_writer_info * __restrict pwr_info);
   void (*rhc_relinquish_ownership_fn)
@@ -58,6 +58,7 @@ typedef void (*ddsi_serdata_free_t) (struct ddsi_serdata *d);
    - the first fragchain always contains the encoding header in its entirety
    - fragchains may overlap, though I have never seen any DDS implementation
      actually send such nasty fragments
+   - returns a null pointer if the data is malformed
    - FIXME: get the encoding header out of the serialised data */
 typedef struct ddsi_serdata * (*ddsi_serdata_from_ser_t) (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size);
 
@@ -123,6 +124,24 @@ typedef bool (*ddsi_serdata_topicless_to_sample_t) (const struct ddsi_sertopic *
    computing equijoins across topics much simpler). */
 typedef bool (*ddsi_serdata_eqkey_t) (const struct ddsi_serdata *a, const struct ddsi_serdata *b);
 
+/* Allocate a serdata of kind "kind" for "size" bytes of serialised data (including
+   the 4-byte encoding header) that the caller will fill in-place, by writing into
+   the buffer returned in *buf, before calling fix_ser.
+   - used for reassembling large fragmented samples without first collecting all
+     fragments and then copying them
+   - optional: may be a null pointer, in which case from_ser is used
+   - "size" comes from the network, so it must not abort if the memory can't be
+     allocated but return a null pointer instead, which causes the sample to be
+     dropped
+   - nothing may be done with the serdata other than fix_ser or unref until fix_ser
+     has been called */
+typedef struct ddsi_serdata * (*ddsi_serdata_alloc_ser_t) (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, size_t size, unsigned char **buf);
+
+/* Complete the construction of a serdata obtained from alloc_ser once the
+   serialised data has been filled in, returns the (possibly different) serdata,
+   or a null pointer (having released "d") if the data is malformed */
+typedef struct ddsi_serdata * (*ddsi_serdata_fix_ser_t) (struct ddsi_serdata *d);
+
 struct ddsi_serdata_ops {
   ddsi_serdata_eqkey_t eqkey;
   ddsi_serdata_size_t get_size;
@@ -136,6 +155,8 @@ struct ddsi_serdata_ops {
   ddsi_serdata_to_topicless_t to_topicless;
   ddsi_serdata_topicless_to_sample_t topicless_to_sample;
   ddsi_serdata_free_t free;
+  ddsi_serdata_alloc_ser_t alloc_ser;
+  ddsi_serdata_fix_ser_t fix_ser;
 };
 
 DDS_EXPORT void ddsi_serdata_init (struct ddsi_serdata *d, const struct ddsi_sertopic *tp, enum ddsi_serdata_kind kind);
@@ -159,6 +180,14 @@ DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_ser (const struct ddsi_
   return topic->serdata_ops->from_ser (topic, kind, fragchain, size);
 }
 
+DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_alloc_ser (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, size_t size, unsigned char **buf) {
+  return topic->serdata_ops->alloc_ser ? topic->serdata_ops->alloc_ser (topic, kind, size, buf) : NULL;
+}
+
+DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_fix_ser (struct ddsi_serdata *d) {
+  return d->ops->fix_ser (d);
+}
+
 DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_keyhash (const struct ddsi_sertopic *topic, const struct nn_keyhash *keyhash) {
   return topic->serdata_ops->from_keyhash (topic, keyhash);
 }
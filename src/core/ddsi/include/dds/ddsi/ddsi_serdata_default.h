@@ -39,8 +39,13 @@ struct CDRHeader {
   unsigned short options;
 };
 
+/* Serdata are recycled through a freelist per size class, the smallest class
+   being 128 bytes and each next one four times larger */
+#define SERDATAPOOL_NCLASSES 5
+
 struct serdatapool {
-  struct nn_freelist freelist;
+  struct nn_freelist freelist[SERDATAPOOL_NCLASSES];
+  ddsrt_atomic_uint32_t bytes[SERDATAPOOL_NCLASSES]; /* memory held by each freelist */
 };
 
 typedef struct dds_key_hash {
@@ -87,6 +92,7 @@ struct ddsi_sertopic_default {
 
   uint32_t flags;
   size_t opt_size;
+  ddsrt_atomic_uint32_t serdata_size_hint; /* size of the most recently serialised sample */
   dds_topic_intern_filter_fn filter_fn;
   void * filter_sample;
   void * filter_ctx;
@@ -189,6 +189,7 @@ struct ddsi_tran_qos
 
   bool m_multicast;
   int m_diffserv;
+  bool m_reuseport;
 };
 
 void ddsi_tran_factories_fini (void);
@@ -12,12 +12,19 @@
 #ifndef _DDSI_UDP_H_
 #define _DDSI_UDP_H_
 
+#include "dds/ddsi/ddsi_tran.h"
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
 
 int ddsi_udp_init (void);
 
+/* Steers packets arriving on the group of SO_REUSEPORT sockets that CONN
+   belongs to (NSOCKS in total) based on the GUID prefix of the sender;
+   returns 0 on success and -1 if not supported or on failure */
+int ddsi_udp_conn_steer_by_guidprefix (ddsi_tran_conn_t conn, uint32_t nsocks);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -12,6 +12,8 @@
 #ifndef NN_ADDRSET_H
 #define NN_ADDRSET_H
 
+#include "dds/export.h"
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsi/q_log.h"
@@ -27,19 +29,29 @@ typedef struct addrset_node {
   nn_locator_t loc;
 } * addrset_node_t;
 
+/* Immutable flattened copy of the contents of an address set, multicast
+   addresses first.  It is built on demand and dropped (and eventually
+   freed via the garbage collector) whenever the set changes, so that
+   threads that are awake can iterate over it without locking the set. */
+struct addrset_snapshot {
+  uint32_t n;
+  nn_locator_t locs[1 /* really a flex ary */];
+};
+
 struct addrset {
   ddsrt_mutex_t lock;
   ddsrt_atomic_uint32_t refc;
   ddsrt_avl_ctree_t ucaddrs, mcaddrs;
+  ddsrt_atomic_voidp_t snapshot;
 };
 
 typedef void (*addrset_forall_fun_t) (const nn_locator_t *loc, void *arg);
 typedef ssize_t (*addrset_forone_fun_t) (const nn_locator_t *loc, void *arg);
 
-struct addrset *new_addrset (void);
+DDS_EXPORT struct addrset *new_addrset (void);
 struct addrset *ref_addrset (struct addrset *as);
-void unref_addrset (struct addrset *as);
-void add_to_addrset (struct addrset *as, const nn_locator_t *loc);
+DDS_EXPORT void unref_addrset (struct addrset *as);
+DDS_EXPORT void add_to_addrset (struct addrset *as, const nn_locator_t *loc);
 void remove_from_addrset (struct addrset *as, const nn_locator_t *loc);
 int addrset_purge (struct addrset *as);
 int compare_locators (const nn_locator_t *a, const nn_locator_t *b);
@@ -59,10 +71,11 @@ int addrset_empty (const struct addrset *as);
 int addrset_any_uc (const struct addrset *as, nn_locator_t *dst);
 int addrset_any_mc (const struct addrset *as, nn_locator_t *dst);
 
-/* Keeps AS locked */
+/* Iterate over a snapshot of AS without locking it if the calling thread
+   is awake, otherwise keep AS locked */
 int addrset_forone (struct addrset *as, addrset_forone_fun_t f, void *arg);
 void addrset_forall (struct addrset *as, addrset_forall_fun_t f, void *arg);
-size_t addrset_forall_count (struct addrset *as, addrset_forall_fun_t f, void *arg);
+DDS_EXPORT size_t addrset_forall_count (struct addrset *as, addrset_forall_fun_t f, void *arg);
 void nn_log_addrset (uint32_t tf, const char *prefix, const struct addrset *as);
 
 /* Tries to lock A then B for a decent check, returning false if
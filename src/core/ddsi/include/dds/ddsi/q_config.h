@@ -70,6 +70,18 @@ enum durability_cdr
 #define PARTICIPANT_INDEX_AUTO -1
 #define PARTICIPANT_INDEX_NONE -2
 
+/* Upper bound on the number of threads receiving unicast data in
+   single-unicast-socket mode (see MultipleReceiveThreads/unicastthreads) */
+#define MAX_RECV_THREADS_UC 16
+
+/* Upper bound on the number of delivery queues (and threads) processing
+   discovery data (see Internal/BuiltinDeliveryQueues) */
+#define MAX_BUILTINS_DQUEUES 16
+
+/* Upper bound on the number of packets covered by a single FEC parity
+   packet (see Internal/FecGroupSize) */
+#define NN_FEC_MAX_GROUP_SIZE 32
+
 /* config_listelem must be an overlay for all used listelem types */
 struct config_listelem {
   struct config_listelem *next;
@@ -78,21 +90,21 @@ struct config_listelem {
 #ifdef DDSI_INCLUDE_ENCRYPTION
 struct q_security_plugins
 {
-  c_bool (*encode) (q_securityEncoderSet, uint32_t, void *, uint32_t, uint32_t *);
-  c_bool (*decode) (q_securityDecoderSet, void *, size_t, size_t *);
+  bool (*encode) (q_securityEncoderSet, uint32_t, void *, uint32_t, uint32_t *);
+  bool (*decode) (q_securityDecoderSet, void *, size_t, size_t *);
   q_securityEncoderSet (*new_encoder) (void);
   q_securityDecoderSet (*new_decoder) (void);
-  c_bool (*free_encoder) (q_securityEncoderSet);
-  c_bool (*free_decoder) (q_securityDecoderSet);
+  bool (*free_encoder) (q_securityEncoderSet);
+  bool (*free_decoder) (q_securityDecoderSet);
   ssize_t (*send_encoded) (ddsi_tran_conn_t, const nn_locator_t *dst, size_t niov, ddsrt_iovec_t *iov, q_securityEncoderSet *, uint32_t, uint32_t);
-  char * (*cipher_type) (q_cipherType);
-  c_bool (*cipher_type_from_string) (const char *, q_cipherType *);
+  const char * (*cipher_type) (q_cipherType);
+  bool (*cipher_type_from_string) (const char *, q_cipherType *);
   uint32_t (*header_size) (q_securityEncoderSet, uint32_t);
   q_cipherType (*encoder_type) (q_securityEncoderSet, uint32_t);
-  c_bool (*valid_uri) (q_cipherType, const char *);
+  bool (*valid_uri) (q_cipherType, const char *);
 };
 
-struct q_security_plugins q_security_plugin;
+extern struct q_security_plugins DDS_EXPORT q_security_plugin;
 
 struct config_securityprofile_listelem
 {
@@ -165,12 +177,20 @@ struct config_maybe_int64 {
   int64_t value;
 };
 
+/* CPUs a thread may run on, sorted and without duplicates; n = 0 means
+   the thread is not pinned */
+struct config_cpuset {
+  uint32_t n;
+  uint32_t *cpus;
+};
+
 struct config_thread_properties_listelem {
   struct config_thread_properties_listelem *next;
   char *name;
   ddsrt_sched_t sched_class;
   struct config_maybe_int32 sched_priority;
   struct config_maybe_uint32 stack_size;
+  struct config_cpuset cpuset;
 };
 
 struct config_peer_listelem
@@ -179,6 +199,28 @@ struct config_peer_listelem
   char *peer;
 };
 
+struct config_static_endpoint_listelem
+{
+  struct config_static_endpoint_listelem *next;
+  uint32_t entityid;
+  char *topic;
+  char *type;
+  char *partition;
+  nn_reliability_kind_t reliability;
+  nn_durability_kind_t durability;
+};
+
+struct config_static_participant_listelem
+{
+  struct config_static_participant_listelem *next;
+  nn_guid_prefix_t prefix;
+  char *address;
+  char *meta_address;
+  int64_t lease_duration;
+  struct config_static_endpoint_listelem *writers;
+  struct config_static_endpoint_listelem *readers;
+};
+
 struct prune_deleted_ppant {
   int64_t delay;
   int enforce_delay;
@@ -229,6 +271,9 @@ struct config
   uint32_t enabled_xchecks;
   char *servicename;
   char *pcap_file;
+  uint32_t pcap_snaplen;
+  uint32_t pcap_ringsize;
+  uint32_t pcap_filesize;
 
   char *networkAddressString;
   char **networkRecvAddressStrings;
@@ -260,19 +305,25 @@ struct config
   int64_t const_hb_intv_min;
   enum retransmit_merging retransmit_merging;
   int64_t retransmit_merging_period;
+  int retransmit_multiple_fragments;
+  uint32_t retransmit_bandwidth_limit; /* bytes/second, 0 = unlimited */
   int squash_participants;
   int liveliness_monitoring;
   int noprogress_log_stacktraces;
   int64_t liveliness_monitoring_interval;
   int prioritize_retransmit;
   int xpack_send_async;
+  int listener_threads;
   int multiple_recv_threads;
+  int multiple_recv_threads_uc;
   unsigned recv_thread_stop_maxretries;
 
   unsigned primary_reorder_maxsamples;
   unsigned secondary_reorder_maxsamples;
 
   unsigned delivery_queue_maxsamples;
+  unsigned coherent_set_maxsamples;
+  int builtins_dqueues;
 
   int do_topic_discovery;
 
@@ -322,6 +373,9 @@ struct config
 #endif /* DDSI_INCLUDE_NETWORK_PARTITIONS */
   struct config_peer_listelem *peers;
   struct config_peer_listelem *peers_group;
+  struct config_static_participant_listelem *static_participants;
+  nn_guid_prefix_t static_local_prefix; /* all-zero: generate */
+  int static_discovery_exclusive;
   struct config_thread_properties_listelem *thread_properties;
 
   /* debug/test/undoc features: */
@@ -331,6 +385,8 @@ struct config
   enum besmode besmode;
   int conservative_builtin_reader_startup;
   int meas_hb_to_ack_latency;
+  int rtt_adaptive_timing;
+  int fec_group_size;
   int unicast_response_to_spdp_messages;
   int synchronous_delivery_priority_threshold;
   int64_t synchronous_delivery_latency_bound;
@@ -345,6 +401,8 @@ struct config
 
   unsigned defrag_unreliable_maxsamples;
   unsigned defrag_reliable_maxsamples;
+  uint32_t defrag_contig_threshold;
+  uint32_t defrag_contig_maxsize;
   unsigned accelerate_rexmit_block_size;
   int64_t responsiveness_timeout;
   uint32_t max_participants;
@@ -393,6 +451,10 @@ struct config
   struct prune_deleted_ppant prune_deleted_ppant;
 };
 
+struct ddsi_sertopic;
+struct ddsi_serdata;
+struct nn_content_filter_property;
+
 struct ddsi_plugin
 {
   int (*init_fn) (void);
@@ -404,6 +466,18 @@ struct ddsi_plugin
 
   /* Read cache */
   struct ddsi_rhc_plugin rhc_plugin;
+
+  /* Content filters of remote readers, evaluated by the writer; compile
+     returns NULL if the filter can't be evaluated locally, in which case
+     all data is sent and filtering is left to the reader.  Filters are
+     applied to a deserialized sample, so that a sample is deserialized
+     once no matter how many filters it is subjected to; sample_new
+     returns NULL if that fails. */
+  void * (*content_filter_compile) (const struct ddsi_sertopic *topic, const struct nn_content_filter_property *filter);
+  void * (*content_filter_sample_new) (const struct ddsi_serdata *serdata);
+  bool (*content_filter_accepts) (const void *filter, const void *sample);
+  void (*content_filter_sample_free) (const struct ddsi_serdata *serdata, void *sample);
+  void (*content_filter_free) (void *filter);
 };
 
 extern struct config DDS_EXPORT config;
@@ -39,6 +39,9 @@ int sedp_write_cm_publisher (const struct nn_plist *datap, int alive);
 int sedp_write_cm_subscriber (const struct nn_plist *datap, int alive);
 
 int builtins_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const nn_guid_t *rdguid, void *qarg);
+struct nn_dqueue *builtins_dqueue_for_prefix (const nn_guid_prefix_t *prefix);
+
+void create_static_proxies (void);
 
 #if defined (__cplusplus)
 }
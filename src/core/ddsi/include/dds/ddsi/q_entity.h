@@ -37,8 +37,10 @@ struct nn_rsample_info;
 struct nn_rdata;
 struct addrset;
 struct ddsi_sertopic;
+struct ddsi_serdata;
 struct whc;
 struct nn_xqos;
+struct nn_content_filter_property;
 struct nn_plist;
 struct lease;
 
@@ -98,8 +100,16 @@ struct wr_prd_match {
   nn_etime_t t_acknack_accepted; /* (local) time an acknack was last accepted */
   struct nn_lat_estim hb_to_ack_latency;
   nn_wctime_t hb_to_ack_latency_tlastlog;
+  int64_t rtt_srtt; /* smoothed heartbeat-to-ack round-trip time, 0 if not (yet) known */
+  int64_t rtt_var; /* mean deviation of the round-trip time */
+  int64_t rto; /* retransmit timeout: rtt_srtt + 4 * rtt_var */
+  int64_t max_rto; /* largest rto in subtree */
+  nn_mtime_t t_last_rexmit; /* time of last retransmit directed at this reader */
+  seqno_t last_rexmit_seq; /* highest sequence number in that retransmit */
   uint32_t non_responsive_count;
   uint32_t rexmit_requests;
+  void *filter; /* compiled content filter of the proxy reader, NULL if none or not evaluated here */
+  unsigned filter_accepted: 1; /* whether the last filtered sample was accepted, see wr->filter_as */
 };
 
 enum pwr_rd_match_syncstate {
@@ -152,6 +162,23 @@ struct local_reader_ary {
   struct reader **rdary; /* for efficient delivery, null-pointer terminated */
 };
 
+/* Samples of a coherent set received from a single writer, held back
+   from readers with coherent access until the set is complete.  A set
+   is identified by the sequence number of its first sample and spans
+   all consecutive sequence numbers up to the end marker (or the first
+   sample not belonging to it); a missing sequence number or exceeding
+   Internal/CoherentSetMaxSamples makes the set incomplete and causes it
+   to be dropped.  A set still open when the writer is deleted is dropped
+   as well. */
+struct coherent_set {
+  seqno_t first_seq; /* coherent set id, 0 if no set is being collected */
+  seqno_t next_seq; /* next sequence number expected for set to be complete */
+  unsigned incomplete: 1; /* set will be dropped, samples no longer retained */
+  uint32_t n, size;
+  struct ddsi_serdata **samples;
+  struct ddsi_tkmap_instance **tks;
+};
+
 struct avail_entityid_set {
   struct inverse_uint32_set x;
 };
@@ -165,6 +192,7 @@ struct participant
   unsigned is_ddsi2_pp: 1; /* true for the "federation leader", the ddsi2 participant itself in OSPL; FIXME: probably should use this for broker mode as well ... */
   struct nn_plist *plist; /* settings/QoS for this participant */
   struct xevent *spdp_xevent; /* timed event for periodically publishing SPDP */
+  struct ddsi_serdata *spdp_serdata; /* last SPDP sample written, used as key for republishing it [e.lock] */
   struct xevent *pmd_update_xevent; /* timed event for periodically publishing ParticipantMessageData */
   nn_locator_t m_locator;
   ddsi_tran_conn_t m_conn;
@@ -235,6 +263,7 @@ struct writer
   unsigned handle_as_transient_local: 1; /* controls whether data is retained in WHC */
   unsigned include_keyhash: 1; /* iff 1, this writer includes a keyhash; keyless topics => include_keyhash = 0 */
   unsigned retransmitting: 1; /* iff 1, this writer is currently retransmitting */
+  unsigned whc_trim_pending: 1; /* iff 1, whc_trim_xevent is scheduled to drop acknowledged samples */
 #ifdef DDSI_INCLUDE_SSM
   unsigned supports_ssm: 1;
   struct addrset *ssm_as;
@@ -243,12 +272,15 @@ struct writer
   struct addrset *as; /* set of addresses to publish to */
   struct addrset *as_group; /* alternate case, used for SPDP, when using Cloud with multiple bootstrap locators */
   struct xevent *heartbeat_xevent; /* timed event for "periodically" publishing heartbeats when unack'd data present, NULL <=> unreliable */
+  struct xevent *whc_trim_xevent; /* timed event for dropping acknowledged samples from the WHC, NULL <=> unreliable */
   long long lease_duration;
   struct whc *whc; /* WHC tracking history, T-L durability service history + samples by sequence number for retransmit */
   uint32_t whc_low, whc_high; /* watermarks for WHC in bytes (counting only unack'd data) */
   nn_etime_t t_rexmit_end; /* time of last 1->0 transition of "retransmitting" */
   nn_etime_t t_whc_high_upd; /* time "whc_high" was last updated for controlled ramp-up of throughput */
   int num_reliable_readers; /* number of matching reliable PROXY readers */
+  uint32_t num_filtered_readers; /* number of matching PROXY readers with a content filter evaluated here */
+  struct addrset *filter_as; /* destinations of the last filtered sample, reused while the same readers accept, or NULL */
   ddsrt_avl_tree_t readers; /* all matching PROXY readers, see struct wr_prd_match */
   ddsrt_avl_tree_t local_readers; /* all matching LOCAL readers, see struct wr_rd_match */
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
@@ -260,6 +292,10 @@ struct writer
   uint32_t throttle_tracing;
   uint32_t rexmit_count; /* cum samples retransmitted (counting events; 1 sample can be counted many times) */
   uint32_t rexmit_lost_count; /* cum samples lost but retransmit requested (also counting events) */
+  uint32_t rexmit_multifrag_count; /* cum retransmitted DATAFRAGs covering more than one fragment */
+  uint32_t filter_gap_count; /* cum GAPs sent instead of a sample rejected by a reader's content filter */
+  uint32_t filter_rexmit_gap_count; /* cum retransmit requests answered with a GAP because of a reader's content filter */
+  uint32_t whc_trim_count; /* cum times acknowledged samples were removed from the WHC */
   struct xeventq *evq; /* timed event queue to be used by this writer */
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
 };
@@ -282,6 +318,7 @@ struct reader
   struct addrset *as;
 #endif
   const struct ddsi_sertopic * topic; /* topic is NULL for built-in readers */
+  struct nn_content_filter_property *filter; /* content filter advertised in discovery, or NULL */
   ddsrt_avl_tree_t writers; /* all matching PROXY writers, see struct rd_pwr_match */
   ddsrt_avl_tree_t local_writers; /* all matching LOCAL writers, see struct rd_wr_match */
   ddsi2direct_directread_cb_t ddsi2direct_cb;
@@ -301,6 +338,8 @@ struct proxy_participant
   struct addrset *as_default; /* default address set to use for user data traffic */
   struct addrset *as_meta; /* default address set to use for discovery traffic */
   struct proxy_endpoint_common *endpoints; /* all proxy endpoints can be reached from here */
+  uint64_t spdp_hash; /* hash of last SPDP payload received, 0 if none [builtins_pp_lock] */
+  uint32_t spdp_unchanged_count; /* cum SPDP messages not parsed because identical to the last one [builtins_pp_lock] */
   ddsrt_avl_tree_t groups; /* table of all groups (publisher, subscriber), see struct proxy_group */
   unsigned kernel_sequence_numbers : 1; /* whether this proxy participant generates OSPL kernel sequence numbers */
   unsigned implicitly_created : 1; /* participants are implicitly created for Cloud/Fog discovered endpoints */
@@ -337,6 +376,8 @@ struct proxy_endpoint_common
   struct addrset *as; /* address set to use for communicating with this endpoint */
   nn_guid_t group_guid; /* 0:0:0:0 if not available */
   nn_vendorid_t vendor; /* cached from proxypp->vendor */
+  uint64_t sedp_hash; /* hash of last SEDP payload received, 0 if none [builtins_pp_lock] */
+  uint32_t sedp_unchanged_count; /* cum SEDP messages not parsed because identical to the last one [builtins_pp_lock] */
 };
 
 struct proxy_writer {
@@ -362,6 +403,7 @@ struct proxy_writer {
   struct nn_dqueue *dqueue; /* delivery queue for asynchronous delivery (historical data is always delivered asynchronously) */
   struct xeventq *evq; /* timed event queue to be used for ACK generation */
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
+  struct coherent_set coherent; /* coherent set being received, only accessed by the (single) delivery thread */
   ddsi2direct_directread_cb_t ddsi2direct_cb;
   void *ddsi2direct_cbarg;
 };
@@ -375,6 +417,7 @@ struct proxy_reader {
 #ifdef DDSI_INCLUDE_SSM
   unsigned favours_ssm: 1; /* iff 1, this proxy reader favours SSM when available */
 #endif
+  struct nn_content_filter_property *filter; /* content filter from discovery, or NULL */
   ddsrt_avl_tree_t writers; /* matching LOCAL writers */
 };
 
@@ -483,7 +526,7 @@ struct writer *get_builtin_writer (const struct participant *pp, unsigned entity
 
 dds_retcode_t new_writer (struct writer **wr_out, struct nn_guid *wrguid, const struct nn_guid *group_guid, const struct nn_guid *ppguid, const struct ddsi_sertopic *topic, const struct nn_xqos *xqos, struct whc * whc, status_cb_t status_cb, void *status_cb_arg);
 
-dds_retcode_t new_reader (struct reader **rd_out, struct nn_guid *rdguid, const struct nn_guid *group_guid, const struct nn_guid *ppguid, const struct ddsi_sertopic *topic, const struct nn_xqos *xqos, struct rhc * rhc, status_cb_t status_cb, void *status_cb_arg);
+dds_retcode_t new_reader (struct reader **rd_out, struct nn_guid *rdguid, const struct nn_guid *group_guid, const struct nn_guid *ppguid, const struct ddsi_sertopic *topic, const struct nn_xqos *xqos, const struct nn_content_filter_property *filter, struct rhc * rhc, status_cb_t status_cb, void *status_cb_arg);
 
 struct whc_node;
 struct whc_state;
@@ -574,6 +617,18 @@ uint64_t writer_instance_id (const struct nn_guid *guid);
    rebuild them all (which only makes sense after previously having emptied them all). */
 void rebuild_or_clear_writer_addrsets(int rebuild);
 
+/* Administration of coherent sets on the receiving side: samples
+   appended to a coherent set hold a reference to the serdata and the
+   tkmap instance until cleared. */
+void coherent_set_init (struct coherent_set *cs);
+void coherent_set_fini (struct coherent_set *cs);
+void coherent_set_start (struct coherent_set *cs, seqno_t first_seq);
+void coherent_set_append (struct coherent_set *cs, seqno_t seq, struct ddsi_serdata *sample, struct ddsi_tkmap_instance *tk);
+void coherent_set_clear (struct coherent_set *cs);
+
+/* Returns true iff the reader wants coherent sets delivered atomically */
+bool reader_wants_coherent_sets (const struct reader *rd);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -83,11 +83,11 @@ void *ephash_lookup_guid_untyped (const struct nn_guid *guid);
 void *ephash_lookup_guid (const struct nn_guid *guid, enum entity_kind kind);
 
 struct participant *ephash_lookup_participant_guid (const struct nn_guid *guid);
-struct proxy_participant *ephash_lookup_proxy_participant_guid (const struct nn_guid *guid);
+DDS_EXPORT struct proxy_participant *ephash_lookup_proxy_participant_guid (const struct nn_guid *guid);
 struct writer *ephash_lookup_writer_guid (const struct nn_guid *guid);
 struct reader *ephash_lookup_reader_guid (const struct nn_guid *guid);
 struct proxy_writer *ephash_lookup_proxy_writer_guid (const struct nn_guid *guid);
-struct proxy_reader *ephash_lookup_proxy_reader_guid (const struct nn_guid *guid);
+DDS_EXPORT struct proxy_reader *ephash_lookup_proxy_reader_guid (const struct nn_guid *guid);
 
 
 /* Enumeration of entries in the hash table:
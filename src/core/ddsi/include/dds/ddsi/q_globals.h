@@ -21,6 +21,7 @@
 #include "dds/ddsrt/fibheap.h"
 
 #include "dds/ddsi/q_plist.h"
+#include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_protocol.h"
 #include "dds/ddsi/q_nwif.h"
 #include "dds/ddsi/q_sockwaitset.h"
@@ -39,6 +40,7 @@ struct serdatapool;
 struct nn_dqueue;
 struct nn_reorder;
 struct nn_defrag;
+struct nn_fec_encoder;
 struct addrset;
 struct xeventq;
 struct gcreq_queue;
@@ -79,6 +81,7 @@ struct recv_thread_arg {
     struct {
       const nn_locator_t *loc;
       struct ddsi_tran_conn *conn;
+      unsigned char trigger; /* index in group of SO_REUSEPORT sockets */
     } single;
     struct {
       os_sockWaitset ws;
@@ -127,6 +130,11 @@ struct q_globals {
   struct ddsi_tran_conn * disc_conn_uc;
   struct ddsi_tran_conn * data_conn_uc;
 
+  /* Additional sockets bound to the same port as data_conn_uc (using
+     SO_REUSEPORT), one for each additional unicast receive thread */
+  unsigned n_data_conn_uc_extra;
+  struct ddsi_tran_conn * data_conn_uc_extra[MAX_RECV_THREADS_UC - 1];
+
   /* TCP listener */
 
   struct ddsi_tran_listener * listener;
@@ -209,10 +217,10 @@ struct q_globals {
      trigger socket.) Receive buffer pool is per receive thread,
      it is only a global variable because it needs to be freed way later
      than the receive thread itself terminates */
-#define MAX_RECV_THREADS 3
+#define MAX_RECV_THREADS (2 + MAX_RECV_THREADS_UC)
   unsigned n_recv_threads;
   struct recv_thread {
-    const char *name;
+    char name[16];
     struct thread_state1 *ts;
     struct recv_thread_arg arg;
   } recv_threads[MAX_RECV_THREADS];
@@ -251,9 +259,18 @@ struct q_globals {
   struct nn_defrag *spdp_defrag;
   struct nn_reorder *spdp_reorder;
 
-  /* Built-in stuff other than SPDP gets funneled through the builtins
-     delivery queue; currently just SEDP and PMD */
-  struct nn_dqueue *builtins_dqueue;
+  /* Built-in data (SPDP, SEDP, PMD) gets funneled through the builtins
+     delivery queues, all data originating in a single participant goes
+     through the same queue (see builtins_dqueue_for_prefix) */
+  unsigned n_builtins_dqueues;
+  struct nn_dqueue *builtins_dqueues[MAX_BUILTINS_DQUEUES];
+
+  /* Data about a participant may also be relayed by another one (and
+     hence arrive on another queue): handling of discovery data is
+     serialized per participant using these locks, indexed by a hash of
+     the GUID prefix */
+#define N_BUILTINS_PP_LOCKS 64
+  ddsrt_mutex_t builtins_pp_locks[N_BUILTINS_PP_LOCKS];
 
   /* Connection used by general timed-event queue for transmitting data */
 
@@ -288,6 +305,7 @@ struct q_globals {
   struct nn_xpack *sendq_tail;
   int sendq_stop;
   struct thread_state1 *sendq_ts;
+  struct nn_fec_encoder *sendq_fec;
 
 #ifdef DDSI_INCLUDE_ENCRYPTION
   /* Codecs needed for decoding incoming encrypted messages
@@ -296,9 +314,8 @@ struct q_globals {
   q_securityDecoderSet recvSecurityCodec;
 #endif /* DDSI_INCLUDE_ENCRYPTION */
 
-  /* File for dumping captured packets, NULL if disabled */
-  FILE *pcap_fp;
-  ddsrt_mutex_t pcap_lock;
+  /* Capture of sent and received packets to a file, NULL if disabled */
+  struct pcap_writer *pcap;
 
   struct nn_group_membership *mship;
 };
@@ -18,6 +18,7 @@ extern "C" {
 
 struct writer;
 struct whc_state;
+struct wr_prd_match;
 
 struct hbcontrol {
   nn_mtime_t t_of_last_write;
@@ -35,6 +36,7 @@ int writer_hbcontrol_ack_required (const struct writer *wr, const struct whc_sta
 struct nn_xmsg *writer_hbcontrol_piggyback (struct writer *wr, const struct whc_state *whcst, nn_mtime_t tnow, unsigned packetid, int *hbansreq);
 int writer_hbcontrol_must_send (const struct writer *wr, const struct whc_state *whcst, nn_mtime_t tnow);
 struct nn_xmsg *writer_hbcontrol_create_heartbeat (struct writer *wr, const struct whc_state *whcst, nn_mtime_t tnow, int hbansreq, int issync);
+void writer_hbcontrol_note_rtt (struct writer *wr, struct wr_prd_match *m, int64_t rtt);
 
 #if defined (__cplusplus)
 }
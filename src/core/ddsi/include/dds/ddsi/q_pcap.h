@@ -20,12 +20,14 @@ extern "C" {
 #endif
 
 struct msghdr;
+struct pcap_writer;
 
-FILE * new_pcap_file (const char *name);
+struct pcap_writer *new_pcap_writer (const char *name);
+void free_pcap_writer (struct pcap_writer *pw);
 
 void write_pcap_received
 (
-  FILE * fp,
+  struct pcap_writer * pw,
   nn_wctime_t tstamp,
   const struct sockaddr_storage * src,
   const struct sockaddr_storage * dst,
@@ -35,7 +37,7 @@ void write_pcap_received
 
 void write_pcap_sent
 (
-  FILE * fp,
+  struct pcap_writer * pw,
   nn_wctime_t tstamp,
   const struct sockaddr_storage * src,
   const ddsrt_msghdr_t * hdr,
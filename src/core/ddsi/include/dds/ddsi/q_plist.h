@@ -132,6 +132,14 @@ typedef struct nn_prismtech_eotinfo {
   nn_prismtech_eotgroup_tid_t *tids;
 } nn_prismtech_eotinfo_t;
 
+typedef struct nn_content_filter_property {
+  char *content_filtered_topic_name;
+  char *related_topic_name;
+  char *filter_class_name;
+  char *filter_expression;
+  nn_stringseq_t expression_parameters;
+} nn_content_filter_property_t;
+
 typedef struct nn_plist {
   uint64_t present;
   uint64_t aliased;
@@ -152,7 +160,7 @@ typedef struct nn_plist {
   nn_count_t participant_manual_liveliness_count;
   unsigned participant_builtin_endpoints;
   nn_duration_t participant_lease_duration;
-  /* nn_content_filter_property_t content_filter_property; */
+  nn_content_filter_property_t content_filter_property;
   nn_guid_t participant_guid;
   nn_guid_t endpoint_guid;
   nn_guid_t group_guid;
@@ -201,6 +209,9 @@ DDS_EXPORT void nn_plist_fini (nn_plist_t *ps);
 DDS_EXPORT void nn_plist_addtomsg (struct nn_xmsg *m, const nn_plist_t *ps, uint64_t pwanted, uint64_t qwanted);
 DDS_EXPORT int nn_plist_init_default_participant (nn_plist_t *plist);
 
+DDS_EXPORT nn_content_filter_property_t *nn_content_filter_property_dup (const nn_content_filter_property_t *src);
+DDS_EXPORT void nn_content_filter_property_free (nn_content_filter_property_t *cfp);
+
 DDS_EXPORT int validate_history_qospolicy (const nn_history_qospolicy_t *q);
 DDS_EXPORT int validate_durability_qospolicy (const nn_durability_qospolicy_t *q);
 DDS_EXPORT int validate_resource_limits_qospolicy (const nn_resource_limits_qospolicy_t *q);
@@ -222,6 +233,7 @@ struct nn_rdata;
 
 DDS_EXPORT unsigned char *nn_plist_quickscan (struct nn_rsample_info *dest, const struct nn_rmsg *rmsg, const nn_plist_src_t *src);
 DDS_EXPORT const unsigned char *nn_plist_findparam_native_unchecked (const void *src, nn_parameterid_t pid);
+DDS_EXPORT int nn_plist_findparam_checking (const nn_plist_src_t *src, nn_parameterid_t pid, const unsigned char **value, uint16_t *length);
 
 #if defined (__cplusplus)
 }
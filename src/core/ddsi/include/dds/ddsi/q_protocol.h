@@ -162,7 +162,9 @@ typedef enum SubmessageKind {
   /* vendor-specific sub messages (0x80 .. 0xff) */
   SMID_PT_INFO_CONTAINER = 0x80,
   SMID_PT_MSG_LEN = 0x81,
-  SMID_PT_ENTITY_ID = 0x82
+  SMID_PT_ENTITY_ID = 0x82,
+  SMID_PT_FEC_INFO = 0x83,
+  SMID_PT_FEC_PARITY = 0x84
 } SubmessageKind_t;
 
 typedef struct InfoTimestamp {
@@ -298,6 +300,26 @@ typedef struct PT_InfoContainer {
 } PT_InfoContainer_t;
 #define PTINFO_ID_ENCRYPT (0x01u)
 
+/* Forward error correction: packets covered by FEC carry a FEC_INFO
+   as their first submessage, identifying the packet within the stream
+   of packets of the sending xpack; every so many packets of a stream
+   a packet consisting of a header and a FEC_PARITY is sent, the
+   payload of which is the XOR of the (zero-padded) packets
+   firstseq .. firstseq+count-1. */
+typedef struct PT_FecInfo {
+  SubmessageHeader_t smhdr;
+  uint32_t streamid;
+  uint32_t seq;
+} PT_FecInfo_t;
+
+typedef struct PT_FecParity {
+  SubmessageHeader_t smhdr;
+  uint32_t streamid;
+  uint32_t firstseq;
+  uint32_t count;
+  uint32_t lenxor; /* XOR of the lengths of the packets */
+} PT_FecParity_t;
+
 typedef union Submessage {
   SubmessageHeader_t smhdr;
   AckNack_t acknack;
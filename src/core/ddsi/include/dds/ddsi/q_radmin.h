@@ -30,9 +30,12 @@ struct nn_rsample_info;
 struct nn_defrag;
 struct nn_reorder;
 struct nn_dqueue;
+struct nn_fec_decoder;
 struct nn_guid;
+struct nn_defrag_contig;
 
 struct proxy_writer;
+struct ddsi_serdata;
 
 struct nn_fragment_number_set;
 struct nn_sequence_number_set;
@@ -93,6 +96,12 @@ struct nn_rmsg {
      the real packet. */
   struct nn_rmsg_chunk *lastchunk;
 
+  /* Samples reassembled contiguously (see DEFRAG) of which the first
+     fragment is in this message: these remain valid for as long as
+     the message itself and get released when the message is freed.
+     Only modified by the receive thread while uncommitted. */
+  struct nn_defrag_contig *contigs;
+
   struct nn_rmsg_chunk chunk;
 };
 #define NN_RMSG_PAYLOAD(m) ((m)->chunk.u.payload)
@@ -121,6 +130,8 @@ struct nn_rsample_info {
   unsigned pt_wr_info_zoff: 16; /* PrismTech writer info offset */
   unsigned bswap: 1;            /* so we can extract well formatted writer info quicker */
   unsigned complex_qos: 1;      /* includes QoS other than keyhash, 2-bit statusinfo, PT writer info */
+  unsigned malformed: 1;        /* reassembled contiguously but rejected by fix_ser, serdata is NULL */
+  struct ddsi_serdata *serdata; /* non-NULL iff reassembled contiguously, owned by rmsg of first fragment */
 };
 
 struct nn_rdata {
@@ -194,6 +205,19 @@ typedef int32_t nn_reorder_result_t;
 
 typedef void (*nn_dqueue_callback_t) (void *arg);
 
+/* Allocates a serdata of sampleinfo->size bytes into which the defragmenter
+   copies the fragments as they arrive, returning it in *sd; returns
+   NN_DEFRAG_CONTIG_OK on success, NN_DEFRAG_CONTIG_UNSUPPORTED if the sample
+   should be defragmented in the receive buffers instead, and
+   NN_DEFRAG_CONTIG_NOMEM if the memory could not be allocated, in which case
+   the sample is dropped. */
+enum nn_defrag_contig_alloc_result {
+  NN_DEFRAG_CONTIG_OK,
+  NN_DEFRAG_CONTIG_UNSUPPORTED,
+  NN_DEFRAG_CONTIG_NOMEM
+};
+typedef enum nn_defrag_contig_alloc_result (*nn_defrag_contig_alloc_t) (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *rdata, struct ddsi_serdata **sd, unsigned char **buf);
+
 struct nn_rbufpool *nn_rbufpool_new (uint32_t rbuf_size, uint32_t max_rmsg_size);
 void nn_rbufpool_setowner (struct nn_rbufpool *rbp, ddsrt_thread_t tid);
 void nn_rbufpool_free (struct nn_rbufpool *rbp);
@@ -209,8 +233,17 @@ struct nn_rdata *nn_rdata_newgap (struct nn_rmsg *rmsg);
 void nn_fragchain_adjust_refcount (struct nn_rdata *frag, int adjust);
 void nn_fragchain_unref (struct nn_rdata *frag);
 
+DDS_EXPORT void nn_fec_xor (unsigned char *dst, const unsigned char *src, size_t n);
+DDS_EXPORT struct nn_fec_decoder *nn_fec_decoder_new (void);
+DDS_EXPORT void nn_fec_decoder_free (struct nn_fec_decoder *dec);
+DDS_EXPORT bool nn_fec_decoder_note_packet (struct nn_fec_decoder *dec, const nn_guid_prefix_t *src, uint32_t streamid, uint32_t seq, const unsigned char *msg, uint32_t len);
+DDS_EXPORT const unsigned char *nn_fec_decoder_parity (struct nn_fec_decoder *dec, const nn_guid_prefix_t *src, uint32_t streamid, uint32_t firstseq, uint32_t count, uint32_t lenxor, const unsigned char *payload, uint32_t paylen, uint32_t *seq, uint32_t *len);
+/* Memory used for retaining copies of packets, bounded by a constant */
+DDS_EXPORT size_t nn_fec_decoder_memsize (const struct nn_fec_decoder *dec);
+
 struct nn_defrag *nn_defrag_new (enum nn_defrag_drop_mode drop_mode, uint32_t max_samples);
 void nn_defrag_free (struct nn_defrag *defrag);
+void nn_defrag_set_contig (struct nn_defrag *defrag, uint32_t minsize, uint32_t maxsize, nn_defrag_contig_alloc_t alloc);
 struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo);
 void nn_defrag_notegap (struct nn_defrag *defrag, seqno_t min, seqno_t maxp1);
 int nn_defrag_nackmap (struct nn_defrag *defrag, seqno_t seq, uint32_t maxfragnum, struct nn_fragment_number_set *map, uint32_t maxsz);
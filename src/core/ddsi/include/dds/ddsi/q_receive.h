@@ -21,11 +21,13 @@ struct nn_rsample_info;
 struct nn_rdata;
 struct ddsi_tran_listener;
 struct recv_thread_arg;
+struct ddsi_serdata;
 
 void trigger_recv_threads (void);
 uint32_t recv_thread (void *vrecv_thread_arg);
 uint32_t listen_thread (struct ddsi_tran_listener * listener);
 int user_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const nn_guid_t *rdguid, void *qarg);
+enum nn_defrag_contig_alloc_result defrag_contig_alloc (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *rdata, struct ddsi_serdata **sd, unsigned char **buf);
 
 #if defined (__cplusplus)
 }
@@ -13,18 +13,17 @@
 #ifndef Q_SECURITY_H
 #define Q_SECURITY_H
 
-#include "c_typebase.h"
+#include "dds/export.h"
 
 #if defined (__cplusplus)
 extern "C" {
 #endif
 
-/* Generic class */
-C_CLASS(q_securityEncoderSet);
-C_CLASS(q_securityDecoderSet);
+typedef struct q_securityEncoderSet *q_securityEncoderSet;
+typedef struct q_securityDecoderSet *q_securityDecoderSet;
 
 /* Set of supported ciphers */
-typedef enum 
+typedef enum
 {
   Q_CIPHER_UNDEFINED,
   Q_CIPHER_NULL,
@@ -33,10 +32,13 @@ typedef enum
   Q_CIPHER_AES192,
   Q_CIPHER_AES256,
   Q_CIPHER_NONE,
+  Q_CIPHER_AES128_GCM,
+  Q_CIPHER_AES256_GCM,
+  Q_CIPHER_CHACHA20_POLY1305,
   Q_CIPHER_MAX
 } q_cipherType;
 
-void ddsi_security_plugin (void);
+DDS_EXPORT void ddsi_security_plugin (void);
 
 #if defined (__cplusplus)
 }
@@ -12,6 +12,7 @@
 #ifndef Q_TRANSMIT_H
 #define Q_TRANSMIT_H
 
+#include <stdbool.h>
 #include "dds/ddsi/q_rtps.h" /* for nn_entityid_t */
 
 #if defined (__cplusplus)
@@ -23,6 +24,7 @@ struct nn_xmsg;
 struct writer;
 struct whc_state;
 struct proxy_reader;
+struct addrset;
 struct ddsi_serdata;
 struct ddsi_tkmap_instance;
 struct thread_state1;
@@ -39,10 +41,25 @@ int write_sample_nogc (struct thread_state1 * const ts1, struct nn_xpack *xp, st
 int write_sample_gc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 int write_sample_nogc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 
+/* Coherent sets: all samples written between begin and end share the
+   coherent set id, the end is marked by writing an empty sample that
+   completes the set (unless the set is empty) */
+/* Evaluates a proxy reader's compiled content filter on a sample (true
+   if it can't be evaluated) */
+bool writer_filter_accepts (const void *filter, const struct ddsi_serdata *serdata);
+
+void writer_begin_coherent (struct writer *wr);
+int writer_end_coherent (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr);
+
 /* When calling the following functions, wr->lock must be held */
-int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, struct proxy_reader *prd,struct nn_xmsg **msg, int isnew);
-int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew);
+
+/* Creates a message containing (at most) nfrags fragments starting at
+   fragnum, returns the number of fragments it contains or a negative
+   error code */
+int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, unsigned nfrags, struct proxy_reader *prd, struct addrset *as, struct nn_xmsg **msg, int isnew);
+int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, struct addrset *as, int isnew);
 void add_Heartbeat (struct nn_xmsg *msg, struct writer *wr, const struct whc_state *whcst, int hbansreq, nn_entityid_t dst, int issync);
+int add_Gap (struct nn_xmsg *msg, struct writer *wr, struct proxy_reader *prd, seqno_t start, seqno_t base, uint32_t numbits, const uint32_t *bits);
 
 #if defined (__cplusplus)
 }
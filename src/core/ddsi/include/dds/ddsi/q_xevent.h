@@ -62,6 +62,7 @@ DDS_EXPORT struct xevent *qxev_acknack (struct xeventq *evq, nn_mtime_t tsched,
 DDS_EXPORT struct xevent *qxev_spdp (nn_mtime_t tsched, const nn_guid_t *pp_guid, const nn_guid_t *proxypp_guid);
 DDS_EXPORT struct xevent *qxev_pmd_update (nn_mtime_t tsched, const nn_guid_t *pp_guid);
 DDS_EXPORT struct xevent *qxev_delete_writer (nn_mtime_t tsched, const nn_guid_t *guid);
+DDS_EXPORT struct xevent *qxev_whc_trim (struct xeventq *evq, nn_mtime_t tsched, const nn_guid_t *wr_guid);
 
 /* cb will be called with now = T_NEVER if the event is still enqueued when when xeventq_free starts cleaning up */
 DDS_EXPORT struct xevent *qxev_callback (nn_mtime_t tsched, void (*cb) (struct xevent *xev, void *arg, nn_mtime_t now), void *arg);
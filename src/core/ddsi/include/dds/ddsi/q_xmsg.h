@@ -30,6 +30,7 @@ struct proxy_writer;
 struct nn_prismtech_participant_version_info;
 struct nn_prismtech_writer_info;
 struct nn_prismtech_eotinfo;
+struct nn_content_filter_property;
 struct nn_xmsgpool;
 struct nn_xmsg_data;
 struct nn_xmsg;
@@ -98,16 +99,18 @@ int nn_xmsg_merge_rexmit_destinations_wrlock_held (struct nn_xmsg *m, const stru
 
 /* To set writer ids for updating last transmitted sequence number;
    wrfragid is 0 based, unlike DDSI but like other places where
-   fragment numbers are handled internally. */
+   fragment numbers are handled internally.  It is the last fragment
+   in the message, wrnfrags the number of fragments it contains. */
 void nn_xmsg_setwriterseq (struct nn_xmsg *msg, const nn_guid_t *wrguid, seqno_t wrseq);
-void nn_xmsg_setwriterseq_fragid (struct nn_xmsg *msg, const nn_guid_t *wrguid, seqno_t wrseq, nn_fragment_number_t wrfragid);
+void nn_xmsg_setwriterseq_fragid (struct nn_xmsg *msg, const nn_guid_t *wrguid, seqno_t wrseq, nn_fragment_number_t wrfragid, uint32_t wrnfrags);
 
 /* Comparison function for retransmits: orders messages on writer
-   guid, sequence number and fragment id */
+   guid, sequence number, fragment id and number of fragments */
 int nn_xmsg_compare_fragid (const struct nn_xmsg *a, const struct nn_xmsg *b);
 
 void nn_xmsg_free (struct nn_xmsg *msg);
 size_t nn_xmsg_size (const struct nn_xmsg *m);
+size_t nn_xmsg_total_size (const struct nn_xmsg *m); /* including referenced serialised data */
 void *nn_xmsg_payload (size_t *sz, struct nn_xmsg *m);
 void nn_xmsg_payload_to_plistsample (struct ddsi_plist_sample *dst, nn_parameterid_t keyparam, const struct nn_xmsg *m);
 enum nn_xmsg_kind nn_xmsg_kind (const struct nn_xmsg *m);
@@ -125,6 +128,7 @@ void *nn_xmsg_addpar (struct nn_xmsg *m, unsigned pid, size_t len);
 void nn_xmsg_addpar_string (struct nn_xmsg *m, unsigned pid, const char *str);
 void nn_xmsg_addpar_octetseq (struct nn_xmsg *m, unsigned pid, const nn_octetseq_t *oseq);
 void nn_xmsg_addpar_stringseq (struct nn_xmsg *m, unsigned pid, const nn_stringseq_t *sseq);
+void nn_xmsg_addpar_content_filter_property (struct nn_xmsg *m, unsigned pid, const struct nn_content_filter_property *cfp);
 void nn_xmsg_addpar_guid (struct nn_xmsg *m, unsigned pid, const nn_guid_t *guid);
 void nn_xmsg_addpar_BE4u (struct nn_xmsg *m, unsigned pid, unsigned x);
 void nn_xmsg_addpar_4u (struct nn_xmsg *m, unsigned pid, unsigned x);
@@ -30,9 +30,13 @@
 /* 8k entries in the freelist seems to be roughly the amount needed to send
    minimum-size (well, 4 bytes) samples as fast as possible over loopback
    while using large messages -- actually, it stands to reason that this would
-   be the same as the WHC node pool size */
+   be the same as the WHC node pool size; the larger size classes get
+   proportionally fewer entries: the memory held by each class is limited to
+   that held by 8k entries of the smallest class.  The freelist itself only
+   approximately bounds the number of entries, hence the separate accounting */
 #define MAX_POOL_SIZE 8192
-#define MAX_SIZE_FOR_POOL 256
+#define MIN_SIZE_FOR_POOL 128
+#define MAX_POOL_BYTES (MAX_POOL_SIZE * MIN_SIZE_FOR_POOL)
 #define CLEAR_PADDING 0
 
 #ifndef NDEBUG
@@ -47,8 +51,13 @@ static size_t alignup_size (size_t x, size_t a);
 struct serdatapool * ddsi_serdatapool_new (void)
 {
   struct serdatapool * pool;
+  uint32_t i;
   pool = ddsrt_malloc (sizeof (*pool));
-  nn_freelist_init (&pool->freelist, MAX_POOL_SIZE, offsetof (struct ddsi_serdata_default, next));
+  for (i = 0; i < SERDATAPOOL_NCLASSES; i++)
+  {
+    nn_freelist_init (&pool->freelist[i], MAX_POOL_SIZE >> (2 * i), offsetof (struct ddsi_serdata_default, next));
+    ddsrt_atomic_st32 (&pool->bytes[i], 0);
+  }
   return pool;
 }
 
@@ -63,11 +72,54 @@ static void serdata_free_wrap (void *elem)
 
 void ddsi_serdatapool_free (struct serdatapool * pool)
 {
+  uint32_t i;
   DDS_TRACE("ddsi_serdatapool_free(%p)\n", (void *) pool);
-  nn_freelist_fini (&pool->freelist, serdata_free_wrap);
+  for (i = 0; i < SERDATAPOOL_NCLASSES; i++)
+    nn_freelist_fini (&pool->freelist[i], serdata_free_wrap);
   ddsrt_free (pool);
 }
 
+static uint32_t serdatapool_class_size (uint32_t cls)
+{
+  return MIN_SIZE_FOR_POOL << (2 * cls);
+}
+
+/* Smallest size class that can hold SIZE bytes, SERDATAPOOL_NCLASSES if none */
+static uint32_t serdatapool_class_for_alloc (uint32_t size)
+{
+  uint32_t cls = 0;
+  while (cls < SERDATAPOOL_NCLASSES && serdatapool_class_size (cls) < size)
+    cls++;
+  return cls;
+}
+
+/* Largest size class a serdata of SIZE bytes can serve, SERDATAPOOL_NCLASSES if
+   it is too small for any (as happens for the trimmed key-only ones used in the
+   instance map) or so much larger than that class that keeping it in the pool
+   would be a waste of memory */
+static uint32_t serdatapool_class_for_free (uint32_t size)
+{
+  uint32_t cls = SERDATAPOOL_NCLASSES;
+  if (size < MIN_SIZE_FOR_POOL)
+    return SERDATAPOOL_NCLASSES;
+  while (serdatapool_class_size (cls - 1) > size)
+    cls--;
+  return (size < 2 * serdatapool_class_size (cls - 1)) ? cls - 1 : SERDATAPOOL_NCLASSES;
+}
+
+/* Accounts for a serdata of SIZE bytes about to be added to the pool of class
+   CLS, returns false if that would exceed the limit on the memory held by it */
+static bool serdatapool_reserve (struct serdatapool *pool, uint32_t cls, uint32_t size)
+{
+  uint32_t bytes;
+  do {
+    bytes = ddsrt_atomic_ld32 (&pool->bytes[cls]);
+    if (bytes + size > MAX_POOL_BYTES)
+      return false;
+  } while (!ddsrt_atomic_cas32 (&pool->bytes[cls], bytes, bytes + size));
+  return true;
+}
+
 static size_t alignup_size (size_t x, size_t a)
 {
   size_t m = a-1;
@@ -209,9 +261,16 @@ static bool serdata_default_eqkey_nokey (const struct ddsi_serdata *acmn, const
 static void serdata_default_free(struct ddsi_serdata *dcmn)
 {
   struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)dcmn;
+  struct serdatapool * const pool = gv.serpool;
+  const uint32_t cls = serdatapool_class_for_free (d->size);
   assert(ddsrt_atomic_ld32(&d->c.refc) == 0);
-  if (d->size > MAX_SIZE_FOR_POOL || !nn_freelist_push (&gv.serpool->freelist, d))
+  if (cls == SERDATAPOOL_NCLASSES || !serdatapool_reserve (pool, cls, d->size))
+    dds_free (d);
+  else if (!nn_freelist_push (&pool->freelist[cls], d))
+  {
+    ddsrt_atomic_sub32 (&pool->bytes[cls], d->size);
     dds_free (d);
+  }
 }
 
 static void serdata_default_init(struct ddsi_serdata_default *d, const struct ddsi_sertopic_default *tp, enum ddsi_serdata_kind kind)
@@ -228,31 +287,65 @@ static void serdata_default_init(struct ddsi_serdata_default *d, const struct dd
   d->keyhash.m_iskey = 0;
 }
 
-static struct ddsi_serdata_default *serdata_default_allocnew(struct serdatapool *pool)
+static struct ddsi_serdata_default *serdata_default_allocnew(struct serdatapool *pool, uint32_t size)
 {
-  const uint32_t init_size = 128;
-  struct ddsi_serdata_default *d = ddsrt_malloc(offsetof (struct ddsi_serdata_default, data) + init_size);
-  d->size = init_size;
+  struct ddsi_serdata_default *d;
+  if ((d = ddsrt_malloc_s(offsetof (struct ddsi_serdata_default, data) + size)) == NULL)
+    return NULL;
+  d->size = size;
   d->pool = pool;
   return d;
 }
 
-static struct ddsi_serdata_default *serdata_default_new(const struct ddsi_sertopic_default *tp, enum ddsi_serdata_kind kind)
+/* Returns a serdata with room for at least SIZE bytes of data, taking it from
+   the pool of the matching size class if possible, or NULL if out of memory */
+static struct ddsi_serdata_default *serdata_default_new_s(const struct ddsi_sertopic_default *tp, enum ddsi_serdata_kind kind, uint32_t size)
 {
+  const uint32_t cls = serdatapool_class_for_alloc (size);
   struct ddsi_serdata_default *d;
-  if ((d = nn_freelist_pop (&gv.serpool->freelist)) == NULL)
-    d = serdata_default_allocnew(gv.serpool);
+  if (cls == SERDATAPOOL_NCLASSES)
+    d = serdata_default_allocnew(gv.serpool, (uint32_t) alignup_size (size, 128));
+  else if ((d = nn_freelist_pop (&gv.serpool->freelist[cls])) == NULL)
+    d = serdata_default_allocnew(gv.serpool, serdatapool_class_size (cls));
   else
+  {
+    ddsrt_atomic_sub32(&gv.serpool->bytes[cls], d->size);
     ddsrt_atomic_st32(&d->c.refc, 1);
+  }
+  if (d == NULL)
+    return NULL;
   serdata_default_init(d, tp, kind);
   return d;
 }
 
+static struct ddsi_serdata_default *serdata_default_new(const struct ddsi_sertopic_default *tp, enum ddsi_serdata_kind kind, uint32_t size)
+{
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_new_s(tp, kind, size)) == NULL)
+    abort();
+  return d;
+}
+
+/* Validate received data and convert it to native endianness, once, so that
+   everything downstream (key extraction, deserialisation, filtering) can rely
+   on well-formed data in native byte order; returns false if malformed */
+static bool serdata_default_normalize (struct ddsi_serdata_default *d, const struct ddsi_sertopic_default *tp)
+{
+  if (d->c.ops != &ddsi_serdata_ops_cdr && d->c.ops != &ddsi_serdata_ops_cdr_nokey)
+    return true;
+  if (d->hdr.identifier != CDR_LE && d->hdr.identifier != CDR_BE)
+    return false;
+  if (!dds_stream_normalize (d->data, d->pos, d->hdr.identifier != tp->native_encoding_identifier, tp, d->c.kind == SDK_KEY))
+    return false;
+  d->hdr.identifier = tp->native_encoding_identifier;
+  return true;
+}
+
 /* Construct a serdata from a fragchain received over the network */
 static struct ddsi_serdata_default *serdata_default_from_ser_common (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
 {
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
-  struct ddsi_serdata_default *d = serdata_default_new(tp, kind);
+  struct ddsi_serdata_default *d = serdata_default_new(tp, kind, (uint32_t) size);
   uint32_t off = 4; /* must skip the CDR header */
 
   assert (fragchain->min == 0);
@@ -260,7 +353,6 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
   (void)size;
 
   memcpy (&d->hdr, NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain)), sizeof (d->hdr));
-  assert (d->hdr.identifier == CDR_LE || d->hdr.identifier == CDR_BE);
 
   while (fragchain)
   {
@@ -276,6 +368,11 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
     fragchain = fragchain->nextfrag;
   }
 
+  if (!serdata_default_normalize (d, tp))
+  {
+    ddsi_serdata_unref (&d->c);
+    return NULL;
+  }
   dds_stream_t is;
   dds_stream_from_serdata_default (&is, d);
   dds_stream_read_keyhash (&is, &d->keyhash, (const dds_topic_descriptor_t *)tp->type, kind == SDK_KEY);
@@ -284,12 +381,67 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
 
 static struct ddsi_serdata *serdata_default_from_ser (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
 {
-  return fix_serdata_default (serdata_default_from_ser_common (tpcmn, kind, fragchain, size), tpcmn->serdata_basehash);
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_from_ser_common (tpcmn, kind, fragchain, size)) == NULL)
+    return NULL;
+  return fix_serdata_default (d, tpcmn->serdata_basehash);
 }
 
 static struct ddsi_serdata *serdata_default_from_ser_nokey (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
 {
-  return fix_serdata_default_nokey (serdata_default_from_ser_common (tpcmn, kind, fragchain, size), tpcmn->serdata_basehash);
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_from_ser_common (tpcmn, kind, fragchain, size)) == NULL)
+    return NULL;
+  return fix_serdata_default_nokey (d, tpcmn->serdata_basehash);
+}
+
+/* Allocate a serdata for "size" bytes of serialised data, CDR header included, to be filled in
+   by the caller (reassembling fragments directly into it), then completed by fix_ser */
+static struct ddsi_serdata *serdata_default_alloc_ser (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, size_t size, unsigned char **buf)
+{
+  const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
+  struct ddsi_serdata_default *d;
+  /* size is set by the sender: leave room for rounding up to the allocation granularity */
+  if (size < sizeof (struct CDRHeader) || size > UINT32_MAX - 128 - offsetof (struct ddsi_serdata_default, data))
+    return NULL;
+  if ((d = serdata_default_new_s(tp, kind, (uint32_t) (size - sizeof (struct CDRHeader)))) == NULL)
+    return NULL;
+  d->pos = (uint32_t) (size - sizeof (struct CDRHeader));
+  *buf = (unsigned char *) &d->hdr;
+  return &d->c;
+}
+
+static struct ddsi_serdata_default *serdata_default_fix_ser_common (struct ddsi_serdata *dcmn)
+{
+  struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)dcmn;
+  const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)d->c.topic;
+  if (!serdata_default_normalize (d, tp))
+  {
+    ddsi_serdata_unref (&d->c);
+    return NULL;
+  }
+  dds_stream_t is;
+  dds_stream_from_serdata_default (&is, d);
+  dds_stream_read_keyhash (&is, &d->keyhash, (const dds_topic_descriptor_t *)tp->type, d->c.kind == SDK_KEY);
+  return d;
+}
+
+static struct ddsi_serdata *serdata_default_fix_ser (struct ddsi_serdata *dcmn)
+{
+  const uint32_t basehash = dcmn->topic->serdata_basehash;
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_fix_ser_common (dcmn)) == NULL)
+    return NULL;
+  return fix_serdata_default (d, basehash);
+}
+
+static struct ddsi_serdata *serdata_default_fix_ser_nokey (struct ddsi_serdata *dcmn)
+{
+  const uint32_t basehash = dcmn->topic->serdata_basehash;
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_fix_ser_common (dcmn)) == NULL)
+    return NULL;
+  return fix_serdata_default_nokey (d, basehash);
 }
 
 struct ddsi_serdata *ddsi_serdata_from_keyhash_cdr (const struct ddsi_sertopic *tpcmn, const nn_keyhash_t *keyhash)
@@ -303,7 +455,7 @@ struct ddsi_serdata *ddsi_serdata_from_keyhash_cdr (const struct ddsi_sertopic *
   }
   else
   {
-    struct ddsi_serdata_default *d = serdata_default_new(tp, SDK_KEY);
+    struct ddsi_serdata_default *d = serdata_default_new(tp, SDK_KEY, 0);
     d->hdr.identifier = CDR_BE;
     serdata_default_append_blob (&d, 1, sizeof (keyhash->value), keyhash->value);
     memcpy (d->keyhash.m_hash, keyhash->value, sizeof (d->keyhash.m_hash));
@@ -316,7 +468,7 @@ struct ddsi_serdata *ddsi_serdata_from_keyhash_cdr (const struct ddsi_sertopic *
 struct ddsi_serdata *ddsi_serdata_from_keyhash_cdr_nokey (const struct ddsi_sertopic *tpcmn, const nn_keyhash_t *keyhash)
 {
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
-  struct ddsi_serdata_default *d = serdata_default_new(tp, SDK_KEY);
+  struct ddsi_serdata_default *d = serdata_default_new(tp, SDK_KEY, 0);
   (void)keyhash;
   d->keyhash.m_set = 1;
   d->keyhash.m_iskey = 1;
@@ -326,9 +478,14 @@ struct ddsi_serdata *ddsi_serdata_from_keyhash_cdr_nokey (const struct ddsi_sert
 static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
-  struct ddsi_serdata_default *d = serdata_default_new(tp, kind);
+  /* Samples of a type tend to be of similar size, so allocating a serdata of the size of the
+     previous one nearly always avoids having to grow it while serializing */
+  ddsrt_atomic_uint32_t *size_hint = (ddsrt_atomic_uint32_t *) &tp->serdata_size_hint;
+  struct ddsi_serdata_default *d = serdata_default_new(tp, kind, (kind == SDK_DATA) ? ddsrt_atomic_ld32 (size_hint) : 0);
   dds_stream_t os;
-  dds_key_gen ((const dds_topic_descriptor_t *)tp->type, &d->keyhash, (char*)sample);
+  /* an empty sample (e.g., marking the end of a coherent set) needn't have a sample */
+  if (kind != SDK_EMPTY)
+    dds_key_gen ((const dds_topic_descriptor_t *)tp->type, &d->keyhash, (char*)sample);
   dds_stream_from_serdata_default (&os, d);
   switch (kind)
   {
@@ -342,6 +499,8 @@ static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (cons
       break;
   }
   dds_stream_add_to_serdata_default (&os, &d);
+  if (kind == SDK_DATA && d->pos != ddsrt_atomic_ld32 (size_hint))
+    ddsrt_atomic_st32 (size_hint, d->pos);
   return d;
 }
 
@@ -360,7 +519,7 @@ static struct ddsi_serdata *serdata_default_from_sample_plist (const struct ddsi
   /* Currently restricted to DDSI discovery data (XTypes will need a rethink of the default representation and that may result in discovery data being moved to that new representation), and that means: keys are either GUIDs or an unbounded string for topics, for which MD5 is acceptable. Furthermore, these things don't get written very often, so scanning the parameter list to get the key value out is good enough for now. And at least it keeps the DDSI discovery data writing out of the internals of the sample representation */
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
   const struct ddsi_plist_sample *sample = vsample;
-  struct ddsi_serdata_default *d = serdata_default_new(tp, kind);
+  struct ddsi_serdata_default *d = serdata_default_new(tp, kind, (uint32_t) sample->size);
   serdata_default_append_blob (&d, 1, sample->size, sample->blob);
   const unsigned char *rawkey = nn_plist_findparam_native_unchecked (sample->blob, sample->keyparam);
 #ifndef NDEBUG
@@ -415,7 +574,7 @@ static struct ddsi_serdata *serdata_default_from_sample_rawcdr (const struct dds
   /* Currently restricted to DDSI discovery data (XTypes will need a rethink of the default representation and that may result in discovery data being moved to that new representation), and that means: keys are either GUIDs or an unbounded string for topics, for which MD5 is acceptable. Furthermore, these things don't get written very often, so scanning the parameter list to get the key value out is good enough for now. And at least it keeps the DDSI discovery data writing out of the internals of the sample representation */
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
   const struct ddsi_rawcdr_sample *sample = vsample;
-  struct ddsi_serdata_default *d = serdata_default_new(tp, kind);
+  struct ddsi_serdata_default *d = serdata_default_new(tp, kind, (uint32_t) sample->size);
   assert (sample->keysize <= 16);
   serdata_default_append_blob (&d, 1, sample->size, sample->blob);
   d->keyhash.m_set = 1;
@@ -433,7 +592,7 @@ static struct ddsi_serdata *serdata_default_to_topicless (const struct ddsi_serd
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)d->c.topic;
-  struct ddsi_serdata_default *d_tl = serdata_default_new(tp, SDK_KEY);
+  struct ddsi_serdata_default *d_tl = serdata_default_new(tp, SDK_KEY, 0);
   d_tl->c.topic = NULL;
   d_tl->c.hash = d->c.hash;
   d_tl->c.timestamp.v = INT64_MIN;
@@ -544,7 +703,9 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr = {
   .to_ser_ref = serdata_default_to_ser_ref,
   .to_ser_unref = serdata_default_to_ser_unref,
   .to_topicless = serdata_default_to_topicless,
-  .topicless_to_sample = serdata_default_topicless_to_sample_cdr
+  .topicless_to_sample = serdata_default_topicless_to_sample_cdr,
+  .alloc_ser = serdata_default_alloc_ser,
+  .fix_ser = serdata_default_fix_ser
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
@@ -559,7 +720,9 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
   .to_ser_ref = serdata_default_to_ser_ref,
   .to_ser_unref = serdata_default_to_ser_unref,
   .to_topicless = serdata_default_to_topicless,
-  .topicless_to_sample = serdata_default_topicless_to_sample_cdr_nokey
+  .topicless_to_sample = serdata_default_topicless_to_sample_cdr_nokey,
+  .alloc_ser = serdata_default_alloc_ser,
+  .fix_ser = serdata_default_fix_ser_nokey
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_plist = {
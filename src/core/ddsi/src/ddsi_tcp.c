@@ -180,7 +180,7 @@ static void ddsi_tcp_sock_free (ddsrt_socket_t sock, const char * msg)
 
 static void ddsi_tcp_sock_new (ddsrt_socket_t * sock, unsigned short port)
 {
-  if (make_socket (sock, port, true, true) != 0)
+  if (make_socket (sock, port, true, true, false) != 0)
   {
     *sock = DDSRT_INVALID_SOCKET;
   }
@@ -27,6 +27,17 @@
 #include "dds/ddsi/q_pcap.h"
 #include "dds/ddsi/q_globals.h"
 
+#if defined __linux
+#include <linux/filter.h>
+#endif
+
+/* Destination address of received packets, for packet capture */
+#if !defined _WIN32 && defined IP_PKTINFO
+#define DDSI_UDP_PKTINFO 1
+#else
+#define DDSI_UDP_PKTINFO 0
+#endif
+
 extern void ddsi_factory_conn_init (ddsi_tran_factory_t factory, ddsi_tran_conn_t conn);
 
 typedef struct ddsi_tran_factory * ddsi_udp_factory_t;
@@ -45,6 +56,8 @@ typedef struct ddsi_udp_conn
   WSAEVENT m_sockEvent;
 #endif
   int m_diffserv;
+  int m_pktinfo; /* IPv4 destination address of received packets available */
+  struct sockaddr_storage m_laddr; /* bound address, destination of captured packets otherwise */
 }
 * ddsi_udp_conn_t;
 
@@ -52,8 +65,37 @@ static struct ddsi_udp_config ddsi_udp_config_g;
 static struct ddsi_tran_factory ddsi_udp_factory_g;
 static ddsrt_atomic_uint32_t ddsi_udp_init_g = DDSRT_ATOMIC_UINT32_INIT(0);
 
+static void get_destination (const ddsi_udp_conn_t uc, const ddsrt_msghdr_t *msghdr, struct sockaddr_storage *dst)
+{
+  *dst = uc->m_laddr;
+#if DDSI_UDP_PKTINFO
+  if (uc->m_pktinfo && msghdr->msg_control != NULL)
+  {
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR (msghdr); cmsg != NULL; cmsg = CMSG_NXTHDR ((ddsrt_msghdr_t *) msghdr, cmsg))
+    {
+      if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+      {
+        struct in_pktinfo pi;
+        memcpy (&pi, CMSG_DATA (cmsg), sizeof (pi));
+        ((struct sockaddr_in *) dst)->sin_addr = pi.ipi_addr;
+      }
+    }
+  }
+#else
+  (void) msghdr;
+#endif
+}
+
 static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, nn_locator_t *srcloc)
 {
+  ddsi_udp_conn_t uc = (ddsi_udp_conn_t) conn;
+#if DDSI_UDP_PKTINFO
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (sizeof (struct in_pktinfo))];
+  } ctrl;
+#endif
   dds_retcode_t rc;
   ssize_t ret = 0;
   ddsrt_msghdr_t msghdr;
@@ -76,9 +118,16 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, s
   msghdr.msg_control = NULL;
   msghdr.msg_controllen = 0;
 #endif
+#if DDSI_UDP_PKTINFO
+  if (uc->m_pktinfo && gv.pcap)
+  {
+    msghdr.msg_control = &ctrl;
+    msghdr.msg_controllen = sizeof (ctrl);
+  }
+#endif
 
   do {
-    rc = ddsrt_recvmsg(((ddsi_udp_conn_t) conn)->m_sock, &msghdr, 0, &ret);
+    rc = ddsrt_recvmsg(uc->m_sock, &msghdr, 0, &ret);
   } while (rc == DDS_RETCODE_INTERRUPTED);
 
   if (ret > 0)
@@ -99,11 +148,17 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, s
       ddsi_locator_to_string(addrbuf, sizeof(addrbuf), &tmp);
       DDS_WARNING("%s => %d truncated to %d\n", addrbuf, (int)ret, (int)len);
     }
+    else if (gv.pcap)
+    {
+      struct sockaddr_storage dst;
+      get_destination (uc, &msghdr, &dst);
+      write_pcap_received (gv.pcap, now (), &src, &dst, buf, (size_t) ret);
+    }
   }
   else if (rc != DDS_RETCODE_BAD_PARAMETER &&
            rc != DDS_RETCODE_NO_CONNECTION)
   {
-    DDS_ERROR("UDP recvmsg sock %d: ret %d retcode %"PRId32"\n", (int) ((ddsi_udp_conn_t) conn)->m_sock, (int) ret, rc);
+    DDS_ERROR("UDP recvmsg sock %d: ret %d retcode %"PRId32"\n", (int) uc->m_sock, (int) ret, rc);
     ret = -1;
   }
   return ret;
@@ -156,13 +211,9 @@ static ssize_t ddsi_udp_conn_write (ddsi_tran_conn_t conn, const nn_locator_t *d
   } while ((rc == DDS_RETCODE_INTERRUPTED) ||
            (rc == DDS_RETCODE_TRY_AGAIN) ||
            (rc == DDS_RETCODE_NOT_ALLOWED && retry-- > 0));
-  if (ret > 0 && gv.pcap_fp)
+  if (ret > 0 && gv.pcap)
   {
-    struct sockaddr_storage sa;
-    socklen_t alen = sizeof (sa);
-    if (ddsrt_getsockname (((ddsi_udp_conn_t) conn)->m_sock, (struct sockaddr *) &sa, &alen) != DDS_RETCODE_OK)
-      memset(&sa, 0, sizeof(sa));
-    write_pcap_sent (gv.pcap_fp, now (), &sa, &msg, (size_t) ret);
+    write_pcap_sent (gv.pcap, now (), &((ddsi_udp_conn_t) conn)->m_laddr, &msg, (size_t) ret);
   }
   else if (rc != DDS_RETCODE_OK &&
            rc != DDS_RETCODE_NOT_ALLOWED &&
@@ -211,20 +262,20 @@ static int ddsi_udp_conn_locator (ddsi_tran_base_t base, nn_locator_t *loc)
   return ret;
 }
 
-static unsigned short get_socket_port (ddsrt_socket_t socket)
+static unsigned short get_socket_port (ddsrt_socket_t socket, struct sockaddr_storage *addr)
 {
   dds_retcode_t ret;
-  struct sockaddr_storage addr;
-  socklen_t addrlen = sizeof (addr);
+  socklen_t addrlen = sizeof (*addr);
 
-  ret = ddsrt_getsockname (socket, (struct sockaddr *)&addr, &addrlen);
+  ret = ddsrt_getsockname (socket, (struct sockaddr *)addr, &addrlen);
   if (ret != DDS_RETCODE_OK)
   {
     DDS_ERROR("ddsi_udp_get_socket_port: getsockname returned %"PRId32"\n", ret);
+    memset (addr, 0, sizeof (*addr));
     return 0;
   }
 
-  return ddsrt_sockaddr_get_port((struct sockaddr *)&addr);
+  return ddsrt_sockaddr_get_port((struct sockaddr *)addr);
 }
 
 static ddsi_tran_conn_t ddsi_udp_create_conn
@@ -245,7 +296,8 @@ static ddsi_tran_conn_t ddsi_udp_create_conn
     &sock,
     (unsigned short) port,
     false,
-    mcast
+    mcast,
+    qos ? qos->m_reuseport : false
   );
 
   if (ret == 0)
@@ -261,7 +313,16 @@ static ddsi_tran_conn_t ddsi_udp_create_conn
 #endif
 
     ddsi_factory_conn_init (&ddsi_udp_factory_g, &uc->m_base);
-    uc->m_base.m_base.m_port = get_socket_port (sock);
+    uc->m_base.m_base.m_port = get_socket_port (sock, &uc->m_laddr);
+#if DDSI_UDP_PKTINFO
+    if (config.pcap_file && *config.pcap_file && ddsi_udp_factory_g.m_kind == NN_LOCATOR_KIND_UDPv4)
+    {
+      /* the bound address is usually the wildcard, the actual destination
+         (including multicast addresses) comes with each packet */
+      const int one = 1;
+      uc->m_pktinfo = (ddsrt_setsockopt (sock, IPPROTO_IP, IP_PKTINFO, &one, sizeof (one)) == DDS_RETCODE_OK);
+    }
+#endif
     uc->m_base.m_base.m_trantype = DDSI_TRAN_CONN;
     uc->m_base.m_base.m_multicast = mcast;
     uc->m_base.m_base.m_handle_fn = ddsi_udp_conn_handle;
@@ -304,6 +365,51 @@ static ddsi_tran_conn_t ddsi_udp_create_conn
   return uc ? &uc->m_base : NULL;
 }
 
+int ddsi_udp_conn_steer_by_guidprefix (ddsi_tran_conn_t conn, uint32_t nsocks)
+{
+#if defined SO_ATTACH_REUSEPORT_CBPF && defined BPF_MOD
+  /* The program is run with the packet data starting at the UDP payload.
+     Anything that can be an RTPS message is steered on a hash of the GUID
+     prefix in the header, so that all traffic from a remote participant is
+     handled by the same receive thread.  Shorter packets are the triggers
+     sent by trigger_recv_threads, their first byte is the index of the
+     socket to wake up.  The index of a socket is the order in which it was
+     bound to the port. */
+  struct sock_filter code[] = {
+    BPF_STMT (BPF_LD | BPF_W | BPF_LEN, 0),
+    BPF_JUMP (BPF_JMP | BPF_JGE | BPF_K, (uint32_t) RTPS_MESSAGE_HEADER_SIZE, 2, 0),
+    BPF_STMT (BPF_LD | BPF_B | BPF_ABS, 0),
+    BPF_JUMP (BPF_JMP | BPF_JA, 9, 0, 0),
+    BPF_STMT (BPF_LD | BPF_W | BPF_ABS, 8),
+    BPF_STMT (BPF_MISC | BPF_TAX, 0),
+    BPF_STMT (BPF_LD | BPF_W | BPF_ABS, 12),
+    BPF_STMT (BPF_ALU | BPF_XOR | BPF_X, 0),
+    BPF_STMT (BPF_MISC | BPF_TAX, 0),
+    BPF_STMT (BPF_LD | BPF_W | BPF_ABS, 16),
+    BPF_STMT (BPF_ALU | BPF_XOR | BPF_X, 0),
+    BPF_STMT (BPF_ALU | BPF_MUL | BPF_K, 0x9e3779b1),
+    BPF_STMT (BPF_ALU | BPF_RSH | BPF_K, 16),
+    BPF_STMT (BPF_ALU | BPF_MOD | BPF_K, nsocks),
+    BPF_STMT (BPF_RET | BPF_A, 0)
+  };
+  struct sock_fprog prog;
+  dds_retcode_t rc;
+  prog.len = (unsigned short) (sizeof (code) / sizeof (code[0]));
+  prog.filter = code;
+  if ((rc = ddsrt_setsockopt (((ddsi_udp_conn_t) conn)->m_sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof (prog))) != DDS_RETCODE_OK)
+  {
+    DDS_WARNING("ddsi_udp_conn_steer_by_guidprefix: attaching steering program failed with retcode %"PRId32"\n", rc);
+    return -1;
+  }
+  return 0;
+#else
+  (void) conn;
+  (void) nsocks;
+  DDS_WARNING("ddsi_udp_conn_steer_by_guidprefix: not supported on this platform\n");
+  return -1;
+#endif
+}
+
 static int joinleave_asm_mcgroup (ddsrt_socket_t socket, int join, const nn_locator_t *mcloc, const struct nn_interface *interf)
 {
   dds_retcode_t rc;
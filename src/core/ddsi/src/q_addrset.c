@@ -22,6 +22,8 @@
 #include "dds/ddsi/q_misc.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_addrset.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_gc.h"
 #include "dds/ddsi/q_globals.h" /* gv.mattr */
 
 /* So what does one do with const & mutexes? I need to take lock in a
@@ -198,6 +200,65 @@ static int compare_locators_vwrap (const void *va, const void *vb)
   return compare_locators (va, vb);
 }
 
+static void gc_addrset_snapshot (struct gcreq *gcreq)
+{
+  ddsrt_free (gcreq->arg);
+  gcreq_free (gcreq);
+}
+
+static void addrset_drop_snapshot (struct addrset *as)
+{
+  /* Called with AS locked whenever its contents change: threads that are
+     awake may still be using the old snapshot, so it can only be freed
+     once they have all made progress.  Without a garbage collector there
+     can't be any concurrent readers. */
+  struct addrset_snapshot *s;
+  if ((s = ddsrt_atomic_ldvoidp (&as->snapshot)) != NULL)
+  {
+    ddsrt_atomic_stvoidp (&as->snapshot, NULL);
+    if (gv.gcreq_queue == NULL)
+      ddsrt_free (s);
+    else
+    {
+      struct gcreq *gcreq = gcreq_new (gv.gcreq_queue, gc_addrset_snapshot);
+      gcreq->arg = s;
+      gcreq_enqueue (gcreq);
+    }
+  }
+}
+
+static const struct addrset_snapshot *addrset_snapshot (const struct addrset *as)
+{
+  /* Only valid for as long as the calling thread stays awake */
+  struct addrset_snapshot *s;
+  assert (thread_is_awake ());
+  if ((s = ddsrt_atomic_ldvoidp (&as->snapshot)) != NULL)
+    ddsrt_atomic_fence_acq ();
+  else
+  {
+    LOCK (as);
+    if ((s = ddsrt_atomic_ldvoidp (&as->snapshot)) == NULL)
+    {
+      const size_t nmc = ddsrt_avl_ccount (&as->mcaddrs);
+      const size_t n = nmc + ddsrt_avl_ccount (&as->ucaddrs);
+      struct addrset_node *an;
+      ddsrt_avl_citer_t it;
+      size_t i = 0;
+      s = ddsrt_malloc (offsetof (struct addrset_snapshot, locs) + (n > 0 ? n : 1) * sizeof (s->locs[0]));
+      for (an = ddsrt_avl_citer_first (&addrset_treedef, &as->mcaddrs, &it); an; an = ddsrt_avl_citer_next (&it))
+        s->locs[i++] = an->loc;
+      for (an = ddsrt_avl_citer_first (&addrset_treedef, &as->ucaddrs, &it); an; an = ddsrt_avl_citer_next (&it))
+        s->locs[i++] = an->loc;
+      assert (i == n);
+      s->n = (uint32_t) n;
+      ddsrt_atomic_fence_rel ();
+      ddsrt_atomic_stvoidp (&((struct addrset *) as)->snapshot, s);
+    }
+    UNLOCK (as);
+  }
+  return s;
+}
+
 struct addrset *new_addrset (void)
 {
   struct addrset *as = ddsrt_malloc (sizeof (*as));
@@ -205,6 +266,7 @@ struct addrset *new_addrset (void)
   ddsrt_mutex_init (&as->lock);
   ddsrt_avl_cinit (&addrset_treedef, &as->ucaddrs);
   ddsrt_avl_cinit (&addrset_treedef, &as->mcaddrs);
+  ddsrt_atomic_stvoidp (&as->snapshot, NULL);
   return as;
 }
 
@@ -223,6 +285,8 @@ void unref_addrset (struct addrset *as)
   {
     ddsrt_avl_cfree (&addrset_treedef, &as->ucaddrs, ddsrt_free);
     ddsrt_avl_cfree (&addrset_treedef, &as->mcaddrs, ddsrt_free);
+    /* no references left, so no thread can be using the snapshot */
+    ddsrt_free (ddsrt_atomic_ldvoidp (&as->snapshot));
     ddsrt_mutex_destroy (&as->lock);
     ddsrt_free (as);
   }
@@ -303,6 +367,7 @@ int addrset_purge (struct addrset *as)
   LOCK (as);
   ddsrt_avl_cfree (&addrset_treedef, &as->ucaddrs, ddsrt_free);
   ddsrt_avl_cfree (&addrset_treedef, &as->mcaddrs, ddsrt_free);
+  addrset_drop_snapshot (as);
   UNLOCK (as);
   return 0;
 }
@@ -319,6 +384,7 @@ void add_to_addrset (struct addrset *as, const nn_locator_t *loc)
       struct addrset_node *n = ddsrt_malloc (sizeof (*n));
       n->loc = *loc;
       ddsrt_avl_cinsert_ipath (&addrset_treedef, tree, n, &path);
+      addrset_drop_snapshot (as);
     }
     UNLOCK (as);
   }
@@ -334,6 +400,7 @@ void remove_from_addrset (struct addrset *as, const nn_locator_t *loc)
   {
     ddsrt_avl_cdelete_dpath (&addrset_treedef, tree, n, &path);
     ddsrt_free (n);
+    addrset_drop_snapshot (as);
   }
   UNLOCK (as);
 }
@@ -398,6 +465,7 @@ void addrset_purge_ssm (struct addrset *as)
     {
       ddsrt_avl_cdelete (&addrset_treedef, &as->mcaddrs, n1);
       ddsrt_free (n1);
+      addrset_drop_snapshot (as);
     }
   }
   UNLOCK (as);
@@ -522,15 +590,26 @@ static void addrset_forall_helper (void *vnode, void *varg)
 
 size_t addrset_forall_count (struct addrset *as, addrset_forall_fun_t f, void *arg)
 {
-  struct addrset_forall_helper_arg arg1;
   size_t count;
-  arg1.f = f;
-  arg1.arg = arg;
-  LOCK (as);
-  ddsrt_avl_cwalk (&addrset_treedef, &as->mcaddrs, addrset_forall_helper, &arg1);
-  ddsrt_avl_cwalk (&addrset_treedef, &as->ucaddrs, addrset_forall_helper, &arg1);
-  count = ddsrt_avl_ccount (&as->ucaddrs) + ddsrt_avl_ccount (&as->mcaddrs);
-  UNLOCK (as);
+  if (thread_is_awake ())
+  {
+    const struct addrset_snapshot *s = addrset_snapshot (as);
+    uint32_t i;
+    for (i = 0; i < s->n; i++)
+      f (&s->locs[i], arg);
+    count = s->n;
+  }
+  else
+  {
+    struct addrset_forall_helper_arg arg1;
+    arg1.f = f;
+    arg1.arg = arg;
+    LOCK (as);
+    ddsrt_avl_cwalk (&addrset_treedef, &as->mcaddrs, addrset_forall_helper, &arg1);
+    ddsrt_avl_cwalk (&addrset_treedef, &as->ucaddrs, addrset_forall_helper, &arg1);
+    count = ddsrt_avl_ccount (&as->ucaddrs) + ddsrt_avl_ccount (&as->mcaddrs);
+    UNLOCK (as);
+  }
   return count;
 }
 
@@ -546,9 +625,22 @@ int addrset_forone (struct addrset *as, addrset_forone_fun_t f, void *arg)
   ddsrt_avl_ctree_t *trees[2];
   ddsrt_avl_citer_t iter;
 
+  if (thread_is_awake ())
+  {
+    const struct addrset_snapshot *s = addrset_snapshot (as);
+    uint32_t j;
+    for (j = 0; j < s->n; j++)
+    {
+      if ((f) (&s->locs[j], arg) > 0)
+        return 0;
+    }
+    return -1;
+  }
+
   trees[0] = &as->mcaddrs;
   trees[1] = &as->ucaddrs;
 
+  LOCK (as);
   for (i = 0; i < 2u; i++)
   {
     n = (addrset_node_t) ddsrt_avl_citer_first (&addrset_treedef, trees[i], &iter);
@@ -556,11 +648,13 @@ int addrset_forone (struct addrset *as, addrset_forone_fun_t f, void *arg)
     {
       if ((f) (&n->loc, arg) > 0)
       {
+        UNLOCK (as);
         return 0;
       }
       n = (addrset_node_t) ddsrt_avl_citer_next (&iter);
     }
   }
+  UNLOCK (as);
   return -1;
 }
 
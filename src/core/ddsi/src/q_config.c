@@ -48,7 +48,7 @@ typedef int(*update_fun_t) (struct cfgst *cfgst, void *parent, struct cfgelem co
 typedef void(*free_fun_t) (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem);
 typedef void(*print_fun_t) (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default);
 
-#ifdef DDSI_INCLUDE_SECURITY
+#ifdef DDSI_INCLUDE_ENCRYPTION
 struct q_security_plugins q_security_plugin = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 #endif
 
@@ -148,6 +148,9 @@ DUPF(uint32);
 #endif
 DU(natint);
 DU(natint_255);
+DU(recv_threads_uc);
+DU(builtins_dqueues);
+DU(fec_group_size);
 DUPF(participantIndex);
 DU(port);
 DU(dyn_port);
@@ -160,16 +163,20 @@ DU(duration_100ms_1hr);
 PF(duration);
 DUPF(standards_conformance);
 DUPF(besmode);
+DUPF(guid_prefix);
+DUPF(entityid);
+DUPF(reliability_kind);
+DUPF(durability_kind);
 DUPF(retransmit_merging);
 DUPF(sched_class);
 DUPF(maybe_memsize);
 DUPF(maybe_int32);
+DUPF(cpuset);
 #ifdef DDSI_INCLUDE_ENCRYPTION
 DUPF(cipher);
+PF(key);
 #endif
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
 DUPF(bandwidth);
-#endif
 DUPF(domainId);
 DUPF(transport_selector);
 DUPF(many_sockets_mode);
@@ -184,6 +191,7 @@ DUPF(min_tls_version);
 #define DF(fname) static void fname (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem)
 DF(ff_free);
 DF(ff_networkAddresses);
+DF(ff_cpuset);
 #undef DF
 
 #define DI(fname) static int fname (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem)
@@ -199,6 +207,8 @@ DI(if_ignored_partition);
 DI(if_partition_mapping);
 #endif
 DI(if_peer);
+DI(if_static_participant);
+DI(if_static_endpoint);
 DI(if_thread_properties);
 #undef DI
 
@@ -277,8 +287,11 @@ static const struct cfgelem securityprofile_cfgattrs[] = {
 <li><i>aes192</i>: AES with a 192-bit key;</li>\n\
 <li><i>aes256</i>: AES with a 256-bit key;</li>\n\
 <li><i>blowfish</i>: the Blowfish cipher with a 128 bit key;</li>\n\
+<li><i>aes128-gcm</i>: AES-GCM with a 128-bit key;</li>\n\
+<li><i>aes256-gcm</i>: AES-GCM with a 256-bit key;</li>\n\
+<li><i>chacha20-poly1305</i>: ChaCha20-Poly1305 with a 256-bit key;</li>\n\
 <li><i>null</i>: no encryption;</li></ul>\n\
-<p>SHA1 is used on conjunction with all ciphers except \"null\" to ensure data integrity.</p>") },
+<p>SHA1 is used on conjunction with aes128, aes192, aes256 and blowfish to ensure data integrity. The authenticated ciphers aes128-gcm, aes256-gcm and chacha20-poly1305 provide integrity themselves, encrypt in a single pass and use hardware acceleration where available; they are considerably faster.</p>") },
   { ATTR("CipherKey"), 1, "", RELOFF(config_securityprofile_listelem, key), 0, uf_string, ff_free, pf_key,
     BLURB("<p>The CipherKey attribute is used to define the secret key required by the cipher selected using the Cipher attribute. The value can be a URI referencing an external file containing the secret key, or the secret key can be defined in-place as a string value.</p>\n\
 <p>The key must be specified as a hexadecimal string with each character representing 4 bits of the key. E.g., 1ABC represents the 16-bit key 0001 1010 1011 1100. The key should not follow a well-known pattern and must exactly match the key length of the selected cipher.</p>\n\
@@ -414,6 +427,8 @@ static const struct cfgelem thread_properties_cfgelems[] = {
     BLURB("<p>This element configures the scheduling properties of the thread.</p>") },
   { LEAF("StackSize"), 1, "default", RELOFF(config_thread_properties_listelem, stack_size), 0, uf_maybe_memsize, 0, pf_maybe_memsize,
     BLURB("<p>This element configures the stack size for this thread. The default value <i>default</i> leaves the stack size at the operating system default.</p>") },
+  { LEAF("CpuSet"), 1, "any", RELOFF(config_thread_properties_listelem, cpuset), 0, uf_cpuset, ff_cpuset, pf_cpuset,
+    BLURB("<p>This element restricts the thread to the specified set of CPUs, as a comma-separated list of CPU numbers and ranges of CPU numbers (e.g., <i>0,2-3</i>). The default value <i>any</i> leaves the thread free to run on any CPU the process is allowed to use. This is currently only supported on Linux and Windows.</p>") },
   END_MARKER
 };
 
@@ -504,6 +519,8 @@ static const struct cfgelem liveliness_monitoring_attrs[] = {
 static const struct cfgelem multiple_recv_threads_attrs[] = {
   { ATTR("maxretries"), 1, "4294967295", ABSOFF(recv_thread_stop_maxretries), 0, uf_uint, 0, pf_uint,
     BLURB("<p>Receive threads dedicated to a single socket can only be triggered for termination by sending a packet. Reception of any packet will do, so termination failure due to packet loss is exceedingly unlikely, but to eliminate all risks, it will retry as many times as specified by this attribute before aborting.</p>") },
+  { ATTR("unicastthreads"), 1, "1", ABSOFF(multiple_recv_threads_uc), 0, uf_recv_threads_uc, 0, pf_int,
+    BLURB("<p>This attribute controls the number of threads receiving unicast data when ManySocketsMode is set to single. Each thread has its own socket bound to the data unicast port with SO_REUSEPORT and its own receive buffer pool. A classic BPF program attached to the sockets selects the socket based on the GUID prefix in the RTPS header, so that all traffic originating in a single remote participant is handled by the same thread. Values greater than 1 are only supported for UDP on platforms that provide SO_REUSEPORT with BPF steering (currently Linux) and otherwise fall back to a single thread.</p>") },
   END_MARKER
 };
 
@@ -512,6 +529,8 @@ static const struct cfgelem unsupp_cfgelems[] = {
   { MOVED("FragmentSize", "CycloneDDS/General/FragmentSize") },
   { LEAF("DeliveryQueueMaxSamples"), 1, "256", ABSOFF(delivery_queue_maxsamples), 0, uf_uint, 0, pf_uint,
     BLURB("<p>This element controls the Maximum size of a delivery queue, expressed in samples. Once a delivery queue is full, incoming samples destined for that queue are dropped until space becomes available again.</p>") },
+  { LEAF("BuiltinDeliveryQueues"), 1, "4", ABSOFF(builtins_dqueues), 0, uf_builtins_dqueues, 0, pf_int,
+    BLURB("<p>This element sets the number of delivery queues, each with its own thread, that process discovery data. All discovery data from a single remote participant is processed in order by the same queue, data from different participants is processed in parallel. The first queue is handled by the <i>dq.builtins</i> thread, the others by <i>dq.builtins.N</i>.</p>") },
   { LEAF("PrimaryReorderMaxSamples"), 1, "64", ABSOFF(primary_reorder_maxsamples), 0, uf_uint, 0, pf_uint,
     BLURB("<p>This element sets the maximum size in samples of a primary re-order administration. Each proxy writer has one primary re-order administration to buffer the packet flow in case some packets arrive out of order. Old samples are forwarded to secondary re-order administrations associated with readers in need of historical data.</p>") },
   { LEAF("SecondaryReorderMaxSamples"), 1, "16", ABSOFF(secondary_reorder_maxsamples), 0, uf_uint, 0, pf_uint,
@@ -520,6 +539,12 @@ static const struct cfgelem unsupp_cfgelems[] = {
     BLURB("<p>This element sets the maximum number of samples that can be defragmented simultaneously for a best-effort writers.</p>") },
   { LEAF("DefragReliableMaxSamples"), 1, "16", ABSOFF(defrag_reliable_maxsamples), 0, uf_uint, 0, pf_uint,
     BLURB("<p>This element sets the maximum number of samples that can be defragmented simultaneously for a reliable writer. This has to be large enough to handle retransmissions of historical data in addition to new samples.</p>") },
+  { LEAF("CoherentSetMaxSamples"), 1, "4096", ABSOFF(coherent_set_maxsamples), 0, uf_uint, 0, pf_uint,
+    BLURB("<p>This element sets the maximum number of samples of a coherent set that are held back for readers with coherent access until the set is complete. This applies to each remote writer and to each local writer with local readers requesting coherent access. A set that grows beyond this limit is discarded: the samples collected so far are released, the remainder of the set is ignored and none of it is delivered to these readers. Readers without coherent access are not affected. The value 0 means unlimited.</p>") },
+  { LEAF("DefragContiguousThreshold"), 1, "64 kB", ABSOFF(defrag_contig_threshold), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element sets the minimum size of an application sample for it to be reassembled directly into its final, contiguous representation as the fragments arrive, instead of retaining all fragments until the sample is complete and then copying them. This limits the memory held in receive buffers by large samples. The value 0 disables it.</p>") },
+  { LEAF("DefragContiguousMaxSize"), 1, "1 MB", ABSOFF(defrag_contig_maxsize), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element sets the maximum size of an application sample for it to be reassembled directly into its final representation (see Internal/DefragContiguousThreshold). The memory for such a sample is allocated when its first fragment arrives, based on the sample size claimed by the sender, and so this limits the memory a remote writer can cause to be allocated. Larger samples are reassembled in the receive buffers.</p>") },
   { LEAF("BuiltinEndpointSet"), 1, "writers", ABSOFF(besmode), 0, uf_besmode, 0, pf_besmode,
     BLURB("<p>This element controls which participants will have which built-in endpoints for the discovery and liveliness protocols. Valid values are:</p>\n\
 <ul><li><i>full</i>: all participants have all endpoints;</li>\n\
@@ -531,6 +556,10 @@ static const struct cfgelem unsupp_cfgelems[] = {
 <p>Should it be necessary to hide DDSI2E's shared discovery behaviour, set this to <i>true</i> and Internal/BuiltinEndpointSet to <i>full</i>.</p>") },
   { LEAF("MeasureHbToAckLatency"), 1, "false", ABSOFF(meas_hb_to_ack_latency), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element enables heartbeat-to-ack latency among DDSI2E services by prepending timestamps to Heartbeat and AckNack messages and calculating round trip times. This is non-standard behaviour. The measured latencies are quite noisy and are currently not used anywhere.</p>") },
+  { LEAF("RttAdaptiveTiming"), 1, "false", ABSOFF(rtt_adaptive_timing), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element enables adapting the reliability protocol timing to the round-trip time measured for each remote reader. Writers prepend a timestamp to heartbeats and readers echo it in their AckNacks (as with Internal/MeasureHbToAckLatency), from which the writer derives a smoothed round-trip time and a retransmit timeout for each reader. The heartbeat interval then follows the slowest reader's retransmit timeout, bounded by Internal/HeartbeatInterval[@minsched] and Internal/HeartbeatInterval[@max], rather than the fixed Internal/HeartbeatInterval; and retransmit requests for samples that were retransmitted less than a round-trip time ago are ignored, as they crossed the retransmit. This is non-standard behaviour and must be enabled on both sides.</p>") },
+  { LEAF("FecGroupSize"), 1, "0", ABSOFF(fec_group_size), 0, uf_fec_group_size, 0, pf_int,
+    BLURB("<p>This element sets the number of packets sent to a set of addresses (typically a multicast group) that are covered by a single forward error correction (FEC) parity packet. The parity packet is the XOR of the packets in the group, which allows a receiver to reconstruct any single lost packet of the group without a round trip to the writer. Packets larger than 65024 bytes and packets sent to a single address are not covered. A value of 0 disables the generation of parity packets; receiving and using them is always enabled. This is non-standard behaviour, the maximum is 32.</p>") },
   { LEAF("UnicastResponseToSPDPMessages"), 1, "true", ABSOFF(unicast_response_to_spdp_messages), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element controls whether the response to a newly discovered participant is sent as a unicasted SPDP packet, instead of rescheduling the periodic multicasted one. There is no known benefit to setting this to <i>false</i>.</p>") },
   { LEAF("SynchronousDeliveryPriorityThreshold"), 1, "0", ABSOFF(synchronous_delivery_priority_threshold), 0, uf_int, 0, pf_int,
@@ -550,6 +579,10 @@ static const struct cfgelem unsupp_cfgelems[] = {
   { LEAF("RetransmitMergingPeriod"), 1, "5 ms", ABSOFF(retransmit_merging_period), 0, uf_duration_us_1s, 0, pf_duration,
     BLURB("<p>This setting determines the size of the time window in which a NACK of some sample is ignored because a retransmit of that sample has been multicasted too recently. This setting has no effect on unicasted retransmits.</p>\n\
 <p>See also Internal/RetransmitMerging.</p>") },
+  { LEAF("RetransmitMultipleFragments"), 1, "true", ABSOFF(retransmit_multiple_fragments), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element controls whether a retransmit of consecutive fragments of a large sample combines as many fragments in a single DATAFRAG submessage as fit in General/MaxMessageSize, instead of sending each fragment in a submessage of its own. Combining them cuts down the number of messages queued for retransmission and the per-message overhead in both writer and reader.</p>") },
+  { LEAF("RetransmitBandwidthLimit"), 1, "inf", ABSOFF(retransmit_bandwidth_limit), 0, uf_bandwidth, 0, pf_bandwidth,
+    BLURB("<p>This element specifies the maximum rate at which retransmits are sent. Retransmits exceeding the rate remain queued (within the bounds set by Internal/MaxQueuedRexmitBytes and Internal/MaxQueuedRexmitMessages) while heartbeats, acknowledgements and all other messages continue to go out unhindered, which also gives more opportunity for merging retransmit requests from different readers. The default value \"inf\" means no limitation is imposed.</p>") },
   { LEAF_W_ATTRS("HeartbeatInterval", heartbeat_interval_attrs), 1, "100 ms", ABSOFF(const_hb_intv_sched), 0, uf_duration_inf, 0, pf_duration,
     BLURB("<p>This elemnents allows configuring the base interval for sending writer heartbeats and the bounds within it can vary.</p>") },
   { LEAF("MaxQueuedRexmitBytes"), 1, "50 kB", ABSOFF(max_queued_rexmit_bytes), 0, uf_memsize, 0, pf_memsize,
@@ -603,6 +636,8 @@ static const struct cfgelem unsupp_cfgelems[] = {
     BLURB("<p>This element controls whether retransmits are prioritized over new data, speeding up recovery.</p>") },
   { LEAF("UseMulticastIfMreqn"), 1, "0", ABSOFF(use_multicast_if_mreqn), 0, uf_int, 0, pf_int,
     BLURB("<p>Do not use.</p>") },
+  { LEAF("ListenerThreads"), 1, "0", ABSOFF(listener_threads), 0, uf_natint, 0, pf_int,
+    BLURB("<p>This element controls how listeners are invoked. If set to 0 (the default), they are invoked synchronously on the thread that delivers the data or causes the status change, which means a slow listener delays all processing on that thread. If set to a positive number, invocations are instead queued for a pool of at most this many threads. Each entity then has at most one invocation in progress or queued, invocations for an entity occur in the order the events occurred, and repeated events of the same kind that occur before the listener is invoked are merged into one invocation.</p>") },
   { LEAF("SendAsync"), 1, "false", ABSOFF(xpack_send_async), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element controls whether the actual sending of packets occurs on the same thread that prepares them, or is done asynchronously by another thread.</p>") },
   { LEAF_W_ATTRS("RediscoveryBlacklistDuration", rediscovery_blacklist_duration_attrs), 1, "10s", ABSOFF(prune_deleted_ppant.delay), 0, uf_duration_inf, 0, pf_duration,
@@ -719,6 +754,52 @@ static const struct cfgelem discovery_peers_cfgelems[] = {
   END_MARKER
 };
 
+static const struct cfgelem discovery_static_endpoint_cfgattrs[] = {
+  { ATTR("EntityId"), 1, NULL, RELOFF(config_static_endpoint_listelem, entityid), 0, uf_entityid, 0, pf_entityid,
+    BLURB("<p>This attribute specifies the DDSI entity id of the endpoint, in decimal or (prefixed with 0x) hexadecimal notation. Locally created readers and writers are assigned entity ids in order of creation: the <i>n</i>th reader or writer created in a participant gets (<i>n</i>&lt;&lt;8)+7 for a reader and (<i>n</i>&lt;&lt;8)+2 for a writer, starting at <i>n</i>=1.</p>") },
+  { ATTR("Topic"), 1, NULL, RELOFF(config_static_endpoint_listelem, topic), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This attribute specifies the name of the topic of the endpoint.</p>") },
+  { ATTR("Type"), 1, NULL, RELOFF(config_static_endpoint_listelem, type), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This attribute specifies the name of the data type of the endpoint.</p>") },
+  { ATTR("Partition"), 1, "", RELOFF(config_static_endpoint_listelem, partition), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This attribute specifies a comma-separated list of partitions of the endpoint, the default is the default partition.</p>") },
+  { ATTR("Reliability"), 1, "reliable", RELOFF(config_static_endpoint_listelem, reliability), 0, uf_reliability_kind, 0, pf_reliability_kind,
+    BLURB("<p>This attribute specifies the reliability of the endpoint: <i>best-effort</i> or <i>reliable</i>.</p>") },
+  { ATTR("Durability"), 1, "volatile", RELOFF(config_static_endpoint_listelem, durability), 0, uf_durability_kind, 0, pf_durability_kind,
+    BLURB("<p>This attribute specifies the durability of the endpoint: <i>volatile</i>, <i>transient-local</i>, <i>transient</i> or <i>persistent</i>.</p>") },
+  END_MARKER
+};
+
+static const struct cfgelem discovery_static_participant_cfgelems[] = {
+  { MGROUP("Writer", NULL, discovery_static_endpoint_cfgattrs), 0, NULL, RELOFF(config_static_participant_listelem, writers), if_static_endpoint, 0, 0, 0,
+    BLURB("<p>This element specifies a writer of the remote participant. All other QoS settings are the defaults.</p>") },
+  { MGROUP("Reader", NULL, discovery_static_endpoint_cfgattrs), 0, NULL, RELOFF(config_static_participant_listelem, readers), if_static_endpoint, 0, 0, 0,
+    BLURB("<p>This element specifies a reader of the remote participant. All other QoS settings are the defaults.</p>") },
+  END_MARKER
+};
+
+static const struct cfgelem discovery_static_participant_cfgattrs[] = {
+  { ATTR("GuidPrefix"), 1, NULL, RELOFF(config_static_participant_listelem, prefix), 0, uf_guid_prefix, 0, pf_guid_prefix,
+    BLURB("<p>This attribute specifies the GUID prefix of the remote participant, as three colon-separated hexadecimal numbers (the form in which GUIDs appear in the trace, see also Discovery/Static/LocalGuidPrefix).</p>") },
+  { ATTR("Address"), 1, NULL, RELOFF(config_static_participant_listelem, address), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This attribute specifies a comma-separated list of unicast addresses of the remote participant in the form ADDRESS:PORT, used for application data. Port numbers are only predictable if the remote side uses a fixed Discovery/ParticipantIndex.</p>") },
+  { ATTR("MetaAddress"), 1, "", RELOFF(config_static_participant_listelem, meta_address), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This attribute specifies a comma-separated list of unicast addresses of the remote participant in the form ADDRESS:PORT, used for the (liveliness) protocol messages. It defaults to the Address attribute.</p>") },
+  { ATTR("LeaseDuration"), 1, "inf", RELOFF(config_static_participant_listelem, lease_duration), 0, uf_duration_inf, 0, pf_duration,
+    BLURB("<p>This attribute specifies the lease duration of the remote participant. When finite, the participant is removed (and not rediscovered) if its lease is not renewed by data or liveliness messages for this long.</p>") },
+  END_MARKER
+};
+
+static const struct cfgelem discovery_static_cfgelems[] = {
+  { LEAF("Exclusive"), 1, "false", ABSOFF(static_discovery_exclusive), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element specifies whether the statically configured participants are the only ones. If true, no participant and endpoint discovery data is sent and any received is ignored.</p>") },
+  { LEAF("LocalGuidPrefix"), 1, "", ABSOFF(static_local_prefix), 0, uf_guid_prefix, 0, pf_guid_prefix,
+    BLURB("<p>This element specifies the GUID prefix of the first local participant, as three colon-separated hexadecimal numbers; the last number is incremented for each subsequent participant. The default is to generate a unique prefix. A fixed prefix is needed for other nodes to configure this one statically.</p>") },
+  { MGROUP("Participant", discovery_static_participant_cfgelems, discovery_static_participant_cfgattrs), 0, NULL, ABSOFF(static_participants), if_static_participant, 0, 0, 0,
+    BLURB("<p>This element specifies a remote participant together with its readers and writers. Statically configured participants and endpoints are created at startup and matched immediately, without waiting for discovery.</p>") },
+  END_MARKER
+};
+
 static const struct cfgelem discovery_cfgelems[] = {
   { LEAF("DSGracePeriod"), 1, "30 s", ABSOFF(ds_grace_period), 0, uf_duration_inf, 0, pf_duration,
     BLURB("<p>This setting controls for how long endpoints discovered via a Cloud discovery service will survive after the discovery service disappeared, allowing reconnect without loss of data when the discovery service restarts (or another instance takes over).</p>") },
@@ -742,6 +823,8 @@ static const struct cfgelem discovery_cfgelems[] = {
     BLURB("<p>Do not use.</p>") },
   { GROUP("Ports", discovery_ports_cfgelems),
     BLURB("<p>The Ports element allows specifying various parameters related to the port numbers used for discovery. These all have default values specified by the DDSI 2.1 specification and rarely need to be changed.</p>") },
+  { GROUP("Static", discovery_static_cfgelems),
+    BLURB("<p>The Static element allows specifying remote participants and their endpoints in the configuration, so that they need not be discovered.</p>") },
   END_MARKER
 };
 
@@ -782,6 +865,12 @@ static const struct cfgelem tracing_cfgelems[] = {
     BLURB("<p>This option specifies whether the output is to be appended to an existing log file. The default is to create a new log file each time, which is generally the best option if a detailed log is generated.</p>") },
   { LEAF("PacketCaptureFile"), 1, "", ABSOFF(pcap_file), 0, uf_string, ff_free, pf_string,
     BLURB("<p>This option specifies the file to which received and sent packets will be logged in the \"pcap\" format suitable for analysis using common networking tools, such as WireShark. IP and UDP headers are ficitious, in particular the destination address of received packets. The TTL may be used to distinguish between sent and received packets: it is 255 for sent packets and 128 for received ones. Currently IPv4 only.</p>") },
+  { LEAF("PacketCaptureSnapLength"), 1, "65535 B", ABSOFF(pcap_snaplen), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This option specifies the maximum number of bytes of each packet, including the IP and UDP headers, that is written to the packet capture file. Longer packets are truncated.</p>") },
+  { LEAF("PacketCaptureRingSize"), 1, "1 MiB", ABSOFF(pcap_ringsize), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This option specifies the size of the buffer in which each thread queues captured packets for a background thread that writes them to the packet capture file. Packets that do not fit are dropped and the number of dropped packets is reported as a warning.</p>") },
+  { LEAF("PacketCaptureFileSize"), 1, "0 B", ABSOFF(pcap_filesize), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This option specifies the size at which the packet capture file is rotated: the file is renamed by appending a sequence number and a new file is started. 0 disables rotation.</p>") },
   END_MARKER
 };
 
@@ -878,7 +967,6 @@ static const struct unit unittab_memsize[] = {
   { NULL, 0 }
 };
 
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
 static const struct unit unittab_bandwidth_bps[] = {
   { "b/s", 1 },{ "bps", 1 },
   { "Kib/s", 1024 },{ "Kibps", 1024 },
@@ -907,7 +995,6 @@ static const struct unit unittab_bandwidth_Bps[] = {
   { "GB/s", 1000000000 },{ "GBps", 1000000000 },
   { NULL, 0 }
 };
-#endif
 
 static void cfgst_push(struct cfgst *cfgst, int isattr, const struct cfgelem *elem, void *parent)
 {
@@ -1232,6 +1319,29 @@ static int if_peer(struct cfgst *cfgst, void *parent, struct cfgelem const * con
   return 0;
 }
 
+static int if_static_participant(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem)
+{
+  struct config_static_participant_listelem *new = if_common(cfgst, parent, cfgelem, sizeof(*new));
+  if ( new == NULL )
+    return -1;
+  new->address = NULL;
+  new->meta_address = NULL;
+  new->writers = NULL;
+  new->readers = NULL;
+  return 0;
+}
+
+static int if_static_endpoint(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem)
+{
+  struct config_static_endpoint_listelem *new = if_common(cfgst, parent, cfgelem, sizeof(*new));
+  if ( new == NULL )
+    return -1;
+  new->topic = NULL;
+  new->type = NULL;
+  new->partition = NULL;
+  return 0;
+}
+
 static void ff_free(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem)
 {
   void **elem = cfg_address(cfgst, parent, cfgelem);
@@ -1357,6 +1467,109 @@ static void pf_besmode(struct cfgst *cfgst, void *parent, struct cfgelem const *
   cfg_log(cfgst, "%s%s", str, is_default ? " [def]" : "");
 }
 
+static int uf_guid_prefix(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
+{
+  nn_guid_prefix_t *elem = cfg_address(cfgst, parent, cfgelem);
+  unsigned u0, u1, u2;
+  int pos;
+  if ( *value == 0 ) {
+    memset(elem, 0, sizeof(*elem));
+    return 1;
+  }
+  if ( sscanf(value, "%x:%x:%x%n", &u0, &u1, &u2, &pos) != 3 || value[pos] != 0 )
+    return cfg_error(cfgst, "'%s': invalid GUID prefix", value);
+  elem->u[0] = u0;
+  elem->u[1] = u1;
+  elem->u[2] = u2;
+  return 1;
+}
+
+static void pf_guid_prefix(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
+{
+  nn_guid_prefix_t *p = cfg_address(cfgst, parent, cfgelem);
+  if ( p->u[0] == 0 && p->u[1] == 0 && p->u[2] == 0 )
+    cfg_log(cfgst, "%s", is_default ? " [def]" : "");
+  else
+    cfg_log(cfgst, "%x:%x:%x%s", p->u[0], p->u[1], p->u[2], is_default ? " [def]" : "");
+}
+
+static int uf_entityid(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
+{
+  uint32_t *elem = cfg_address(cfgst, parent, cfgelem);
+  char *endptr;
+  unsigned long v = strtoul(value, &endptr, 0);
+  if ( *value == 0 || *endptr != 0 )
+    return cfg_error(cfgst, "%s: not an integer", value);
+  if ( v == 0 || v != (uint32_t) v )
+    return cfg_error(cfgst, "%s: value out of range", value);
+  *elem = (uint32_t) v;
+  return 1;
+}
+
+static void pf_entityid(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
+{
+  uint32_t *p = cfg_address(cfgst, parent, cfgelem);
+  cfg_log(cfgst, "0x%x%s", *p, is_default ? " [def]" : "");
+}
+
+static int uf_reliability_kind(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
+{
+  static const char *vs[] = {
+    "best-effort", "reliable", NULL
+  };
+  static const nn_reliability_kind_t ms[] = {
+    NN_BEST_EFFORT_RELIABILITY_QOS, NN_RELIABLE_RELIABILITY_QOS, 0,
+  };
+  int idx = list_index(vs, value);
+  nn_reliability_kind_t *elem = cfg_address(cfgst, parent, cfgelem);
+  assert(sizeof(vs) / sizeof(*vs) == sizeof(ms) / sizeof(*ms));
+  if ( idx < 0 )
+    return cfg_error(cfgst, "'%s': undefined value", value);
+  *elem = ms[idx];
+  return 1;
+}
+
+static void pf_reliability_kind(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
+{
+  nn_reliability_kind_t *p = cfg_address(cfgst, parent, cfgelem);
+  const char *str = "INVALID";
+  switch ( *p ) {
+    case NN_BEST_EFFORT_RELIABILITY_QOS: str = "best-effort"; break;
+    case NN_RELIABLE_RELIABILITY_QOS: str = "reliable"; break;
+  }
+  cfg_log(cfgst, "%s%s", str, is_default ? " [def]" : "");
+}
+
+static int uf_durability_kind(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
+{
+  static const char *vs[] = {
+    "volatile", "transient-local", "transient", "persistent", NULL
+  };
+  static const nn_durability_kind_t ms[] = {
+    NN_VOLATILE_DURABILITY_QOS, NN_TRANSIENT_LOCAL_DURABILITY_QOS, NN_TRANSIENT_DURABILITY_QOS, NN_PERSISTENT_DURABILITY_QOS, 0,
+  };
+  int idx = list_index(vs, value);
+  nn_durability_kind_t *elem = cfg_address(cfgst, parent, cfgelem);
+  assert(sizeof(vs) / sizeof(*vs) == sizeof(ms) / sizeof(*ms));
+  if ( idx < 0 )
+    return cfg_error(cfgst, "'%s': undefined value", value);
+  *elem = ms[idx];
+  return 1;
+}
+
+static void pf_durability_kind(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
+{
+  nn_durability_kind_t *p = cfg_address(cfgst, parent, cfgelem);
+  const char *str = "INVALID";
+  switch ( *p ) {
+    case NN_VOLATILE_DURABILITY_QOS: str = "volatile"; break;
+    case NN_TRANSIENT_LOCAL_DURABILITY_QOS: str = "transient-local"; break;
+    case NN_TRANSIENT_DURABILITY_QOS: str = "transient"; break;
+    case NN_PERSISTENT_DURABILITY_QOS: str = "persistent"; break;
+  }
+  cfg_log(cfgst, "%s%s", str, is_default ? " [def]" : "");
+}
+
 #ifdef DDSI_INCLUDE_SSL
 static int uf_min_tls_version(struct cfgst *cfgst, UNUSED_ARG(void *parent), UNUSED_ARG(struct cfgelem const * const cfgelem), UNUSED_ARG(int first), const char *value)
 {
@@ -1450,7 +1663,6 @@ static int uf_natint64_unit(struct cfgst *cfgst, int64_t *elem, const char *valu
 }
 DDSRT_WARNING_MSVC_ON(4996);
 
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
 static int uf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
 {
   int64_t bandwidth_bps = 0;
@@ -1462,7 +1674,7 @@ static int uf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const
       return 0;
     *elem = 0;
     return 1;
-  } else if ( !uf_natint64_unit(cfgst, &bandwidth_bps, value, unittab_bandwidth_bps, 8, INT64_MAX) ) {
+  } else if ( !uf_natint64_unit(cfgst, &bandwidth_bps, value, unittab_bandwidth_bps, 8, 0, INT64_MAX) ) {
     return 0;
   } else if ( bandwidth_bps / 8 > INT_MAX ) {
     return cfg_error(cfgst, "%s: value out of range", value);
@@ -1472,7 +1684,6 @@ static int uf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const
     return 1;
   }
 }
-#endif
 
 static int uf_memsize(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
 {
@@ -1705,6 +1916,83 @@ static int uf_maybe_memsize(struct cfgst *cfgst, void *parent, struct cfgelem co
   }
 }
 
+#define MAX_CPU_INDEX 4095
+
+static int cmp_cpu (const void *va, const void *vb)
+{
+  const uint32_t *a = va, *b = vb;
+  return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
+}
+
+static int parse_cpu_index(const char **p, uint32_t *cpu)
+{
+  /* plain decimal digits only: no sign, no white space and no
+     wrap-around of out-of-range values */
+  const char *q = *p;
+  uint32_t v = 0;
+  if ( *q < '0' || *q > '9' )
+    return 0;
+  do {
+    v = 10 * v + (uint32_t) (*q++ - '0');
+    if ( v > MAX_CPU_INDEX )
+      return 0;
+  } while ( *q >= '0' && *q <= '9' );
+  *p = q;
+  *cpu = v;
+  return 1;
+}
+
+static int uf_cpuset(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
+{
+  struct config_cpuset *elem = cfg_address(cfgst, parent, cfgelem);
+  const char *p = value;
+  uint32_t n = 0, size = 0, *cpus = NULL;
+  if ( ddsrt_strcasecmp(value, "any") == 0 ) {
+    elem->n = 0;
+    elem->cpus = NULL;
+    return 1;
+  }
+  do {
+    uint32_t lo, hi;
+    if ( !parse_cpu_index(&p, &lo) )
+      goto err;
+    hi = lo;
+    if ( *p == '-' ) {
+      p++;
+      if ( !parse_cpu_index(&p, &hi) || hi < lo )
+        goto err;
+    }
+    for ( ; lo <= hi; lo++ ) {
+      if ( n == size ) {
+        size = (size == 0) ? 8 : 2 * size;
+        cpus = ddsrt_realloc(cpus, size * sizeof(*cpus));
+      }
+      cpus[n++] = lo;
+    }
+  } while ( *p++ == ',' );
+  if ( p[-1] != 0 )
+    goto err;
+  qsort(cpus, n, sizeof(*cpus), cmp_cpu);
+  elem->n = 0;
+  for ( uint32_t i = 0; i < n; i++ ) {
+    if ( elem->n == 0 || cpus[elem->n - 1] != cpus[i] )
+      cpus[elem->n++] = cpus[i];
+  }
+  elem->cpus = cpus;
+  return 1;
+ err:
+  ddsrt_free(cpus);
+  elem->n = 0;
+  elem->cpus = NULL;
+  return cfg_error(cfgst, "'%s': neither 'any' nor a list of CPU numbers and ranges in [0,%d]\n", value, MAX_CPU_INDEX);
+}
+
+static void ff_cpuset(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem)
+{
+  struct config_cpuset *elem = cfg_address(cfgst, parent, cfgelem);
+  ddsrt_free(elem->cpus);
+}
+
 static int uf_int(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG(int first), const char *value)
 {
   int *elem = cfg_address(cfgst, parent, cfgelem);
@@ -1855,11 +2143,26 @@ static int uf_natint(struct cfgst *cfgst, void *parent, struct cfgelem const * c
   return uf_int_min_max(cfgst, parent, cfgelem, first, value, 0, INT32_MAX);
 }
 
+static int uf_recv_threads_uc(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 1, MAX_RECV_THREADS_UC);
+}
+
+static int uf_builtins_dqueues(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 1, MAX_BUILTINS_DQUEUES);
+}
+
 static int uf_natint_255(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
 {
   return uf_int_min_max(cfgst, parent, cfgelem, first, value, 0, 255);
 }
 
+static int uf_fec_group_size(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 0, NN_FEC_MAX_GROUP_SIZE);
+}
+
 static int uf_transport_selector (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
 {
   static const char *vs[] = { "default", "udp", "udp6", "tcp", "tcp6", "raweth", NULL };
@@ -2097,7 +2400,6 @@ static void pf_duration(struct cfgst *cfgst, void *parent, struct cfgelem const
     pf_int64_unit(cfgst, *elem, is_default, unittab_duration, "s");
 }
 
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
 static void pf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
 {
   const uint32_t *elem = cfg_address(cfgst, parent, cfgelem);
@@ -2106,7 +2408,6 @@ static void pf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const
   else
     pf_int64_unit(cfgst, *elem, is_default, unittab_bandwidth_Bps, "B/s");
 }
-#endif
 
 static void pf_memsize(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
 {
@@ -2148,6 +2449,29 @@ static void pf_maybe_memsize(struct cfgst *cfgst, void *parent, struct cfgelem c
     pf_int64_unit(cfgst, p->value, is_default, unittab_memsize, "B");
 }
 
+static void pf_cpuset(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
+{
+  struct config_cpuset *p = cfg_address(cfgst, parent, cfgelem);
+  char str[256];
+  size_t pos = 0;
+  if ( p->n == 0 ) {
+    cfg_log(cfgst, "any%s", is_default ? " [def]" : "");
+    return;
+  }
+  str[0] = 0;
+  for ( uint32_t i = 0; i < p->n && pos < sizeof(str); ) {
+    uint32_t j = i + 1;
+    while ( j < p->n && p->cpus[j] == p->cpus[j - 1] + 1 )
+      j++;
+    if ( j - i == 1 )
+      pos += (size_t) snprintf(str + pos, sizeof(str) - pos, "%s%"PRIu32, i == 0 ? "" : ",", p->cpus[i]);
+    else
+      pos += (size_t) snprintf(str + pos, sizeof(str) - pos, "%s%"PRIu32"-%"PRIu32, i == 0 ? "" : ",", p->cpus[i], p->cpus[j - 1]);
+    i = j;
+  }
+  cfg_log(cfgst, "%s%s", str, is_default ? " [def]" : "");
+}
+
 static void pf_domainId(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int is_default)
 {
   struct config_maybe_int32 *p = cfg_address(cfgst, parent, cfgelem);
@@ -2650,6 +2974,11 @@ struct cfgst * config_init (const char *configfile)
 
   memset(&config, 0, sizeof(config));
 
+#ifdef DDSI_INCLUDE_ENCRYPTION
+  /* the cipher names in the configuration are resolved by the plugin */
+  ddsi_security_plugin ();
+#endif
+
   config.tracingOutputFile = stderr;
   config.enabled_logcats = DDS_LC_ERROR | DDS_LC_WARNING;
 
@@ -19,6 +19,7 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/md5.h"
+#include "dds/ddsrt/string.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsi/q_protocol.h"
@@ -170,16 +171,21 @@ static void maybe_add_pp_as_meta_to_as_disc (const struct addrset *as_meta)
   }
 }
 
-static int write_mpayload (struct writer *wr, int alive, nn_parameterid_t keyparam, struct nn_xmsg *mpayload)
+static struct ddsi_serdata *mpayload_to_serdata (int alive, nn_parameterid_t keyparam, struct nn_xmsg *mpayload)
 {
-  struct thread_state1 * const ts1 = lookup_thread_state ();
   struct ddsi_plist_sample plist_sample;
   struct ddsi_serdata *serdata;
   nn_xmsg_payload_to_plistsample (&plist_sample, keyparam, mpayload);
   serdata = ddsi_serdata_from_sample (gv.plist_topic, alive ? SDK_DATA : SDK_KEY, &plist_sample);
   serdata->statusinfo = alive ? 0 : NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER;
   serdata->timestamp = now ();
-  return write_sample_nogc_notk (ts1, NULL, wr, serdata);
+  return serdata;
+}
+
+static int write_mpayload (struct writer *wr, int alive, nn_parameterid_t keyparam, struct nn_xmsg *mpayload)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  return write_sample_nogc_notk (ts1, NULL, wr, mpayload_to_serdata (alive, keyparam, mpayload));
 }
 
 int spdp_write (struct participant *pp)
@@ -188,10 +194,10 @@ int spdp_write (struct participant *pp)
   struct nn_locators_one def_uni_loc_one, def_multi_loc_one, meta_uni_loc_one, meta_multi_loc_one;
   nn_plist_t ps;
   struct writer *wr;
+  struct ddsi_serdata *serdata, *old_serdata;
   size_t size;
   char node[64];
   uint64_t qosdiff;
-  int ret;
 
   if (pp->e.onlylocal) {
       /* This topic is only locally available. */
@@ -321,9 +327,19 @@ int spdp_write (struct participant *pp)
   nn_xmsg_addpar_sentinel (mpayload);
   nn_plist_fini (&ps);
 
-  ret = write_mpayload (wr, 1, PID_PARTICIPANT_GUID, mpayload);
+  /* The periodic republishing of the SPDP sample looks it up in the WHC by
+     key, retaining a reference to the sample saves constructing the key
+     over and over again; replacing it whenever the participant's
+     discovery data changes keeps it current. */
+  serdata = mpayload_to_serdata (1, PID_PARTICIPANT_GUID, mpayload);
   nn_xmsg_free (mpayload);
-  return ret;
+  ddsrt_mutex_lock (&pp->e.lock);
+  old_serdata = pp->spdp_serdata;
+  pp->spdp_serdata = ddsi_serdata_ref (serdata);
+  ddsrt_mutex_unlock (&pp->e.lock);
+  if (old_serdata)
+    ddsi_serdata_unref (old_serdata);
+  return write_sample_nogc_notk (lookup_thread_state (), NULL, wr, serdata);
 }
 
 int spdp_dispose_unregister (struct participant *pp)
@@ -333,6 +349,8 @@ int spdp_dispose_unregister (struct participant *pp)
   struct writer *wr;
   int ret;
 
+  if (config.static_discovery_exclusive)
+    return 0;
   if ((wr = get_builtin_writer (pp, NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER)) == NULL)
   {
     DDS_TRACE("spdp_dispose_unregister("PGUIDFMT") - builtin participant writer not found\n", PGUID (pp->e.guid));
@@ -779,6 +797,66 @@ static int handle_SPDP_alive (const struct receiver_state *rst, nn_wctime_t time
   return 1;
 }
 
+static uint32_t guid_prefix_hash (const nn_guid_prefix_t *prefix)
+{
+  return (uint32_t)
+    (((uint64_t) prefix->u[0] * UINT64_C (16292676669999574021) +
+      (uint64_t) prefix->u[1] * UINT64_C (10242350189706880077) +
+      (uint64_t) prefix->u[2] * UINT64_C (12844332200329132887)) >> 32);
+}
+
+static ddsrt_mutex_t *builtins_pp_lock (const nn_guid_prefix_t *prefix)
+{
+  return &gv.builtins_pp_locks[guid_prefix_hash (prefix) % N_BUILTINS_PP_LOCKS];
+}
+
+static uint64_t discovery_payload_hash (const void *vdata, unsigned len)
+{
+  /* FNV-1a over the serialized payload, including the encoding; 0 is
+     reserved for "none" */
+  const unsigned char *data = vdata;
+  uint64_t h = UINT64_C (14695981039346656037);
+  for (unsigned i = 0; i < len; i++)
+    h = (h ^ data[i]) * UINT64_C (1099511628211);
+  return (h == 0) ? 1 : h;
+}
+
+static bool find_guid_param (const nn_plist_src_t *src, nn_parameterid_t pid, nn_guid_t *guid)
+{
+  const unsigned char *value;
+  uint16_t length;
+  if (nn_plist_findparam_checking (src, pid, &value, &length) < 0 || value == NULL || length < sizeof (*guid))
+    return false;
+  memcpy (guid, value, sizeof (*guid));
+  *guid = nn_ntoh_guid (*guid);
+  return true;
+}
+
+static bool handle_SPDP_unchanged (const nn_plist_src_t *src, uint64_t hash)
+{
+  /* Participants periodically republish their SPDP data, nearly always
+     unchanged.  For a known proxy participant that published exactly the
+     same data before, all that needs to be done is renewing its lease, so
+     skip parsing it. */
+  struct proxy_participant *proxypp;
+  ddsrt_mutex_t *pp_lock;
+  nn_guid_t ppguid;
+  bool unchanged = false;
+  if (!find_guid_param (src, PID_PARTICIPANT_GUID, &ppguid))
+    return false;
+  pp_lock = builtins_pp_lock (&ppguid.prefix);
+  ddsrt_mutex_lock (pp_lock);
+  if ((proxypp = ephash_lookup_proxy_participant_guid (&ppguid)) != NULL && proxypp->spdp_hash == hash)
+  {
+    DDS_LOG(DDS_LC_TRACE, " "PGUIDFMT" (known, unchanged)\n", PGUID (ppguid));
+    lease_renew (ddsrt_atomic_ldvoidp (&proxypp->lease), now_et ());
+    proxypp->spdp_unchanged_count++;
+    unchanged = true;
+  }
+  ddsrt_mutex_unlock (pp_lock);
+  return unchanged;
+}
+
 static void handle_SPDP (const struct receiver_state *rst, nn_wctime_t timestamp, unsigned statusinfo, const void *vdata, unsigned len)
 {
   const struct CDRHeader *data = vdata; /* built-ins not deserialized (yet) */
@@ -794,11 +872,16 @@ static void handle_SPDP (const struct receiver_state *rst, nn_wctime_t timestamp
     nn_plist_src_t src;
     int interesting = 0;
     int plist_ret;
+    ddsrt_mutex_t *pp_lock;
+    uint64_t hash;
     src.protocol_version = rst->protocol_version;
     src.vendorid = rst->vendor;
     src.encoding = data->identifier;
     src.buf = (unsigned char *) data + 4;
     src.bufsz = len - 4;
+    hash = discovery_payload_hash (data, len);
+    if (statusinfo == 0 && handle_SPDP_unchanged (&src, hash))
+      return;
     if ((plist_ret = nn_plist_init_frommsg (&decoded_data, NULL, ~(uint64_t)0, ~(uint64_t)0, &src)) < 0)
     {
       if (plist_ret != Q_ERR_INCOMPATIBLE)
@@ -806,11 +889,17 @@ static void handle_SPDP (const struct receiver_state *rst, nn_wctime_t timestamp
       return;
     }
 
+    pp_lock = builtins_pp_lock ((decoded_data.present & PP_PARTICIPANT_GUID) ? &decoded_data.participant_guid.prefix : &rst->src_guid_prefix);
+    ddsrt_mutex_lock (pp_lock);
     switch (statusinfo & (NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER))
     {
-      case 0:
+      case 0: {
+        struct proxy_participant *proxypp;
         interesting = handle_SPDP_alive (rst, timestamp, &decoded_data);
+        if ((decoded_data.present & PP_PARTICIPANT_GUID) && (proxypp = ephash_lookup_proxy_participant_guid (&decoded_data.participant_guid)) != NULL)
+          proxypp->spdp_hash = hash;
         break;
+      }
 
       case NN_STATUSINFO_DISPOSE:
       case NN_STATUSINFO_UNREGISTER:
@@ -818,6 +907,7 @@ static void handle_SPDP (const struct receiver_state *rst, nn_wctime_t timestamp
         interesting = handle_SPDP_dead (rst, timestamp, &decoded_data, statusinfo);
         break;
     }
+    ddsrt_mutex_unlock (pp_lock);
 
     nn_plist_fini (&decoded_data);
     DDS_LOG(interesting ? DDS_LC_DISCOVERY : DDS_LC_TRACE, "\n");
@@ -866,7 +956,7 @@ static int sedp_write_endpoint
 (
    struct writer *wr, int alive, const nn_guid_t *epguid,
    const struct entity_common *common, const struct endpoint_common *epcommon,
-   const nn_xqos_t *xqos, struct addrset *as)
+   const nn_xqos_t *xqos, const nn_content_filter_property_t *filter, struct addrset *as)
 {
   const nn_xqos_t *defqos = is_writer_entityid (epguid->entityid) ? &gv.default_xqos_wr : &gv.default_xqos_rd;
   struct nn_xmsg *mpayload;
@@ -874,6 +964,11 @@ static int sedp_write_endpoint
   nn_plist_t ps;
   int ret;
 
+  /* Endpoints are configured on the remote side when discovery is
+     exclusively static, so there is no point in publishing them */
+  if (config.static_discovery_exclusive)
+    return 0;
+
   nn_plist_init_empty (&ps);
   ps.present |= PP_ENDPOINT_GUID;
   ps.endpoint_guid = *epguid;
@@ -940,6 +1035,7 @@ static int sedp_write_endpoint
   mpayload = nn_xmsg_new (gv.xmsgpool, &wr->e.guid.prefix, 0, NN_XMSG_KIND_DATA);
   nn_plist_addtomsg (mpayload, &ps, ~(uint64_t)0, ~(uint64_t)0);
   if (xqos) nn_xqos_addtomsg (mpayload, xqos, qosdiff);
+  if (filter) nn_xmsg_addpar_content_filter_property (mpayload, PID_CONTENT_FILTER_PROPERTY, filter);
   nn_xmsg_addpar_sentinel (mpayload);
   nn_plist_fini (&ps);
 
@@ -967,7 +1063,7 @@ int sedp_write_writer (struct writer *wr)
 #else
     struct addrset *as = NULL;
 #endif
-    return sedp_write_endpoint (sedp_wr, 1, &wr->e.guid, &wr->e, &wr->c, wr->xqos, as);
+    return sedp_write_endpoint (sedp_wr, 1, &wr->e.guid, &wr->e, &wr->c, wr->xqos, NULL, as);
   }
   return 0;
 }
@@ -982,7 +1078,7 @@ int sedp_write_reader (struct reader *rd)
 #else
     struct addrset *as = NULL;
 #endif
-    return sedp_write_endpoint (sedp_wr, 1, &rd->e.guid, &rd->e, &rd->c, rd->xqos, as);
+    return sedp_write_endpoint (sedp_wr, 1, &rd->e.guid, &rd->e, &rd->c, rd->xqos, rd->filter, as);
   }
   return 0;
 }
@@ -992,7 +1088,7 @@ int sedp_dispose_unregister_writer (struct writer *wr)
   if ((!is_builtin_entityid(wr->e.guid.entityid, NN_VENDORID_ECLIPSE)) && (!wr->e.onlylocal))
   {
     struct writer *sedp_wr = get_sedp_writer (wr->c.pp, NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_WRITER);
-    return sedp_write_endpoint (sedp_wr, 0, &wr->e.guid, NULL, NULL, NULL, NULL);
+    return sedp_write_endpoint (sedp_wr, 0, &wr->e.guid, NULL, NULL, NULL, NULL, NULL);
   }
   return 0;
 }
@@ -1002,7 +1098,7 @@ int sedp_dispose_unregister_reader (struct reader *rd)
   if ((!is_builtin_entityid(rd->e.guid.entityid, NN_VENDORID_ECLIPSE)) && (!rd->e.onlylocal))
   {
     struct writer *sedp_wr = get_sedp_writer (rd->c.pp, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_WRITER);
-    return sedp_write_endpoint (sedp_wr, 0, &rd->e.guid, NULL, NULL, NULL, NULL);
+    return sedp_write_endpoint (sedp_wr, 0, &rd->e.guid, NULL, NULL, NULL, NULL, NULL);
   }
   return 0;
 }
@@ -1322,6 +1418,43 @@ static void handle_SEDP_dead (nn_plist_t *datap, nn_wctime_t timestamp)
   DDS_LOG(DDS_LC_DISCOVERY, " %s\n", (res < 0) ? " unknown" : " delete");
 }
 
+static struct proxy_endpoint_common *lookup_proxy_endpoint (const nn_guid_t *guid)
+{
+  if (is_writer_entityid (guid->entityid))
+  {
+    struct proxy_writer *pwr = ephash_lookup_proxy_writer_guid (guid);
+    return pwr ? &pwr->c : NULL;
+  }
+  else
+  {
+    struct proxy_reader *prd = ephash_lookup_proxy_reader_guid (guid);
+    return prd ? &prd->c : NULL;
+  }
+}
+
+static bool handle_SEDP_unchanged (const struct receiver_state *rst, const nn_plist_src_t *src, uint64_t hash)
+{
+  /* Reannouncements of known endpoints are ignored (except for Cloud, which
+     uses it to move proxy participants between instances), so if the data
+     is the same as before, there's no point in parsing it */
+  struct proxy_endpoint_common *c;
+  ddsrt_mutex_t *pp_lock;
+  nn_guid_t epguid;
+  bool unchanged = false;
+  if (vendor_is_cloud (rst->vendor) || !find_guid_param (src, PID_ENDPOINT_GUID, &epguid))
+    return false;
+  pp_lock = builtins_pp_lock (&epguid.prefix);
+  ddsrt_mutex_lock (pp_lock);
+  if ((c = lookup_proxy_endpoint (&epguid)) != NULL && c->sedp_hash == hash)
+  {
+    DDS_LOG(DDS_LC_DISCOVERY, " "PGUIDFMT" known, unchanged\n", PGUID (epguid));
+    c->sedp_unchanged_count++;
+    unchanged = true;
+  }
+  ddsrt_mutex_unlock (pp_lock);
+  return unchanged;
+}
+
 static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp, unsigned statusinfo, const void *vdata, unsigned len)
 {
   const struct CDRHeader *data = vdata; /* built-ins not deserialized (yet) */
@@ -1336,11 +1469,16 @@ static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp
     nn_plist_t decoded_data;
     nn_plist_src_t src;
     int plist_ret;
+    ddsrt_mutex_t *pp_lock;
+    uint64_t hash;
     src.protocol_version = rst->protocol_version;
     src.vendorid = rst->vendor;
     src.encoding = data->identifier;
     src.buf = (unsigned char *) data + 4;
     src.bufsz = len - 4;
+    hash = discovery_payload_hash (data, len);
+    if (statusinfo == 0 && handle_SEDP_unchanged (rst, &src, hash))
+      return;
     if ((plist_ret = nn_plist_init_frommsg (&decoded_data, NULL, ~(uint64_t)0, ~(uint64_t)0, &src)) < 0)
     {
       if (plist_ret != Q_ERR_INCOMPATIBLE)
@@ -1348,11 +1486,17 @@ static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp
       return;
     }
 
+    pp_lock = builtins_pp_lock ((decoded_data.present & PP_ENDPOINT_GUID) ? &decoded_data.endpoint_guid.prefix : &rst->src_guid_prefix);
+    ddsrt_mutex_lock (pp_lock);
     switch (statusinfo & (NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER))
     {
-      case 0:
+      case 0: {
+        struct proxy_endpoint_common *c;
         handle_SEDP_alive (rst, &decoded_data, &rst->src_guid_prefix, rst->vendor, timestamp);
+        if ((decoded_data.present & PP_ENDPOINT_GUID) && (c = lookup_proxy_endpoint (&decoded_data.endpoint_guid)) != NULL)
+          c->sedp_hash = hash;
         break;
+      }
 
       case NN_STATUSINFO_DISPOSE:
       case NN_STATUSINFO_UNREGISTER:
@@ -1360,6 +1504,7 @@ static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp
         handle_SEDP_dead (&decoded_data, timestamp);
         break;
     }
+    ddsrt_mutex_unlock (pp_lock);
 
     nn_plist_fini (&decoded_data);
   }
@@ -1689,6 +1834,141 @@ static int defragment (unsigned char **datap, const struct nn_rdata *fragchain,
   }
 }
 
+/******************************************************************************
+ ***
+ *** Static discovery
+ ***
+ *****************************************************************************/
+
+static void static_endpoint_qos (nn_xqos_t *xqos, const struct config_static_endpoint_listelem *ep, const nn_xqos_t *defqos)
+{
+  xqos->present |= QP_TOPIC_NAME | QP_TYPE_NAME | QP_RELIABILITY | QP_DURABILITY;
+  xqos->topic_name = ddsrt_strdup (ep->topic);
+  xqos->type_name = ddsrt_strdup (ep->type);
+  xqos->reliability.kind = ep->reliability;
+  xqos->reliability.max_blocking_time = defqos->reliability.max_blocking_time;
+  xqos->durability.kind = ep->durability;
+  if (*ep->partition)
+  {
+    char *copy = ddsrt_strdup (ep->partition), *cursor = copy, *tok;
+    uint32_t n = 1;
+    for (const char *c = ep->partition; *c; c++)
+      if (*c == ',')
+        n++;
+    xqos->present |= QP_PARTITION;
+    xqos->partition.n = 0;
+    xqos->partition.strs = ddsrt_malloc (n * sizeof (*xqos->partition.strs));
+    while ((tok = ddsrt_strsep (&cursor, ",")) != NULL)
+      xqos->partition.strs[xqos->partition.n++] = ddsrt_strdup (tok);
+    ddsrt_free (copy);
+  }
+  nn_xqos_mergein_missing (xqos, defqos);
+}
+
+static void create_static_endpoints (const nn_guid_t *ppguid, struct addrset *as, const struct config_static_endpoint_listelem *eps, int is_writer, nn_wctime_t timestamp)
+{
+  for (const struct config_static_endpoint_listelem *ep = eps; ep; ep = ep->next)
+  {
+    nn_plist_t plist;
+    nn_plist_init_empty (&plist);
+    plist.present |= PP_ENDPOINT_GUID;
+    plist.endpoint_guid.prefix = ppguid->prefix;
+    plist.endpoint_guid.entityid.u = ep->entityid;
+    if (is_builtin_entityid (plist.endpoint_guid.entityid, NN_VENDORID_ECLIPSE) ||
+        (is_writer ? !is_writer_entityid (plist.endpoint_guid.entityid) : is_writer_entityid (plist.endpoint_guid.entityid)))
+    {
+      DDS_ERROR ("static discovery: "PGUIDFMT": invalid entity id for a %s\n", PGUID (plist.endpoint_guid), is_writer ? "writer" : "reader");
+      continue;
+    }
+    if (is_writer ? ephash_lookup_proxy_writer_guid (&plist.endpoint_guid) != NULL : ephash_lookup_proxy_reader_guid (&plist.endpoint_guid) != NULL)
+    {
+      DDS_ERROR ("static discovery: "PGUIDFMT": duplicate endpoint\n", PGUID (plist.endpoint_guid));
+      continue;
+    }
+    static_endpoint_qos (&plist.qos, ep, is_writer ? &gv.default_xqos_wr : &gv.default_xqos_rd);
+    DDS_LOG (DDS_LC_DISCOVERY, "static discovery: "PGUIDFMT" %s %s: %s/%s\n", PGUID (plist.endpoint_guid),
+             (plist.qos.reliability.kind == NN_RELIABLE_RELIABILITY_QOS) ? "reliable" : "best-effort",
+             is_writer ? "writer" : "reader", plist.qos.topic_name, plist.qos.type_name);
+    if (is_writer)
+    {
+#ifdef DDSI_INCLUDE_NETWORK_CHANNELS
+      struct config_channel_listelem *channel = find_channel (plist.qos.transport_priority);
+      new_proxy_writer (ppguid, &plist.endpoint_guid, as, &plist, channel->dqueue, channel->evq ? channel->evq : gv.xevents, timestamp);
+#else
+      new_proxy_writer (ppguid, &plist.endpoint_guid, as, &plist, gv.user_dqueue, gv.xevents, timestamp);
+#endif
+    }
+    else
+    {
+#ifdef DDSI_INCLUDE_SSM
+      new_proxy_reader (ppguid, &plist.endpoint_guid, as, &plist, timestamp, 0);
+#else
+      new_proxy_reader (ppguid, &plist.endpoint_guid, as, &plist, timestamp);
+#endif
+    }
+    nn_plist_fini (&plist);
+  }
+}
+
+void create_static_proxies (void)
+{
+  /* Statically configured participants only advertise the participant
+     message endpoints, so that liveliness is still exchanged; all user
+     endpoints come from the configuration and no SEDP is needed */
+  const unsigned bes = NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_DATA_WRITER | NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_DATA_READER;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  nn_wctime_t timestamp = now ();
+
+  thread_state_awake (ts1);
+  for (const struct config_static_participant_listelem *p = config.static_participants; p; p = p->next)
+  {
+    struct addrset *as_default, *as_meta;
+    nn_plist_t plist;
+    nn_guid_t ppguid;
+    ppguid.prefix = p->prefix;
+    ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+    if (ephash_lookup_proxy_participant_guid (&ppguid) != NULL)
+    {
+      DDS_ERROR ("static discovery: "PGUIDFMT": duplicate participant\n", PGUID (ppguid));
+      continue;
+    }
+
+    as_default = new_addrset ();
+    as_meta = new_addrset ();
+    add_addresses_to_addrset (as_default, p->address, -1, "static discovery", 0);
+    add_addresses_to_addrset (as_meta, *p->meta_address ? p->meta_address : p->address, -1, "static discovery", 0);
+    if (addrset_empty_uc (as_default) || addrset_empty_uc (as_meta))
+    {
+      DDS_ERROR ("static discovery: "PGUIDFMT": no unicast address\n", PGUID (ppguid));
+      unref_addrset (as_default);
+      unref_addrset (as_meta);
+      continue;
+    }
+    DDS_LOG (DDS_LC_DISCOVERY, "static discovery: "PGUIDFMT, PGUID (ppguid));
+    nn_log_addrset (DDS_LC_DISCOVERY, " (data", as_default);
+    nn_log_addrset (DDS_LC_DISCOVERY, " meta", as_meta);
+    DDS_LOG (DDS_LC_DISCOVERY, ")\n");
+
+    nn_plist_init_empty (&plist);
+    plist.present |= PP_PARTICIPANT_GUID;
+    plist.participant_guid = ppguid;
+    new_proxy_participant (&ppguid, bes, 0, NULL, as_default, as_meta, &plist, p->lease_duration, NN_VENDORID_ECLIPSE, 0, timestamp);
+    nn_plist_fini (&plist);
+
+    create_static_endpoints (&ppguid, as_default, p->writers, 1, timestamp);
+    create_static_endpoints (&ppguid, as_default, p->readers, 0, timestamp);
+  }
+  thread_state_asleep (ts1);
+}
+
+struct nn_dqueue *builtins_dqueue_for_prefix (const nn_guid_prefix_t *prefix)
+{
+  /* Discovery data from different participants is processed in parallel
+     on multiple queues, that from a single participant always on the same
+     queue so that it is processed in order */
+  return gv.builtins_dqueues[((uint64_t) guid_prefix_hash (prefix) * gv.n_builtins_dqueues) >> 32];
+}
+
 int builtins_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, UNUSED_ARG (const nn_guid_t *rdguid), UNUSED_ARG (void *qarg))
 {
   struct proxy_writer *pwr;
@@ -1865,7 +2145,10 @@ int builtins_dqueue_handler (const struct nn_rsample_info *sampleinfo, const str
   switch (srcguid.entityid.u)
   {
     case NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER:
-      handle_SPDP (sampleinfo->rst, timestamp, statusinfo, datap, datasz);
+      if (config.static_discovery_exclusive)
+        DDS_LOG (DDS_LC_DISCOVERY, "SPDP "PGUIDFMT": ignored (static discovery)\n", PGUID (srcguid));
+      else
+        handle_SPDP (sampleinfo->rst, timestamp, statusinfo, datap, datasz);
       break;
     case NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_WRITER:
     case NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_WRITER:
@@ -17,6 +17,7 @@
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/string.h"
 
 #include "dds/ddsrt/avl.h"
 
@@ -300,12 +301,86 @@ static int print_proxy_participants (struct thread_state1 * const ts1, ddsi_tran
   return x;
 }
 
+#define DEBMON_MAX_CPUS 64
+
+struct thread_placement {
+  char *name;
+  dds_retcode_t rc;
+  uint32_t ncpus;
+  uint32_t cpus[DEBMON_MAX_CPUS];
+};
+
+static int print_cpus (ddsi_tran_conn_t conn, uint32_t ncpus, const uint32_t *cpus)
+{
+  const uint32_t n = (ncpus < DEBMON_MAX_CPUS) ? ncpus : DEBMON_MAX_CPUS;
+  int x = 0;
+  for (uint32_t i = 0; i < n; )
+  {
+    uint32_t j = i + 1;
+    while (j < n && cpus[j] == cpus[j - 1] + 1)
+      j++;
+    if (j - i == 1)
+      x += cpf (conn, "%s%"PRIu32, i == 0 ? "" : ",", cpus[i]);
+    else
+      x += cpf (conn, "%s%"PRIu32"-%"PRIu32, i == 0 ? "" : ",", cpus[i], cpus[j - 1]);
+    i = j;
+  }
+  if (n < ncpus)
+    x += cpf (conn, ",...");
+  return x;
+}
+
+static int print_threads (ddsi_tran_conn_t conn)
+{
+  struct thread_placement *tps;
+  unsigned i, n = 0;
+  int x = 0;
+
+  /* Collect the placement of the internal threads first, so as not to hold
+     the thread states lock while writing to the connection */
+  ddsrt_mutex_lock (&thread_states.lock);
+  tps = ddsrt_malloc (thread_states.nthreads * sizeof (*tps));
+  for (i = 0; i < thread_states.nthreads; i++)
+  {
+    const struct thread_state1 *ts = &thread_states.ts[i];
+    if (ts->state != THREAD_STATE_ALIVE)
+      continue;
+    tps[n].name = ddsrt_strdup (ts->name);
+    tps[n].rc = ddsrt_thread_getaffinity (ts->extTid, &tps[n].ncpus, tps[n].cpus, DEBMON_MAX_CPUS);
+    n++;
+  }
+  ddsrt_mutex_unlock (&thread_states.lock);
+
+  for (i = 0; i < n; i++)
+  {
+    const struct config_thread_properties_listelem *tprops = lookup_thread_properties (tps[i].name);
+    x += cpf (conn, "thread %s cpus ", tps[i].name);
+    if (tps[i].rc == DDS_RETCODE_OK)
+      x += print_cpus (conn, tps[i].ncpus, tps[i].cpus);
+    else
+      x += cpf (conn, "unknown");
+    if (tprops == NULL || tprops->cpuset.n == 0)
+      x += cpf (conn, " (configured any)\n");
+    else
+    {
+      x += cpf (conn, " (configured ");
+      x += print_cpus (conn, tprops->cpuset.n, tprops->cpuset.cpus);
+      x += cpf (conn, ")\n");
+    }
+    ddsrt_free (tps[i].name);
+  }
+  ddsrt_free (tps);
+  return x;
+}
+
 static void debmon_handle_connection (struct debug_monitor *dm, ddsi_tran_conn_t conn)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   struct plugin *p;
   int r = 0;
-  r += print_participants (ts1, conn);
+  r += print_threads (conn);
+  if (r == 0)
+    r += print_participants (ts1, conn);
   if (r == 0)
     r += print_proxy_participants (ts1, conn);
 
@@ -89,7 +89,7 @@ static const unsigned prismtech_builtin_writers_besmask =
   NN_DISC_BUILTIN_ENDPOINT_CM_SUBSCRIBER_WRITER;
 
 static dds_retcode_t new_writer_guid (struct writer **wr_out, const struct nn_guid *guid, const struct nn_guid *group_guid, struct participant *pp, const struct ddsi_sertopic *topic, const struct nn_xqos *xqos, struct whc *whc, status_cb_t status_cb, void *status_cbarg);
-static dds_retcode_t new_reader_guid (struct reader **rd_out, const struct nn_guid *guid, const struct nn_guid *group_guid, struct participant *pp, const struct ddsi_sertopic *topic, const struct nn_xqos *xqos, struct rhc *rhc, status_cb_t status_cb, void *status_cbarg);
+static dds_retcode_t new_reader_guid (struct reader **rd_out, const struct nn_guid *guid, const struct nn_guid *group_guid, struct participant *pp, const struct ddsi_sertopic *topic, const struct nn_xqos *xqos, const struct nn_content_filter_property *filter, struct rhc *rhc, status_cb_t status_cb, void *status_cbarg);
 static struct participant *ref_participant (struct participant *pp, const struct nn_guid *guid_of_refing_entity);
 static void unref_participant (struct participant *pp, const struct nn_guid *guid_of_refing_entity);
 static void delete_proxy_group_locked (struct proxy_group *pgroup, nn_wctime_t timestamp, int isimplicit);
@@ -243,6 +243,84 @@ void local_reader_ary_setinvalid (struct local_reader_ary *x)
   ddsrt_mutex_unlock (&x->rdary_lock);
 }
 
+void coherent_set_init (struct coherent_set *cs)
+{
+  cs->first_seq = 0;
+  cs->next_seq = 0;
+  cs->incomplete = 0;
+  cs->n = cs->size = 0;
+  cs->samples = NULL;
+  cs->tks = NULL;
+}
+
+void coherent_set_fini (struct coherent_set *cs)
+{
+  coherent_set_clear (cs);
+  ddsrt_free (cs->samples);
+  ddsrt_free (cs->tks);
+}
+
+void coherent_set_start (struct coherent_set *cs, seqno_t first_seq)
+{
+  assert (cs->n == 0);
+  cs->first_seq = first_seq;
+  cs->next_seq = first_seq;
+  cs->incomplete = 0;
+}
+
+static void coherent_set_release_samples (struct coherent_set *cs)
+{
+  uint32_t i;
+  for (i = 0; i < cs->n; i++)
+  {
+    ddsi_serdata_unref (cs->samples[i]);
+    ddsi_tkmap_instance_unref (cs->tks[i]);
+  }
+  cs->n = 0;
+}
+
+void coherent_set_append (struct coherent_set *cs, seqno_t seq, struct ddsi_serdata *sample, struct ddsi_tkmap_instance *tk)
+{
+  assert (cs->first_seq != 0);
+  if (seq != cs->next_seq)
+    cs->incomplete = 1;
+  cs->next_seq = seq + 1;
+  if (!cs->incomplete && config.coherent_set_maxsamples > 0 && cs->n == config.coherent_set_maxsamples)
+  {
+    DDS_TRACE(" coherent set %"PRId64" exceeds %"PRIu32" samples, dropped\n", cs->first_seq, cs->n);
+    cs->incomplete = 1;
+  }
+  if (cs->incomplete)
+  {
+    /* An incomplete set never gets delivered, so there is no point in
+       holding on to its samples until the end of the set */
+    coherent_set_release_samples (cs);
+    return;
+  }
+  if (cs->n == cs->size)
+  {
+    cs->size = (cs->size == 0) ? 8 : 2 * cs->size;
+    cs->samples = ddsrt_realloc (cs->samples, cs->size * sizeof (*cs->samples));
+    cs->tks = ddsrt_realloc (cs->tks, cs->size * sizeof (*cs->tks));
+  }
+  cs->samples[cs->n] = ddsi_serdata_ref (sample);
+  cs->tks[cs->n] = tk;
+  ddsi_tkmap_instance_ref (tk);
+  cs->n++;
+}
+
+void coherent_set_clear (struct coherent_set *cs)
+{
+  coherent_set_release_samples (cs);
+  cs->first_seq = 0;
+  cs->incomplete = 0;
+}
+
+bool reader_wants_coherent_sets (const struct reader *rd)
+{
+  return rd->xqos->presentation.coherent_access != 0;
+}
+
 nn_vendorid_t get_entity_vendorid (const struct entity_common *e)
 {
   switch (e->kind)
@@ -473,6 +551,7 @@ int new_participant_guid (const nn_guid_t *ppguid, unsigned flags, const nn_plis
      things go wrong -- we must initialize all that unref_participant
      depends on. */
   pp->spdp_xevent = NULL;
+  pp->spdp_serdata = NULL;
   pp->pmd_update_xevent = NULL;
 
   /* Create built-in endpoints (note: these have no GID, and no group GUID). */
@@ -551,31 +630,31 @@ int new_participant_guid (const nn_guid_t *ppguid, unsigned flags, const nn_plis
   if (!(flags & RTPS_PF_NO_BUILTIN_READERS))
   {
     subguid.entityid = to_entityid (NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.spdp_endpoint_xqos, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.spdp_endpoint_xqos, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_DETECTOR;
 
     subguid.entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_DETECTOR;
 
     subguid.entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_DETECTOR;
 
     subguid.entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_MESSAGE_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_DATA_READER;
 
     subguid.entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_CM_PARTICIPANT_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->prismtech_bes |= NN_DISC_BUILTIN_ENDPOINT_CM_PARTICIPANT_READER;
 
     subguid.entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_CM_PUBLISHER_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->prismtech_bes |= NN_DISC_BUILTIN_ENDPOINT_CM_PUBLISHER_READER;
 
     subguid.entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_CM_SUBSCRIBER_READER);
-    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, &subguid, &group_guid, pp, NULL, &gv.builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->prismtech_bes |= NN_DISC_BUILTIN_ENDPOINT_CM_SUBSCRIBER_READER;
 
   }
@@ -624,8 +703,9 @@ int new_participant_guid (const nn_guid_t *ppguid, unsigned flags, const nn_plis
   /* SPDP periodic broadcast uses the retransmit path, so the initial
      publication must be done differently. Must be later than making
      the participant globally visible, or the SPDP processing won't
-     recognise the participant as a local one. */
-  if (spdp_write (pp) >= 0)
+     recognise the participant as a local one. With exclusively static
+     discovery there is nothing to publish. */
+  if (!config.static_discovery_exclusive && spdp_write (pp) >= 0)
   {
     /* Once the initial sample has been written, the automatic and
        asynchronous broadcasting required by SPDP can start. Also,
@@ -828,6 +908,8 @@ static void unref_participant (struct participant *pp, const struct nn_guid *gui
          while longer for it to wakeup. */
       ddsi_conn_free (pp->m_conn);
     }
+    if (pp->spdp_serdata)
+      ddsi_serdata_unref (pp->spdp_serdata);
     nn_plist_fini (pp->plist);
     ddsrt_free (pp->plist);
     ddsrt_mutex_destroy (&pp->refc_lock);
@@ -1235,6 +1317,13 @@ static void rebuild_writer_addrset (struct writer *wr)
   wr->as = newas;
   unref_addrset (oldas);
 
+  /* the destinations of filtered samples derive from the same readers */
+  if (wr->filter_as)
+  {
+    unref_addrset (wr->filter_as);
+    wr->filter_as = NULL;
+  }
+
   DDS_LOG(DDS_LC_DISCOVERY, "rebuild_writer_addrset("PGUIDFMT"):", PGUID (wr->e.guid));
   nn_log_addrset(DDS_LC_DISCOVERY, "", wr->as);
   DDS_LOG(DDS_LC_DISCOVERY, "\n");
@@ -1256,7 +1345,11 @@ void rebuild_or_clear_writer_addrsets(int rebuild)
       if (rebuild)
         rebuild_writer_addrset(wr);
       else
+      {
         addrset_purge(wr->as);
+        if (wr->filter_as)
+          addrset_purge(wr->filter_as);
+      }
     }
     else
     {
@@ -1281,6 +1374,8 @@ static void free_wr_prd_match (struct wr_prd_match *m)
 {
   if (m)
   {
+    if (m->filter)
+      ddsi_plugin.content_filter_free (m->filter);
     nn_lat_estim_fini (&m->hb_to_ack_latency);
     ddsrt_free (m);
   }
@@ -1344,6 +1439,7 @@ static void writer_drop_connection (const struct nn_guid * wr_guid, const struct
       rebuild_writer_addrset (wr);
       remove_acked_messages (wr, &whcst, &deferred_free_list);
       wr->num_reliable_readers -= m->is_reliable;
+      wr->num_filtered_readers -= (m->filter != NULL);
     }
     ddsrt_mutex_unlock (&wr->e.lock);
     if (m != NULL && wr->status_cb)
@@ -1534,6 +1630,15 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
   m->all_have_replied_to_hb = 0;
   m->non_responsive_count = 0;
   m->rexmit_requests = 0;
+  m->filter = NULL;
+  m->filter_accepted = 1;
+  if (prd->filter && wr->topic && ddsi_plugin.content_filter_compile)
+  {
+    /* if we can't evaluate it, everything is sent and the reader filters */
+    if ((m->filter = ddsi_plugin.content_filter_compile (wr->topic, prd->filter)) == NULL)
+      DDS_LOG(DDS_LC_DISCOVERY, "  writer_add_connection(wr "PGUIDFMT" prd "PGUIDFMT") - content filter class \"%s\" not evaluated\n",
+              PGUID (wr->e.guid), PGUID (prd->e.guid), prd->filter->filter_class_name);
+  }
   /* m->demoted: see below */
   ddsrt_mutex_lock (&prd->e.lock);
   if (prd->deleting)
@@ -1557,6 +1662,11 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
   m->next_nackfrag = DDSI_COUNT_MIN;
   nn_lat_estim_init (&m->hb_to_ack_latency);
   m->hb_to_ack_latency_tlastlog = now ();
+  m->rtt_srtt = 0;
+  m->rtt_var = 0;
+  m->rto = 0;
+  m->t_last_rexmit.v = 0;
+  m->last_rexmit_seq = 0;
   m->t_acknack_accepted.v = 0;
 
   ddsrt_mutex_lock (&wr->e.lock);
@@ -1568,8 +1678,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
   {
     DDS_LOG(DDS_LC_DISCOVERY, "  writer_add_connection(wr "PGUIDFMT" prd "PGUIDFMT") - already connected\n", PGUID (wr->e.guid), PGUID (prd->e.guid));
     ddsrt_mutex_unlock (&wr->e.lock);
-    nn_lat_estim_fini (&m->hb_to_ack_latency);
-    ddsrt_free (m);
+    free_wr_prd_match (m);
   }
   else
   {
@@ -1577,6 +1686,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
     ddsrt_avl_insert_ipath (&wr_readers_treedef, &wr->readers, m, &path);
     rebuild_writer_addrset (wr);
     wr->num_reliable_readers += m->is_reliable;
+    wr->num_filtered_readers += (m->filter != NULL);
     ddsrt_mutex_unlock (&wr->e.lock);
 
     if (wr->status_cb)
@@ -2478,6 +2588,13 @@ static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vr
   n->max_seq = max_seq;
   n->all_have_replied_to_hb = have_replied ? 1 : 0;
 
+  /* 1b. Compute max_rto (0 if no reader in the subtree has a known round-trip time) */
+  n->max_rto = n->rto;
+  if (left && left->max_rto > n->max_rto)
+    n->max_rto = left->max_rto;
+  if (right && right->max_rto > n->max_rto)
+    n->max_rto = right->max_rto;
+
   /* 2. Compute num_reliable_readers_where_seq_equals_max */
   if (max_seq == 0)
   {
@@ -2599,6 +2716,7 @@ unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, stru
   assert (wr->e.guid.entityid.u != NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER);
   ASSERT_MUTEX_HELD (&wr->e.lock);
   n = whc_remove_acked_messages (wr->whc, writer_max_drop_seq (wr), whcst, deferred_free_list);
+  wr->whc_trim_count++;
   /* when transitioning from >= low-water to < low-water, signal
      anyone waiting in throttle_writer() */
   if (wr->throttling && whcst->unacked_bytes <= wr->whc_low)
@@ -2625,15 +2743,22 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
   writer_hbcontrol_init (&wr->hbcontrol);
   wr->throttling = 0;
   wr->retransmitting = 0;
+  wr->whc_trim_pending = 0;
   wr->t_rexmit_end.v = 0;
   wr->t_whc_high_upd.v = 0;
   wr->num_reliable_readers = 0;
+  wr->num_filtered_readers = 0;
+  wr->filter_as = NULL;
   wr->num_acks_received = 0;
   wr->num_nacks_received = 0;
   wr->throttle_count = 0;
   wr->throttle_tracing = 0;
   wr->rexmit_count = 0;
   wr->rexmit_lost_count = 0;
+  wr->rexmit_multifrag_count = 0;
+  wr->filter_gap_count = 0;
+  wr->filter_rexmit_gap_count = 0;
+  wr->whc_trim_count = 0;
 
   wr->status_cb = status_cb;
   wr->status_cb_entity = status_entity;
@@ -2736,16 +2861,19 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
   /* heartbeat event will be deleted when the handler can't find a
      writer for it in the hash table. T_NEVER => won't ever be
      scheduled, and this can only change by writing data, which won't
-     happen until after it becomes visible. */
+     happen until after it becomes visible. Likewise for the WHC trim
+     event, which only gets scheduled by acknowledgements. */
   if (wr->reliable)
   {
     nn_mtime_t tsched;
     tsched.v = T_NEVER;
     wr->heartbeat_xevent = qxev_heartbeat (wr->evq, tsched, &wr->e.guid);
+    wr->whc_trim_xevent = qxev_whc_trim (wr->evq, tsched, &wr->e.guid);
   }
   else
   {
     wr->heartbeat_xevent = NULL;
+    wr->whc_trim_xevent = NULL;
   }
   assert (wr->xqos->present & QP_LIVELINESS);
   if (wr->xqos->liveliness.kind != NN_AUTOMATIC_LIVELINESS_QOS ||
@@ -2884,6 +3012,8 @@ static void gc_delete_writer (struct gcreq *gcreq)
     wr->hbcontrol.tsched.v = T_NEVER;
     delete_xevent (wr->heartbeat_xevent);
   }
+  if (wr->whc_trim_xevent)
+    delete_xevent (wr->whc_trim_xevent);
 
   /* Tear down connections -- no proxy reader can be adding/removing
       us now, because we can't be found via guid_hash anymore.  We
@@ -2918,6 +3048,8 @@ static void gc_delete_writer (struct gcreq *gcreq)
     unref_addrset (wr->ssm_as);
 #endif
   unref_addrset (wr->as); /* must remain until readers gone (rebuilding of addrset) */
+  if (wr->filter_as)
+    unref_addrset (wr->filter_as);
   nn_xqos_fini (wr->xqos);
   ddsrt_free (wr->xqos);
   local_reader_ary_fini (&wr->rdary);
@@ -3161,6 +3293,7 @@ static dds_retcode_t new_reader_guid
   struct participant *pp,
   const struct ddsi_sertopic *topic,
   const struct nn_xqos *xqos,
+  const struct nn_content_filter_property *filter,
   struct rhc *rhc,
   status_cb_t status_cb,
   void * status_entity
@@ -3200,6 +3333,7 @@ static dds_retcode_t new_reader_guid
   assert (rd->xqos->present & QP_DURABILITY);
   rd->handle_as_transient_local = (rd->xqos->durability.kind == NN_TRANSIENT_LOCAL_DURABILITY_QOS);
   rd->topic = ddsi_sertopic_ref (topic);
+  rd->filter = filter ? nn_content_filter_property_dup (filter) : NULL;
   rd->ddsi2direct_cb = 0;
   rd->ddsi2direct_cbarg = 0;
   rd->init_acknack_count = 0;
@@ -3300,6 +3434,7 @@ dds_retcode_t new_reader
   const struct nn_guid *ppguid,
   const struct ddsi_sertopic *topic,
   const struct nn_xqos *xqos,
+  const struct nn_content_filter_property *filter,
   struct rhc * rhc,
   status_cb_t status_cb,
   void * status_cbarg
@@ -3315,7 +3450,7 @@ dds_retcode_t new_reader
   rdguid->prefix = pp->e.guid.prefix;
   if (pp_allocate_entityid (&rdguid->entityid, NN_ENTITYID_KIND_READER_WITH_KEY, pp) < 0)
     return DDS_RETCODE_OUT_OF_RESOURCES;
-  return new_reader_guid (rd_out, rdguid, group_guid, pp, topic, xqos, rhc, status_cb, status_cbarg);
+  return new_reader_guid (rd_out, rdguid, group_guid, pp, topic, xqos, filter, rhc, status_cb, status_cbarg);
 }
 
 static void gc_delete_reader (struct gcreq *gcreq)
@@ -3354,6 +3489,7 @@ static void gc_delete_reader (struct gcreq *gcreq)
     (rd->status_cb) (rd->status_cb_entity, NULL);
   }
   ddsi_sertopic_unref ((struct ddsi_sertopic *) rd->topic);
+  nn_content_filter_property_free (rd->filter);
 
   nn_xqos_fini (rd->xqos);
   ddsrt_free (rd->xqos);
@@ -3505,6 +3641,8 @@ void new_proxy_participant
   proxypp->as_default = as_default;
   proxypp->as_meta = as_meta;
   proxypp->endpoints = NULL;
+  proxypp->spdp_hash = 0;
+  proxypp->spdp_unchanged_count = 0;
   proxypp->plist = nn_plist_dup (plist);
   ddsrt_avl_init (&proxypp_groups_treedef, &proxypp->groups);
 
@@ -3590,7 +3728,7 @@ void new_proxy_participant
         assert (is_builtin_entityid (guid1.entityid, proxypp->vendor));
         if (is_writer_entityid (guid1.entityid))
         {
-          new_proxy_writer (ppguid, &guid1, proxypp->as_meta, &plist_wr, gv.builtins_dqueue, gv.xevents, timestamp);
+          new_proxy_writer (ppguid, &guid1, proxypp->as_meta, &plist_wr, builtins_dqueue_for_prefix (&proxypp->e.guid.prefix), gv.xevents, timestamp);
         }
         else
         {
@@ -4023,6 +4161,8 @@ static void proxy_endpoint_common_init (struct entity_common *e, struct proxy_en
   c->as = ref_addrset (as);
   c->topic = NULL; /* set from first matching reader/writer */
   c->vendor = proxypp->vendor;
+  c->sedp_hash = 0;
+  c->sedp_unchanged_count = 0;
 
   if (plist->present & PP_GROUP_GUID)
     c->group_guid = plist->group_guid;
@@ -4123,12 +4263,14 @@ int new_proxy_writer (const struct nn_guid *ppguid, const struct nn_guid *guid,
     pwr->defrag = nn_defrag_new (NN_DEFRAG_DROP_OLDEST, config.defrag_unreliable_maxsamples);
     pwr->reorder = nn_reorder_new (NN_REORDER_MODE_MONOTONICALLY_INCREASING, config.primary_reorder_maxsamples);
   }
+  nn_defrag_set_contig (pwr->defrag, config.defrag_contig_threshold, config.defrag_contig_maxsize, defrag_contig_alloc);
   pwr->dqueue = dqueue;
   pwr->evq = evq;
   pwr->ddsi2direct_cb = 0;
   pwr->ddsi2direct_cbarg = 0;
 
   local_reader_ary_init (&pwr->rdary);
+  coherent_set_init (&pwr->coherent);
 
   /* locking the entity prevents matching while the built-in topic hasn't been published yet */
   ddsrt_mutex_lock (&pwr->e.lock);
@@ -4243,6 +4385,9 @@ static void gc_delete_proxy_writer (struct gcreq *gcreq)
     free_pwr_rd_match (m);
   }
   local_reader_ary_fini (&pwr->rdary);
+  if (pwr->coherent.first_seq != 0)
+    DDS_LOG(DDS_LC_DISCOVERY, "gc_delete_proxy_writer: dropping unfinished coherent set %"PRId64" (%"PRIu32" samples)\n", pwr->coherent.first_seq, pwr->coherent.n);
+  coherent_set_fini (&pwr->coherent);
   proxy_endpoint_common_fini (&pwr->e, &pwr->c);
   nn_defrag_free (pwr->defrag);
   nn_reorder_free (pwr->reorder);
@@ -4303,6 +4448,7 @@ int new_proxy_reader (const struct nn_guid *ppguid, const struct nn_guid *guid,
   prd->favours_ssm = (favours_ssm && config.allowMulticast & AMC_SSM) ? 1 : 0;
 #endif
   prd->is_fict_trans_reader = 0;
+  prd->filter = (plist->present & PP_CONTENT_FILTER_PROPERTY) ? nn_content_filter_property_dup (&plist->content_filter_property) : NULL;
   /* Only assert PP lease on receipt of data if enabled (duh) and the proxy participant is a
      "real" participant, rather than the thing we use for endpoints discovered via the DS */
   prd->assert_pp_lease = (unsigned) !!config.arrival_of_data_asserts_pp_and_ep_liveliness;
@@ -4381,6 +4527,7 @@ static void gc_delete_proxy_reader (struct gcreq *gcreq)
     free_prd_wr_match (m);
   }
 
+  nn_content_filter_property_free (prd->filter);
   proxy_endpoint_common_fini (&prd->e, &prd->c);
   ddsrt_free (prd);
 }
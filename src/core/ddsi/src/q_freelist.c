@@ -9,6 +9,7 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#include <assert.h>
 #include <stddef.h>
 
 #include "dds/ddsrt/atomics.h"
@@ -245,6 +246,36 @@ void *nn_freelist_pushmany (struct nn_freelist *fl, void *first, void *last, uin
   return NULL;
 }
 
+static bool steal_inner (struct nn_freelist *fl, int k)
+{
+  /* When elements are freed by a different thread than the one allocating
+     them (e.g., samples acknowledged and freed by the GC thread), they can
+     linger in the partially filled magazine of the freeing thread, so take
+     those before resorting to allocating new ones.  Another thread may be
+     holding its own magazine and be trying to take ours, hence trylock. */
+  int i;
+  assert (fl->inner[k].count == 0);
+  for (i = 1; i < NN_FREELIST_NPAR; i++)
+  {
+    struct nn_freelist1 * const src = &fl->inner[(k + i) % NN_FREELIST_NPAR];
+    if (ddsrt_mutex_trylock (&src->lock))
+    {
+      if (src->count > 0)
+      {
+        struct nn_freelistM * const m = fl->inner[k].m;
+        fl->inner[k].m = src->m;
+        fl->inner[k].count = src->count;
+        src->m = m;
+        src->count = 0;
+        ddsrt_mutex_unlock (&src->lock);
+        return true;
+      }
+      ddsrt_mutex_unlock (&src->lock);
+    }
+  }
+  return false;
+}
+
 void *nn_freelist_pop (struct nn_freelist *fl)
 {
   int k = lock_inner (fl);
@@ -260,6 +291,12 @@ void *nn_freelist_pop (struct nn_freelist *fl)
     if (fl->mlist == NULL)
     {
       ddsrt_mutex_unlock (&fl->lock);
+      if (steal_inner (fl, k))
+      {
+        void *e = fl->inner[k].m->x[--fl->inner[k].count];
+        ddsrt_mutex_unlock (&fl->inner[k].lock);
+        return e;
+      }
       ddsrt_mutex_unlock (&fl->inner[k].lock);
       return NULL;
     }
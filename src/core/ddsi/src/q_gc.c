@@ -28,6 +28,10 @@
 
 #include "dds/ddsi/q_rtps.h" /* for guid_hash */
 
+/* Requests are created at a steady rate while data is being acknowledged, so
+   a few freed ones are kept for reuse */
+#define MAX_CACHED_GCREQS 16
+
 struct gcreq_queue {
   struct gcreq *first;
   struct gcreq *last;
@@ -35,6 +39,8 @@ struct gcreq_queue {
   ddsrt_cond_t cond;
   int terminate;
   int32_t count;
+  struct gcreq *cached; /* freed requests available for reuse, linked via next */
+  uint32_t ncached;
   struct thread_state1 *ts;
 };
 
@@ -172,6 +178,8 @@ struct gcreq_queue *gcreq_queue_new (void)
   q->first = q->last = NULL;
   q->terminate = 0;
   q->count = 0;
+  q->cached = NULL;
+  q->ncached = 0;
   ddsrt_mutex_init (&q->lock);
   ddsrt_cond_init (&q->cond);
   if (create_thread (&q->ts, "gc", (uint32_t (*) (void *)) gcreq_queue_thread, q) == DDS_RETCODE_OK)
@@ -218,6 +226,11 @@ void gcreq_queue_free (struct gcreq_queue *q)
 
   join_thread (q->ts);
   assert (q->first == NULL);
+  while ((gcreq = q->cached) != NULL)
+  {
+    q->cached = gcreq->next;
+    ddsrt_free (gcreq);
+  }
   ddsrt_cond_destroy (&q->cond);
   ddsrt_mutex_destroy (&q->lock);
   ddsrt_free (q);
@@ -226,13 +239,19 @@ void gcreq_queue_free (struct gcreq_queue *q)
 struct gcreq *gcreq_new (struct gcreq_queue *q, gcreq_cb_t cb)
 {
   struct gcreq *gcreq;
-  gcreq = ddsrt_malloc (offsetof (struct gcreq, vtimes) + thread_states.nthreads * sizeof (*gcreq->vtimes));
-  gcreq->cb = cb;
-  gcreq->queue = q;
-  threads_vtime_gather_for_wait (&gcreq->nvtimes, gcreq->vtimes);
   ddsrt_mutex_lock (&q->lock);
   q->count++;
+  if ((gcreq = q->cached) != NULL)
+  {
+    q->cached = gcreq->next;
+    q->ncached--;
+  }
   ddsrt_mutex_unlock (&q->lock);
+  if (gcreq == NULL)
+    gcreq = ddsrt_malloc (offsetof (struct gcreq, vtimes) + thread_states.nthreads * sizeof (*gcreq->vtimes));
+  gcreq->cb = cb;
+  gcreq->queue = q;
+  threads_vtime_gather_for_wait (&gcreq->nvtimes, gcreq->vtimes);
   return gcreq;
 }
 
@@ -243,6 +262,13 @@ void gcreq_free (struct gcreq *gcreq)
   --gcreq_queue->count;
   if (gcreq_queue->count <= 1)
     ddsrt_cond_broadcast (&gcreq_queue->cond);
+  if (gcreq_queue->ncached < MAX_CACHED_GCREQS)
+  {
+    gcreq->next = gcreq_queue->cached;
+    gcreq_queue->cached = gcreq;
+    gcreq_queue->ncached++;
+    gcreq = NULL;
+  }
   ddsrt_mutex_unlock (&gcreq_queue->lock);
   ddsrt_free (gcreq);
 }
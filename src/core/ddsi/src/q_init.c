@@ -71,6 +71,39 @@ static void add_peer_addresses (struct addrset *as, const struct config_peer_lis
   }
 }
 
+static bool use_reuseport_uc_recv_threads (void)
+{
+  /* Multiple threads receiving unicast data, each with its own socket bound
+     to the data port, requires SO_REUSEPORT and hence UDP; and it only makes
+     sense if there is a single unicast data socket */
+  return (config.multiple_recv_threads && config.multiple_recv_threads_uc > 1 &&
+          config.many_sockets_mode == MSM_SINGLE_UNICAST &&
+          (config.transport_selector == TRANS_UDP || config.transport_selector == TRANS_UDP6));
+}
+
+static ddsi_tran_conn_t make_data_conn_uc (uint32_t port)
+{
+  ddsi_tran_qos_t qos;
+  ddsi_tran_conn_t conn;
+  if (!use_reuseport_uc_recv_threads ())
+    return ddsi_factory_create_conn (gv.m_factory, port, NULL);
+  if (port == 0)
+  {
+    /* The kernel may hand out a port already in use by another socket with
+       SO_REUSEPORT set (e.g., of another process), so first have it pick a
+       port for a socket without that option */
+    if ((conn = ddsi_factory_create_conn (gv.m_factory, 0, NULL)) == NULL)
+      return NULL;
+    port = ddsi_conn_port (conn);
+    ddsi_conn_free (conn);
+  }
+  qos = ddsi_tran_create_qos ();
+  qos->m_reuseport = true;
+  conn = ddsi_factory_create_conn (gv.m_factory, port, qos);
+  ddsi_tran_free_qos (qos);
+  return conn;
+}
+
 static int make_uc_sockets (uint32_t * pdisc, uint32_t * pdata, int ppid)
 {
   if (config.many_sockets_mode == MSM_NO_UNICAST)
@@ -107,9 +140,9 @@ static int make_uc_sockets (uint32_t * pdisc, uint32_t * pdata, int ppid)
   {
     /* Check not configured to use same unicast port for data and discovery */
 
-    if (*pdata != 0 && (*pdata != *pdisc))
+    if ((*pdata != 0 && (*pdata != *pdisc)) || (*pdata == 0 && use_reuseport_uc_recv_threads ()))
     {
-      gv.data_conn_uc = ddsi_factory_create_conn (gv.m_factory, *pdata, NULL);
+      gv.data_conn_uc = make_data_conn_uc (*pdata);
     }
     else
     {
@@ -577,9 +610,9 @@ int rtps_config_prep (struct cfgst *cfgst)
 #define USER_MAX_THREADS 50
 
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
-    const unsigned max_threads = 9 + USER_MAX_THREADS + num_channel_threads + config.ddsi2direct_max_threads;
+    const unsigned max_threads = 9 + USER_MAX_THREADS + num_channel_threads + config.ddsi2direct_max_threads + (unsigned) (config.builtins_dqueues - 1);
 #else
-    const unsigned max_threads = 11 + USER_MAX_THREADS + config.ddsi2direct_max_threads;
+    const unsigned max_threads = 11 + USER_MAX_THREADS + config.ddsi2direct_max_threads + (unsigned) (config.builtins_dqueues - 1);
 #endif
     thread_states_init (max_threads);
   }
@@ -763,6 +796,49 @@ static void free_special_topics (void)
   ddsi_sertopic_unref (gv.rawcdr_topic);
 }
 
+static void add_extra_uc_recv_threads (void)
+{
+  /* Additional unicast receive threads each get a socket bound to the data
+     port of their own.  Dedicated receive threads can only be woken up by
+     sending a packet to them, and it is the steering program that makes it
+     possible to address an individual socket in the group, so without it
+     the additional sockets are of no use. */
+  const uint32_t port = ddsi_conn_port (gv.data_conn_uc);
+  ddsi_tran_qos_t qos = ddsi_tran_create_qos ();
+  unsigned i;
+  qos->m_reuseport = true;
+  while (gv.n_data_conn_uc_extra + 1 < (unsigned) config.multiple_recv_threads_uc)
+  {
+    ddsi_tran_conn_t conn;
+    if ((conn = ddsi_factory_create_conn (gv.m_factory, port, qos)) == NULL)
+      break;
+    gv.data_conn_uc_extra[gv.n_data_conn_uc_extra++] = conn;
+  }
+  ddsi_tran_free_qos (qos);
+  if (gv.n_data_conn_uc_extra + 1 < (unsigned) config.multiple_recv_threads_uc)
+  {
+    DDS_WARNING("rtps_init: could create only %u of %d unicast receive sockets\n", gv.n_data_conn_uc_extra + 1, config.multiple_recv_threads_uc);
+  }
+  if (gv.n_data_conn_uc_extra > 0 && ddsi_udp_conn_steer_by_guidprefix (gv.data_conn_uc, gv.n_data_conn_uc_extra + 1) < 0)
+  {
+    DDS_WARNING("rtps_init: no packet steering for unicast receive sockets, using a single unicast receive thread\n");
+    for (i = 0; i < gv.n_data_conn_uc_extra; i++)
+      ddsi_conn_free (gv.data_conn_uc_extra[i]);
+    gv.n_data_conn_uc_extra = 0;
+  }
+  for (i = 0; i < gv.n_data_conn_uc_extra; i++)
+  {
+    struct recv_thread * const rt = &gv.recv_threads[gv.n_recv_threads];
+    (void) snprintf (rt->name, sizeof (rt->name), "recvUC%u", i + 1);
+    rt->arg.mode = RTM_SINGLE;
+    rt->arg.u.single.conn = gv.data_conn_uc_extra[i];
+    rt->arg.u.single.loc = &gv.loc_default_uc;
+    rt->arg.u.single.trigger = (unsigned char) (i + 1);
+    ddsi_conn_disable_multiplexing (gv.data_conn_uc_extra[i]);
+    gv.n_recv_threads++;
+  }
+}
+
 static int setup_and_start_recv_threads (void)
 {
   unsigned i;
@@ -773,18 +849,20 @@ static int setup_and_start_recv_threads (void)
     gv.recv_threads[i].arg.rbpool = NULL;
     gv.recv_threads[i].arg.u.single.loc = NULL;
     gv.recv_threads[i].arg.u.single.conn = NULL;
+    gv.recv_threads[i].arg.u.single.trigger = 0;
   }
+  gv.n_data_conn_uc_extra = 0;
 
   /* First thread always uses a waitset and gobbles up all sockets not handled by dedicated threads - FIXME: MSM_NO_UNICAST mode with UDP probably doesn't even need this one to use a waitset */
   gv.n_recv_threads = 1;
-  gv.recv_threads[0].name = "recv";
+  (void) snprintf (gv.recv_threads[0].name, sizeof (gv.recv_threads[0].name), "recv");
   gv.recv_threads[0].arg.mode = RTM_MANY;
   if (gv.m_factory->m_connless && config.many_sockets_mode != MSM_NO_UNICAST && config.multiple_recv_threads)
   {
     if (ddsi_is_mcaddr (&gv.loc_default_mc) && !ddsi_is_ssm_mcaddr (&gv.loc_default_mc) && (config.allowMulticast & AMC_ASM))
     {
       /* Multicast enabled, but it isn't an SSM address => handle data multicasts on a separate thread (the trouble with SSM addresses is that we only join matching writers, which our own sockets typically would not be) */
-      gv.recv_threads[gv.n_recv_threads].name = "recvMC";
+      (void) snprintf (gv.recv_threads[gv.n_recv_threads].name, sizeof (gv.recv_threads[gv.n_recv_threads].name), "recvMC");
       gv.recv_threads[gv.n_recv_threads].arg.mode = RTM_SINGLE;
       gv.recv_threads[gv.n_recv_threads].arg.u.single.conn = gv.data_conn_mc;
       gv.recv_threads[gv.n_recv_threads].arg.u.single.loc = &gv.loc_default_mc;
@@ -794,12 +872,14 @@ static int setup_and_start_recv_threads (void)
     if (config.many_sockets_mode == MSM_SINGLE_UNICAST)
     {
       /* No per-participant sockets => handle data unicasts on a separate thread as well */
-      gv.recv_threads[gv.n_recv_threads].name = "recvUC";
+      (void) snprintf (gv.recv_threads[gv.n_recv_threads].name, sizeof (gv.recv_threads[gv.n_recv_threads].name), "recvUC");
       gv.recv_threads[gv.n_recv_threads].arg.mode = RTM_SINGLE;
       gv.recv_threads[gv.n_recv_threads].arg.u.single.conn = gv.data_conn_uc;
       gv.recv_threads[gv.n_recv_threads].arg.u.single.loc = &gv.loc_default_uc;
       ddsi_conn_disable_multiplexing (gv.data_conn_uc);
       gv.n_recv_threads++;
+      if (gv.data_conn_uc != gv.disc_conn_uc && use_reuseport_uc_recv_threads ())
+        add_extra_uc_recv_threads ();
     }
   }
   assert (gv.n_recv_threads <= MAX_RECV_THREADS);
@@ -1025,6 +1105,8 @@ int rtps_init (void)
   gv.next_ppguid.prefix.u[1] = (unsigned) ddsrt_getpid ();
   gv.next_ppguid.prefix.u[2] = 1;
   gv.next_ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  if (config.static_local_prefix.u[0] || config.static_local_prefix.u[1] || config.static_local_prefix.u[2])
+    gv.next_ppguid.prefix = config.static_local_prefix;
 
   ddsrt_mutex_init (&gv.lock);
   ddsrt_mutex_init (&gv.spdp_lock);
@@ -1078,15 +1160,11 @@ int rtps_init (void)
 
   if (config.pcap_file && *config.pcap_file)
   {
-    gv.pcap_fp = new_pcap_file (config.pcap_file);
-    if (gv.pcap_fp)
-    {
-      ddsrt_mutex_init (&gv.pcap_lock);
-    }
+    gv.pcap = new_pcap_writer (config.pcap_file);
   }
   else
   {
-    gv.pcap_fp = NULL;
+    gv.pcap = NULL;
   }
 
   gv.mship = new_group_membership();
@@ -1261,7 +1339,16 @@ int rtps_init (void)
     nn_xpack_sendq_start();
   }
 
-  gv.builtins_dqueue = nn_dqueue_new ("builtins", config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL);
+  for (unsigned i = 0; i < N_BUILTINS_PP_LOCKS; i++)
+    ddsrt_mutex_init (&gv.builtins_pp_locks[i]);
+  gv.n_builtins_dqueues = (unsigned) config.builtins_dqueues;
+  gv.builtins_dqueues[0] = nn_dqueue_new ("builtins", config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL);
+  for (unsigned i = 1; i < gv.n_builtins_dqueues; i++)
+  {
+    char name[32];
+    snprintf (name, sizeof (name), "builtins.%u", i);
+    gv.builtins_dqueues[i] = nn_dqueue_new (name, config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL);
+  }
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
   for (struct config_channel_listelem *chptr = config.channels; chptr; chptr = chptr->next)
     chptr->dqueue = nn_dqueue_new (chptr->name, config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
@@ -1276,8 +1363,8 @@ err_mc_conn:
     ddsi_conn_free (gv.disc_conn_mc);
   if (gv.data_conn_mc && gv.data_conn_mc != gv.disc_conn_mc)
     ddsi_conn_free (gv.data_conn_mc);
-  if (gv.pcap_fp)
-    ddsrt_mutex_destroy (&gv.pcap_lock);
+  if (gv.pcap)
+    free_pcap_writer (gv.pcap);
   if (gv.disc_conn_uc != gv.disc_conn_mc)
     ddsi_conn_free (gv.disc_conn_uc);
   if (gv.data_conn_uc != gv.disc_conn_uc)
@@ -1369,6 +1456,10 @@ int rtps_start (void)
   }
 #endif
 
+  /* Statically configured proxies must exist before the first packet from
+     them is processed */
+  create_static_proxies ();
+
   if (setup_and_start_recv_threads () < 0)
   {
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
@@ -1391,14 +1482,14 @@ int rtps_start (void)
 struct dq_builtins_ready_arg {
   ddsrt_mutex_t lock;
   ddsrt_cond_t cond;
-  int ready;
+  unsigned ready;
 };
 
 static void builtins_dqueue_ready_cb (void *varg)
 {
   struct dq_builtins_ready_arg *arg = varg;
   ddsrt_mutex_lock (&arg->lock);
-  arg->ready = 1;
+  arg->ready++;
   ddsrt_cond_broadcast (&arg->cond);
   ddsrt_mutex_unlock (&arg->lock);
 }
@@ -1437,7 +1528,7 @@ void rtps_stop (void)
   }
 #endif /* DDSI_INCLUDE_NETWORK_CHANNELS */
 
-  /* Send a bubble through the delivery queue for built-ins, so that any
+  /* Send a bubble through the delivery queues for built-ins, so that any
      pending proxy participant discovery is finished before we start
      deleting them */
   {
@@ -1445,9 +1536,10 @@ void rtps_stop (void)
     ddsrt_mutex_init (&arg.lock);
     ddsrt_cond_init (&arg.cond);
     arg.ready = 0;
-    nn_dqueue_enqueue_callback(gv.builtins_dqueue, builtins_dqueue_ready_cb, &arg);
+    for (unsigned i = 0; i < gv.n_builtins_dqueues; i++)
+      nn_dqueue_enqueue_callback(gv.builtins_dqueues[i], builtins_dqueue_ready_cb, &arg);
     ddsrt_mutex_lock (&arg.lock);
-    while (!arg.ready)
+    while (arg.ready < gv.n_builtins_dqueues)
       ddsrt_cond_wait (&arg.cond, &arg.lock);
     ddsrt_mutex_unlock (&arg.lock);
     ddsrt_cond_destroy (&arg.cond);
@@ -1544,11 +1636,15 @@ void rtps_fini (void)
 {
   /* Shut down the GC system -- no new requests will be added */
   gcreq_queue_free (gv.gcreq_queue);
+  gv.gcreq_queue = NULL;
 
   /* No new data gets added to any admin, all synchronous processing
      has ended, so now we can drain the delivery queues to end up with
      the expected reference counts all over the radmin thingummies. */
-  nn_dqueue_free (gv.builtins_dqueue);
+  for (unsigned i = 0; i < gv.n_builtins_dqueues; i++)
+    nn_dqueue_free (gv.builtins_dqueues[i]);
+  for (unsigned i = 0; i < N_BUILTINS_PP_LOCKS; i++)
+    ddsrt_mutex_destroy (&gv.builtins_pp_locks[i]);
 
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
   chptr = config.channels;
@@ -1596,16 +1692,18 @@ void rtps_fini (void)
     ddsi_conn_free (gv.disc_conn_uc);
   if (gv.data_conn_uc != gv.disc_conn_uc)
     ddsi_conn_free (gv.data_conn_uc);
+  for (unsigned i = 0; i < gv.n_data_conn_uc_extra; i++)
+    ddsi_conn_free (gv.data_conn_uc_extra[i]);
+  gv.n_data_conn_uc_extra = 0;
 
   /* Not freeing gv.tev_conn: it aliases data_conn_uc */
 
   free_group_membership(gv.mship);
   ddsi_tran_factories_fini ();
 
-  if (gv.pcap_fp)
+  if (gv.pcap)
   {
-    ddsrt_mutex_destroy (&gv.pcap_lock);
-    fclose (gv.pcap_fp);
+    free_pcap_writer (gv.pcap);
   }
 
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
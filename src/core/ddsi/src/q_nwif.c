@@ -200,6 +200,25 @@ static int set_reuse_options (ddsrt_socket_t socket)
   return 0;
 }
 
+static int set_reuseport_option (ddsrt_socket_t socket)
+{
+  /* Set REUSEPORT so that multiple unicast sockets can be bound to
+     the same port and be served by different receive threads */
+#ifdef SO_REUSEPORT
+  int one = 1;
+  if (ddsrt_setsockopt (socket, SOL_SOCKET, SO_REUSEPORT, (char *) &one, sizeof (one)) != DDS_RETCODE_OK)
+  {
+    print_sockerror ("SO_REUSEPORT");
+    return -2;
+  }
+  return 0;
+#else
+  (void) socket;
+  DDS_ERROR("SO_REUSEPORT: not supported on this platform\n");
+  return -2;
+#endif
+}
+
 static int bind_socket (ddsrt_socket_t socket, unsigned short port)
 {
   dds_retcode_t rc = DDS_RETCODE_ERROR;
@@ -329,7 +348,8 @@ int make_socket
   ddsrt_socket_t * sock,
   unsigned short port,
   bool stream,
-  bool reuse
+  bool reuse,
+  bool reuseport
 )
 {
   int rc = -2;
@@ -362,6 +382,11 @@ int make_socket
     goto fail;
   }
 
+  if (reuseport && ((rc = set_reuseport_option (*sock)) < 0))
+  {
+    goto fail;
+  }
+
   if
   (
     (rc = set_rcvbuf (*sock) < 0) ||
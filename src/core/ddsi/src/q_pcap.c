@@ -10,14 +10,20 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "dds/ddsrt/endian.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/string.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_time.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_globals.h"
 #include "dds/ddsi/q_bswap.h"
+#include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_pcap.h"
 
 /* pcap format info taken from http://wiki.wireshark.org/Development/LibpcapFileFormat */
@@ -77,8 +83,54 @@ static const ipv4_hdr_t ipv4_hdr_template = {
 #define IPV4_HDR_SIZE 20
 #define UDP_HDR_SIZE 8
 
+/* Capturing a packet only copies it into a ring owned by the calling thread
+   (one per thread slot, single producer/single consumer, so no locking);
+   the "pcap" thread drains the rings into the file using large buffered
+   writes.  Each record in a ring is a uint32_t length followed by exactly
+   the bytes that go into the file, padded to a multiple of 4 bytes.  A
+   length of PCAP_RING_WRAP means the remainder of the ring is unused and
+   the next record starts at the beginning.  Positions are free-running
+   counters. */
+#define PCAP_RING_ALIGN(x) (((x) + 3u) & ~(uint32_t) 3u)
+#define PCAP_RING_WRAP UINT32_MAX
+#define PCAP_RING_MINSIZE 65536u
+#define PCAP_IOBUF_SIZE 1048576u
+#define PCAP_IDLE_SLEEP DDS_MSECS (10)
+#define PCAP_DROP_REPORT_INTERVAL DDS_SECS (1)
+
+struct pcap_ring {
+  ddsrt_atomic_uint32_t wrpos;   /* written by producer only */
+  ddsrt_atomic_uint32_t rdpos;   /* written by pcap thread only */
+  ddsrt_atomic_uint32_t dropped; /* packets discarded because the ring was full */
+  uint32_t size;                 /* power of 2 */
+  unsigned char *buf;
+};
+
+struct pcap_writer {
+  char *name;
+  FILE *fp;
+  char *iobuf;
+  uint32_t snaplen;
+  uint32_t ringsize;
+  uint64_t filesize;
+  uint64_t maxfilesize;          /* 0: no rotation */
+  uint32_t nrotated;
+  uint32_t nrings;
+  ddsrt_atomic_voidp_t *rings;   /* [nrings], indexed by thread slot */
+  ddsrt_atomic_uint32_t terminate;
+  uint32_t dropped_reported;
+  nn_mtime_t tlast_drop_report;
+  struct thread_state1 *ts;
+};
+
+typedef struct pcap_pkt_hdr_s {
+  pcaprec_hdr_t rec;
+  ipv4_hdr_t ipv4;
+  udp_hdr_t udp;
+} pcap_pkt_hdr_t;
+
 DDSRT_WARNING_MSVC_OFF(4996);
-FILE *new_pcap_file (const char *name)
+static FILE *new_pcap_file (const char *name, uint32_t snaplen, char *iobuf)
 {
   FILE *fp;
   pcap_hdr_t hdr;
@@ -88,33 +140,251 @@ FILE *new_pcap_file (const char *name)
     DDS_WARNING ("packet capture disabled: file %s could not be opened for writing\n", name);
     return NULL;
   }
+  setvbuf (fp, iobuf, _IOFBF, PCAP_IOBUF_SIZE);
 
   hdr.magic_number = 0xa1b2c3d4;
   hdr.version_major = 2;
   hdr.version_minor = 4;
   hdr.thiszone = 0;
   hdr.sigfigs = 0;
-  hdr.snaplen = 65535;
+  hdr.snaplen = snaplen;
   hdr.network = LINKTYPE_RAW;
   fwrite (&hdr, sizeof (hdr), 1, fp);
 
   return fp;
 }
+
+static int rotate_pcap_file (struct pcap_writer *pw)
+{
+  char *oldname;
+  fclose (pw->fp);
+  ddsrt_asprintf (&oldname, "%s.%"PRIu32, pw->name, ++pw->nrotated);
+  if (rename (pw->name, oldname) != 0)
+    DDS_WARNING ("packet capture: could not rename %s to %s\n", pw->name, oldname);
+  ddsrt_free (oldname);
+  pw->filesize = sizeof (pcap_hdr_t);
+  return (pw->fp = new_pcap_file (pw->name, pw->snaplen, pw->iobuf)) != NULL;
+}
 DDSRT_WARNING_MSVC_ON(4996);
 
-static void write_data (FILE *fp, const ddsrt_msghdr_t *msghdr, size_t sz)
+static struct pcap_ring *new_pcap_ring (uint32_t size)
+{
+  struct pcap_ring *r = ddsrt_malloc (sizeof (*r));
+  ddsrt_atomic_st32 (&r->wrpos, 0);
+  ddsrt_atomic_st32 (&r->rdpos, 0);
+  ddsrt_atomic_st32 (&r->dropped, 0);
+  r->size = size;
+  r->buf = ddsrt_malloc (size);
+  return r;
+}
+
+static void free_pcap_ring (struct pcap_ring *r)
+{
+  ddsrt_free (r->buf);
+  ddsrt_free (r);
+}
+
+static struct pcap_ring *get_pcap_ring (struct pcap_writer *pw)
 {
-  size_t i, n = 0;
-  for (i = 0; i < (size_t) msghdr->msg_iovlen && n < sz; i++)
+  /* A thread slot is used by one thread at a time, so the ring is only ever
+     created and written by the thread that owns the slot */
+  const uint32_t idx = (uint32_t) (lookup_thread_state () - thread_states.ts);
+  struct pcap_ring *r;
+  assert (idx < pw->nrings);
+  if ((r = ddsrt_atomic_ldvoidp (&pw->rings[idx])) == NULL)
   {
-    size_t m1 = msghdr->msg_iov[i].iov_len;
-    size_t m = (n + m1 <= sz) ? m1 : sz - n;
-    fwrite (msghdr->msg_iov[i].iov_base, m, 1, fp);
+    r = new_pcap_ring (pw->ringsize);
+    ddsrt_atomic_fence_rel ();
+    ddsrt_atomic_stvoidp (&pw->rings[idx], r);
+  }
+  return r;
+}
+
+static void pcap_ring_put (struct pcap_writer *pw, const pcap_pkt_hdr_t *hdr, const ddsrt_iovec_t *iov, size_t niov)
+{
+  struct pcap_ring * const r = get_pcap_ring (pw);
+  const uint32_t len = (uint32_t) sizeof (hdr->rec) + hdr->rec.incl_len;
+  const uint32_t need = PCAP_RING_ALIGN ((uint32_t) sizeof (uint32_t) + len);
+  uint32_t wrpos = ddsrt_atomic_ld32 (&r->wrpos);
+  const uint32_t rdpos = ddsrt_atomic_ld32 (&r->rdpos);
+  uint32_t off = wrpos & (r->size - 1);
+  const uint32_t pad = (need > r->size - off) ? r->size - off : 0;
+  unsigned char *p;
+  size_t i, n, datasz;
+
+  ddsrt_atomic_fence_acq ();
+  if (need + pad > r->size - (wrpos - rdpos))
+  {
+    ddsrt_atomic_inc32 (&r->dropped);
+    return;
+  }
+  if (pad)
+  {
+    memcpy (r->buf + off, &(uint32_t){ PCAP_RING_WRAP }, sizeof (uint32_t));
+    wrpos += pad;
+    off = 0;
+  }
+
+  p = r->buf + off;
+  memcpy (p, &len, sizeof (len));
+  p += sizeof (len);
+  memcpy (p, &hdr->rec, sizeof (hdr->rec));
+  p += sizeof (hdr->rec);
+  memcpy (p, &hdr->ipv4, IPV4_HDR_SIZE);
+  p += IPV4_HDR_SIZE;
+  memcpy (p, &hdr->udp, UDP_HDR_SIZE);
+  p += UDP_HDR_SIZE;
+  datasz = hdr->rec.incl_len - (IPV4_HDR_SIZE + UDP_HDR_SIZE);
+  for (i = 0, n = 0; i < niov && n < datasz; i++)
+  {
+    size_t m1 = iov[i].iov_len;
+    size_t m = (n + m1 <= datasz) ? m1 : datasz - n;
+    memcpy (p + n, iov[i].iov_base, m);
     n += m;
   }
-  assert (n == sz);
+  assert (n == datasz);
+
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&r->wrpos, wrpos + need);
+}
+
+static uint32_t pcap_ring_drain (struct pcap_writer *pw, struct pcap_ring *r)
+{
+  uint32_t rdpos = ddsrt_atomic_ld32 (&r->rdpos);
+  const uint32_t wrpos = ddsrt_atomic_ld32 (&r->wrpos);
+  uint32_t count = 0;
+  ddsrt_atomic_fence_acq ();
+  while (rdpos != wrpos)
+  {
+    const uint32_t off = rdpos & (r->size - 1);
+    uint32_t len;
+    memcpy (&len, r->buf + off, sizeof (len));
+    if (len == PCAP_RING_WRAP)
+    {
+      rdpos += r->size - off;
+      continue;
+    }
+    if (pw->fp && pw->maxfilesize > 0 && pw->filesize + len > pw->maxfilesize && pw->filesize > sizeof (pcap_hdr_t))
+      (void) rotate_pcap_file (pw);
+    if (pw->fp)
+    {
+      fwrite (r->buf + off + sizeof (len), len, 1, pw->fp);
+      pw->filesize += len;
+    }
+    rdpos += PCAP_RING_ALIGN ((uint32_t) sizeof (len) + len);
+    count++;
+  }
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&r->rdpos, rdpos);
+  return count;
+}
+
+static uint32_t pcap_writer_drain (struct pcap_writer *pw)
+{
+  uint32_t count = 0, dropped = 0;
+  for (uint32_t i = 0; i < pw->nrings; i++)
+  {
+    struct pcap_ring *r;
+    if ((r = ddsrt_atomic_ldvoidp (&pw->rings[i])) != NULL)
+    {
+      ddsrt_atomic_fence_acq ();
+      count += pcap_ring_drain (pw, r);
+      dropped += ddsrt_atomic_ld32 (&r->dropped);
+    }
+  }
+  if (dropped != pw->dropped_reported)
+  {
+    nn_mtime_t tnow = now_mt ();
+    if (tnow.v >= pw->tlast_drop_report.v + PCAP_DROP_REPORT_INTERVAL)
+    {
+      DDS_WARNING ("packet capture: %"PRIu32" packets dropped because capture could not keep up\n", dropped - pw->dropped_reported);
+      pw->dropped_reported = dropped;
+      pw->tlast_drop_report = tnow;
+    }
+  }
+  return count;
+}
+
+static uint32_t pcap_writer_thread (struct pcap_writer *pw)
+{
+  while (!ddsrt_atomic_ld32 (&pw->terminate))
+  {
+    if (pcap_writer_drain (pw) == 0)
+    {
+      if (pw->fp)
+        fflush (pw->fp);
+      dds_sleepfor (PCAP_IDLE_SLEEP);
+    }
+  }
+  return 0;
+}
+
+struct pcap_writer *new_pcap_writer (const char *name)
+{
+  struct pcap_writer *pw = ddsrt_malloc (sizeof (*pw));
+  uint32_t maxrec;
+
+  /* the IP and UDP headers always fit */
+  pw->snaplen = (config.pcap_snaplen < IPV4_HDR_SIZE + UDP_HDR_SIZE) ? IPV4_HDR_SIZE + UDP_HDR_SIZE : config.pcap_snaplen;
+  if (pw->snaplen > IPV4_HDR_SIZE + UDP_HDR_SIZE + 65535)
+    pw->snaplen = IPV4_HDR_SIZE + UDP_HDR_SIZE + 65535;
+  maxrec = PCAP_RING_ALIGN ((uint32_t) (sizeof (uint32_t) + sizeof (pcaprec_hdr_t)) + pw->snaplen);
+  pw->ringsize = PCAP_RING_MINSIZE;
+  while (pw->ringsize < config.pcap_ringsize || pw->ringsize < 2 * maxrec)
+    pw->ringsize *= 2;
+  pw->maxfilesize = config.pcap_filesize;
+  pw->nrotated = 0;
+
+  pw->name = ddsrt_strdup (name);
+  pw->iobuf = ddsrt_malloc (PCAP_IOBUF_SIZE);
+  if ((pw->fp = new_pcap_file (pw->name, pw->snaplen, pw->iobuf)) == NULL)
+  {
+    ddsrt_free (pw->iobuf);
+    ddsrt_free (pw->name);
+    ddsrt_free (pw);
+    return NULL;
+  }
+  pw->filesize = sizeof (pcap_hdr_t);
+
+  pw->nrings = thread_states.nthreads;
+  pw->rings = ddsrt_malloc (pw->nrings * sizeof (*pw->rings));
+  for (uint32_t i = 0; i < pw->nrings; i++)
+    ddsrt_atomic_stvoidp (&pw->rings[i], NULL);
+  ddsrt_atomic_st32 (&pw->terminate, 0);
+  pw->dropped_reported = 0;
+  pw->tlast_drop_report.v = 0;
+  if (create_thread (&pw->ts, "pcap", (uint32_t (*) (void *)) pcap_writer_thread, pw) != DDS_RETCODE_OK)
+  {
+    fclose (pw->fp);
+    ddsrt_free (pw->rings);
+    ddsrt_free (pw->iobuf);
+    ddsrt_free (pw->name);
+    ddsrt_free (pw);
+    return NULL;
+  }
+  return pw;
 }
 
+void free_pcap_writer (struct pcap_writer *pw)
+{
+  ddsrt_atomic_st32 (&pw->terminate, 1);
+  join_thread (pw->ts);
+  /* writes all remaining packets and reports remaining drops */
+  pw->tlast_drop_report.v = 0;
+  (void) pcap_writer_drain (pw);
+  for (uint32_t i = 0; i < pw->nrings; i++)
+  {
+    struct pcap_ring *r;
+    if ((r = ddsrt_atomic_ldvoidp (&pw->rings[i])) != NULL)
+      free_pcap_ring (r);
+  }
+  if (pw->fp)
+    fclose (pw->fp);
+  ddsrt_free (pw->rings);
+  ddsrt_free (pw->iobuf);
+  ddsrt_free (pw->name);
+  ddsrt_free (pw);
+}
 static uint16_t calc_ipv4_checksum (const uint16_t *x)
 {
   uint32_t s = 0;
@@ -127,9 +397,33 @@ static uint16_t calc_ipv4_checksum (const uint16_t *x)
   return (uint16_t) ~s;
 }
 
+static void fill_pcap_pkt_hdr (pcap_pkt_hdr_t *hdr, uint32_t snaplen, nn_wctime_t tstamp, unsigned char ttl, const struct sockaddr_in *src, const struct sockaddr_in *dst, size_t sz)
+{
+  union {
+    ipv4_hdr_t ipv4_hdr;
+    uint16_t x[10];
+  } u;
+  size_t sz_ud = sz + UDP_HDR_SIZE;
+  size_t sz_iud = sz_ud + IPV4_HDR_SIZE;
+  wctime_to_sec_usec (&hdr->rec.ts_sec, &hdr->rec.ts_usec, tstamp);
+  hdr->rec.orig_len = (uint32_t) sz_iud;
+  hdr->rec.incl_len = (sz_iud <= snaplen) ? (uint32_t) sz_iud : snaplen;
+  u.ipv4_hdr = ipv4_hdr_template;
+  u.ipv4_hdr.totallength = toBE2u ((unsigned short) sz_iud);
+  u.ipv4_hdr.ttl = ttl;
+  u.ipv4_hdr.srcip = src->sin_addr.s_addr;
+  u.ipv4_hdr.dstip = dst->sin_addr.s_addr;
+  u.ipv4_hdr.checksum = calc_ipv4_checksum (u.x);
+  hdr->ipv4 = u.ipv4_hdr;
+  hdr->udp.srcport = src->sin_port;
+  hdr->udp.dstport = dst->sin_port;
+  hdr->udp.length = toBE2u ((unsigned short) sz_ud);
+  hdr->udp.checksum = 0; /* don't have to compute a checksum for UDPv4 */
+}
+
 void write_pcap_received
 (
-  FILE * fp,
+  struct pcap_writer * pw,
   nn_wctime_t tstamp,
   const struct sockaddr_storage * src,
   const struct sockaddr_storage * dst,
@@ -139,38 +433,18 @@ void write_pcap_received
 {
   if (config.transport_selector == TRANS_UDP)
   {
-    pcaprec_hdr_t pcap_hdr;
-    union {
-      ipv4_hdr_t ipv4_hdr;
-      uint16_t x[10];
-    } u;
-    udp_hdr_t udp_hdr;
-    size_t sz_ud = sz + UDP_HDR_SIZE;
-    size_t sz_iud = sz_ud + IPV4_HDR_SIZE;
-    ddsrt_mutex_lock (&gv.pcap_lock);
-    wctime_to_sec_usec (&pcap_hdr.ts_sec, &pcap_hdr.ts_usec, tstamp);
-    pcap_hdr.incl_len = pcap_hdr.orig_len = (uint32_t) sz_iud;
-    fwrite (&pcap_hdr, sizeof (pcap_hdr), 1, fp);
-    u.ipv4_hdr = ipv4_hdr_template;
-    u.ipv4_hdr.totallength = toBE2u ((unsigned short) sz_iud);
-    u.ipv4_hdr.ttl = 128;
-    u.ipv4_hdr.srcip = ((struct sockaddr_in*) src)->sin_addr.s_addr;
-    u.ipv4_hdr.dstip = ((struct sockaddr_in*) dst)->sin_addr.s_addr;
-    u.ipv4_hdr.checksum = calc_ipv4_checksum (u.x);
-    fwrite (&u.ipv4_hdr, sizeof (u.ipv4_hdr), 1, fp);
-    udp_hdr.srcport = ((struct sockaddr_in*) src)->sin_port;
-    udp_hdr.dstport = ((struct sockaddr_in*) dst)->sin_port;
-    udp_hdr.length = toBE2u ((unsigned short) sz_ud);
-    udp_hdr.checksum = 0; /* don't have to compute a checksum for UDPv4 */
-    fwrite (&udp_hdr, sizeof (udp_hdr), 1, fp);
-    fwrite (buf, sz, 1, fp);
-    ddsrt_mutex_unlock (&gv.pcap_lock);
+    pcap_pkt_hdr_t hdr;
+    ddsrt_iovec_t iov;
+    fill_pcap_pkt_hdr (&hdr, pw->snaplen, tstamp, 128, (const struct sockaddr_in *) src, (const struct sockaddr_in *) dst, sz);
+    iov.iov_base = buf;
+    iov.iov_len = (ddsrt_iov_len_t) sz;
+    pcap_ring_put (pw, &hdr, &iov, 1);
   }
 }
 
 void write_pcap_sent
 (
-  FILE * fp,
+  struct pcap_writer * pw,
   nn_wctime_t tstamp,
   const struct sockaddr_storage * src,
   const ddsrt_msghdr_t * hdr,
@@ -179,31 +453,8 @@ void write_pcap_sent
 {
   if (config.transport_selector == TRANS_UDP)
   {
-    pcaprec_hdr_t pcap_hdr;
-    union {
-      ipv4_hdr_t ipv4_hdr;
-      uint16_t x[10];
-    } u;
-    udp_hdr_t udp_hdr;
-    size_t sz_ud = sz + UDP_HDR_SIZE;
-    size_t sz_iud = sz_ud + IPV4_HDR_SIZE;
-    ddsrt_mutex_lock (&gv.pcap_lock);
-    wctime_to_sec_usec (&pcap_hdr.ts_sec, &pcap_hdr.ts_usec, tstamp);
-    pcap_hdr.incl_len = pcap_hdr.orig_len = (uint32_t) sz_iud;
-    fwrite (&pcap_hdr, sizeof (pcap_hdr), 1, fp);
-    u.ipv4_hdr = ipv4_hdr_template;
-    u.ipv4_hdr.totallength = toBE2u ((unsigned short) sz_iud);
-    u.ipv4_hdr.ttl = 255;
-    u.ipv4_hdr.srcip = ((struct sockaddr_in*) src)->sin_addr.s_addr;
-    u.ipv4_hdr.dstip = ((struct sockaddr_in*) hdr->msg_name)->sin_addr.s_addr;
-    u.ipv4_hdr.checksum = calc_ipv4_checksum (u.x);
-    fwrite (&u.ipv4_hdr, sizeof (u.ipv4_hdr), 1, fp);
-    udp_hdr.srcport = ((struct sockaddr_in*) src)->sin_port;
-    udp_hdr.dstport = ((struct sockaddr_in*) hdr->msg_name)->sin_port;
-    udp_hdr.length = toBE2u ((unsigned short) sz_ud);
-    udp_hdr.checksum = 0; /* don't have to compute a checksum for UDPv4 */
-    fwrite (&udp_hdr, sizeof (udp_hdr), 1, fp);
-    write_data (fp, hdr, sz);
-    ddsrt_mutex_unlock (&gv.pcap_lock);
+    pcap_pkt_hdr_t pkthdr;
+    fill_pcap_pkt_hdr (&pkthdr, pw->snaplen, tstamp, 255, (const struct sockaddr_in *) src, (const struct sockaddr_in *) hdr->msg_name, sz);
+    pcap_ring_put (pw, &pkthdr, hdr->msg_iov, (size_t) hdr->msg_iovlen);
   }
 }
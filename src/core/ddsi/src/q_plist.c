@@ -390,6 +390,78 @@ static void unalias_eotinfo (nn_prismtech_eotinfo_t *txnid, UNUSED_ARG (int bswa
   }
 }
 
+static int do_content_filter_property (nn_content_filter_property_t *q, uint64_t *present, uint64_t *aliased, uint64_t wanted, uint64_t fl, const struct dd *dd)
+{
+  /* four strings followed by a sequence of strings, all aliasing the
+     message (except for the array of pointers in the sequence) */
+  char ** const strs[] = {
+    &q->content_filtered_topic_name, &q->related_topic_name, &q->filter_class_name, &q->filter_expression
+  };
+  struct dd dd1 = *dd;
+  size_t i, len;
+  int res;
+  if (!(wanted & fl))
+    return 0;
+  for (i = 0; i < sizeof (strs) / sizeof (strs[0]); i++)
+  {
+    if ((res = alias_string ((const unsigned char **) strs[i], &dd1, &len)) < 0)
+    {
+      DDS_TRACE("plist/do_content_filter_property: invalid string\n");
+      return res;
+    }
+    len = sizeof (uint32_t) + align4u (len);
+    dd1.buf += len;
+    dd1.bufsz = (len < dd1.bufsz) ? dd1.bufsz - len : 0;
+  }
+  if ((res = alias_stringseq (&q->expression_parameters, &dd1)) >= 0)
+  {
+    *present |= fl;
+    *aliased |= fl;
+  }
+  return res;
+}
+
+static void duplicate_content_filter_property (nn_content_filter_property_t *dst, const nn_content_filter_property_t *src)
+{
+  *dst = *src;
+  dst->expression_parameters.strs = NULL;
+  unalias_string (&dst->content_filtered_topic_name, -1);
+  unalias_string (&dst->related_topic_name, -1);
+  unalias_string (&dst->filter_class_name, -1);
+  unalias_string (&dst->filter_expression, -1);
+  duplicate_stringseq (&dst->expression_parameters, &src->expression_parameters);
+}
+
+static void fini_content_filter_property (nn_content_filter_property_t *q, int aliased)
+{
+  if (aliased)
+    ddsrt_free (q->expression_parameters.strs);
+  else
+  {
+    ddsrt_free (q->content_filtered_topic_name);
+    ddsrt_free (q->related_topic_name);
+    ddsrt_free (q->filter_class_name);
+    ddsrt_free (q->filter_expression);
+    free_stringseq (&q->expression_parameters);
+  }
+}
+
+nn_content_filter_property_t *nn_content_filter_property_dup (const nn_content_filter_property_t *src)
+{
+  nn_content_filter_property_t *dst = ddsrt_malloc (sizeof (*dst));
+  duplicate_content_filter_property (dst, src);
+  return dst;
+}
+
+void nn_content_filter_property_free (nn_content_filter_property_t *cfp)
+{
+  if (cfp)
+  {
+    fini_content_filter_property (cfp, 0);
+    ddsrt_free (cfp);
+  }
+}
+
 void nn_plist_fini (nn_plist_t *ps)
 {
   struct t { uint64_t fl; size_t off; };
@@ -428,6 +500,8 @@ DDSRT_WARNING_MSVC_OFF(6001);
       free_locators ((nn_locators_t *) ((char *) ps + locs[i].off));
   }
 DDSRT_WARNING_MSVC_ON(6001);
+  if (ps->present & PP_CONTENT_FILTER_PROPERTY)
+    fini_content_filter_property (&ps->content_filter_property, (ps->aliased & PP_CONTENT_FILTER_PROPERTY) != 0);
 
   ps->present = 0;
 }
@@ -1841,8 +1915,7 @@ static int init_one_parameter
       return do_duration (&dest->participant_lease_duration, &dest->present, PP_PARTICIPANT_LEASE_DURATION, dd);
 
     case PID_CONTENT_FILTER_PROPERTY:
-      /* FIXME */
-      return 0;
+      return do_content_filter_property (&dest->content_filter_property, &dest->present, &dest->aliased, pwanted, PP_CONTENT_FILTER_PROPERTY, dd);
 
     case PID_PARTICIPANT_GUID:
       return do_guid (&dest->participant_guid, &dest->present, PP_PARTICIPANT_GUID, valid_participant_guid, dd);
@@ -2272,6 +2345,11 @@ void nn_plist_mergein_missing (nn_plist_t *a, const nn_plist_t *b)
   CQ (PRISMTECH_TYPE_DESCRIPTION, type_description, string, char *);
   CQ (PRISMTECH_EOTINFO, eotinfo, eotinfo, nn_prismtech_eotinfo_t);
 #undef CQ
+  if (!(a->present & PP_CONTENT_FILTER_PROPERTY) && (b->present & PP_CONTENT_FILTER_PROPERTY))
+  {
+    duplicate_content_filter_property (&a->content_filter_property, &b->content_filter_property);
+    a->present |= PP_CONTENT_FILTER_PROPERTY;
+  }
   if (!(a->present & PP_PRISMTECH_PARTICIPANT_VERSION_INFO) &&
       (b->present & PP_PRISMTECH_PARTICIPANT_VERSION_INFO))
   {
@@ -2499,6 +2577,48 @@ const unsigned char *nn_plist_findparam_native_unchecked (const void *src, nn_pa
   return (unsigned char *) (par + 1);
 }
 
+int nn_plist_findparam_checking (const nn_plist_src_t *src, nn_parameterid_t pid, const unsigned char **value, uint16_t *length)
+{
+  /* Scans a received parameter list for pid without interpreting anything, setting *value to
+     its contents (or to NULL if not present) and *length to its length.  Returns Q_ERR_INVALID
+     if the list is malformed, but otherwise does much less checking than nn_plist_init_frommsg,
+     it is meant for extracting a key from discovery data quickly. */
+  const unsigned char *pl = src->buf;
+  int bswap;
+  switch (src->encoding)
+  {
+    case PL_CDR_LE:
+      bswap = (DDSRT_ENDIAN != DDSRT_LITTLE_ENDIAN);
+      break;
+    case PL_CDR_BE:
+      bswap = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN);
+      break;
+    default:
+      return Q_ERR_INVALID;
+  }
+  *value = NULL;
+  *length = 0;
+  while (pl + sizeof (nn_parameter_t) <= src->buf + src->bufsz)
+  {
+    const nn_parameter_t *par = (const nn_parameter_t *) pl;
+    const nn_parameterid_t parid = (nn_parameterid_t) (bswap ? bswap2u (par->parameterid) : par->parameterid);
+    const uint16_t parlen = (uint16_t) (bswap ? bswap2u (par->length) : par->length);
+    pl += sizeof (*par);
+    if (parid == PID_SENTINEL)
+      return 0;
+    if (parlen > src->bufsz - (size_t) (pl - src->buf) || (parlen % 4) != 0)
+      return Q_ERR_INVALID;
+    if (parid == pid)
+    {
+      *value = pl;
+      *length = parlen;
+      return 0;
+    }
+    pl += parlen;
+  }
+  return Q_ERR_INVALID;
+}
+
 unsigned char *nn_plist_quickscan (struct nn_rsample_info *dest, const struct nn_rmsg *rmsg, const nn_plist_src_t *src)
 {
   /* Sets a few fields in dest, returns address of first byte
@@ -3325,6 +3445,7 @@ void nn_plist_addtomsg (struct nn_xmsg *m, const nn_plist_t *ps, uint64_t pwante
 
   SIMPLE_TYPE (EXPECTS_INLINE_QOS, expects_inline_qos, unsigned char);
   SIMPLE_TYPE (PARTICIPANT_LEASE_DURATION, participant_lease_duration, nn_duration_t);
+  FUNC_BY_REF (CONTENT_FILTER_PROPERTY, content_filter_property, content_filter_property);
   FUNC_BY_REF (PARTICIPANT_GUID, participant_guid, guid);
   SIMPLE_TYPE (BUILTIN_ENDPOINT_SET, builtin_endpoint_set, unsigned);
   SIMPLE_TYPE (KEYHASH, keyhash, nn_keyhash_t);
@@ -11,6 +11,7 @@
  */
 #include <ctype.h>
 #include <stddef.h>
+#include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -42,6 +43,7 @@
 #include "dds/ddsi/q_bitset.h"
 #include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_globals.h" /* for mattr, cattr */
+#include "dds/ddsi/ddsi_serdata.h"
 
 /* OVERVIEW ------------------------------------------------------------
 
@@ -242,6 +244,15 @@
    you can't get anything through anymore if there are multiple
    writers.
 
+   The argument for it is that for really large samples, keeping all
+   fragments in the receive buffers pins many rbufs and the
+   deserializer has to copy all of it into a single block of memory
+   anyway.  So the defragmenter does do exactly that for samples of
+   at least a configurable size, copying the fragments straight into
+   a serdata of the right size (see DEFRAG).  The number of samples
+   in flight is bounded by the defragmenter's max_samples, which
+   keeps the memory required within reason.
+
    Gaps and Heartbeats prune the defragmenting index and are (when
    needed) stored as intervals of specially marked rdatas in the
    reordering indices.
@@ -508,6 +519,8 @@ static void *nn_rbuf_alloc (struct nn_rbufpool *rbufpool)
   return rb->freeptr;
 }
 
+static void nn_defrag_contig_release (struct nn_defrag_contig *contig);
+
 static void init_rmsg_chunk (struct nn_rmsg_chunk *chunk, struct nn_rbuf *rbuf)
 {
   chunk->rbuf = rbuf;
@@ -528,6 +541,7 @@ struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbufpool)
 
   /* Reference to this rmsg, undone by rmsg_commit(). */
   ddsrt_atomic_st32 (&rmsg->refcount, RMSG_REFCOUNT_UNCOMMITTED_BIAS);
+  rmsg->contigs = NULL;
   /* Initial chunk */
   init_rmsg_chunk (&rmsg->chunk, rbufpool->current);
   rmsg->lastchunk = &rmsg->chunk;
@@ -565,6 +579,7 @@ void nn_rmsg_free (struct nn_rmsg *rmsg)
   struct nn_rmsg_chunk *c;
   DDS_LOG(DDS_LC_RADMIN, "rmsg_free(%p)\n", (void *) rmsg);
   assert (ddsrt_atomic_ld32 (&rmsg->refcount) == 0);
+  nn_defrag_contig_release (rmsg->contigs);
   c = &rmsg->chunk;
   while (c)
   {
@@ -748,6 +763,242 @@ static void nn_rdata_unref (struct nn_rdata *rdata)
   nn_rmsg_unref (rdata->rmsg);
 }
 
+/* FEC -----------------------------------------------------------------
+
+   Forward error correction operates on whole packets, before anything
+   else looks at their contents: a sender that has FEC enabled tags
+   each packet it sends to a set of addresses with a stream id and a
+   sequence number (FEC_INFO), and follows every group of packets with
+   a parity packet (FEC_PARITY) containing the XOR of all of them (the
+   shorter ones zero-padded) and the XOR of their lengths.
+
+   The decoder keeps a copy of the last NN_FEC_WINDOW packets received
+   for a small number of streams (indexed on the source GUID prefix
+   and stream id, evicting the least-recently used one), and when a
+   parity packet arrives for a group of which precisely one packet is
+   missing, it reconstructs that packet by XOR'ing the parity payload
+   with the packets it did receive. The reconstructed packet is then
+   processed as if it had been received from the network, so that it
+   gets fed into the defragmenting and reordering like any other.
+
+   The sequence numbers also make it trivial to discard duplicates, as
+   occur when a packet is reconstructed and the original turns up
+   late after all.
+
+   Only packets tagged with FEC_INFO are copied, and the memory used for
+   the copies is limited to NN_FEC_DECODER_MAX_BYTES: when storing a
+   packet would exceed it, the copies held for the least-recently used
+   other streams are released first, and if that doesn't suffice, the
+   packet is not retained, which merely means the group it belongs to
+   can't be repaired.
+
+   A decoder is owned by a receive thread and not thread-safe.  */
+
+#define NN_FEC_WINDOW 64u /* must be a power of 2 and >= 2 * NN_FEC_MAX_GROUP_SIZE */
+#define NN_FEC_MAX_STREAMS 16
+#define NN_FEC_DECODER_MAX_BYTES (2u * 1024u * 1024u)
+
+struct nn_fec_slot {
+  uint32_t seq;
+  uint32_t len;
+  uint32_t cap;
+  int valid;
+  unsigned char *data;
+};
+
+struct nn_fec_stream {
+  nn_guid_prefix_t src;
+  uint32_t streamid;
+  uint32_t lastuse; /* 0: unused */
+  uint32_t bytes; /* sum of slot capacities */
+  struct nn_fec_slot slots[NN_FEC_WINDOW];
+};
+
+struct nn_fec_decoder {
+  uint32_t tick;
+  uint32_t bytes; /* sum of slot capacities of all streams */
+  uint32_t scratch_size;
+  unsigned char *scratch;
+  struct nn_fec_stream streams[NN_FEC_MAX_STREAMS];
+};
+
+void nn_fec_xor (unsigned char *dst, const unsigned char *src, size_t n)
+{
+  size_t i = 0;
+  /* memcpy to and from a uint64_t is the portable way of expressing
+     unaligned 8-byte loads & stores, compilers turn it into just that */
+  for (; i + 8 <= n; i += 8)
+  {
+    uint64_t a, b;
+    memcpy (&a, dst + i, 8);
+    memcpy (&b, src + i, 8);
+    a ^= b;
+    memcpy (dst + i, &a, 8);
+  }
+  for (; i < n; i++)
+    dst[i] ^= src[i];
+}
+
+struct nn_fec_decoder *nn_fec_decoder_new (void)
+{
+  struct nn_fec_decoder *dec = ddsrt_malloc (sizeof (*dec));
+  memset (dec, 0, sizeof (*dec));
+  return dec;
+}
+
+void nn_fec_decoder_free (struct nn_fec_decoder *dec)
+{
+  for (int i = 0; i < NN_FEC_MAX_STREAMS; i++)
+    for (uint32_t j = 0; j < NN_FEC_WINDOW; j++)
+      ddsrt_free (dec->streams[i].slots[j].data);
+  ddsrt_free (dec->scratch);
+  ddsrt_free (dec);
+}
+
+size_t nn_fec_decoder_memsize (const struct nn_fec_decoder *dec)
+{
+  return dec->bytes;
+}
+
+static void fec_release_stream (struct nn_fec_decoder *dec, struct nn_fec_stream *s)
+{
+  for (uint32_t j = 0; j < NN_FEC_WINDOW; j++)
+  {
+    struct nn_fec_slot *slot = &s->slots[j];
+    ddsrt_free (slot->data);
+    slot->data = NULL;
+    slot->cap = 0;
+    slot->valid = 0;
+  }
+  dec->bytes -= s->bytes;
+  s->bytes = 0;
+  s->lastuse = 0;
+}
+
+static struct nn_fec_stream *fec_lru_other_stream (struct nn_fec_decoder *dec, const struct nn_fec_stream *self)
+{
+  struct nn_fec_stream *lru = NULL;
+  for (int i = 0; i < NN_FEC_MAX_STREAMS; i++)
+  {
+    struct nn_fec_stream *s = &dec->streams[i];
+    if (s != self && s->bytes > 0 && (lru == NULL || s->lastuse < lru->lastuse))
+      lru = s;
+  }
+  return lru;
+}
+
+static struct nn_fec_stream *fec_lookup_stream (struct nn_fec_decoder *dec, const nn_guid_prefix_t *src, uint32_t streamid, int create)
+{
+  struct nn_fec_stream *s, *lru = &dec->streams[0];
+  for (int i = 0; i < NN_FEC_MAX_STREAMS; i++)
+  {
+    s = &dec->streams[i];
+    if (s->lastuse != 0 && s->streamid == streamid && memcmp (&s->src, src, sizeof (*src)) == 0)
+    {
+      s->lastuse = ++dec->tick;
+      return s;
+    }
+    if (s->lastuse < lru->lastuse)
+      lru = s;
+  }
+  if (!create)
+    return NULL;
+  /* Slot buffers are retained for reuse, only the contents are invalidated */
+  s = lru;
+  s->src = *src;
+  s->streamid = streamid;
+  s->lastuse = ++dec->tick;
+  for (uint32_t j = 0; j < NN_FEC_WINDOW; j++)
+    s->slots[j].valid = 0;
+  return s;
+}
+
+static void fec_store (struct nn_fec_decoder *dec, struct nn_fec_stream *s, struct nn_fec_slot *slot, uint32_t seq, const unsigned char *msg, uint32_t len)
+{
+  if (slot->cap < len)
+  {
+    struct nn_fec_stream *victim;
+    unsigned char *data;
+    while (dec->bytes - slot->cap + len > NN_FEC_DECODER_MAX_BYTES && (victim = fec_lru_other_stream (dec, s)) != NULL)
+      fec_release_stream (dec, victim);
+    if (dec->bytes - slot->cap + len > NN_FEC_DECODER_MAX_BYTES || (data = ddsrt_realloc_s (slot->data, len)) == NULL)
+    {
+      /* not retaining it only means its group can't be repaired */
+      slot->valid = 0;
+      return;
+    }
+    dec->bytes += len - slot->cap;
+    s->bytes += len - slot->cap;
+    slot->data = data;
+    slot->cap = len;
+  }
+  memcpy (slot->data, msg, len);
+  slot->seq = seq;
+  slot->len = len;
+  slot->valid = 1;
+}
+
+bool nn_fec_decoder_note_packet (struct nn_fec_decoder *dec, const nn_guid_prefix_t *src, uint32_t streamid, uint32_t seq, const unsigned char *msg, uint32_t len)
+{
+  struct nn_fec_stream *s = fec_lookup_stream (dec, src, streamid, 1);
+  struct nn_fec_slot *slot = &s->slots[seq % NN_FEC_WINDOW];
+  if (slot->valid && slot->seq == seq)
+    return false;
+  fec_store (dec, s, slot, seq, msg, len);
+  return true;
+}
+
+const unsigned char *nn_fec_decoder_parity (struct nn_fec_decoder *dec, const nn_guid_prefix_t *src, uint32_t streamid, uint32_t firstseq, uint32_t count, uint32_t lenxor, const unsigned char *payload, uint32_t paylen, uint32_t *seq, uint32_t *len)
+{
+  struct nn_fec_stream *s;
+  struct nn_fec_slot *missing = NULL;
+  uint32_t missing_seq = 0, i;
+
+  if (count == 0 || count > NN_FEC_MAX_GROUP_SIZE)
+    return NULL;
+  if ((s = fec_lookup_stream (dec, src, streamid, 0)) == NULL)
+    return NULL;
+  for (i = 0; i < count; i++)
+  {
+    struct nn_fec_slot *slot = &s->slots[(firstseq + i) % NN_FEC_WINDOW];
+    if (!(slot->valid && slot->seq == firstseq + i))
+    {
+      if (missing)
+        return NULL; /* can only repair a single loss */
+      missing = slot;
+      missing_seq = firstseq + i;
+    }
+    else if (slot->len > paylen)
+    {
+      return NULL; /* not the packet the parity was computed over */
+    }
+  }
+  if (missing == NULL)
+    return NULL;
+
+  if (dec->scratch_size < paylen)
+  {
+    dec->scratch = ddsrt_realloc (dec->scratch, paylen);
+    dec->scratch_size = paylen;
+  }
+  memcpy (dec->scratch, payload, paylen);
+  for (i = 0; i < count; i++)
+  {
+    struct nn_fec_slot *slot = &s->slots[(firstseq + i) % NN_FEC_WINDOW];
+    if (slot != missing)
+    {
+      nn_fec_xor (dec->scratch, slot->data, slot->len);
+      lenxor ^= slot->len;
+    }
+  }
+  if (lenxor > paylen || lenxor < RTPS_MESSAGE_HEADER_SIZE)
+    return NULL;
+  fec_store (dec, s, missing, missing_seq, dec->scratch, lenxor);
+  *seq = missing_seq;
+  *len = lenxor;
+  return dec->scratch;
+}
+
 /* DEFRAG --------------------------------------------------------------
 
    Defragmentation happens separately from reordering, the reason
@@ -809,7 +1060,43 @@ static void nn_rdata_unref (struct nn_rdata *rdata)
    a single bit of state) or to splay trees (must have a parent
    because they can degenerate to linear structures, unless the number
    of intervals in the tree is limited, which probably is a good idea
-   anyway). */
+   anyway).
+
+   Samples of at least contig_minsize and at most contig_maxsize bytes
+   are defragmented differently, provided the owner of the defragmenter set a
+   contig_alloc function and it returns a serdata for the sample:
+   then the fragments are copied into the serdata upon arrival and the
+   rdatas are not retained, with two exceptions.  The first is the
+   rdata that caused the creation of the rsample, as the rsample, the
+   sample info and the sample chain element are allocated in its rmsg.
+   The second is the rdata of the first fragment, because the
+   submessage header and the inline QoS are needed for delivering it.
+   Once the sample is complete, these two and the rdata completing it
+   (from whose rmsg nn_reorder_rsample_dup may allocate) form the
+   fragment chain (first fragment first), with the serdata referenced
+   by the sample info.  Received fragments are tracked in a bitmap, in units of the
+   fragment size of the first fragment to arrive.
+
+   The administration for a contiguous sample, including the reference
+   to the serdata, is owned by the defragmenter until the first
+   fragment arrives, and is then transferred to the rmsg of that
+   fragment.  That way, it lives exactly as long as anything can
+   reference the sample. */
+
+struct nn_defrag_contig {
+  struct nn_defrag_contig *next; /* in rmsg::contigs of first fragment */
+  struct ddsi_serdata *sd;
+  unsigned char *buf;            /* serialised data, including CDR header */
+  struct nn_rdata *creator;      /* rdata providing storage for rsample */
+  struct nn_rdata *first;        /* first fragment or NULL if not yet received */
+  struct nn_rdata *last;         /* fragment completing the sample, if not creator/first */
+  struct nn_rsample_chain_elem *sce;
+  uint32_t size;
+  uint32_t fragsize;
+  uint32_t nfrags;
+  uint32_t nmissing;
+  uint32_t bits[];               /* received fragments */
+};
 
 struct nn_defrag_iv {
   ddsrt_avl_node_t avlnode; /* for nn_rsample.defrag::fragtree */
@@ -825,6 +1112,7 @@ struct nn_rsample {
       ddsrt_avl_tree_t fragtree;
       struct nn_defrag_iv *lastfrag;
       struct nn_rsample_info *sampleinfo;
+      struct nn_defrag_contig *contig; /* non-NULL: fragtree unused */
       seqno_t seq;
     } defrag;
     struct nn_rsample_reorder {
@@ -842,6 +1130,9 @@ struct nn_defrag {
   uint32_t n_samples;
   uint32_t max_samples;
   enum nn_defrag_drop_mode drop_mode;
+  uint32_t contig_minsize;
+  uint32_t contig_maxsize;
+  nn_defrag_contig_alloc_t contig_alloc;
 };
 
 static int compare_uint32 (const void *va, const void *vb);
@@ -875,9 +1166,37 @@ struct nn_defrag *nn_defrag_new (enum nn_defrag_drop_mode drop_mode, uint32_t ma
   d->max_samples = max_samples;
   d->n_samples = 0;
   d->max_sample = NULL;
+  d->contig_minsize = 0;
+  d->contig_maxsize = 0;
+  d->contig_alloc = 0;
   return d;
 }
 
+void nn_defrag_set_contig (struct nn_defrag *defrag, uint32_t minsize, uint32_t maxsize, nn_defrag_contig_alloc_t alloc)
+{
+  /* minsize = 0 disables contiguous defragmenting, as even the
+     smallest fragmented sample would qualify otherwise; the sample
+     size is taken from the DATAFRAG and therefore under the control
+     of the sender, maxsize bounds what it can make us allocate */
+  assert (defrag->n_samples == 0);
+  defrag->contig_minsize = minsize;
+  defrag->contig_maxsize = maxsize;
+  defrag->contig_alloc = (minsize > 0 && maxsize >= minsize) ? alloc : 0;
+}
+
+static void nn_defrag_contig_release (struct nn_defrag_contig *contig)
+{
+  while (contig)
+  {
+    struct nn_defrag_contig *next = contig->next;
+    DDS_LOG(DDS_LC_RADMIN, "defrag_contig_release(%p)\n", (void *) contig);
+    if (contig->sd)
+      ddsi_serdata_unref (contig->sd);
+    ddsrt_free (contig);
+    contig = next;
+  }
+}
+
 void nn_fragchain_adjust_refcount (struct nn_rdata *frag, int adjust)
 {
   DDS_LOG(DDS_LC_RADMIN, "fragchain_adjust_refcount(%p, %d)\n", (void *) frag, adjust);
@@ -909,6 +1228,20 @@ static void defrag_rsample_drop (struct nn_defrag *defrag, struct nn_rsample *rs
   ddsrt_avl_delete (&defrag_sampletree_treedef, &defrag->sampletree, rsample);
   assert (defrag->n_samples > 0);
   defrag->n_samples--;
+  if (rsample->u.defrag.contig)
+  {
+    /* the rsample lives in the creator's rmsg and the contig admin
+       in that of the first fragment once it has been received */
+    struct nn_defrag_contig * const contig = rsample->u.defrag.contig;
+    struct nn_rdata * const creator = contig->creator;
+    struct nn_rdata * const first = contig->first;
+    if (first == NULL)
+      nn_defrag_contig_release (contig);
+    else if (first != creator)
+      nn_fragchain_rmbias (first);
+    nn_fragchain_rmbias (creator);
+    return;
+  }
   for (iv = ddsrt_avl_iter_first (&rsample_defrag_fragtree_treedef, &rsample->u.defrag.fragtree, &iter); iv; iv = ddsrt_avl_iter_next (&iter))
     nn_fragchain_rmbias (iv->first);
 }
@@ -1017,6 +1350,7 @@ static struct nn_rsample *defrag_rsample_new (struct nn_rdata *rdata, const stru
   rsample_init_common (rsample, rdata, sampleinfo);
   dfsample = &rsample->u.defrag;
   dfsample->lastfrag = NULL;
+  dfsample->contig = NULL;
   dfsample->seq = sampleinfo->seq;
   if ((dfsample->sampleinfo = nn_rmsg_alloc (rdata->rmsg, sizeof (*dfsample->sampleinfo))) == NULL)
     return NULL;
@@ -1042,6 +1376,143 @@ static struct nn_rsample *defrag_rsample_new (struct nn_rdata *rdata, const stru
   return rsample;
 }
 
+static int defrag_contig_add (struct nn_rsample_defrag *dfsample, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo)
+{
+  /* Copies the new data into the serdata and marks the fragments
+     fully covered by rdata as received, returns 1 iff that completes
+     the sample.  Partially covered fragments (only possible if the
+     sender changes the fragmentation) are ignored and will eventually
+     be NACK'd. */
+  struct nn_defrag_contig * const contig = dfsample->contig;
+  const uint32_t fs = contig->fragsize;
+  const uint32_t maxp1 = (rdata->maxp1 < contig->size) ? rdata->maxp1 : contig->size;
+  uint32_t i, iend, nnew = 0;
+
+  i = (rdata->min + fs - 1) / fs;
+  iend = (maxp1 == contig->size) ? contig->nfrags : maxp1 / fs;
+  for (; i < iend; i++)
+  {
+    if (!nn_bitset_isset (contig->nfrags, contig->bits, i))
+    {
+      nn_bitset_set (contig->nfrags, contig->bits, i);
+      nnew++;
+    }
+  }
+  DDS_LOG(DDS_LC_RADMIN, "  defrag_contig_add(%p [%"PRIu32"..%"PRIu32")): %"PRIu32" new of %"PRIu32" missing\n",
+          (void *) contig, rdata->min, maxp1, nnew, contig->nmissing);
+  if (nnew > 0 && rdata->min < maxp1)
+  {
+    const unsigned char *payload = NN_RMSG_PAYLOADOFF (rdata->rmsg, NN_RDATA_PAYLOAD_OFF (rdata));
+    memcpy (contig->buf + rdata->min, payload, maxp1 - rdata->min);
+    assert (contig->nmissing >= nnew);
+    contig->nmissing -= nnew;
+  }
+
+  if (rdata->min == 0 && contig->first == NULL)
+  {
+    /* Retain the first fragment and hand the contig admin over to its
+       rmsg, which is still uncommitted and owned by this thread.  The
+       sample info of the first fragment is the one that counts. */
+    if (rdata != contig->creator)
+    {
+      rdata->nextfrag = NULL;
+      nn_rdata_addbias (rdata);
+    }
+    contig->first = rdata;
+    contig->next = rdata->rmsg->contigs;
+    rdata->rmsg->contigs = contig;
+    *dfsample->sampleinfo = *sampleinfo;
+  }
+  if (contig->nmissing > 0)
+    return 0;
+  assert (contig->first != NULL);
+  if (rdata != contig->first && rdata != contig->creator)
+  {
+    rdata->nextfrag = NULL;
+    nn_rdata_addbias (rdata);
+    contig->last = rdata;
+  }
+  return 1;
+}
+
+static struct nn_rsample *defrag_rsample_new_contig (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo)
+{
+  struct nn_rsample *rsample;
+  struct nn_rsample_defrag *dfsample;
+  struct nn_rsample_chain_elem *sce;
+  struct nn_rsample_info *si;
+  struct nn_defrag_contig *contig;
+  struct ddsi_serdata *sd;
+  unsigned char *buf;
+  uint32_t nfrags;
+
+  assert (sampleinfo->fragsize > 0);
+  switch (defrag->contig_alloc (sampleinfo, rdata, &sd, &buf))
+  {
+    case NN_DEFRAG_CONTIG_OK:
+      break;
+    case NN_DEFRAG_CONTIG_UNSUPPORTED:
+      return defrag_rsample_new (rdata, sampleinfo);
+    case NN_DEFRAG_CONTIG_NOMEM:
+      DDS_LOG(DDS_LC_RADMIN, "  defrag_rsample_new_contig: out of memory for size %"PRIu32", dropping sample\n", sampleinfo->size);
+      return NULL;
+  }
+
+  /* Everything living in the creator's rmsg must be allocated now,
+     because that rmsg will have been committed by the time the sample
+     completes */
+  nfrags = (sampleinfo->size + sampleinfo->fragsize - 1) / sampleinfo->fragsize;
+  if ((rsample = nn_rmsg_alloc (rdata->rmsg, sizeof (*rsample))) == NULL ||
+      (sce = nn_rmsg_alloc (rdata->rmsg, sizeof (*sce))) == NULL ||
+      (si = nn_rmsg_alloc (rdata->rmsg, sizeof (*si))) == NULL ||
+      (contig = ddsrt_malloc_s (offsetof (struct nn_defrag_contig, bits) + 4 * ((nfrags + 31) / 32))) == NULL)
+  {
+    ddsi_serdata_unref (sd);
+    return NULL;
+  }
+  rsample_init_common (rsample, rdata, sampleinfo);
+  contig->next = NULL;
+  contig->sd = sd;
+  contig->buf = buf;
+  contig->creator = rdata;
+  contig->first = NULL;
+  contig->last = NULL;
+  contig->sce = sce;
+  contig->size = sampleinfo->size;
+  contig->fragsize = sampleinfo->fragsize;
+  contig->nfrags = nfrags;
+  contig->nmissing = nfrags;
+  nn_bitset_zero (nfrags, contig->bits);
+  DDS_LOG(DDS_LC_RADMIN, "  defrag_rsample_new_contig(%p) sd %p size %"PRIu32" nfrags %"PRIu32"\n",
+          (void *) contig, (void *) sd, contig->size, nfrags);
+
+  dfsample = &rsample->u.defrag;
+  dfsample->lastfrag = NULL;
+  dfsample->contig = contig;
+  dfsample->seq = sampleinfo->seq;
+  dfsample->sampleinfo = si;
+  *dfsample->sampleinfo = *sampleinfo;
+  ddsrt_avl_init (&rsample_defrag_fragtree_treedef, &dfsample->fragtree);
+
+  rdata->nextfrag = NULL;
+  nn_rdata_addbias (rdata);
+  {
+    /* a fragment by definition doesn't cover the entire sample */
+    int complete = defrag_contig_add (dfsample, rdata, sampleinfo);
+    assert (!complete);
+    (void) complete;
+  }
+  return rsample;
+}
+
+static struct nn_rsample *defrag_rsample_new_any (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo)
+{
+  if (defrag->contig_alloc && sampleinfo->size >= defrag->contig_minsize && sampleinfo->size <= defrag->contig_maxsize && sampleinfo->fragsize > 0)
+    return defrag_rsample_new_contig (defrag, rdata, sampleinfo);
+  else
+    return defrag_rsample_new (rdata, sampleinfo);
+}
+
 static struct nn_rsample *reorder_rsample_new (struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo)
 {
   /* Implements:
@@ -1111,14 +1582,35 @@ static void rsample_convert_defrag_to_reorder (struct nn_rsample *sample)
      self-respecting compiler will optimise them away, and any
      self-respecting CPU would need to copy them via registers anyway
      because it uses a load-store architecture. */
-  struct nn_defrag_iv *iv = ddsrt_avl_root_non_empty (&rsample_defrag_fragtree_treedef, &sample->u.defrag.fragtree);
-  struct nn_rdata *fragchain = iv->first;
+  struct nn_rdata *fragchain;
   struct nn_rsample_info *sampleinfo = sample->u.defrag.sampleinfo;
   struct nn_rsample_chain_elem *sce;
   seqno_t seq = sample->u.defrag.seq;
 
-  /* re-use memory fragment interval node for sample chain */
-  sce = (struct nn_rsample_chain_elem *) ddsrt_avl_root_non_empty (&rsample_defrag_fragtree_treedef, &sample->u.defrag.fragtree);
+  if (sample->u.defrag.contig == NULL)
+  {
+    struct nn_defrag_iv *iv = ddsrt_avl_root_non_empty (&rsample_defrag_fragtree_treedef, &sample->u.defrag.fragtree);
+    fragchain = iv->first;
+    /* re-use memory fragment interval node for sample chain */
+    sce = (struct nn_rsample_chain_elem *) iv;
+  }
+  else
+  {
+    /* first fragment followed by creator and last (if different)
+       keeps the memory alive, the data itself is in the serdata */
+    struct nn_defrag_contig * const contig = sample->u.defrag.contig;
+    struct nn_rdata *tail;
+    assert (contig->first != NULL && contig->first->nextfrag == NULL);
+    fragchain = tail = contig->first;
+    if (contig->creator != contig->first)
+      tail = tail->nextfrag = contig->creator;
+    if (contig->last)
+      tail->nextfrag = contig->last;
+    contig->sd = ddsi_serdata_fix_ser (contig->sd);
+    sampleinfo->serdata = contig->sd;
+    sampleinfo->malformed = (contig->sd == NULL);
+    sce = contig->sce;
+  }
   sce->fragchain = fragchain;
   sce->next = NULL;
   sce->sampleinfo = sampleinfo;
@@ -1136,6 +1628,12 @@ static struct nn_rsample *defrag_add_fragment (struct nn_rsample *sample, struct
   const uint32_t min = rdata->min;
   const uint32_t maxp1 = rdata->maxp1;
 
+  if (dfsample->contig)
+  {
+    assert (dfsample->seq == sampleinfo->seq);
+    return defrag_contig_add (dfsample, rdata, sampleinfo) ? sample : NULL;
+  }
+
   /* min, max are byte offsets; contents has max-min+1 bytes; it all
      concerns the message pointer to by sample */
   assert (min < maxp1);
@@ -1359,7 +1857,7 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
     /* FIXME: MERGE THIS ONE WITH THE NEXT */
     DDS_LOG(DDS_LC_RADMIN, "  new max sample\n");
     ddsrt_avl_lookup_ipath (&defrag_sampletree_treedef, &defrag->sampletree, &sampleinfo->seq, &path);
-    if ((sample = defrag_rsample_new (rdata, sampleinfo)) == NULL)
+    if ((sample = defrag_rsample_new_any (defrag, rdata, sampleinfo)) == NULL)
       return NULL;
     ddsrt_avl_insert_ipath (&defrag_sampletree_treedef, &defrag->sampletree, sample, &path);
     defrag->max_sample = sample;
@@ -1371,7 +1869,7 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
     /* a new sequence number, but smaller than the maximum */
     DDS_LOG(DDS_LC_RADMIN, "  new sample less than max\n");
     assert (sampleinfo->seq < max_seq);
-    if ((sample = defrag_rsample_new (rdata, sampleinfo)) == NULL)
+    if ((sample = defrag_rsample_new_any (defrag, rdata, sampleinfo)) == NULL)
       return NULL;
     ddsrt_avl_insert_ipath (&defrag_sampletree_treedef, &defrag->sampletree, sample, &path);
     defrag->n_samples++;
@@ -1422,6 +1920,38 @@ void nn_defrag_notegap (struct nn_defrag *defrag, seqno_t min, seqno_t maxp1)
   defrag->max_sample = ddsrt_avl_find_max (&defrag_sampletree_treedef, &defrag->sampletree);
 }
 
+static int defrag_contig_nackmap (const struct nn_defrag_contig *contig, uint32_t maxfragnum, struct nn_fragment_number_set *map, uint32_t maxsz)
+{
+  /* Bitmap runs from first missing fragment to the last missing one
+     that has been published so far, exactly as for the interval tree
+     but a whole lot simpler */
+  uint32_t i, last;
+  if (maxfragnum >= contig->nfrags)
+    maxfragnum = contig->nfrags - 1;
+  /* the common case for a large sample is a long prefix of received
+     fragments, skip over those a word at a time */
+  for (i = 0; i + 32 <= maxfragnum + 1 && contig->bits[i / 32] == ~(uint32_t) 0; i += 32)
+    ;
+  for (; i <= maxfragnum && nn_bitset_isset (contig->nfrags, contig->bits, i); i++)
+    ;
+  map->bitmap_base = i;
+  if (i > maxfragnum)
+  {
+    map->numbits = 0;
+    return 0;
+  }
+  for (last = maxfragnum; last > i && nn_bitset_isset (contig->nfrags, contig->bits, last); last--)
+    ;
+  map->numbits = last - i + 1;
+  if (map->numbits > maxsz)
+    map->numbits = maxsz;
+  nn_bitset_zero (map->numbits, map->bits);
+  for (i = 0; i < map->numbits; i++)
+    if (!nn_bitset_isset (contig->nfrags, contig->bits, map->bitmap_base + i))
+      nn_bitset_set (map->numbits, map->bits, i);
+  return (int) map->numbits;
+}
+
 int nn_defrag_nackmap (struct nn_defrag *defrag, seqno_t seq, uint32_t maxfragnum, struct nn_fragment_number_set *map, uint32_t maxsz)
 {
   struct nn_rsample *s;
@@ -1451,6 +1981,9 @@ int nn_defrag_nackmap (struct nn_defrag *defrag, seqno_t seq, uint32_t maxfragnu
     }
   }
 
+  if (s->u.defrag.contig)
+    return defrag_contig_nackmap (s->u.defrag.contig, maxfragnum, map, maxsz);
+
   /* Limit maxfragnum to actual sample size, so that the caller can
      get accurate info without knowing maxfragnum.  MAXFRAGNUM is
      0-based, so at most nfrags-1. */
@@ -1820,7 +2353,11 @@ static void delete_last_sample (struct nn_reorder *reorder)
     pe->next = NULL;
     assert (pe->sampleinfo->seq + 1 < last->maxp1);
     last->sc.last = pe;
-    last->maxp1--;
+    /* Gaps following the deleted sample may have been merged into the
+       interval, so it must end at the deleted sample rather than just
+       lose the last sequence number it covers, or the deleted sample
+       would appear to have been received */
+    last->maxp1 = e->sampleinfo->seq;
     last->n_samples--;
   }
 
@@ -354,6 +354,8 @@ static int valid_Data (const struct receiver_state *rst, struct nn_rmsg *rmsg, D
   set_sampleinfo_proxy_writer (sampleinfo, &pwr_guid);
   sampleinfo->seq = fromSN (msg->x.writerSN);
   sampleinfo->fragsize = 0; /* for unfragmented data, fragsize = 0 works swell */
+  sampleinfo->serdata = NULL;
+  sampleinfo->malformed = 0;
 
   if (sampleinfo->seq <= 0 && sampleinfo->seq != NN_SEQUENCE_NUMBER_UNKNOWN)
     return 0;
@@ -484,6 +486,8 @@ static int valid_DataFrag (const struct receiver_state *rst, struct nn_rmsg *rms
   sampleinfo->seq = fromSN (msg->x.writerSN);
   sampleinfo->fragsize = msg->fragmentSize;
   sampleinfo->size = msg->sampleSize;
+  sampleinfo->serdata = NULL;
+  sampleinfo->malformed = 0;
 
   if (sampleinfo->seq <= 0 && sampleinfo->seq != NN_SEQUENCE_NUMBER_UNKNOWN)
     return 0;
@@ -558,24 +562,6 @@ static int valid_DataFrag (const struct receiver_state *rst, struct nn_rmsg *rms
   return 1;
 }
 
-static int add_Gap (struct nn_xmsg *msg, struct writer *wr, struct proxy_reader *prd, seqno_t start, seqno_t base, uint32_t numbits, const uint32_t *bits)
-{
-  struct nn_xmsg_marker sm_marker;
-  Gap_t *gap;
-  ASSERT_MUTEX_HELD (wr->e.lock);
-  assert (numbits > 0);
-  gap = nn_xmsg_append (msg, &sm_marker, GAP_SIZE (numbits));
-  nn_xmsg_submsg_init (msg, sm_marker, SMID_GAP);
-  gap->readerId = nn_hton_entityid (prd->e.guid.entityid);
-  gap->writerId = nn_hton_entityid (wr->e.guid.entityid);
-  gap->gapStart = toSN (start);
-  gap->gapList.bitmap_base = toSN (base);
-  gap->gapList.numbits = numbits;
-  memcpy (gap->gapList.bits, bits, NN_SEQUENCE_NUMBER_SET_BITS_SIZE (numbits));
-  nn_xmsg_submsg_setnext (msg, sm_marker);
-  return 0;
-}
-
 static void force_heartbeat_to_peer (struct writer *wr, const struct whc_state *whcst, struct proxy_reader *prd, int hbansreq)
 {
   struct nn_xmsg *m;
@@ -656,6 +642,14 @@ static int accept_ack_or_hb_w_timeout (nn_count_t new_count, nn_count_t *exp_cou
   return 1;
 }
 
+/* Pure acknowledgements only update the per-reader state of the
+   writer; dropping the acknowledged samples from the WHC is left to
+   the writer's WHC trim event, scheduled this long after the first
+   one.  With many readers acking the same writer, that saves taking
+   the WHC lock, recomputing the drop sequence number and walking the
+   WHC for each of them. */
+#define WHC_TRIM_DELAY T_MILLISECOND
+
 static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const AckNack_t *msg, nn_ddsi_time_t timestamp)
 {
   struct proxy_reader *prd;
@@ -672,6 +666,7 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
   int is_pure_ack;
   int is_pure_nonhist_ack;
   int is_preemptive_ack;
+  int is_batchable_ack;
   int enqueued;
   unsigned numbits;
   uint32_t msgs_sent, msgs_lost;
@@ -680,6 +675,8 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
   struct whc_state whcst;
   unsigned i;
   int hb_sent_in_response = 0;
+  int64_t rexmit_merging_period = config.retransmit_merging_period;
+  seqno_t rexmit_in_flight_seq = 0;
   memset (gapbits, 0, sizeof (gapbits));
   countp = (nn_count_t *) ((char *) msg + offsetof (AckNack_t, readerSNState) +
                            NN_SEQUENCE_NUMBER_SET_SIZE (msg->readerSNState.numbits));
@@ -737,6 +734,13 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
   is_pure_ack = !acknack_is_nack (msg);
   is_pure_nonhist_ack = is_pure_ack && seqbase - 1 >= rn->seq;
   is_preemptive_ack = seqbase <= 1 && is_pure_ack;
+  /* A final, pure ack from a reader that is in sync and responsive
+     requires no response, and so neither the WHC state: dropping the
+     samples can be postponed, unless someone is waiting for the WHC to
+     shrink or for a lingering writer to be fully acknowledged */
+  is_batchable_ack = (is_pure_nonhist_ack && !is_preemptive_ack && (msg->smhdr.flags & ACKNACK_FLAG_FINAL) &&
+                      rn->assumed_in_sync && rn->seq != MAX_SEQ_NUMBER &&
+                      wr->whc_trim_xevent != NULL && !wr->throttling && wr->state == WRST_OPERATIONAL);
 
   wr->num_acks_received++;
   if (!is_pure_ack)
@@ -768,6 +772,17 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
     }
   }
 
+  /* The timestamp, if present, is the one we put in the heartbeat and
+     the reader echoed, so it gives the round-trip time on our own
+     clock.  Anything implausible is most likely a left-over from some
+     other submessage and is ignored. */
+  if (config.rtt_adaptive_timing && valid_ddsi_timestamp (timestamp))
+  {
+    const int64_t rtt = now ().v - nn_wctime_from_ddsi_time (timestamp).v;
+    if (rtt >= 0 && rtt < 10 * T_SECOND)
+      writer_hbcontrol_note_rtt (wr, rn, rtt);
+  }
+
   /* First, the ACK part: if the AckNack advances the highest sequence
      number ack'd by the remote reader, update state & try dropping
      some messages */
@@ -782,10 +797,22 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
       rn->seq = wr->seq;
     }
     ddsrt_avl_augment_update (&wr_readers_treedef, rn);
-    n = remove_acked_messages (wr, &whcst, &deferred_free_list);
-    DDS_TRACE(" ACK%"PRId64" RM%u", n_ack, n);
+    if (is_batchable_ack)
+    {
+      if (!wr->whc_trim_pending)
+      {
+        wr->whc_trim_pending = 1;
+        resched_xevent_if_earlier (wr->whc_trim_xevent, add_duration_to_mtime (now_mt (), WHC_TRIM_DELAY));
+      }
+      DDS_TRACE(" ACK%"PRId64" (deferred)", n_ack);
+    }
+    else
+    {
+      n = remove_acked_messages (wr, &whcst, &deferred_free_list);
+      DDS_TRACE(" ACK%"PRId64" RM%u", n_ack, n);
+    }
   }
-  else
+  else if (!is_batchable_ack)
   {
     /* There's actually no guarantee that we need this information */
     whc_get_state(wr->whc, &whcst);
@@ -887,6 +914,16 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
      a future request'll fix it. */
   enqueued = 1;
   seq_xmit = READ_SEQ_XMIT(wr);
+  if (config.rtt_adaptive_timing && rn->rtt_srtt > 0)
+  {
+    /* A NACK for something retransmitted less than a round-trip time
+       ago most likely crossed the retransmit: the retransmit merging
+       period is at least the round-trip time, and a directed
+       retransmit isn't repeated within it */
+    rexmit_merging_period = (rn->rtt_srtt > config.retransmit_merging_period) ? rn->rtt_srtt : config.retransmit_merging_period;
+    if (now_mt ().v < rn->t_last_rexmit.v + rn->rtt_srtt)
+      rexmit_in_flight_seq = rn->last_rexmit_seq;
+  }
   for (i = 0; i < numbits && seqbase + i <= seq_xmit && enqueued; i++)
   {
     /* Accelerated schedule may run ahead of sequence number set
@@ -897,7 +934,16 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
     {
       seqno_t seq = seqbase + i;
       struct whc_borrowed_sample sample;
-      if (whc_borrow_sample (wr->whc, seq, &sample))
+      int have_sample = whc_borrow_sample (wr->whc, seq, &sample);
+      if (have_sample && rn->filter && sample.serdata->kind == SDK_DATA && !writer_filter_accepts (rn->filter, sample.serdata))
+      {
+        /* of no interest to this reader, so treat it as lost and let
+           it be covered by a GAP */
+        whc_return_sample (wr->whc, &sample, false);
+        wr->filter_rexmit_gap_count++;
+        have_sample = 0;
+      }
+      if (have_sample)
       {
         if (!wr->retransmitting && sample.unacked)
           writer_set_retransmitting (wr);
@@ -906,10 +952,10 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
         {
           /* send retransmit to all receivers, but skip if recently done */
           nn_mtime_t tstamp = now_mt ();
-          if (tstamp.v > sample.last_rexmit_ts.v + config.retransmit_merging_period)
+          if (tstamp.v > sample.last_rexmit_ts.v + rexmit_merging_period)
           {
             DDS_TRACE(" RX%"PRId64, seqbase + i);
-            enqueued = (enqueue_sample_wrlock_held (wr, seq, sample.plist, sample.serdata, NULL, 0) >= 0);
+            enqueued = (enqueue_sample_wrlock_held (wr, seq, sample.plist, sample.serdata, NULL, NULL, 0) >= 0);
             if (enqueued)
             {
               max_seq_in_reply = seqbase + i;
@@ -922,16 +968,22 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
             DDS_TRACE(" RX%"PRId64" (merged)", seqbase + i);
           }
         }
+        else if (seq <= rexmit_in_flight_seq)
+        {
+          DDS_TRACE(" RX%"PRId64" (in flight)", seqbase + i);
+        }
         else
         {
           /* no merging, send directed retransmit */
           DDS_TRACE(" RX%"PRId64"", seqbase + i);
-          enqueued = (enqueue_sample_wrlock_held (wr, seq, sample.plist, sample.serdata, prd, 0) >= 0);
+          enqueued = (enqueue_sample_wrlock_held (wr, seq, sample.plist, sample.serdata, prd, NULL, 0) >= 0);
           if (enqueued)
           {
             max_seq_in_reply = seqbase + i;
             msgs_sent++;
             sample.rexmit_count++;
+            rn->t_last_rexmit = now_mt ();
+            rn->last_rexmit_seq = seq;
           }
         }
 
@@ -1142,7 +1194,7 @@ static void handle_Heartbeat_helper (struct pwr_rd_match * const wn, struct hand
     }
     if (resched_xevent_if_earlier (wn->acknack_xevent, tsched))
     {
-      if (config.meas_hb_to_ack_latency && valid_ddsi_timestamp (arg->timestamp))
+      if ((config.meas_hb_to_ack_latency || config.rtt_adaptive_timing) && valid_ddsi_timestamp (arg->timestamp))
         wn->hb_timestamp = nn_wctime_from_ddsi_time (arg->timestamp);
     }
   }
@@ -1410,6 +1462,7 @@ static int handle_NackFrag (struct receiver_state *rst, nn_etime_t tnow, const N
   nn_count_t *countp;
   seqno_t seq = fromSN (msg->writerSN);
   unsigned i;
+  int more_to_request = 0;
 
   countp = (nn_count_t *) ((char *) msg + offsetof (NackFrag_t, fragmentNumberState) + NN_FRAGMENT_NUMBER_SET_SIZE (msg->fragmentNumberState.numbits));
   src.prefix = rst->src_guid_prefix;
@@ -1475,17 +1528,35 @@ static int handle_NackFrag (struct receiver_state *rst, nn_etime_t tnow, const N
     const unsigned base = msg->fragmentNumberState.bitmap_base - 1;
     int enqueued = 1;
     DDS_TRACE(" scheduling requested frags ...\n");
-    for (i = 0; i < msg->fragmentNumberState.numbits && enqueued; i++)
-    {
-      if (nn_bitset_isset (msg->fragmentNumberState.numbits, msg->fragmentNumberState.bits, i))
+    i = 0;
+    while (i < msg->fragmentNumberState.numbits && enqueued)
+    {
+      /* Runs of requested fragments go out combined in as few messages
+         as possible, create_fragment_message decides how many fit */
+      struct nn_xmsg *reply;
+      unsigned n;
+      int ret;
+      if (!nn_bitset_isset (msg->fragmentNumberState.numbits, msg->fragmentNumberState.bits, i))
       {
-        struct nn_xmsg *reply;
-        if (create_fragment_message (wr, seq, sample.plist, sample.serdata, base + i, prd, &reply, 0) < 0)
-          enqueued = 0;
-        else
-          enqueued = qxev_msg_rexmit_wrlock_held (wr->evq, reply, 0);
+        i++;
+        continue;
+      }
+      for (n = 1; i + n < msg->fragmentNumberState.numbits && nn_bitset_isset (msg->fragmentNumberState.numbits, msg->fragmentNumberState.bits, i + n); n++)
+        ;
+      if ((ret = create_fragment_message (wr, seq, sample.plist, sample.serdata, base + i, n, prd, NULL, &reply, 0)) < 0)
+        enqueued = 0;
+      else
+      {
+        enqueued = qxev_msg_rexmit_wrlock_held (wr->evq, reply, 0);
+        i += (unsigned) ret;
       }
     }
+    /* A large sample can easily be missing more fragments than fit in
+       a single NackFrag, and some of the requested ones may not have
+       fit in the retransmit queue.  Either way, there is no point in
+       waiting for the next regular heartbeat to ask for the rest. */
+    if (!enqueued || (msg->fragmentNumberState.numbits == 256 && (base + 256) * config.fragment_size < ddsi_serdata_size (sample.serdata)))
+      more_to_request = 1;
     whc_return_sample (wr->whc, &sample, false);
   }
   else
@@ -1507,7 +1578,7 @@ static int handle_NackFrag (struct receiver_state *rst, nn_etime_t tnow, const N
       qxev_msg (wr->evq, m);
     }
   }
-  if (seq < READ_SEQ_XMIT(wr))
+  if (seq < READ_SEQ_XMIT(wr) || more_to_request)
   {
     /* Not everything was retransmitted yet, so force a heartbeat out
        to give the reader a chance to nack the rest and make sure
@@ -1763,9 +1834,23 @@ static int handle_Gap (struct receiver_state *rst, nn_etime_t tnow, struct nn_rm
   return 1;
 }
 
-static struct ddsi_serdata *get_serdata (struct ddsi_sertopic const * const topic, const struct nn_rdata *fragchain, uint32_t sz, int justkey, unsigned statusinfo, nn_wctime_t tstamp)
+static struct ddsi_serdata *get_serdata (struct ddsi_sertopic const * const topic, const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, int justkey, unsigned statusinfo, nn_wctime_t tstamp)
 {
-  struct ddsi_serdata *sd = ddsi_serdata_from_ser (topic, justkey ? SDK_KEY : SDK_DATA, fragchain, sz);
+  struct ddsi_serdata *sd;
+  if (sampleinfo->malformed)
+    return NULL;
+  else if (sampleinfo->serdata == NULL)
+  {
+    if ((sd = ddsi_serdata_from_ser (topic, justkey ? SDK_KEY : SDK_DATA, fragchain, sampleinfo->size)) == NULL)
+      return NULL;
+  }
+  else
+  {
+    /* reassembled directly into a serdata by the defragmenter, of the
+       kind derived from the same flags (see defrag_contig_alloc) */
+    assert (sampleinfo->serdata->kind == (justkey ? SDK_KEY : SDK_DATA));
+    sd = ddsi_serdata_ref (sampleinfo->serdata);
+  }
   sd->statusinfo = statusinfo;
   sd->timestamp = tstamp;
   return sd;
@@ -1796,7 +1881,8 @@ static struct ddsi_serdata *extract_sample_from_data
               data_smhdr_flags, sampleinfo->size);
       return NULL;
     }
-    sample = get_serdata (topic, fragchain, sampleinfo->size, 0, statusinfo, tstamp);
+    if ((sample = get_serdata (topic, sampleinfo, fragchain, 0, statusinfo, tstamp)) == NULL)
+      failmsg = "malformed payload";
   }
   else if (sampleinfo->size)
   {
@@ -1805,12 +1891,14 @@ static struct ddsi_serdata *extract_sample_from_data
        as one would expect to receive */
     if (data_smhdr_flags & DATA_FLAG_KEYFLAG)
     {
-      sample = get_serdata (topic, fragchain, sampleinfo->size, 1, statusinfo, tstamp);
+      if ((sample = get_serdata (topic, sampleinfo, fragchain, 1, statusinfo, tstamp)) == NULL)
+        failmsg = "malformed payload";
     }
     else
     {
       assert (data_smhdr_flags & DATA_FLAG_DATAFLAG);
-      sample = get_serdata (topic, fragchain, sampleinfo->size, 0, statusinfo, tstamp);
+      if ((sample = get_serdata (topic, sampleinfo, fragchain, 0, statusinfo, tstamp)) == NULL)
+        failmsg = "malformed payload";
     }
   }
   else if (data_smhdr_flags & DATA_FLAG_INLINE_QOS)
@@ -1871,6 +1959,96 @@ unsigned char normalize_data_datafrag_flags (const SubmessageHeader_t *smhdr)
   }
 }
 
+enum nn_defrag_contig_alloc_result defrag_contig_alloc (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *rdata, struct ddsi_serdata **sd, unsigned char **buf)
+{
+  /* Called by the defragmenter of a proxy writer with pwr->e.lock held
+     when the first fragment of a large sample arrives.  The kind of
+     serdata is determined by the submessage flags, which are the same
+     for all fragments of a sample. */
+  const struct proxy_writer *pwr = sampleinfo->pwr;
+  const Data_DataFrag_common_t *msg;
+  if (pwr == NULL || pwr->ddsi2direct_cb || pwr->c.topic == NULL || is_builtin_entityid (pwr->e.guid.entityid, pwr->c.vendor))
+    return NN_DEFRAG_CONTIG_UNSUPPORTED;
+  if (pwr->c.topic->serdata_ops->alloc_ser == 0)
+    return NN_DEFRAG_CONTIG_UNSUPPORTED;
+  msg = (const Data_DataFrag_common_t *) NN_RMSG_PAYLOADOFF (rdata->rmsg, NN_RDATA_SUBMSG_OFF (rdata));
+  if (normalize_data_datafrag_flags (&msg->smhdr) & DATA_FLAG_KEYFLAG)
+    *sd = ddsi_serdata_alloc_ser (pwr->c.topic, SDK_KEY, sampleinfo->size, buf);
+  else
+    *sd = ddsi_serdata_alloc_ser (pwr->c.topic, SDK_DATA, sampleinfo->size, buf);
+  return (*sd != NULL) ? NN_DEFRAG_CONTIG_OK : NN_DEFRAG_CONTIG_NOMEM;
+}
+
+static void deliver_coherent_set (struct proxy_writer *pwr, int pwr_locked)
+{
+  struct coherent_set * const cs = &pwr->coherent;
+  struct proxy_writer_info pwr_info;
+  nn_guid_t *rdguids;
+  uint32_t nrd = 0, i;
+
+  make_proxy_writer_info (&pwr_info, &pwr->e, pwr->c.xqos);
+
+  /* Delivering a set may block on resource limits of a reader, in which
+     case the locks have to be released for a bit, so first collect the
+     readers that have been waiting for this set */
+  ddsrt_mutex_lock (&pwr->rdary.rdary_lock);
+  if (pwr->rdary.fastpath_ok)
+  {
+    struct reader ** const rdary = pwr->rdary.rdary;
+    rdguids = ddsrt_malloc ((pwr->rdary.n_readers + 1) * sizeof (*rdguids));
+    for (i = 0; rdary[i]; i++)
+      if (reader_wants_coherent_sets (rdary[i]))
+        rdguids[nrd++] = rdary[i]->e.guid;
+    ddsrt_mutex_unlock (&pwr->rdary.rdary_lock);
+  }
+  else
+  {
+    ddsrt_avl_iter_t it;
+    struct pwr_rd_match *m;
+    uint32_t nmatch = 0;
+    ddsrt_mutex_unlock (&pwr->rdary.rdary_lock);
+    if (!pwr_locked) ddsrt_mutex_lock (&pwr->e.lock);
+    for (m = ddsrt_avl_iter_first (&pwr_readers_treedef, &pwr->readers, &it); m != NULL; m = ddsrt_avl_iter_next (&it))
+      nmatch++;
+    rdguids = ddsrt_malloc ((nmatch + 1) * sizeof (*rdguids));
+    for (m = ddsrt_avl_iter_first (&pwr_readers_treedef, &pwr->readers, &it); m != NULL; m = ddsrt_avl_iter_next (&it))
+    {
+      struct reader *rd;
+      if ((rd = ephash_lookup_reader_guid (&m->rd_guid)) != NULL && reader_wants_coherent_sets (rd))
+        rdguids[nrd++] = m->rd_guid;
+    }
+    if (!pwr_locked) ddsrt_mutex_unlock (&pwr->e.lock);
+  }
+
+  for (i = 0; i < nrd; i++)
+  {
+    struct reader *rd;
+    uint32_t ndeliv = 0;
+    DDS_TRACE(" coherent set %"PRId64" (%"PRIu32" samples) => "PGUIDFMT"\n", cs->first_seq, cs->n, PGUID (rdguids[i]));
+    while ((rd = ephash_lookup_reader_guid (&rdguids[i])) != NULL &&
+           (ndeliv += (ddsi_plugin.rhc_plugin.rhc_store_set_fn) (rd->rhc, &pwr_info, cs->n - ndeliv, cs->samples + ndeliv, cs->tks + ndeliv)) < cs->n &&
+           ephash_lookup_proxy_writer_guid (&pwr->e.guid))
+    {
+      if (pwr_locked) ddsrt_mutex_unlock (&pwr->e.lock);
+      dds_sleepfor (DDS_MSECS (1));
+      if (pwr_locked) ddsrt_mutex_lock (&pwr->e.lock);
+    }
+  }
+  ddsrt_free (rdguids);
+}
+
+static void end_coherent_set (struct proxy_writer *pwr, seqno_t end_seq, int pwr_locked)
+{
+  /* A coherent set ends at END_SEQ, it is complete if all sequence numbers
+     from the first one up to END_SEQ have been received */
+  struct coherent_set * const cs = &pwr->coherent;
+  if (cs->incomplete || cs->next_seq != end_seq)
+    DDS_TRACE(" coherent set %"PRId64" incomplete at #%"PRId64", dropped\n", cs->first_seq, end_seq);
+  else if (cs->n > 0)
+    deliver_coherent_set (pwr, pwr_locked);
+  coherent_set_clear (cs);
+}
+
 static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const nn_guid_t *rdguid, int pwr_locked)
 {
   struct receiver_state const * const rst = sampleinfo->rst;
@@ -1882,6 +2060,7 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
   nn_plist_t qos;
   int need_keyhash;
   struct ddsi_serdata * payload;
+  seqno_t cs_seq;
 
   if (pwr->ddsi2direct_cb)
   {
@@ -1897,9 +2076,9 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
      taking care of itself, but it is currently doing so in an
      annoyingly simplistic manner ...  */
 
-  /* FIXME: fragments are now handled by copying the message to
-     freshly malloced memory (see defragment()) ... that'll have to
-     change eventually */
+  /* Fragments are copied into a serdata in get_serdata(), unless the
+     sample was large enough for the defragmenter to reassemble it in
+     place (sampleinfo->serdata, see defrag_contig_alloc()) */
   assert (fragchain->min == 0);
   assert (!is_builtin_entityid (pwr->e.guid.entityid, pwr->c.vendor));
   /* Can only get here if at some point readers existed => topic can't
@@ -1950,6 +2129,24 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     statusinfo = (qos.present & PP_STATUSINFO) ? qos.statusinfo : 0;
   }
 
+  /* Coherent sets: samples belonging to one are collected for readers
+     with coherent access and only stored in their history caches once
+     the set is known to be complete.  The set ends with an explicit
+     end-of-set marker (a DATA without payload that only carries the
+     coherent set id), or with the first sample not belonging to it.
+     Historical data for a specific reader bypasses all this. */
+  cs_seq = (qos.present & PP_COHERENT_SET) ? fromSN (qos.coherent_set_seqno) : 0;
+  {
+    const bool is_end_marker = (cs_seq != 0 && (data_smhdr_flags & (DATA_FLAG_KEYFLAG | DATA_FLAG_DATAFLAG)) == 0);
+    if (rdguid == NULL && pwr->coherent.first_seq != 0 && (is_end_marker || cs_seq != pwr->coherent.first_seq))
+      end_coherent_set (pwr, sampleinfo->seq, pwr_locked);
+    if (is_end_marker)
+    {
+      DDS_TRACE(" %"PRId64": end of coherent set %"PRId64"\n", sampleinfo->seq, cs_seq);
+      goto no_payload;
+    }
+  }
+
   /* Note: deserializing done potentially many times for a historical
      data sample (once per reader that cares about that data).  For
      now, this is accepted as sufficiently abnormal behaviour to not
@@ -1982,6 +2179,7 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
 
       if (rdguid == NULL)
       {
+        bool in_coherent_set = false;
         DDS_TRACE(" %"PRId64"=>EVERYONE\n", sampleinfo->seq);
 
         /* FIXME: pwr->rdary is an array of pointers to attached
@@ -2002,6 +2200,12 @@ retry:
           unsigned i;
           for (i = 0; rdary[i]; i++)
           {
+            if (cs_seq != 0 && reader_wants_coherent_sets (rdary[i]))
+            {
+              DDS_TRACE("reader "PGUIDFMT" (coherent)\n", PGUID (rdary[i]->e.guid));
+              in_coherent_set = true;
+              continue;
+            }
             DDS_TRACE("reader "PGUIDFMT"\n", PGUID (rdary[i]->e.guid));
             if (! (ddsi_plugin.rhc_plugin.rhc_store_fn) (rdary[i]->rhc, &pwr_info, payload, tk))
             {
@@ -2031,15 +2235,27 @@ retry:
           for (m = ddsrt_avl_iter_first (&pwr_readers_treedef, &pwr->readers, &it); m != NULL; m = ddsrt_avl_iter_next (&it))
           {
             struct reader *rd;
-            if ((rd = ephash_lookup_reader_guid (&m->rd_guid)) != NULL)
+            if ((rd = ephash_lookup_reader_guid (&m->rd_guid)) == NULL)
+              continue;
+            if (cs_seq != 0 && reader_wants_coherent_sets (rd))
             {
-              DDS_TRACE("reader-via-guid "PGUIDFMT"\n", PGUID (rd->e.guid));
-              (void) (ddsi_plugin.rhc_plugin.rhc_store_fn) (rd->rhc, &pwr_info, payload, tk);
+              DDS_TRACE("reader-via-guid "PGUIDFMT" (coherent)\n", PGUID (rd->e.guid));
+              in_coherent_set = true;
+              continue;
             }
+            DDS_TRACE("reader-via-guid "PGUIDFMT"\n", PGUID (rd->e.guid));
+            (void) (ddsi_plugin.rhc_plugin.rhc_store_fn) (rd->rhc, &pwr_info, payload, tk);
           }
           if (!pwr_locked) ddsrt_mutex_unlock (&pwr->e.lock);
         }
 
+        if (in_coherent_set)
+        {
+          if (pwr->coherent.first_seq == 0)
+            coherent_set_start (&pwr->coherent, cs_seq);
+          coherent_set_append (&pwr->coherent, sampleinfo->seq, payload, tk);
+        }
+
         ddsrt_atomic_st32 (&pwr->next_deliv_seq_lowword, (uint32_t) (sampleinfo->seq + 1));
       }
       else
@@ -2294,11 +2510,12 @@ static int handle_SPDP (const struct nn_rsample_info *sampleinfo, struct nn_rdat
   struct nn_rdata *fragchain;
   nn_reorder_result_t rres;
   int refc_adjust = 0;
+  struct nn_dqueue * const dqueue = builtins_dqueue_for_prefix (&sampleinfo->rst->src_guid_prefix);
   ddsrt_mutex_lock (&gv.spdp_lock);
   rsample = nn_defrag_rsample (gv.spdp_defrag, rdata, sampleinfo);
   fragchain = nn_rsample_fragchain (rsample);
-  if ((rres = nn_reorder_rsample (&sc, gv.spdp_reorder, rsample, &refc_adjust, nn_dqueue_is_full (gv.builtins_dqueue))) > 0)
-    nn_dqueue_enqueue (gv.builtins_dqueue, &sc, rres);
+  if ((rres = nn_reorder_rsample (&sc, gv.spdp_reorder, rsample, &refc_adjust, nn_dqueue_is_full (dqueue))) > 0)
+    nn_dqueue_enqueue (dqueue, &sc, rres);
   nn_fragchain_adjust_refcount (fragchain, refc_adjust);
   ddsrt_mutex_unlock (&gv.spdp_lock);
   return 0;
@@ -2854,13 +3071,13 @@ static int handle_submsg_sequence
                 unsigned char * const submsg1 = submsg + sizeof (PT_InfoContainer_t);
                 size_t len2 = decode_container (submsg1, len1);
                 if ( len2 != 0 ) {
-                  TRACE ((")\n"));
+                  DDS_TRACE(")\n");
                   thread_state_asleep (ts1);
-                  if (handle_submsg_sequence (conn, srcloc, tnowWC, tnowE, src_prefix, dst_prefix, msg, (size_t) (submsg1 - msg) + len2, submsg1, rmsg) < 0)
+                  if (handle_submsg_sequence (ts1, conn, srcloc, tnowWC, tnowE, src_prefix, dst_prefix, msg, (size_t) (submsg1 - msg) + len2, submsg1, rmsg) < 0)
                     goto malformed_asleep;
                   thread_state_awake (ts1);
                 }
-                TRACE (("PT_INFO_CONTAINER END"));
+                DDS_TRACE("PT_INFO_CONTAINER END");
               }
 #endif /* DDSI_INCLUDE_ENCRYPTION */
               break;
@@ -2885,6 +3102,13 @@ static int handle_submsg_sequence
         DDS_TRACE("ENTITY_ID");
         break;
       }
+      case SMID_PT_FEC_INFO:
+      case SMID_PT_FEC_PARITY:
+      {
+        /* FEC operates on the packets as a whole, see do_packet */
+        DDS_TRACE("FEC");
+        break;
+      }
       default:
         state = "parse:undefined";
         DDS_TRACE("UNDEFINED(%x)", sm->smhdr.submessageId);
@@ -2923,6 +3147,7 @@ static int handle_submsg_sequence
     state = "parse:shortmsg";
     state_smkind = SMID_PAD;
     DDS_TRACE("short (size %"PRIuSIZE" exp %p act %p)", submsg_size, (void *) submsg, (void *) end);
+    thread_state_asleep (ts1);
     goto malformed_asleep;
   }
   thread_state_asleep (ts1);
@@ -2942,12 +3167,93 @@ malformed_asleep:
   return -1;
 }
 
+static void handle_rtps_message (struct thread_state1 * const ts1, ddsi_tran_conn_t conn, const nn_guid_prefix_t * guidprefix, struct nn_rmsg *rmsg, unsigned char *buff, size_t sz, const nn_locator_t *srcloc)
+{
+  Header_t * hdr = (Header_t*) buff;
+  assert (thread_is_asleep ());
+  if (sz < RTPS_MESSAGE_HEADER_SIZE || *(uint32_t *)buff != NN_PROTOCOLID_AS_UINT32)
+  {
+    /* discard packets that are really too small or don't have magic cookie */
+  }
+  else if (hdr->version.major != RTPS_MAJOR || (hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
+  {
+    if ((hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
+      DDS_TRACE("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu\n, version mismatch: %d.%d\n",
+                PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, hdr->version.major, hdr->version.minor);
+    if (NN_PEDANTIC_P)
+      malformed_packet_received_nosubmsg (buff, (ssize_t) sz, "header", hdr->vendorid);
+  }
+  else
+  {
+    hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
+
+    if (dds_get_log_mask() & DDS_LC_TRACE)
+    {
+      char addrstr[DDSI_LOCSTRLEN];
+      ddsi_locator_to_string(addrstr, sizeof(addrstr), srcloc);
+      DDS_TRACE("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu from %s\n",
+                PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
+    }
+
+    handle_submsg_sequence (ts1, conn, srcloc, now (), now_et (), &hdr->guid_prefix, guidprefix, buff, sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg);
+  }
+}
+
+static uint32_t fec_get32 (const unsigned char *p, bool bswap)
+{
+  uint32_t x;
+  memcpy (&x, p, sizeof (x));
+  return bswap ? bswap4u (x) : x;
+}
+
+/* Feeds a packet to the FEC decoder if it was sent with FEC enabled.
+   Returns false if the packet should not be processed any further,
+   because it is a duplicate or a parity packet; in the latter case,
+   *rec is set to the packet that could be reconstructed, if any. */
+static bool fec_handle_packet (struct nn_fec_decoder *fec, const unsigned char *buff, size_t sz, const unsigned char **rec, uint32_t *reclen)
+{
+  const Header_t *hdr = (const Header_t *) buff;
+  const SubmessageHeader_t *smhdr = (const SubmessageHeader_t *) (buff + RTPS_MESSAGE_HEADER_SIZE);
+  bool bswap;
+  *rec = NULL;
+  if (sz < RTPS_MESSAGE_HEADER_SIZE + sizeof (PT_FecInfo_t) || !vendor_is_eclipse (hdr->vendorid))
+    return true;
+  bswap = (smhdr->flags & SMFLAG_ENDIANNESS) ? (DDSRT_ENDIAN != DDSRT_LITTLE_ENDIAN) : (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN);
+  if (smhdr->submessageId == SMID_PT_FEC_INFO)
+  {
+    const unsigned char *p = buff + RTPS_MESSAGE_HEADER_SIZE;
+    const uint32_t streamid = fec_get32 (p + offsetof (PT_FecInfo_t, streamid), bswap);
+    const uint32_t seq = fec_get32 (p + offsetof (PT_FecInfo_t, seq), bswap);
+    if (!nn_fec_decoder_note_packet (fec, &hdr->guid_prefix, streamid, seq, buff, (uint32_t) sz))
+    {
+      DDS_TRACE("fec: duplicate %"PRIx32"/%"PRIu32" dropped\n", streamid, seq);
+      return false;
+    }
+    return true;
+  }
+  else if (smhdr->submessageId == SMID_PT_FEC_PARITY && sz >= RTPS_MESSAGE_HEADER_SIZE + sizeof (PT_FecParity_t))
+  {
+    const unsigned char *p = buff + RTPS_MESSAGE_HEADER_SIZE;
+    const uint32_t streamid = fec_get32 (p + offsetof (PT_FecParity_t, streamid), bswap);
+    const uint32_t firstseq = fec_get32 (p + offsetof (PT_FecParity_t, firstseq), bswap);
+    const uint32_t count = fec_get32 (p + offsetof (PT_FecParity_t, count), bswap);
+    const uint32_t lenxor = fec_get32 (p + offsetof (PT_FecParity_t, lenxor), bswap);
+    const uint32_t paylen = (uint32_t) (sz - RTPS_MESSAGE_HEADER_SIZE - sizeof (PT_FecParity_t));
+    uint32_t seq;
+    if ((*rec = nn_fec_decoder_parity (fec, &hdr->guid_prefix, streamid, firstseq, count, lenxor, p + sizeof (PT_FecParity_t), paylen, &seq, reclen)) != NULL)
+      DDS_TRACE("fec: reconstructed %"PRIx32"/%"PRIu32" from parity %"PRIu32"..%"PRIu32"\n", streamid, seq, firstseq, firstseq + count - 1);
+    return false;
+  }
+  return true;
+}
+
 static bool do_packet
 (
   struct thread_state1 * const ts1,
   ddsi_tran_conn_t conn,
   const nn_guid_prefix_t * guidprefix,
-  struct nn_rbufpool *rbpool
+  struct nn_rbufpool *rbpool,
+  struct nn_fec_decoder *fec
 )
 {
   /* UDP max packet size is 64kB */
@@ -3031,34 +3337,21 @@ static bool do_packet
 
   if (sz > 0 && !gv.deaf)
   {
+    const unsigned char *rec = NULL;
+    uint32_t reclen = 0;
     nn_rmsg_setsize (rmsg, (uint32_t) sz);
-    assert (thread_is_asleep ());
-
-    if ((size_t)sz < RTPS_MESSAGE_HEADER_SIZE || *(uint32_t *)buff != NN_PROTOCOLID_AS_UINT32)
-    {
-      /* discard packets that are really too small or don't have magic cookie */
-    }
-    else if (hdr->version.major != RTPS_MAJOR || (hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
-    {
-      if ((hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
-        DDS_TRACE("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu\n, version mismatch: %d.%d\n",
-                  PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, hdr->version.major, hdr->version.minor);
-      if (NN_PEDANTIC_P)
-        malformed_packet_received_nosubmsg (buff, sz, "header", hdr->vendorid);
-    }
-    else
+    if (conn->m_stream || fec_handle_packet (fec, buff, (size_t) sz, &rec, &reclen))
+      handle_rtps_message (ts1, conn, guidprefix, rmsg, buff, (size_t) sz, &srcloc);
+    if (rec)
     {
-      hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
-
-      if (dds_get_log_mask() & DDS_LC_TRACE)
-      {
-        char addrstr[DDSI_LOCSTRLEN];
-        ddsi_locator_to_string(addrstr, sizeof(addrstr), &srcloc);
-        DDS_TRACE("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu from %s\n",
-                  PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
-      }
-
-      handle_submsg_sequence (ts1, conn, &srcloc, now (), now_et (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg);
+      /* A packet reconstructed from the parity packet just received gets
+         processed as if it had been received instead of the parity */
+      nn_rmsg_commit (rmsg);
+      if ((rmsg = nn_rmsg_new (rbpool)) == NULL)
+        return true;
+      memcpy (NN_RMSG_PAYLOAD (rmsg), rec, reclen);
+      nn_rmsg_setsize (rmsg, reclen);
+      handle_rtps_message (ts1, conn, guidprefix, rmsg, NN_RMSG_PAYLOAD (rmsg), reclen, &srcloc);
     }
   }
   nn_rmsg_commit (rmsg);
@@ -3320,7 +3613,7 @@ void trigger_recv_threads (void)
     {
       case RTM_SINGLE: {
         char buf[DDSI_LOCSTRLEN];
-        char dummy = 0;
+        char dummy = (char) gv.recv_threads[i].arg.u.single.trigger;
         const nn_locator_t *dst = gv.recv_threads[i].arg.u.single.loc;
         ddsrt_iovec_t iov;
         iov.iov_base = &dummy;
@@ -3345,6 +3638,7 @@ uint32_t recv_thread (void *vrecv_thread_arg)
   struct nn_rbufpool *rbpool = recv_thread_arg->rbpool;
   os_sockWaitset waitset = recv_thread_arg->mode == RTM_MANY ? recv_thread_arg->u.many.ws : NULL;
   nn_mtime_t next_thread_cputime = { 0 };
+  struct nn_fec_decoder *fec = nn_fec_decoder_new ();
 
   nn_rbufpool_setowner (rbpool, ddsrt_thread_self ());
   if (waitset == NULL)
@@ -3352,7 +3646,7 @@ uint32_t recv_thread (void *vrecv_thread_arg)
     while (gv.rtps_keepgoing)
     {
       LOG_THREAD_CPUTIME (next_thread_cputime);
-      (void) do_packet (ts1, recv_thread_arg->u.single.conn, NULL, rbpool);
+      (void) do_packet (ts1, recv_thread_arg->u.single.conn, NULL, rbpool, fec);
     }
   }
   else
@@ -3422,12 +3716,13 @@ uint32_t recv_thread (void *vrecv_thread_arg)
           else
             guid_prefix = &lps.ps[(unsigned)idx - num_fixed].guid_prefix;
           /* Process message and clean out connection if failed or closed */
-          if (!do_packet (ts1, conn, guid_prefix, rbpool) && !conn->m_connless)
+          if (!do_packet (ts1, conn, guid_prefix, rbpool, fec) && !conn->m_connless)
             ddsi_conn_free (conn);
         }
       }
     }
     local_participant_set_fini (&lps);
   }
+  nn_fec_decoder_free (fec);
   return 0;
 }
@@ -11,17 +11,25 @@
  */
 #ifdef DDSI_INCLUDE_ENCRYPTION
 
+#include <assert.h>
+#include <string.h>       /* for memcpy */
+#include <ctype.h>        /* for isspace */
+#include <stdio.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
 #include "dds/ddsi/q_security.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_error.h"
-#include "os/os_stdlib.h"
-#include "os/os_process.h"
-#include "os/os_thread.h"
-#include "os/os_heap.h"
+#include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/ddsi_tran.h"
 
-#include <string.h>       /* for memcpy */
-#include <ctype.h>        /* for isspace */
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <openssl/rand.h>
@@ -62,6 +70,18 @@
  * counter, shall be chosen randomly */
 #define Q_KEYID_LENGTH 4
 
+/* The AEAD ciphers (AES-GCM, ChaCha20-Poly1305) use a 96-bit nonce, of which
+ * the lower 64 bits are a message counter, and a 128-bit authentication tag
+ * that replaces the SHA1 digest; the key id, the cipher type and the partition
+ * id in the header are authenticated as additional data */
+#define Q_AEAD_NONCE_LENGTH      12
+#define Q_AEAD_COUNTER_LENGTH    8
+#define Q_AEAD_TAG_LENGTH        16
+#define Q_AEAD_AAD_LENGTH        (Q_KEYID_LENGTH + sizeof(q_cipherType) + sizeof(uint32_t))
+
+#define Q_CIPHER_IS_AEAD(c) \
+    ((c) == Q_CIPHER_AES128_GCM || (c) == Q_CIPHER_AES256_GCM || (c) == Q_CIPHER_CHACHA20_POLY1305)
+
 #define Q_REPORT_OPENSSL_ERR(x) \
 while ( ERR_peek_error() ) \
    DDS_ERROR(x "%s", ERR_error_string(ERR_get_error(), NULL));
@@ -71,47 +91,84 @@ while ( ERR_peek_error() ) \
 typedef unsigned char q_sha1Digest[SHA_DIGEST_LENGTH];  /* 20 bytes + '\0' */
 
 
-C_STRUCT(q_sha1Header) {
+struct q_sha1Header {
     unsigned char hash[Q_DIGEST_LENGTH_2]; /* hash over body and security attributes */
     /* ----- up to here encrypted ------*/
 };
 
 
 /* class declarations */
-C_CLASS(q_nullHeader);
-C_CLASS(q_blowfishHeader);
-C_CLASS(q_aesHeader);
+typedef struct q_nullHeader *q_nullHeader;
+typedef struct q_blowfishHeader *q_blowfishHeader;
+typedef struct q_aesHeader *q_aesHeader;
+typedef struct q_aeadHeader *q_aeadHeader;
+typedef struct q_securityAeadContext *q_securityAeadContext;
+typedef struct q_securityReplayWindow *q_securityReplayWindow;
 
 
 /* structure declarations */
-C_STRUCT(q_nullHeader) {
+struct q_nullHeader {
     q_cipherType  cipherType;   /* network order */ /* OPTME */
-    os_uint32 partitionId;  /* network order */
+    uint32_t partitionId;  /* network order */
 };
 
-C_STRUCT(q_blowfishHeader) {
+struct q_blowfishHeader {
     unsigned char  keyId[Q_KEYID_LENGTH];   /* required for re-keying (reserved for future usage) */
     unsigned char  counter[Q_BLOWFISH_BLOCK_SIZE]; /* cipher block length */
     q_cipherType  cipherType;   /* network order */ /* OPTME */
-    os_uint32 partitionId;  /* network order */
+    uint32_t partitionId;  /* network order */
 };
 
-C_STRUCT(q_aesHeader) {
+struct q_aesHeader {
     unsigned char  keyId[Q_KEYID_LENGTH];   /* required for re-keying (reserved for future usage)*/
     unsigned char  counter[Q_AES_BLOCK_SIZE]; /* cipher block length */
     q_cipherType  cipherType;   /* network order */ /* OPTME */
-    os_uint32 partitionId;  /* network order */
+    uint32_t partitionId;  /* network order */
+};
+
+struct q_aeadHeader {
+    unsigned char  keyId[Q_KEYID_LENGTH];   /* authenticated, identifies the sender with the nonce */
+    unsigned char  nonce[Q_AEAD_NONCE_LENGTH];
+    unsigned char  tag[Q_AEAD_TAG_LENGTH];
+    q_cipherType  cipherType;   /* network order, authenticated */
+    uint32_t partitionId;  /* network order, authenticated */
+};
+
+/* Cipher context of an AEAD codec for a single thread: the key schedule is
+ * computed once per thread, and the nonce counter is private to the thread,
+ * so parallel senders and receivers neither serialize nor reuse nonces */
+struct q_securityAeadContext {
+    EVP_CIPHER_CTX *ctx;
+    unsigned char  nonce[Q_AEAD_NONCE_LENGTH]; /* encoders only */
+};
+
+/* Replay protection of an AEAD decoder. A sender is identified by the key id
+ * of its encoder and the random upper 32 bits of the nonce of its thread; the
+ * counter in the lower 64 bits of the nonce increases with every message. Of
+ * each sender the highest counter seen and which of the Q_REPLAY_WINDOW_SIZE
+ * counters before it have been seen are tracked, anything older or seen before
+ * is a replay. A sender can't be forgotten without accepting replays of its
+ * old messages, so once Q_REPLAY_MAX_SENDERS senders are tracked, all messages
+ * of senders not yet tracked are dropped */
+#define Q_REPLAY_WINDOW_SIZE 64
+#define Q_REPLAY_MAX_SENDERS 256
+
+struct q_securityReplayWindow {
+    uint64_t sender;   /* key id and nonce prefix */
+    uint64_t highest;  /* highest counter accepted */
+    uint64_t seen;     /* bit i set: highest - i accepted */
 };
 
 /* To prevent fragmentations of heap and costly pointer dereferencing with
  * possible lot of cache-misses, we declare a union that allows us to allocate
  * a single array of codecs, each entry realizing a different cipher and
  * header-size.  */
-C_STRUCT(q_securityHeader) {
+struct q_securityHeader {
     union {
-        C_STRUCT(q_nullHeader)     null; /* obsolete */
-        C_STRUCT(q_blowfishHeader) blowfish;
-        C_STRUCT(q_aesHeader)      aes;
+        struct q_nullHeader     null; /* obsolete */
+        struct q_blowfishHeader blowfish;
+        struct q_aesHeader      aes;
+        struct q_aeadHeader     aead;
     } u;
 };
 
@@ -144,41 +201,55 @@ typedef enum {
    ((state)&(Q_CODEC_STATE_DROP_TEMP|Q_CODEC_STATE_DROP_PERM))
 
 /* declaration of codec */
-C_CLASS(q_securityPartitionDecoder);
-C_CLASS(q_securityPartitionEncoder);
+typedef struct q_securityPartitionDecoder *q_securityPartitionDecoder;
+typedef struct q_securityPartitionEncoder *q_securityPartitionEncoder;
 
-C_STRUCT(q_securityPartitionDecoder) {
+struct q_securityPartitionDecoder {
     q_securityCodecState  state;
     char                  *cipherKeyURL;
     q_cipherType          cipherType;
-    os_char *             partitionName;
-    EVP_CIPHER_CTX        cipherContext;
+    char                  *partitionName;
+    EVP_CIPHER_CTX        *cipherContext;
     /* this codec does hold state and therfor does not require securityHeader
      * attributes */
+    /* AEAD ciphers: one context per thread slot, created on first use */
+    const EVP_CIPHER      *aeadCipher;
+    unsigned char         aeadKey[Q_MAX_KEY_LENGTH];
+    uint32_t              nofAeadContexts;
+    q_securityAeadContext aeadContexts;
+    /* AEAD ciphers: messages recently accepted, per sender */
+    ddsrt_mutex_t         replayLock;
+    uint32_t              nofReplayWindows;
+    q_securityReplayWindow replayWindows;
 };
 
 
-C_STRUCT(q_securityPartitionEncoder){
+struct q_securityPartitionEncoder{
     q_securityCodecState state;
     char                 *cipherKeyURL;
     q_cipherType         cipherType;
-    os_char *            partitionName;
-    EVP_CIPHER_CTX       cipherContext;
+    char                 *partitionName;
+    EVP_CIPHER_CTX       *cipherContext;
     /* The current state will be appendend to message and will be used by
      * receiver to decrypt the message in question. To avoid cache misses
      * store the current state close to EVP_CIPHER_CTX  */
-    C_STRUCT(q_securityHeader) securityHeader; /* holds the state */
+    struct q_securityHeader securityHeader; /* holds the state */
+    /* AEAD ciphers: one context per thread slot, created on first use */
+    const EVP_CIPHER     *aeadCipher;
+    unsigned char        aeadKey[Q_MAX_KEY_LENGTH];
+    uint32_t             nofAeadContexts;
+    q_securityAeadContext aeadContexts;
 };
 
 
-C_STRUCT(q_securityDecoderSet) {
-    os_uint32 nofPartitions;
+struct q_securityDecoderSet {
+    uint32_t nofPartitions;
     q_securityPartitionDecoder decoders;
 };
 
-C_STRUCT(q_securityEncoderSet) {
-    os_uint32 nofPartitions;
-    os_uint32 headerSizeMax;
+struct q_securityEncoderSet {
+    uint32_t nofPartitions;
+    uint32_t headerSizeMax;
     q_securityPartitionEncoder encoders;
 };
 
@@ -264,12 +335,12 @@ static void dumpPayload (FILE *of, unsigned char* buffer, int mesgLength, int bu
 static void dumpBuffer
 (
   char* partitionName,
-  os_uint32 partitionId,
+  uint32_t partitionId,
   unsigned char* buffer,
   int length,
   const char* direction,
   unsigned char* counter,
-  os_uint32 counterLength,
+  uint32_t counterLength,
   int bufferLength)
 {
   char filename[FILENAME_MAX+1];
@@ -345,9 +416,9 @@ static void tdumpPayload (unsigned char* buffer, int mesgLength, int bufferLengt
                 int c = buffer[current];
                 c = (isalnum(c) ? c : '.');
                 if (current!=mesgLength) {
-                    TRACE((" %c", c));
+                    DDS_TRACE(" %c", c);
                 } else {
-                    TRACE(("#%c", c));
+                    DDS_TRACE("#%c", c);
                 }
         }
 
@@ -362,12 +433,12 @@ static void tdumpPayload (unsigned char* buffer, int mesgLength, int bufferLengt
 static void tdumpBuffer
 (
   char* partitionName,
-  os_uint32 partitionId,
+  uint32_t partitionId,
   unsigned char* buffer,
   int length,
   const char* direction,
   unsigned char* counter,
-  os_uint32 counterLength,
+  uint32_t counterLength,
   int bufferLength
 )
 {
@@ -385,19 +456,19 @@ static void tdumpBuffer
 
 /* returns the required space, codec must be non-NULL */
 
-static os_uint32 q_securityEncoderSetHeaderSize (q_securityEncoderSet codec)
+static uint32_t q_securityEncoderSetHeaderSize (q_securityEncoderSet codec)
 {
   assert (codec);
   return codec->headerSizeMax;
 }
 
 
-static c_bool decoderIsBlocked (q_securityPartitionDecoder codec)
+static bool decoderIsBlocked (q_securityPartitionDecoder codec)
 {
   return (IS_DROP_STATE(codec->state) > 0);
 }
 
-static c_bool encoderIsBlocked (q_securityPartitionEncoder codec)
+static bool encoderIsBlocked (q_securityPartitionEncoder codec)
 {
   return (IS_DROP_STATE(codec->state) > 0);
 }
@@ -436,10 +507,10 @@ static short hex2bin(char hexChar)
 }
 
 /* returns NULL on error, eg bad hex-string */
-static c_bool hex2key
+static bool hex2key
 (
   const char* hexKey,
-  os_uint32 expectedLength,
+  uint32_t expectedLength,
   unsigned char *result /* out */ )
 {
     size_t i, len=0;
@@ -452,7 +523,7 @@ static c_bool hex2key
         short low  = hex2bin(hexKey[(i*2)+1]);
         if (high < 0 || low < 0) {
             /* error, bad hex-string */
-            return FALSE;
+            return false;
         }
 
         val = (short) (high << 4 | low);
@@ -461,25 +532,28 @@ static c_bool hex2key
 
     /* hexString too short or too long */
     if (i!=expectedLength || len/2 != expectedLength) {
-        return FALSE;
+        return false;
     }
 
-    return TRUE;
+    return true;
 }
 
 
 /* return the key-length this cipher-type requires */
 static
-os_uint32
+uint32_t
 q_securityCipherKeyLength(q_cipherType cipherType) {
     switch (cipherType) {
         case Q_CIPHER_UNDEFINED: return 0;
         case Q_CIPHER_NULL:      return 0;
         case Q_CIPHER_NONE:      return 0;
-        case Q_CIPHER_BLOWFISH:  return (os_uint32)EVP_CIPHER_key_length(EVP_bf_ecb()); /* 16 */
-        case Q_CIPHER_AES128:    return (os_uint32)EVP_CIPHER_key_length(EVP_aes_128_ecb()); /* 16 */
-        case Q_CIPHER_AES192:    return (os_uint32)EVP_CIPHER_key_length(EVP_aes_192_ecb()); /* 24 */
-        case Q_CIPHER_AES256:    return (os_uint32)EVP_CIPHER_key_length(EVP_aes_256_ecb()); /* 32 */
+        case Q_CIPHER_BLOWFISH:  return (uint32_t)EVP_CIPHER_key_length(EVP_bf_ecb()); /* 16 */
+        case Q_CIPHER_AES128:    return (uint32_t)EVP_CIPHER_key_length(EVP_aes_128_ecb()); /* 16 */
+        case Q_CIPHER_AES192:    return (uint32_t)EVP_CIPHER_key_length(EVP_aes_192_ecb()); /* 24 */
+        case Q_CIPHER_AES256:    return (uint32_t)EVP_CIPHER_key_length(EVP_aes_256_ecb()); /* 32 */
+        case Q_CIPHER_AES128_GCM: return (uint32_t)EVP_CIPHER_key_length(EVP_aes_128_gcm()); /* 16 */
+        case Q_CIPHER_AES256_GCM: return (uint32_t)EVP_CIPHER_key_length(EVP_aes_256_gcm()); /* 32 */
+        case Q_CIPHER_CHACHA20_POLY1305: return (uint32_t)EVP_CIPHER_key_length(EVP_chacha20_poly1305()); /* 32 */
 
         default:
             assert(0 && "never reach");
@@ -488,7 +562,7 @@ q_securityCipherKeyLength(q_cipherType cipherType) {
 }
 
 /* return the const char-pointer  */
-static char * cipherTypeAsString (q_cipherType cipherType)
+static const char * cipherTypeAsString (q_cipherType cipherType)
 {
     switch (cipherType) {
         case Q_CIPHER_UNDEFINED: return "undefined";
@@ -498,6 +572,9 @@ static char * cipherTypeAsString (q_cipherType cipherType)
         case Q_CIPHER_AES128:    return "AES128-SHA1";
         case Q_CIPHER_AES192:    return "AES192-SHA1";
         case Q_CIPHER_AES256:    return "AES256-SHA1";
+        case Q_CIPHER_AES128_GCM: return "AES128-GCM";
+        case Q_CIPHER_AES256_GCM: return "AES256-GCM";
+        case Q_CIPHER_CHACHA20_POLY1305: return "ChaCha20-Poly1305";
         default:
             assert(0 && "never reach");
             return "undefined";
@@ -505,7 +582,7 @@ static char * cipherTypeAsString (q_cipherType cipherType)
 }
 
 /* return the const char-pointer  */
-static char*
+static const char*
 stateAsString(q_securityCodecState state) {
     if (state&(Q_CODEC_STATE_DROP_PERM)) return "drop-permanently";
     else if (state&(Q_CODEC_STATE_DROP_TEMP)) return "drop-temporary";
@@ -516,10 +593,10 @@ stateAsString(q_securityCodecState state) {
 /* this function is based on original code of
  * components/configuration/parser/code/cfg_parser.y */
 
-static c_bool q_securityResolveCipherKeyFromUri
+static bool q_securityResolveCipherKeyFromUri
 (
   const char *uriStr,
-  os_uint32 expectedLength,
+  uint32_t expectedLength,
   unsigned char *cipherKey /* out buffer */
 )
 {
@@ -528,7 +605,7 @@ static c_bool q_securityResolveCipherKeyFromUri
     char  readBuffer[256]; /*at most strings of 255 chars */
     char *hexStr = NULL;
     int ret;
-    c_bool result = FALSE;
+    bool result = false;
 
     if ((uriStr != NULL) &&
         (strncmp(uriStr, URI_FILESCHEMA, strlen(URI_FILESCHEMA)) == 0)) {
@@ -574,14 +651,14 @@ static c_bool q_securityResolveCipherKeyFromUri
 
 /* Validate the cipherkey, parsing the hex-string directly or the content of
  * file */
-static c_bool q_securityIsValidCipherKeyUri
+static bool q_securityIsValidCipherKeyUri
 (
   q_cipherType cipherType,
   const char* cipherKeyUri
 )
 {
   unsigned char tmpCipherKey[Q_MAX_KEY_LENGTH]; /* transient */
-  os_uint32 expectedLength = q_securityCipherKeyLength(cipherType);
+  uint32_t expectedLength = q_securityCipherKeyLength(cipherType);
 
   assert(expectedLength > 0);
 
@@ -590,14 +667,14 @@ static c_bool q_securityIsValidCipherKeyUri
 }
 
 /* compare cipherName to known identifiers, comparison is case-insensitive  */
-static c_bool q_securityCipherTypeFromString(const char* cipherName,
+static bool q_securityCipherTypeFromString(const char* cipherName,
                                 q_cipherType *cipherType) /* out */
 {
     if (cipherName == NULL)
     {
         DDS_ERROR("q_securityCipherTypeFromString:internal error, empty cipher string");
         *cipherType = Q_CIPHER_UNDEFINED;
-        return FALSE;
+        return false;
     }
 
     if (ddsrt_strcasecmp(cipherName, "null") == 0) {
@@ -614,6 +691,12 @@ static c_bool q_securityCipherTypeFromString(const char* cipherName,
     } else if (ddsrt_strcasecmp(cipherName, "aes256") == 0 ||
               ddsrt_strcasecmp(cipherName, "aes256-sha1") == 0) {
         *cipherType = Q_CIPHER_AES256;
+    } else if (ddsrt_strcasecmp(cipherName, "aes128-gcm") == 0) {
+        *cipherType = Q_CIPHER_AES128_GCM;
+    } else if (ddsrt_strcasecmp(cipherName, "aes256-gcm") == 0) {
+        *cipherType = Q_CIPHER_AES256_GCM;
+    } else if (ddsrt_strcasecmp(cipherName, "chacha20-poly1305") == 0) {
+        *cipherType = Q_CIPHER_CHACHA20_POLY1305;
 #if 0
     } else if (ddsrt_strcasecmp(cipherName, "rsa-null") == 0) {
         *cipherType = Q_CIPHER_RSA_WITH_NULL;
@@ -632,34 +715,39 @@ static c_bool q_securityCipherTypeFromString(const char* cipherName,
 #endif
     } else {
         *cipherType = Q_CIPHER_UNDEFINED;
-        return FALSE;
+        return false;
     }
-    return TRUE;
+    return true;
 }
 
-static os_uint32 cipherTypeToHeaderSize(q_cipherType cipherType) {
+static uint32_t cipherTypeToHeaderSize(q_cipherType cipherType) {
     switch (cipherType) {
         case Q_CIPHER_UNDEFINED:
         case Q_CIPHER_NONE:
             return 0;
         case Q_CIPHER_NULL:
-            return sizeof(C_STRUCT(q_nullHeader));
+            return sizeof(struct q_nullHeader);
 
         case Q_CIPHER_BLOWFISH:
-            return sizeof(C_STRUCT(q_sha1Header)) +
-                   sizeof(C_STRUCT(q_blowfishHeader));
+            return sizeof(struct q_sha1Header) +
+                   sizeof(struct q_blowfishHeader);
 
         case Q_CIPHER_AES128:
         case Q_CIPHER_AES192:
         case Q_CIPHER_AES256:
-            return sizeof(C_STRUCT(q_sha1Header)) +
-                   sizeof(C_STRUCT(q_aesHeader));
+            return sizeof(struct q_sha1Header) +
+                   sizeof(struct q_aesHeader);
+
+        case Q_CIPHER_AES128_GCM:
+        case Q_CIPHER_AES256_GCM:
+        case Q_CIPHER_CHACHA20_POLY1305:
+            return sizeof(struct q_aeadHeader);
 
         default:
             assert(0 && "unsupported cipher");
     }
 
-    assert(FALSE);
+    assert(false);
     return 0;
 }
 
@@ -670,8 +758,8 @@ void q_securityRNGSeed (void)
 {
     int32_t nsec;
     dds_time_t time = ddsrt_time_monotonic();
-    nsec = time % DDS_NSECS_IN_SEC;
-    RAND_seed(nsec,sizeof(nsec));
+    nsec = (int32_t) (time % DDS_NSECS_IN_SEC);
+    RAND_seed(&nsec,sizeof(nsec));
 }
 
 static
@@ -680,18 +768,93 @@ void q_securityRNGGetRandomNumber(int number_length,unsigned char * randNumber)
     RAND_bytes(randNumber,number_length);
 }
 
+static const EVP_CIPHER *
+q_securityAeadCipher(q_cipherType cipherType)
+{
+    switch (cipherType) {
+        case Q_CIPHER_AES128_GCM: return EVP_aes_128_gcm();
+        case Q_CIPHER_AES256_GCM: return EVP_aes_256_gcm();
+        case Q_CIPHER_CHACHA20_POLY1305: return EVP_chacha20_poly1305();
+        default:
+            assert(0 && "never reach");
+            return NULL;
+    }
+}
+
+static q_securityAeadContext
+q_securityAeadContextsNew(void)
+{
+    /* one per thread slot, so every thread of the process can have its own */
+    q_securityAeadContext contexts =
+        ddsrt_malloc(sizeof(struct q_securityAeadContext) * thread_states.nthreads);
+    memset(contexts, 0, sizeof(struct q_securityAeadContext) * thread_states.nthreads);
+    return contexts;
+}
+
+static void
+q_securityAeadContextsFree(q_securityAeadContext contexts, uint32_t nofContexts)
+{
+    uint32_t i;
+
+    if (contexts == NULL) {
+        return;
+    }
+    for (i = 0; i < nofContexts; i++) {
+        if (contexts[i].ctx) {
+            EVP_CIPHER_CTX_free(contexts[i].ctx);
+        }
+    }
+    ddsrt_free(contexts);
+}
+
+/* Returns the context of the calling thread for an AEAD codec, keying it on
+ * first use; a thread slot is only ever used by the thread that owns it, so
+ * no locking is needed. Returns NULL on error. */
+static q_securityAeadContext
+q_securityAeadThreadContext
+(
+  q_securityAeadContext contexts,
+  uint32_t nofContexts,
+  const EVP_CIPHER *cipher,
+  const unsigned char *key,
+  int enc
+)
+{
+    struct thread_state1 * const self = lookup_thread_state();
+    const uint32_t idx = (uint32_t) (self - thread_states.ts);
+    q_securityAeadContext context;
+
+    assert(idx < nofContexts);
+    (void) nofContexts;
+    context = &contexts[idx];
+    if (context->ctx == NULL) {
+        if ((context->ctx = EVP_CIPHER_CTX_new()) == NULL ||
+            !EVP_CipherInit_ex(context->ctx, cipher, NULL, key, NULL, enc)) {
+            Q_REPORT_OPENSSL_ERR("q_securityAeadThreadContext:");
+            if (context->ctx) {
+                EVP_CIPHER_CTX_free(context->ctx);
+                context->ctx = NULL;
+            }
+            return NULL;
+        }
+        /* random start, threads sharing a key must never share a nonce */
+        q_securityRNGGetRandomNumber(Q_AEAD_NONCE_LENGTH, context->nonce);
+    }
+    return context;
+}
+
 
 static
-c_bool
+bool
 q_securityPartitionEncoderInit(q_securityPartitionEncoder encoder,struct config_networkpartition_listelem *p)
 {
     unsigned char  cipherKey[Q_MAX_KEY_LENGTH];
     char      *cipherKeyURL = p->securityProfile?p->securityProfile->key:NULL;
-    os_char * partitionName = p->name;
-    c_bool        connected = (c_bool) p->connected;
+    char * partitionName = p->name;
+    bool        connected = (bool) p->connected;
     q_cipherType cipherType = p->securityProfile?p->securityProfile->cipher: Q_CIPHER_NONE;
-    os_uint32          hash = p->partitionHash;
-    os_uint32   partitionId = p->partitionId;
+    uint32_t          hash = p->partitionHash;
+    uint32_t   partitionId = p->partitionId;
 
     /* init */
     memset(encoder, 0, sizeof(*encoder));
@@ -705,7 +868,7 @@ q_securityPartitionEncoderInit(q_securityPartitionEncoder encoder,struct config_
         encoder->cipherType = Q_CIPHER_UNDEFINED;
         encoder->partitionName = partitionName;
 
-        return TRUE;
+        return true;
     }
 
     assert(cipherType != Q_CIPHER_UNDEFINED);
@@ -713,11 +876,11 @@ q_securityPartitionEncoderInit(q_securityPartitionEncoder encoder,struct config_
     {
         /* init the cipher */
 
-        const os_uint32 partitionHashNetworkOrder =  htonl(hash);
+        const uint32_t partitionHashNetworkOrder =  htonl(hash);
         const q_cipherType  cipherTypeNetworkOrder  = htonl(cipherType);
         const unsigned char *iv = NULL;  /* ignored by ECBs ciphers */
         const EVP_CIPHER *cipher = NULL;
-        const os_uint32 cipherKeyLength = q_securityCipherKeyLength(cipherType);
+        const uint32_t cipherKeyLength = q_securityCipherKeyLength(cipherType);
         unsigned char randCounter[Q_KEYID_LENGTH];
 
         /*TRACE(("Security Encoder init:  partition '%s' (%d) (connected), cipherType %d, cipherKey %s\n",
@@ -784,6 +947,18 @@ q_securityPartitionEncoderInit(q_securityPartitionEncoder encoder,struct config_
                 memcpy(encoder->securityHeader.u.aes.counter, &randCounter, sizeof(randCounter));
                 break;
 
+            case Q_CIPHER_AES128_GCM:
+            case Q_CIPHER_AES256_GCM:
+            case Q_CIPHER_CHACHA20_POLY1305:
+                cipher = q_securityAeadCipher(cipherType);
+                assert(Q_AEAD_NONCE_LENGTH == EVP_CIPHER_iv_length(cipher));
+
+                encoder->securityHeader.u.aead.cipherType = cipherTypeNetworkOrder;
+                encoder->securityHeader.u.aead.partitionId = partitionHashNetworkOrder;
+
+                memcpy(encoder->securityHeader.u.aead.keyId, &randCounter, sizeof(randCounter));
+                break;
+
             default:
                 assert(0 && "never reach");
         }
@@ -796,45 +971,53 @@ q_securityPartitionEncoderInit(q_securityPartitionEncoder encoder,struct config_
             encoder->state = Q_CODEC_STATE_DROP_TEMP;
         }
 
-        EVP_CIPHER_CTX_init(&(encoder->cipherContext));
+        encoder->cipherContext = EVP_CIPHER_CTX_new();
 
-        EVP_EncryptInit_ex(&(encoder->cipherContext),
-                           cipher,
-                           NULL,
-                           cipherKey,
-                           iv); /* IV is ignored by ECB ciphers */
+        if (Q_CIPHER_IS_AEAD(cipherType)) {
+            /* keyed per thread on first use, see q_securityAeadThreadContext */
+            encoder->aeadCipher = cipher;
+            memcpy(encoder->aeadKey, cipherKey, cipherKeyLength);
+            encoder->nofAeadContexts = thread_states.nthreads;
+            encoder->aeadContexts = q_securityAeadContextsNew();
+        } else {
+            EVP_EncryptInit_ex(encoder->cipherContext,
+                               cipher,
+                               NULL,
+                               cipherKey,
+                               iv); /* IV is ignored by ECB ciphers */
+        }
+        OPENSSL_cleanse(cipherKey, sizeof(cipherKey));
     }
 
-    return TRUE;
+    return true;
 }
 
 
 static
-c_bool
+bool
 q_securityPartitionEncoderFini(q_securityPartitionEncoder encoder)
 {
     if (encoder->cipherType != Q_CIPHER_UNDEFINED) {
         /* release the cipher */
-        EVP_CIPHER_CTX *ctx = NULL;
-
-        ctx = &(encoder->cipherContext);
+        EVP_CIPHER_CTX_free(encoder->cipherContext);
 
-        EVP_CIPHER_CTX_cleanup(ctx);
+        q_securityAeadContextsFree(encoder->aeadContexts, encoder->nofAeadContexts);
+        OPENSSL_cleanse(encoder->aeadKey, sizeof(encoder->aeadKey));
     }
 
-    return TRUE;
+    return true;
 }
 
 static
-c_bool
+bool
 q_securityPartitionDecoderInit(q_securityPartitionDecoder decoder,struct config_networkpartition_listelem *p)
 {
     unsigned char  cipherKey[Q_MAX_KEY_LENGTH];
     char *cipherKeyURL = p->securityProfile?p->securityProfile->key:NULL;
-    os_char * partitionName = p->name;
-    c_bool        connected = (c_bool) p->connected;
+    char * partitionName = p->name;
+    bool        connected = (bool) p->connected;
     q_cipherType cipherType = p->securityProfile?p->securityProfile->cipher: Q_CIPHER_NONE;
-    os_uint32   partitionId = p->partitionId;
+    uint32_t   partitionId = p->partitionId;
 
 
     /* init */
@@ -847,7 +1030,7 @@ q_securityPartitionDecoderInit(q_securityPartitionDecoder decoder,struct config_
         decoder->state = Q_CODEC_STATE_DROP_PERM;
         decoder->cipherType = Q_CIPHER_UNDEFINED;
         decoder->partitionName = partitionName;
-        return TRUE;
+        return true;
     }
 
 
@@ -857,7 +1040,7 @@ q_securityPartitionDecoderInit(q_securityPartitionDecoder decoder,struct config_
         /* init the cipher */
         const unsigned char *iv = NULL;  /* ignored by ECBs ciphers */
         const EVP_CIPHER *cipher = NULL;
-        const os_uint32  cipherKeyLength = q_securityCipherKeyLength(cipherType);
+        const uint32_t  cipherKeyLength = q_securityCipherKeyLength(cipherType);
 
         /*TRACE(("Security Decoder init:  partition '%s' (%d) (connected), cipherType %d, cipherKey %s \n",
                    partitionName,partitionId, cipherType, cipherKeyURL));*/
@@ -901,6 +1084,13 @@ q_securityPartitionDecoderInit(q_securityPartitionDecoder decoder,struct config_
                 assert(32 == cipherKeyLength);
                 break;
 
+            case Q_CIPHER_AES128_GCM:
+            case Q_CIPHER_AES256_GCM:
+            case Q_CIPHER_CHACHA20_POLY1305:
+                cipher = q_securityAeadCipher(cipherType);
+                assert(Q_AEAD_NONCE_LENGTH == EVP_CIPHER_iv_length(cipher));
+                break;
+
             default:
                 assert(0 && "never reach");
         }
@@ -914,29 +1104,43 @@ q_securityPartitionDecoderInit(q_securityPartitionDecoder decoder,struct config_
             decoder->state = Q_CODEC_STATE_DROP_TEMP;
         }
 
-        EVP_CIPHER_CTX_init(&(decoder->cipherContext));
-
-        EVP_EncryptInit_ex(&(decoder->cipherContext),
-                           cipher,
-                           NULL,
-                           cipherKey,
-                           iv); /* IV is ignored by ECB ciphers */
-
+        decoder->cipherContext = EVP_CIPHER_CTX_new();
+
+        if (Q_CIPHER_IS_AEAD(cipherType)) {
+            /* keyed per thread on first use, see q_securityAeadThreadContext */
+            decoder->aeadCipher = cipher;
+            memcpy(decoder->aeadKey, cipherKey, cipherKeyLength);
+            decoder->nofAeadContexts = thread_states.nthreads;
+            decoder->aeadContexts = q_securityAeadContextsNew();
+            ddsrt_mutex_init(&decoder->replayLock);
+            decoder->nofReplayWindows = 0;
+            decoder->replayWindows = ddsrt_malloc(sizeof(struct q_securityReplayWindow) * Q_REPLAY_MAX_SENDERS);
+        } else {
+            EVP_EncryptInit_ex(decoder->cipherContext,
+                               cipher,
+                               NULL,
+                               cipherKey,
+                               iv); /* IV is ignored by ECB ciphers */
+        }
+        OPENSSL_cleanse(cipherKey, sizeof(cipherKey));
     }
 
-    return TRUE;
+    return true;
 }
 
 
-static c_bool q_securityPartitionDecoderFini (q_securityPartitionDecoder decoder)
+static bool q_securityPartitionDecoderFini (q_securityPartitionDecoder decoder)
 {
     if (decoder->cipherType != Q_CIPHER_UNDEFINED) {
         /* release the cipher */
-        EVP_CIPHER_CTX *ctx = NULL;
+        EVP_CIPHER_CTX_free(decoder->cipherContext);
 
-        ctx = &(decoder->cipherContext);
-
-        EVP_CIPHER_CTX_cleanup(ctx);
+        q_securityAeadContextsFree(decoder->aeadContexts, decoder->nofAeadContexts);
+        if (decoder->replayWindows) {
+            ddsrt_mutex_destroy(&decoder->replayLock);
+            ddsrt_free(decoder->replayWindows);
+        }
+        OPENSSL_cleanse(decoder->aeadKey, sizeof(decoder->aeadKey));
     }
 
     return 1; /* true */
@@ -946,10 +1150,10 @@ static c_bool q_securityPartitionDecoderFini (q_securityPartitionDecoder decoder
 
 static q_securityEncoderSet q_securityEncoderSetNew (void)
 {
-    const os_uint32 nofPartitions = config.nof_networkPartitions;
+    const uint32_t nofPartitions = config.nof_networkPartitions;
 
     q_securityEncoderSet result =
-        ddsrt_malloc(sizeof(C_STRUCT(q_securityEncoderSet)));
+        ddsrt_malloc(sizeof(struct q_securityEncoderSet));
 
     if (!result) {
         return NULL;
@@ -960,10 +1164,10 @@ static q_securityEncoderSet q_securityEncoderSetNew (void)
     if (nofPartitions == 0) {
         result->encoders = NULL;
     } else {
-        result->encoders = ddsrt_malloc(sizeof(C_STRUCT(q_securityPartitionEncoder)) * nofPartitions);
+        result->encoders = ddsrt_malloc(sizeof(struct q_securityPartitionEncoder) * nofPartitions);
         memset(result->encoders,
                0,
-               sizeof(C_STRUCT(q_securityPartitionEncoder)) *
+               sizeof(struct q_securityPartitionEncoder) *
                nofPartitions);
     }
 
@@ -975,7 +1179,7 @@ static q_securityEncoderSet q_securityEncoderSetNew (void)
     /* init each codec per network parition */
     {
         q_securityPartitionEncoder currentEncoder = NULL;
-        os_uint32 headerSizeProfile = 0;
+        uint32_t headerSizeProfile = 0;
 
         struct config_networkpartition_listelem *p = config.networkPartitions;
 
@@ -1001,7 +1205,7 @@ static q_securityEncoderSet q_securityEncoderSetNew (void)
 
                 headerSizeProfile = cipherTypeToHeaderSize(currentEncoder->cipherType);
                 result->headerSizeMax = (headerSizeProfile > (result->headerSizeMax)) ? headerSizeProfile: (result->headerSizeMax);
-                result->headerSizeMax = (result->headerSizeMax + 4u) & ~4u; /* enforce mutiple of 4 */
+                result->headerSizeMax = (result->headerSizeMax + 3u) & ~3u; /* enforce multiple of 4 */
             } else {
                 memset(currentEncoder, 0, sizeof(*currentEncoder));
                 currentEncoder->state = Q_CODEC_STATE_DROP_PERM;
@@ -1032,23 +1236,23 @@ static q_securityEncoderSet q_securityEncoderSetNew (void)
 static q_securityDecoderSet q_securityDecoderSetNew (void)
 {
     q_securityDecoderSet result;
-    const os_uint32 nofPartitions = config.nof_networkPartitions;
+    const uint32_t nofPartitions = config.nof_networkPartitions;
 
     if (nofPartitions == 0)
     {
       return NULL;
     }
 
-    result = ddsrt_malloc (sizeof(C_STRUCT(q_securityDecoderSet)));
+    result = ddsrt_malloc (sizeof(struct q_securityDecoderSet));
     result->nofPartitions = 0;
 
     result->decoders =
-        ddsrt_malloc(sizeof(C_STRUCT(q_securityPartitionDecoder)) * nofPartitions);
+        ddsrt_malloc(sizeof(struct q_securityPartitionDecoder) * nofPartitions);
 
     /* init the memory region */
     memset(result->decoders,
            0,
-           sizeof(C_STRUCT(q_securityPartitionDecoder)) *
+           sizeof(struct q_securityPartitionDecoder) *
            nofPartitions);
 
     /* if not done yet, init the RNG within this thread*/
@@ -1101,14 +1305,14 @@ static q_securityDecoderSet q_securityDecoderSetNew (void)
 
 }
 
-static c_bool q_securityEncoderSetFree (q_securityEncoderSet codec)
+static bool q_securityEncoderSetFree (q_securityEncoderSet codec)
 {
     q_securityPartitionEncoder currentEncoder = NULL;
-    os_uint32 ix;
+    uint32_t ix;
 
     if (!codec) {
         /* parameter is NULL */
-        return TRUE;
+        return true;
     }
 
     for (ix=0; ix<codec->nofPartitions; ++ix) {
@@ -1123,14 +1327,14 @@ static c_bool q_securityEncoderSetFree (q_securityEncoderSet codec)
     return 1; /* true */
 }
 
-static c_bool q_securityDecoderSetFree (q_securityDecoderSet codec)
+static bool q_securityDecoderSetFree (q_securityDecoderSet codec)
 {
     q_securityPartitionDecoder currentDecoder = NULL;
-    os_uint32 ix;
+    uint32_t ix;
 
     if (!codec) {
         /* parameter is NULL */
-        return TRUE;
+        return true;
     }
 
     for (ix=0; ix<codec->nofPartitions; ++ix) {
@@ -1142,10 +1346,10 @@ static c_bool q_securityDecoderSetFree (q_securityDecoderSet codec)
     ddsrt_free(codec->decoders);
     ddsrt_free(codec);
 
-    return TRUE; /* true */
+    return true; /* true */
 }
 
-static os_uint32 q_securityEncoderHeaderSize (q_securityEncoderSet codec, os_uint32 partitionId)
+static uint32_t q_securityEncoderHeaderSize (q_securityEncoderSet codec, uint32_t partitionId)
 {
     assert(partitionId > 0);
     if (!codec) {
@@ -1156,7 +1360,7 @@ static os_uint32 q_securityEncoderHeaderSize (q_securityEncoderSet codec, os_uin
     return cipherTypeToHeaderSize(codec->encoders[partitionId-1].cipherType);
 }
 
-static q_cipherType q_securityEncoderCipherType (q_securityEncoderSet codec, os_uint32 partitionId)
+static q_cipherType q_securityEncoderCipherType (q_securityEncoderSet codec, uint32_t partitionId)
 {
     assert(partitionId > 0);
     if (!codec) {
@@ -1170,7 +1374,7 @@ static q_cipherType q_securityEncoderCipherType (q_securityEncoderSet codec, os_
 
 
 /* returns 0 on error, otherwise 1, */
-static c_bool counterEncryptOrDecryptInPlace
+static bool counterEncryptOrDecryptInPlace
 (
   EVP_CIPHER_CTX *ctx,
   unsigned char *counter, /* in/out */
@@ -1190,7 +1394,7 @@ static c_bool counterEncryptOrDecryptInPlace
 
             DDS_WARNING("Incoming encrypted sub-message dropped: Decrypt failed (bufferLength %u, blockSize %u, where %u)\n",length, bl, where);
 
-            return FALSE;
+            return false;
         }
 
         /* use the keystream to encrypt a single block of buffer */
@@ -1217,16 +1421,16 @@ static c_bool counterEncryptOrDecryptInPlace
         where += num;
     }
 
-    return TRUE;
+    return true;
 }
 
 
 static void
-attachHeaderAndDoSha1(unsigned char* data, os_uint32 dataLength,
-                      const void *symCipherHeader, os_uint32 symCipherHeaderLength)
+attachHeaderAndDoSha1(unsigned char* data, uint32_t dataLength,
+                      const void *symCipherHeader, uint32_t symCipherHeaderLength)
 {
-    const os_uint32 sha1HeaderLength = sizeof(C_STRUCT(q_sha1Header));
-    const os_uint32 overallLength = dataLength +
+    const uint32_t sha1HeaderLength = sizeof(struct q_sha1Header);
+    const uint32_t overallLength = dataLength +
                                     sha1HeaderLength +
                                     symCipherHeaderLength;
 
@@ -1247,19 +1451,19 @@ attachHeaderAndDoSha1(unsigned char* data, os_uint32 dataLength,
 }
 
 static void
-attachHeader(unsigned char* data, os_uint32 dataLength,
-         const void *symCipherHeader, os_uint32 symCipherHeaderLength)
+attachHeader(unsigned char* data, uint32_t dataLength,
+         const void *symCipherHeader, uint32_t symCipherHeaderLength)
 {
     /* pur the fixed attributes into buffer to calculate the digest */
     void *cipStart = &(data[dataLength]);
     memcpy(cipStart, symCipherHeader, symCipherHeaderLength);
 }
 
-static c_bool
-verifySha1(unsigned char* data, os_uint32 dataLength, void *digStart)
+static bool
+verifySha1(unsigned char* data, uint32_t dataLength, void *digStart)
 {
-    const os_uint32 sha1HeaderLength = sizeof(C_STRUCT(q_sha1Header));
-    C_STRUCT(q_sha1Header) sha1Header;
+    const uint32_t sha1HeaderLength = sizeof(struct q_sha1Header);
+    struct q_sha1Header sha1Header;
     unsigned char md[Q_DIGEST_LENGTH];
 
     /* backup the sha1 digest */
@@ -1274,30 +1478,201 @@ verifySha1(unsigned char* data, os_uint32 dataLength, void *digStart)
     return !memcmp(md, sha1Header.hash, Q_DIGEST_LENGTH_2);
 }
 
-static c_bool q_securityEncodeInPlace_Generic
+/* The additional authenticated data: the parts of the header that aren't
+ * protected by the cipher itself */
+static void q_securityAeadAad(const struct q_aeadHeader *header, unsigned char *aad)
+{
+    memcpy(aad, header->keyId, Q_KEYID_LENGTH);
+    memcpy(aad + Q_KEYID_LENGTH, &header->cipherType, sizeof(header->cipherType));
+    memcpy(aad + Q_KEYID_LENGTH + sizeof(header->cipherType), &header->partitionId, sizeof(header->partitionId));
+}
+
+/* Encrypts the concatenation of the "niov" buffers in "iov" into "cipherText",
+ * which may be the (single) input buffer itself, and appends the AEAD header
+ * with nonce and authentication tag. Returns 0 on error, otherwise 1,
+ * "cipherTextLength" is set to the length excluding the header. */
+static bool q_securityAeadEncrypt
 (
   q_securityPartitionEncoder encoder,
-  os_uint32 partitionId, /*  debugging  */
+  const ddsrt_iovec_t *iov,
+  size_t niov,
+  unsigned char *cipherText,
+  uint32_t *cipherTextLength /* out */
+)
+{
+    struct q_aeadHeader header = encoder->securityHeader.u.aead;
+    unsigned char aad[Q_AEAD_AAD_LENGTH];
+    q_securityAeadContext context;
+    uint32_t pos = 0;
+    size_t i;
+    int len, j;
+
+    context = q_securityAeadThreadContext(encoder->aeadContexts, encoder->nofAeadContexts,
+                                          encoder->aeadCipher, encoder->aeadKey, 1);
+    if (context == NULL) {
+        return false;
+    }
+
+    /* the lower 64 bits of the nonce count messages (big-endian) */
+    for (j = Q_AEAD_NONCE_LENGTH - 1; j >= Q_AEAD_NONCE_LENGTH - Q_AEAD_COUNTER_LENGTH; j--) {
+        if (++context->nonce[j] != 0) {
+            break;
+        }
+    }
+    memcpy(header.nonce, context->nonce, Q_AEAD_NONCE_LENGTH);
+
+    q_securityAeadAad(&header, aad);
+    if (!EVP_EncryptInit_ex(context->ctx, NULL, NULL, NULL, header.nonce) ||
+        !EVP_EncryptUpdate(context->ctx, NULL, &len, aad, (int) Q_AEAD_AAD_LENGTH)) {
+        goto err;
+    }
+    for (i = 0; i < niov; i++) {
+        if (!EVP_EncryptUpdate(context->ctx, cipherText + pos, &len,
+                               iov[i].iov_base, (int) iov[i].iov_len)) {
+            goto err;
+        }
+        pos += (uint32_t) len;
+    }
+    if (!EVP_EncryptFinal_ex(context->ctx, cipherText + pos, &len)) {
+        goto err;
+    }
+    pos += (uint32_t) len;
+    if (!EVP_CIPHER_CTX_ctrl(context->ctx, EVP_CTRL_AEAD_GET_TAG, Q_AEAD_TAG_LENGTH, header.tag)) {
+        goto err;
+    }
+
+    memcpy(cipherText + pos, &header, sizeof(header));
+    *cipherTextLength = pos;
+    return true;
+
+err:
+    Q_REPORT_OPENSSL_ERR("q_securityAeadEncrypt:");
+    return false;
+}
+
+/* Returns true if the message with the given key id and nonce hasn't been
+ * received before, and records that it now has been */
+static bool q_securityReplayCheck
+(
+  q_securityPartitionDecoder decoder,
+  const unsigned char *keyId,
+  const unsigned char *nonce
+)
+{
+    const int prefixLength = Q_AEAD_NONCE_LENGTH - Q_AEAD_COUNTER_LENGTH;
+    q_securityReplayWindow w = NULL;
+    uint64_t sender = 0, counter = 0;
+    bool result = true;
+    uint32_t i;
+    int j;
+
+    for (j = 0; j < Q_KEYID_LENGTH; j++) {
+        sender = (sender << 8) | keyId[j];
+    }
+    for (j = 0; j < prefixLength; j++) {
+        sender = (sender << 8) | nonce[j];
+    }
+    for (j = prefixLength; j < Q_AEAD_NONCE_LENGTH; j++) {
+        counter = (counter << 8) | nonce[j];
+    }
+
+    ddsrt_mutex_lock(&decoder->replayLock);
+    for (i = 0; i < decoder->nofReplayWindows && w == NULL; i++) {
+        if (decoder->replayWindows[i].sender == sender) {
+            w = &decoder->replayWindows[i];
+        }
+    }
+    if (w == NULL) {
+        if (decoder->nofReplayWindows == Q_REPLAY_MAX_SENDERS) {
+            DDS_WARNING("Incoming encrypted sub-message dropped: too many senders for partition '%s'\n", decoder->partitionName);
+            result = false;
+        } else {
+            w = &decoder->replayWindows[decoder->nofReplayWindows++];
+            w->sender = sender;
+            w->highest = counter;
+            w->seen = 1;
+        }
+    } else if (counter > w->highest) {
+        const uint64_t shift = counter - w->highest;
+        w->seen = (shift < Q_REPLAY_WINDOW_SIZE) ? (w->seen << shift) | 1 : 1;
+        w->highest = counter;
+    } else {
+        const uint64_t age = w->highest - counter;
+        if (age >= Q_REPLAY_WINDOW_SIZE || (w->seen & ((uint64_t) 1 << age))) {
+            DDS_WARNING("Incoming encrypted sub-message dropped: replayed message for partition '%s'\n", decoder->partitionName);
+            result = false;
+        } else {
+            w->seen |= (uint64_t) 1 << age;
+        }
+    }
+    ddsrt_mutex_unlock(&decoder->replayLock);
+    return result;
+}
+
+/* Decrypts "cipherTextLength" bytes of "buffer" in place and verifies the
+ * authentication tag in the AEAD header following it; returns 0 if the
+ * message was not authentic, otherwise 1 */
+static bool q_securityAeadDecrypt
+(
+  q_securityPartitionDecoder decoder,
   unsigned char *buffer,
-  os_uint32 *dataLength, /* in/out */
-  os_uint32 bufferLength /* for debug */
+  uint32_t cipherTextLength
 )
 {
-  const os_uint32 overallHeaderSize = cipherTypeToHeaderSize(encoder->cipherType);
+    struct q_aeadHeader header;
+    unsigned char aad[Q_AEAD_AAD_LENGTH];
+    q_securityAeadContext context;
+    int len;
+
+    /* copy from buffer into aligned memory */
+    memcpy(&header, buffer + cipherTextLength, sizeof(header));
+
+    context = q_securityAeadThreadContext(decoder->aeadContexts, decoder->nofAeadContexts,
+                                          decoder->aeadCipher, decoder->aeadKey, 0);
+    if (context == NULL) {
+        return false;
+    }
+
+    q_securityAeadAad(&header, aad);
+    if (!EVP_DecryptInit_ex(context->ctx, NULL, NULL, NULL, header.nonce) ||
+        !EVP_DecryptUpdate(context->ctx, NULL, &len, aad, (int) Q_AEAD_AAD_LENGTH) ||
+        !EVP_DecryptUpdate(context->ctx, buffer, &len, buffer, (int) cipherTextLength) ||
+        !EVP_CIPHER_CTX_ctrl(context->ctx, EVP_CTRL_AEAD_SET_TAG, Q_AEAD_TAG_LENGTH, header.tag)) {
+        Q_REPORT_OPENSSL_ERR("q_securityAeadDecrypt:");
+        return false;
+    }
+    /* fails if the tag doesn't match */
+    if (EVP_DecryptFinal_ex(context->ctx, buffer + len, &len) <= 0) {
+        return false;
+    }
+    /* only authentic messages may affect the replay windows */
+    return q_securityReplayCheck(decoder, header.keyId, header.nonce);
+}
 
-  EVP_CIPHER_CTX    *ctx   = &(encoder->cipherContext);
+static bool q_securityEncodeInPlace_Generic
+(
+  q_securityPartitionEncoder encoder,
+  uint32_t partitionId, /*  debugging  */
+  unsigned char *buffer,
+  uint32_t *dataLength, /* in/out */
+  uint32_t bufferLength /* for debug */
+)
+{
+  const uint32_t overallHeaderSize = cipherTypeToHeaderSize(encoder->cipherType);
+
+  EVP_CIPHER_CTX    *ctx   = encoder->cipherContext;
   unsigned char     *plainText = buffer;
-  os_uint32          plainTextLength = *dataLength;
-  c_bool result = TRUE;
+  uint32_t          plainTextLength = *dataLength;
+  bool result = true;
 
 
-  TRACE((":ENCRYPT:'%s'(%d)",encoder->partitionName, partitionId));
+  DDS_TRACE(":ENCRYPT:'%s'(%d)",encoder->partitionName, partitionId);
 
   (void) bufferLength;
 
   switch (encoder->cipherType) {
         case Q_CIPHER_NULL: {
-            const os_uint32 symCipherHeaderLength = sizeof(C_STRUCT(q_nullHeader));
+            const uint32_t symCipherHeaderLength = sizeof(struct q_nullHeader);
 
             q_nullHeader symCipherHeader = &((encoder->securityHeader).u.null);
 
@@ -1307,7 +1682,7 @@ static c_bool q_securityEncodeInPlace_Generic
             attachHeader(plainText, plainTextLength,
                          symCipherHeader, symCipherHeaderLength);
 
-            TRACE((":NULL:%s", result?"OK":"ERROR")); /* debug */
+            DDS_TRACE(":NULL:%s", result?"OK":"ERROR"); /* debug */
 
             DUMP_BUFFER(encoder->partitionName, partitionId, buffer, *dataLength+overallHeaderSize, "<-encode", NULL,
                         Q_NULL_COUNTER_SIZE, bufferLength);
@@ -1315,7 +1690,7 @@ static c_bool q_securityEncodeInPlace_Generic
         break;
 
         case Q_CIPHER_BLOWFISH: {
-            const os_uint32    symCipherHeaderLength = sizeof(C_STRUCT(q_blowfishHeader));
+            const uint32_t    symCipherHeaderLength = sizeof(struct q_blowfishHeader);
             q_blowfishHeader  symCipherHeader = &((encoder->securityHeader).u.blowfish);
             unsigned char     *counter = symCipherHeader->counter;
 
@@ -1329,9 +1704,9 @@ static c_bool q_securityEncodeInPlace_Generic
             result = counterEncryptOrDecryptInPlace(ctx,
                                                     counter,
                                                     plainText,
-                                                    (int) (plainTextLength + sizeof(C_STRUCT(q_sha1Header))));
+                                                    (int) (plainTextLength + sizeof(struct q_sha1Header)));
 
-            TRACE((":BLF:%s", result?"OK":"ERROR")); /* debug */
+            DDS_TRACE(":BLF:%s", result?"OK":"ERROR"); /* debug */
 
             DUMP_BUFFER(encoder->partitionName, partitionId, buffer, *dataLength+overallHeaderSize, "<-encode", counter,
                         Q_BLOWFISH_COUNTER_SIZE, bufferLength);
@@ -1341,7 +1716,7 @@ static c_bool q_securityEncodeInPlace_Generic
         case Q_CIPHER_AES128:
         case Q_CIPHER_AES192:
         case Q_CIPHER_AES256: {
-            const os_uint32    symCipherHeaderLength = sizeof(C_STRUCT(q_aesHeader));
+            const uint32_t    symCipherHeaderLength = sizeof(struct q_aesHeader);
             q_aesHeader       symCipherHeader = &((encoder->securityHeader).u.aes);
             unsigned char     *counter = symCipherHeader->counter;
 
@@ -1355,39 +1730,56 @@ static c_bool q_securityEncodeInPlace_Generic
             result = counterEncryptOrDecryptInPlace(ctx,
                                                     counter,
                                                     plainText,
-                                                    (int) (plainTextLength + sizeof(C_STRUCT(q_sha1Header))));
+                                                    (int) (plainTextLength + sizeof(struct q_sha1Header)));
 
-            TRACE((":AES:%s", result?"OK":"ERROR")); /* debug */
+            DDS_TRACE(":AES:%s", result?"OK":"ERROR"); /* debug */
 
             DUMP_BUFFER(encoder->partitionName, partitionId, buffer, *dataLength+overallHeaderSize, "<-encode", counter,
                         Q_AES_COUNTER_SIZE, bufferLength);
         }
         break;
+
+        case Q_CIPHER_AES128_GCM:
+        case Q_CIPHER_AES256_GCM:
+        case Q_CIPHER_CHACHA20_POLY1305: {
+            ddsrt_iovec_t plain;
+            uint32_t cipherTextLength;
+
+            plain.iov_base = plainText;
+            plain.iov_len = plainTextLength;
+
+            /* stream ciphers: the cipher text has the length of the plain text */
+            result = q_securityAeadEncrypt(encoder, &plain, 1, plainText, &cipherTextLength);
+            assert(!result || cipherTextLength == plainTextLength);
+
+            DDS_TRACE(":AEAD:%s", result?"OK":"ERROR"); /* debug */
+        }
+        break;
         default:
             assert(0 && "do not reach");
   }
-  TRACE((":(%d->%d)", *dataLength, *dataLength + overallHeaderSize));
+  DDS_TRACE(":(%d->%d)", *dataLength, *dataLength + overallHeaderSize);
 
   *dataLength += overallHeaderSize;
   return result;
 }
 
 
-static c_bool q_securityDecodeInPlace_Generic
+static bool q_securityDecodeInPlace_Generic
 (
   q_securityPartitionDecoder decoder,
-  os_uint32 partitionId,
+  uint32_t partitionId,
   unsigned char *buffer,
-  os_uint32 *dataLength,          /* in/out */
+  uint32_t *dataLength,          /* in/out */
   q_cipherType sendersCipherType,
-  os_uint32 bufferLength
+  uint32_t bufferLength
 )
 {
-    const os_uint32 overallHeaderSize = cipherTypeToHeaderSize(sendersCipherType);
-    EVP_CIPHER_CTX *ctx = &(decoder->cipherContext);
-    c_bool result = TRUE;
+    const uint32_t overallHeaderSize = cipherTypeToHeaderSize(sendersCipherType);
+    EVP_CIPHER_CTX *ctx = decoder->cipherContext;
+    bool result = true;
 
-    TRACE((":DECRYPT:'%s'(%d)",decoder->partitionName, partitionId));
+    DDS_TRACE(":DECRYPT:'%s'(%d)",decoder->partitionName, partitionId);
 
     (void) bufferLength;
 
@@ -1399,7 +1791,7 @@ static c_bool q_securityDecodeInPlace_Generic
                         Q_NULL_COUNTER_SIZE, bufferLength);
 
             /* nothing todo here, just decreasing the buffer length at end of this function */
-            TRACE((":NULL:%s", result?"OK":"ERROR")); /* debug */
+            DDS_TRACE(":NULL:%s", result?"OK":"ERROR"); /* debug */
 
             DUMP_BUFFER(decoder->partitionName, partitionId, buffer, *dataLength - overallHeaderSize, "<-decode",
                         NULL,
@@ -1409,16 +1801,16 @@ static c_bool q_securityDecodeInPlace_Generic
 
         case Q_CIPHER_BLOWFISH:
         {
-            const os_uint32 sha1HeaderLength = sizeof(C_STRUCT(q_sha1Header));
-            const os_uint32 cipherTextLength = *dataLength - overallHeaderSize + sha1HeaderLength;
-            C_STRUCT(q_blowfishHeader) symCipherHeader;
+            const uint32_t sha1HeaderLength = sizeof(struct q_sha1Header);
+            const uint32_t cipherTextLength = *dataLength - overallHeaderSize + sha1HeaderLength;
+            struct q_blowfishHeader symCipherHeader;
 
             void *cipherText       = buffer;
             void *sha1HeaderStart  = &(buffer[*dataLength - overallHeaderSize]);
             void *symCipherHeaderStart  = &(buffer[*dataLength - overallHeaderSize + sha1HeaderLength]);
 
             /* copy from buffer into aligned memory */
-            memcpy(&symCipherHeader, symCipherHeaderStart, sizeof(C_STRUCT(q_blowfishHeader)));
+            memcpy(&symCipherHeader, symCipherHeaderStart, sizeof(struct q_blowfishHeader));
 
             DUMP_BUFFER(decoder->partitionName, partitionId, buffer, *dataLength, "decode->", symCipherHeader.counter,Q_BLOWFISH_COUNTER_SIZE, bufferLength);
 
@@ -1430,7 +1822,7 @@ static c_bool q_securityDecodeInPlace_Generic
             if (result) {
                 /* will zero out the sha1Header values in buffer */
                 result = verifySha1(cipherText, *dataLength, sha1HeaderStart);
-                TRACE((":BLF:%s", result?"OK":"ERROR")); /* debug */
+                DDS_TRACE(":BLF:%s", result?"OK":"ERROR"); /* debug */
                 if (!result) {
                     DDS_WARNING("Incoming encrypted sub-message dropped: Decrypt (blowfish) verification failed for partition '%s' - possible Key-mismatch\n", decoder->partitionName);
                 }
@@ -1444,16 +1836,16 @@ static c_bool q_securityDecodeInPlace_Generic
         case Q_CIPHER_AES192:
         case Q_CIPHER_AES256:
         {
-            const os_uint32 sha1HeaderLength = sizeof(C_STRUCT(q_sha1Header));
-            const os_uint32 cipherTextLength = *dataLength - overallHeaderSize + sha1HeaderLength;
-            C_STRUCT(q_aesHeader) symCipherHeader;
+            const uint32_t sha1HeaderLength = sizeof(struct q_sha1Header);
+            const uint32_t cipherTextLength = *dataLength - overallHeaderSize + sha1HeaderLength;
+            struct q_aesHeader symCipherHeader;
 
             void *cipherText = buffer;
             void *sha1HeaderStart = &(buffer[*dataLength - overallHeaderSize]);
             void *symCipherHeaderStart  = &(buffer[*dataLength - overallHeaderSize + sha1HeaderLength]);
 
             /* copy from buffer into aligned memory */
-            memcpy(&symCipherHeader, symCipherHeaderStart, sizeof(C_STRUCT(q_aesHeader)));
+            memcpy(&symCipherHeader, symCipherHeaderStart, sizeof(struct q_aesHeader));
 
             DUMP_BUFFER(decoder->partitionName, partitionId, buffer, *dataLength, "decode->",symCipherHeader.counter, Q_AES_COUNTER_SIZE, bufferLength);
 
@@ -1474,6 +1866,19 @@ static c_bool q_securityDecodeInPlace_Generic
             DUMP_BUFFER(decoder->partitionName, partitionId, buffer, *dataLength - overallHeaderSize, "<-decode", symCipherHeader.counter, Q_AES_COUNTER_SIZE, bufferLength);
         }
         break;
+
+        case Q_CIPHER_AES128_GCM:
+        case Q_CIPHER_AES256_GCM:
+        case Q_CIPHER_CHACHA20_POLY1305:
+        {
+            /* the tag covers payload, cipher type and partition: no digest */
+            result = q_securityAeadDecrypt(decoder, buffer, *dataLength - overallHeaderSize);
+            DDS_TRACE(":AEAD:%s", result?"OK":"ERROR"); /* debug */
+            if (!result) {
+                DDS_WARNING("Incoming encrypted sub-message dropped: Decrypt (%s) verification failed for partition '%s' - possible Key-mismatch\n", cipherTypeAsString(sendersCipherType), decoder->partitionName);
+            }
+        }
+        break;
         default:
             assert(0 && "do not reach");
     }
@@ -1487,60 +1892,74 @@ static c_bool q_securityDecodeInPlace_Generic
 
 
 
-/* returns 0 on error, otherwise 1,
-   @param codec the security context object
-   @param partitionId defines the security policy to be used
-   @param buffer with content, with reserved space at end
-   @param fragmentLength overall length of buffer
-   @param dataLength the occupied space of buffer, must leave enough space for security attribute header */
-
-static c_bool q_securityEncodeInPlace
+/* returns the encoder for the partition, or NULL if sending is blocked */
+static q_securityPartitionEncoder q_securityLookupEncoder
 (
   q_securityEncoderSet codec,
-  os_uint32 partitionId,
-  void *buffer,
-  os_uint32 fragmentLength,
-  os_uint32 *dataLength /* in/out */
+  uint32_t partitionId
 )
 {
     q_securityPartitionEncoder encoder = NULL;
-    os_uint32    overallHeaderSize;
-    c_bool result = FALSE;
 
     assert(codec);
 
-
     if (partitionId == 0 || partitionId > codec->nofPartitions) {
         /* if partitionId is larger than number of partitions, network service
          * seems to be in undefined state */
         DDS_ERROR("q_securityEncodeInPlace:Sending message blocked, bad partitionid '%d'\n",
                           partitionId);
-        return FALSE;
+        return NULL;
     }
 
     encoder = &(codec->encoders[partitionId-1]);
 
-
     if (encoderIsBlocked(encoder)) {
         DDS_ERROR("q_securityEncodeInPlace:Sending message blocked, encoder of partitionid '%d' in bad state\n",
                           partitionId);
-        return FALSE;
+        return NULL;
+    }
+
+    return encoder;
+}
+
+/* returns 0 on error, otherwise 1,
+   @param codec the security context object
+   @param partitionId defines the security policy to be used
+   @param buffer with content, with reserved space at end
+   @param fragmentLength overall length of buffer
+   @param dataLength the occupied space of buffer, must leave enough space for security attribute header */
+
+static bool q_securityEncodeInPlace
+(
+  q_securityEncoderSet codec,
+  uint32_t partitionId,
+  void *buffer,
+  uint32_t fragmentLength,
+  uint32_t *dataLength /* in/out */
+)
+{
+    q_securityPartitionEncoder encoder = NULL;
+    uint32_t    overallHeaderSize;
+    bool result = false;
+
+    if ((encoder = q_securityLookupEncoder(codec, partitionId)) == NULL) {
+        return false;
     }
 
     if (*dataLength <= 0) {
         DDS_WARNING("q_securityEncodeInPlace:encoder called with empty buffer\n");
-        return FALSE;
+        return false;
     }
 
     overallHeaderSize = cipherTypeToHeaderSize(encoder->cipherType);
 
     if (*dataLength + overallHeaderSize  > fragmentLength) {
-        DDS_ERROR("q_securityEncodeInPlace:sending message of %"PA_PRIu32" bytes overlaps with reserved space of %"PA_PRIu32" bytes\n",
+        DDS_ERROR("q_securityEncodeInPlace:sending message of %"PRIu32" bytes overlaps with reserved space of %"PRIu32" bytes\n",
                           *dataLength, overallHeaderSize);
-        return FALSE;
+        return false;
     }
 
-    assert(sizeof(os_uint32) == sizeof(os_uint32));
+    assert(sizeof(uint32_t) == sizeof(uint32_t));
 
     /* do the encoding now */
     result = q_securityEncodeInPlace_Generic(encoder, partitionId, buffer, dataLength, fragmentLength);
@@ -1548,29 +1967,29 @@ static c_bool q_securityEncodeInPlace
     return result;
 }
 
-static c_bool q_securityGetHashFromCipherText
+static bool q_securityGetHashFromCipherText
 (
   unsigned char*  buffer,
-  os_uint32       dataLength,
-  os_uint32       *hash,
+  uint32_t       dataLength,
+  uint32_t       *hash,
   q_cipherType    *sendersCipherType
 )
 {
-    C_STRUCT(q_nullHeader) header;
+    struct q_nullHeader header;
 
-    const os_uint32 headerSize = sizeof(C_STRUCT(q_nullHeader));
+    const uint32_t headerSize = sizeof(struct q_nullHeader);
 
     unsigned char* end = NULL;
 
     assert(dataLength >= headerSize);
-    assert(sizeof(os_uint32) == sizeof(os_uint32));
+    assert(sizeof(uint32_t) == sizeof(uint32_t));
 
     end = &(buffer[dataLength - headerSize]);
 
     memcpy(&header, end, headerSize);
     *hash = ntohl(header.partitionId);
     *sendersCipherType = ntohl(header.cipherType);
-    return TRUE;
+    return true;
 }
 
 /* returns 0 on error, otherwise 1,
@@ -1578,7 +1997,7 @@ static c_bool q_securityGetHashFromCipherText
    @param buffer containing the ciphertext
    @param fragmentLength overall length of buffer
    @param dataLength the occupied space within buffer, on return it contains the length of plaintext in buffer */
-static c_bool q_securityDecodeInPlace
+static bool q_securityDecodeInPlace
 (
   q_securityDecoderSet codec,
   void *buffer,
@@ -1587,16 +2006,21 @@ static c_bool q_securityDecodeInPlace
 )
 {
     q_securityPartitionDecoder decoder = NULL;
-    c_bool result = FALSE;
-    os_uint32 hash;
-    os_uint32 partitionId = 0;
-    os_uint32 dataLength32 = (os_uint32) *dataLength;
-    os_uint32 overallHeaderSize;
+    bool result = false;
+    uint32_t hash;
+    uint32_t partitionId = 0;
+    uint32_t dataLength32 = (uint32_t) *dataLength;
+    uint32_t overallHeaderSize;
     q_cipherType sendersCipherType;
     struct config_networkpartition_listelem *p = config.networkPartitions;
 
     assert(codec);
 
+    if (*dataLength < sizeof(struct q_nullHeader)) {
+        DDS_WARNING("Incoming encrypted sub-message dropped: submessage too small (%"PRIuSIZE" bytes)\n", *dataLength);
+        return false;
+    }
+
     q_securityGetHashFromCipherText(buffer,dataLength32,&hash,&sendersCipherType);
 
     /* lookup hash in config to determine partitionId */
@@ -1607,7 +2031,7 @@ static c_bool q_securityDecodeInPlace
 
     if ((partitionId < 1) || (partitionId > codec->nofPartitions)) {
         DDS_WARNING("Incoming encrypted sub-message dropped, bad partition hash '%u'\n", hash);
-        return FALSE;
+        return false;
     }
 
     decoder = &(codec->decoders[partitionId-1]);
@@ -1616,19 +2040,19 @@ static c_bool q_securityDecodeInPlace
 
     if (sendersCipherType!=decoder->cipherType) {
         DDS_WARNING("Incoming encrypted sub-message dropped: cipherType mismatch (%d != %d) for partition '%s'\n", sendersCipherType,decoder->cipherType, decoder->partitionName);
-        return FALSE;
+        return false;
     }
     if (decoderIsBlocked(decoder)) {
         DDS_WARNING("Incoming encrypted sub-message dropped: decoder is blocked for partition '%s'\n", decoder->partitionName);
-        return FALSE;
+        return false;
     }
 
     if (overallHeaderSize > dataLength32) {
-        DDS_WARNING("Incoming encrypted sub-message dropped: submessage too small(%"PA_PRIu32" bytes),for partition '%s'\n", dataLength32, decoder->partitionName);
-        return FALSE;
+        DDS_WARNING("Incoming encrypted sub-message dropped: submessage too small(%"PRIu32" bytes),for partition '%s'\n", dataLength32, decoder->partitionName);
+        return false;
     }
 
-    result = q_securityDecodeInPlace_Generic(decoder, partitionId, buffer, &dataLength32, sendersCipherType, (os_uint32) fragmentLength);
+    result = q_securityDecodeInPlace_Generic(decoder, partitionId, buffer, &dataLength32, sendersCipherType, (uint32_t) fragmentLength);
     *dataLength = dataLength32;
 
     return result;
@@ -1642,16 +2066,20 @@ static c_bool q_securityDecodeInPlace
  * Buffer is encrypted and will be the new third iov.
  * The size of the encrypted data is set in the second iov as the "octets to next message"
  *
+ * AEAD ciphers encrypt straight from iov[2..n] into the buffer, so the payload
+ * is touched only once. (The iovs themselves can't be encrypted in place: they
+ * reference serialized samples that are shared with the WHC and other
+ * destinations.)
  */
 
-static os_ssize_t q_security_sendmsg
+static ssize_t q_security_sendmsg
 (
   ddsi_tran_conn_t conn,
   const nn_locator_t *dst,
-  size_t niov, os_iovec_t *iov,
+  size_t niov, ddsrt_iovec_t *iov,
   q_securityEncoderSet *codec,
-  os_uint32 encoderId,
-  os_uint32 flags
+  uint32_t encoderId,
+  uint32_t flags
 )
 {
   char stbuf[2048], *buf;
@@ -1659,17 +2087,25 @@ static os_ssize_t q_security_sendmsg
   uint32_t sz32, data_size32;
   ssize_t ret = Q_ERR_UNSPECIFIED;
   PT_InfoContainer_t * securityHeader;
+  q_securityPartitionEncoder encoder;
+  bool encoded;
   unsigned i;
 
   assert (niov > 2);
   securityHeader = iov[1].iov_base;
+  if ((encoder = q_securityLookupEncoder (*codec, encoderId)) == NULL)
+  {
+    return ret;
+  }
   /* first determine the size of the message, then select the
      on-stack buffer or allocate one on the heap ... */
   sz = q_securityEncoderSetHeaderSize (*codec); /* reserve appropriate headersize */
+  data_size = 0;
   for (i = 2; i < niov; i++)
   {
-    sz += iov[i].iov_len;
+    data_size += iov[i].iov_len;
   }
+  sz += data_size;
   if (sz <= sizeof (stbuf))
   {
     buf = stbuf;
@@ -1678,39 +2114,45 @@ static os_ssize_t q_security_sendmsg
   {
     buf = ddsrt_malloc (sz);
   }
-  /* ... then copy data into buffer */
-  data_size = 0;
-  for (i = 2; i < niov; i++)
-  {
-    memcpy (buf + data_size, iov[i].iov_base, iov[i].iov_len);
-    data_size += iov[i].iov_len;
-  }
-  sz = data_size + q_securityEncoderSetHeaderSize (*codec);
   assert(sz <= UINT32_MAX);
   sz32 = (uint32_t) sz;
   data_size32 = (uint32_t) data_size;
 
-  /* Encrypt the buf in place with the given encoder */
+  if (Q_CIPHER_IS_AEAD (encoder->cipherType))
+  {
+    /* Encrypt from the iovs into buf, appending the header */
+    encoded = q_securityAeadEncrypt (encoder, iov + 2, niov - 2, (unsigned char *) buf, &data_size32);
+    data_size32 += (uint32_t) sizeof (struct q_aeadHeader);
+  }
+  else
+  {
+    /* Copy data into buffer and encrypt the buf in place with the given encoder */
+    data_size = 0;
+    for (i = 2; i < niov; i++)
+    {
+      memcpy (buf + data_size, iov[i].iov_base, iov[i].iov_len);
+      data_size += iov[i].iov_len;
+    }
+    encoded = q_securityEncodeInPlace (*codec, encoderId, buf, sz32, &data_size32);
+  }
 
-  if (q_securityEncodeInPlace (*codec, encoderId, buf, sz32, &data_size32))
+  if (encoded)
   {
-    os_size_t nbytes;
     /* replace encrypted buffer into iov */
 
     iov[2].iov_base = buf;
-    iov[2].iov_len = data_size;
+    iov[2].iov_len = data_size32;
     niov = 3;
     /* correct size in security header */
-    securityHeader->smhdr.octetsToNextHeader = (unsigned short) (data_size + 4);
+    securityHeader->smhdr.octetsToNextHeader = (unsigned short) (data_size32 + 4);
 
     /* send the encrypted data to the connection */
 
-    nbytes = message->msg_iov[0].iov_len + message->msg_iov[1].iov_len + message->msg_iov[2].iov_len;
     if (!gv.mute)
       ret = ddsi_conn_write (conn, dst, niov, iov, flags);
     else
     {
-      TRACE (("(dropped)"));
+      DDS_TRACE("(dropped)");
       ret = (ssize_t) (iov[0].iov_len + iov[1].iov_len + iov[2].iov_len);
     }
   }
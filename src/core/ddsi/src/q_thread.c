@@ -122,7 +122,9 @@ static struct thread_state1 *find_thread_state (ddsrt_thread_t tid)
   if (thread_states.ts) {
     unsigned i;
     for (i = 0; i < thread_states.nthreads; i++) {
-      if (ddsrt_thread_equal (thread_states.ts[i].tid, tid)) {
+      /* a free slot retains the id of the thread that last used it, and
+         thread ids get reused */
+      if (thread_states.ts[i].state != THREAD_STATE_ZERO && ddsrt_thread_equal (thread_states.ts[i].tid, tid)) {
         return &thread_states.ts[i];
       }
     }
@@ -269,8 +271,15 @@ dds_retcode_t create_thread (struct thread_state1 **ts1, const char *name, uint3
     tattr.schedClass = tprops->sched_class; /* explicit default value in the enum */
     if (!tprops->stack_size.isdefault)
       tattr.stackSize = tprops->stack_size.value;
+    tattr.ncpus = tprops->cpuset.n;
+    tattr.cpus = tprops->cpuset.cpus;
   }
-  DDS_TRACE("create_thread: %s: class %d priority %"PRId32" stack %"PRIu32"\n", name, (int) tattr.schedClass, tattr.schedPriority, tattr.stackSize);
+  DDS_TRACE("create_thread: %s: class %d priority %"PRId32" stack %"PRIu32" cpus", name, (int) tattr.schedClass, tattr.schedPriority, tattr.stackSize);
+  if (tattr.ncpus == 0)
+    DDS_TRACE(" any");
+  for (uint32_t i = 0; i < tattr.ncpus; i++)
+    DDS_TRACE("%s%"PRIu32, (i == 0) ? " " : ",", tattr.cpus[i]);
+  DDS_TRACE("\n");
 
   if (ddsrt_thread_create (&tid, name, &tattr, &create_thread_wrapper, ctxt) != DDS_RETCODE_OK)
   {
@@ -11,12 +11,14 @@
  */
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
 
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_ephash.h"
 #include "dds/ddsi/q_addrset.h"
 #include "dds/ddsi/q_xmsg.h"
 #include "dds/ddsi/q_bswap.h"
@@ -86,10 +88,51 @@ static void writer_hbcontrol_note_hb (struct writer *wr, nn_mtime_t tnow, int an
   hbc->hbs_since_last_write++;
 }
 
+static int64_t writer_hbcontrol_base_intv (const struct writer *wr)
+{
+  /* Fixed base interval, unless adapting to the measured round-trip
+     times, in which case it is twice the largest retransmit timeout
+     of the readers (the heartbeat goes to all of them) */
+  int64_t intv;
+  if (!config.rtt_adaptive_timing || ddsrt_avl_is_empty (&wr->readers) || root_rdmatch (wr)->max_rto == 0)
+    return config.const_hb_intv_sched;
+  intv = 2 * root_rdmatch (wr)->max_rto;
+  if (intv < config.const_hb_intv_sched_min)
+    intv = config.const_hb_intv_sched_min;
+  else if (intv > config.const_hb_intv_sched_max)
+    intv = config.const_hb_intv_sched_max;
+  return intv;
+}
+
+void writer_hbcontrol_note_rtt (struct writer *wr, struct wr_prd_match *m, int64_t rtt)
+{
+  /* Smoothed round-trip time and mean deviation as used by TCP
+     (RFC 6298); 0 is reserved for "unknown" */
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (rtt <= 0)
+    rtt = 1;
+  if (m->rtt_srtt == 0)
+  {
+    m->rtt_srtt = rtt;
+    m->rtt_var = rtt / 2;
+  }
+  else
+  {
+    const int64_t err = rtt - m->rtt_srtt;
+    m->rtt_var += ((err < 0) ? -err : err) / 4 - m->rtt_var / 4;
+    m->rtt_srtt += err / 8;
+    if (m->rtt_srtt <= 0)
+      m->rtt_srtt = 1;
+  }
+  m->rto = m->rtt_srtt + 4 * m->rtt_var;
+  ddsrt_avl_augment_update (&wr_readers_treedef, m);
+  DDS_TRACE(" rtt %gs srtt %gs rto %gs (wr "PGUIDFMT")", (double) rtt / 1e9, (double) m->rtt_srtt / 1e9, (double) m->rto / 1e9, PGUID (wr->e.guid));
+}
+
 int64_t writer_hbcontrol_intv (const struct writer *wr, const struct whc_state *whcst, UNUSED_ARG (nn_mtime_t tnow))
 {
   struct hbcontrol const * const hbc = &wr->hbcontrol;
-  int64_t ret = config.const_hb_intv_sched;
+  int64_t ret = writer_hbcontrol_base_intv (wr);
   size_t n_unacked;
 
   if (hbc->hbs_since_last_write > 2)
@@ -122,7 +165,7 @@ void writer_hbcontrol_note_asyncwrite (struct writer *wr, nn_mtime_t tnow)
 
   /* We know this is new data, so we want a heartbeat event after one
      base interval */
-  tnext.v = tnow.v + config.const_hb_intv_sched;
+  tnext.v = tnow.v + writer_hbcontrol_base_intv (wr);
   if (tnext.v < hbc->tsched.v)
   {
     /* Insertion of a message with WHC locked => must now have at
@@ -233,7 +276,7 @@ struct nn_xmsg *writer_hbcontrol_create_heartbeat (struct writer *wr, const stru
 static int writer_hbcontrol_ack_required_generic (const struct writer *wr, const struct whc_state *whcst, nn_mtime_t tlast, nn_mtime_t tnow, int piggyback)
 {
   struct hbcontrol const * const hbc = &wr->hbcontrol;
-  const int64_t hb_intv_ack = config.const_hb_intv_sched;
+  const int64_t hb_intv_ack = writer_hbcontrol_base_intv (wr);
   assert(wr->heartbeat_xevent != NULL && whcst != NULL);
 
   if (piggyback)
@@ -331,7 +374,7 @@ void add_Heartbeat (struct nn_xmsg *msg, struct writer *wr, const struct whc_sta
   assert (wr->reliable);
   assert (hbansreq >= 0);
 
-  if (config.meas_hb_to_ack_latency)
+  if (config.meas_hb_to_ack_latency || config.rtt_adaptive_timing)
   {
     /* If configured to measure heartbeat-to-ack latency, we must add
        a timestamp.  No big deal if it fails. */
@@ -387,7 +430,25 @@ void add_Heartbeat (struct nn_xmsg *msg, struct writer *wr, const struct whc_sta
   nn_xmsg_submsg_setnext (msg, sm_marker);
 }
 
-static int create_fragment_message_simple (struct writer *wr, seqno_t seq, struct ddsi_serdata *serdata, struct nn_xmsg **pmsg)
+int add_Gap (struct nn_xmsg *msg, struct writer *wr, struct proxy_reader *prd, seqno_t start, seqno_t base, uint32_t numbits, const uint32_t *bits)
+{
+  struct nn_xmsg_marker sm_marker;
+  Gap_t *gap;
+  ASSERT_MUTEX_HELD (wr->e.lock);
+  assert (numbits > 0);
+  gap = nn_xmsg_append (msg, &sm_marker, GAP_SIZE (numbits));
+  nn_xmsg_submsg_init (msg, sm_marker, SMID_GAP);
+  gap->readerId = nn_hton_entityid (prd->e.guid.entityid);
+  gap->writerId = nn_hton_entityid (wr->e.guid.entityid);
+  gap->gapStart = toSN (start);
+  gap->gapList.bitmap_base = toSN (base);
+  gap->gapList.numbits = numbits;
+  memcpy (gap->gapList.bits, bits, NN_SEQUENCE_NUMBER_SET_BITS_SIZE (numbits));
+  nn_xmsg_submsg_setnext (msg, sm_marker);
+  return 0;
+}
+
+static int create_fragment_message_simple (struct writer *wr, seqno_t seq, struct ddsi_serdata *serdata, struct addrset *as, struct nn_xmsg **pmsg)
 {
 #define TEST_KEYHASH 0
   /* actual expected_inline_qos_size is typically 0, but always claiming 32 bytes won't make
@@ -424,7 +485,10 @@ static int create_fragment_message_simple (struct writer *wr, seqno_t seq, struc
   nn_xmsg_setencoderid (*pmsg, wr->partition_id);
 #endif
 
-  nn_xmsg_setdstN (*pmsg, wr->as, wr->as_group);
+  if (as)
+    nn_xmsg_setdstN (*pmsg, as, NULL);
+  else
+    nn_xmsg_setdstN (*pmsg, wr->as, wr->as_group);
   nn_xmsg_setmaxdelay (*pmsg, nn_from_ddsi_duration (wr->xqos->latency_budget.duration));
   nn_xmsg_add_timestamp (*pmsg, serdata->timestamp);
   data = nn_xmsg_append (*pmsg, &sm_marker, sizeof (Data_t));
@@ -461,15 +525,28 @@ static int create_fragment_message_simple (struct writer *wr, seqno_t seq, struc
   return 0;
 }
 
-int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, struct proxy_reader *prd, struct nn_xmsg **pmsg, int isnew)
+static unsigned max_fragments_per_message (void)
+{
+  /* Leave room for the RTPS header, an INFO_DST, an INFO_TS, the
+     DATAFRAG submessage header and some inline QoS */
+  const uint32_t overhead = 20 + 16 + 12 + 36 + 32;
+  uint32_t n;
+  if (!config.retransmit_multiple_fragments || config.max_msg_size < overhead + 2 * config.fragment_size)
+    return 1;
+  n = (config.max_msg_size - overhead) / config.fragment_size;
+  return (n > UINT16_MAX) ? UINT16_MAX : n;
+}
+
+int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, unsigned nfrags, struct proxy_reader *prd, struct addrset *as, struct nn_xmsg **pmsg, int isnew)
 {
   /* We always fragment into FRAGMENT_SIZEd fragments, which are near
-     the smallest allowed fragment size & can't be bothered (yet) to
-     put multiple fragments into one DataFrag submessage if it makes
-     sense to send large messages, as it would e.g. on GigE with jumbo
-     frames.  If the sample is small enough to fit into one Data
-     submessage, we require fragnum = 0 & generate a Data instead of a
-     DataFrag.
+     the smallest allowed fragment size.  New data always goes out one
+     fragment per DataFrag submessage, but retransmits of consecutive
+     fragments are combined into a single one as long as the result
+     fits in a message of MaxMessageSize (if so configured): that is
+     what nfrags is for.  If the sample is small enough to fit into one
+     Data submessage, we require fragnum = 0 & generate a Data instead
+     of a DataFrag.
 
      Note: fragnum is 0-based here, 1-based in DDSI. But 0-based is
      much easier ...
@@ -484,10 +561,10 @@ int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_pli
   uint32_t fragstart, fraglen;
   enum nn_xmsg_kind xmsg_kind = isnew ? NN_XMSG_KIND_DATA : NN_XMSG_KIND_DATA_REXMIT;
   const uint32_t size = ddsi_serdata_size (serdata);
-  int ret = 0;
-  (void)plist;
+  int ret = 1;
 
   ASSERT_MUTEX_HELD (&wr->e.lock);
+  assert (nfrags > 0);
 
   if (fragnum * config.fragment_size >= size && size > 0)
   {
@@ -521,7 +598,10 @@ int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_pli
   }
   else
   {
-    nn_xmsg_setdstN (*pmsg, wr->as, wr->as_group);
+    if (as)
+      nn_xmsg_setdstN (*pmsg, as, NULL);
+    else
+      nn_xmsg_setdstN (*pmsg, wr->as, wr->as_group);
     nn_xmsg_setmaxdelay (*pmsg, nn_from_ddsi_duration (wr->xqos->latency_budget.duration));
   }
 
@@ -563,18 +643,24 @@ int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_pli
     nn_xmsg_submsg_init (*pmsg, sm_marker, SMID_DATA_FRAG);
     ddcmn->smhdr.flags = (unsigned char) (ddcmn->smhdr.flags | contentflag);
 
+    fragstart = fragnum * config.fragment_size;
+    if (nfrags > 1)
+    {
+      const unsigned maxfrags = max_fragments_per_message ();
+      const unsigned remaining = (size - fragstart + config.fragment_size - 1) / config.fragment_size;
+      if (nfrags > maxfrags)
+        nfrags = maxfrags;
+      if (nfrags > remaining)
+        nfrags = remaining;
+    }
+
     frag->fragmentStartingNum = fragnum + 1;
-    frag->fragmentsInSubmessage = 1;
+    frag->fragmentsInSubmessage = (unsigned short) nfrags;
     frag->fragmentSize = (unsigned short) config.fragment_size;
     frag->sampleSize = (uint32_t)size;
-
-    fragstart = fragnum * config.fragment_size;
-#if MULTIPLE_FRAGS_IN_SUBMSG /* ugly hack for testing only */
-    if (fragstart + config.fragment_size < ddsi_serdata_size (serdata) &&
-        fragstart + 2 * config.fragment_size >= ddsi_serdata_size (serdata))
-      frag->fragmentsInSubmessage++;
-    ret = frag->fragmentsInSubmessage;
-#endif
+    ret = (int) nfrags;
+    if (!isnew && nfrags > 1)
+      wr->rexmit_multifrag_count++;
 
     fraglen = config.fragment_size * frag->fragmentsInSubmessage;
     if (fragstart + fraglen > size)
@@ -587,7 +673,7 @@ int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_pli
          want it set for all so we can do merging. FIXME: I guess the
          writer should track both seq_xmit and the fragment number
          ... */
-      nn_xmsg_setwriterseq_fragid (*pmsg, &wr->e.guid, seq, fragnum + frag->fragmentsInSubmessage - 1);
+      nn_xmsg_setwriterseq_fragid (*pmsg, &wr->e.guid, seq, fragnum + frag->fragmentsInSubmessage - 1, frag->fragmentsInSubmessage);
     }
   }
 
@@ -614,6 +700,10 @@ int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_pli
     {
       nn_xmsg_addpar_statusinfo (*pmsg, serdata->statusinfo);
     }
+    if (plist != NULL)
+    {
+      nn_plist_addtomsg (*pmsg, plist, PP_COHERENT_SET, 0);
+    }
     rc = nn_xmsg_addpar_sentinel_ifparam (*pmsg);
     if (rc > 0)
     {
@@ -633,7 +723,7 @@ int create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_pli
   return ret;
 }
 
-static void create_HeartbeatFrag (struct writer *wr, seqno_t seq, unsigned fragnum, struct proxy_reader *prd, struct nn_xmsg **pmsg)
+static void create_HeartbeatFrag (struct writer *wr, seqno_t seq, unsigned fragnum, struct proxy_reader *prd, struct addrset *as, struct nn_xmsg **pmsg)
 {
   struct nn_xmsg_marker sm_marker;
   HeartbeatFrag_t *hbf;
@@ -653,6 +743,10 @@ static void create_HeartbeatFrag (struct writer *wr, seqno_t seq, unsigned fragn
       return;
     }
   }
+  else if (as)
+  {
+    nn_xmsg_setdstN (*pmsg, as, NULL);
+  }
   else
   {
     nn_xmsg_setdstN (*pmsg, wr->as, wr->as_group);
@@ -692,7 +786,7 @@ static int must_skip_frag (const char *frags_to_skip, unsigned frag)
 }
 #endif
 
-static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *wr, const struct whc_state *whcst, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew, unsigned nfrags)
+static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *wr, const struct whc_state *whcst, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, struct addrset *as, int isnew, unsigned nfrags)
 {
   unsigned i;
 #if 0
@@ -701,35 +795,34 @@ static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *
   assert(xp);
   assert((wr->heartbeat_xevent != NULL) == (whcst != NULL));
 
-  for (i = 0; i < nfrags; i++)
+  i = 0;
+  while (i < nfrags)
   {
     struct nn_xmsg *fmsg = NULL;
     struct nn_xmsg *hmsg = NULL;
     int ret;
 #if 0
     if (must_skip_frag (frags_to_skip, i))
+    {
+      i++;
       continue;
+    }
 #endif
     /* Ignore out-of-memory errors: we can't do anything about it, and
        eventually we'll have to retry.  But if a packet went out and
        we haven't yet completed transmitting a fragmented message, add
        a HeartbeatFrag. */
     ddsrt_mutex_lock (&wr->e.lock);
-    ret = create_fragment_message (wr, seq, plist, serdata, i, prd, &fmsg, isnew);
-    if (ret >= 0)
-    {
-      if (nfrags > 1 && i + 1 < nfrags)
-        create_HeartbeatFrag (wr, seq, i, prd, &hmsg);
-    }
+    ret = create_fragment_message (wr, seq, plist, serdata, i, isnew ? 1 : nfrags - i, prd, as, &fmsg, isnew);
+    if (ret < 0)
+      ret = 1;
+    else if (nfrags > 1 && i + (unsigned) ret < nfrags)
+      create_HeartbeatFrag (wr, seq, i + (unsigned) ret - 1, prd, as, &hmsg);
     ddsrt_mutex_unlock (&wr->e.lock);
 
     if(fmsg) nn_xpack_addmsg (xp, fmsg, 0);
     if(hmsg) nn_xpack_addmsg (xp, hmsg, 0);
-
-#if MULTIPLE_FRAGS_IN_SUBMSG /* ugly hack for testing only */
-    if (ret > 1)
-      i += ret-1;
-#endif
+    i += (unsigned) ret;
   }
 
   /* Note: wr->heartbeat_xevent != NULL <=> wr is reliable */
@@ -750,7 +843,7 @@ static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *
   }
 }
 
-static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr, const struct whc_state *whcst, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew)
+static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr, const struct whc_state *whcst, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, struct addrset *as, int isnew)
 {
   /* on entry: &wr->e.lock held; on exit: lock no longer held */
   struct nn_xmsg *fmsg;
@@ -764,10 +857,10 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
     uint32_t nfrags;
     ddsrt_mutex_unlock (&wr->e.lock);
     nfrags = (sz + config.fragment_size - 1) / config.fragment_size;
-    transmit_sample_lgmsg_unlocked (xp, wr, whcst, seq, plist, serdata, prd, isnew, nfrags);
+    transmit_sample_lgmsg_unlocked (xp, wr, whcst, seq, plist, serdata, prd, as, isnew, nfrags);
     return;
   }
-  else if (create_fragment_message_simple (wr, seq, serdata, &fmsg) < 0)
+  else if (create_fragment_message_simple (wr, seq, serdata, as, &fmsg) < 0)
   {
     ddsrt_mutex_unlock (&wr->e.lock);
     return;
@@ -792,7 +885,7 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
   }
 }
 
-int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew)
+int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, struct addrset *as, int isnew)
 {
   uint32_t i, sz, nfrags;
   int enqueued = 1;
@@ -806,19 +899,21 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_
     /* end-of-transaction messages are empty, but still need to be sent */
     nfrags = 1;
   }
-  for (i = 0; i < nfrags && enqueued; i++)
+  i = 0;
+  while (i < nfrags && enqueued)
   {
     struct nn_xmsg *fmsg = NULL;
     struct nn_xmsg *hmsg = NULL;
+    int ret;
     /* Ignore out-of-memory errors: we can't do anything about it, and
        eventually we'll have to retry.  But if a packet went out and
        we haven't yet completed transmitting a fragmented message, add
-       a HeartbeatFrag. */
-    if (create_fragment_message (wr, seq, plist, serdata, i, prd, &fmsg, isnew) >= 0)
-    {
-      if (nfrags > 1 && i + 1 < nfrags)
-        create_HeartbeatFrag (wr, seq, i, prd, &hmsg);
-    }
+       a HeartbeatFrag.  Retransmits combine fragments where possible. */
+    ret = create_fragment_message (wr, seq, plist, serdata, i, isnew ? 1 : nfrags - i, prd, as, &fmsg, isnew);
+    if (ret < 0)
+      ret = 1;
+    else if (nfrags > 1 && i + (unsigned) ret < nfrags)
+      create_HeartbeatFrag (wr, seq, i + (unsigned) ret - 1, prd, as, &hmsg);
     if (isnew)
     {
       if(fmsg) qxev_msg (wr->evq, fmsg);
@@ -842,6 +937,7 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_
           nn_xmsg_free (hmsg);
       }
     }
+    i += (unsigned) ret;
   }
   return enqueued ? 0 : -1;
 }
@@ -1018,11 +1114,121 @@ static int maybe_grow_whc (struct writer *wr)
   return 0;
 }
 
+bool writer_filter_accepts (const void *filter, const struct ddsi_serdata *serdata)
+{
+  void *sample;
+  bool ret;
+  /* if it can't be evaluated, the reader gets it and filters it itself */
+  if ((sample = ddsi_plugin.content_filter_sample_new (serdata)) == NULL)
+    return true;
+  ret = ddsi_plugin.content_filter_accepts (filter, sample);
+  ddsi_plugin.content_filter_sample_free (serdata, sample);
+  return ret;
+}
+
+static void writer_filter_send_gap (struct writer *wr, struct proxy_reader *prd, seqno_t seq)
+{
+  static const uint32_t zero = 0;
+  struct nn_xmsg *msg;
+  if ((msg = nn_xmsg_new (gv.xmsgpool, &wr->e.guid.prefix, 0, NN_XMSG_KIND_CONTROL)) == NULL)
+    return;
+#ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
+  nn_xmsg_setencoderid (msg, wr->partition_id);
+#endif
+  if (nn_xmsg_setdstPRD (msg, prd) < 0)
+  {
+    nn_xmsg_free (msg);
+    return;
+  }
+  add_Gap (msg, wr, prd, seq, seq + 1, 1, &zero);
+  DDS_TRACE ("filtered "PGUIDFMT" #%"PRId64" for "PGUIDFMT"\n", PGUID (wr->e.guid), seq, PGUID (prd->e.guid));
+  wr->filter_gap_count++;
+  qxev_msg (wr->evq, msg);
+}
+
+static struct addrset *writer_filter_destinations (struct writer *wr, seqno_t seq, const struct ddsi_serdata *serdata, void **sample)
+{
+  /* Returns NULL if the sample is to go to the writer's normal address
+     set, else an address set covering only those proxy readers that
+     accept the sample according to their content filter.  Reliable
+     readers that reject the sample get a GAP instead, so they don't
+     wait for it.  SAMPLE is the deserialized sample, it is normally
+     provided by the caller but created here if a filtered reader
+     matched in the meantime. */
+  ddsrt_avl_iter_t it;
+  struct wr_prd_match *m;
+  uint32_t naccept = 0, nreject = 0;
+  int changed;
+  nn_locator_t loc;
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (wr->num_filtered_readers == 0 || serdata->kind != SDK_DATA)
+    return NULL;
+  if (*sample == NULL && (*sample = ddsi_plugin.content_filter_sample_new (serdata)) == NULL)
+    return NULL;
+
+  changed = (wr->filter_as == NULL);
+  for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  {
+    const unsigned accept = (m->filter == NULL || ddsi_plugin.content_filter_accepts (m->filter, *sample));
+    if (accept != m->filter_accepted)
+    {
+      m->filter_accepted = accept ? 1 : 0;
+      changed = 1;
+    }
+    if (accept)
+      naccept++;
+    else
+      nreject++;
+  }
+
+  /* If the readers are reached via multicast, a single multicast costs
+     less than a unicast to each of several accepting readers, and the
+     rejecting readers filter it themselves */
+  if (nreject == 0 || (naccept > 1 && addrset_any_mc (wr->as, &loc)))
+  {
+    /* the cached address set no longer matches the readers' state */
+    if (changed && wr->filter_as)
+    {
+      unref_addrset (wr->filter_as);
+      wr->filter_as = NULL;
+    }
+    return NULL;
+  }
+
+  /* The destinations only depend on which readers accept the sample, and
+     that tends to remain the same from one sample to the next */
+  if (changed)
+  {
+    if (wr->filter_as)
+      unref_addrset (wr->filter_as);
+    wr->filter_as = new_addrset ();
+  }
+  for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  {
+    struct proxy_reader *prd;
+    if (!(changed || (!m->filter_accepted && m->is_reliable)))
+      continue;
+    if ((prd = ephash_lookup_proxy_reader_guid (&m->prd_guid)) == NULL)
+      continue;
+    if (!m->filter_accepted)
+    {
+      if (m->is_reliable)
+        writer_filter_send_gap (wr, prd, seq);
+    }
+    else if (addrset_any_uc (prd->c.as, &loc) || addrset_any_mc (prd->c.as, &loc))
+    {
+      add_to_addrset (wr->filter_as, &loc);
+    }
+  }
+  return ref_addrset (wr->filter_as);
+}
+
 static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct nn_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk, int end_of_txn, int gc_allowed)
 {
   int r;
   seqno_t seq;
   nn_mtime_t tnow;
+  void *filter_sample = NULL;
 
   /* If GC not allowed, we must be sure to never block when writing.  That is only the case for (true, aggressive) KEEP_LAST writers, and also only if there is no limit to how much unacknowledged data the WHC may contain. */
   assert(gc_allowed || (wr->xqos->history.kind == NN_KEEP_LAST_HISTORY_QOS && wr->whc_low == INT32_MAX));
@@ -1044,12 +1250,15 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     goto drop;
   }
 
-  ddsrt_mutex_lock (&wr->e.lock);
+  /* Content filters of proxy readers are evaluated on the deserialized
+     sample; deserializing it before locking the writer keeps that out of
+     the critical section.  Reading num_filtered_readers without holding
+     the lock is merely a hint: writer_filter_destinations deserializes
+     it if a filtered reader matched in the meantime. */
+  if (wr->num_filtered_readers > 0 && serdata->kind == SDK_DATA)
+    filter_sample = ddsi_plugin.content_filter_sample_new (serdata);
 
-  if (end_of_txn)
-  {
-    wr->cs_seq = 0;
-  }
+  ddsrt_mutex_lock (&wr->e.lock);
 
   /* If WHC overfull, block. */
   {
@@ -1095,6 +1304,13 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     plist->coherent_set_seqno = toSN (wr->cs_seq);
   }
 
+  /* The end-of-transaction sample is the last one that is part of the
+     coherent set */
+  if (end_of_txn)
+  {
+    wr->cs_seq = 0;
+  }
+
   if ((r = insert_sample_in_whc (wr, seq, plist, serdata, tk)) < 0)
   {
     /* Failure of some kind */
@@ -1110,7 +1326,20 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     /* Note the subtlety of enqueueing with the lock held but
        transmitting without holding the lock. Still working on
        cleaning that up. */
-    if (xp)
+    struct addrset *as = writer_filter_destinations (wr, seq, serdata, &filter_sample);
+    if (as && addrset_empty (as))
+    {
+      /* no remote reader interested: it is in the WHC for the
+         benefit of late-joiners, and the readers have been sent GAPs.
+         The GAPs stand in for the sample, so it counts as transmitted:
+         heartbeats must cover it and a lost GAP must be repeated in
+         response to a NACK for it. */
+      UPDATE_SEQ_XMIT_LOCKED (wr, seq);
+      if (wr->heartbeat_xevent)
+        writer_hbcontrol_note_asyncwrite (wr, tnow);
+      ddsrt_mutex_unlock (&wr->e.lock);
+    }
+    else if (xp)
     {
       /* If all reliable readers disappear between unlocking the writer and
        * creating the message, the WHC will free the plist (if any). Currently,
@@ -1132,7 +1361,7 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
         whc_get_state(wr->whc, &whcst);
         whcstptr = &whcst;
       }
-      transmit_sample_unlocks_wr (xp, wr, whcstptr, seq, plist_copy, serdata, NULL, 1);
+      transmit_sample_unlocks_wr (xp, wr, whcstptr, seq, plist_copy, serdata, NULL, as, 1);
       if (plist_copy)
         nn_plist_fini (plist_copy);
     }
@@ -1140,9 +1369,10 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     {
       if (wr->heartbeat_xevent)
         writer_hbcontrol_note_asyncwrite (wr, tnow);
-      enqueue_sample_wrlock_held (wr, seq, plist, serdata, NULL, 1);
+      enqueue_sample_wrlock_held (wr, seq, plist, serdata, NULL, as, 1);
       ddsrt_mutex_unlock (&wr->e.lock);
     }
+    unref_addrset (as);
 
     /* If not actually inserted, WHC didn't take ownership of plist */
     if (r == 0 && plist != NULL)
@@ -1153,11 +1383,45 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
   }
 
 drop:
+  if (filter_sample)
+    ddsi_plugin.content_filter_sample_free (serdata, filter_sample);
   /* FIXME: shouldn't I move the ddsi_serdata_unref call to the callers? */
   ddsi_serdata_unref (serdata);
   return r;
 }
 
+void writer_begin_coherent (struct writer *wr)
+{
+  ddsrt_mutex_lock (&wr->e.lock);
+  /* the first sample of the set will get the next sequence number */
+  if (wr->cs_seq == 0)
+    wr->cs_seq = wr->seq + 1;
+  ddsrt_mutex_unlock (&wr->e.lock);
+}
+
+int writer_end_coherent (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr)
+{
+  struct ddsi_serdata *marker;
+  ddsrt_mutex_lock (&wr->e.lock);
+  if (wr->cs_seq == 0 || wr->seq < wr->cs_seq)
+  {
+    /* no coherent set or nothing written, nothing to do */
+    wr->cs_seq = 0;
+    ddsrt_mutex_unlock (&wr->e.lock);
+    return 0;
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+
+  /* End-of-set marker: a sample without any content (so no instance,
+     either), only the coherent set id in the inline QoS tells the
+     readers the set is complete.  Writing a sample may block, so the
+     writer can't remain locked. */
+  marker = ddsi_serdata_from_sample (wr->topic, SDK_EMPTY, NULL);
+  marker->statusinfo = 0;
+  marker->timestamp = now ();
+  return write_sample_eot (ts1, xp, wr, NULL, marker, NULL, 1, 1);
+}
+
 int write_sample_gc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
   return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1);
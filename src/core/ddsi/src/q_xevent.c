@@ -64,6 +64,7 @@ enum xeventkind
   XEVK_SPDP,
   XEVK_PMD_UPDATE,
   XEVK_DELETE_WRITER,
+  XEVK_WHC_TRIM,
   XEVK_CALLBACK
 };
 
@@ -96,6 +97,9 @@ struct xevent
     struct {
       nn_guid_t guid;
     } delete_writer;
+    struct {
+      nn_guid_t wr_guid;
+    } whc_trim;
     struct {
       void (*cb) (struct xevent *ev, void *arg, nn_mtime_t tnow);
       void *arg;
@@ -142,6 +146,10 @@ struct xeventq {
   ddsrt_avl_tree_t msg_xevents;
   struct xevent_nt *non_timed_xmit_list_oldest;
   struct xevent_nt *non_timed_xmit_list_newest; /* undefined if ..._oldest == NULL */
+  /* retransmits are queued separately, so that pacing them doesn't hold
+     up the other "non-timed" xevents */
+  struct xevent_nt *rexmit_list_oldest;
+  struct xevent_nt *rexmit_list_newest; /* undefined if ..._oldest == NULL */
   size_t queued_rexmit_bytes;
   size_t queued_rexmit_msgs;
   size_t max_queued_rexmit_bytes;
@@ -152,6 +160,11 @@ struct xeventq {
   ddsrt_cond_t cond;
   ddsi_tran_conn_t tev_conn;
   uint32_t auxiliary_bandwidth_limit;
+
+  /* Retransmit pacing: a retransmit may go out once tnow >= rexmit_tnext,
+     rexmit_bandwidth_limit = 0 means no pacing */
+  uint32_t rexmit_bandwidth_limit;
+  nn_mtime_t rexmit_tnext;
 };
 
 static uint32_t xevent_thread (struct xeventq *xevq);
@@ -221,37 +234,71 @@ static void forget_msg (struct xeventq *evq, struct xevent_nt *ev)
   ddsrt_avl_delete (&msg_xevents_treedef, &evq->msg_xevents, ev);
 }
 
-static void add_to_non_timed_xmit_list (struct xeventq *evq, struct xevent_nt *ev)
+static void append_to_list (struct xevent_nt **oldest, struct xevent_nt **newest, struct xevent_nt *ev)
 {
   ev->listnode.next = NULL;
-  if (evq->non_timed_xmit_list_oldest == NULL) {
+  if (*oldest == NULL) {
     /* list is currently empty so add the first item (at the front) */
-    evq->non_timed_xmit_list_oldest = ev;
+    *oldest = ev;
   } else {
-    evq->non_timed_xmit_list_newest->listnode.next = ev;
+    (*newest)->listnode.next = ev;
   }
-  evq->non_timed_xmit_list_newest = ev;
+  *newest = ev;
+}
 
-  if (ev->kind == XEVK_MSG_REXMIT)
+static void add_to_non_timed_xmit_list (struct xeventq *evq, struct xevent_nt *ev)
+{
+  if (ev->kind != XEVK_MSG_REXMIT)
+    append_to_list (&evq->non_timed_xmit_list_oldest, &evq->non_timed_xmit_list_newest, ev);
+  else
+  {
+    append_to_list (&evq->rexmit_list_oldest, &evq->rexmit_list_newest, ev);
     remember_msg (evq, ev);
+  }
 
   ddsrt_cond_signal (&evq->cond);
 }
 
-static struct xevent_nt *getnext_from_non_timed_xmit_list  (struct xeventq *evq)
+/* A bit of a budget for bursts of retransmits, similar to the
+   bandwidth limiter in q_xmsg.c */
+#define REXMIT_PACING_MAX_BUFFER (30 * T_MILLISECOND)
+
+static int rexmit_list_is_paced (const struct xeventq *evq, nn_mtime_t tnow)
 {
-  /* function removes and returns the first item in the list
-     (from the front) and frees the container */
-  struct xevent_nt *ev = evq->non_timed_xmit_list_oldest;
-  if (ev != NULL)
+  /* Only retransmits are subject to pacing: timed events and the other
+     "non-timed" ones (ACKNACKs, heartbeats, GAPs sent in response to
+     requests) go out while retransmits wait. */
+  return (evq->rexmit_bandwidth_limit > 0 && evq->rexmit_tnext.v > tnow.v);
+}
+
+static void rexmit_pacing_update (struct xeventq *evq, const struct xevent_nt *ev, nn_mtime_t tnow)
+{
+  if (ev->kind == XEVK_MSG_REXMIT && evq->rexmit_bandwidth_limit > 0)
   {
-    evq->non_timed_xmit_list_oldest = ev->listnode.next;
+    if (evq->rexmit_tnext.v < tnow.v - REXMIT_PACING_MAX_BUFFER)
+      evq->rexmit_tnext.v = tnow.v - REXMIT_PACING_MAX_BUFFER;
+    evq->rexmit_tnext.v += T_SECOND * (int64_t) nn_xmsg_total_size (ev->u.msg_rexmit.msg) / evq->rexmit_bandwidth_limit;
+  }
+}
 
-    if (ev->kind == XEVK_MSG_REXMIT)
-    {
-      assert (lookup_msg (evq, ev->u.msg_rexmit.msg) == ev);
-      forget_msg (evq, ev);
-    }
+static struct xevent_nt *getnext_from_non_timed_xmit_list  (struct xeventq *evq, nn_mtime_t tnow)
+{
+  /* function removes and returns the first item in the list
+     (from the front) and frees the container; the small control
+     messages go before retransmits, and retransmits only once pacing
+     allows it */
+  struct xevent_nt *ev;
+  if ((ev = evq->non_timed_xmit_list_oldest) != NULL)
+    evq->non_timed_xmit_list_oldest = ev->listnode.next;
+  else if ((ev = evq->rexmit_list_oldest) != NULL && !rexmit_list_is_paced (evq, tnow))
+  {
+    evq->rexmit_list_oldest = ev->listnode.next;
+    assert (lookup_msg (evq, ev->u.msg_rexmit.msg) == ev);
+    forget_msg (evq, ev);
+  }
+  else
+  {
+    ev = NULL;
   }
   return ev;
 }
@@ -259,7 +306,13 @@ static struct xevent_nt *getnext_from_non_timed_xmit_list  (struct xeventq *evq)
 static int non_timed_xmit_list_is_empty (struct xeventq *evq)
 {
   /* check whether the "non-timed" xevent list is empty */
-  return (evq->non_timed_xmit_list_oldest == NULL);
+  return (evq->non_timed_xmit_list_oldest == NULL && evq->rexmit_list_oldest == NULL);
+}
+
+static int non_timed_xmit_list_is_ready (struct xeventq *evq, nn_mtime_t tnow)
+{
+  /* check whether there is a "non-timed" xevent that may be handled now */
+  return (evq->non_timed_xmit_list_oldest != NULL || (evq->rexmit_list_oldest != NULL && !rexmit_list_is_paced (evq, tnow)));
 }
 
 static int compute_non_timed_xmit_list_size (struct xeventq *evq)
@@ -268,13 +321,12 @@ static int compute_non_timed_xmit_list_size (struct xeventq *evq)
      number of events in the list -- it'd be easy to compute the
      length incrementally in the add_... and next_... functions, but
      it isn't really being used anywhere, so why bother? */
-  struct xevent_nt *current = evq->non_timed_xmit_list_oldest;
+  struct xevent_nt *current;
   int i = 0;
-  while (current)
-  {
-    current = current->listnode.next;
+  for (current = evq->non_timed_xmit_list_oldest; current; current = current->listnode.next)
+    i++;
+  for (current = evq->rexmit_list_oldest; current; current = current->listnode.next)
     i++;
-  }
   return i;
 }
 
@@ -291,6 +343,14 @@ static int nontimed_xevent_in_queue (struct xeventq *evq, struct xevent_nt *ev)
       return 1;
     }
   }
+  for (x = evq->rexmit_list_oldest; x; x = x->listnode.next)
+  {
+    if (x == ev)
+    {
+      ddsrt_mutex_unlock (&evq->lock);
+      return 1;
+    }
+  }
   ddsrt_mutex_unlock (&evq->lock);
   return 0;
 }
@@ -308,6 +368,7 @@ static void free_xevent (struct xeventq *evq, struct xevent *ev)
       case XEVK_SPDP:
       case XEVK_PMD_UPDATE:
       case XEVK_DELETE_WRITER:
+      case XEVK_WHC_TRIM:
       case XEVK_CALLBACK:
         break;
     }
@@ -483,11 +544,15 @@ struct xeventq * xeventq_new
   ddsrt_avl_init (&msg_xevents_treedef, &evq->msg_xevents);
   evq->non_timed_xmit_list_oldest = NULL;
   evq->non_timed_xmit_list_newest = NULL;
+  evq->rexmit_list_oldest = NULL;
+  evq->rexmit_list_newest = NULL;
   evq->terminate = 0;
   evq->ts = NULL;
   evq->max_queued_rexmit_bytes = max_queued_rexmit_bytes;
   evq->max_queued_rexmit_msgs = max_queued_rexmit_msgs;
   evq->auxiliary_bandwidth_limit = auxiliary_bandwidth_limit;
+  evq->rexmit_bandwidth_limit = config.retransmit_bandwidth_limit;
+  evq->rexmit_tnext.v = 0;
   evq->queued_rexmit_bytes = 0;
   evq->queued_rexmit_msgs = 0;
   evq->tev_conn = conn;
@@ -551,8 +616,12 @@ void xeventq_free (struct xeventq *evq)
       }
     }
   }
-  while (!non_timed_xmit_list_is_empty(evq))
-    free_xevent_nt (evq, getnext_from_non_timed_xmit_list (evq));
+  {
+    /* pacing doesn't matter when discarding the retransmits */
+    const nn_mtime_t tnever = { T_NEVER };
+    while (!non_timed_xmit_list_is_empty(evq))
+      free_xevent_nt (evq, getnext_from_non_timed_xmit_list (evq, tnever));
+  }
   assert (ddsrt_avl_is_empty (&evq->msg_xevents));
   ddsrt_cond_destroy (&evq->cond);
   ddsrt_mutex_destroy (&evq->lock);
@@ -885,7 +954,7 @@ static void handle_xevk_acknack (UNUSED_ARG (struct nn_xpack *xp), struct xevent
     if ((msg = nn_xmsg_new (gv.xmsgpool, &ev->u.acknack.rd_guid.prefix, ACKNACK_SIZE_MAX, NN_XMSG_KIND_CONTROL)) == NULL)
       goto outofmem;
     nn_xmsg_setdst1 (msg, &ev->u.acknack.pwr_guid.prefix, &loc);
-    if (config.meas_hb_to_ack_latency && rwn->hb_timestamp.v)
+    if ((config.meas_hb_to_ack_latency || config.rtt_adaptive_timing) && rwn->hb_timestamp.v)
     {
       /* If HB->ACK latency measurement is enabled, and we have a
          timestamp available, add it and clear the time stamp.  There
@@ -947,25 +1016,19 @@ static void handle_xevk_acknack (UNUSED_ARG (struct nn_xpack *xp), struct xevent
   resched_xevent_if_earlier (ev, add_duration_to_mtime (tnow, 100 * T_MILLISECOND));
 }
 
-static bool resend_spdp_sample_by_guid_key (struct writer *wr, const nn_guid_t *guid, struct proxy_reader *prd)
+static bool resend_spdp_sample (struct writer *wr, struct participant *pp, struct proxy_reader *prd)
 {
-  /* Look up data in (transient-local) WHC by key value -- FIXME: clearly
-   a slightly more efficient and elegant way of looking up the key value
-   is to be preferred */
-  bool sample_found;
-  nn_plist_t ps;
-  nn_plist_init_empty (&ps);
-  ps.present |= PP_PARTICIPANT_GUID;
-  ps.participant_guid = *guid;
-  struct nn_xmsg *mpayload = nn_xmsg_new (gv.xmsgpool, &guid->prefix, 0, NN_XMSG_KIND_DATA);
-  nn_plist_addtomsg (mpayload, &ps, ~(uint64_t)0, ~(uint64_t)0);
-  nn_xmsg_addpar_sentinel (mpayload);
-  nn_plist_fini (&ps);
-  struct ddsi_plist_sample plist_sample;
-  nn_xmsg_payload_to_plistsample (&plist_sample, PID_PARTICIPANT_GUID, mpayload);
-  struct ddsi_serdata *sd = ddsi_serdata_from_sample (gv.plist_topic, SDK_KEY, &plist_sample);
+  /* Look up data in (transient-local) WHC by key value, using the sample
+     spdp_write retained for this purpose as the key */
+  struct ddsi_serdata *sd;
   struct whc_borrowed_sample sample;
-  nn_xmsg_free (mpayload);
+  bool sample_found;
+
+  ddsrt_mutex_lock (&pp->e.lock);
+  sd = pp->spdp_serdata ? ddsi_serdata_ref (pp->spdp_serdata) : NULL;
+  ddsrt_mutex_unlock (&pp->e.lock);
+  if (sd == NULL)
+    return false;
 
   ddsrt_mutex_lock (&wr->e.lock);
   sample_found = whc_borrow_sample_key (wr->whc, sd, &sample);
@@ -976,7 +1039,7 @@ static bool resend_spdp_sample_by_guid_key (struct writer *wr, const nn_guid_t *
      updating of the last transmitted sequence number won't take
      place anyway.  Nor is it necessary to fiddle with heartbeat
      control stuff. */
-    enqueue_sample_wrlock_held (wr, sample.seq, sample.plist, sample.serdata, prd, 1);
+    enqueue_sample_wrlock_held (wr, sample.seq, sample.plist, sample.serdata, prd, NULL, 1);
     whc_return_sample(wr->whc, &sample, false);
   }
   ddsrt_mutex_unlock (&wr->e.lock);
@@ -1028,7 +1091,7 @@ static void handle_xevk_spdp (UNUSED_ARG (struct nn_xpack *xp), struct xevent *e
       DDS_TRACE("xmit spdp: no proxy reader "PGUIDFMT"\n", PGUID (guid));
   }
 
-  if (do_write && !resend_spdp_sample_by_guid_key (spdp_wr, &ev->u.spdp.pp_guid, prd))
+  if (do_write && !resend_spdp_sample (spdp_wr, pp, prd))
   {
 #ifndef NDEBUG
     /* If undirected, it is pp->spdp_xevent, and that one must never
@@ -1188,6 +1251,29 @@ static void handle_xevk_delete_writer (UNUSED_ARG (struct nn_xpack *xp), struct
   delete_xevent (ev);
 }
 
+static void handle_xevk_whc_trim (UNUSED_ARG (struct nn_xpack *xp), struct xevent *ev, UNUSED_ARG (nn_mtime_t tnow))
+{
+  /* Drops the samples acknowledged by all readers since the event was
+     scheduled by handle_AckNack, however many ACKNACKs that were */
+  struct whc_node *deferred_free_list = NULL;
+  struct whc_state whcst;
+  struct writer *wr;
+  unsigned n;
+
+  if ((wr = ephash_lookup_writer_guid (&ev->u.whc_trim.wr_guid)) == NULL)
+  {
+    DDS_TRACE("whc_trim(wr "PGUIDFMT") writer gone\n", PGUID (ev->u.whc_trim.wr_guid));
+    return;
+  }
+
+  ddsrt_mutex_lock (&wr->e.lock);
+  wr->whc_trim_pending = 0;
+  n = remove_acked_messages (wr, &whcst, &deferred_free_list);
+  ddsrt_mutex_unlock (&wr->e.lock);
+  whc_free_deferred_free_list (wr->whc, deferred_free_list);
+  DDS_TRACE("whc_trim(wr "PGUIDFMT") RM%u\n", PGUID (wr->e.guid), n);
+}
+
 static void handle_individual_xevent (struct thread_state1 * const ts1, struct xevent *xev, struct nn_xpack *xp, nn_mtime_t tnow)
 {
   switch (xev->kind)
@@ -1207,6 +1293,9 @@ static void handle_individual_xevent (struct thread_state1 * const ts1, struct x
     case XEVK_DELETE_WRITER:
       handle_xevk_delete_writer (xp, xev, tnow);
       break;
+    case XEVK_WHC_TRIM:
+      handle_xevk_whc_trim (xp, xev, tnow);
+      break;
     case XEVK_CALLBACK:
       xev->u.callback.cb (xev, xev->u.callback.arg, tnow);
       break;
@@ -1310,9 +1399,10 @@ static void handle_xevents (struct thread_state1 * const ts1, struct xeventq *xe
       tnow = now_mt ();
     }
 
-    if (!non_timed_xmit_list_is_empty (xevq))
+    if (non_timed_xmit_list_is_ready (xevq, tnow))
     {
-      struct xevent_nt *xev = getnext_from_non_timed_xmit_list (xevq);
+      struct xevent_nt *xev = getnext_from_non_timed_xmit_list (xevq, tnow);
+      rexmit_pacing_update (xevq, xev, tnow);
       thread_state_awake_to_awake_no_nest (ts1);
       handle_nontimed_xevent (xev, xp);
       tnow = now_mt ();
@@ -1349,13 +1439,15 @@ static uint32_t xevent_thread (struct xeventq * xevq)
     ddsrt_mutex_lock (&xevq->lock);
     thread_state_asleep (ts1);
 
-    if (!non_timed_xmit_list_is_empty (xevq) || xevq->terminate)
+    if (non_timed_xmit_list_is_ready (xevq, now_mt ()) || xevq->terminate)
     {
       /* continue immediately */
     }
     else
     {
       nn_mtime_t twakeup = earliest_in_xeventq (xevq);
+      if (xevq->rexmit_list_oldest != NULL && xevq->rexmit_tnext.v < twakeup.v)
+        twakeup = xevq->rexmit_tnext;
       if (twakeup.v == T_NEVER)
       {
         /* no scheduled events nor any non-timed events */
@@ -1560,6 +1652,19 @@ struct xevent *qxev_delete_writer (nn_mtime_t tsched, const nn_guid_t *guid)
   return ev;
 }
 
+struct xevent *qxev_whc_trim (struct xeventq *evq, nn_mtime_t tsched, const nn_guid_t *wr_guid)
+{
+  /* Same lifetime as the heartbeat event: wr->whc_trim_xevent */
+  struct xevent *ev;
+  assert(evq);
+  ddsrt_mutex_lock (&evq->lock);
+  ev = qxev_common (evq, tsched, XEVK_WHC_TRIM);
+  ev->u.whc_trim.wr_guid = *wr_guid;
+  qxev_insert (ev);
+  ddsrt_mutex_unlock (&evq->lock);
+  return ev;
+}
+
 struct xevent *qxev_callback (nn_mtime_t tsched, void (*cb) (struct xevent *ev, void *arg, nn_mtime_t tnow), void *arg)
 {
   struct xevent *ev;
@@ -34,6 +34,7 @@
 #include "dds/ddsi/q_error.h"
 #include "dds/ddsi/q_misc.h"
 #include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/q_xmsg.h"
 #include "dds/ddsi/q_config.h"
@@ -41,6 +42,7 @@
 #include "dds/ddsi/q_globals.h"
 #include "dds/ddsi/q_ephash.h"
 #include "dds/ddsi/q_freelist.h"
+#include "dds/ddsi/q_radmin.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
 
 #define NN_XMSG_MAX_ALIGN 8
@@ -86,7 +88,8 @@ struct nn_xmsg {
     struct {
       nn_guid_t wrguid;
       seqno_t wrseq;
-      nn_fragment_number_t wrfragid;
+      nn_fragment_number_t wrfragid; /* last fragment in message */
+      uint32_t wrnfrags;
       /* readerId encodes offset to destination readerId or 0 -- used
          only for rexmits, but more convenient to combine both into
          one struct in the union */
@@ -216,6 +219,11 @@ struct nn_xpack
 
   struct nn_xmsg_chain included_msgs;
 
+  /* FEC: if fec_tagged, iov[1] refers to fec_info */
+  bool fec_tagged;
+  PT_FecInfo_t fec_info;
+  struct nn_fec_encoder *fec;
+
 #ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
   struct nn_bw_limiter limiter;
 #endif
@@ -393,6 +401,9 @@ static int submsg_is_compatible (const struct nn_xmsg *msg, SubmessageKind_t smk
         case SMID_DATA: case SMID_DATA_FRAG:
           /* but data is strictly verboten */
           return 0;
+        case SMID_PT_FEC_INFO: case SMID_PT_FEC_PARITY:
+          /* these are added by the xpack, never part of a message */
+          return 0;
       }
       assert (0);
       break;
@@ -422,6 +433,8 @@ static int submsg_is_compatible (const struct nn_xmsg *msg, SubmessageKind_t smk
         case SMID_PT_INFO_CONTAINER:
         case SMID_PT_MSG_LEN:
         case SMID_PT_ENTITY_ID:
+        case SMID_PT_FEC_INFO:
+        case SMID_PT_FEC_PARITY:
           /* anything else is strictly verboten */
           return 0;
       }
@@ -447,6 +460,8 @@ int nn_xmsg_compare_fragid (const struct nn_xmsg *a, const struct nn_xmsg *b)
     return (a->kindspecific.data.wrseq < b->kindspecific.data.wrseq) ? -1 : 1;
   else if (a->kindspecific.data.wrfragid != b->kindspecific.data.wrfragid)
     return (a->kindspecific.data.wrfragid < b->kindspecific.data.wrfragid) ? -1 : 1;
+  else if (a->kindspecific.data.wrnfrags != b->kindspecific.data.wrnfrags)
+    return (a->kindspecific.data.wrnfrags < b->kindspecific.data.wrnfrags) ? -1 : 1;
   else
     return 0;
 }
@@ -456,6 +471,11 @@ size_t nn_xmsg_size (const struct nn_xmsg *m)
   return m->sz;
 }
 
+size_t nn_xmsg_total_size (const struct nn_xmsg *m)
+{
+  return m->sz + (m->refd_payload ? m->refd_payload_iov.iov_len : 0);
+}
+
 enum nn_xmsg_kind nn_xmsg_kind (const struct nn_xmsg *m)
 {
   return m->kind;
@@ -660,6 +680,7 @@ int nn_xmsg_merge_rexmit_destinations_wrlock_held (struct nn_xmsg *m, const stru
   assert (memcmp (&m->kindspecific.data.wrguid, &madd->kindspecific.data.wrguid, sizeof (m->kindspecific.data.wrguid)) == 0);
   assert (m->kindspecific.data.wrseq == madd->kindspecific.data.wrseq);
   assert (m->kindspecific.data.wrfragid == madd->kindspecific.data.wrfragid);
+  assert (m->kindspecific.data.wrnfrags == madd->kindspecific.data.wrnfrags);
   assert (m->kind == NN_XMSG_KIND_DATA_REXMIT);
   assert (madd->kind == NN_XMSG_KIND_DATA_REXMIT);
   assert (m->kindspecific.data.readerId_off != 0);
@@ -758,10 +779,11 @@ void nn_xmsg_setwriterseq (struct nn_xmsg *msg, const nn_guid_t *wrguid, seqno_t
   msg->kindspecific.data.wrseq = wrseq;
 }
 
-void nn_xmsg_setwriterseq_fragid (struct nn_xmsg *msg, const nn_guid_t *wrguid, seqno_t wrseq, nn_fragment_number_t wrfragid)
+void nn_xmsg_setwriterseq_fragid (struct nn_xmsg *msg, const nn_guid_t *wrguid, seqno_t wrseq, nn_fragment_number_t wrfragid, uint32_t wrnfrags)
 {
   nn_xmsg_setwriterseq (msg, wrguid, wrseq);
   msg->kindspecific.data.wrfragid = wrfragid;
+  msg->kindspecific.data.wrnfrags = wrnfrags;
 }
 
 size_t nn_xmsg_add_string_padded(unsigned char *buf, char *str)
@@ -857,6 +879,30 @@ void nn_xmsg_addpar_stringseq (struct nn_xmsg *m, unsigned pid, const nn_strings
   }
 }
 
+void nn_xmsg_addpar_content_filter_property (struct nn_xmsg *m, unsigned pid, const struct nn_content_filter_property *cfp)
+{
+  const char *strs[] = {
+    cfp->content_filtered_topic_name, cfp->related_topic_name, cfp->filter_class_name, cfp->filter_expression
+  };
+  unsigned char *tmp;
+  uint32_t i;
+  size_t len = 0;
+
+  for (i = 0; i < sizeof (strs) / sizeof (strs[0]); i++)
+    len += nn_xmsg_add_string_padded (NULL, (char *) strs[i]);
+  for (i = 0; i < cfp->expression_parameters.n; i++)
+    len += nn_xmsg_add_string_padded (NULL, cfp->expression_parameters.strs[i]);
+
+  tmp = nn_xmsg_addpar (m, pid, 4 + len);
+
+  for (i = 0; i < sizeof (strs) / sizeof (strs[0]); i++)
+    tmp += nn_xmsg_add_string_padded (tmp, (char *) strs[i]);
+  *((uint32_t *) tmp) = cfp->expression_parameters.n;
+  tmp += sizeof (uint32_t);
+  for (i = 0; i < cfp->expression_parameters.n; i++)
+    tmp += nn_xmsg_add_string_padded (tmp, cfp->expression_parameters.strs[i]);
+}
+
 void nn_xmsg_addpar_keyhash (struct nn_xmsg *m, const struct ddsi_serdata *serdata)
 {
   if (serdata->kind != SDK_EMPTY)
@@ -1166,6 +1212,73 @@ static void nn_bw_limit_init (struct nn_bw_limiter *limiter, uint32_t bandwidth_
 }
 #endif /* DDSI_INCLUDE_BANDWIDTH_LIMITING */
 
+/* FEC -----------------------------------------------------------------
+
+   Packets sent to a set of addresses are tagged with a FEC_INFO
+   submessage (immediately following the header) giving the stream id
+   of the encoder and a sequence number, and grouped: once a group of
+   FecGroupSize packets has been sent, a packet containing the XOR of
+   these packets is sent to the same addresses, allowing the receivers
+   to reconstruct any single lost packet in the group (see q_radmin.c).
+
+   All packets in a group have the same source GUID prefix and address
+   sets, a packet that doesn't match closes the group and starts a new
+   one.  A group left incomplete when traffic stops simply doesn't get
+   a parity packet, losses there are left to the regular retransmits
+   (if the writer is reliable).
+
+   Every xpack has its own encoder, except those that send
+   asynchronously: there the copies queued for the sendq thread share
+   the one encoder used by that thread. */
+
+#define NN_FEC_MAX_PACKET_SIZE 65024u
+
+struct nn_fec_encoder {
+  uint32_t streamid;
+  uint32_t nextseq;
+  uint32_t count; /* number of packets in current group */
+  uint32_t lenxor;
+  uint32_t maxlen;
+  struct addrset *as, *as_group; /* destination of current group */
+  Header_t hdr;
+  PT_FecParity_t parity;
+  uint32_t accsize;
+  unsigned char *acc;
+};
+
+static ddsrt_atomic_uint32_t fec_streamid_gen = DDSRT_ATOMIC_UINT32_INIT (0);
+
+static struct nn_fec_encoder *nn_fec_encoder_new (void)
+{
+  struct nn_fec_encoder *enc = ddsrt_malloc (sizeof (*enc));
+  memset (enc, 0, sizeof (*enc));
+  enc->streamid = ddsrt_atomic_inc32_nv (&fec_streamid_gen);
+  enc->parity.smhdr.submessageId = SMID_PT_FEC_PARITY;
+  enc->parity.smhdr.flags = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? SMFLAG_ENDIANNESS : 0);
+  enc->parity.streamid = enc->streamid;
+  return enc;
+}
+
+static void nn_fec_encoder_reset (struct nn_fec_encoder *enc)
+{
+  if (enc->count > 0)
+  {
+    unref_addrset (enc->as);
+    unref_addrset (enc->as_group);
+    memset (enc->acc, 0, enc->maxlen);
+  }
+  enc->count = 0;
+  enc->lenxor = 0;
+  enc->maxlen = 0;
+}
+
+static void nn_fec_encoder_free (struct nn_fec_encoder *enc)
+{
+  nn_fec_encoder_reset (enc);
+  ddsrt_free (enc->acc);
+  ddsrt_free (enc);
+}
+
 /* XPACK ---------------------------------------------------------------
 
    Queued messages are packed into xpacks (all by-ref, using iovecs).
@@ -1180,6 +1293,7 @@ static void nn_xpack_reinit (struct nn_xpack *xp)
   xp->msg_len.length = 0;
   xp->included_msgs.latest = NULL;
   xp->maxdelay = T_NEVER;
+  xp->fec_tagged = false;
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
   xp->encoderId = 0;
 #endif
@@ -1213,6 +1327,12 @@ struct nn_xpack * nn_xpack_new (ddsi_tran_conn_t conn, uint32_t bw_limit, bool a
   xp->msg_len.smhdr.flags = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? SMFLAG_ENDIANNESS : 0);
   xp->msg_len.smhdr.octetsToNextHeader = 4;
 
+  xp->fec_info.smhdr.submessageId = SMID_PT_FEC_INFO;
+  xp->fec_info.smhdr.flags = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? SMFLAG_ENDIANNESS : 0);
+  xp->fec_info.smhdr.octetsToNextHeader = sizeof (xp->fec_info) - RTPS_SUBMESSAGE_HEADER_SIZE;
+  if (config.fec_group_size > 0 && !async_mode)
+    xp->fec = nn_fec_encoder_new ();
+
   xp->conn = conn;
   nn_xpack_reinit (xp);
 
@@ -1249,6 +1369,8 @@ void nn_xpack_free (struct nn_xpack *xp)
 #endif
   if (gv.thread_pool)
     ddsi_sem_destroy (&xp->sem);
+  if (xp->fec)
+    nn_fec_encoder_free (xp->fec);
   ddsrt_free (xp);
 }
 
@@ -1349,6 +1471,93 @@ static void nn_xpack_send1_threaded (const nn_locator_t *loc, void * varg)
   ddsrt_thread_pool_submit (gv.thread_pool, nn_xpack_send1_thread, arg);
 }
 
+static void nn_xpack_send_fec_parity (struct nn_xpack *xp, struct nn_fec_encoder *enc)
+{
+  /* Borrow the xpack's iovecs for sending the parity packet, the
+     payload of the packet being sent may still need them */
+  ddsrt_iovec_t iov[3];
+  const size_t niov = xp->niov;
+  const uint32_t length = xp->msg_len.length, call_flags = xp->call_flags;
+  assert (enc->count > 0);
+  if (enc->count > 1)
+  {
+    enc->parity.firstseq = enc->nextseq - enc->count;
+    enc->parity.count = enc->count;
+    enc->parity.lenxor = enc->lenxor;
+    enc->parity.smhdr.octetsToNextHeader = (unsigned short) (sizeof (enc->parity) - RTPS_SUBMESSAGE_HEADER_SIZE + enc->maxlen);
+    memcpy (iov, xp->iov, sizeof (iov));
+    xp->iov[0].iov_base = (void *) &enc->hdr;
+    xp->iov[0].iov_len = sizeof (enc->hdr);
+    xp->iov[1].iov_base = (void *) &enc->parity;
+    xp->iov[1].iov_len = sizeof (enc->parity);
+    xp->iov[2].iov_base = (void *) enc->acc;
+    xp->iov[2].iov_len = (ddsrt_iov_len_t) enc->maxlen;
+    xp->niov = 3;
+    xp->msg_len.length = (uint32_t) (sizeof (enc->hdr) + sizeof (enc->parity) + enc->maxlen);
+    DDS_TRACE(" fec-parity(%"PRIx32"/%"PRIu32"..%"PRIu32")", enc->streamid, enc->parity.firstseq, enc->nextseq - 1);
+    xp->call_flags = 0;
+    if (enc->as)
+      addrset_forall (enc->as, nn_xpack_send1v, xp);
+    if (enc->as_group)
+      (void) addrset_forone (enc->as_group, nn_xpack_send1, xp);
+    memcpy (xp->iov, iov, sizeof (iov));
+    xp->niov = niov;
+    xp->msg_len.length = length;
+    xp->call_flags = call_flags;
+  }
+  nn_fec_encoder_reset (enc);
+}
+
+static struct nn_fec_encoder *nn_xpack_fec_encoder (const struct nn_xpack *xp)
+{
+  return xp->async_mode ? gv.sendq_fec : xp->fec;
+}
+
+static void nn_xpack_fec_prepare (struct nn_xpack *xp, struct nn_fec_encoder *enc)
+{
+  /* Close the current group if this packet can't be part of it, then
+     assign the packet its sequence number */
+  assert (xp->dstmode == NN_XMSG_DST_ALL);
+  if (enc->count > 0 && (enc->as != xp->dstaddr.all.as || enc->as_group != xp->dstaddr.all.as_group ||
+                         memcmp (&enc->hdr, &xp->hdr, sizeof (enc->hdr)) != 0 ||
+                         xp->msg_len.length > NN_FEC_MAX_PACKET_SIZE))
+    nn_xpack_send_fec_parity (xp, enc);
+  xp->iov[1].iov_base = (void *) &xp->fec_info;
+  xp->fec_info.streamid = enc->streamid;
+  xp->fec_info.seq = enc->nextseq++;
+}
+
+static void nn_xpack_fec_add (struct nn_xpack *xp, struct nn_fec_encoder *enc)
+{
+  const uint32_t len = xp->msg_len.length;
+  size_t off = 0;
+  if (len > NN_FEC_MAX_PACKET_SIZE)
+    return;
+  if (enc->count == 0)
+  {
+    enc->as = ref_addrset (xp->dstaddr.all.as);
+    enc->as_group = ref_addrset (xp->dstaddr.all.as_group);
+    enc->hdr = xp->hdr;
+  }
+  if (len > enc->accsize)
+  {
+    enc->acc = ddsrt_realloc (enc->acc, len);
+    memset (enc->acc + enc->accsize, 0, len - enc->accsize);
+    enc->accsize = len;
+  }
+  for (size_t i = 0; i < xp->niov; i++)
+  {
+    nn_fec_xor (enc->acc + off, xp->iov[i].iov_base, xp->iov[i].iov_len);
+    off += xp->iov[i].iov_len;
+  }
+  assert (off == len);
+  enc->lenxor ^= len;
+  if (len > enc->maxlen)
+    enc->maxlen = len;
+  if (++enc->count == (uint32_t) config.fec_group_size)
+    nn_xpack_send_fec_parity (xp, enc);
+}
+
 static void nn_xpack_send_real (struct nn_xpack * xp)
 {
   size_t calls;
@@ -1380,6 +1589,10 @@ static void nn_xpack_send_real (struct nn_xpack * xp)
   }
   else
   {
+    struct nn_fec_encoder * const enc = xp->fec_tagged ? nn_xpack_fec_encoder (xp) : NULL;
+    if (enc)
+      nn_xpack_fec_prepare (xp, enc);
+
     /* Send to all addresses in as - as ultimately references the writer's
        address set, which is currently replaced rather than changed whenever
        it is updated, but that might not be something we want to guarantee */
@@ -1401,7 +1614,6 @@ static void nn_xpack_send_real (struct nn_xpack * xp)
         if (ddsrt_atomic_dec32_ov (&xp->calls) != 1)
           ddsi_sem_wait (&xp->sem);
       }
-      unref_addrset (xp->dstaddr.all.as);
     }
 
     /* Send to at most one address in as_group */
@@ -1412,8 +1624,12 @@ static void nn_xpack_send_real (struct nn_xpack * xp)
       {
         calls++;
       }
-      unref_addrset (xp->dstaddr.all.as_group);
     }
+
+    if (enc)
+      nn_xpack_fec_add (xp, enc);
+    unref_addrset (xp->dstaddr.all.as);
+    unref_addrset (xp->dstaddr.all.as_group);
   }
   DDS_TRACE(" ]\n");
   if (calls)
@@ -1430,6 +1646,7 @@ static void nn_xpack_send_real (struct nn_xpack * xp)
 
 static uint32_t nn_xpack_sendq_thread (UNUSED_ARG (void *arg))
 {
+  struct thread_state1 * const ts1 = lookup_thread_state ();
   ddsrt_mutex_lock (&gv.sendq_lock);
   while (!(gv.sendq_stop && gv.sendq_head == NULL))
   {
@@ -1444,7 +1661,11 @@ static uint32_t nn_xpack_sendq_thread (UNUSED_ARG (void *arg))
       if (--gv.sendq_length == SENDQ_LW)
         ddsrt_cond_broadcast (&gv.sendq_cond);
       ddsrt_mutex_unlock (&gv.sendq_lock);
+      /* awake, so that the destination address set can be traversed
+         without locking it, as on the synchronous path */
+      thread_state_awake (ts1);
       nn_xpack_send_real (xp);
+      thread_state_asleep (ts1);
       nn_xpack_free (xp);
       ddsrt_mutex_lock (&gv.sendq_lock);
     }
@@ -1459,6 +1680,7 @@ void nn_xpack_sendq_init (void)
   gv.sendq_head = NULL;
   gv.sendq_tail = NULL;
   gv.sendq_length = 0;
+  gv.sendq_fec = (config.fec_group_size > 0) ? nn_fec_encoder_new () : NULL;
   ddsrt_mutex_init (&gv.sendq_lock);
   ddsrt_cond_init (&gv.sendq_cond);
 }
@@ -1482,6 +1704,8 @@ void nn_xpack_sendq_fini (void)
   join_thread(gv.sendq_ts);
   ddsrt_cond_destroy(&gv.sendq_cond);
   ddsrt_mutex_destroy(&gv.sendq_lock);
+  if (gv.sendq_fec)
+    nn_fec_encoder_free (gv.sendq_fec);
 }
 
 void nn_xpack_send (struct nn_xpack *xp, bool immediately)
@@ -1494,6 +1718,14 @@ void nn_xpack_send (struct nn_xpack *xp, bool immediately)
   {
     struct nn_xpack *xp1 = ddsrt_malloc (sizeof (*xp));
     memcpy (xp1, xp, sizeof (*xp1));
+    /* the RTPS header &c. are part of the xpack itself, the copy must
+       not refer to the original, which gets reused or freed */
+    for (size_t i = 0; i < xp1->niov; i++)
+    {
+      const char *base = xp1->iov[i].iov_base;
+      if (base >= (const char *) xp && base < (const char *) (xp + 1))
+        xp1->iov[i].iov_base = (char *) xp1 + (base - (const char *) xp);
+    }
     nn_xpack_reinit (xp);
     xp1->sendq_next = NULL;
     ddsrt_mutex_lock (&gv.sendq_lock);
@@ -1684,6 +1916,15 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
       sz += sizeof (xp->msg_len);
       niov++;
     }
+    else if (m->dstmode == NN_XMSG_DST_ALL && config.fec_group_size > 0)
+    {
+      /* Sequence number is assigned on sending, see nn_xpack_fec_prepare */
+      xp->iov[niov].iov_base = (void*) &xp->fec_info;
+      xp->iov[niov].iov_len = sizeof (xp->fec_info);
+      sz += sizeof (xp->fec_info);
+      niov++;
+      xp->fec_tagged = true;
+    }
 
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
     xp->encoderId = m->encoderid;
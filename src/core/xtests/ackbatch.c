@@ -0,0 +1,201 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_whc.h"
+#include "dds__entity.h"
+#include "dds__types.h"
+
+#include "RhcTypes.h"
+
+/* Measures how often the acknowledged samples are dropped from the WHC of a
+   writer with many remote readers, compared to the number of ACKNACKs the
+   writer receives.  Pure acknowledgements only update the reader's state
+   (under the writer lock that handling the ACKNACK takes anyway), dropping
+   the samples is done by a timed event, once for all ACKNACKs received in
+   the meantime.  Each drop costs a writer lock acquisition and a walk of
+   the WHC, so fewer drops than ACKNACKs means less work.
+
+   It also checks that everything does get dropped in the end.  The process
+   spawns a copy of itself for the subscribing side. */
+
+#define URI "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery></CycloneDDS>"
+
+static dds_qos_t *reliable_qos (void)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  return qos;
+}
+
+static bool take_all (dds_entity_t rd)
+{
+  RhcTypes_T xs[100];
+  void *ptrs[100];
+  dds_sample_info_t si[100];
+  for (int i = 0; i < 100; i++)
+  {
+    memset (&xs[i], 0, sizeof (xs[i]));
+    ptrs[i] = &xs[i];
+  }
+  if (dds_take (rd, ptrs, si, 100, 100) <= 0)
+    return false;
+  dds_return_loan (rd, ptrs, 100);
+  return true;
+}
+
+static bool reader_done (dds_entity_t rd)
+{
+  dds_subscription_matched_status_t sm;
+  dds_get_subscription_matched_status (rd, &sm);
+  return sm.total_count > 0 && sm.current_count == 0;
+}
+
+static int subscriber (const char *topicname, int nreaders)
+{
+  dds_qos_t *qos = reliable_qos ();
+  dds_entity_t pp, tp, *rds;
+  dds_time_t tend = dds_time () + DDS_SECS (120);
+  bool done;
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  rds = dds_alloc ((size_t) nreaders * sizeof (*rds));
+  for (int i = 0; i < nreaders; i++)
+    rds[i] = dds_create_reader (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  /* take everything until the publisher has come and gone */
+  do {
+    bool took = false;
+    done = true;
+    for (int i = 0; i < nreaders; i++)
+    {
+      took = take_all (rds[i]) || took;
+      done = done && reader_done (rds[i]);
+    }
+    if (!took)
+      dds_sleepfor (DDS_MSECS (1));
+  } while (!done && dds_time () < tend);
+  dds_free (rds);
+  dds_delete (pp);
+  return 0;
+}
+
+struct counts {
+  uint32_t acks;
+  uint32_t trims;
+  size_t unacked_bytes;
+};
+
+static void get_counts (dds_entity_t wrhandle, struct counts *c)
+{
+  dds_entity *x;
+  struct writer *wr;
+  struct whc_state whcst;
+  if (dds_entity_lock (wrhandle, DDS_KIND_WRITER, &x) < 0)
+    abort ();
+  wr = ((dds_writer *) x)->m_wr;
+  ddsrt_mutex_lock (&wr->e.lock);
+  c->acks = wr->num_acks_received;
+  c->trims = wr->whc_trim_count;
+  whc_get_state (wr->whc, &whcst);
+  c->unacked_bytes = whcst.unacked_bytes;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  dds_entity_unlock (x);
+}
+
+static bool writer_matched (dds_entity_t wr, int nreaders)
+{
+  dds_publication_matched_status_t pm;
+  dds_get_publication_matched_status (wr, &pm);
+  return pm.current_count == (uint32_t) nreaders;
+}
+
+int main (int argc, char **argv)
+{
+  char topicname[100], nreaders_str[20];
+  char *sub_argv[] = { "-sub", topicname, nreaders_str, NULL };
+  int nreaders = 10, nsamples = 2000, result = 1;
+  dds_entity_t pp, tp, wr;
+  ddsrt_pid_t pid;
+  int32_t code = -1;
+  dds_time_t tend;
+  dds_qos_t *qos;
+
+  if (ddsrt_setenv ("CYCLONEDDS_URI", URI) != DDS_RETCODE_OK)
+    return 1;
+  if (argc == 4 && strcmp (argv[1], "-sub") == 0)
+    return subscriber (argv[2], atoi (argv[3]));
+  if (argc > 1)
+    nreaders = atoi (argv[1]);
+  if (argc > 2)
+    nsamples = atoi (argv[2]);
+  snprintf (topicname, sizeof (topicname), "ackbatch_%"PRIdPID, ddsrt_getpid ());
+  snprintf (nreaders_str, sizeof (nreaders_str), "%d", nreaders);
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  wr = dds_create_writer (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  if (ddsrt_proc_create (argv[0], sub_argv, &pid) != DDS_RETCODE_OK)
+  {
+    dds_delete (pp);
+    return 1;
+  }
+  tend = dds_time () + DDS_SECS (60);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+  } while (!writer_matched (wr, nreaders) && dds_time () < tend);
+
+  if (writer_matched (wr, nreaders))
+  {
+    RhcTypes_T x = { 0, "key", 0, 0, "" };
+    struct counts c0, c1;
+    get_counts (wr, &c0);
+    result = 0;
+    for (int i = 0; i < nsamples && result == 0; i++)
+    {
+      x.x = i;
+      if (dds_write (wr, &x) != DDS_RETCODE_OK)
+        result = 1;
+      else if (i % 10 == 9)
+        dds_sleepfor (DDS_MSECS (1));
+    }
+    /* wait for everything to be acknowledged and dropped from the WHC */
+    tend = dds_time () + DDS_SECS (10);
+    do {
+      dds_sleepfor (DDS_MSECS (10));
+      get_counts (wr, &c1);
+    } while (c1.unacked_bytes > 0 && dds_time () < tend);
+    c1.acks -= c0.acks;
+    c1.trims -= c0.trims;
+    printf ("%d readers, %d writes: %"PRIu32" ACKNACKs, %"PRIu32" WHC trims (%.1f ACKNACKs per trim), %zu unacked bytes left\n",
+            nreaders, nsamples, c1.acks, c1.trims, (c1.trims > 0) ? (double) c1.acks / c1.trims : 0.0, c1.unacked_bytes);
+    if (c1.unacked_bytes > 0 || c1.acks < (uint32_t) nreaders || 2 * c1.trims > c1.acks)
+      result = 1;
+  }
+  dds_delete (pp);
+  (void) ddsrt_proc_waitpid (pid, DDS_SECS (30), &code);
+  return (result == 0 && code == 0) ? 0 : 1;
+}
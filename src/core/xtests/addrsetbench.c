@@ -0,0 +1,131 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+#include "dds/ddsi/q_addrset.h"
+#include "dds/ddsi/q_thread.h"
+
+/* Measures the cost of iterating over the destination address set of a
+   packet, as nn_xpack_send does for every packet it sends, for sets of
+   various sizes.  A thread that is awake iterates over the flattened
+   snapshot without locking the set; one that is asleep takes the lock and
+   walks the trees, as all threads used to do.  That is done with and
+   without a second thread iterating over the same set concurrently, as
+   the threads sending packets for writers with the same readers would. */
+
+static uint32_t sink;
+
+static void count_loc (const nn_locator_t *loc, void *varg)
+{
+  uint32_t *n = varg;
+  *n += loc->port;
+}
+
+static struct addrset *make_addrset (uint32_t n)
+{
+  struct addrset *as = new_addrset ();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    nn_locator_t loc;
+    memset (&loc, 0, sizeof (loc));
+    loc.kind = NN_LOCATOR_KIND_UDPv4;
+    loc.port = 7410 + i % 100;
+    loc.address[12] = 10;
+    loc.address[13] = (unsigned char) (i >> 16);
+    loc.address[14] = (unsigned char) (i >> 8);
+    loc.address[15] = (unsigned char) i;
+    add_to_addrset (as, &loc);
+  }
+  return as;
+}
+
+struct iterate_arg {
+  struct addrset *as;
+  bool awake;
+  uint32_t niter;
+  dds_duration_t dt;
+};
+
+static uint32_t iterate (void *varg)
+{
+  struct iterate_arg * const arg = varg;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  uint32_t n = 0;
+  dds_time_t t0 = dds_time ();
+  for (uint32_t i = 0; i < arg->niter; i++)
+  {
+    if (arg->awake)
+      thread_state_awake (ts1);
+    (void) addrset_forall_count (arg->as, count_loc, &n);
+    if (arg->awake)
+      thread_state_asleep (ts1);
+  }
+  arg->dt = dds_time () - t0;
+  sink += n;
+  return 0;
+}
+
+static double run (struct addrset *as, bool awake, uint32_t nthreads, uint32_t niter)
+{
+  struct iterate_arg args[2];
+  ddsrt_thread_t tids[2];
+  ddsrt_threadattr_t tattr;
+  dds_duration_t dt = 0;
+  ddsrt_threadattr_init (&tattr);
+  for (uint32_t i = 0; i < nthreads; i++)
+  {
+    args[i].as = as;
+    args[i].awake = awake;
+    args[i].niter = niter;
+    if (ddsrt_thread_create (&tids[i], "iterate", &tattr, iterate, &args[i]) != DDS_RETCODE_OK)
+      abort ();
+  }
+  for (uint32_t i = 0; i < nthreads; i++)
+  {
+    (void) ddsrt_thread_join (tids[i], NULL);
+    dt += args[i].dt;
+  }
+  return (double) dt / nthreads / niter;
+}
+
+int main (int argc, char **argv)
+{
+  static const uint32_t sizes[] = { 1, 4, 16, 64 };
+  uint32_t niter = 1000000;
+  dds_entity_t pp;
+  if (argc > 1)
+    niter = (uint32_t) atoi (argv[1]);
+  /* address sets need the garbage collector for freeing old snapshots */
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  printf ("%9s %9s %14s %14s\n", "addresses", "threads", "locked ns/it", "snapshot ns/it");
+  for (size_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+  {
+    struct addrset *as = make_addrset (sizes[i]);
+    for (uint32_t nthreads = 1; nthreads <= 2; nthreads++)
+    {
+      const double locked = run (as, false, nthreads, niter);
+      const double snapshot = run (as, true, nthreads, niter);
+      printf ("%9"PRIu32" %9"PRIu32" %14.1f %14.1f\n", sizes[i], nthreads, locked, snapshot);
+    }
+    unref_addrset (as);
+  }
+  dds_delete (pp);
+  return 0;
+}
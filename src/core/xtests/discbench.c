@@ -0,0 +1,326 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/endian.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/q_globals.h"
+
+#include "RhcTypes.h"
+
+/* Measures how long it takes to discover a burst of remote participants (as
+   when a rack of machines restarts), each with a number of readers, for a
+   range of numbers of builtin delivery queues (Internal/BuiltinDeliveryQueues).
+
+   The remote participants are fake: their SPDP and SEDP messages are crafted
+   here and sent over the loopback interface to the discovery unicast port of
+   the local participant.  The readers match a local writer, and the time it
+   takes for that writer to match all of them is the discovery time.  The fake
+   participants never respond, so SEDP data that arrives before the
+   participant has been discovered gets lost; therefore all messages are
+   resent whenever discovery stalls until it is complete. */
+
+#define URI_FMT "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex></Discovery><Internal><BuiltinDeliveryQueues>%d</BuiltinDeliveryQueues></Internal></CycloneDDS>"
+
+/* the fake participants' locators: nothing listens on this port */
+#define FAKE_PORT 7399
+
+#define RESEND_INTERVAL DDS_MSECS (200)
+#define BURST_SIZE 32
+
+struct msg {
+  unsigned char buf[16384]; /* large enough for 100 readers */
+  size_t pos;
+  size_t smhdr; /* offset of the current submessage header */
+  size_t hbcount; /* offset of the heartbeat count, 0 if none */
+};
+
+static void put (struct msg *m, const void *data, size_t sz)
+{
+  memcpy (m->buf + m->pos, data, sz);
+  m->pos += sz;
+}
+
+static void put_u16 (struct msg *m, uint16_t x) { put (m, &x, sizeof (x)); }
+static void put_u32 (struct msg *m, uint32_t x) { put (m, &x, sizeof (x)); }
+
+static void put_entityid (struct msg *m, uint32_t entityid)
+{
+  const unsigned char x[4] = {
+    (unsigned char) (entityid >> 24), (unsigned char) (entityid >> 16),
+    (unsigned char) (entityid >> 8), (unsigned char) entityid
+  };
+  put (m, x, sizeof (x));
+}
+
+static void put_param_hdr (struct msg *m, uint16_t pid, size_t len)
+{
+  put_u16 (m, pid);
+  put_u16 (m, (uint16_t) ((len + 3) & ~(size_t) 3));
+}
+
+static void put_pad (struct msg *m)
+{
+  while (m->pos % 4)
+    m->buf[m->pos++] = 0;
+}
+
+static void put_param_u32 (struct msg *m, uint16_t pid, uint32_t x)
+{
+  put_param_hdr (m, pid, 4);
+  put_u32 (m, x);
+}
+
+static void put_param_guid (struct msg *m, uint16_t pid, const unsigned char prefix[12], uint32_t entityid)
+{
+  put_param_hdr (m, pid, 16);
+  put (m, prefix, 12);
+  put_entityid (m, entityid);
+}
+
+static void put_param_string (struct msg *m, uint16_t pid, const char *str)
+{
+  const uint32_t len = (uint32_t) strlen (str) + 1;
+  put_param_hdr (m, pid, 4 + len);
+  put_u32 (m, len);
+  put (m, str, len);
+  put_pad (m);
+}
+
+static void put_param_locator (struct msg *m, uint16_t pid)
+{
+  const unsigned char addr[16] = { 0,0,0,0, 0,0,0,0, 0,0,0,0, 127,0,0,1 };
+  put_param_hdr (m, pid, 24);
+  put_u32 (m, NN_LOCATOR_KIND_UDPv4);
+  put_u32 (m, FAKE_PORT);
+  put (m, addr, sizeof (addr));
+}
+
+static void msg_init (struct msg *m, const unsigned char prefix[12])
+{
+  const unsigned char hdr[8] = { 'R', 'T', 'P', 'S', 2, 1, 1, 0x10 };
+  m->pos = 0;
+  m->hbcount = 0;
+  put (m, hdr, sizeof (hdr));
+  put (m, prefix, 12);
+}
+
+static void data_begin (struct msg *m, uint32_t rdid, uint32_t wrid, uint32_t seq)
+{
+  /* DATA with serialized payload in native endianness */
+  const unsigned char encoding[4] = { 0, (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? 3 : 2, 0, 0 };
+  m->smhdr = m->pos;
+  m->buf[m->pos++] = SMID_DATA;
+  m->buf[m->pos++] = (unsigned char) (DATA_FLAG_DATAFLAG | ((DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? SMFLAG_ENDIANNESS : 0));
+  put_u16 (m, 0); /* octetsToNextHeader: filled in by data_end */
+  put_u16 (m, 0); /* extraFlags */
+  put_u16 (m, 16); /* octetsToInlineQos */
+  put_entityid (m, rdid);
+  put_entityid (m, wrid);
+  put_u32 (m, 0);
+  put_u32 (m, seq);
+  put (m, encoding, sizeof (encoding));
+}
+
+static void data_end (struct msg *m)
+{
+  const uint16_t len = (uint16_t) (m->pos + 4 - m->smhdr - 4);
+  put_u16 (m, PID_SENTINEL);
+  put_u16 (m, 0);
+  memcpy (m->buf + m->smhdr + 2, &len, sizeof (len));
+}
+
+static void heartbeat (struct msg *m, uint32_t rdid, uint32_t wrid, uint32_t lastseq)
+{
+  /* the reader doesn't accept data from a reliable proxy writer until it has
+     seen a heartbeat; the count must increase for each retransmission */
+  m->buf[m->pos++] = SMID_HEARTBEAT;
+  m->buf[m->pos++] = (unsigned char) (HEARTBEAT_FLAG_FINAL | ((DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? SMFLAG_ENDIANNESS : 0));
+  put_u16 (m, 28);
+  put_entityid (m, rdid);
+  put_entityid (m, wrid);
+  put_u32 (m, 0);
+  put_u32 (m, 1);
+  put_u32 (m, 0);
+  put_u32 (m, lastseq);
+  m->hbcount = m->pos;
+  put_u32 (m, 0);
+}
+
+static void make_prefix (unsigned char prefix[12], uint32_t run, uint32_t i)
+{
+  const uint32_t pid = (uint32_t) ddsrt_getpid ();
+  prefix[0] = 0xd1; prefix[1] = 0x5c;
+  prefix[2] = (unsigned char) (run >> 8); prefix[3] = (unsigned char) run;
+  for (int k = 0; k < 4; k++)
+  {
+    prefix[4 + k] = (unsigned char) (pid >> (24 - 8 * k));
+    prefix[8 + k] = (unsigned char) (i >> (24 - 8 * k));
+  }
+}
+
+static void make_spdp (struct msg *m, const unsigned char prefix[12])
+{
+  const unsigned char protover[4] = { 2, 1, 0, 0 }, vendor[4] = { 1, 0x10, 0, 0 };
+  msg_init (m, prefix);
+  data_begin (m, NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_READER, NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER, 1);
+  put_param_hdr (m, PID_PROTOCOL_VERSION, 4);
+  put (m, protover, 4);
+  put_param_hdr (m, PID_VENDORID, 4);
+  put (m, vendor, 4);
+  put_param_guid (m, PID_PARTICIPANT_GUID, prefix, NN_ENTITYID_PARTICIPANT);
+  put_param_u32 (m, PID_BUILTIN_ENDPOINT_SET,
+                 NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_ANNOUNCER | NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_DETECTOR |
+                 NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_ANNOUNCER | NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_DETECTOR |
+                 NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_ANNOUNCER | NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_DETECTOR);
+  put_param_locator (m, PID_DEFAULT_UNICAST_LOCATOR);
+  put_param_locator (m, PID_METATRAFFIC_UNICAST_LOCATOR);
+  put_param_hdr (m, PID_PARTICIPANT_LEASE_DURATION, 8);
+  put_u32 (m, 100); /* seconds */
+  put_u32 (m, 0);
+  data_end (m);
+}
+
+static void make_sedp (struct msg *m, const unsigned char prefix[12], int nreaders, const char *topicname, const char *typename)
+{
+  msg_init (m, prefix);
+  heartbeat (m, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_WRITER, (uint32_t) nreaders);
+  for (int k = 0; k < nreaders; k++)
+  {
+    data_begin (m, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_WRITER, (uint32_t) k + 1);
+    put_param_guid (m, PID_ENDPOINT_GUID, prefix, ((uint32_t) k + 1) << 8 | NN_ENTITYID_KIND_READER_WITH_KEY);
+    put_param_string (m, PID_TOPIC_NAME, topicname);
+    put_param_string (m, PID_TYPE_NAME, typename);
+    data_end (m);
+  }
+}
+
+static int run (uint32_t runidx, int nqueues, int nparticipants, int nreaders, double *elapsed)
+{
+  char uri[1024], topicname[100];
+  struct msg *spdp, *sedp;
+  struct sockaddr_in dst;
+  ddsrt_socket_t sock;
+  dds_entity_t pp, tp, wr;
+  dds_publication_matched_status_t pm;
+  dds_time_t t0, tnext, tend;
+  uint32_t round = 0, lastcount = 0;
+  ssize_t sent;
+  int ret = 1;
+
+  *elapsed = 0.0;
+  snprintf (uri, sizeof (uri), URI_FMT, nqueues);
+  if (ddsrt_setenv ("CYCLONEDDS_URI", uri) != DDS_RETCODE_OK)
+    return 1;
+  snprintf (topicname, sizeof (topicname), "discbench_%"PRIdPID"_%"PRIu32, ddsrt_getpid (), runidx);
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, NULL, NULL);
+  wr = dds_create_writer (pp, tp, NULL, NULL);
+
+  memset (&dst, 0, sizeof (dst));
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons ((uint16_t) gv.loc_meta_uc.port);
+  dst.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (ddsrt_socket (&sock, AF_INET, SOCK_DGRAM, 0) != DDS_RETCODE_OK)
+    goto err_socket;
+  if (ddsrt_connect (sock, (struct sockaddr *) &dst, sizeof (dst)) != DDS_RETCODE_OK)
+    goto err_connect;
+
+  spdp = malloc ((size_t) nparticipants * sizeof (*spdp));
+  sedp = malloc ((size_t) nparticipants * sizeof (*sedp));
+  for (int i = 0; i < nparticipants; i++)
+  {
+    unsigned char prefix[12];
+    make_prefix (prefix, runidx, (uint32_t) i);
+    make_spdp (&spdp[i], prefix);
+    make_sedp (&sedp[i], prefix, nreaders, topicname, RhcTypes_T_desc.m_typename);
+  }
+
+  t0 = dds_time ();
+  tnext = t0;
+  tend = t0 + DDS_SECS (60);
+  do {
+    if (dds_time () >= tnext)
+    {
+      round++;
+      for (int i = 0; i < nparticipants; i++)
+        memcpy (sedp[i].buf + sedp[i].hbcount, &round, sizeof (round));
+      for (int i = 0; i < 2 * nparticipants; i++)
+      {
+        const struct msg *m = (i < nparticipants) ? &spdp[i] : &sedp[i - nparticipants];
+        (void) ddsrt_send (sock, m->buf, m->pos, 0, &sent);
+        /* pace it a bit, lest most of it be lost to socket buffer overflows */
+        if ((i % BURST_SIZE) == BURST_SIZE - 1)
+          dds_sleepfor (DDS_MSECS (1));
+      }
+      tnext = dds_time () + RESEND_INTERVAL;
+    }
+    dds_sleepfor (DDS_MSECS (1));
+    dds_get_publication_matched_status (wr, &pm);
+    if (pm.current_count != lastcount)
+    {
+      /* only resend once discovery stalls, retransmitting while it is
+         progressing merely adds to the load */
+      lastcount = pm.current_count;
+      tnext = dds_time () + RESEND_INTERVAL;
+    }
+  } while (pm.current_count < (uint32_t) (nparticipants * nreaders) && dds_time () < tend);
+  *elapsed = (double) (dds_time () - t0) / 1e9;
+  if (pm.current_count == (uint32_t) (nparticipants * nreaders))
+    ret = 0;
+
+  free (sedp);
+  free (spdp);
+err_connect:
+  ddsrt_close (sock);
+err_socket:
+  dds_delete (pp);
+  return ret;
+}
+
+int main (int argc, char **argv)
+{
+  int nparticipants = 200, nreaders = 10;
+  static const int nqueues[] = { 1, 2, 4, 8 };
+  double elapsed;
+
+  if (argc > 1)
+    nparticipants = atoi (argv[1]);
+  if (argc > 2)
+    nreaders = atoi (argv[2]);
+  if (nparticipants <= 0 || nreaders <= 0 || nreaders > 100)
+  {
+    fprintf (stderr, "usage: %s [PARTICIPANTS [READERS-PER-PARTICIPANT]]\n", argv[0]);
+    return 2;
+  }
+  printf ("%d participants, %d readers each\n", nparticipants, nreaders);
+  for (size_t i = 0; i < sizeof (nqueues) / sizeof (nqueues[0]); i++)
+  {
+    if (run ((uint32_t) i, nqueues[i], nparticipants, nreaders, &elapsed) != 0)
+    {
+      printf ("%d builtin delivery queues: discovery incomplete after %.3f s\n", nqueues[i], elapsed);
+      return 1;
+    }
+    printf ("%d builtin delivery queues: %.3f s\n", nqueues[i], elapsed);
+  }
+  return 0;
+}
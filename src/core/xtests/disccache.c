@@ -0,0 +1,353 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/endian.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_ephash.h"
+#include "dds/ddsi/q_entity.h"
+
+/* Checks that SPDP and SEDP messages identical to the last ones received
+   for a known participant or endpoint are not parsed, and that ones that
+   differ are.  The remote participant is fake: its SPDP and SEDP messages
+   are crafted here and sent over the loopback interface to the discovery
+   unicast port of the local participant, as in discbench.  A message was
+   skipped if the proxy's count of unchanged messages increased, and it was
+   parsed if the hash of the last payload the proxy was updated with
+   changed, which only happens after parsing it. */
+
+#define URI "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex></Discovery></CycloneDDS>"
+
+/* the fake participant's locators: nothing listens on this port */
+#define FAKE_PORT 7399
+
+#define READER_ENTITYID ((1u << 8) | NN_ENTITYID_KIND_READER_WITH_KEY)
+
+struct msg {
+  unsigned char buf[1024];
+  size_t pos;
+  size_t smhdr; /* offset of the current submessage header */
+};
+
+static void put (struct msg *m, const void *data, size_t sz)
+{
+  memcpy (m->buf + m->pos, data, sz);
+  m->pos += sz;
+}
+
+static void put_u16 (struct msg *m, uint16_t x) { put (m, &x, sizeof (x)); }
+static void put_u32 (struct msg *m, uint32_t x) { put (m, &x, sizeof (x)); }
+
+static void put_entityid (struct msg *m, uint32_t entityid)
+{
+  const unsigned char x[4] = {
+    (unsigned char) (entityid >> 24), (unsigned char) (entityid >> 16),
+    (unsigned char) (entityid >> 8), (unsigned char) entityid
+  };
+  put (m, x, sizeof (x));
+}
+
+static void put_param_hdr (struct msg *m, uint16_t pid, size_t len)
+{
+  put_u16 (m, pid);
+  put_u16 (m, (uint16_t) ((len + 3) & ~(size_t) 3));
+}
+
+static void put_pad (struct msg *m)
+{
+  while (m->pos % 4)
+    m->buf[m->pos++] = 0;
+}
+
+static void put_param_u32 (struct msg *m, uint16_t pid, uint32_t x)
+{
+  put_param_hdr (m, pid, 4);
+  put_u32 (m, x);
+}
+
+static void put_param_guid (struct msg *m, uint16_t pid, const unsigned char prefix[12], uint32_t entityid)
+{
+  put_param_hdr (m, pid, 16);
+  put (m, prefix, 12);
+  put_entityid (m, entityid);
+}
+
+static void put_param_string (struct msg *m, uint16_t pid, const char *str)
+{
+  const uint32_t len = (uint32_t) strlen (str) + 1;
+  put_param_hdr (m, pid, 4 + len);
+  put_u32 (m, len);
+  put (m, str, len);
+  put_pad (m);
+}
+
+static void put_param_locator (struct msg *m, uint16_t pid)
+{
+  const unsigned char addr[16] = { 0,0,0,0, 0,0,0,0, 0,0,0,0, 127,0,0,1 };
+  put_param_hdr (m, pid, 24);
+  put_u32 (m, NN_LOCATOR_KIND_UDPv4);
+  put_u32 (m, FAKE_PORT);
+  put (m, addr, sizeof (addr));
+}
+
+static void msg_init (struct msg *m, const unsigned char prefix[12])
+{
+  const unsigned char hdr[8] = { 'R', 'T', 'P', 'S', 2, 1, 1, 0x10 };
+  m->pos = 0;
+  put (m, hdr, sizeof (hdr));
+  put (m, prefix, 12);
+}
+
+static void data_begin (struct msg *m, uint32_t rdid, uint32_t wrid, uint32_t seq)
+{
+  /* DATA with serialized payload in native endianness */
+  const unsigned char encoding[4] = { 0, (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? 3 : 2, 0, 0 };
+  m->smhdr = m->pos;
+  m->buf[m->pos++] = SMID_DATA;
+  m->buf[m->pos++] = (unsigned char) (DATA_FLAG_DATAFLAG | ((DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? SMFLAG_ENDIANNESS : 0));
+  put_u16 (m, 0); /* octetsToNextHeader: filled in by data_end */
+  put_u16 (m, 0); /* extraFlags */
+  put_u16 (m, 16); /* octetsToInlineQos */
+  put_entityid (m, rdid);
+  put_entityid (m, wrid);
+  put_u32 (m, 0);
+  put_u32 (m, seq);
+  put (m, encoding, sizeof (encoding));
+}
+
+static void data_end (struct msg *m)
+{
+  const uint16_t len = (uint16_t) (m->pos + 4 - m->smhdr - 4);
+  put_u16 (m, PID_SENTINEL);
+  put_u16 (m, 0);
+  memcpy (m->buf + m->smhdr + 2, &len, sizeof (len));
+}
+
+static void heartbeat (struct msg *m, uint32_t rdid, uint32_t wrid, uint32_t lastseq, uint32_t count)
+{
+  /* the reader doesn't accept data from a reliable proxy writer until it has
+     seen a heartbeat; the count must increase for each one */
+  m->buf[m->pos++] = SMID_HEARTBEAT;
+  m->buf[m->pos++] = (unsigned char) (HEARTBEAT_FLAG_FINAL | ((DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? SMFLAG_ENDIANNESS : 0));
+  put_u16 (m, 28);
+  put_entityid (m, rdid);
+  put_entityid (m, wrid);
+  put_u32 (m, 0);
+  put_u32 (m, 1);
+  put_u32 (m, 0);
+  put_u32 (m, lastseq);
+  put_u32 (m, count);
+}
+
+static void make_spdp (struct msg *m, const unsigned char prefix[12], uint32_t lease_secs)
+{
+  const unsigned char protover[4] = { 2, 1, 0, 0 }, vendor[4] = { 1, 0x10, 0, 0 };
+  msg_init (m, prefix);
+  data_begin (m, NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_READER, NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER, 1);
+  put_param_hdr (m, PID_PROTOCOL_VERSION, 4);
+  put (m, protover, 4);
+  put_param_hdr (m, PID_VENDORID, 4);
+  put (m, vendor, 4);
+  put_param_guid (m, PID_PARTICIPANT_GUID, prefix, NN_ENTITYID_PARTICIPANT);
+  put_param_u32 (m, PID_BUILTIN_ENDPOINT_SET,
+                 NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_ANNOUNCER | NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_DETECTOR |
+                 NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_ANNOUNCER | NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_DETECTOR |
+                 NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_ANNOUNCER | NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_DETECTOR);
+  put_param_locator (m, PID_DEFAULT_UNICAST_LOCATOR);
+  put_param_locator (m, PID_METATRAFFIC_UNICAST_LOCATOR);
+  put_param_hdr (m, PID_PARTICIPANT_LEASE_DURATION, 8);
+  put_u32 (m, lease_secs);
+  put_u32 (m, 0);
+  data_end (m);
+}
+
+static void make_sedp (struct msg *m, const unsigned char prefix[12], uint32_t seq, const char *topicname)
+{
+  msg_init (m, prefix);
+  heartbeat (m, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_WRITER, seq, seq);
+  data_begin (m, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER, NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_WRITER, seq);
+  put_param_guid (m, PID_ENDPOINT_GUID, prefix, READER_ENTITYID);
+  put_param_string (m, PID_TOPIC_NAME, topicname);
+  put_param_string (m, PID_TYPE_NAME, "DiscCache");
+  data_end (m);
+}
+
+static void make_guid (nn_guid_t *guid, const unsigned char prefix[12], uint32_t entityid)
+{
+  for (int i = 0; i < 3; i++)
+    guid->prefix.u[i] = (uint32_t) prefix[4*i] << 24 | (uint32_t) prefix[4*i+1] << 16 | (uint32_t) prefix[4*i+2] << 8 | prefix[4*i+3];
+  guid->entityid.u = entityid;
+}
+
+struct state {
+  bool exists;
+  uint64_t hash;
+  uint32_t unchanged;
+};
+
+/* The counts only ever increase and the hash is only of interest once it
+   changed, so reading them without holding the lock is good enough here */
+static void get_state (const nn_guid_t *guid, struct state *st)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  thread_state_awake (ts1);
+  if (guid->entityid.u == NN_ENTITYID_PARTICIPANT)
+  {
+    struct proxy_participant *proxypp = ephash_lookup_proxy_participant_guid (guid);
+    st->exists = (proxypp != NULL);
+    st->hash = proxypp ? proxypp->spdp_hash : 0;
+    st->unchanged = proxypp ? proxypp->spdp_unchanged_count : 0;
+  }
+  else
+  {
+    struct proxy_reader *prd = ephash_lookup_proxy_reader_guid (guid);
+    st->exists = (prd != NULL);
+    st->hash = prd ? prd->c.sedp_hash : 0;
+    st->unchanged = prd ? prd->c.sedp_unchanged_count : 0;
+  }
+  thread_state_asleep (ts1);
+}
+
+enum until {
+  UNTIL_EXISTS,
+  UNTIL_UNCHANGED_COUNTED,
+  UNTIL_HASH_CHANGED
+};
+
+/* Sends m once a second until the state of guid meets the condition, then
+   returns true and leaves the new state in st, or returns false after a
+   while.  Sending a message more than once is harmless: sending it again
+   only ever counts as an unchanged message */
+static bool send_until (ddsrt_socket_t sock, const struct msg *m, const nn_guid_t *guid, enum until until, struct state *st)
+{
+  const struct state st0 = *st;
+  dds_time_t tnext = 0, tend = dds_time () + DDS_SECS (10);
+  ssize_t sent;
+  do {
+    if (dds_time () >= tnext)
+    {
+      (void) ddsrt_send (sock, m->buf, m->pos, 0, &sent);
+      tnext = dds_time () + DDS_SECS (1);
+    }
+    dds_sleepfor (DDS_MSECS (1));
+    get_state (guid, st);
+    switch (until)
+    {
+      case UNTIL_EXISTS:
+        if (st->exists && st->hash != 0)
+          return true;
+        break;
+      case UNTIL_UNCHANGED_COUNTED:
+        if (st->exists && st->unchanged > st0.unchanged)
+          return true;
+        break;
+      case UNTIL_HASH_CHANGED:
+        if (st->exists && st->hash != st0.hash)
+          return true;
+        break;
+    }
+  } while (dds_time () < tend);
+  return false;
+}
+
+static bool check (ddsrt_socket_t sock, const char *what, const struct msg *first, const struct msg *same, const struct msg *changed, const nn_guid_t *guid)
+{
+  struct state st;
+  uint32_t unchanged;
+  memset (&st, 0, sizeof (st));
+  if (!send_until (sock, first, guid, UNTIL_EXISTS, &st))
+  {
+    printf ("%s: not discovered\n", what);
+    return false;
+  }
+  if (!send_until (sock, same, guid, UNTIL_UNCHANGED_COUNTED, &st))
+  {
+    printf ("%s: unchanged data was parsed\n", what);
+    return false;
+  }
+  unchanged = st.unchanged;
+  if (!send_until (sock, changed, guid, UNTIL_HASH_CHANGED, &st))
+  {
+    printf ("%s: changed data was not parsed\n", what);
+    return false;
+  }
+  printf ("%s: unchanged data skipped, changed data parsed%s\n", what, (st.unchanged == unchanged) ? "" : " (after a resend)");
+  return true;
+}
+
+int main (int argc, char **argv)
+{
+  char topicname[100];
+  unsigned char prefix[12];
+  struct msg spdp, spdp_changed, sedp, sedp_same, sedp_changed;
+  struct sockaddr_in dst;
+  ddsrt_socket_t sock;
+  dds_entity_t pp;
+  nn_guid_t ppguid, rdguid;
+  uint32_t pid = (uint32_t) ddsrt_getpid ();
+  int ret = 1;
+
+  (void) argc;
+  (void) argv;
+  if (ddsrt_setenv ("CYCLONEDDS_URI", URI) != DDS_RETCODE_OK)
+    return 1;
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  snprintf (topicname, sizeof (topicname), "disccache_%"PRIdPID, ddsrt_getpid ());
+
+  memset (&dst, 0, sizeof (dst));
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons ((uint16_t) gv.loc_meta_uc.port);
+  dst.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (ddsrt_socket (&sock, AF_INET, SOCK_DGRAM, 0) != DDS_RETCODE_OK)
+    goto err_socket;
+  if (ddsrt_connect (sock, (struct sockaddr *) &dst, sizeof (dst)) != DDS_RETCODE_OK)
+    goto err_connect;
+
+  prefix[0] = 0xd1; prefix[1] = 0x5c; prefix[2] = 0xca; prefix[3] = 0xc4;
+  for (int k = 0; k < 4; k++)
+  {
+    prefix[4 + k] = (unsigned char) (pid >> (24 - 8 * k));
+    prefix[8 + k] = 0;
+  }
+  make_guid (&ppguid, prefix, NN_ENTITYID_PARTICIPANT);
+  make_guid (&rdguid, prefix, READER_ENTITYID);
+
+  /* SPDP is always delivered, a copy of the same message will do; SEDP is
+     reliable, so a re-announcement with the same contents must have a new
+     sequence number */
+  make_spdp (&spdp, prefix, 100);
+  make_spdp (&spdp_changed, prefix, 101);
+  make_sedp (&sedp, prefix, 1, topicname);
+  make_sedp (&sedp_same, prefix, 2, topicname);
+  make_sedp (&sedp_changed, prefix, 3, "disccache_other");
+  if (check (sock, "SPDP", &spdp, &spdp, &spdp_changed, &ppguid) &&
+      check (sock, "SEDP", &sedp, &sedp_same, &sedp_changed, &rdguid))
+    ret = 0;
+
+err_connect:
+  ddsrt_close (sock);
+err_socket:
+  dds_delete (pp);
+  return ret;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_whc.h"
+#include "dds__entity.h"
+#include "dds__types.h"
+
+#include "RhcTypes.h"
+
+/* Checks that a writer evaluates the content filter of a remote reader and
+   sends that reader a GAP instead of the samples it rejects, both when
+   first sending the samples and when the reader requests a retransmit
+   because the GAP got lost.  The publisher drops outgoing packets
+   (Internal/Test/XmitLossiness), the subscriber, a copy of this process,
+   doesn't.  The subscriber counts the samples its own filter rejects:
+   it never gets to see a rejected sample if the writer filtered them. */
+
+#define URI_PUB "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery><Internal><Test><XmitLossiness>%d</XmitLossiness></Test></Internal></CycloneDDS>"
+#define URI_SUB "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery></CycloneDDS>"
+
+/* The filter: expression "x % %0 == 0" with an integer parameter */
+static ddsrt_atomic_uint32_t nrejected = DDSRT_ATOMIC_UINT32_INIT (0);
+
+static void *mod_compile (const dds_topic_descriptor_t *desc, const char *expression, uint32_t nparams, const char * const *params)
+{
+  int32_t *mod;
+  if (desc != &RhcTypes_T_desc || strcmp (expression, "x % %0 == 0") != 0 || nparams != 1 || atoi (params[0]) <= 0)
+    return NULL;
+  mod = ddsrt_malloc (sizeof (*mod));
+  *mod = (int32_t) atoi (params[0]);
+  return mod;
+}
+
+static bool mod_accept (const void *compiled, const void *sample)
+{
+  const bool accept = (((const RhcTypes_T *) sample)->x % *(const int32_t *) compiled == 0);
+  if (!accept)
+    ddsrt_atomic_inc32 (&nrejected);
+  return accept;
+}
+
+static void mod_free (void *compiled)
+{
+  ddsrt_free (compiled);
+}
+
+static const dds_content_filter_class_t mod_class = {
+  "xtests_filtergap_mod", mod_compile, mod_accept, mod_free
+};
+
+#define MOD 3
+#define MOD_STR "3"
+
+static dds_qos_t *reliable_qos (void)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  /* so that it doesn't matter whether the reader has discovered the
+     writer by the time it starts writing */
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  return qos;
+}
+
+static int subscriber (const char *topicname, int nsamples)
+{
+  static const char *params[] = { MOD_STR };
+  dds_qos_t *qos;
+  dds_entity_t pp, tp, rd;
+  dds_subscription_matched_status_t sm;
+  dds_time_t tend = dds_time () + DDS_SECS (60);
+  int nrecv = 0, nbad = 0;
+  unsigned char *seen;
+  if (ddsrt_setenv ("CYCLONEDDS_URI", URI_SUB) != DDS_RETCODE_OK)
+    return 1;
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  rd = dds_create_filtered_reader (pp, tp, mod_class.name, "x % %0 == 0", 1, params, qos, NULL);
+  dds_delete_qos (qos);
+  /* historical data may be delivered after the first live samples, so only
+     check that each accepted sample arrives exactly once */
+  seen = ddsrt_malloc ((size_t) nsamples);
+  memset (seen, 0, (size_t) nsamples);
+  /* take everything until the publisher has come and gone */
+  do {
+    RhcTypes_T x;
+    void *ptr = &x;
+    dds_sample_info_t si;
+    memset (&x, 0, sizeof (x));
+    if (dds_take (rd, &ptr, &si, 1, 1) > 0)
+    {
+      if (si.valid_data)
+      {
+        nrecv++;
+        if (x.x < 0 || x.x >= nsamples || x.x % MOD != 0 || seen[x.x]++)
+          nbad++;
+      }
+      dds_return_loan (rd, &ptr, 1);
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+    dds_get_subscription_matched_status (rd, &sm);
+  } while (rd > 0 && !(sm.total_count > 0 && sm.current_count == 0) && dds_time () < tend);
+  dds_delete (pp);
+  ddsrt_free (seen);
+  printf ("subscriber: %d samples received, %d unexpected, %"PRIu32" rejected by the reader\n", nrecv, nbad, ddsrt_atomic_ld32 (&nrejected));
+  return (nrecv == (nsamples + MOD - 1) / MOD && nbad == 0 && ddsrt_atomic_ld32 (&nrejected) == 0) ? 0 : 1;
+}
+
+struct counts {
+  uint32_t filter_gaps;
+  uint32_t filter_rexmit_gaps;
+  size_t unacked_bytes;
+};
+
+static void get_counts (dds_entity_t wrhandle, struct counts *c)
+{
+  dds_entity *x;
+  struct writer *wr;
+  struct whc_state whcst;
+  if (dds_entity_lock (wrhandle, DDS_KIND_WRITER, &x) < 0)
+    abort ();
+  wr = ((dds_writer *) x)->m_wr;
+  ddsrt_mutex_lock (&wr->e.lock);
+  c->filter_gaps = wr->filter_gap_count;
+  c->filter_rexmit_gaps = wr->filter_rexmit_gap_count;
+  whc_get_state (wr->whc, &whcst);
+  c->unacked_bytes = whcst.unacked_bytes;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  dds_entity_unlock (x);
+}
+
+int main (int argc, char **argv)
+{
+  char topicname[100], nsamples_str[20], uri[1024];
+  char *sub_argv[] = { "-sub", topicname, nsamples_str, NULL };
+  int nsamples = 300, lossiness = 200, result = 1;
+  dds_entity_t pp, tp, wr;
+  dds_publication_matched_status_t pm;
+  ddsrt_pid_t pid;
+  int32_t code = -1;
+  dds_time_t tend;
+  dds_qos_t *qos;
+
+  if (dds_register_content_filter_class (&mod_class) != DDS_RETCODE_OK)
+    return 1;
+  if (argc == 4 && strcmp (argv[1], "-sub") == 0)
+    return subscriber (argv[2], atoi (argv[3]));
+  if (argc > 1)
+    nsamples = atoi (argv[1]);
+  if (argc > 2)
+    lossiness = atoi (argv[2]);
+  snprintf (topicname, sizeof (topicname), "filtergap_%"PRIdPID, ddsrt_getpid ());
+  snprintf (nsamples_str, sizeof (nsamples_str), "%d", nsamples);
+  snprintf (uri, sizeof (uri), URI_PUB, lossiness);
+  if (ddsrt_setenv ("CYCLONEDDS_URI", uri) != DDS_RETCODE_OK)
+    return 1;
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  wr = dds_create_writer (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  if (ddsrt_proc_create (argv[0], sub_argv, &pid) != DDS_RETCODE_OK)
+  {
+    dds_delete (pp);
+    return 1;
+  }
+  tend = dds_time () + DDS_SECS (60);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    dds_get_publication_matched_status (wr, &pm);
+  } while (pm.current_count == 0 && dds_time () < tend);
+
+  if (pm.current_count > 0)
+  {
+    RhcTypes_T x = { 0, "key", 0, 0, "" };
+    struct counts c;
+    result = 0;
+    for (int i = 0; i < nsamples && result == 0; i++)
+    {
+      x.x = i;
+      if (dds_write (wr, &x) != DDS_RETCODE_OK)
+        result = 1;
+      else if (i % 10 == 9)
+        dds_sleepfor (DDS_MSECS (1));
+    }
+    /* all samples acknowledged means the accepted samples were delivered
+       and the GAPs for the rejected ones arrived */
+    tend = dds_time () + DDS_SECS (30);
+    do {
+      dds_sleepfor (DDS_MSECS (10));
+      get_counts (wr, &c);
+    } while (c.unacked_bytes > 0 && dds_time () < tend);
+    printf ("%d samples, %.1f%% loss: %"PRIu32" GAPs for rejected samples, %"PRIu32" retransmit requests for rejected samples, %zu unacked bytes left\n",
+            nsamples, lossiness / 10.0, c.filter_gaps, c.filter_rexmit_gaps, c.unacked_bytes);
+    if (c.unacked_bytes > 0 || c.filter_gaps == 0 || (lossiness > 0 && c.filter_rexmit_gaps == 0))
+      result = 1;
+  }
+  dds_delete (pp);
+  (void) ddsrt_proc_waitpid (pid, DDS_SECS (30), &code);
+  return (result == 0 && code == 0) ? 0 : 1;
+}
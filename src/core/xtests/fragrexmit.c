@@ -0,0 +1,186 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_whc.h"
+#include "dds__entity.h"
+#include "dds__types.h"
+
+#include "RhcTypes.h"
+
+/* Checks that lost fragments of large samples are retransmitted with
+   several fragments combined in a single DATAFRAG, and that all samples
+   get delivered, while the retransmits are paced
+   (Internal/RetransmitBandwidthLimit).  The publisher drops outgoing
+   packets (Internal/Test/XmitLossiness), the subscriber, a copy of this
+   process, doesn't, so its ACKNACKs and NACKFRAGs all arrive. */
+
+#define URI_PUB "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery><Internal><Test><XmitLossiness>%d</XmitLossiness></Test><RetransmitBandwidthLimit>100Mb/s</RetransmitBandwidthLimit></Internal></CycloneDDS>"
+#define URI_SUB "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery></CycloneDDS>"
+
+#define SAMPLE_SIZE 100000
+
+static dds_qos_t *reliable_qos (void)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  /* so that it doesn't matter whether the reader has discovered the
+     writer by the time it starts writing */
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  return qos;
+}
+
+static int subscriber (const char *topicname, int nsamples)
+{
+  dds_qos_t *qos;
+  dds_entity_t pp, tp, rd;
+  dds_subscription_matched_status_t sm;
+  dds_time_t tend = dds_time () + DDS_SECS (60);
+  int nrecv = 0, nbad = 0;
+  if (ddsrt_setenv ("CYCLONEDDS_URI", URI_SUB) != DDS_RETCODE_OK)
+    return 1;
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  rd = dds_create_reader (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  /* take everything until the publisher has come and gone */
+  do {
+    RhcTypes_T x;
+    void *ptr = &x;
+    dds_sample_info_t si;
+    memset (&x, 0, sizeof (x));
+    if (dds_take (rd, &ptr, &si, 1, 1) > 0)
+    {
+      if (si.valid_data)
+      {
+        nrecv++;
+        if (x.s == NULL || strlen (x.s) != SAMPLE_SIZE)
+          nbad++;
+      }
+      dds_return_loan (rd, &ptr, 1);
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+    dds_get_subscription_matched_status (rd, &sm);
+  } while (!(sm.total_count > 0 && sm.current_count == 0) && dds_time () < tend);
+  dds_delete (pp);
+  return (nrecv == nsamples && nbad == 0) ? 0 : 1;
+}
+
+struct counts {
+  uint32_t multifrag;
+  size_t unacked_bytes;
+};
+
+static void get_counts (dds_entity_t wrhandle, struct counts *c)
+{
+  dds_entity *x;
+  struct writer *wr;
+  struct whc_state whcst;
+  if (dds_entity_lock (wrhandle, DDS_KIND_WRITER, &x) < 0)
+    abort ();
+  wr = ((dds_writer *) x)->m_wr;
+  ddsrt_mutex_lock (&wr->e.lock);
+  c->multifrag = wr->rexmit_multifrag_count;
+  whc_get_state (wr->whc, &whcst);
+  c->unacked_bytes = whcst.unacked_bytes;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  dds_entity_unlock (x);
+}
+
+int main (int argc, char **argv)
+{
+  char topicname[100], nsamples_str[20], uri[1024];
+  char *sub_argv[] = { "-sub", topicname, nsamples_str, NULL };
+  int nsamples = 20, lossiness = 200, result = 1;
+  dds_entity_t pp, tp, wr;
+  dds_publication_matched_status_t pm;
+  ddsrt_pid_t pid;
+  int32_t code = -1;
+  dds_time_t tend;
+  dds_qos_t *qos;
+
+  if (argc == 4 && strcmp (argv[1], "-sub") == 0)
+    return subscriber (argv[2], atoi (argv[3]));
+  if (argc > 1)
+    nsamples = atoi (argv[1]);
+  if (argc > 2)
+    lossiness = atoi (argv[2]);
+  snprintf (topicname, sizeof (topicname), "fragrexmit_%"PRIdPID, ddsrt_getpid ());
+  snprintf (nsamples_str, sizeof (nsamples_str), "%d", nsamples);
+  snprintf (uri, sizeof (uri), URI_PUB, lossiness);
+  if (ddsrt_setenv ("CYCLONEDDS_URI", uri) != DDS_RETCODE_OK)
+    return 1;
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  wr = dds_create_writer (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  if (ddsrt_proc_create (argv[0], sub_argv, &pid) != DDS_RETCODE_OK)
+  {
+    dds_delete (pp);
+    return 1;
+  }
+  tend = dds_time () + DDS_SECS (60);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    dds_get_publication_matched_status (wr, &pm);
+  } while (pm.current_count == 0 && dds_time () < tend);
+
+  if (pm.current_count > 0)
+  {
+    RhcTypes_T x = { 0, "key", 0, 0, NULL };
+    struct counts c;
+    dds_time_t t0 = dds_time ();
+    x.s = ddsrt_malloc (SAMPLE_SIZE + 1);
+    memset (x.s, 'x', SAMPLE_SIZE);
+    x.s[SAMPLE_SIZE] = 0;
+    result = 0;
+    for (int i = 0; i < nsamples && result == 0; i++)
+    {
+      x.x = i;
+      if (dds_write (wr, &x) != DDS_RETCODE_OK)
+        result = 1;
+    }
+    ddsrt_free (x.s);
+    /* all samples acknowledged means all samples delivered */
+    tend = dds_time () + DDS_SECS (30);
+    do {
+      dds_sleepfor (DDS_MSECS (10));
+      get_counts (wr, &c);
+    } while (c.unacked_bytes > 0 && dds_time () < tend);
+    printf ("%d samples of %d bytes, %.1f%% loss: %.3f s, %"PRIu32" retransmitted DATAFRAGs with multiple fragments, %zu unacked bytes left\n",
+            nsamples, SAMPLE_SIZE, lossiness / 10.0, (double) (dds_time () - t0) / 1e9, c.multifrag, c.unacked_bytes);
+    if (c.unacked_bytes > 0 || c.multifrag == 0)
+      result = 1;
+  }
+  dds_delete (pp);
+  (void) ddsrt_proc_waitpid (pid, DDS_SECS (30), &code);
+  return (result == 0 && code == 0) ? 0 : 1;
+}
@@ -0,0 +1,1019 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/avl.h"
+#include "dds/ddsrt/fibheap.h"
+#include "dds/dds.h"
+#include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/ddsi_iid.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_rhc_plugin.h"
+#include "dds/ddsi/q_freelist.h"
+#include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds__entity.h"
+#include "dds__topic.h"
+#include "dds__rhc.h"
+
+#include "MicrobenchTypes.h"
+
+#if defined (__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#define HAVE_PERF_EVENTS 1
+#else
+#define HAVE_PERF_EVENTS 0
+#endif
+
+/* Microbenchmarks for the data structures and serialisation paths that dominate the
+   per-sample cost: hopscotch hash tables, AVL trees, the Fibonacci heap, the lock-free
+   freelist, CDR (de)serialisation, the instance map and the reader history cache.
+
+   Each benchmark is run over a set of container sizes (or sample sizes), reports the
+   time per operation, the number of heap allocations per operation and the number of
+   cache misses per operation, and can compare the result against a previously saved
+   run. */
+
+/*****************************************************************************************
+ *
+ *  Allocation counting
+ *
+ *****************************************************************************************/
+
+static ddsrt_thread_local int count_allocs;
+static uint64_t nallocs;
+
+#if defined (__GLIBC__)
+/* Interposing malloc & friends in the executable catches all allocations done through
+   ddsrt_malloc in the DDS library as well; only those made by the measuring thread while
+   running a benchmark are counted. */
+#define HAVE_ALLOC_COUNTING 1
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+
+void *malloc (size_t size)
+{
+  if (count_allocs)
+    nallocs++;
+  return __libc_malloc (size);
+}
+
+void *calloc (size_t nmemb, size_t size)
+{
+  if (count_allocs)
+    nallocs++;
+  return __libc_calloc (nmemb, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+  if (count_allocs)
+    nallocs++;
+  return __libc_realloc (ptr, size);
+}
+
+void free (void *ptr)
+{
+  __libc_free (ptr);
+}
+#else
+#define HAVE_ALLOC_COUNTING 0
+#endif
+
+/*****************************************************************************************
+ *
+ *  Cache miss counting
+ *
+ *****************************************************************************************/
+
+#if HAVE_PERF_EVENTS
+static int perf_fd = -1;
+
+static void cachemiss_init (void)
+{
+  struct perf_event_attr pea;
+  memset (&pea, 0, sizeof (pea));
+  pea.type = PERF_TYPE_HARDWARE;
+  pea.size = sizeof (pea);
+  pea.config = PERF_COUNT_HW_CACHE_MISSES;
+  pea.disabled = 1;
+  pea.exclude_kernel = 1;
+  pea.exclude_hv = 1;
+  /* counting only the calling thread, on any CPU; fails in many containers and VMs,
+     in which case cache misses are simply not reported */
+  perf_fd = (int) syscall (__NR_perf_event_open, &pea, 0, -1, -1, 0);
+}
+
+static void cachemiss_fini (void)
+{
+  if (perf_fd >= 0)
+    close (perf_fd);
+}
+
+static void cachemiss_start (void)
+{
+  if (perf_fd >= 0)
+  {
+    ioctl (perf_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl (perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+static bool cachemiss_stop (uint64_t *count)
+{
+  if (perf_fd < 0)
+    return false;
+  ioctl (perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+  return read (perf_fd, count, sizeof (*count)) == (ssize_t) sizeof (*count);
+}
+#else
+static void cachemiss_init (void) { }
+static void cachemiss_fini (void) { }
+static void cachemiss_start (void) { }
+static bool cachemiss_stop (uint64_t *count) { (void) count; return false; }
+#endif
+
+/*****************************************************************************************
+ *
+ *  DDS-side setup shared by the CDR, tkmap and RHC benchmarks
+ *
+ *****************************************************************************************/
+
+static dds_entity_t ppant;
+static ddsrt_prng_t prng;
+
+static struct ddsi_sertopic *get_sertopic (const dds_topic_descriptor_t *desc, const char *name)
+{
+  struct ddsi_sertopic *st;
+  struct dds_entity *x;
+  dds_entity_t tp;
+  if (ppant == 0 && (ppant = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+  {
+    fprintf (stderr, "dds_create_participant: error %"PRId32"\n", ppant);
+    exit (2);
+  }
+  if ((tp = dds_find_topic (ppant, name)) < 0 &&
+      (tp = dds_create_topic (ppant, desc, name, NULL, NULL)) < 0)
+  {
+    fprintf (stderr, "dds_create_topic: error %"PRId32"\n", tp);
+    exit (2);
+  }
+  if (dds_entity_lock (tp, DDS_KIND_TOPIC, &x) < 0)
+    abort ();
+  st = dds_topic_lookup (x->m_domain, name);
+  dds_entity_unlock (x);
+  return st;
+}
+
+static void permute (uint32_t *order, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    order[i] = i;
+  for (uint32_t i = n; i > 1; i--)
+  {
+    uint32_t j = ddsrt_prng_random (&prng) % i, t = order[i-1];
+    order[i-1] = order[j];
+    order[j] = t;
+  }
+}
+
+/*****************************************************************************************
+ *
+ *  Generic data structures: hopscotch, AVL, Fibonacci heap, freelist
+ *
+ *****************************************************************************************/
+
+struct elem {
+  ddsrt_avl_node_t avlnode;
+  ddsrt_fibheap_node_t fhnode;
+  struct elem *next;
+  uint64_t prio;
+  uint32_t key;
+};
+
+struct ds_state {
+  uint32_t n, cursor;
+  struct elem *elems;  /* 2n: the first n are in the container initially */
+  uint32_t *slot;      /* slot[i]: index of an element currently in the container */
+  uint32_t *spare;     /* spare[i]: index of an element currently not in the container */
+  struct ddsrt_hh *hh;
+  struct ddsrt_chh *chh;
+  ddsrt_avl_tree_t avl;
+  ddsrt_fibheap_t fh;
+  struct nn_freelist fl;
+};
+
+static uint32_t elem_hash (const void *va)
+{
+  const struct elem *a = va;
+  return (uint32_t) (((uint64_t) a->key * UINT64_C (16292676669999574021)) >> 32);
+}
+
+static int elem_equals (const void *va, const void *vb)
+{
+  const struct elem *a = va, *b = vb;
+  return a->key == b->key;
+}
+
+static int elem_cmp (const void *va, const void *vb)
+{
+  const uint32_t *a = va, *b = vb;
+  return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
+}
+
+static int elem_prio_cmp (const void *va, const void *vb)
+{
+  const struct elem *a = va, *b = vb;
+  return (a->prio == b->prio) ? 0 : (a->prio < b->prio) ? -1 : 1;
+}
+
+static void chh_gc_buckets (void *bs)
+{
+  /* single-threaded use only, so no need to defer */
+  ddsrt_free (bs);
+}
+
+static const ddsrt_avl_treedef_t elem_avltd = DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct elem, avlnode), offsetof (struct elem, key), elem_cmp, 0);
+static const ddsrt_fibheap_def_t elem_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER (offsetof (struct elem, fhnode), elem_prio_cmp);
+
+static struct ds_state *ds_new (uint32_t n)
+{
+  struct ds_state *st = ddsrt_malloc (sizeof (*st));
+  memset (st, 0, sizeof (*st));
+  st->n = n;
+  st->elems = ddsrt_malloc (2 * n * sizeof (*st->elems));
+  st->slot = ddsrt_malloc (n * sizeof (*st->slot));
+  st->spare = ddsrt_malloc (n * sizeof (*st->spare));
+  memset (st->elems, 0, 2 * n * sizeof (*st->elems));
+  for (uint32_t i = 0; i < 2 * n; i++)
+  {
+    /* a bijection on uint32_t, so keys are unique but not sequential */
+    st->elems[i].key = i * 2654435761u;
+    st->elems[i].prio = i;
+  }
+  permute (st->slot, n);
+  permute (st->spare, n);
+  for (uint32_t i = 0; i < n; i++)
+    st->spare[i] += n;
+  return st;
+}
+
+static void ds_free (struct ds_state *st)
+{
+  ddsrt_free (st->spare);
+  ddsrt_free (st->slot);
+  ddsrt_free (st->elems);
+  ddsrt_free (st);
+}
+
+static struct elem *ds_next_lookup (struct ds_state *st)
+{
+  struct elem *e = &st->elems[st->slot[st->cursor]];
+  if (++st->cursor == st->n)
+    st->cursor = 0;
+  return e;
+}
+
+static void ds_next_replace (struct ds_state *st, struct elem **out, struct elem **in)
+{
+  /* swaps a random element in the container for one that isn't, keeping the size constant */
+  uint32_t t = st->slot[st->cursor];
+  *out = &st->elems[t];
+  *in = &st->elems[st->spare[st->cursor]];
+  st->slot[st->cursor] = st->spare[st->cursor];
+  st->spare[st->cursor] = t;
+  if (++st->cursor == st->n)
+    st->cursor = 0;
+}
+
+static void *hh_setup (uint32_t n, uint32_t size)
+{
+  struct ds_state *st = ds_new (n);
+  (void) size;
+  st->hh = ddsrt_hh_new (1, elem_hash, elem_equals);
+  for (uint32_t i = 0; i < n; i++)
+    ddsrt_hh_add (st->hh, &st->elems[i]);
+  return st;
+}
+
+static void hh_teardown (void *vst)
+{
+  struct ds_state *st = vst;
+  ddsrt_hh_free (st->hh);
+  ds_free (st);
+}
+
+static void hh_lookup_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *e = ds_next_lookup (st);
+    if (ddsrt_hh_lookup (st->hh, e) != e)
+      abort ();
+  }
+}
+
+static void hh_add_remove_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *out, *in;
+    ds_next_replace (st, &out, &in);
+    if (!ddsrt_hh_remove (st->hh, out) || !ddsrt_hh_add (st->hh, in))
+      abort ();
+  }
+}
+
+static void *chh_setup (uint32_t n, uint32_t size)
+{
+  struct ds_state *st = ds_new (n);
+  (void) size;
+  st->chh = ddsrt_chh_new (1, elem_hash, elem_equals, chh_gc_buckets);
+  for (uint32_t i = 0; i < n; i++)
+    ddsrt_chh_add (st->chh, &st->elems[i]);
+  return st;
+}
+
+static void chh_teardown (void *vst)
+{
+  struct ds_state *st = vst;
+  ddsrt_chh_free (st->chh);
+  ds_free (st);
+}
+
+static void chh_lookup_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *e = ds_next_lookup (st);
+    if (ddsrt_chh_lookup (st->chh, e) != e)
+      abort ();
+  }
+}
+
+static void chh_add_remove_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *out, *in;
+    ds_next_replace (st, &out, &in);
+    if (!ddsrt_chh_remove (st->chh, out) || !ddsrt_chh_add (st->chh, in))
+      abort ();
+  }
+}
+
+static void *avl_setup (uint32_t n, uint32_t size)
+{
+  struct ds_state *st = ds_new (n);
+  (void) size;
+  ddsrt_avl_init (&elem_avltd, &st->avl);
+  for (uint32_t i = 0; i < n; i++)
+    ddsrt_avl_insert (&elem_avltd, &st->avl, &st->elems[i]);
+  return st;
+}
+
+static void avl_teardown (void *vst)
+{
+  struct ds_state *st = vst;
+  ddsrt_avl_free (&elem_avltd, &st->avl, 0);
+  ds_free (st);
+}
+
+static void avl_lookup_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *e = ds_next_lookup (st);
+    if (ddsrt_avl_lookup (&elem_avltd, &st->avl, &e->key) != e)
+      abort ();
+  }
+}
+
+static void avl_insert_delete_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *out, *in;
+    ds_next_replace (st, &out, &in);
+    ddsrt_avl_delete (&elem_avltd, &st->avl, out);
+    ddsrt_avl_insert (&elem_avltd, &st->avl, in);
+  }
+}
+
+static void *fibheap_setup (uint32_t n, uint32_t size)
+{
+  struct ds_state *st = ds_new (n);
+  (void) size;
+  ddsrt_fibheap_init (&elem_fhdef, &st->fh);
+  for (uint32_t i = 0; i < n; i++)
+    ddsrt_fibheap_insert (&elem_fhdef, &st->fh, &st->elems[st->slot[i]]);
+  return st;
+}
+
+static void fibheap_teardown (void *vst)
+{
+  ds_free (vst);
+}
+
+static void fibheap_extract_insert_run (void *vst, uint64_t iters)
+{
+  /* the typical timed-event queue pattern: take the earliest, reschedule it for later */
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct elem *e = ddsrt_fibheap_extract_min (&elem_fhdef, &st->fh);
+    e->prio += st->n;
+    ddsrt_fibheap_insert (&elem_fhdef, &st->fh, e);
+  }
+}
+
+static void *freelist_setup (uint32_t n, uint32_t size)
+{
+  struct ds_state *st = ds_new (n);
+  (void) size;
+  nn_freelist_init (&st->fl, n, offsetof (struct elem, next));
+  for (uint32_t i = 0; i < n; i++)
+    nn_freelist_push (&st->fl, &st->elems[i]);
+  return st;
+}
+
+static void freelist_noop_free (void *elem)
+{
+  (void) elem;
+}
+
+static void freelist_teardown (void *vst)
+{
+  struct ds_state *st = vst;
+  nn_freelist_fini (&st->fl, freelist_noop_free);
+  ds_free (st);
+}
+
+static void freelist_pop_push_run (void *vst, uint64_t iters)
+{
+  struct ds_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    void *e = nn_freelist_pop (&st->fl);
+    if (e == NULL || !nn_freelist_push (&st->fl, e))
+      abort ();
+  }
+}
+
+/*****************************************************************************************
+ *
+ *  CDR serialisation, deserialisation and key extraction
+ *
+ *****************************************************************************************/
+
+struct cdr_state {
+  const struct ddsi_sertopic *tp;
+  void *sample;
+  void *rsample;
+  struct ddsi_serdata *sd;
+};
+
+static struct cdr_state *cdr_new (const dds_topic_descriptor_t *desc, const char *name, void *sample)
+{
+  struct cdr_state *st = ddsrt_malloc (sizeof (*st));
+  st->tp = get_sertopic (desc, name);
+  st->sample = sample;
+  st->rsample = ddsrt_malloc (desc->m_size);
+  memset (st->rsample, 0, desc->m_size);
+  st->sd = ddsi_serdata_from_sample (st->tp, SDK_DATA, st->sample);
+  return st;
+}
+
+static void *cdr_small_setup (uint32_t n, uint32_t size)
+{
+  MicrobenchTypes_Small *s = ddsrt_malloc (sizeof (*s));
+  (void) n; (void) size;
+  s->k = 1;
+  s->v = 2;
+  return cdr_new (&MicrobenchTypes_Small_desc, "MicrobenchTypes_Small", s);
+}
+
+static void *cdr_array_setup (uint32_t n, uint32_t size)
+{
+  MicrobenchTypes_Array *s = ddsrt_malloc (sizeof (*s));
+  (void) n; (void) size;
+  s->k = 1;
+  memset (s->payload, 0x55, sizeof (s->payload));
+  return cdr_new (&MicrobenchTypes_Array_desc, "MicrobenchTypes_Array", s);
+}
+
+static void *cdr_seq_setup (uint32_t n, uint32_t size)
+{
+  MicrobenchTypes_Seq *s = ddsrt_malloc (sizeof (*s));
+  (void) n;
+  s->k = 1;
+  s->name = ddsrt_strdup ("microbench");
+  s->payload._maximum = s->payload._length = size;
+  s->payload._buffer = ddsrt_malloc (size > 0 ? size : 1);
+  s->payload._release = true;
+  memset (s->payload._buffer, 0x55, size);
+  return cdr_new (&MicrobenchTypes_Seq_desc, "MicrobenchTypes_Seq", s);
+}
+
+static void cdr_teardown (void *vst)
+{
+  struct cdr_state *st = vst;
+  ddsi_serdata_unref (st->sd);
+  ddsi_sertopic_free_sample (st->tp, st->rsample, DDS_FREE_ALL);
+  ddsi_sertopic_free_sample (st->tp, st->sample, DDS_FREE_ALL);
+  ddsrt_free (st);
+}
+
+static void cdr_write_run (void *vst, uint64_t iters)
+{
+  struct cdr_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+    ddsi_serdata_unref (ddsi_serdata_from_sample (st->tp, SDK_DATA, st->sample));
+}
+
+static void cdr_read_run (void *vst, uint64_t iters)
+{
+  struct cdr_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+    if (!ddsi_serdata_to_sample (st->sd, st->rsample, NULL, NULL))
+      abort ();
+}
+
+static void cdr_key_run (void *vst, uint64_t iters)
+{
+  struct cdr_state *st = vst;
+  for (uint64_t i = 0; i < iters; i++)
+    ddsi_serdata_unref (ddsi_serdata_to_topicless (st->sd));
+}
+
+/*****************************************************************************************
+ *
+ *  Instance map and reader history cache
+ *
+ *****************************************************************************************/
+
+struct inst_state {
+  uint32_t n, cursor;
+  const struct ddsi_sertopic *tp;
+  struct ddsi_serdata **sds;
+  struct ddsi_tkmap_instance **tks;
+  uint32_t *order;
+  struct rhc *rhc;
+  struct proxy_writer_info pwr_info;
+  struct ddsi_serdata **rbuf;
+  dds_sample_info_t *rinfo;
+};
+
+static struct inst_state *inst_new (uint32_t n)
+{
+  struct inst_state *st = ddsrt_malloc (sizeof (*st));
+  memset (st, 0, sizeof (*st));
+  st->n = n;
+  st->tp = get_sertopic (&MicrobenchTypes_Small_desc, "MicrobenchTypes_Small");
+  st->sds = ddsrt_malloc (n * sizeof (*st->sds));
+  st->tks = ddsrt_malloc (n * sizeof (*st->tks));
+  st->order = ddsrt_malloc (n * sizeof (*st->order));
+  permute (st->order, n);
+  thread_state_awake (lookup_thread_state ());
+  for (uint32_t i = 0; i < n; i++)
+  {
+    MicrobenchTypes_Small s = { (int32_t) i, 0 };
+    st->sds[i] = ddsi_serdata_from_sample (st->tp, SDK_DATA, &s);
+    st->tks[i] = ddsi_tkmap_lookup_instance_ref (st->sds[i]);
+  }
+  thread_state_asleep (lookup_thread_state ());
+  return st;
+}
+
+static void inst_free (struct inst_state *st)
+{
+  thread_state_awake (lookup_thread_state ());
+  for (uint32_t i = 0; i < st->n; i++)
+  {
+    ddsi_tkmap_instance_unref (st->tks[i]);
+    ddsi_serdata_unref (st->sds[i]);
+  }
+  thread_state_asleep (lookup_thread_state ());
+  ddsrt_free (st->order);
+  ddsrt_free (st->tks);
+  ddsrt_free (st->sds);
+  ddsrt_free (st);
+}
+
+static void *tkmap_setup (uint32_t n, uint32_t size)
+{
+  (void) size;
+  return inst_new (n);
+}
+
+static void tkmap_teardown (void *vst)
+{
+  inst_free (vst);
+}
+
+static void tkmap_find_run (void *vst, uint64_t iters)
+{
+  struct inst_state *st = vst;
+  thread_state_awake (lookup_thread_state ());
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    struct ddsi_tkmap_instance *tk = ddsi_tkmap_find (st->sds[st->order[st->cursor]], false, false);
+    if (tk == NULL)
+      abort ();
+    ddsi_tkmap_instance_unref (tk);
+    if (++st->cursor == st->n)
+      st->cursor = 0;
+  }
+  thread_state_asleep (lookup_thread_state ());
+}
+
+static void *rhc_setup (uint32_t n, uint32_t size)
+{
+  struct inst_state *st = inst_new (n);
+  (void) size;
+  st->rbuf = ddsrt_malloc (n * sizeof (*st->rbuf));
+  st->rinfo = ddsrt_malloc (n * sizeof (*st->rinfo));
+  memset (&st->pwr_info, 0, sizeof (st->pwr_info));
+  st->pwr_info.iid = ddsi_iid_gen ();
+  thread_state_awake (lookup_thread_state ());
+  st->rhc = dds_rhc_new (NULL, st->tp);
+  dds_rhc_set_qos (st->rhc, &gv.default_xqos_rd);
+  thread_state_asleep (lookup_thread_state ());
+  return st;
+}
+
+static void rhc_teardown (void *vst)
+{
+  struct inst_state *st = vst;
+  thread_state_awake (lookup_thread_state ());
+  dds_rhc_free (st->rhc);
+  thread_state_asleep (lookup_thread_state ());
+  ddsrt_free (st->rinfo);
+  ddsrt_free (st->rbuf);
+  inst_free (st);
+}
+
+static void rhc_store_take_run (void *vst, uint64_t iters)
+{
+  /* stores one sample for each of the n instances in random order, then takes them all:
+     the cost of the take is amortised over the stores */
+  struct inst_state *st = vst;
+  thread_state_awake (lookup_thread_state ());
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    const uint32_t k = st->order[st->cursor];
+    (void) dds_rhc_store (st->rhc, &st->pwr_info, st->sds[k], st->tks[k]);
+    if (++st->cursor == st->n)
+    {
+      int cnt = dds_rhc_takecdr (st->rhc, true, st->rbuf, st->rinfo, st->n, DDS_ANY_SAMPLE_STATE, DDS_ANY_VIEW_STATE, DDS_ANY_INSTANCE_STATE, DDS_HANDLE_NIL);
+      for (int j = 0; j < cnt; j++)
+        ddsi_serdata_unref (st->rbuf[j]);
+      st->cursor = 0;
+    }
+  }
+  thread_state_asleep (lookup_thread_state ());
+}
+
+/*****************************************************************************************
+ *
+ *  Benchmark table, measurement and reporting
+ *
+ *****************************************************************************************/
+
+enum bench_param {
+  BP_NONE,  /* neither -n nor -s applies */
+  BP_COUNT, /* run for each container size given by -n */
+  BP_SIZE   /* run for each sample size given by -s */
+};
+
+struct bench {
+  const char *name;
+  enum bench_param param;
+  void *(*setup) (uint32_t n, uint32_t size);
+  void (*run) (void *st, uint64_t iters);
+  void (*teardown) (void *st);
+};
+
+static const struct bench benches[] = {
+  { "hh_lookup", BP_COUNT, hh_setup, hh_lookup_run, hh_teardown },
+  { "hh_add_remove", BP_COUNT, hh_setup, hh_add_remove_run, hh_teardown },
+  { "chh_lookup", BP_COUNT, chh_setup, chh_lookup_run, chh_teardown },
+  { "chh_add_remove", BP_COUNT, chh_setup, chh_add_remove_run, chh_teardown },
+  { "avl_lookup", BP_COUNT, avl_setup, avl_lookup_run, avl_teardown },
+  { "avl_insert_delete", BP_COUNT, avl_setup, avl_insert_delete_run, avl_teardown },
+  { "fibheap_extract_insert", BP_COUNT, fibheap_setup, fibheap_extract_insert_run, fibheap_teardown },
+  { "freelist_pop_push", BP_COUNT, freelist_setup, freelist_pop_push_run, freelist_teardown },
+  { "cdr_write_small", BP_NONE, cdr_small_setup, cdr_write_run, cdr_teardown },
+  { "cdr_read_small", BP_NONE, cdr_small_setup, cdr_read_run, cdr_teardown },
+  { "cdr_key_small", BP_NONE, cdr_small_setup, cdr_key_run, cdr_teardown },
+  { "cdr_write_array", BP_NONE, cdr_array_setup, cdr_write_run, cdr_teardown },
+  { "cdr_read_array", BP_NONE, cdr_array_setup, cdr_read_run, cdr_teardown },
+  { "cdr_key_array", BP_NONE, cdr_array_setup, cdr_key_run, cdr_teardown },
+  { "cdr_write_seq", BP_SIZE, cdr_seq_setup, cdr_write_run, cdr_teardown },
+  { "cdr_read_seq", BP_SIZE, cdr_seq_setup, cdr_read_run, cdr_teardown },
+  { "cdr_key_seq", BP_SIZE, cdr_seq_setup, cdr_key_run, cdr_teardown },
+  { "tkmap_find", BP_COUNT, tkmap_setup, tkmap_find_run, tkmap_teardown },
+  { "rhc_store_take", BP_COUNT, rhc_setup, rhc_store_take_run, rhc_teardown }
+};
+
+struct result {
+  char name[64];
+  uint32_t n, size;
+  double ns_per_op;
+  double allocs_per_op; /* < 0 if not available */
+  double misses_per_op; /* < 0 if not available */
+};
+
+static double min_time = 0.2;
+static unsigned repeats = 5;
+
+static void measure (const struct bench *b, void *st, struct result *res)
+{
+  const int64_t tmin = (int64_t) (min_time * 1e9);
+  uint64_t iters = 1;
+  int64_t t;
+
+  /* calibrate: double the iteration count until a run takes a reasonable fraction of the
+     minimum time, then scale it up; this also warms up caches and any lazily allocated
+     state */
+  while (1)
+  {
+    dds_time_t t0 = ddsrt_time_monotonic ();
+    b->run (st, iters);
+    t = ddsrt_time_monotonic () - t0;
+    if (t >= tmin / 16 || iters >= (UINT64_MAX >> 5))
+      break;
+    iters *= 2;
+  }
+  if (t < tmin)
+    iters = (uint64_t) ((double) iters * (double) tmin / (double) (t > 0 ? t : 1)) + 1;
+
+  res->ns_per_op = -1.0;
+  for (unsigned r = 0; r < repeats; r++)
+  {
+    uint64_t misses = 0;
+    bool have_misses;
+    double nsop;
+    nallocs = 0;
+    count_allocs = 1;
+    cachemiss_start ();
+    dds_time_t t0 = ddsrt_time_monotonic ();
+    b->run (st, iters);
+    t = ddsrt_time_monotonic () - t0;
+    have_misses = cachemiss_stop (&misses);
+    count_allocs = 0;
+    /* report the fastest run, it is the least disturbed one */
+    nsop = (double) t / (double) iters;
+    if (res->ns_per_op < 0.0 || nsop < res->ns_per_op)
+    {
+      res->ns_per_op = nsop;
+      res->allocs_per_op = HAVE_ALLOC_COUNTING ? (double) nallocs / (double) iters : -1.0;
+      res->misses_per_op = have_misses ? (double) misses / (double) iters : -1.0;
+    }
+  }
+}
+
+static void print_metric (FILE *fp, double v)
+{
+  if (v < 0.0)
+    fprintf (fp, "\t-");
+  else
+    fprintf (fp, "\t%.3f", v);
+}
+
+static void print_result (FILE *fp, const struct result *res)
+{
+  fprintf (fp, "%s\t%"PRIu32"\t%"PRIu32"\t%.2f", res->name, res->n, res->size, res->ns_per_op);
+  print_metric (fp, res->allocs_per_op);
+  print_metric (fp, res->misses_per_op);
+}
+
+static double parse_metric (const char *s)
+{
+  return (strcmp (s, "-") == 0) ? -1.0 : atof (s);
+}
+
+static struct result *read_results (const char *file, size_t *nres)
+{
+  struct result *res = NULL;
+  char line[256];
+  FILE *fp;
+  *nres = 0;
+  if ((fp = fopen (file, "r")) == NULL)
+  {
+    perror (file);
+    exit (2);
+  }
+  while (fgets (line, sizeof (line), fp))
+  {
+    char name[64], nsop[32], allocs[32], misses[32];
+    uint32_t n, size;
+    if (line[0] == '#')
+      continue;
+    if (sscanf (line, "%63s %"SCNu32" %"SCNu32" %31s %31s %31s", name, &n, &size, nsop, allocs, misses) != 6)
+      continue;
+    res = ddsrt_realloc (res, (*nres + 1) * sizeof (*res));
+    (void) ddsrt_strlcpy (res[*nres].name, name, sizeof (res[*nres].name));
+    res[*nres].n = n;
+    res[*nres].size = size;
+    res[*nres].ns_per_op = atof (nsop);
+    res[*nres].allocs_per_op = parse_metric (allocs);
+    res[*nres].misses_per_op = parse_metric (misses);
+    (*nres)++;
+  }
+  fclose (fp);
+  return res;
+}
+
+static const struct result *find_result (const struct result *res, size_t nres, const struct result *x)
+{
+  for (size_t i = 0; i < nres; i++)
+    if (strcmp (res[i].name, x->name) == 0 && res[i].n == x->n && res[i].size == x->size)
+      return &res[i];
+  return NULL;
+}
+
+static uint32_t *parse_list (const char *arg, size_t *cnt)
+{
+  char *copy = ddsrt_strdup (arg), *cursor = copy, *tok;
+  uint32_t *xs = NULL;
+  *cnt = 0;
+  while ((tok = ddsrt_strsep (&cursor, ",")) != NULL)
+  {
+    char *endp;
+    unsigned long v = strtoul (tok, &endp, 0);
+    if (*tok == 0 || v == 0 || v > UINT32_MAX)
+    {
+      fprintf (stderr, "%s: invalid list (expected comma-separated positive integers)\n", arg);
+      exit (2);
+    }
+    switch (*endp)
+    {
+      case 0: break;
+      case 'k': v *= 1024; break;
+      case 'M': v *= 1048576; break;
+      default:
+        fprintf (stderr, "%s: invalid list (expected comma-separated positive integers)\n", arg);
+        exit (2);
+    }
+    xs = ddsrt_realloc (xs, (*cnt + 1) * sizeof (*xs));
+    xs[(*cnt)++] = (uint32_t) v;
+  }
+  ddsrt_free (copy);
+  return xs;
+}
+
+static bool selected (const char *name, int npat, char **pats)
+{
+  if (npat == 0)
+    return true;
+  for (int i = 0; i < npat; i++)
+    if (strstr (name, pats[i]) != NULL)
+      return true;
+  return false;
+}
+
+static void usage (const char *argv0)
+{
+  printf ("\
+%s [OPTIONS] [PATTERN...]\n\
+\n\
+Runs the microbenchmarks whose name contains one of the PATTERNs, or all of\n\
+them if none is given, and prints for each: the name, the container size,\n\
+the sample size, the time per operation in ns, the number of heap allocations\n\
+per operation and the number of cache misses per operation (\"-\" if not\n\
+available on this platform).\n\
+\n\
+OPTIONS:\n\
+  -l          list the benchmarks and exit\n\
+  -n N,...    container sizes (default 1000,100000), k and M suffixes allowed\n\
+  -s S,...    sample sizes for sequence types (default 16,1024,65536)\n\
+  -t SEC      minimum duration of a single measurement (default %g)\n\
+  -r N        repeat each measurement N times, report the fastest (default %u)\n\
+  -o FILE     also write the results to FILE, suitable for use with -c\n\
+  -c FILE     compare against the results in FILE (written earlier with -o)\n\
+  -S SEED     seed for the random number generator (default 1)\n\
+", argv0, min_time, repeats);
+  exit (1);
+}
+
+int main (int argc, char **argv)
+{
+  const char *counts_arg = "1000,100000", *sizes_arg = "16,1024,65536";
+  const char *outfile = NULL, *basefile = NULL;
+  uint32_t *counts, *sizes;
+  size_t ncounts, nsizes, nbase = 0;
+  struct result *base = NULL;
+  uint32_t seed = 1;
+  FILE *outfp = NULL;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "ln:s:t:r:o:c:S:h")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'l':
+        for (size_t i = 0; i < sizeof (benches) / sizeof (benches[0]); i++)
+          printf ("%s\n", benches[i].name);
+        return 0;
+      case 'n': counts_arg = optarg; break;
+      case 's': sizes_arg = optarg; break;
+      case 't': min_time = atof (optarg); break;
+      case 'r': repeats = (unsigned) atoi (optarg); break;
+      case 'o': outfile = optarg; break;
+      case 'c': basefile = optarg; break;
+      case 'S': seed = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (min_time <= 0.0 || repeats == 0)
+    usage (argv[0]);
+  counts = parse_list (counts_arg, &ncounts);
+  sizes = parse_list (sizes_arg, &nsizes);
+  if (basefile)
+    base = read_results (basefile, &nbase);
+  if (outfile && (outfp = fopen (outfile, "w")) == NULL)
+  {
+    perror (outfile);
+    return 2;
+  }
+  ddsrt_prng_init_simple (&prng, seed);
+  cachemiss_init ();
+
+  printf ("# name\tn\tsize\tns/op\tallocs/op\tmisses/op%s\n", base ? "\tbase-ns/op\tdelta" : "");
+  if (outfp)
+    fprintf (outfp, "# name\tn\tsize\tns/op\tallocs/op\tmisses/op\n");
+  for (size_t i = 0; i < sizeof (benches) / sizeof (benches[0]); i++)
+  {
+    const struct bench *b = &benches[i];
+    const size_t nparams = (b->param == BP_COUNT) ? ncounts : (b->param == BP_SIZE) ? nsizes : 1;
+    if (!selected (b->name, argc - optind, argv + optind))
+      continue;
+    for (size_t j = 0; j < nparams; j++)
+    {
+      struct result res;
+      const struct result *bres;
+      void *st;
+      memset (&res, 0, sizeof (res));
+      (void) ddsrt_strlcpy (res.name, b->name, sizeof (res.name));
+      res.n = (b->param == BP_COUNT) ? counts[j] : 0;
+      res.size = (b->param == BP_SIZE) ? sizes[j] : 0;
+      st = b->setup (res.n, res.size);
+      measure (b, st, &res);
+      b->teardown (st);
+
+      print_result (stdout, &res);
+      if (base && (bres = find_result (base, nbase, &res)) != NULL)
+        printf ("\t%.2f\t%+.1f%%", bres->ns_per_op, 100.0 * (res.ns_per_op - bres->ns_per_op) / bres->ns_per_op);
+      printf ("\n");
+      fflush (stdout);
+      if (outfp)
+      {
+        print_result (outfp, &res);
+        fprintf (outfp, "\n");
+      }
+    }
+  }
+
+  cachemiss_fini ();
+  if (outfp)
+    fclose (outfp);
+  if (ppant > 0)
+    dds_delete (ppant);
+  ddsrt_free (base);
+  ddsrt_free (sizes);
+  ddsrt_free (counts);
+  return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+
+#include "RhcTypes.h"
+
+/* Measures how long it takes to reliably deliver a burst of samples to a
+   reader in another process over a lossy (simulated, using
+   Internal/Test/XmitLossiness) loopback network, once with the fixed heartbeat
+   and retransmit timing and once with the timing adapted to the measured
+   round-trip time (Internal/RttAdaptiveTiming).
+
+   The process spawns a copy of itself for the subscribing side, which
+   acknowledges receipt of all samples by publishing a single sample on a
+   second topic. */
+
+#define URI_FMT "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery><Internal><Test><XmitLossiness>%d</XmitLossiness></Test><RttAdaptiveTiming>%s</RttAdaptiveTiming></Internal></CycloneDDS>"
+
+static dds_qos_t *reliable_qos (void)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  /* so that it doesn't matter whether the reader has discovered the
+     writer by the time it starts writing */
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  return qos;
+}
+
+static int subscriber (const char *topicname, int nsamples)
+{
+  char donename[100];
+  dds_qos_t *qos = reliable_qos ();
+  dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  dds_entity_t tp, tpdone, rd, wr;
+  dds_publication_matched_status_t pm;
+  dds_time_t tend = dds_time () + DDS_SECS (60);
+  int nrecv = 0;
+  if (pp < 0)
+    return 1;
+  snprintf (donename, sizeof (donename), "%s_done", topicname);
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  tpdone = dds_create_topic (pp, &RhcTypes_T_desc, donename, qos, NULL);
+  rd = dds_create_reader (pp, tp, NULL, NULL);
+  wr = dds_create_writer (pp, tpdone, NULL, NULL);
+  dds_delete_qos (qos);
+  while (nrecv < nsamples && dds_time () < tend)
+  {
+    RhcTypes_T xs[100];
+    void *ptrs[100];
+    dds_sample_info_t si[100];
+    int32_t n;
+    for (int i = 0; i < 100; i++)
+    {
+      memset (&xs[i], 0, sizeof (xs[i]));
+      ptrs[i] = &xs[i];
+    }
+    if ((n = dds_take (rd, ptrs, si, 100, 100)) > 0)
+    {
+      for (int32_t i = 0; i < n; i++)
+        if (si[i].valid_data)
+          nrecv++;
+      dds_return_loan (rd, ptrs, n);
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  if (nrecv == nsamples)
+  {
+    RhcTypes_T done = { nrecv, "", 0, 0, "" };
+    dds_write (wr, &done);
+    /* linger until the publisher is gone, so the "done" sample surely arrives */
+    do {
+      dds_sleepfor (DDS_MSECS (10));
+      dds_get_publication_matched_status (wr, &pm);
+    } while (pm.current_count > 0 && dds_time () < tend);
+  }
+  dds_delete (pp);
+  return (nrecv == nsamples) ? 0 : 1;
+}
+
+static int publisher (const char *self, const char *topicname, int nsamples, int lossiness, bool adaptive, double *elapsed)
+{
+  char donename[100], nstr[20], uri[1024];
+  dds_qos_t *qos;
+  dds_entity_t pp, tp, tpdone, rd, wr;
+  dds_subscription_matched_status_t sm;
+  dds_publication_matched_status_t pm;
+  ddsrt_pid_t pid;
+  int32_t code = -1;
+  dds_time_t t0, tend;
+  bool done = false;
+  char *sub_argv[] = { "-sub", (char *) topicname, nstr, NULL };
+
+  snprintf (uri, sizeof (uri), URI_FMT, lossiness, adaptive ? "true" : "false");
+  if (ddsrt_setenv ("CYCLONEDDS_URI", uri) != DDS_RETCODE_OK)
+    return 1;
+  snprintf (nstr, sizeof (nstr), "%d", nsamples);
+  snprintf (donename, sizeof (donename), "%s_done", topicname);
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  tpdone = dds_create_topic (pp, &RhcTypes_T_desc, donename, qos, NULL);
+  wr = dds_create_writer (pp, tp, NULL, NULL);
+  rd = dds_create_reader (pp, tpdone, NULL, NULL);
+  dds_delete_qos (qos);
+  if (ddsrt_proc_create (self, sub_argv, &pid) != DDS_RETCODE_OK)
+  {
+    dds_delete (pp);
+    return 1;
+  }
+
+  tend = dds_time () + DDS_SECS (60);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    dds_get_publication_matched_status (wr, &pm);
+    dds_get_subscription_matched_status (rd, &sm);
+  } while ((pm.current_count == 0 || sm.current_count == 0) && dds_time () < tend);
+
+  t0 = dds_time ();
+  for (int i = 0; i < nsamples; i++)
+  {
+    RhcTypes_T x = { 0, "", i, 0, "" };
+    dds_write (wr, &x);
+  }
+  while (!done && dds_time () < tend)
+  {
+    RhcTypes_T x;
+    void *ptr = &x;
+    dds_sample_info_t si;
+    memset (&x, 0, sizeof (x));
+    if (dds_take (rd, &ptr, &si, 1, 1) > 0)
+    {
+      done = si.valid_data;
+      dds_return_loan (rd, &ptr, 1);
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  *elapsed = (double) (dds_time () - t0) / 1e9;
+  /* the subscriber lingers until it no longer matches our reader, which
+     can take a lease duration if our goodbye message gets lost */
+  dds_delete (pp);
+  (void) ddsrt_proc_waitpid (pid, DDS_SECS (30), &code);
+  return (done && code == 0) ? 0 : 1;
+}
+
+int main (int argc, char **argv)
+{
+  char topicname[100];
+  int nsamples = 1000, lossiness = 100;
+  double elapsed_fixed, elapsed_adaptive;
+
+  if (argc == 4 && strcmp (argv[1], "-sub") == 0)
+    return subscriber (argv[2], atoi (argv[3]));
+
+  if (argc > 1)
+    nsamples = atoi (argv[1]);
+  if (argc > 2)
+    lossiness = atoi (argv[2]);
+  snprintf (topicname, sizeof (topicname), "rttloss_%"PRIdPID, ddsrt_getpid ());
+  printf ("%d samples, %.1f%% loss\n", nsamples, lossiness / 10.0);
+  if (publisher (argv[0], topicname, nsamples, lossiness, false, &elapsed_fixed) != 0)
+  {
+    printf ("fixed timing: not all samples delivered\n");
+    return 1;
+  }
+  printf ("fixed timing: %.3f s\n", elapsed_fixed);
+  if (publisher (argv[0], topicname, nsamples, lossiness, true, &elapsed_adaptive) != 0)
+  {
+    printf ("adaptive timing: not all samples delivered\n");
+    return 1;
+  }
+  printf ("adaptive timing: %.3f s\n", elapsed_adaptive);
+  return 0;
+}
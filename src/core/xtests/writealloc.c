@@ -0,0 +1,261 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/time.h"
+#include "dds/dds.h"
+
+#include "RhcTypes.h"
+
+/* Verifies that, once warmed up, writing a sample to a reliable reader in
+   another process, transmitting it, processing the acknowledgement and
+   freeing it performs no heap allocations at all.
+
+   Writes are paced so that each sample is normally acknowledged before the
+   next one is written, and counting continues for a while after the last
+   write so that the whole cycle is covered.  This is done for a small sample
+   and for one that is larger than the smallest serdata size class, both
+   for a KEEP_ALL writer of a keyed topic and for a volatile KEEP_LAST
+   writer of a keyless topic, which use different WHC implementations.  The
+   process spawns a copy of itself for the subscribing side. */
+
+/* Allocation counting by interposing malloc & friends, as in microbench,
+   except that the transmission and acknowledgement processing happen in
+   other threads, so all threads are counted */
+static ddsrt_atomic_uint32_t count_allocs = DDSRT_ATOMIC_UINT32_INIT (0);
+static ddsrt_atomic_uint32_t nallocs = DDSRT_ATOMIC_UINT32_INIT (0);
+
+#if defined (__GLIBC__)
+#define HAVE_ALLOC_COUNTING 1
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+
+void *malloc (size_t size)
+{
+  if (ddsrt_atomic_ld32 (&count_allocs))
+    ddsrt_atomic_inc32 (&nallocs);
+  return __libc_malloc (size);
+}
+
+void *calloc (size_t nmemb, size_t size)
+{
+  if (ddsrt_atomic_ld32 (&count_allocs))
+    ddsrt_atomic_inc32 (&nallocs);
+  return __libc_calloc (nmemb, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+  if (ddsrt_atomic_ld32 (&count_allocs))
+    ddsrt_atomic_inc32 (&nallocs);
+  return __libc_realloc (ptr, size);
+}
+
+void free (void *ptr)
+{
+  __libc_free (ptr);
+}
+#else
+#define HAVE_ALLOC_COUNTING 0
+#endif
+
+/* Periodic discovery and liveliness traffic allocates, so the intervals are
+   made long enough not to interfere */
+#define URI "<CycloneDDS><Domain><Id>any</Id></Domain><General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers><SPDPInterval>1000 s</SPDPInterval></Discovery><Internal><LeaseDuration>1000 s</LeaseDuration></Internal></CycloneDDS>"
+
+static dds_qos_t *reliable_qos (void)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  return qos;
+}
+
+static dds_qos_t *keep_last_qos (void)
+{
+  /* volatile is the default */
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, 1);
+  return qos;
+}
+
+static bool take_all (dds_entity_t rd)
+{
+  /* large enough for either type */
+  RhcTypes_T xs[100];
+  void *ptrs[100];
+  dds_sample_info_t si[100];
+  for (int i = 0; i < 100; i++)
+  {
+    memset (&xs[i], 0, sizeof (xs[i]));
+    ptrs[i] = &xs[i];
+  }
+  if (dds_take (rd, ptrs, si, 100, 100) <= 0)
+    return false;
+  dds_return_loan (rd, ptrs, 100);
+  return true;
+}
+
+static bool reader_done (dds_entity_t rd)
+{
+  dds_subscription_matched_status_t sm;
+  dds_get_subscription_matched_status (rd, &sm);
+  return sm.total_count > 0 && sm.current_count == 0;
+}
+
+static int subscriber (const char *topicname, const char *keyless_topicname)
+{
+  dds_qos_t *qos = reliable_qos ();
+  dds_entity_t pp, tp, rd, rd_keyless;
+  dds_time_t tend = dds_time () + DDS_SECS (120);
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  rd = dds_create_reader (pp, tp, qos, NULL);
+  tp = dds_create_topic (pp, &RhcTypes_Keyless_desc, keyless_topicname, qos, NULL);
+  rd_keyless = dds_create_reader (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  /* take everything until the publisher has come and gone */
+  do {
+    bool took = take_all (rd);
+    took = take_all (rd_keyless) || took;
+    if (!took)
+      dds_sleepfor (DDS_MSECS (1));
+  } while (!(reader_done (rd) && reader_done (rd_keyless)) && dds_time () < tend);
+  dds_delete (pp);
+  return 0;
+}
+
+static bool write_paced (dds_entity_t wr, const void *x)
+{
+  if (dds_write (wr, x) != DDS_RETCODE_OK)
+    return false;
+  dds_sleepfor (DDS_MSECS (1));
+  return true;
+}
+
+static int run (dds_entity_t wr, bool keyless, size_t ssize, int nwarmup, int nsamples)
+{
+  const char *what = keyless ? "keyless keep-last" : "keyed keep-all";
+  char *s = ddsrt_malloc (ssize + 1);
+  RhcTypes_T x = { 0, "key", 0, 0, s };
+  RhcTypes_Keyless xk = { 0, s };
+  int32_t * const seq = keyless ? &xk.x : &x.x;
+  const void * const sample = keyless ? (const void *) &xk : (const void *) &x;
+  uint32_t allocs;
+  memset (s, 'x', ssize);
+  s[ssize] = 0;
+  for (int i = 0; i < nwarmup; i++)
+  {
+    *seq = i;
+    if (!write_paced (wr, sample))
+      goto fail;
+  }
+  ddsrt_atomic_st32 (&count_allocs, 1);
+  allocs = ddsrt_atomic_ld32 (&nallocs);
+  for (int i = 0; i < nsamples; i++)
+  {
+    *seq = nwarmup + i;
+    if (!write_paced (wr, sample))
+      goto fail;
+  }
+  dds_sleepfor (DDS_MSECS (500));
+  allocs = ddsrt_atomic_ld32 (&nallocs) - allocs;
+  ddsrt_atomic_st32 (&count_allocs, 0);
+  ddsrt_free (s);
+  printf ("%s, %zu-byte string: %"PRIu32" allocations in %d writes\n", what, ssize, allocs, nsamples);
+  return (allocs == 0) ? 0 : 1;
+fail:
+  ddsrt_atomic_st32 (&count_allocs, 0);
+  ddsrt_free (s);
+  printf ("%s, %zu-byte string: write failed\n", what, ssize);
+  return 1;
+}
+
+static bool writer_matched (dds_entity_t wr)
+{
+  dds_publication_matched_status_t pm;
+  dds_get_publication_matched_status (wr, &pm);
+  return pm.current_count > 0;
+}
+
+int main (int argc, char **argv)
+{
+  char topicname[100], keyless_topicname[100];
+  char *sub_argv[] = { "-sub", topicname, keyless_topicname, NULL };
+  int nwarmup = 1000, nsamples = 1000, result = 1;
+  dds_entity_t pp, tp, wr, wr_keyless;
+  ddsrt_pid_t pid;
+  int32_t code = -1;
+  dds_time_t tend;
+  dds_qos_t *qos;
+
+  if (ddsrt_setenv ("CYCLONEDDS_URI", URI) != DDS_RETCODE_OK)
+    return 1;
+  if (argc == 4 && strcmp (argv[1], "-sub") == 0)
+    return subscriber (argv[2], argv[3]);
+  if (!HAVE_ALLOC_COUNTING)
+  {
+    printf ("allocation counting not supported on this platform\n");
+    return 0;
+  }
+  if (argc > 1)
+    nwarmup = atoi (argv[1]);
+  if (argc > 2)
+    nsamples = atoi (argv[2]);
+  snprintf (topicname, sizeof (topicname), "writealloc_%"PRIdPID, ddsrt_getpid ());
+  snprintf (keyless_topicname, sizeof (keyless_topicname), "writealloc_keyless_%"PRIdPID, ddsrt_getpid ());
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    return 1;
+  qos = reliable_qos ();
+  tp = dds_create_topic (pp, &RhcTypes_T_desc, topicname, qos, NULL);
+  wr = dds_create_writer (pp, tp, qos, NULL);
+  tp = dds_create_topic (pp, &RhcTypes_Keyless_desc, keyless_topicname, qos, NULL);
+  dds_delete_qos (qos);
+  qos = keep_last_qos ();
+  wr_keyless = dds_create_writer (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  if (ddsrt_proc_create (argv[0], sub_argv, &pid) != DDS_RETCODE_OK)
+  {
+    dds_delete (pp);
+    return 1;
+  }
+  tend = dds_time () + DDS_SECS (60);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+  } while (!(writer_matched (wr) && writer_matched (wr_keyless)) && dds_time () < tend);
+
+  if (writer_matched (wr) && writer_matched (wr_keyless))
+  {
+    /* newly discovered participants get a few SPDP messages directed to
+       them at one second intervals, wait for those to have been sent */
+    dds_sleepfor (DDS_SECS (5));
+    result = run (wr, false, 10, nwarmup, nsamples);
+    result |= run (wr, false, 2000, nwarmup, nsamples);
+    result |= run (wr_keyless, true, 10, nwarmup, nsamples);
+    result |= run (wr_keyless, true, 2000, nwarmup, nsamples);
+  }
+  dds_delete (pp);
+  (void) ddsrt_proc_waitpid (pid, DDS_SECS (30), &code);
+  return (result == 0 && code == 0) ? 0 : 1;
+}
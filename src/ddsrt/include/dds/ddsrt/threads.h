@@ -93,6 +93,10 @@ typedef struct {
   int32_t schedPriority;
   /** Specifies the thread stack size */
   uint32_t stackSize;
+  /** Number of CPUs in cpus, 0 leaves the thread free to run on any CPU */
+  uint32_t ncpus;
+  /** CPUs the thread may run on, only used during ddsrt_thread_create */
+  const uint32_t *cpus;
 } ddsrt_threadattr_t;
 
 /**
@@ -135,6 +139,33 @@ ddsrt_thread_create(
   void *arg)
 ddsrt_nonnull((1,2,3,4));
 
+/**
+ * @brief Retrieve the set of CPUs a thread may run on.
+ *
+ * @param[in]   thread   Id of thread to query.
+ * @param[out]  ncpus    Location where the number of CPUs in the set is
+ *                       stored, this may exceed @maxcpus.
+ * @param[out]  cpus     Array where the (first @maxcpus) CPU numbers are
+ *                       stored in ascending order.
+ * @param[in]   maxcpus  Number of entries available in @cpus.
+ *
+ * @returns A dds_retcode_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             CPU set successfully retrieved.
+ * @retval DDS_RETCODE_UNSUPPORTED
+ *             The platform does not support querying the CPU set.
+ * @retval DDS_RETCODE_ERROR
+ *             The CPU set could not be retrieved.
+ */
+DDS_EXPORT dds_retcode_t
+ddsrt_thread_getaffinity(
+  ddsrt_thread_t thread,
+  uint32_t *ncpus,
+  uint32_t *cpus,
+  uint32_t maxcpus)
+ddsrt_nonnull((2));
+
 /**
  * @brief Retrieve integer representation of the given thread id.
  *
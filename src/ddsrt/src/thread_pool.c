@@ -25,6 +25,13 @@ typedef struct ddsi_work_queue_job
 }
 * ddsi_work_queue_job_t;
 
+struct ddsrt_thread_pool_thread
+{
+    struct ddsrt_thread_pool_thread * m_next; /* Running or exited threads list pointer */
+    struct ddsrt_thread_pool_s * m_pool;      /* Pool the thread belongs to */
+    ddsrt_thread_t m_tid;                     /* Thread to join once exited */
+};
+
 struct ddsrt_thread_pool_s
 {
     ddsi_work_queue_job_t m_jobs;      /* Job queue */
@@ -36,6 +43,10 @@ struct ddsrt_thread_pool_s
     uint32_t m_waiting;               /* Number of threads waiting for a job */
     uint32_t m_job_count;             /* Number of queued jobs */
     uint32_t m_job_max;               /* Maximum number of jobs to queue */
+    uint32_t m_purge;                 /* Number of idle threads to terminate */
+    int m_terminate;                  /* Set when the pool is being deleted */
+    struct ddsrt_thread_pool_thread * m_running; /* Threads still running */
+    struct ddsrt_thread_pool_thread * m_exited;  /* Threads that exited but have not been joined */
     unsigned short m_count;            /* Counter for thread name */
     ddsrt_threadattr_t m_attr;              /* Thread creation attribute */
     ddsrt_cond_t m_cv;                    /* Thread wait semaphore */
@@ -45,19 +56,19 @@ struct ddsrt_thread_pool_s
 static uint32_t ddsrt_thread_start_fn (void * arg)
 {
     ddsi_work_queue_job_t job;
-    ddsrt_thread_pool pool = (ddsrt_thread_pool) arg;
+    struct ddsrt_thread_pool_thread * self = arg;
+    struct ddsrt_thread_pool_thread ** pself;
+    ddsrt_thread_pool pool = self->m_pool;
 
-    /* Thread loops, pulling jobs from queue */
+    /* Thread loops, pulling jobs from queue until the pool is deleted or
+       purged */
 
     ddsrt_mutex_lock (&pool->m_mutex);
 
-    while (pool->m_jobs != NULL) {
-        /* Wait for job */
-        ddsrt_cond_wait (&pool->m_cv, &pool->m_mutex);
-
-        /* Check if pool deleted or being purged */
-
-        if (pool->m_jobs) {
+    while (1)
+    {
+        if (pool->m_jobs)
+        {
             /* Take job from queue head */
 
             pool->m_waiting--;
@@ -78,9 +89,33 @@ static uint32_t ddsrt_thread_start_fn (void * arg)
             job->m_next_job = pool->m_free;
             pool->m_free = job;
         }
+        else if (pool->m_terminate)
+        {
+            break;
+        }
+        else if (pool->m_purge > 0)
+        {
+            pool->m_purge--;
+            break;
+        }
+        else
+        {
+            /* Wait for job */
+            ddsrt_cond_wait (&pool->m_cv, &pool->m_mutex);
+        }
     }
 
-    if (--pool->m_threads) {
+    /* Move to the exited list so that whoever frees or purges the pool can
+       join the thread */
+
+    for (pself = &pool->m_running; *pself != self; pself = &(*pself)->m_next)
+        ;
+    *pself = self->m_next;
+    self->m_next = pool->m_exited;
+    pool->m_exited = self;
+
+    pool->m_waiting--;
+    if (--pool->m_threads == 0) {
         /* last to leave triggers thread_pool_free */
         ddsrt_cond_broadcast (&pool->m_cv);
     }
@@ -88,23 +123,55 @@ static uint32_t ddsrt_thread_start_fn (void * arg)
     return 0;
 }
 
+/* Joins all threads that exited, called without pool->m_mutex held */
+static void ddsrt_thread_pool_join_exited (ddsrt_thread_pool pool)
+{
+    struct ddsrt_thread_pool_thread * exited;
+
+    ddsrt_mutex_lock (&pool->m_mutex);
+    exited = pool->m_exited;
+    pool->m_exited = NULL;
+    ddsrt_mutex_unlock (&pool->m_mutex);
+
+    while (exited)
+    {
+        struct ddsrt_thread_pool_thread * next = exited->m_next;
+        (void) ddsrt_thread_join (exited->m_tid, NULL);
+        ddsrt_free (exited);
+        exited = next;
+    }
+}
+
+/* Called with pool->m_mutex held */
 static dds_retcode_t ddsrt_thread_pool_new_thread (ddsrt_thread_pool pool)
 {
     static unsigned char pools = 0; /* Pool counter - TODO make atomic */
 
     char name [64];
-    ddsrt_thread_t id;
+    struct ddsrt_thread_pool_thread * thr;
     dds_retcode_t res;
 
+    if ((thr = ddsrt_malloc_s (sizeof (*thr))) == NULL)
+    {
+        return DDS_RETCODE_OUT_OF_RESOURCES;
+    }
+    thr->m_pool = pool;
+
     (void) snprintf (name, sizeof (name), "OSPL-%u-%u", pools++, pool->m_count++);
-    res = ddsrt_thread_create (&id, name, &pool->m_attr, &ddsrt_thread_start_fn, pool);
 
-    if (res == DDS_RETCODE_OK)
+    /* Account for the thread before it starts running, as it may take a job
+       before ddsrt_thread_create returns */
+    pool->m_threads++;
+    pool->m_waiting++;
+    thr->m_next = pool->m_running;
+    pool->m_running = thr;
+    res = ddsrt_thread_create (&thr->m_tid, name, &pool->m_attr, &ddsrt_thread_start_fn, thr);
+    if (res != DDS_RETCODE_OK)
     {
-        ddsrt_mutex_lock (&pool->m_mutex);
-        pool->m_threads++;
-        pool->m_waiting++;
-        ddsrt_mutex_unlock (&pool->m_mutex);
+        pool->m_threads--;
+        pool->m_waiting--;
+        pool->m_running = thr->m_next;
+        ddsrt_free (thr);
     }
 
     return res;
@@ -144,7 +211,11 @@ ddsrt_thread_pool ddsrt_thread_pool_new (uint32_t threads, uint32_t max_threads,
 
     while (threads--)
     {
-        if (ddsrt_thread_pool_new_thread (pool) != DDS_RETCODE_OK)
+        dds_retcode_t res;
+        ddsrt_mutex_lock (&pool->m_mutex);
+        res = ddsrt_thread_pool_new_thread (pool);
+        ddsrt_mutex_unlock (&pool->m_mutex);
+        if (res != DDS_RETCODE_OK)
         {
             ddsrt_thread_pool_free (pool);
             pool = NULL;
@@ -180,17 +251,20 @@ void ddsrt_thread_pool_free (ddsrt_thread_pool pool)
 
     /* Wake all waiting threads */
 
+    pool->m_terminate = 1;
     ddsrt_cond_broadcast (&pool->m_cv);
 
-    ddsrt_mutex_unlock (&pool->m_mutex);
-
     /* Wait for threads to complete */
 
-    ddsrt_mutex_lock (&pool->m_mutex);
     while (pool->m_threads != 0)
         ddsrt_cond_wait (&pool->m_cv, &pool->m_mutex);
     ddsrt_mutex_unlock (&pool->m_mutex);
 
+    /* Threads may still be on their way out: join them before the pool
+       they reference disappears */
+
+    ddsrt_thread_pool_join_exited (pool);
+
     /* Delete all free jobs from queue */
 
     while (pool->m_free)
@@ -274,12 +348,17 @@ void ddsrt_thread_pool_purge (ddsrt_thread_pool pool)
     uint32_t total;
 
     ddsrt_mutex_lock (&pool->m_mutex);
-    total = pool->m_threads;
-    while (pool->m_waiting && (total > pool->m_thread_min))
+    total = pool->m_threads - pool->m_purge;
+    while (pool->m_waiting > pool->m_purge && (total > pool->m_thread_min))
     {
-        pool->m_waiting--;
+        pool->m_purge++;
         total--;
     }
     ddsrt_cond_broadcast (&pool->m_cv);
     ddsrt_mutex_unlock (&pool->m_mutex);
+
+    /* Threads purged now are joined by the next purge or when the pool is
+       freed */
+
+    ddsrt_thread_pool_join_exited (pool);
 }
@@ -10,6 +10,7 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <assert.h>
+#include <stddef.h>
 
 #include "dds/ddsrt/threads.h"
 
@@ -21,4 +22,6 @@ ddsrt_threadattr_init (
   tattr->schedClass = DDSRT_SCHED_DEFAULT;
   tattr->schedPriority = 0;
   tattr->stackSize = 0;
+  tattr->ncpus = 0;
+  tattr->cpus = NULL;
 }
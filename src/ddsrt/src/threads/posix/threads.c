@@ -10,11 +10,13 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 
-/* _GNU_SOURCE is required for pthread_getname_np and pthread_setname_np. */
+/* _GNU_SOURCE is required for pthread_getname_np and pthread_setname_np,
+   and for the CPU affinity interfaces. */
 #define _GNU_SOURCE
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -276,6 +278,31 @@ ddsrt_thread_create (
     }
   }
 
+  if (tattr.ncpus > 0)
+  {
+#if defined(__linux)
+    /* Restricting it to CPUs the process may not use makes pthread_create
+       fail, so only use those that are available and run it unpinned
+       rather than not at all if none of them is */
+    cpu_set_t allowed, cpuset;
+    CPU_ZERO (&cpuset);
+    for (uint32_t i = 0; i < tattr.ncpus; i++)
+      if (tattr.cpus[i] < CPU_SETSIZE)
+        CPU_SET ((size_t) tattr.cpus[i], &cpuset);
+    if (sched_getaffinity (0, sizeof (allowed), &allowed) == 0)
+      CPU_AND (&cpuset, &cpuset, &allowed);
+    if (CPU_COUNT (&cpuset) == 0)
+      DDS_WARNING ("ddsrt_thread_create(%s): none of the requested CPUs is available, not setting affinity\n", name);
+    else if ((result = pthread_attr_setaffinity_np (&attr, sizeof (cpuset), &cpuset)) != 0)
+    {
+      DDS_ERROR ("ddsrt_thread_create(%s): pthread_attr_setaffinity_np failed with error %d\n", name, result);
+      goto err;
+    }
+#else
+    DDS_WARNING ("ddsrt_thread_create(%s): setting CPU affinity is unsupported on this platform\n", name);
+#endif
+  }
+
   /* Construct context structure & start thread */
   ctx = ddsrt_malloc (sizeof (thread_context_t));
   ctx->name = ddsrt_malloc (strlen (name) + 1);
@@ -305,6 +332,40 @@ err:
   return DDS_RETCODE_ERROR;
 }
 
+dds_retcode_t
+ddsrt_thread_getaffinity (
+  ddsrt_thread_t thread,
+  uint32_t *ncpus,
+  uint32_t *cpus,
+  uint32_t maxcpus)
+{
+#if defined(__linux)
+  cpu_set_t cpuset;
+  uint32_t n = 0;
+  assert (ncpus != NULL);
+  assert (cpus != NULL || maxcpus == 0);
+  if (pthread_getaffinity_np (thread.v, sizeof (cpuset), &cpuset) != 0)
+    return DDS_RETCODE_ERROR;
+  for (size_t i = 0; i < (size_t) CPU_SETSIZE; i++)
+  {
+    if (CPU_ISSET (i, &cpuset))
+    {
+      if (n < maxcpus)
+        cpus[n] = (uint32_t) i;
+      n++;
+    }
+  }
+  *ncpus = n;
+  return DDS_RETCODE_OK;
+#else
+  (void) thread;
+  (void) ncpus;
+  (void) cpus;
+  (void) maxcpus;
+  return DDS_RETCODE_UNSUPPORTED;
+#endif
+}
+
 ddsrt_tid_t
 ddsrt_gettid(void)
 {
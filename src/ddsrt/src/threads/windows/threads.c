@@ -104,9 +104,35 @@ ddsrt_thread_create(
     DDS_WARNING("SetThreadPriority failed with %i\n", GetLastError());
   }
 
+  if (attr->ncpus > 0) {
+    /* Only the CPUs in the processor group of the process are supported */
+    DWORD_PTR mask = 0;
+    for (uint32_t i = 0; i < attr->ncpus; i++) {
+      if (attr->cpus[i] < 8 * sizeof(mask))
+        mask |= (DWORD_PTR)1 << attr->cpus[i];
+    }
+    if (mask == 0 || SetThreadAffinityMask(thr.handle, mask) == 0) {
+      DDS_WARNING("SetThreadAffinityMask failed with %i\n", GetLastError());
+    }
+  }
+
   return DDS_RETCODE_OK;
 }
 
+dds_retcode_t
+ddsrt_thread_getaffinity(
+  ddsrt_thread_t thread,
+  uint32_t *ncpus,
+  uint32_t *cpus,
+  uint32_t maxcpus)
+{
+  (void)thread;
+  (void)ncpus;
+  (void)cpus;
+  (void)maxcpus;
+  return DDS_RETCODE_UNSUPPORTED;
+}
+
 ddsrt_tid_t
 ddsrt_gettid(void)
 {
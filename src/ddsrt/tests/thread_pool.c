@@ -0,0 +1,172 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdint.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsrt/thread_pool.h"
+#include "dds/ddsrt/time.h"
+
+CU_Init(ddsrt_thread_pool)
+{
+  ddsrt_init();
+  return 0;
+}
+
+CU_Clean(ddsrt_thread_pool)
+{
+  ddsrt_fini();
+  return 0;
+}
+
+static ddsrt_atomic_uint32_t count;
+static ddsrt_atomic_uint32_t started;
+static ddsrt_atomic_uint32_t gate;
+
+static void count_job(void *varg)
+{
+  (void)varg;
+  ddsrt_atomic_inc32(&count);
+}
+
+/* Blocks until the gate is opened */
+static void gate_job(void *varg)
+{
+  (void)varg;
+  ddsrt_atomic_inc32(&started);
+  while (ddsrt_atomic_ld32(&gate) == 0)
+    dds_sleepfor(DDS_MSECS(1));
+  ddsrt_atomic_inc32(&count);
+}
+
+static void slow_job(void *varg)
+{
+  (void)varg;
+  ddsrt_atomic_inc32(&started);
+  dds_sleepfor(DDS_MSECS(100));
+  ddsrt_atomic_inc32(&count);
+}
+
+static uint32_t open_gate(void *varg)
+{
+  (void)varg;
+  dds_sleepfor(DDS_MSECS(100));
+  ddsrt_atomic_st32(&gate, 1);
+  return 0;
+}
+
+static void reset(void)
+{
+  ddsrt_atomic_st32(&count, 0);
+  ddsrt_atomic_st32(&started, 0);
+  ddsrt_atomic_st32(&gate, 0);
+}
+
+static bool wait_for(ddsrt_atomic_uint32_t *x, uint32_t value)
+{
+  dds_time_t tend = dds_time() + DDS_SECS(10);
+  while (ddsrt_atomic_ld32(x) < value && dds_time() < tend)
+    dds_sleepfor(DDS_MSECS(1));
+  return ddsrt_atomic_ld32(x) >= value;
+}
+
+CU_Test(ddsrt_thread_pool, run_all)
+{
+  ddsrt_thread_pool pool;
+  reset();
+  pool = ddsrt_thread_pool_new(0, 4, 0, NULL);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+  for (int i = 0; i < 100; i++)
+    CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, count_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT(wait_for(&count, 100));
+  ddsrt_thread_pool_free(pool);
+  CU_ASSERT_EQUAL(ddsrt_atomic_ld32(&count), 100);
+}
+
+CU_Test(ddsrt_thread_pool, free_waits_for_running_job)
+{
+  ddsrt_thread_pool pool;
+  reset();
+  pool = ddsrt_thread_pool_new(2, 2, 0, NULL);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+  CU_ASSERT_EQUAL_FATAL(ddsrt_thread_pool_submit(pool, slow_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT_FATAL(wait_for(&started, 1));
+  /* Free may only return once the job has completed and the threads have
+     been joined */
+  ddsrt_thread_pool_free(pool);
+  CU_ASSERT_EQUAL(ddsrt_atomic_ld32(&count), 1);
+}
+
+CU_Test(ddsrt_thread_pool, free_with_queued_jobs)
+{
+  ddsrt_thread_pool pool;
+  ddsrt_thread_t tid;
+  ddsrt_threadattr_t attr;
+  reset();
+  pool = ddsrt_thread_pool_new(1, 1, 0, NULL);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+  CU_ASSERT_EQUAL_FATAL(ddsrt_thread_pool_submit(pool, gate_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT_FATAL(wait_for(&started, 1));
+  for (int i = 0; i < 10; i++)
+    CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, count_job, NULL), DDS_RETCODE_OK);
+  /* The only thread is blocked, so all jobs are still queued; freeing the
+     pool discards them and waits for the blocked job */
+  ddsrt_threadattr_init(&attr);
+  CU_ASSERT_EQUAL_FATAL(ddsrt_thread_create(&tid, "open_gate", &attr, open_gate, NULL), DDS_RETCODE_OK);
+  ddsrt_thread_pool_free(pool);
+  CU_ASSERT(ddsrt_atomic_ld32(&gate) != 0);
+  CU_ASSERT(ddsrt_atomic_ld32(&count) >= 1);
+  CU_ASSERT_EQUAL(ddsrt_thread_join(tid, NULL), DDS_RETCODE_OK);
+}
+
+CU_Test(ddsrt_thread_pool, max_queue)
+{
+  ddsrt_thread_pool pool;
+  reset();
+  pool = ddsrt_thread_pool_new(1, 1, 2, NULL);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+  CU_ASSERT_EQUAL_FATAL(ddsrt_thread_pool_submit(pool, gate_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT_FATAL(wait_for(&started, 1));
+  CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, count_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, count_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, count_job, NULL), DDS_RETCODE_TRY_AGAIN);
+  ddsrt_atomic_st32(&gate, 1);
+  CU_ASSERT(wait_for(&count, 3));
+  ddsrt_thread_pool_free(pool);
+  CU_ASSERT_EQUAL(ddsrt_atomic_ld32(&count), 3);
+}
+
+CU_Test(ddsrt_thread_pool, purge)
+{
+  ddsrt_thread_pool pool;
+  reset();
+  pool = ddsrt_thread_pool_new(1, 0, 0, NULL);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+  /* Blocking jobs force the pool to grow, one thread per job */
+  for (int i = 0; i < 4; i++)
+    CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, gate_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT_FATAL(wait_for(&started, 4));
+  ddsrt_atomic_st32(&gate, 1);
+  CU_ASSERT_FATAL(wait_for(&count, 4));
+  /* Purging terminates the idle threads beyond the minimum; the pool must
+     still accept and run jobs afterwards */
+  ddsrt_thread_pool_purge(pool);
+  for (int i = 0; i < 10; i++)
+    CU_ASSERT_EQUAL(ddsrt_thread_pool_submit(pool, count_job, NULL), DDS_RETCODE_OK);
+  CU_ASSERT(wait_for(&count, 14));
+  ddsrt_thread_pool_purge(pool);
+  ddsrt_thread_pool_free(pool);
+  CU_ASSERT_EQUAL(ddsrt_atomic_ld32(&count), 14);
+}
@@ -0,0 +1,43 @@
+#include "mpt/mpt.h"
+#include "mpt/resource.h" /* MPT_SOURCE_ROOT_DIR */
+#include "procs/coherent.h"
+
+
+/*
+ * Tests to check that coherent sets from a remote writer are delivered to a
+ * reader with coherent access all at once, on the end-of-set marker, and that
+ * a set missing a sample, which the writer could only answer with a GAP, is
+ * not delivered at all.
+ */
+
+
+static mpt_env_t environment_lossy[] = {
+    { "ETC_DIR",        MPT_SOURCE_ROOT_DIR"/tests/basic/etc" },
+    { "CYCLONEDDS_URI", "file://${ETC_DIR}/config_lossy.xml"  },
+    { NULL,             NULL                                  }
+};
+
+
+/*
+ * Keep-all writer without packet loss: all sets arrive.
+ */
+#define TEST_PUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "coherent_sets", 20, 5, 0)
+#define TEST_SUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "coherent_sets", 20, 5, false)
+MPT_TestProcess(coherent, sets, pub, coherent_publisher,  TEST_PUB_ARGS);
+MPT_TestProcess(coherent, sets, sub, coherent_subscriber, TEST_SUB_ARGS);
+MPT_Test(coherent, sets, .init=coherent_init, .fini=coherent_fini);
+#undef TEST_SUB_ARGS
+#undef TEST_PUB_ARGS
+
+
+/*
+ * Keep-last writer on a lossy network: lost samples that have been
+ * overwritten are answered with a GAP, and those sets get dropped.
+ */
+#define TEST_PUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "coherent_gap", 50, 5, 1)
+#define TEST_SUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "coherent_gap", 50, 5, true)
+MPT_TestProcess(coherent, gap, pub, coherent_publisher,  TEST_PUB_ARGS);
+MPT_TestProcess(coherent, gap, sub, coherent_subscriber, TEST_SUB_ARGS);
+MPT_Test(coherent, gap, .init=coherent_init, .fini=coherent_fini, .environment=environment_lossy, .timeout=60);
+#undef TEST_SUB_ARGS
+#undef TEST_PUB_ARGS
@@ -0,0 +1,26 @@
+#include "mpt/mpt.h"
+#include "mpt/resource.h" /* MPT_SOURCE_ROOT_DIR */
+#include "procs/sequence.h"
+
+
+/*
+ * Tests to check that reliable data sent over multicast with forward error
+ * correction (Internal/FecGroupSize) on a lossy network
+ * (Internal/Test/XmitLossiness) arrives completely and in order, regardless
+ * of whether a lost packet is reconstructed from a parity packet or
+ * retransmitted.
+ */
+
+
+static mpt_env_t environment_fec[] = {
+    { "ETC_DIR",        MPT_SOURCE_ROOT_DIR"/tests/basic/etc" },
+    { "CYCLONEDDS_URI", "file://${ETC_DIR}/config_fec.xml"    },
+    { NULL,             NULL                                  }
+};
+
+
+#define TEST_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "fec_lossy", 2000)
+MPT_TestProcess(fec, lossy, pub, sequence_publisher,  TEST_ARGS);
+MPT_TestProcess(fec, lossy, sub, sequence_subscriber, TEST_ARGS);
+MPT_Test(fec, lossy, .init=sequence_init, .fini=sequence_fini, .environment=environment_fec);
+#undef TEST_ARGS
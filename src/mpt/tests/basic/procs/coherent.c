@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mpt/mpt.h"
+
+#include "dds/dds.h"
+#include "helloworlddata.h"
+
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/sync.h"
+#include "coherent.h"
+
+
+#define MAX_SAMPLES 64
+
+/* The sets are written as instance 0, the final set as instance 1 */
+#define SET_ID   0
+#define FINAL_ID 1
+
+static int g_publication_matched_count = 0;
+static ddsrt_mutex_t g_mutex;
+static ddsrt_cond_t  g_cond;
+
+static void
+publication_matched_cb(
+        dds_entity_t writer,
+        const dds_publication_matched_status_t status,
+        void* arg)
+{
+  (void)arg;
+  (void)writer;
+  ddsrt_mutex_lock(&g_mutex);
+  g_publication_matched_count = (int)status.current_count;
+  ddsrt_cond_broadcast(&g_cond);
+  ddsrt_mutex_unlock(&g_mutex);
+}
+
+static void
+data_available_cb(
+        dds_entity_t reader,
+        void* arg)
+{
+  (void)arg;
+  (void)reader;
+  ddsrt_mutex_lock(&g_mutex);
+  ddsrt_cond_broadcast(&g_cond);
+  ddsrt_mutex_unlock(&g_mutex);
+}
+
+void
+coherent_init(void)
+{
+  ddsrt_init();
+  ddsrt_mutex_init(&g_mutex);
+  ddsrt_cond_init(&g_cond);
+}
+
+void
+coherent_fini(void)
+{
+  ddsrt_cond_destroy(&g_cond);
+  ddsrt_mutex_destroy(&g_mutex);
+  ddsrt_fini();
+}
+
+static dds_qos_t *
+ready_qos(void)
+{
+  dds_qos_t *qos = dds_create_qos();
+  dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
+  dds_qset_durability(qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  return qos;
+}
+
+static dds_entity_t
+create_ready_topic(dds_entity_t participant, const char *topic_name)
+{
+  char name[100];
+  dds_entity_t topic;
+  (void)snprintf(name, sizeof(name), "%s_ready", topic_name);
+  topic = dds_create_topic (participant, &HelloWorldData_Msg_desc, name, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  return topic;
+}
+
+static dds_qos_t *
+coherent_qos(void)
+{
+  /* Coherent access at topic scope for the publisher and the subscriber,
+     reliable and keep-all for the readers and writers. */
+  dds_qos_t *qos = dds_create_qos();
+  dds_qset_presentation(qos, DDS_PRESENTATION_TOPIC, true, false);
+  dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
+  dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+  return qos;
+}
+
+
+/*
+ * The coherent publisher.
+ * It waits for a publication matched and for the subscriber to signal that
+ * its reader has discovered the writer, so that no set can be missed for
+ * that reason. It then writes set_cnt coherent sets of set_size samples of a
+ * single instance, the message is "set:index". A final set with a single
+ * sample of another instance follows. Each set is closed by the end-of-set
+ * marker dds_end_coherent sends, and as nothing follows the final set, the
+ * subscriber only gets it because of that marker.
+ *
+ * A history_depth > 0 makes the writer keep-last, so that lost samples
+ * overwritten by later ones in the same set can no longer be retransmitted.
+ * The subscriber gets a GAP for those instead.
+ * It quits when the publication matched has been reset again.
+ */
+MPT_ProcessEntry(coherent_publisher,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int set_cnt,
+                          int set_size,
+                          int history_depth))
+{
+  HelloWorldData_Msg msg;
+  dds_listener_t *listener;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t publisher;
+  dds_entity_t writer;
+  dds_entity_t ready_reader;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  char text[32];
+  int id = (int)ddsrt_getpid();
+
+  assert(topic_name);
+
+  printf("=== [Publisher(%d)] Start(%d) ...\n", id, domainid);
+
+  qos = coherent_qos();
+
+  listener = dds_create_listener(NULL);
+  MPT_ASSERT_FATAL_NOT_NULL(listener, "Could not create listener");
+  dds_lset_publication_matched(listener, publication_matched_cb);
+
+  participant = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(participant, 0, "Could not create participant: %s\n", dds_strretcode(-participant));
+  topic = dds_create_topic (
+            participant, &HelloWorldData_Msg_desc, topic_name, qos, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  publisher = dds_create_publisher (participant, qos, NULL);
+  MPT_ASSERT_FATAL_GT(publisher, 0, "Could not create publisher: %s\n", dds_strretcode(-publisher));
+  if (history_depth > 0)
+    dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, history_depth);
+  writer = dds_create_writer (publisher, topic, qos, listener);
+  MPT_ASSERT_FATAL_GT(writer, 0, "Could not create writer: %s\n", dds_strretcode(-writer));
+
+  ddsrt_mutex_lock(&g_mutex);
+  while (g_publication_matched_count != 1) {
+    ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_INFINITY);
+  }
+  ddsrt_mutex_unlock(&g_mutex);
+
+  dds_delete_qos(qos);
+  qos = ready_qos();
+  ready_reader = dds_create_reader (participant, create_ready_topic(participant, topic_name), qos, NULL);
+  MPT_ASSERT_FATAL_GT(ready_reader, 0, "Could not create reader: %s\n", dds_strretcode(-ready_reader));
+  do {
+    HelloWorldData_Msg ready;
+    void *ptr = &ready;
+    dds_sample_info_t info;
+    memset(&ready, 0, sizeof(ready));
+    if ((rc = dds_take (ready_reader, &ptr, &info, 1, 1)) > 0)
+      dds_return_loan (ready_reader, &ptr, rc);
+    else
+      dds_sleepfor (DDS_MSECS(10));
+  } while (rc <= 0);
+
+  msg.message = text;
+  for (int s = 0; s <= set_cnt; s++) {
+    const int n = (s < set_cnt) ? set_size : 1;
+    rc = dds_begin_coherent (publisher);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not begin set %d\n", s);
+    msg.userID = (s < set_cnt) ? SET_ID : FINAL_ID;
+    for (int i = 0; i < n; i++) {
+      (void)snprintf(text, sizeof(text), "%d:%d", s, i);
+      rc = dds_write (writer, &msg);
+      MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Could not write sample %d of set %d\n", i, s);
+    }
+    rc = dds_end_coherent (publisher);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not end set %d\n", s);
+  }
+  printf("=== [Publisher(%d)] Sent %d sets\n", id, set_cnt + 1);
+
+  /* Wait for the subscriber to have finished. */
+  ddsrt_mutex_lock(&g_mutex);
+  while (g_publication_matched_count != 0) {
+    ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_INFINITY);
+  }
+  ddsrt_mutex_unlock(&g_mutex);
+
+  rc = dds_delete (participant);
+  MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Teardown failed\n");
+
+  dds_delete_listener(listener);
+  dds_delete_qos(qos);
+
+  printf("=== [Publisher(%d)] Done\n", id);
+}
+
+
+/*
+ * The coherent subscriber.
+ * Once its reader has discovered the writer, it tells the publisher to start
+ * writing. It then takes samples until it has received the final set,
+ * checking that every set is stored in the reader history cache all at once:
+ * whenever it has taken everything there is, each set it has seen must be
+ * complete.
+ *
+ * Without packet loss, every set must arrive. With packet loss, a lost
+ * sample that has been overwritten in the writer history makes the writer
+ * send a GAP, the set is then incomplete and must be dropped as a whole:
+ * some of the sets must be missing.
+ */
+MPT_ProcessEntry(coherent_subscriber,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int set_cnt,
+                          int set_size,
+                          bool lossy))
+{
+  void *samples[MAX_SAMPLES];
+  dds_sample_info_t infos[MAX_SAMPLES];
+  dds_listener_t *listener;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t subscriber;
+  dds_entity_t reader;
+  dds_entity_t ready_writer;
+  dds_subscription_matched_status_t sm;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  int *counts;
+  int missing_cnt = 0;
+  bool done = false;
+  int id = (int)ddsrt_getpid();
+
+  assert(topic_name);
+  assert(set_size <= MAX_SAMPLES);
+
+  printf("--- [Subscriber(%d)] Start(%d) ...\n", id, domainid);
+
+  qos = coherent_qos();
+
+  listener = dds_create_listener(NULL);
+  MPT_ASSERT_FATAL_NOT_NULL(listener, "Could not create listener");
+  dds_lset_data_available(listener, data_available_cb);
+
+  participant = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(participant, 0, "Could not create participant: %s\n", dds_strretcode(-participant));
+  topic = dds_create_topic (
+            participant, &HelloWorldData_Msg_desc, topic_name, qos, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  subscriber = dds_create_subscriber (participant, qos, NULL);
+  MPT_ASSERT_FATAL_GT(subscriber, 0, "Could not create subscriber: %s\n", dds_strretcode(-subscriber));
+  reader = dds_create_reader (subscriber, topic, qos, listener);
+  MPT_ASSERT_FATAL_GT(reader, 0, "Could not create reader: %s\n", dds_strretcode(-reader));
+
+  do {
+    dds_sleepfor (DDS_MSECS(10));
+    rc = dds_get_subscription_matched_status (reader, &sm);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not get subscription matched status\n");
+  } while (sm.current_count == 0);
+  dds_delete_qos(qos);
+  qos = ready_qos();
+  ready_writer = dds_create_writer (participant, create_ready_topic(participant, topic_name), qos, NULL);
+  MPT_ASSERT_FATAL_GT(ready_writer, 0, "Could not create writer: %s\n", dds_strretcode(-ready_writer));
+  {
+    HelloWorldData_Msg ready = { 0, "ready" };
+    rc = dds_write (ready_writer, &ready);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not write ready\n");
+  }
+
+  printf("--- [Subscriber(%d)] Waiting for %d set(s) ...\n", id, set_cnt + 1);
+
+  counts = calloc((size_t)set_cnt, sizeof(*counts));
+  MPT_ASSERT_FATAL_NOT_NULL(counts, "Could not allocate counts");
+  for (int i = 0; i < MAX_SAMPLES; i++)
+    samples[i] = HelloWorldData_Msg__alloc ();
+
+  ddsrt_mutex_lock(&g_mutex);
+  while (!done) {
+    rc = dds_take (reader, samples, infos, MAX_SAMPLES, MAX_SAMPLES);
+    MPT_ASSERT_FATAL_GEQ(rc, 0, "Could not take: %s\n", dds_strretcode(-rc));
+    if (rc == 0) {
+      ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_MSECS(100));
+      continue;
+    }
+    for (int i = 0; i < rc; i++) {
+      const HelloWorldData_Msg *msg = samples[i];
+      int s, idx;
+      if (!infos[i].valid_data)
+        continue;
+      MPT_ASSERT_FATAL_EQ(sscanf(msg->message, "%d:%d", &s, &idx), 2,
+                          "Unexpected message \"%s\"\n", msg->message);
+      if (msg->userID == FINAL_ID) {
+        MPT_ASSERT_FATAL_EQ(s, set_cnt, "Unexpected final set %d\n", s);
+        done = true;
+        continue;
+      }
+      MPT_ASSERT_FATAL(s >= 0 && s < set_cnt, "Unexpected set %d\n", s);
+      MPT_ASSERT_FATAL_EQ(idx, counts[s], "Received sample %d of set %d, expected %d\n", idx, s, counts[s]);
+      counts[s]++;
+    }
+    if (rc < MAX_SAMPLES) {
+      /* Everything in the reader has been taken, so no set can be partial. */
+      for (int s = 0; s < set_cnt; s++)
+        MPT_ASSERT_FATAL(counts[s] == 0 || counts[s] == set_size,
+                         "Set %d partially received (%d of %d samples)\n", s, counts[s], set_size);
+    }
+  }
+  ddsrt_mutex_unlock(&g_mutex);
+
+  for (int s = 0; s < set_cnt; s++) {
+    if (counts[s] == 0)
+      missing_cnt++;
+  }
+  printf("--- [Subscriber(%d)] Received %d set(s), %d dropped\n", id, set_cnt + 1 - missing_cnt, missing_cnt);
+  if (lossy)
+    MPT_ASSERT(missing_cnt > 0, "No set was dropped\n");
+  else
+    MPT_ASSERT_EQ(missing_cnt, 0, "%d sets were dropped\n", missing_cnt);
+
+  for (int i = 0; i < MAX_SAMPLES; i++)
+    HelloWorldData_Msg_free (samples[i], DDS_FREE_ALL);
+  free(counts);
+
+  rc = dds_delete (participant);
+  MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Teardown failed\n");
+
+  dds_delete_listener(listener);
+  dds_delete_qos(qos);
+
+  printf("--- [Subscriber(%d)] Done\n", id);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef MPT_BASIC_PROCS_COHERENT_H
+#define MPT_BASIC_PROCS_COHERENT_H
+
+#include <stdbool.h>
+
+#include "dds/dds.h"
+#include "mpt/mpt.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+void coherent_init(void);
+void coherent_fini(void);
+
+MPT_ProcessEntry(coherent_publisher,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int set_cnt,
+                          int set_size,
+                          int history_depth));
+
+MPT_ProcessEntry(coherent_subscriber,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int set_cnt,
+                          int set_size,
+                          bool lossy));
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* MPT_BASIC_PROCS_COHERENT_H */
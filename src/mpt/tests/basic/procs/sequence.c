@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mpt/mpt.h"
+
+#include "dds/dds.h"
+#include "helloworlddata.h"
+
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/strtol.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/sync.h"
+#include "sequence.h"
+
+
+#define MAX_SAMPLES 16
+
+static int g_publication_matched_count = 0;
+static ddsrt_mutex_t g_mutex;
+static ddsrt_cond_t  g_cond;
+
+static void
+publication_matched_cb(
+        dds_entity_t writer,
+        const dds_publication_matched_status_t status,
+        void* arg)
+{
+  (void)arg;
+  (void)writer;
+  ddsrt_mutex_lock(&g_mutex);
+  g_publication_matched_count = (int)status.current_count;
+  ddsrt_cond_broadcast(&g_cond);
+  ddsrt_mutex_unlock(&g_mutex);
+}
+
+static void
+data_available_cb(
+        dds_entity_t reader,
+        void* arg)
+{
+  (void)arg;
+  (void)reader;
+  ddsrt_mutex_lock(&g_mutex);
+  ddsrt_cond_broadcast(&g_cond);
+  ddsrt_mutex_unlock(&g_mutex);
+}
+
+void
+sequence_init(void)
+{
+  ddsrt_init();
+  ddsrt_mutex_init(&g_mutex);
+  ddsrt_cond_init(&g_cond);
+}
+
+void
+sequence_fini(void)
+{
+  ddsrt_cond_destroy(&g_cond);
+  ddsrt_mutex_destroy(&g_mutex);
+  ddsrt_fini();
+}
+
+static dds_qos_t *
+sequence_qos(void)
+{
+  /*
+   * Reliable and keep-all, so that all samples must arrive once the reader
+   * is in sync with the writer. Volatile, because catching up on historical
+   * data runs separately from the live stream.
+   */
+  dds_qos_t *qos = dds_create_qos();
+  dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
+  dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+  return qos;
+}
+
+
+/*
+ * The sequence publisher.
+ * It waits for a publication matched, and then writes sample_cnt samples of
+ * a single instance, the message is the sequence number of the sample.
+ * It quits when the publication matched has been reset again.
+ */
+MPT_ProcessEntry(sequence_publisher,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int sample_cnt))
+{
+  HelloWorldData_Msg msg;
+  dds_listener_t *listener;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t writer;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  char text[16];
+  int id = (int)ddsrt_getpid();
+
+  assert(topic_name);
+
+  printf("=== [Publisher(%d)] Start(%d) ...\n", id, domainid);
+
+  qos = sequence_qos();
+
+  listener = dds_create_listener(NULL);
+  MPT_ASSERT_FATAL_NOT_NULL(listener, "Could not create listener");
+  dds_lset_publication_matched(listener, publication_matched_cb);
+
+  participant = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(participant, 0, "Could not create participant: %s\n", dds_strretcode(-participant));
+  topic = dds_create_topic (
+            participant, &HelloWorldData_Msg_desc, topic_name, qos, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  writer = dds_create_writer (participant, topic, qos, listener);
+  MPT_ASSERT_FATAL_GT(writer, 0, "Could not create writer: %s\n", dds_strretcode(-writer));
+
+  ddsrt_mutex_lock(&g_mutex);
+  while (g_publication_matched_count != 1) {
+    ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_INFINITY);
+  }
+  ddsrt_mutex_unlock(&g_mutex);
+
+  msg.userID = 0;
+  msg.message = text;
+  for (int i = 0; i < sample_cnt; i++) {
+    (void)snprintf(text, sizeof(text), "%d", i);
+    rc = dds_write (writer, &msg);
+    MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Could not write sample %d\n", i);
+  }
+  printf("=== [Publisher(%d)] Sent %d samples\n", id, sample_cnt);
+
+  /* Wait for the subscriber to have finished. */
+  ddsrt_mutex_lock(&g_mutex);
+  while (g_publication_matched_count != 0) {
+    ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_INFINITY);
+  }
+  ddsrt_mutex_unlock(&g_mutex);
+
+  rc = dds_delete (participant);
+  MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Teardown failed\n");
+
+  dds_delete_listener(listener);
+  dds_delete_qos(qos);
+
+  printf("=== [Publisher(%d)] Done\n", id);
+}
+
+
+/*
+ * The sequence subscriber.
+ * It takes samples until the last one written has been received, checking
+ * that they arrive in the order in which they were written and without gaps.
+ *
+ * The publisher only knows that its writer has discovered the reader, not
+ * that the reader has discovered the writer, and the first few samples may
+ * be dropped by the reader for that reason. So the first sample received
+ * needn't be the first one written, but everything after it must arrive.
+ */
+MPT_ProcessEntry(sequence_subscriber,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int sample_cnt))
+{
+  void *samples[MAX_SAMPLES];
+  dds_sample_info_t infos[MAX_SAMPLES];
+  dds_listener_t *listener;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t reader;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  int recv_cnt;
+  long long next_seq;
+  int id = (int)ddsrt_getpid();
+
+  assert(topic_name);
+
+  printf("--- [Subscriber(%d)] Start(%d) ...\n", id, domainid);
+
+  qos = sequence_qos();
+
+  listener = dds_create_listener(NULL);
+  MPT_ASSERT_FATAL_NOT_NULL(listener, "Could not create listener");
+  dds_lset_data_available(listener, data_available_cb);
+
+  participant = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(participant, 0, "Could not create participant: %s\n", dds_strretcode(-participant));
+  topic = dds_create_topic (
+            participant, &HelloWorldData_Msg_desc, topic_name, qos, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  reader = dds_create_reader (participant, topic, qos, listener);
+  MPT_ASSERT_FATAL_GT(reader, 0, "Could not create reader: %s\n", dds_strretcode(-reader));
+
+  printf("--- [Subscriber(%d)] Waiting for %d sample(s) ...\n", id, sample_cnt);
+
+  for (int i = 0; i < MAX_SAMPLES; i++)
+    samples[i] = HelloWorldData_Msg__alloc ();
+
+  ddsrt_mutex_lock(&g_mutex);
+  recv_cnt = 0;
+  next_seq = -1;
+  while (next_seq < sample_cnt) {
+    rc = dds_take (reader, samples, infos, MAX_SAMPLES, MAX_SAMPLES);
+    MPT_ASSERT_FATAL_GEQ(rc, 0, "Could not take: %s\n", dds_strretcode(-rc));
+    if (rc == 0) {
+      ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_INFINITY);
+      continue;
+    }
+    for (int i = 0; i < rc; i++) {
+      const HelloWorldData_Msg *msg = samples[i];
+      long long seq;
+      if (!infos[i].valid_data)
+        continue;
+      MPT_ASSERT_FATAL_EQ(ddsrt_atoll(msg->message, &seq), DDS_RETCODE_OK,
+                          "Unexpected message \"%s\"\n", msg->message);
+      if (next_seq < 0)
+        next_seq = seq;
+      MPT_ASSERT_FATAL_EQ(seq, next_seq, "Received sample %lld, expected %lld\n", seq, next_seq);
+      next_seq++;
+      recv_cnt++;
+    }
+  }
+  ddsrt_mutex_unlock(&g_mutex);
+  printf("--- [Subscriber(%d)] Received %d samples in order\n", id, recv_cnt);
+  MPT_ASSERT(recv_cnt > sample_cnt / 2, "Received only %d of %d samples\n", recv_cnt, sample_cnt);
+
+  for (int i = 0; i < MAX_SAMPLES; i++)
+    HelloWorldData_Msg_free (samples[i], DDS_FREE_ALL);
+
+  rc = dds_delete (participant);
+  MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Teardown failed\n");
+
+  dds_delete_listener(listener);
+  dds_delete_qos(qos);
+
+  printf("--- [Subscriber(%d)] Done\n", id);
+}
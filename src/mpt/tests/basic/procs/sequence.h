@@ -0,0 +1,39 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef MPT_BASIC_PROCS_SEQUENCE_H
+#define MPT_BASIC_PROCS_SEQUENCE_H
+
+#include "dds/dds.h"
+#include "mpt/mpt.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+void sequence_init(void);
+void sequence_fini(void);
+
+MPT_ProcessEntry(sequence_publisher,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int sample_cnt));
+
+MPT_ProcessEntry(sequence_subscriber,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int sample_cnt));
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* MPT_BASIC_PROCS_SEQUENCE_H */
@@ -0,0 +1,45 @@
+#include "mpt/mpt.h"
+#include "mpt/resource.h" /* MPT_SOURCE_ROOT_DIR */
+#include "procs/hello.h"
+
+
+/*
+ * Tests to check that data still arrives when unicast reception is spread
+ * over several receive threads (Internal/MultipleReceiveThreads/@unicastthreads).
+ */
+
+
+static mpt_env_t environment_recvthreads[] = {
+    { "ETC_DIR",        MPT_SOURCE_ROOT_DIR"/tests/basic/etc"       },
+    { "CYCLONEDDS_URI", "file://${ETC_DIR}/config_recvthreads.xml"  },
+    { NULL,             NULL                                        }
+};
+
+
+/*
+ * One publisher, one subscriber: all traffic from the remote participant is
+ * handled by one of the threads.
+ */
+#define TEST_PUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "recvthreads_pubsub", 1, "pubsub")
+#define TEST_SUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "recvthreads_pubsub", 1, "pubsub")
+MPT_TestProcess(recvthreads, pubsub, pub, hello_publisher,  TEST_PUB_ARGS);
+MPT_TestProcess(recvthreads, pubsub, sub, hello_subscriber, TEST_SUB_ARGS);
+MPT_Test(recvthreads, pubsub, .init=hello_init, .fini=hello_fini, .environment=environment_recvthreads);
+#undef TEST_SUB_ARGS
+#undef TEST_PUB_ARGS
+
+
+/*
+ * Several publishers and subscribers, so that the traffic of the different
+ * remote participants is spread over the threads.
+ */
+#define TEST_PUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "recvthreads_pubpubpubsubsub", 2, "pubpubpubsubsub")
+#define TEST_SUB_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "recvthreads_pubpubpubsubsub", 3, "pubpubpubsubsub")
+MPT_TestProcess(recvthreads, pubpubpubsubsub, pub1, hello_publisher,  TEST_PUB_ARGS);
+MPT_TestProcess(recvthreads, pubpubpubsubsub, pub2, hello_publisher,  TEST_PUB_ARGS);
+MPT_TestProcess(recvthreads, pubpubpubsubsub, pub3, hello_publisher,  TEST_PUB_ARGS);
+MPT_TestProcess(recvthreads, pubpubpubsubsub, sub1, hello_subscriber, TEST_SUB_ARGS);
+MPT_TestProcess(recvthreads, pubpubpubsubsub, sub2, hello_subscriber, TEST_SUB_ARGS);
+MPT_Test(recvthreads, pubpubpubsubsub, .init=hello_init, .fini=hello_fini, .environment=environment_recvthreads);
+#undef TEST_SUB_ARGS
+#undef TEST_PUB_ARGS
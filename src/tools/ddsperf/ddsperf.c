@@ -28,6 +28,7 @@
 #include "ddsperf_types.h"
 
 #include "dds/ddsrt/process.h"
+#include "dds/ddsrt/rusage.h"
 #include "dds/ddsrt/string.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/sockets.h"
@@ -45,9 +46,17 @@ enum topicsel {
   KS,   /* KeyedSeq type: seq#, key, sequence-of-octet */
   K32,  /* Keyed32  type: seq#, key, array-of-24-octet (sizeof = 32) */
   K256, /* Keyed256 type: seq#, key, array-of-248-octet (sizeof = 256) */
+  K1K,  /* Keyed1k  type: seq#, key, array-of-1016-octet (sizeof = 1024) */
+  K16K, /* Keyed16k type: seq#, key, array-of-16376-octet (sizeof = 16384) */
   OU    /* OneULong type: seq# */
 };
 
+enum outputfmt {
+  OF_TEXT, /* human-readable text */
+  OF_JSON, /* one JSON object per line per statistics record */
+  OF_CSV   /* CSV with a fixed set of columns */
+};
+
 enum submode {
   SM_NONE,    /* no subscriber at all */
   SM_WAITSET, /* subscriber using a waitset */
@@ -58,6 +67,19 @@ enum submode {
 static const char *argv0;
 static volatile sig_atomic_t termflag = 0;
 
+/* Output format for the statistics; in anything but text mode all
+   other output goes to stderr so stdout can be parsed reliably */
+static enum outputfmt outputfmt = OF_TEXT;
+static bool csvheader = true;
+static FILE *logfp;
+
+/* Name of this process in the statistics records, set by the
+   scenario runner for the processes it starts */
+static const char *procname = "ddsperf";
+
+/* Scenario file, NULL if not running a scenario */
+static const char *scenario_file = NULL;
+
 /* Domain participant, guard condition for termination, domain id */
 static dds_entity_t dp;
 static dds_instance_handle_t dp_handle;
@@ -304,13 +326,15 @@ union data {
   KeyedSeq ks;
   Keyed32 k32;
   Keyed256 k256;
+  Keyed1k k1k;
+  Keyed16k k16k;
   OneULong ou;
 };
 
 static void verrorx (int exitcode, const char *fmt, va_list ap)
 {
-  vprintf (fmt, ap);
-  fflush (stdout);
+  vfprintf (logfp, fmt, ap);
+  fflush (logfp);
   exit (exitcode);
 }
 
@@ -481,6 +505,164 @@ static void hist_print (const char *prefix, struct hist *h, dds_time_t dt, int r
     hist_reset (h);
 }
 
+static uint64_t hist_quantile (const struct hist *h, uint64_t cnt, double q)
+{
+  /* Upper bound of the bin containing the q-quantile, limited to the
+     maximum observed value (bins are too wide for the rest) */
+  const uint64_t target = (uint64_t) ((double) cnt * q + 0.5);
+  uint64_t acc = h->under;
+  if (acc >= target)
+    return (h->bin0 < h->max) ? h->bin0 : h->max;
+  for (unsigned i = 0; i < h->nbins; i++)
+  {
+    if ((acc += h->bins[i]) >= target)
+    {
+      const uint64_t ub = h->bin0 + (i + 1) * h->binwidth;
+      return (ub < h->max) ? ub : h->max;
+    }
+  }
+  return h->max;
+}
+
+/**************************
+ MACHINE-READABLE STATISTICS
+ **************************/
+
+/* Every statistics record has a timestamp, process id and name and a
+   record kind:
+
+     pub   publishing rate and latency of dds_write (from the histogram)
+     sub   receive rate and losses
+     rtt   round-trip latency statistics for one peer
+     proc  CPU usage and maximum resident set size of this process
+
+   and the subset of the fields below applicable to the kind.  In CSV
+   format all columns are always present, absent fields are empty.  All
+   times in microseconds except CPU times, which are in seconds. */
+static const char *statrec_fields[] = {
+  "peer", "size", "ntot", "delta", "lost", "rate_hz", "rate_mbps",
+  "mean_us", "min_us", "p50_us", "p90_us", "p99_us", "max_us", "cnt",
+  "cpu_user_s", "cpu_sys_s", "cpu_pct", "maxrss_bytes", NULL
+};
+
+#define STATREC_MAXFIELDS 18
+
+struct statrec {
+  double t;
+  const char *kind;
+  const char *peer;
+  unsigned nfields;
+  struct { const char *name; double value; } fields[STATREC_MAXFIELDS];
+};
+
+static void statrec_init (struct statrec *r, double t, const char *kind)
+{
+  r->t = t;
+  r->kind = kind;
+  r->peer = NULL;
+  r->nfields = 0;
+}
+
+static void statrec_add (struct statrec *r, const char *name, double value)
+{
+  assert (r->nfields < STATREC_MAXFIELDS);
+  r->fields[r->nfields].name = name;
+  r->fields[r->nfields].value = value;
+  r->nfields++;
+}
+
+static void print_quoted (const char *str, char quote)
+{
+  /* JSON and CSV only differ in how they escape the quote character
+     itself, and the strings here never contain control characters */
+  putchar (quote);
+  for (const char *c = str; *c; c++)
+  {
+    if (*c == quote)
+      fputs ((quote == '"' && outputfmt == OF_CSV) ? "\"\"" : "\\\"", stdout);
+    else if (*c == '\\' && outputfmt == OF_JSON)
+      fputs ("\\\\", stdout);
+    else
+      putchar (*c);
+  }
+  putchar (quote);
+}
+
+static void print_csv_header (void)
+{
+  printf ("time,pid,name,kind");
+  for (size_t i = 0; statrec_fields[i]; i++)
+    printf (",%s", statrec_fields[i]);
+  printf ("\n");
+  fflush (stdout);
+}
+
+static void statrec_print (const struct statrec *r)
+{
+  switch (outputfmt)
+  {
+    case OF_TEXT:
+      assert (0);
+      break;
+    case OF_JSON:
+      printf ("{\"time\":%.3f,\"pid\":%"PRIdPID",\"name\":", r->t, ddsrt_getpid ());
+      print_quoted (procname, '"');
+      printf (",\"kind\":\"%s\"", r->kind);
+      if (r->peer)
+      {
+        printf (",\"peer\":");
+        print_quoted (r->peer, '"');
+      }
+      for (unsigned i = 0; i < r->nfields; i++)
+        printf (",\"%s\":%.*g", r->fields[i].name, 15, r->fields[i].value);
+      printf ("}\n");
+      break;
+    case OF_CSV:
+      printf ("%.3f,%"PRIdPID",", r->t, ddsrt_getpid ());
+      print_quoted (procname, '"');
+      printf (",%s", r->kind);
+      for (size_t i = 0; statrec_fields[i]; i++)
+      {
+        putchar (',');
+        if (strcmp (statrec_fields[i], "peer") == 0)
+        {
+          if (r->peer)
+            print_quoted (r->peer, '"');
+        }
+        else
+        {
+          for (unsigned j = 0; j < r->nfields; j++)
+            if (strcmp (r->fields[j].name, statrec_fields[i]) == 0)
+              printf ("%.*g", 15, r->fields[j].value);
+        }
+      }
+      printf ("\n");
+      break;
+  }
+}
+
+static void hist_record_stats (double ts, struct hist *h, dds_time_t dt, int reset)
+{
+  struct statrec r;
+  uint64_t cnt = h->under + h->over;
+  for (unsigned i = 0; i < h->nbins; i++)
+    cnt += h->bins[i];
+  statrec_init (&r, ts, "pub");
+  statrec_add (&r, "cnt", (double) cnt);
+  statrec_add (&r, "rate_hz", (double) cnt / ((double) dt / 1e9));
+  if (cnt > 0)
+  {
+    statrec_add (&r, "min_us", (double) h->min / 1e3);
+    statrec_add (&r, "p50_us", (double) hist_quantile (h, cnt, 0.5) / 1e3);
+    statrec_add (&r, "p90_us", (double) hist_quantile (h, cnt, 0.9) / 1e3);
+    statrec_add (&r, "p99_us", (double) hist_quantile (h, cnt, 0.99) / 1e3);
+    statrec_add (&r, "max_us", (double) h->max / 1e3);
+  }
+  statrec_print (&r);
+  if (reset)
+    hist_reset (h);
+}
+
 static void *make_baggage (dds_sequence_t *b, unsigned cnt)
 {
   b->_maximum = b->_length = cnt;
@@ -514,6 +696,16 @@ static void *init_sample (union data *data, uint32_t seq)
       data->k256.keyval = 0;
       memset (data->k256.baggage, 0xee, sizeof (data->k256.baggage));
       break;
+    case K1K:
+      data->k1k.seq = seq;
+      data->k1k.keyval = 0;
+      memset (data->k1k.baggage, 0xee, sizeof (data->k1k.baggage));
+      break;
+    case K16K:
+      data->k16k.seq = seq;
+      data->k16k.keyval = 0;
+      memset (data->k16k.baggage, 0xee, sizeof (data->k16k.baggage));
+      break;
     case OU:
       data->ou.seq = seq;
       break;
@@ -557,8 +749,8 @@ static uint32_t pubthread (void *varg)
     const dds_time_t t_write = (dds_time () & ~1) | reqresp;
     if ((result = dds_write_ts (wr_data, &data, t_write)) != DDS_RETCODE_OK)
     {
-      printf ("write error: %d\n", result);
-      fflush (stdout);
+      fprintf (logfp, "write error: %d\n", result);
+      fflush (logfp);
       if (dds_err_nr (result) != DDS_RETCODE_TIMEOUT)
         exit (2);
       timeouts++;
@@ -628,7 +820,7 @@ static int check_eseq (struct eseq_admin *ea, uint32_t seq, uint32_t keyval, uin
   uint32_t *eseq;
   if (keyval >= ea->nkeys)
   {
-    printf ("received key %"PRIu32" >= nkeys %u\n", keyval, ea->nkeys);
+    fprintf (logfp, "received key %"PRIu32" >= nkeys %u\n", keyval, ea->nkeys);
     exit (3);
   }
   ddsrt_mutex_lock (&ea->lock);
@@ -672,8 +864,8 @@ static dds_instance_handle_t get_pphandle_for_pubhandle (dds_instance_handle_t p
     error2 ("dds_read_instance(rd_publications, %"PRIx64") failed: %d\n", pubhandle, (int) n);
   if (n == 0 || !info.valid_data)
   {
-    printf ("get_pong_writer: publication handle %"PRIx64" not found\n", pubhandle);
-    fflush (stdout);
+    fprintf (logfp, "get_pong_writer: publication handle %"PRIx64" not found\n", pubhandle);
+    fflush (logfp);
     return 0;
   }
   else
@@ -756,8 +948,8 @@ static dds_entity_t get_pong_writer_locked (dds_instance_handle_t pubhandle)
       }
     }
   }
-  printf ("get_pong_writer: participant handle %"PRIx64" not found\n", pphandle);
-  fflush (stdout);
+  fprintf (logfp, "get_pong_writer: participant handle %"PRIx64" not found\n", pphandle);
+  fflush (logfp);
   return 0;
 }
 
@@ -788,6 +980,8 @@ static bool process_data (dds_entity_t rd, struct subthread_arg *arg)
         case KS:   { KeyedSeq *d = (KeyedSeq *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 12 + d->baggage._length; } break;
         case K32:  { Keyed32 *d  = (Keyed32 *)  mseq[i]; keyval = d->keyval; seq = d->seq; size = 32; } break;
         case K256: { Keyed256 *d = (Keyed256 *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 256; } break;
+        case K1K:  { Keyed1k *d  = (Keyed1k *)  mseq[i]; keyval = d->keyval; seq = d->seq; size = 1024; } break;
+        case K16K: { Keyed16k *d = (Keyed16k *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 16384; } break;
         case OU:   { OneULong *d = (OneULong *) mseq[i]; keyval = 0;         seq = d->seq; size = 4; } break;
       }
       (void) check_eseq (&eseq_admin, seq, keyval, size, iseq[i].publication_handle);
@@ -886,8 +1080,8 @@ static void maybe_send_new_ping (dds_time_t tnow, dds_time_t *tnextping)
   {
     if (tnow > twarn_ping_timeout)
     {
-      printf ("[%"PRIdPID"] ping timed out ... sending new ping\n", ddsrt_getpid ());
-      fflush (stdout);
+      fprintf (logfp, "[%"PRIdPID"] ping timed out ... sending new ping\n", ddsrt_getpid ());
+      fflush (logfp);
     }
     n_pong_seen = 0;
     cur_ping_time = tnow;
@@ -1078,8 +1272,8 @@ static void participant_data_listener (dds_entity_t rd, void *arg)
       ddsrt_mutex_lock (&disc_lock);
       if ((pp = ddsrt_avl_lookup_dpath (&ppants_td, &ppants, &info.instance_handle, &dpath)) != NULL)
       {
-        printf ("[%"PRIdPID"] participant %s:%"PRIu32": gone\n", ddsrt_getpid (), pp->hostname, pp->pid);
-        fflush (stdout);
+        fprintf (logfp, "[%"PRIdPID"] participant %s:%"PRIu32": gone\n", ddsrt_getpid (), pp->hostname, pp->pid);
+        fflush (logfp);
 
         if (pp->handle != dp_handle || ignorelocal == DDS_IGNORELOCAL_NONE)
         {
@@ -1116,7 +1310,7 @@ static void participant_data_listener (dds_entity_t rd, void *arg)
             free (hostname);
           else
           {
-            printf ("[%"PRIdPID"] participant %s:%"PRIu32": new%s\n", ddsrt_getpid (), hostname, (uint32_t) pid, (info.instance_handle == dp_handle) ? " (self)" : "");
+            fprintf (logfp, "[%"PRIdPID"] participant %s:%"PRIu32": new%s\n", ddsrt_getpid (), hostname, (uint32_t) pid, (info.instance_handle == dp_handle) ? " (self)" : "");
             pp = malloc (sizeof (*pp));
             pp->handle = info.instance_handle;
             pp->guid = sample->key;
@@ -1176,7 +1370,7 @@ static void endpoint_matched_listener (uint32_t match_mask, dds_entity_t rd_epin
   if ((n = dds_read_instance (rd_epinfo, &msg, &info, 1, 1, remote_endpoint)) < 0)
     error2 ("dds_read_instance(rd_epinfo, %"PRIx64") failed: %d\n", remote_endpoint, (int) n);
   else if (n == 0)
-    printf ("[%"PRIdPID"] endpoint %"PRIx64" not found\n", ddsrt_getpid (), remote_endpoint);
+    fprintf (logfp, "[%"PRIdPID"] endpoint %"PRIx64" not found\n", ddsrt_getpid (), remote_endpoint);
   else
   {
     if (info.valid_data)
@@ -1185,7 +1379,7 @@ static void endpoint_matched_listener (uint32_t match_mask, dds_entity_t rd_epin
       struct ppant *pp;
       ddsrt_mutex_lock (&disc_lock);
       if ((pp = ddsrt_avl_lookup (&ppants_td, &ppants, &sample->participant_instance_handle)) == NULL)
-        printf ("[%"PRIdPID"] participant %"PRIx64" no longer exists\n", ddsrt_getpid (), sample->participant_instance_handle);
+        fprintf (logfp, "[%"PRIdPID"] participant %"PRIx64" no longer exists\n", ddsrt_getpid (), sample->participant_instance_handle);
       else
       {
         pp->unmatched &= ~match_mask;
@@ -1196,7 +1390,7 @@ static void endpoint_matched_listener (uint32_t match_mask, dds_entity_t rd_epin
     }
     dds_return_loan (rd_epinfo, &msg, n);
   }
-  fflush (stdout);
+  fflush (logfp);
 }
 
 static const char *match_mask1_to_string (uint32_t mask)
@@ -1281,6 +1475,32 @@ static int cmp_uint64 (const void *va, const void *vb)
   return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
 }
 
+/* CPU time consumed at the time of the previous process statistics
+   output (or the start of the run) */
+static dds_time_t cpu_prev;
+
+static void init_proc_stats (void)
+{
+  ddsrt_rusage_t u;
+  if (ddsrt_getrusage (DDSRT_RUSAGE_SELF, &u) == DDS_RETCODE_OK)
+    cpu_prev = u.utime + u.stime;
+}
+
+static void print_proc_stats (double ts, dds_time_t tnow, dds_time_t tprev)
+{
+  ddsrt_rusage_t u;
+  struct statrec r;
+  if (ddsrt_getrusage (DDSRT_RUSAGE_SELF, &u) != DDS_RETCODE_OK)
+    return;
+  statrec_init (&r, ts, "proc");
+  statrec_add (&r, "cpu_user_s", (double) u.utime / 1e9);
+  statrec_add (&r, "cpu_sys_s", (double) u.stime / 1e9);
+  statrec_add (&r, "cpu_pct", 100.0 * (double) (u.utime + u.stime - cpu_prev) / (double) (tnow - tprev));
+  statrec_add (&r, "maxrss_bytes", (double) u.maxrss);
+  statrec_print (&r);
+  cpu_prev = u.utime + u.stime;
+}
+
 static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
 {
   char prefix[128];
@@ -1290,7 +1510,10 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
   if (rate > 0)
   {
     ddsrt_mutex_lock (&pubstat_lock);
-    hist_print (prefix, pubstat_hist, tnow - tprev, 1);
+    if (outputfmt == OF_TEXT)
+      hist_print (prefix, pubstat_hist, tnow - tprev, 1);
+    else
+      hist_record_stats (ts, pubstat_hist, tnow - tprev, 1);
     ddsrt_mutex_unlock (&pubstat_lock);
   }
 
@@ -1314,7 +1537,19 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
     }
     ddsrt_mutex_unlock (&ea->lock);
 
-    if (nrecv > 0)
+    if (outputfmt != OF_TEXT)
+    {
+      struct statrec r;
+      statrec_init (&r, ts, "sub");
+      statrec_add (&r, "size", last_size);
+      statrec_add (&r, "ntot", (double) tot_nrecv);
+      statrec_add (&r, "delta", (double) nrecv);
+      statrec_add (&r, "lost", (double) nlost);
+      statrec_add (&r, "rate_hz", (double) nrecv * 1e9 / (double) (tnow - tprev));
+      statrec_add (&r, "rate_mbps", (double) nrecv_bytes * 8 * 1e3 / (double) (tnow - tprev));
+      statrec_print (&r);
+    }
+    else if (nrecv > 0)
     {
       printf ("%s size %"PRIu32" ntot %"PRIu64" delta: %"PRIu64" lost %"PRIu64" rate %.2f Mb/s\n",
               prefix, last_size, tot_nrecv, nrecv, nlost, (double) nrecv_bytes * 8 * 1e3 / (double) (tnow - tprev));
@@ -1347,15 +1582,32 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
       ddsrt_mutex_unlock (&disc_lock);
 
       qsort (y.raw, rawcnt, sizeof (*y.raw), cmp_uint64);
-      printf ("%s  %s mean %.3fus min %.3fus 50%% %.3fus 90%% %.3fus 99%% %.3fus max %.3fus cnt %"PRIu32"\n",
-              prefix, ppinfo,
-              (double) y.sum / (double) y.cnt / 1e3,
-              (double) y.min / 1e3,
-              (double) y.raw[rawcnt - (rawcnt + 1) / 2] / 1e3,
-              (double) y.raw[rawcnt - (rawcnt + 9) / 10] / 1e3,
-              (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3,
-              (double) y.max / 1e3,
-              y.cnt);
+      if (outputfmt != OF_TEXT)
+      {
+        struct statrec r;
+        statrec_init (&r, ts, "rtt");
+        r.peer = ppinfo;
+        statrec_add (&r, "mean_us", (double) y.sum / (double) y.cnt / 1e3);
+        statrec_add (&r, "min_us", (double) y.min / 1e3);
+        statrec_add (&r, "p50_us", (double) y.raw[rawcnt - (rawcnt + 1) / 2] / 1e3);
+        statrec_add (&r, "p90_us", (double) y.raw[rawcnt - (rawcnt + 9) / 10] / 1e3);
+        statrec_add (&r, "p99_us", (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3);
+        statrec_add (&r, "max_us", (double) y.max / 1e3);
+        statrec_add (&r, "cnt", y.cnt);
+        statrec_print (&r);
+      }
+      else
+      {
+        printf ("%s  %s mean %.3fus min %.3fus 50%% %.3fus 90%% %.3fus 99%% %.3fus max %.3fus cnt %"PRIu32"\n",
+                prefix, ppinfo,
+                (double) y.sum / (double) y.cnt / 1e3,
+                (double) y.min / 1e3,
+                (double) y.raw[rawcnt - (rawcnt + 1) / 2] / 1e3,
+                (double) y.raw[rawcnt - (rawcnt + 9) / 10] / 1e3,
+                (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3,
+                (double) y.max / 1e3,
+                y.cnt);
+      }
     }
     newraw = y.raw;
 
@@ -1363,6 +1615,8 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
   }
   ddsrt_mutex_unlock (&pongstat_lock);
   free (newraw);
+  if (outputfmt != OF_TEXT)
+    print_proc_stats (ts, tnow, tprev);
   fflush (stdout);
 }
 
@@ -1414,10 +1668,12 @@ static void usage (void)
 %s [OPTIONS] MODE...\n\
 \n\
 OPTIONS:\n\
-  -T KS|K32|K256|OU   topic:\n\
+  -T KS|K32|K256|K1K|K16K|OU  topic:\n\
                         KS   seq num, key value, sequence-of-octets\n\
                         K32  seq num, key value, array of 24 octets\n\
                         K256 seq num, key value, array of 248 octets\n\
+                        K1K  seq num, key value, array of 1016 octets\n\
+                        K16K seq num, key value, array of 16376 octets\n\
                         OU   seq num\n\
   -L                  allow matching with local endpoints\n\
   -u                  best-effort instead of reliable\n\
@@ -1428,6 +1684,16 @@ OPTIONS:\n\
   -D DUR              run for at most DUR seconds\n\
   -N COUNT            require at least COUNT matching participants\n\
   -M DUR              require those participants to match within DUR seconds\n\
+  -O text|json|csv    format of the statistics printed every second:\n\
+                        text human-readable (default)\n\
+                        json one JSON object per line\n\
+                        csv  comma-separated values with a header line\n\
+                      in json and csv format, CPU usage and maximum RSS of\n\
+                      the process are included and other output goes to\n\
+                      stderr\n\
+  -H                  omit the CSV header line\n\
+  -I NAME             process name to include in json and csv records\n\
+  -S FILE             run the scenario in FILE (see below)\n\
 \n\
 MODE... is zero or more of:\n\
   ping [R[Hz]] [waitset|listener]\n\
@@ -1451,6 +1717,17 @@ MODE... is zero or more of:\n\
     \"ping\" keyword is optional, the %% sign is not).\n\
 \n\
 If no MODE specified, it defaults to a 1Hz ping + responding to any pings.\n\
+\n\
+A scenario file describes a local topology of processes, one per line:\n\
+  NAME[*N]: [OPTIONS] MODE...\n\
+where the OPTIONS and MODEs are as above, \"*N\" starts N instances of the\n\
+process and everything following a \"#\" is ignored.  If the scenario\n\
+consists of a single process, it runs in the ddsperf process itself,\n\
+otherwise each process is started with the options given on the command line\n\
+(which must include a path to the executable, rather than rely on PATH).\n\
+The exit status is 0 only if all processes exit with status 0.  Example:\n\
+  pub: -D 10 -T K1K pub 10kHz burst 10\n\
+  sub*2: -D 10 -T K1K sub\n\
 ", argv0, argv0);
   fflush (stdout);
   exit (3);
@@ -1633,26 +1910,172 @@ static void set_mode (int xoptind, int xargc, char * const xargv[])
   }
 }
 
-int main (int argc, char *argv[])
+/*********
+ SCENARIOS
+ *********/
+
+struct scenario_proc {
+  char *name;
+  unsigned count;
+  int argc;
+  char **argv; /* argv[0] is a placeholder for the executable */
+};
+
+struct scenario {
+  unsigned nprocs;
+  struct scenario_proc *procs;
+};
+
+static void scenario_read (struct scenario *sc, const char *file)
 {
-  dds_entity_t ws;
-  dds_return_t rc;
-  dds_qos_t *qos;
-  dds_listener_t *listener;
-  int opt;
-  ddsrt_threadattr_t attr;
-  ddsrt_thread_t pubtid, subtid, subpingtid, subpongtid;
-#ifndef _WIN32
-  sigset_t sigset, osigset;
-  ddsrt_thread_t sigtid;
-#endif
-  ddsrt_threadattr_init (&attr);
+  char line[4096];
+  unsigned lineno = 0;
+  FILE *fp;
+  if ((fp = fopen (file, "r")) == NULL)
+    error3 ("%s: can't open scenario file\n", file);
+  sc->nprocs = 0;
+  sc->procs = NULL;
+  while (fgets (line, sizeof (line), fp) != NULL)
+  {
+    struct scenario_proc *sp;
+    char *colon, *star, *tok, *cursor;
+    lineno++;
+    if (strchr (line, '\n') == NULL && !feof (fp))
+      error3 ("%s:%u: line too long\n", file, lineno);
+    if ((cursor = strchr (line, '#')) != NULL)
+      *cursor = 0;
+    cursor = line + strspn (line, " \t\r\n");
+    if (*cursor == 0)
+      continue;
+    if ((colon = strchr (cursor, ':')) == NULL)
+      error3 ("%s:%u: expected NAME: [OPTIONS] MODE...\n", file, lineno);
+    *colon = 0;
+    sc->procs = realloc (sc->procs, (sc->nprocs + 1) * sizeof (*sc->procs));
+    sp = &sc->procs[sc->nprocs++];
+    sp->count = 1;
+    if ((star = strchr (cursor, '*')) != NULL)
+    {
+      int pos;
+      *star = 0;
+      if (sscanf (star + 1, "%u%n", &sp->count, &pos) != 1 || star[1 + pos] != 0 || sp->count == 0)
+        error3 ("%s:%u: %s: invalid process count\n", file, lineno, star + 1);
+    }
+    if ((tok = ddsrt_strsep (&cursor, " \t")) == NULL || *tok == 0)
+      error3 ("%s:%u: process name missing\n", file, lineno);
+    sp->name = ddsrt_strdup (tok);
+    sp->argc = 1;
+    sp->argv = malloc (2 * sizeof (*sp->argv));
+    sp->argv[0] = (char *) argv0;
+    cursor = colon + 1;
+    while ((tok = ddsrt_strsep (&cursor, " \t\r\n")) != NULL)
+    {
+      if (*tok == 0)
+        continue;
+      sp->argv = realloc (sp->argv, ((size_t) sp->argc + 2) * sizeof (*sp->argv));
+      sp->argv[sp->argc++] = ddsrt_strdup (tok);
+    }
+    sp->argv[sp->argc] = NULL;
+  }
+  fclose (fp);
+  if (sc->nprocs == 0)
+    error3 ("%s: scenario contains no processes\n", file);
+}
 
-  argv0 = argv[0];
+static void scenario_free (struct scenario *sc)
+{
+  for (unsigned i = 0; i < sc->nprocs; i++)
+  {
+    for (int j = 1; j < sc->procs[i].argc; j++)
+      free (sc->procs[i].argv[j]);
+    free (sc->procs[i].argv);
+    free (sc->procs[i].name);
+  }
+  free (sc->procs);
+}
 
-  if (argc == 2 && strcmp (argv[1], "help") == 0)
-    usage ();
-  while ((opt = getopt (argc, argv, "D:n:z:k:uLT:M:N:h")) != EOF)
+static void scenario_signal_handler (int sig)
+{
+  /* the processes in the scenario get the signal as well */
+  (void) sig;
+  termflag = 1;
+}
+
+static int scenario_run (const struct scenario *sc, int nfwd, char * const fwd[])
+{
+  /* Starts all processes with the forwarded options prepended and waits
+     for them to terminate */
+  ddsrt_pid_t *pids;
+  unsigned npids = 0, nfailed = 0;
+  for (unsigned i = 0; i < sc->nprocs; i++)
+    npids += sc->procs[i].count;
+  pids = malloc (npids * sizeof (*pids));
+  if (outputfmt == OF_CSV && csvheader)
+    print_csv_header ();
+  signal (SIGINT, scenario_signal_handler);
+
+  npids = 0;
+  for (unsigned i = 0; i < sc->nprocs; i++)
+  {
+    const struct scenario_proc *sp = &sc->procs[i];
+    char **xargv = malloc (((size_t) nfwd + 4 + (size_t) sp->argc) * sizeof (*xargv));
+    char name[256];
+    int xargc = 0;
+    for (int j = 0; j < nfwd; j++)
+      xargv[xargc++] = fwd[j];
+    xargv[xargc++] = "-H";
+    xargv[xargc++] = "-I";
+    xargv[xargc++] = name;
+    for (int j = 1; j < sp->argc; j++)
+      xargv[xargc++] = sp->argv[j];
+    xargv[xargc] = NULL;
+    for (unsigned k = 0; k < sp->count; k++)
+    {
+      dds_retcode_t ret;
+      if (sp->count == 1)
+        snprintf (name, sizeof (name), "%s", sp->name);
+      else
+        snprintf (name, sizeof (name), "%s.%u", sp->name, k + 1);
+      if ((ret = ddsrt_proc_create (argv0, xargv, &pids[npids])) != DDS_RETCODE_OK)
+      {
+        fprintf (logfp, "[%"PRIdPID"] %s: failed to start %s (%d)\n", ddsrt_getpid (), name, argv0, (int) ret);
+        nfailed++;
+      }
+      else
+      {
+        fprintf (logfp, "[%"PRIdPID"] %s: started as %"PRIdPID"\n", ddsrt_getpid (), name, pids[npids]);
+        npids++;
+      }
+    }
+    free (xargv);
+  }
+  fflush (logfp);
+
+  while (npids > 0)
+  {
+    ddsrt_pid_t pid;
+    int32_t code;
+    dds_retcode_t ret = ddsrt_proc_waitpids (DDS_SECS (1), &pid, &code);
+    if (ret == DDS_RETCODE_OK)
+    {
+      if (code != 0)
+        nfailed++;
+      fprintf (logfp, "[%"PRIdPID"] process %"PRIdPID" exited with status %"PRId32"\n", ddsrt_getpid (), pid, code);
+      fflush (logfp);
+      npids--;
+    }
+    else if (ret != DDS_RETCODE_TIMEOUT && ret != DDS_RETCODE_PRECONDITION_NOT_MET)
+    {
+      break;
+    }
+  }
+  free (pids);
+  return (nfailed == 0) ? 0 : 1;
+}
+
+static void parse_options (int argc, char *argv[])
+{
+  int opt;
+  while ((opt = getopt (argc, argv, "D:n:z:k:uLT:M:N:O:HI:S:h")) != EOF)
   {
     switch (opt)
     {
@@ -1665,16 +2088,90 @@ int main (int argc, char *argv[])
         if (strcmp (optarg, "KS") == 0) topicsel = KS;
         else if (strcmp (optarg, "K32") == 0) topicsel = K32;
         else if (strcmp (optarg, "K256") == 0) topicsel = K256;
+        else if (strcmp (optarg, "K1K") == 0) topicsel = K1K;
+        else if (strcmp (optarg, "K16K") == 0) topicsel = K16K;
         else if (strcmp (optarg, "OU") == 0) topicsel = OU;
         else error3 ("%s: unknown topic\n", optarg);
         break;
       case 'M': maxwait = atof (optarg); if (maxwait <= 0) maxwait = HUGE_VAL; break;
       case 'N': minmatch = (unsigned) atoi (optarg); break;
       case 'z': baggagesize = (unsigned) atoi (optarg); break;
+      case 'O':
+        if (strcmp (optarg, "text") == 0) outputfmt = OF_TEXT;
+        else if (strcmp (optarg, "json") == 0) outputfmt = OF_JSON;
+        else if (strcmp (optarg, "csv") == 0) outputfmt = OF_CSV;
+        else error3 ("%s: unknown output format\n", optarg);
+        break;
+      case 'H': csvheader = false; break;
+      case 'I': procname = optarg; break;
+      case 'S': scenario_file = optarg; break;
       case 'h': usage (); break;
       default: error3 ("-%c: unknown option\n", opt); break;
     }
   }
+}
+
+int main (int argc, char *argv[])
+{
+  dds_entity_t ws;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  dds_listener_t *listener;
+  ddsrt_threadattr_t attr;
+  ddsrt_thread_t pubtid, subtid, subpingtid, subpongtid;
+#ifndef _WIN32
+  sigset_t sigset, osigset;
+  ddsrt_thread_t sigtid;
+#endif
+  ddsrt_threadattr_init (&attr);
+
+  logfp = stdout;
+  argv0 = argv[0];
+
+  if (argc == 2 && strcmp (argv[1], "help") == 0)
+    usage ();
+  parse_options (argc, argv);
+  if (outputfmt != OF_TEXT)
+    logfp = stderr;
+  if (scenario_file != NULL)
+  {
+    struct scenario sc;
+    if (optind != argc)
+      error3 ("%s: no modes allowed on the command line with a scenario\n", argv[optind]);
+    scenario_read (&sc, scenario_file);
+    if (sc.nprocs > 1 || sc.procs[0].count > 1)
+    {
+      /* forward all options except the scenario itself */
+      char **fwd = malloc ((size_t) argc * sizeof (*fwd));
+      int nfwd = 0, ret;
+      for (int i = 1; i < optind; i++)
+      {
+        if (strcmp (argv[i], "-S") == 0)
+          i++;
+        else if (strncmp (argv[i], "-S", 2) != 0)
+          fwd[nfwd++] = argv[i];
+      }
+      ret = scenario_run (&sc, nfwd, fwd);
+      free (fwd);
+      scenario_free (&sc);
+      return ret;
+    }
+    /* single process: run it here, the scenario is never freed because
+       the arguments are referenced by the configuration */
+    if (strcmp (procname, "ddsperf") == 0)
+      procname = sc.procs[0].name;
+    scenario_file = NULL;
+    argc = sc.procs[0].argc;
+    argv = sc.procs[0].argv;
+    optind = 1;
+    parse_options (argc, argv);
+    if (scenario_file != NULL)
+      error3 ("%s: scenarios can't be nested\n", scenario_file);
+  }
+  if (outputfmt != OF_TEXT)
+    logfp = stderr;
+  if (outputfmt == OF_CSV && csvheader)
+    print_csv_header ();
   set_mode (optind, argc, argv);
 
   if (nkeyvals == 0)
@@ -1733,6 +2230,8 @@ int main (int argc, char *argv[])
       case KS:   tp_suf = "KS";   tp_desc = &KeyedSeq_desc; break;
       case K32:  tp_suf = "K32";  tp_desc = &Keyed32_desc;  break;
       case K256: tp_suf = "K256"; tp_desc = &Keyed256_desc; break;
+      case K1K:  tp_suf = "K1K";  tp_desc = &Keyed1k_desc;  break;
+      case K16K: tp_suf = "K16K"; tp_desc = &Keyed16k_desc; break;
       case OU:   tp_suf = "OU";   tp_desc = &OneULong_desc; break;
     }
     snprintf (tpname_data, sizeof (tpname_data), "DDSPerf%cData%s", reliable ? 'R' : 'U', tp_suf);
@@ -1806,14 +2305,16 @@ int main (int argc, char *argv[])
   {
     /* participant listener should have already been called for "dp", so we
        can simply look up the details on ourself to get at the GUID of the
-       participant */
+       participant -- unless listeners are invoked asynchronously, so make
+       sure the participant data has been processed */
     struct guidstr guidstr;
     struct ppant *pp;
     dds_entity_t sub_pong;
+    participant_data_listener (rd_participants, NULL);
     ddsrt_mutex_lock (&disc_lock);
     if ((pp = ddsrt_avl_lookup (&ppants_td, &ppants, &dp_handle)) == NULL)
     {
-      printf ("participant %"PRIx64" (self) not found\n", dp_handle);
+      fprintf (logfp, "participant %"PRIx64" (self) not found\n", dp_handle);
       exit (2);
     }
     make_guidstr (&guidstr, &pp->guid);
@@ -1896,6 +2397,7 @@ int main (int argc, char *argv[])
 
   /* Run until time limit reached or a signal received.  (The time calculations
      ignore the possibility of overflow around the year 2260.) */
+  init_proc_stats ();
   dds_time_t tnow = dds_time ();
   const dds_time_t tstart = tnow;
   dds_time_t tmatch = (maxwait == HUGE_VAL) ? DDS_NEVER : tstart + (int64_t) (maxwait * 1e9 + 0.5);
@@ -1937,8 +2439,8 @@ int main (int argc, char *argv[])
         (void) ddsrt_fibheap_extract_min (&ppants_to_match_fhd, &ppants_to_match);
         if (pp->unmatched != 0)
         {
-          printf ("[%"PRIdPID"] participant %s:%"PRIu32": failed to match in %.3fs\n", ddsrt_getpid (), pp->hostname, pp->pid, (double) (pp->tdeadline - pp->tdisc) / 1e9);
-          fflush (stdout);
+          fprintf (logfp, "[%"PRIdPID"] participant %s:%"PRIu32": failed to match in %.3fs\n", ddsrt_getpid (), pp->hostname, pp->pid, (double) (pp->tdeadline - pp->tdisc) / 1e9);
+          fflush (logfp);
           matchtimeout++;
         }
         /* keep the participant in the admin so we will never look at it again */
@@ -2061,18 +2563,18 @@ int main (int argc, char *argv[])
       if (pp->unmatched != 0)
       {
         char buf[256];
-        printf ("[%"PRIdPID"] error: %s:%"PRIu32" failed to match %s\n", ddsrt_getpid (), pp->hostname, pp->pid, match_mask_to_string (buf, sizeof (buf), pp->unmatched));
+        fprintf (logfp, "[%"PRIdPID"] error: %s:%"PRIu32" failed to match %s\n", ddsrt_getpid (), pp->hostname, pp->pid, match_mask_to_string (buf, sizeof (buf), pp->unmatched));
         ok = false;
       }
   }
   if (matchcount < minmatch)
   {
-    printf ("[%"PRIdPID"] error: too few matching participants (%"PRIu32" instead of %"PRIu32")\n", ddsrt_getpid (), matchcount, minmatch);
+    fprintf (logfp, "[%"PRIdPID"] error: too few matching participants (%"PRIu32" instead of %"PRIu32")\n", ddsrt_getpid (), matchcount, minmatch);
     ok = false;
   }
   if (nlost > 0 && (reliable && histdepth == 0))
   {
-    printf ("[%"PRIdPID"] error: %"PRIu64" samples lost\n", ddsrt_getpid (), nlost);
+    fprintf (logfp, "[%"PRIdPID"] error: %"PRIu64" samples lost\n", ddsrt_getpid (), nlost);
     ok = false;
   }
   return ok ? 0 : 1;